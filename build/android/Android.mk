@@ -86,6 +86,7 @@ LOCAL_SRC_FILES = \
 	base/msticker.c \
 	base/msvideopresets.c \
 	base/mswebcam.c \
+	base/msworkerpool.c \
 	base/mtu.c \
 	crypto/dtls_srtp.c \
 	crypto/ms_srtp.c \
@@ -99,6 +100,7 @@ LOCAL_SRC_FILES = \
 	utils/dsptools.c \
 	utils/g722_decode.c \
 	utils/g722_encode.c \
+	utils/pcmformat.c \
 	utils/kiss_fft.c \
 	utils/kiss_fftr.c \
 	utils/msjava.c \
@@ -110,12 +112,20 @@ LOCAL_SRC_FILES = \
 	voip/ice.c \
 	voip/mediastream.c \
 	voip/msmediaplayer.c \
+	voip/msrtpbatcher.c \
+	voip/msrtpendpoint.c \
+	voip/msrtpfec.c \
+	voip/msrtpmultiplexer.c \
+	voip/msrtpretransmission.c \
+	voip/msrtpsharedport.c \
 	voip/msvoip.c \
 	voip/qosanalyzer.c \
 	voip/qualityindicator.c \
 	voip/ringstream.c \
 	voip/stun.c \
 	voip/stun_udp.c \
+	otherfilters/mspacer.c \
+	otherfilters/msred.c \
 	otherfilters/rfc4103_source.c \
 	otherfilters/rfc4103_sink.c \
 	voip/rfc4103_textstream.c
@@ -145,7 +155,9 @@ ifeq ($(_BUILD_VIDEO),1)
 LOCAL_SRC_FILES += \
 	voip/video_preset_high_fps.c \
 	voip/videostarter.c \
+	voip/msencoderthread.c \
 	voip/videostream.c \
+	voip/videoconference.c \
 	voip/rfc3984.c \
 	voip/vp8rtpfmt.c \
 	voip/layouts.c \
@@ -156,6 +168,8 @@ LOCAL_SRC_FILES += \
 	videofilters/videodec.c \
 	videofilters/pixconv.c  \
 	videofilters/sizeconv.c \
+	videofilters/videomixer.c \
+	videofilters/videoswitcher.c \
 	videofilters/nowebcam.c \
 	videofilters/h264dec.c \
 	videofilters/mire.c \
@@ -186,6 +200,8 @@ ifeq ($(TARGET_ARCH), x86)
 endif
 LOCAL_SRC_FILES+= \
 	voip/scaler.c \
+	voip/scaler_x86.c \
+	voip/msvideo_x86.c \
 	voip/msvideo.c
 endif
 
@@ -52,6 +52,9 @@ extern MSFilterDesc ms_itc_source_desc;
 extern MSFilterDesc ms_itc_sink_desc;
 extern MSFilterDesc ms_vad_dtx_desc;
 extern MSFilterDesc ms_genericplc_desc;
+extern MSFilterDesc ms_red_enc_desc;
+extern MSFilterDesc ms_red_dec_desc;
+extern MSFilterDesc ms_pacer_desc;
 extern MSFilterDesc ms_rtt_4103_sink_desc;
 extern MSFilterDesc ms_rtt_4103_source_desc;
 
@@ -109,6 +112,9 @@ MSFilterDesc * ms_voip_filter_descs[]={
 &ms_itc_sink_desc,
 &ms_vad_dtx_desc,
 &ms_genericplc_desc,
+&ms_red_enc_desc,
+&ms_red_dec_desc,
+&ms_pacer_desc,
 &ms_rtt_4103_sink_desc,
 &ms_rtt_4103_source_desc,
 NULL
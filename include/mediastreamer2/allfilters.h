@@ -156,7 +156,12 @@ typedef enum MSFilterId{
 	MS_MEDIACODEC_H264_DEC_ID,
 	MS_MEDIACODEC_H264_ENC_ID,
 	MS_BV16_DEC_ID,
-	MS_BV16_ENC_ID
+	MS_BV16_ENC_ID,
+	MS_VIDEO_MIXER_ID,
+	MS_VIDEO_SWITCHER_ID,
+	MS_RED_ENC_ID,
+	MS_RED_DEC_ID,
+	MS_PACER_ID
 } MSFilterId;
 
 #endif
@@ -22,6 +22,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define ms2_ratecontrol
 
 #include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msrtpfec.h"
 #include <ortp/ortp.h>
 
 #ifdef __cplusplus
@@ -88,7 +89,8 @@ struct _MSQosAnalyzerDesc{
 
 enum _MSQosAnalyzerAlgorithm {
 	MSQosAnalyzerAlgorithmSimple,
-	MSQosAnalyzerAlgorithmStateful
+	MSQosAnalyzerAlgorithmStateful,
+	MSQosAnalyzerAlgorithmDelayGradient
 };
 typedef enum _MSQosAnalyzerAlgorithm MSQosAnalyzerAlgorithm;
 MS2_PUBLIC const char* ms_qos_analyzer_algorithm_to_string(MSQosAnalyzerAlgorithm alg);
@@ -133,6 +135,17 @@ MS2_PUBLIC void ms_qos_analyzer_set_on_action_suggested(MSQosAnalyzer *obj, void
 MS2_PUBLIC MSQosAnalyzer * ms_simple_qos_analyzer_new(RtpSession *session);
 
 MS2_PUBLIC MSQosAnalyzer * ms_stateful_qos_analyzer_new(RtpSession *session);
+
+/**
+ * The delay gradient qos analyzer estimates the available bandwidth from the variations of the one way delay of the
+ * packets, which grows as soon as a queue builds up on the path, before any packet is lost.
+ * It works on both sides of the session: the delay of the packets received is measured and the resulting estimation is
+ * sent back to the remote party in REMB feedback messages, while the estimations received from the remote party, and
+ * the loss rate of its reports, drive the actions suggested for the streams sent. Both parties must use it.
+ * The analyzer is attached to the session until the session is destroyed: creating it again for the same session returns
+ * the same analyzer, which keeps its estimations.
+**/
+MS2_PUBLIC MSQosAnalyzer * ms_delay_gradient_qos_analyzer_new(RtpSession *session);
 /**
  * The audio/video qos analyzer is an implementation of MSQosAnalyzer that performs analysis of two audio and video streams.
 **/
@@ -170,6 +183,13 @@ MS2_PUBLIC void ms_bitrate_controller_update(MSBitrateController *obj);
 **/
 MS2_PUBLIC MSQosAnalyzer * ms_bitrate_controller_get_qos_analyzer(MSBitrateController *obj);
 
+/**
+ * Give the bitrate controller the FEC handler of the session, whose protection is then adapted to the loss rate
+ * reported by the remote party. The FEC handler is not owned by the bitrate controller.
+ * @param fec the FEC handler, or NULL to stop adapting it.
+**/
+MS2_PUBLIC void ms_bitrate_controller_set_fec(MSBitrateController *obj, MSRtpFec *fec);
+
 /**
  * Destroys the bitrate controller
  *
@@ -206,6 +226,12 @@ MS2_PUBLIC MSBitrateController *ms_audio_bitrate_controller_new(RtpSession *sess
 MS2_PUBLIC MSBitrateController *ms_av_bitrate_controller_new(RtpSession *asession, MSFilter *aenc, RtpSession *vsession, MSFilter *venc);
 
 MS2_PUBLIC MSBitrateController *ms_bandwidth_bitrate_controller_new(RtpSession *asession, MSFilter *aenc, RtpSession *vsession, MSFilter *venc);
+
+/**
+ * Convenience function to create a bitrate controller using the delay gradient qos analyzer on the video session, or
+ * the audio session if there is no video, and the bandwidth bitrate driver.
+**/
+MS2_PUBLIC MSBitrateController *ms_delay_gradient_bitrate_controller_new(RtpSession *asession, MSFilter *aenc, RtpSession *vsession, MSFilter *venc);
 #ifdef __cplusplus
 }
 #endif
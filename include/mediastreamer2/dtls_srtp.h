@@ -46,6 +46,16 @@ typedef struct MSDtlsSrtpParams {
 /* an opaque structure containing all context data needed by DTLS-SRTP */
 typedef struct _MSDtlsSrtpContext MSDtlsSrtpContext;
 
+/* defined in msworkerpool.h */
+struct _MSWorkerPool;
+
+typedef struct _MSDtlsSrtpStats {
+	uint64_t handshake_duration; /**< time in ms between the start of the handshake and the availability of the keys on RTP channel, 0 until then */
+	uint64_t handshake_processing_time; /**< time in us spent computing the handshake steps, on both channels */
+	uint64_t handshake_max_step_time; /**< longest time in us spent computing a single handshake step */
+	int handshake_steps; /**< number of handshake steps computed */
+} MSDtlsSrtpStats;
+
 /**
  * check if DTLS-SRTP is available
  * @return TRUE if it is available, FALSE if not
@@ -79,6 +89,22 @@ MS2_PUBLIC void ms_dtls_srtp_context_destroy(MSDtlsSrtpContext *ctx);
  */
 MS2_PUBLIC void ms_dtls_srtp_set_role(MSDtlsSrtpContext *context, MSDtlsSrtpRole role);
 
+/**
+ * Compute the handshake steps with the threads of a worker pool instead of the thread receiving the packets (usually a MSTicker thread),
+ * so that the cryptographic operations of the handshake do not delay the processing of the other streams.
+ * The keys are given to srtp by the thread receiving the packets once the handshake is over.
+ * @param[in/out]	context		the DTLS-SRTP context
+ * @param[in]		pool		the worker pool, which must outlive the context, or NULL to compute the handshake steps synchronously
+ */
+MS2_PUBLIC void ms_dtls_srtp_set_worker_pool(MSDtlsSrtpContext *context, struct _MSWorkerPool *pool);
+
+/**
+ * Get the handshake timings of the DTLS-SRTP context
+ * @param[in]	context		the DTLS-SRTP context
+ * @param[out]	stats		filled with the timings, zeroed when the context is NULL
+ */
+MS2_PUBLIC void ms_dtls_srtp_get_stats(MSDtlsSrtpContext *context, MSDtlsSrtpStats *stats);
+
 /**
  * Give to the DTLS-SRTP context the peer certificate fingerprint extracted from trusted SDP INVITE,
  * it will be compared(case insensitive) with locally computed one after DTLS handshake is completed successfully and peer certicate retrieved
@@ -21,6 +21,7 @@
 #ifndef flowcontrol_h
 #define flowcontrol_h
 
+#include "mediastreamer2/msqueue.h"
 
 
 typedef struct _MSAudioFlowController {
@@ -41,6 +42,47 @@ MS2_PUBLIC void ms_audio_flow_controller_set_target(MSAudioFlowController *ctl,
 
 MS2_PUBLIC mblk_t *ms_audio_flow_controller_process(MSAudioFlowController *ctl, mblk_t *m);
 
+/**
+ * The MSAudioTimeStretcher reads 16 bits PCM audio out of a MSBufferizer, and slightly accelerates or slows down
+ * the playout in order to keep the amount of buffered audio close to a target.
+ * Corrections are made by removing or repeating one pitch period at a time, chosen by waveform similarity and
+ * inserted with a cross-fade (WSOLA), so that they are hardly audible. This compensates clock drifts between
+ * sound cards, mixers and RTP streams continuously, instead of letting queues grow and then discarding samples.
+**/
+typedef struct _MSAudioTimeStretcher MSAudioTimeStretcher;
+
+MS2_PUBLIC MSAudioTimeStretcher *ms_audio_time_stretcher_new(int rate, int nchannels);
+
+/**
+ * Set the amount of buffered audio, in milliseconds, that the stretcher tries to maintain.
+**/
+MS2_PUBLIC void ms_audio_time_stretcher_set_target(MSAudioTimeStretcher *ts, int target_ms);
+
+/**
+ * Returns the maximum amount of buffered audio, in milliseconds. When the input brings more audio than the speed change
+ * can absorb and this amount is exceeded, the excess is discarded at once down to the target.
+ * It is three times the target, and at least the target plus 60 milliseconds.
+**/
+MS2_PUBLIC int ms_audio_time_stretcher_get_max_depth(const MSAudioTimeStretcher *ts);
+
+/**
+ * Set the maximum playout speed change, for example 0.04 for +/- 4%.
+**/
+MS2_PUBLIC void ms_audio_time_stretcher_set_max_speed_change(MSAudioTimeStretcher *ts, float ratio);
+
+/**
+ * Read nsamples samples per channel from the bufferizer into out.
+ * @return the number of samples per channel written, which is nsamples or 0 if not enough audio is available.
+**/
+MS2_PUBLIC int ms_audio_time_stretcher_read(MSAudioTimeStretcher *ts, MSBufferizer *input, int16_t *out, int nsamples);
+
+/**
+ * Returns the number of samples per channel that were removed (positive) or inserted (negative) since creation.
+**/
+MS2_PUBLIC int64_t ms_audio_time_stretcher_get_correction(const MSAudioTimeStretcher *ts);
+
+MS2_PUBLIC void ms_audio_time_stretcher_destroy(MSAudioTimeStretcher *ts);
+
 
 #ifdef __cplusplus
 }
@@ -197,6 +197,8 @@ typedef struct _IceCandidatePair {
 	bool_t wait_transaction_timeout;	/**< Boolean value telling to create a new binding request on retransmission timeout */
 	bool_t retry_with_dummy_message_integrity; /** use to tell to retry with dummy message integrity. Useful to keep backward compatibility with older version*/
 	bool_t use_dummy_hmac; /*don't compute real hmac. used for backward compatibility*/
+	bool_t in_check_list;	/**< Boolean value telling whether the candidate pair is in the check list of its check list */
+	struct _IceTimer *retransmission_timer;	/**< Timer of the check list timer wheel that triggers the retransmissions of the connectivity check */
 } IceCandidatePair;
 
 /**
@@ -256,6 +258,8 @@ typedef struct _IceCheckList {
 	MSTimeSpec gathering_start_time;	/**< Time when the gathering process was started */
 	MSTimeSpec nomination_delay_start_time;	/**< Time when the nomination process has been delayed */
 	IceStunRequestRoundTripTime rtt;
+	struct _IceCheckListIndexes *indexes;	/**< Hash tables indexing the candidates by transport address, the candidate pairs by candidates and the transactions by ID */
+	struct _IceTimerWheel *timers;	/**< Timer wheel scheduling the retransmissions of the connectivity checks and the keepalives */
 } IceCheckList;
 
 
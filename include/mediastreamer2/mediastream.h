@@ -37,6 +37,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <mediastreamer2/dtls_srtp.h>
 #include <mediastreamer2/ms_srtp.h>
 #include <mediastreamer2/msequalizer.h>
+#include <mediastreamer2/msrtpsharedport.h>
+#include <mediastreamer2/msrtpretransmission.h>
+#include <mediastreamer2/msrtpfec.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -386,6 +389,8 @@ struct _AudioStream
 	}av_player;
 	RtpSession *rtp_io_session; /**< The RTP session used for RTP input/output. */
 	MSFilter *vaddtx;
+	MSFilter *red_enc; /*add and use the redundant copies of the frames when the red payload type is used (RFC 2198)*/
+	MSFilter *red_dec;
 	char *recorder_file;
 	EchoLimiterType el_type; /*use echo limiter: two MSVolume, measured input level controlling local output level*/
 	EqualizerLocation eq_loc;
@@ -823,6 +828,20 @@ struct _VideoStream
 	uint64_t last_reported_decoding_error_time;
 	uint64_t last_fps_check;
 	MediaStreamVideoStat ms_video_stat;
+	RtpSession *simulcast_sessions[2]; /*sessions sending the lower resolution layers, owned by the application*/
+	MSFilter *simulcast_rtpsends[2];
+	OrtpEvQueue *simulcast_evqs[2]; /*receive the RTCP of the simulcast sessions, for their key frame requests*/
+	int simulcast_layers;
+	MSFilter *video_switcher; /*set while the stream is a member of a MSVideoConference, to forward it the key frame requests*/
+	int video_switcher_pin;
+	MSRtpRetransmission *retransmission; /*answers and sends the generic NACKs, if enabled*/
+	int retransmission_cache_size;
+	MSRtpFec *fec; /*sends and uses the FEC packets, if enabled*/
+	int fec_payload_type;
+	MSFilter *pacer; /*spreads the packets of the frames sent, if enabled*/
+	RtpSession *pacing_priority_session; /*the session whose packets go first, owned by the application*/
+	int pacing_bitrate; /*the bitrate last given to the pacer*/
+	bool_t pacing_enabled;
 	bool_t use_preview_window;
 	bool_t freeze_on_error;
 	bool_t display_filter_auto_rotate_enabled;
@@ -1118,6 +1137,75 @@ MS2_PUBLIC void video_stream_set_preview_size(VideoStream *stream, MSVideoSize v
 **/
 MS2_PUBLIC void video_stream_set_fps(VideoStream *stream, float fps);
 
+/**
+ * Send the video in several resolutions (simulcast), from a single capture.
+ * Besides the full resolution picture, sent on the main RTP session, the encoder outputs layers half the size of the previous one,
+ * each of them sent on its own RTP session so with its own SSRC. The bitrate given to the encoder is shared between the layers,
+ * the largest ones being disabled when it is not enough. It has no effect if the encoder does not support simulcast.
+ * Must be called before the stream is started.
+ * @param[in] stream The VideoStream object.
+ * @param[in] layer_sessions the RTP sessions of the lower resolution layers, from the largest to the smallest. They must be
+ * configured (profile, send payload type and remote address) by the application, and remain valid until the stream is stopped.
+ * The PLI and FIR received on them make the encoder send a key frame. oRTP reads the RTCP of the sessions in RTP_SESSION_SENDONLY mode
+ * when sending, so this is the mode to create them in.
+ * @param[in] nlayers the number of sessions in layer_sessions, at most 2. 0 disables simulcast.
+**/
+MS2_PUBLIC void video_stream_enable_simulcast(VideoStream *stream, RtpSession *layer_sessions[], int nlayers);
+
+/**
+ * Recover the lost video packets by requesting their retransmission with generic NACK messages, and retransmit the packets
+ * requested by the remote party. This is cheaper than the key frame that would otherwise be needed to repair the picture.
+ * Must be called before the stream is started, and only has an effect if AVPF is enabled for the payload type.
+ * The remote party must support generic NACK (a=rtcp-fb:* nack in SDP).
+ * @param[in] stream The VideoStream object.
+ * @param[in] cache_size the number of sent packets kept for retransmission, rounded up to a power of two. 0 disables retransmissions.
+**/
+MS2_PUBLIC void video_stream_enable_retransmission(VideoStream *stream, int cache_size);
+
+/**
+ * Get the counters of the retransmissions of the stream. They are all zero if retransmissions are not enabled.
+**/
+MS2_PUBLIC void video_stream_get_retransmission_stats(VideoStream *stream, MSRtpRetransmissionStats *stats);
+
+/**
+ * Protect the video packets sent with XOR forward error correction packets, and rebuild the lost packets from the FEC packets
+ * received. A lost packet is then recovered without waiting for a retransmission nor a key frame, at the cost of the bandwidth
+ * of the FEC packets, which is adapted to the loss rate reported by the remote party. The FEC packets are sent as a separate
+ * stream with its own SSRC, and are protected by SRTP like the video packets. Must be called before the stream is started.
+ * The remote party must send and understand the FEC packets with the same payload type.
+ * @param[in] stream The VideoStream object.
+ * @param[in] payload_type the payload type of the FEC packets, not used by the stream. 0 disables FEC.
+**/
+MS2_PUBLIC void video_stream_enable_fec(VideoStream *stream, int payload_type);
+
+/**
+ * Get the counters of the FEC of the stream. They are all zero if FEC is not enabled.
+**/
+MS2_PUBLIC void video_stream_get_fec_stats(VideoStream *stream, MSRtpFecStats *stats);
+
+/**
+ * Spread the packets of the frames sent over time, at a multiple of the bitrate of the encoder, instead of sending all the
+ * packets of a frame at once. The bursts of the key frames no longer overflow the buffers of the routers, at the cost of a
+ * few milliseconds of delay. Must be called before the stream is started.
+ * @param[in] stream The VideoStream object.
+ * @param[in] enabled TRUE to pace the packets sent.
+**/
+MS2_PUBLIC void video_stream_enable_pacing(VideoStream *stream, bool_t enabled);
+
+/**
+ * Give the packets of another session, usually the audio session of the same call, priority over the video packets when
+ * pacing is enabled: the bandwidth they use is deducted from the pacing rate of the video.
+ * @param[in] stream The VideoStream object.
+ * @param[in] session the RTP session whose packets go first, or NULL. It must remain valid until the stream is stopped or the
+ * session is removed.
+**/
+MS2_PUBLIC void video_stream_set_pacing_priority_session(VideoStream *stream, RtpSession *session);
+
+/**
+ * Get the time in milliseconds the oldest packet queued by the pacer has waited, 0 if pacing is not enabled.
+**/
+MS2_PUBLIC int video_stream_get_pacing_queue_delay(VideoStream *stream);
+
 /**
  * Link the audio stream with an existing video stream.
  * This is necessary to enable recording of audio & video into a multimedia file.
@@ -1195,6 +1283,14 @@ MS2_PUBLIC MSWebCamDesc *ms_mire_webcam_desc_get(void);
  */
 MS2_PUBLIC RtpSession * ms_create_duplex_rtp_session(const char* local_ip, int loc_rtp_port, int loc_rtcp_port, int mtu);
 
+/**
+ * Create an RTP session for duplex communication, sending and receiving its RTP and RTCP packets through a shared port
+ * instead of its own sockets. The session must be removed from the shared port before being destroyed.
+ * @param[in] port The shared port.
+ * @return the session, or NULL if it cannot be added to the shared port.
+ */
+MS2_PUBLIC RtpSession * ms_create_shared_port_rtp_session(MSRtpSharedPort *port, int mtu);
+
 /**
  * Asks the audio playback filter to route to the selected device (currently only used for blackberry)
  * @param[in] stream The AudioStream object
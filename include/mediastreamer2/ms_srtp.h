@@ -41,7 +41,9 @@ typedef enum _MSCryptoSuite{
         MS_AES_128_NO_AUTH,
         MS_NO_CIPHER_SHA1_80,
         MS_AES_256_SHA1_80,
-        MS_AES_256_SHA1_32
+        MS_AES_256_SHA1_32,
+        MS_AEAD_AES_128_GCM, /*RFC 7714, requires a libsrtp built with GCM support*/
+        MS_AEAD_AES_256_GCM
 } MSCryptoSuite;
 
 typedef struct _MSCryptoSuiteNameParams{
@@ -74,6 +76,13 @@ MS2_PUBLIC const char * ms_srtp_stream_type_to_string(const MSSrtpStreamType typ
  */
 MS2_PUBLIC bool_t ms_srtp_supported(void);
 
+/**
+ * Check if a crypto suite is supported by the SRTP library mediastreamer2 is built with
+ * @param[in]	suite	The crypto suite
+ * @return true if the suite can be used to set the SRTP keys
+ */
+MS2_PUBLIC bool_t ms_srtp_crypto_suite_supported(MSCryptoSuite suite);
+
 /**
  * Set encryption requirements.
  * srtp session might be created/deleted depending on requirement parameter and already set keys
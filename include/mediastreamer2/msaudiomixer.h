@@ -39,4 +39,12 @@ typedef struct MSAudioMixerCtl{
 #define MS_AUDIO_MIXER_SET_MASTER_CHANNEL		MS_FILTER_METHOD(MS_AUDIO_MIXER_ID,3,int)
 
 #define MS_AUDIO_MIXER_ENABLE_OUTPUT			MS_FILTER_METHOD(MS_AUDIO_MIXER_ID,4,MSAudioMixerCtl)
+
+/**
+ * Set the amount of audio, in milliseconds, to keep buffered on each input channel (except the master channel).
+ * When set to a positive value, clock drifts between inputs are compensated by time-stretching the audio (see MSAudioTimeStretcher)
+ * instead of dropping samples once too much has accumulated. 0 (the default) keeps the dropping behavior.
+ * It must be set before the filter is attached to a ticker.
+**/
+#define MS_AUDIO_MIXER_SET_TARGET_BUFFER_DELAY		MS_FILTER_METHOD(MS_AUDIO_MIXER_ID,5,int)
 #endif
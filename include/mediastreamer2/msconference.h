@@ -19,7 +19,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 /*
- * Convenient API to create and manage audio conferences.
+ * Convenient API to create and manage audio and video conferences.
  */
 
 #ifndef msconference_h
@@ -211,6 +211,124 @@ MS2_PUBLIC void ms_audio_endpoint_destroy(MSAudioEndpoint *ep);
  * @}
  */
 
+/**
+ * @addtogroup mediastreamer2_video_conference
+ * @{
+ */
+
+/**
+ * Structure that holds video conference parameters
+**/
+struct _MSVideoConferenceParams{
+	const char *codec_mime_type; /**< Encoding used by all the participants: VP8 or H264*/
+};
+
+/**
+ * Typedef to structure that holds video conference parameters
+**/
+typedef struct _MSVideoConferenceParams MSVideoConferenceParams;
+
+/**
+ * The MSVideoConference is the object representing a video conference.
+ *
+ * Unlike the MSAudioConference, it does not decode nor mix anything: the encoded video of the participant having the
+ * focus is forwarded to all the others, who must therefore all use the same encoding.
+ * The participant having the focus receives the video of the participant that had the focus before.
+ * When the focus changes, a key frame is requested from the new participant, and its video is forwarded from this
+ * key frame on. The key frame requests (PLI and FIR) of the participants are forwarded to the participant they receive
+ * the video of, and combined so that this participant is not flooded with them.
+ *
+ * First, the conference has to be created with ms_video_conference_new().
+ * Participants are added with ms_video_conference_add_member() and removed with ms_video_conference_remove_member().
+ * The conference processing is performed in a new thread run by a MSTicker object, which is owned by the conference.
+ * When all participants are removed, the MSVideoConference object can be destroyed with ms_video_conference_destroy().
+**/
+typedef struct _MSVideoConference MSVideoConference;
+
+/**
+ * The MSVideoEndpoint represents a participant in the video conference.
+ * It is constructed from an existing VideoStream with ms_video_endpoint_get_from_stream().
+**/
+typedef struct _MSVideoEndpoint MSVideoEndpoint;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Creates a video conference.
+ * @param factory the MSFactory used to create the filters.
+ * @param params a MSVideoConferenceParams structure, containing conference parameters.
+ * @return a MSVideoConference object.
+**/
+MS2_PUBLIC MSVideoConference * ms_video_conference_new(MSFactory *factory, const MSVideoConferenceParams *params);
+
+/**
+ * Gets conference's current parameters.
+ * @param obj the conference.
+ * @return a read-only pointer to the conference parameters.
+**/
+MS2_PUBLIC const MSVideoConferenceParams *ms_video_conference_get_params(MSVideoConference *obj);
+
+/**
+ * Adds a participant to the conference.
+ * The first participant added gets the focus.
+ * @param obj the conference
+ * @param ep the participant, represented as a MSVideoEndpoint object
+**/
+MS2_PUBLIC void ms_video_conference_add_member(MSVideoConference *obj, MSVideoEndpoint *ep);
+
+/**
+ * Removes a participant from the conference.
+ * If it had the focus, the focus is given to another participant.
+ * @param obj the conference
+ * @param ep the participant, represented as a MSVideoEndpoint object
+**/
+MS2_PUBLIC void ms_video_conference_remove_member(MSVideoConference *obj, MSVideoEndpoint *ep);
+
+/**
+ * Gives the focus to a participant, whose video is then forwarded to all the others.
+ * @param obj the conference
+ * @param ep the participant, represented as a MSVideoEndpoint object
+**/
+MS2_PUBLIC void ms_video_conference_set_focus(MSVideoConference *obj, MSVideoEndpoint *ep);
+
+/**
+ * Returns the size (ie the number of participants) of a conference.
+ * @param obj the conference
+**/
+MS2_PUBLIC int ms_video_conference_get_size(MSVideoConference *obj);
+
+/**
+ * Destroys a conference.
+ * @param obj the conference
+ * All participants must have been removed before destroying the conference.
+**/
+MS2_PUBLIC void ms_video_conference_destroy(MSVideoConference *obj);
+
+/**
+ * Creates a MSVideoEndpoint from an existing VideoStream.
+ *
+ * The VideoStream is started as for a normal call with the participant, with the conference's encoding. Its capture,
+ * encoding, decoding and display are suspended while it is a participant of the conference: only its MSRtpRecv and
+ * MSRtpSend are used, to receive and send the forwarded video.
+**/
+MS2_PUBLIC MSVideoEndpoint * ms_video_endpoint_get_from_stream(VideoStream *st);
+
+/**
+ * Destroys a MSVideoEndpoint that was created from a VideoStream with ms_video_endpoint_get_from_stream().
+ * The VideoStream resumes its normal processing, and can then be destroyed if needed.
+**/
+MS2_PUBLIC void ms_video_endpoint_release_from_stream(MSVideoEndpoint *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
 
 
 #endif
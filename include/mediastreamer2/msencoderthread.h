@@ -0,0 +1,82 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef msencoderthread_h
+#define msencoderthread_h
+
+#include <mediastreamer2/msfilter.h>
+
+/**
+ * @file msencoderthread.h
+ * @brief A dedicated thread running the encoding of an encoder filter out of the MSTicker thread.
+ *
+ * The process() function of the filter pushes its input frames to the thread and collects the output produced
+ * by the encoding of the previous frames, so that a slow encoding (typically a key frame) does not make the ticker late.
+ * Frames are queued in a bounded queue: when the encoding cannot keep up, the oldest pending frame is dropped.
+**/
+
+typedef struct _MSEncoderThread MSEncoderThread;
+
+/**
+ * Function encoding one frame, executed by the encoder thread with the filter lock held.
+ * @param f the encoder filter
+ * @param frame the frame to encode. It remains owned by the encoder thread.
+ * @param frame_time the ticker time at which the frame was pushed, to be used instead of f->ticker->time.
+ * @param output the queue where to put the encoded packets.
+**/
+typedef void (*MSEncoderThreadFunc)(MSFilter *f, mblk_t *frame, uint64_t frame_time, MSQueue *output);
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * Create an encoder thread for a filter.
+ * @param f the encoder filter
+ * @param func the encoding function
+ * @param max_pending the maximum number of frames waiting for the encoder thread, at least 1.
+**/
+MS2_PUBLIC MSEncoderThread *ms_encoder_thread_new(MSFilter *f, MSEncoderThreadFunc func, int max_pending);
+
+/**
+ * Queue a frame for encoding, and take ownership of it. When max_pending frames are already waiting, the oldest one is dropped.
+**/
+MS2_PUBLIC void ms_encoder_thread_push(MSEncoderThread *obj, mblk_t *frame, uint64_t frame_time);
+
+/**
+ * Move the packets encoded since the last call to the output queue.
+**/
+MS2_PUBLIC void ms_encoder_thread_collect(MSEncoderThread *obj, MSQueue *output);
+
+/**
+ * Get the number of encoded and dropped frames, and the encoding latency.
+**/
+MS2_PUBLIC void ms_encoder_thread_get_stats(MSEncoderThread *obj, MSVideoEncoderAsyncStats *stats);
+
+/**
+ * Stop the thread and destroy the object. Pending frames and packets not collected yet are discarded.
+ * It must not be called with the filter lock held, because the encoding function runs under this lock.
+**/
+MS2_PUBLIC void ms_encoder_thread_destroy(MSEncoderThread *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
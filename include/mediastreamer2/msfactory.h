@@ -46,6 +46,10 @@ struct _MSFactory{
 	bool_t statistics_enabled;
 	bool_t voip_initd;
 	MSDevicesInfo *devices_info;
+	struct _MSWorkerPool *worker_pool;
+	struct _MSWorkerPool *dtls_worker_pool;
+	ms_mutex_t worker_pool_lock;
+	struct _MSStaticImageCache *static_image_cache;
 };
 
 typedef struct _MSFactory MSFactory;
@@ -258,6 +262,29 @@ MS2_PUBLIC unsigned int ms_factory_get_cpu_count(MSFactory *obj);
 **/
 MS2_PUBLIC void ms_factory_set_cpu_count(MSFactory *obj, unsigned int c);
 
+/**
+ * Returns the number of processors of the platform, the cpu count given to the factories when they are created.
+**/
+MS2_PUBLIC unsigned int ms_factory_detect_cpu_count(void);
+
+/**
+ * Get the worker pool shared by all the objects created by the factory.
+ * It is created on first use, with as many threads as the cpu count of the factory. It may be called from any thread.
+**/
+MS2_PUBLIC struct _MSWorkerPool * ms_factory_get_worker_pool(MSFactory *obj);
+
+/**
+ * Get the worker pool computing the DTLS handshakes of the streams created with the factory.
+ * It is created on first use, with a few threads, apart from the shared pool so that handshake bursts do not delay
+ * the processing of the filters. It may be called from any thread.
+**/
+MS2_PUBLIC struct _MSWorkerPool * ms_factory_get_dtls_worker_pool(MSFactory *obj);
+
+/**
+ * Get the cache of the pictures decoded by the static image filters, NULL if video is not enabled.
+**/
+MS2_PUBLIC struct _MSStaticImageCache * ms_factory_get_static_image_cache(MSFactory *obj);
+
 MS2_PUBLIC void ms_factory_add_platform_tag(MSFactory *obj, const char *tag);
 
 MS2_PUBLIC MSList * ms_factory_get_platform_tags(MSFactory *obj);
@@ -149,6 +149,8 @@ struct _MSFilterStats{
 	const char *name; /*<filter name*/
 	uint64_t elapsed; /*<cumulative number of nanoseconds elapsed */
 	unsigned int count; /*<number of time the filter is called for processing*/
+	uint64_t scaling_elapsed; /*<cumulative number of nanoseconds spent scaling or converting pictures*/
+	unsigned int scaling_count; /*<number of pictures scaled or converted*/
 };
 
 typedef struct _MSFilterStats MSFilterStats;
@@ -44,6 +44,22 @@ struct _MSVideoEncoderPixFmt {
 	bool_t supported;
 };
 
+typedef struct _MSVideoEncoderAsyncStats MSVideoEncoderAsyncStats;
+
+struct _MSVideoEncoderAsyncStats {
+	unsigned int encoded_frames; /*number of frames encoded by the encoder thread*/
+	unsigned int dropped_frames; /*number of frames dropped because the encoder thread could not keep up*/
+	float mean_latency; /*mean delay in milliseconds between the submission of a frame and the availability of its encoded packets*/
+	float max_latency; /*maximum of this delay, in milliseconds*/
+};
+
+typedef struct _MSVideoEncoderLayersThreads MSVideoEncoderLayersThreads;
+
+struct _MSVideoEncoderLayersThreads {
+	int nlayers; /*number of simulcast layers being encoded, including the full resolution one*/
+	int threads[3]; /*number of threads encoding each layer, from the full resolution one*/
+};
+
 /**
  * Interface definition for video display filters.
 **/
@@ -281,6 +297,19 @@ typedef enum _MSRecorderState MSRecorderState;
 	MS_FILTER_METHOD(MSFilterVideoEncoderInterface, 9, const MSVideoConfiguration *)
 #define MS_VIDEO_ENCODER_IS_HARDWARE_ACCELERATED \
 	MS_FILTER_METHOD(MSFilterVideoEncoderInterface, 10, bool_t)
+/* run the encoding in a dedicated thread instead of the ticker thread, must be called before the filter is attached to a ticker */
+#define MS_VIDEO_ENCODER_ENABLE_ASYNC \
+	MS_FILTER_METHOD(MSFilterVideoEncoderInterface, 11, bool_t)
+#define MS_VIDEO_ENCODER_GET_ASYNC_STATS \
+	MS_FILTER_METHOD(MSFilterVideoEncoderInterface, 12, MSVideoEncoderAsyncStats)
+/* let the encoder trade quality for speed, and lower its frame rate, according to the load of the ticker and its encoding time */
+#define MS_VIDEO_ENCODER_ENABLE_LOAD_ADAPTATION \
+	MS_FILTER_METHOD(MSFilterVideoEncoderInterface, 13, bool_t)
+/* number of spatial layers to encode, each one being sent on its own output, must be called before the filter is attached to a ticker */
+#define MS_VIDEO_ENCODER_SET_SIMULCAST_LAYERS \
+	MS_FILTER_METHOD(MSFilterVideoEncoderInterface, 14, int)
+#define MS_VIDEO_ENCODER_GET_LAYERS_THREADS \
+	MS_FILTER_METHOD(MSFilterVideoEncoderInterface, 15, MSVideoEncoderLayersThreads)
 
 /** Interface definitions for audio capture */
 /* Start numbering from the end for hacks */
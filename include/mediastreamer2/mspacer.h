@@ -0,0 +1,43 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#ifndef mspacer_h
+#define mspacer_h
+
+#include <mediastreamer2/msfilter.h>
+#include <ortp/rtpsession.h>
+
+/**
+ * The MSPacer filter is placed between a video encoder and the MSRtpSend. The encoders output all the packets of a frame
+ * at once, and a key frame sent in a single burst overflows the small buffers of the routers, causing the losses that
+ * request more key frames. The MSPacer spreads the packets over the ticks, at a multiple of the bitrate of the encoder
+ * given with MS_FILTER_SET_BITRATE: each tick, it outputs only the packets the link can carry in the time elapsed.
+ * The packets are never held for more than about 100ms: beyond, the pacing rate is raised to empty the queue in time.
+ * Without a bitrate, the packets go through without delay.
+ * The bytes sent meanwhile by a priority session, the audio session of the same call, are deducted from the pacing budget,
+ * so that the audio packets are never delayed by the video ones on a shared link.
+**/
+
+/** Set the pacing rate, as a multiple of the bitrate. The default is 2.5. */
+#define MS_PACER_SET_FACTOR		MS_FILTER_METHOD(MS_PACER_ID,0,float)
+/** Set the RTP session whose packets go first, or NULL. It must remain valid until it is removed or the filter destroyed. */
+#define MS_PACER_SET_PRIORITY_SESSION	MS_FILTER_METHOD(MS_PACER_ID,1,RtpSession*)
+/** Get the time in milliseconds the oldest packet queued has waited. */
+#define MS_PACER_GET_QUEUE_DELAY	MS_FILTER_METHOD(MS_PACER_ID,2,int)
+
+#endif
@@ -0,0 +1,49 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#ifndef msred_h
+#define msred_h
+
+#include <mediastreamer2/msfilter.h>
+#include <mediastreamer2/mscodecutils.h>
+
+/**
+ * The MSRedEnc and MSRedDec filters carry redundant audio data as described in RFC 2198.
+ * MSRedEnc is placed between the audio encoder and the MSRtpSend: each packet it outputs carries the encoded frame
+ * (the primary encoding) preceded by a copy of the one or two previous frames. MSRedDec is placed between the MSRtpRecv
+ * and the audio decoder: it gives the primary encoding to the decoder, and when a packet is missing at the time it should
+ * be played, looks into the jitter buffer for the next packets to give the decoder the copy they carry instead of letting it
+ * conceal the loss.
+ * The RTP session uses the "red" payload type, whose fmtp lists the payload type of the primary encoding ("111/111").
+**/
+
+/** Set the payload type of the primary encoding, written in and expected in the RED headers. */
+#define MS_RED_ENC_SET_PRIMARY_PAYLOAD_TYPE	MS_FILTER_METHOD(MS_RED_ENC_ID,0,int)
+/** Maximum number of previous frames copied in each packet. */
+#define MS_RED_ENC_MAX_DISTANCE			2
+
+/** Set the number of previous frames copied in each packet, between 0 and MS_RED_ENC_MAX_DISTANCE. The default is 1. */
+#define MS_RED_ENC_SET_DISTANCE			MS_FILTER_METHOD(MS_RED_ENC_ID,1,int)
+
+#define MS_RED_DEC_SET_PRIMARY_PAYLOAD_TYPE	MS_FILTER_METHOD(MS_RED_DEC_ID,0,int)
+/** Give the filter the access to the jitter buffer of the RTP session. Without it no frame is recovered. */
+#define MS_RED_DEC_SET_RTP_PAYLOAD_PICKER	MS_FILTER_METHOD(MS_RED_DEC_ID,1,MSRtpPayloadPickerContext)
+/** Get the number of missing frames that were replaced by their redundant copy. */
+#define MS_RED_DEC_GET_RECOVERED_FRAMES	MS_FILTER_METHOD(MS_RED_DEC_ID,2,int)
+
+#endif
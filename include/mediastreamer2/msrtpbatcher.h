@@ -0,0 +1,91 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef msrtpbatcher_h
+#define msrtpbatcher_h
+
+#include <mediastreamer2/msticker.h>
+#include <ortp/rtpsession.h>
+
+/**
+ * @file msrtpbatcher.h
+ * @brief Coalesce the RTP and RTCP packets sent during a tick into as few system calls as possible.
+ *
+ * A MSRtpSendBatcher installs itself as the endpoint of the RTP and RTCP transports of the sessions it is given.
+ * The packets sent by these sessions from the thread of the ticker are queued instead of being sent immediately,
+ * and are flushed at the end of the tick with one sendmmsg() call per socket. On platforms without sendmmsg(),
+ * they are sent one by one at the end of the tick.
+ * Packets sent from another thread (for example RTCP feedback requested by the application) are sent immediately.
+ *
+ * This is intended for servers running a large number of streams on the same ticker, for which the cost of the
+ * send system calls is significant.
+ * It can be used together with a MSRtpRecvMultiplexer on the same sessions, but a session that already has another
+ * transport endpoint (for example the one used for TURN) cannot be batched.
+**/
+
+typedef struct _MSRtpSendBatcher MSRtpSendBatcher;
+
+struct _MSRtpSendBatcherStats{
+	uint64_t packets; /**< number of packets flushed */
+	uint64_t syscalls; /**< number of send system calls made to flush them */
+	uint64_t flushes; /**< number of ticks at the end of which at least one packet was flushed */
+	uint64_t errors; /**< number of packets that could not be sent */
+	int last_flush_size; /**< number of packets flushed at the end of the last tick */
+	int max_flush_size; /**< highest number of packets flushed at the end of a tick */
+};
+
+typedef struct _MSRtpSendBatcherStats MSRtpSendBatcherStats;
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * Create a batcher flushing the packets at the end of the ticks of the given ticker.
+ * The batcher must be destroyed before the ticker.
+**/
+MS2_PUBLIC MSRtpSendBatcher *ms_rtp_send_batcher_new(MSTicker *ticker);
+
+/**
+ * Start batching the RTP and RTCP packets sent by the session.
+ * The session must be run by the ticker of the batcher, and must be removed from the batcher before being destroyed.
+ * @return 0 if successful, -1 if the session cannot be batched.
+**/
+MS2_PUBLIC int ms_rtp_send_batcher_add_session(MSRtpSendBatcher *batcher, RtpSession *session);
+
+/**
+ * Stop batching the packets of the session. The packets of the session that are still queued are sent.
+**/
+MS2_PUBLIC void ms_rtp_send_batcher_remove_session(MSRtpSendBatcher *batcher, RtpSession *session);
+
+/**
+ * Get the counters of the batcher, which can be used to evaluate the number of system calls saved.
+**/
+MS2_PUBLIC void ms_rtp_send_batcher_get_stats(MSRtpSendBatcher *batcher, MSRtpSendBatcherStats *stats);
+
+/**
+ * Remove all the sessions from the batcher and destroy it.
+**/
+MS2_PUBLIC void ms_rtp_send_batcher_destroy(MSRtpSendBatcher *batcher);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
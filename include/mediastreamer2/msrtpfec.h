@@ -0,0 +1,109 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef msrtpfec_h
+#define msrtpfec_h
+
+#include <mediastreamer2/mscommon.h>
+#include <ortp/rtpsession.h>
+
+/**
+ * @file msrtpfec.h
+ * @brief Protect the RTP packets of a session with XOR forward error correction.
+ *
+ * A MSRtpFec installs itself as a modifier of the RTP transport of a session, and works on both sides:
+ *  - the packets sent by the session are grouped, and after each group a FEC packet carrying the XOR of the packets of
+ *    the group is sent. The FEC packets use the ULPFEC format (RFC 5109) with a single protection level, and are sent
+ *    as a separate stream (RFC 5109 section 9) on the same transport, with their own SSRC, payload type and sequence
+ *    numbers.
+ *  - the FEC packets received are not given to the session: they are kept until the packets they protect arrive, and
+ *    when a single packet of a group is missing it is rebuilt with the SSRC of the media stream received and given to
+ *    the session as if it had been received.
+ *
+ * The recovery happens as the packets arrive, before the jitter buffer, so it adds no delay to the packets received
+ * normally, unlike a retransmission it does not need a round trip. The cost is the bandwidth of the FEC packets, which is
+ * set by the size of the groups: one FEC packet is sent for every group_size packets, or at the end of a video frame.
+ * The size of the groups is adapted to the loss rate reported by the remote party, either by the MSBitrateController
+ * when it is given the MSRtpFec with ms_bitrate_controller_set_fec(), or by ms_rtp_fec_process_rtcp() otherwise.
+ *
+ * The FEC packets go through the transport modifiers appended after the MSRtpFec: when it is created before SRTP is
+ * enabled on the session, which is the case of the video stream, the packets are protected before SRTP and the FEC
+ * packets are encrypted and authenticated like the media packets. It can be used together with any transport endpoint.
+**/
+
+typedef struct _MSRtpFec MSRtpFec;
+
+struct _MSRtpFecStats{
+	uint64_t packets_protected; /**< number of packets sent protected by a FEC packet */
+	uint64_t fec_packets_sent; /**< number of FEC packets sent */
+	uint64_t fec_packets_received; /**< number of FEC packets received */
+	uint64_t packets_recovered; /**< number of missing packets rebuilt from the FEC packets received */
+	uint64_t recoveries_failed; /**< number of FEC packets given up while several packets they protect were missing */
+	int group_size; /**< current number of packets protected by a FEC packet, 0 if no FEC packet is sent */
+};
+
+typedef struct _MSRtpFecStats MSRtpFecStats;
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * Create the FEC handler of a session.
+ * @param session the RTP session. It must be destroyed after the FEC handler.
+ * @param payload_type the payload type of the FEC packets, sent and received. It must not be used by the session.
+ * @return the FEC handler, or NULL if the session has no RTP transport.
+**/
+MS2_PUBLIC MSRtpFec *ms_rtp_fec_new(RtpSession *session, int payload_type);
+
+/**
+ * Set the number of packets protected by each FEC packet sent, between 2 and 16. 0 stops sending FEC packets, the
+ * FEC packets received are still used.
+**/
+MS2_PUBLIC void ms_rtp_fec_set_group_size(MSRtpFec *obj, int group_size);
+
+/**
+ * Adapt the size of the groups to the loss rate reported by the remote party: the higher the loss rate, the smaller the
+ * groups. The groups shrink at once when the losses increase, but grow back one packet per call, and no FEC packet is sent
+ * once the losses stay below 1% with the largest groups.
+ * @param loss_rate the loss rate in percent.
+**/
+MS2_PUBLIC void ms_rtp_fec_set_loss_rate(MSRtpFec *obj, float loss_rate);
+
+/**
+ * Give the FEC handler the RTCP packets received, to adapt the size of the groups to the loss rate reported by the remote
+ * party with ms_rtp_fec_set_loss_rate(). Not needed when a MSBitrateController adapts it.
+**/
+MS2_PUBLIC void ms_rtp_fec_process_rtcp(MSRtpFec *obj, mblk_t *rtcp);
+
+/**
+ * Get the counters of the FEC handler.
+**/
+MS2_PUBLIC void ms_rtp_fec_get_stats(MSRtpFec *obj, MSRtpFecStats *stats);
+
+/**
+ * Uninstall the FEC handler from its session and destroy it.
+**/
+MS2_PUBLIC void ms_rtp_fec_destroy(MSRtpFec *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
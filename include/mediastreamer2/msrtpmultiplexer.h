@@ -0,0 +1,96 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef msrtpmultiplexer_h
+#define msrtpmultiplexer_h
+
+#include <mediastreamer2/msticker.h>
+#include <ortp/rtpsession.h>
+
+/**
+ * @file msrtpmultiplexer.h
+ * @brief Read the packets of all the sessions of a ticker with a few system calls.
+ *
+ * A MSRtpRecvMultiplexer watches the RTP and RTCP sockets of the sessions it is given with a single epoll set.
+ * Once per tick, the sockets that are ready are drained with recvmmsg(), and the packets are handed over to the
+ * sessions when they read. The MSRtpRecv of a session that received nothing skips its processing, so that the cost
+ * of the reception depends on the traffic rather than on the number of sessions.
+ *
+ * It is available on Linux only. It can be used together with a MSRtpSendBatcher on the same sessions, but not
+ * with another transport endpoint (for example the one used for TURN).
+**/
+
+typedef struct _MSRtpRecvMultiplexer MSRtpRecvMultiplexer;
+
+struct _MSRtpRecvMultiplexerStats{
+	uint64_t packets; /**< number of packets read */
+	uint64_t syscalls; /**< number of epoll_wait() and recvmmsg() calls made to read them */
+	uint64_t polls; /**< number of ticks during which the sockets were polled */
+	int last_poll_size; /**< number of packets read during the last tick */
+	int max_poll_size; /**< highest number of packets read during a tick */
+};
+
+typedef struct _MSRtpRecvMultiplexerStats MSRtpRecvMultiplexerStats;
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * Create a multiplexer reading the sockets of the sessions run by the given ticker.
+ * The multiplexer must be destroyed before the ticker.
+ * @return the multiplexer, or NULL if it is not supported on this platform.
+**/
+MS2_PUBLIC MSRtpRecvMultiplexer *ms_rtp_recv_multiplexer_new(MSTicker *ticker);
+
+/**
+ * Start reading the RTP and RTCP sockets of the session through the multiplexer.
+ * The session must be read by a MSRtpRecv run by the ticker of the multiplexer, and must be removed from the
+ * multiplexer before being destroyed.
+ * @return 0 if successful, -1 if the session cannot be multiplexed.
+**/
+MS2_PUBLIC int ms_rtp_recv_multiplexer_add_session(MSRtpRecvMultiplexer *obj, RtpSession *session);
+
+/**
+ * Stop reading the sockets of the session through the multiplexer. The packets already read and not yet handed over
+ * to the session are dropped.
+**/
+MS2_PUBLIC void ms_rtp_recv_multiplexer_remove_session(MSRtpRecvMultiplexer *obj, RtpSession *session);
+
+/**
+ * Get the counters of the multiplexer.
+**/
+MS2_PUBLIC void ms_rtp_recv_multiplexer_get_stats(MSRtpRecvMultiplexer *obj, MSRtpRecvMultiplexerStats *stats);
+
+/**
+ * Remove all the sessions from the multiplexer and destroy it.
+**/
+MS2_PUBLIC void ms_rtp_recv_multiplexer_destroy(MSRtpRecvMultiplexer *obj);
+
+/**
+ * Tell whether the receiving of the session can be skipped during the current tick, because the session is read
+ * through a multiplexer and nothing is waiting to be processed. This is used by the MSRtpRecv filter.
+**/
+MS2_PUBLIC bool_t ms_rtp_recv_multiplexer_session_idle(RtpSession *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef msrtpretransmission_h
+#define msrtpretransmission_h
+
+#include <mediastreamer2/mscommon.h>
+#include <ortp/rtpsession.h>
+
+/**
+ * @file msrtpretransmission.h
+ * @brief Recover lost RTP packets with generic NACK feedback (RFC 4585) and retransmissions.
+ *
+ * A MSRtpRetransmission installs itself as the endpoint of the RTP transport of a session, and works on both sides:
+ *  - the packets sent by the session are kept in a ring buffer indexed by their sequence number. When a generic NACK is
+ *    received from the remote party, the requested packets still in the buffer are sent again, as they were sent the first time.
+ *  - the sequence numbers of the packets received by the session are tracked as they arrive, before they enter the jitter buffer.
+ *    When a gap is detected, a generic NACK listing the missing packets is sent, and repeated a few times if they do not arrive.
+ *
+ * Retransmitting a few packets costs far less than the key frame that would otherwise be requested to recover from the loss.
+ * The remote party must support generic NACK, which is negotiated in SDP with "a=rtcp-fb:* nack".
+ * The retransmitted packets reuse the SSRC and sequence number of the original ones: the RTX payload format (RFC 4588) requires
+ * a separate RTX stream that is not negotiated by the applications using mediastreamer2.
+ * It can be used together with a MSRtpSendBatcher, a MSRtpRecvMultiplexer or a MSRtpSharedPort on the same session, but not
+ * with another transport endpoint (for example the one used for TURN).
+**/
+
+typedef struct _MSRtpRetransmission MSRtpRetransmission;
+
+struct _MSRtpRetransmissionStats{
+	uint64_t nacks_sent; /**< number of generic NACK messages sent */
+	uint64_t packets_requested; /**< number of packets requested in the NACK messages sent, including the repeated requests */
+	uint64_t packets_recovered; /**< number of missing packets received after having been requested */
+	uint64_t packets_abandoned; /**< number of missing packets no longer requested because they were too old or requested too many times */
+	uint64_t nacks_received; /**< number of generic NACK messages received */
+	uint64_t packets_retransmitted; /**< number of packets sent again in answer to the NACK messages received */
+	uint64_t packets_unavailable; /**< number of packets requested by the remote party that were no longer in the ring buffer */
+};
+
+typedef struct _MSRtpRetransmissionStats MSRtpRetransmissionStats;
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * Create the retransmission handler of a session.
+ * @param session the RTP session, which must use AVPF. It must be destroyed after the retransmission handler.
+ * @param cache_size the number of sent packets kept for retransmission, rounded up to a power of two.
+ * @return the retransmission handler, or NULL if the session already has another transport endpoint.
+**/
+MS2_PUBLIC MSRtpRetransmission *ms_rtp_retransmission_new(RtpSession *session, int cache_size);
+
+/**
+ * Give a RTCP packet received by the session to the retransmission handler. The generic NACK messages addressed to the session
+ * are answered, the others are ignored.
+ * @return TRUE if the packet was a generic NACK addressed to the session.
+**/
+MS2_PUBLIC bool_t ms_rtp_retransmission_process_rtcp(MSRtpRetransmission *obj, const mblk_t *rtcp);
+
+/**
+ * Get the counters of the retransmission handler.
+**/
+MS2_PUBLIC void ms_rtp_retransmission_get_stats(MSRtpRetransmission *obj, MSRtpRetransmissionStats *stats);
+
+/**
+ * Uninstall the retransmission handler from its session and destroy it.
+**/
+MS2_PUBLIC void ms_rtp_retransmission_destroy(MSRtpRetransmission *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
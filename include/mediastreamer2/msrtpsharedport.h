@@ -0,0 +1,114 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef msrtpsharedport_h
+#define msrtpsharedport_h
+
+#include <mediastreamer2/msticker.h>
+#include <ortp/rtpsession.h>
+
+/**
+ * @file msrtpsharedport.h
+ * @brief Receive the RTP and RTCP packets of many sessions on a single UDP port.
+ *
+ * A MSRtpSharedPort owns one UDP socket, which is used by all the sessions it is given instead of two sockets per
+ * session. Once per tick, the packets received on the socket are read and demultiplexed to the sessions:
+ *  - by the address they come from, which is learnt from the destinations the sessions send to,
+ *  - or by their SSRC, which is learnt from the packets coming from a known address, or declared with
+ *  ms_rtp_shared_port_add_remote_ssrc().
+ *
+ * RTCP packets are recognized by their payload type (RFC 5761) and handed over to the RTCP side of the session,
+ * unless the session uses rtcp-mux. When several sessions send to the same remote address (BUNDLE), their packets
+ * are demultiplexed by SSRC only, so the remote SSRCs should be declared. The packets that are not RTP nor RTCP
+ * (STUN, DTLS) go to the first of these sessions.
+ *
+ * The destinations are only learnt from the packets sent by the ticker thread. When a session first sends to an address
+ * from another thread, for instance during a DTLS handshake run by a worker pool, the address is not learnt: the remote
+ * address of the session should then be set before it is added to the shared port, or its remote SSRCs declared.
+ *
+ * As the RTCP packets are sent from the same port as the RTP packets, the port shall be announced as the RTCP port
+ * too (or rtcp-mux shall be used).
+ * The sessions must be read by MSRtpRecv filters run by the ticker of the shared port. A session that is not read keeps
+ * only its last 256 packets.
+**/
+
+typedef struct _MSRtpSharedPort MSRtpSharedPort;
+
+struct _MSRtpSharedPortStats{
+	uint64_t packets; /**< number of packets read */
+	uint64_t syscalls; /**< number of receive system calls made to read them */
+	uint64_t discarded; /**< number of packets that did not belong to any session */
+	uint64_t dropped; /**< number of packets dropped because their session did not read them, the oldest first */
+};
+
+typedef struct _MSRtpSharedPortStats MSRtpSharedPortStats;
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * Create a shared port bound to the given local address and port, read by the given ticker.
+ * The shared port must be destroyed before the ticker.
+ * @param ticker the ticker running the sessions
+ * @param local_ip the local address to bind
+ * @param port the local port to bind, or 0 to choose a random one
+ * @return the shared port, or NULL if the socket cannot be bound.
+**/
+MS2_PUBLIC MSRtpSharedPort *ms_rtp_shared_port_new(MSTicker *ticker, const char *local_ip, int port);
+
+/**
+ * Get the local port of the shared port.
+**/
+MS2_PUBLIC int ms_rtp_shared_port_get_local_port(const MSRtpSharedPort *obj);
+
+/**
+ * Make the session send and receive through the shared port.
+ * The session must not have bound sockets by itself, and must be removed from the shared port before being destroyed.
+ * It cannot be used together with a MSRtpRecvMultiplexer, but can be used with a MSRtpSendBatcher.
+ * @return 0 if successful, -1 if the session cannot use the shared port.
+**/
+MS2_PUBLIC int ms_rtp_shared_port_add_session(MSRtpSharedPort *obj, RtpSession *session);
+
+/**
+ * Declare a SSRC used by the remote party of the session, so that its packets are handed over to the session whatever
+ * the address they come from.
+**/
+MS2_PUBLIC void ms_rtp_shared_port_add_remote_ssrc(MSRtpSharedPort *obj, RtpSession *session, uint32_t ssrc);
+
+/**
+ * Stop using the shared port for the session. The session has no socket anymore and can only be destroyed.
+**/
+MS2_PUBLIC void ms_rtp_shared_port_remove_session(MSRtpSharedPort *obj, RtpSession *session);
+
+/**
+ * Get the counters of the shared port.
+**/
+MS2_PUBLIC void ms_rtp_shared_port_get_stats(MSRtpSharedPort *obj, MSRtpSharedPortStats *stats);
+
+/**
+ * Remove all the sessions from the shared port, close its socket and destroy it.
+**/
+MS2_PUBLIC void ms_rtp_shared_port_destroy(MSRtpSharedPort *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -76,6 +76,7 @@ struct _MSTicker
 	ms_cond_t cond;
 	MSList *execution_list;     /* the list of source filters to be executed.*/
 	MSList *task_list; /* list of tasks (see ms_filter_postpone_task())*/
+	MSList *tick_end_callbacks; /* callbacks run once all graphs have been processed (see ms_ticker_add_tick_end_callback())*/
 	ms_thread_t thread;   /* the thread ressource*/
 	int interval; /* in miliseconds*/
 	int exec_id;
@@ -100,6 +101,12 @@ struct _MSTicker
  */
 typedef struct _MSTicker MSTicker;
 
+/**
+ * Function called by the ticker thread at the end of every tick.
+ * @var MSTickerCallback
+ */
+typedef void (*MSTickerCallback)(MSTicker *ticker, void *user_data);
+
 
 struct _MSTickerParams{
 	MSTickerPrio prio;
@@ -220,6 +227,27 @@ MS2_PUBLIC void ms_ticker_set_time_func(MSTicker *ticker, MSTickerTimeFunc func,
  */
 MS2_PUBLIC void ms_ticker_set_tick_func(MSTicker *ticker, MSTickerTickFunc func, void *user_data);
 
+/**
+ * Register a function to be called by the ticker thread at the end of every tick, once all the graphs have been processed.
+ * It is typically used to flush what the filters have accumulated during the tick.
+ * The callbacks are called with the ticker lock held: they must not attach or detach filters, nor add or remove callbacks.
+ *
+ * @param ticker  A #MSTicker object.
+ * @param func    The function to call.
+ * @param user_data Any pointer to user private data, passed to func.
+ */
+MS2_PUBLIC void ms_ticker_add_tick_end_callback(MSTicker *ticker, MSTickerCallback func, void *user_data);
+
+/**
+ * Unregister a function previously registered with ms_ticker_add_tick_end_callback().
+ * When this function returns, the callback is guaranteed not to be running anymore.
+ *
+ * @param ticker  A #MSTicker object.
+ * @param func    The function given to ms_ticker_add_tick_end_callback().
+ * @param user_data The user data given to ms_ticker_add_tick_end_callback().
+ */
+MS2_PUBLIC void ms_ticker_remove_tick_end_callback(MSTicker *ticker, MSTickerCallback func, void *user_data);
+
 /**
  * Print on stdout all filters of a ticker. (INTERNAL: DO NOT USE)
  *
@@ -45,12 +45,25 @@ struct _MSToneDetectorEvent{
 
 typedef struct _MSToneDetectorEvent MSToneDetectorEvent;
 
+/**
+ * Structure carried as argument of MS_TONE_DETECTOR_GET_ENERGIES.
+**/
+struct _MSToneDetectorEnergies{
+	float *energies;	/**<Array filled with the relative energy of each scan, in the order they were added*/
+	int count;	/**<Size of the energies array as input, number of energies written as output*/
+};
+
+typedef struct _MSToneDetectorEnergies MSToneDetectorEnergies;
+
 /** Method to as the tone detector filter to monitor a new tone type.*/
 #define MS_TONE_DETECTOR_ADD_SCAN	MS_FILTER_METHOD(MS_TONE_DETECTOR_ID,0,MSToneDetectorDef)
 
 /** Remove previously added scans*/
 #define MS_TONE_DETECTOR_CLEAR_SCANS	MS_FILTER_METHOD_NO_ARG(MS_TONE_DETECTOR_ID,1)
 
+/** Get the energy of every scanned tone over the last analyzed frame, relative to the energy of the frame. */
+#define MS_TONE_DETECTOR_GET_ENERGIES	MS_FILTER_METHOD(MS_TONE_DETECTOR_ID,2,MSToneDetectorEnergies)
+
 /** Event generated when a tone is detected */
 #define MS_TONE_DETECTOR_EVENT		MS_FILTER_EVENT(MS_TONE_DETECTOR_ID,0,MSToneDetectorEvent)
 
@@ -32,6 +32,7 @@ typedef void (*MSAudioDiffProgressNotify)(void* user_data, int percentage);
 typedef struct _MSAudioDiffParams{
 	int max_shift_percent; /*percentage of overlap between the two signals, used to restrict the cross correlation around t=0 in range [1 ; 100].*/
 	int chunk_size_ms; /*chunk size in milliseconds, if chunked cross correlation is to be used. Use 0 otherwise.*/
+	int max_threads; /*maximum number of threads used to process chunks in parallel. Use 0 to run one thread per processor.*/
 }MSAudioDiffParams;
 
 
@@ -41,7 +42,7 @@ typedef struct _MSAudioDiffParams{
  * @param matched_file path to a wav file contaning the audio segment where the reference file is to be matched.
  * @param ret the similarity factor, set in return
  * @param max_shift_percent percentage of overlap between the two signals, used to restrict the cross correlation around t=0 in range [1 ; 100].
- * @param func a callback called to show progress of the operation
+ * @param func a callback called to show progress of the operation. With chunked cross correlation, it may be invoked from a worker thread.
  * @param user_data a user data passed to the callback when invoked.
  * @return -1 on error, 0 if succesful.
 **/
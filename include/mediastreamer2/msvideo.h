@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define msvideo_h
 
 #include <mediastreamer2/msfilter.h>
+#include <mediastreamer2/msworkerpool.h>
 
 
 #if defined(__arm__) || defined(__arm64__) || defined(_M_ARM)
@@ -229,7 +230,9 @@ typedef enum{
 	MS_YUY2,   /* -> same as MS_YUYV */
 	MS_RGBA32,
 	MS_RGB565,
-	MS_H264
+	MS_H264,
+	MS_NV12, /* Y plane followed by an interleaved UV plane */
+	MS_NV21 /* Y plane followed by an interleaved VU plane */
 }MSPixFmt;
 
 typedef struct _MSPicture{
@@ -360,10 +363,44 @@ MS2_PUBLIC MSScalerContext *ms_scaler_create_context(int src_w, int src_h, MSPix
 
 MS2_PUBLIC int ms_scaler_process(MSScalerContext *ctx, uint8_t *src[], int src_strides[], uint8_t *dst[], int dst_strides[]);
 
+/**
+ * Same as ms_scaler_process(), also accounting the time spent in the statistics of the filter, when they are enabled.
+**/
+MS2_PUBLIC int ms_scaler_process_in_filter(MSFilter *f, MSScalerContext *ctx, uint8_t *src[], int src_strides[], uint8_t *dst[], int dst_strides[]);
+
+/**
+ * Allow the scaler context to split pictures into horizontal slices, processed in parallel by the threads of a worker pool
+ * and by the thread calling ms_scaler_process().
+ * Slicing is only used for pictures of 1280x720 and more, when both source and destination heights can be divided evenly.
+ * Since each slice is scaled on its own, the rows at the boundaries between slices may slightly differ from a scaling in one piece.
+ * @param ctx the scaler context
+ * @param pool the worker pool running the slices, typically the one returned by ms_factory_get_worker_pool(). NULL disables slicing.
+**/
+MS2_PUBLIC void ms_scaler_context_enable_slicing(MSScalerContext *ctx, MSWorkerPool *pool);
+
 MS2_PUBLIC void ms_scaler_context_free(MSScalerContext *ctx);
 
 MS2_PUBLIC void ms_video_set_scaler_impl(MSScalerDesc *desc);
 
+/**
+ * Returns the scaler implementation set with ms_video_set_scaler_impl(), or NULL if none was set yet.
+**/
+MS2_PUBLIC MSScalerDesc * ms_video_get_scaler_impl(void);
+
+/**
+ * Returns the scaler implementation optimized for x86 processors (SSE2 and AVX2), or NULL if not available on this platform.
+ * It is used by default only when mediastreamer2 is built without ffmpeg: applications opt in with ms_video_set_scaler_impl().
+ * Its 2-tap bilinear filter aliases on large downscales, for which swscale gives better pictures.
+ * It handles YUV420P, NV12 and NV21 inputs, and YUV420P, NV12, NV21, RGB24, RGBA32 and RGB565 outputs;
+ * other conversions are delegated to ffmpeg's swscale when it is available.
+**/
+MS2_PUBLIC MSScalerDesc * ms_video_get_x86_scaler_impl(void);
+
+/**
+ * Returns the scaler implementation based on ffmpeg's swscale, or NULL if mediastreamer2 is built without ffmpeg.
+**/
+MS2_PUBLIC MSScalerDesc * ms_video_get_ffmpeg_scaler_impl(void);
+
 MS2_PUBLIC mblk_t *copy_ycbcrbiplanar_to_true_yuv_with_rotation(MSYuvBufAllocator *allocator, const uint8_t* y, const uint8_t* cbcr, int rotation, int w, int h, int y_byte_per_row,int cbcr_byte_per_row, bool_t uFirstvSecond);
 
 /*** Encoder Helpers ***/
@@ -0,0 +1,43 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#ifndef msvideomixer_h
+#define msvideomixer_h
+
+#include <mediastreamer2/msfilter.h>
+
+/**
+ * The MSVideoMixer filter composes the YUV420P pictures of its connected inputs into a single picture, output at the
+ * frame rate set with MS_FILTER_SET_FPS and of the size set with MS_FILTER_SET_VIDEO_SIZE.
+ * Each input gets a slot of the layout, in which its pictures are scaled keeping their aspect ratio.
+ * Only the slots of the inputs that received a new picture are composed again.
+ */
+
+#define MS_VIDEO_MIXER_MAX_INPUTS 9
+
+typedef enum _MSVideoMixerLayout {
+	MSVideoMixerLayoutGrid, /**< all the inputs get slots of the same size */
+	MSVideoMixerLayoutActiveSpeaker /**< the active speaker gets most of the picture, the others are shown as thumbnails below it */
+} MSVideoMixerLayout;
+
+#define MS_VIDEO_MIXER_SET_LAYOUT		MS_FILTER_METHOD(MS_VIDEO_MIXER_ID,0,MSVideoMixerLayout)
+
+/** Set the input shown in the main slot of the active speaker layout, 0 by default. */
+#define MS_VIDEO_MIXER_SET_ACTIVE_SPEAKER	MS_FILTER_METHOD(MS_VIDEO_MIXER_ID,1,int)
+
+#endif
@@ -0,0 +1,55 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#ifndef msvideoswitcher_h
+#define msvideoswitcher_h
+
+#include <mediastreamer2/msfilter.h>
+
+/**
+ * The MSVideoSwitcher filter forwards encoded video between the participants of a conference without transcoding.
+ * Input i receives the RTP payloads output by the MSRtpRecv of participant i, output i feeds the MSRtpSend of the same
+ * participant.
+ * Every output forwards the stream of the participant having the focus, except the output of this participant, which
+ * forwards the stream of the participant that had the focus before.
+ * When the forwarded participant changes, the output keeps forwarding the previous one until a key frame arrives from
+ * the new one, and the RTP timestamps are rewritten so that they stay continuous. The sequence numbers and SSRC are
+ * those of the RtpSession of the MSRtpSend.
+ * The encoding of the payloads (VP8 or H264) must be set with MS_FILTER_SET_INPUT_FMT, for the key frames to be found.
+ */
+
+#define MS_VIDEO_SWITCHER_MAX_INPUTS 20
+
+/** Give the focus to the participant of the given pin. */
+#define MS_VIDEO_SWITCHER_SET_FOCUS		MS_FILTER_METHOD(MS_VIDEO_SWITCHER_ID,0,int)
+
+/** Notify that the participant of the given pin requested a key frame with a PLI. */
+#define MS_VIDEO_SWITCHER_NOTIFY_PLI		MS_FILTER_METHOD(MS_VIDEO_SWITCHER_ID,1,int)
+
+/** Notify that the participant of the given pin requested a key frame with a FIR. */
+#define MS_VIDEO_SWITCHER_NOTIFY_FIR		MS_FILTER_METHOD(MS_VIDEO_SWITCHER_ID,2,int)
+
+/**
+ * Emitted to request a key frame from the participant of the given pin. The requests of all the participants
+ * receiving its stream are combined, and sent at most once per second.
+ */
+#define MS_VIDEO_SWITCHER_SEND_FIR		MS_FILTER_EVENT(MS_VIDEO_SWITCHER_ID,0,int)
+
+#define MS_VIDEO_SWITCHER_SEND_PLI		MS_FILTER_EVENT(MS_VIDEO_SWITCHER_ID,1,int)
+
+#endif
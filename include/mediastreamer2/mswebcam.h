@@ -246,6 +246,45 @@ MS2_PUBLIC const char *ms_web_cam_get_string_id(MSWebCam *obj);
 MS2_PUBLIC void ms_static_image_set_default_image(const char *path);
 MS2_PUBLIC const char *ms_static_image_get_default_image(void);
 
+/**
+ * Cache of the pictures decoded by the static image filters, shared by all the filters of a factory.
+ * It is created with the factory (see ms_factory_get_static_image_cache()).
+ */
+typedef struct _MSStaticImageCache MSStaticImageCache;
+
+typedef struct _MSStaticImageCacheStats {
+	unsigned int hits; /*pictures served from the cache*/
+	unsigned int misses; /*pictures that had to be decoded*/
+	unsigned int evictions; /*pictures removed from the cache to respect the memory limit*/
+	unsigned int entries; /*pictures in the cache*/
+	size_t memory; /*memory used by the pictures in the cache, in bytes*/
+} MSStaticImageCacheStats;
+
+MS2_PUBLIC MSStaticImageCache *ms_static_image_cache_new(void);
+
+MS2_PUBLIC void ms_static_image_cache_destroy(MSStaticImageCache *cache);
+
+/**
+ * Get a picture decoded from a jpeg file and scaled to a size, decoding it if it is not in the cache.
+ * @param cache the cache
+ * @param path the jpeg file
+ * @param vsize the requested size, set to the size of the picture, which can be different on some platforms.
+ * @return a copy of the picture, to be freed with freemsg(), or NULL if the file could not be decoded.
+ */
+MS2_PUBLIC mblk_t *ms_static_image_cache_get(MSStaticImageCache *cache, const char *path, MSVideoSize *vsize);
+
+/**
+ * Set the memory that the pictures in the cache can use, in bytes. It is 16MB by default.
+ */
+MS2_PUBLIC void ms_static_image_cache_set_max_memory(MSStaticImageCache *cache, size_t max_memory);
+
+MS2_PUBLIC void ms_static_image_cache_get_stats(MSStaticImageCache *cache, MSStaticImageCacheStats *stats);
+
+/**
+ * Remove all the pictures from the cache, for instance after a file was changed.
+ */
+MS2_PUBLIC void ms_static_image_cache_flush(MSStaticImageCache *cache);
+
 /** method for the "nowebcam" filter */
 #define MS_STATIC_IMAGE_SET_IMAGE \
 	MS_FILTER_METHOD(MS_STATIC_IMAGE_ID,0,const char)
@@ -0,0 +1,82 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef msworkerpool_h
+#define msworkerpool_h
+
+#include <mediastreamer2/mscommon.h>
+
+/**
+ * @file msworkerpool.h
+ * @brief A fixed set of threads running jobs out of the MSTicker threads.
+ *
+ * A MSWorkerPool is used to run CPU intensive processing (scaling of large pictures, offline audio comparison,
+ * cryptographic handshakes...) in parallel or asynchronously, so that the calling thread is not stalled.
+**/
+
+typedef struct _MSWorkerPool MSWorkerPool;
+
+/**
+ * Function executed by a worker thread.
+**/
+typedef void (*MSWorkerFunc)(void *data);
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * Create a worker pool.
+ * @param nthreads the number of threads of the pool. With 0 threads, all jobs are run synchronously by the caller.
+**/
+MS2_PUBLIC MSWorkerPool *ms_worker_pool_new(int nthreads);
+
+/**
+ * Returns the number of threads of the pool.
+**/
+MS2_PUBLIC int ms_worker_pool_get_thread_count(const MSWorkerPool *pool);
+
+/**
+ * Queue a job to be run by one of the threads of the pool, and return immediately.
+ * The caller is responsible for keeping data valid until the job has run.
+**/
+MS2_PUBLIC void ms_worker_pool_post(MSWorkerPool *pool, MSWorkerFunc func, void *data);
+
+/**
+ * Run func on every element of the data array, in parallel on the threads of the pool.
+ * The calling thread takes part in the processing, and the function returns once all the jobs are done.
+ * It does not wait for the jobs posted before to the pool: if all the threads are busy, the calling thread runs all the jobs itself.
+ * It must not be called from a job running on the same pool.
+ * @param pool the worker pool
+ * @param func the function to apply
+ * @param data an array of count pointers, each of them passed to one call of func
+ * @param count the number of elements in data
+**/
+MS2_PUBLIC void ms_worker_pool_run(MSWorkerPool *pool, MSWorkerFunc func, void **data, int count);
+
+/**
+ * Destroy the pool. Jobs already queued are run before the threads exit.
+**/
+MS2_PUBLIC void ms_worker_pool_destroy(MSWorkerPool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -27,7 +27,10 @@
 
 #cmakedefine HAVE_SYS_SHM_H 1
 #cmakedefine HAVE_ALLOCA_H 1
+#cmakedefine HAVE_SYS_EPOLL_H 1
 #cmakedefine HAVE_DLOPEN 1
+#cmakedefine HAVE_SENDMMSG 1
+#cmakedefine HAVE_RECVMMSG 1
 
 #cmakedefine WORDS_BIGENDIAN
 
@@ -35,6 +38,7 @@
 #define HAVE_NON_FREE_CODECS ${HAVE_NON_FREE_CODECS}
 
 #cmakedefine HAVE_SRTP
+#cmakedefine HAVE_SRTP_GCM
 #cmakedefine HAVE_ZRTP
 #cmakedefine HAVE_DTLS
 
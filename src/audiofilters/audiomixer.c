@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/msaudiomixer.h"
 #include "mediastreamer2/msticker.h"
+#include "mediastreamer2/flowcontrol.h"
 
 #ifdef _MSC_VER
 #include <malloc.h>
@@ -52,6 +53,7 @@ static void apply_gain(int16_t *samples, int nsamples, float gain){
 
 typedef struct Channel{
 	MSBufferizer bufferizer;
+	MSAudioTimeStretcher *stretcher; /*when not NULL, replaces the flow control by dropping*/
 	int16_t *input;	/*the channel contribution, for removal at output*/
 	float gain;
 	int min_fullness;
@@ -75,9 +77,20 @@ static void channel_prepare(Channel *chan, int bytes_per_tick){
 	chan->last_activity=(uint64_t)-1;
 }
 
-static int channel_process_in(Channel *chan, MSQueue *q, int32_t *sum, int nsamples){
+static void channel_enable_time_stretching(Channel *chan, int rate, int nchannels, int target_ms){
+	chan->stretcher=ms_audio_time_stretcher_new(rate,nchannels);
+	ms_audio_time_stretcher_set_target(chan->stretcher,target_ms);
+}
+
+static int channel_read(Channel *chan, int nsamples, int nchannels){
+	if (chan->stretcher)
+		return ms_audio_time_stretcher_read(chan->stretcher,&chan->bufferizer,chan->input,nsamples/nchannels);
+	return ms_bufferizer_read(&chan->bufferizer,(uint8_t*)chan->input,nsamples*2)!=0;
+}
+
+static int channel_process_in(Channel *chan, MSQueue *q, int32_t *sum, int nsamples, int nchannels){
 	ms_bufferizer_put_from_queue(&chan->bufferizer,q);
-	if (ms_bufferizer_read(&chan->bufferizer,(uint8_t*)chan->input,nsamples*2)!=0){
+	if (channel_read(chan,nsamples,nchannels)){
 		if (chan->active){
 			if (chan->gain!=1.0){
 				apply_gain(chan->input,nsamples,chan->gain);
@@ -132,6 +145,12 @@ static mblk_t *channel_process_out(Channel *chan, int32_t *sum, int nsamples){
 static void channel_unprepare(Channel *chan){
 	ms_free(chan->input);
 	chan->input=NULL;
+	if (chan->stretcher){
+		ms_message("MSAudioMixer: channel time stretching corrected %i samples",
+			(int)ms_audio_time_stretcher_get_correction(chan->stretcher));
+		ms_audio_time_stretcher_destroy(chan->stretcher);
+		chan->stretcher=NULL;
+	}
 }
 
 static void channel_uninit(Channel *chan){
@@ -147,6 +166,7 @@ typedef struct MixerState{
 	int conf_mode;
 	int skip_threshold;
 	int master_channel;
+	int target_buffer_delay;
 	bool_t bypass_mode;
 	bool_t single_output;
 } MixerState;
@@ -190,8 +210,11 @@ static void mixer_preprocess(MSFilter *f){
 
 	s->bytespertick=(2*s->nchannels*s->rate*f->ticker->interval)/1000;
 	s->sum=(int32_t*)ms_malloc0((s->bytespertick/2)*sizeof(int32_t));
-	for(i=0;i<MIXER_MAX_CHANNELS;++i)
+	for(i=0;i<MIXER_MAX_CHANNELS;++i){
 		channel_prepare(&s->channels[i],s->bytespertick);
+		if (s->target_buffer_delay>0 && i!=s->master_channel)
+			channel_enable_time_stretching(&s->channels[i],s->rate,s->nchannels,s->target_buffer_delay);
+	}
 	/*ms_message("bytespertick=%i, purgeoffset=%i",s->bytespertick,s->purgeoffset);*/
 	s->skip_threshold=s->bytespertick*2;
 	s->bypass_mode=FALSE;
@@ -306,9 +329,9 @@ static void mixer_process(MSFilter *f){
 		MSQueue *q=f->inputs[i];
 
 		if (q){
-			if (channel_process_in(&s->channels[i],q,s->sum,nwords))
+			if (channel_process_in(&s->channels[i],q,s->sum,nwords,s->nchannels))
 				got_something=TRUE;
-			if ((skip=channel_flow_control(&s->channels[i],s->skip_threshold,f->ticker->time))>0){
+			if (s->channels[i].stretcher==NULL && (skip=channel_flow_control(&s->channels[i],s->skip_threshold,f->ticker->time))>0){
 				ms_warning("Too much data in channel %i, %i ms in excess dropped",i,(skip*1000)/(2*s->nchannels*s->rate));
 			}
 		}
@@ -420,6 +443,12 @@ static int mixer_set_master_channel(MSFilter *f, void *data){
 	return 0;
 }
 
+static int mixer_set_target_buffer_delay(MSFilter *f, void *data){
+	MixerState *s=(MixerState *)f->data;
+	s->target_buffer_delay=*(int*)data;
+	return 0;
+}
+
 static MSFilterMethod methods[]={
 	{	MS_FILTER_SET_NCHANNELS , mixer_set_nchannels },
 	{	MS_FILTER_GET_NCHANNELS , mixer_get_nchannels },
@@ -430,6 +459,7 @@ static MSFilterMethod methods[]={
 	{	MS_AUDIO_MIXER_ENABLE_CONFERENCE_MODE, mixer_set_conference_mode	},
 	{	MS_AUDIO_MIXER_SET_MASTER_CHANNEL , mixer_set_master_channel },
 	{	MS_AUDIO_MIXER_ENABLE_OUTPUT,	mixer_enable_output },
+	{	MS_AUDIO_MIXER_SET_TARGET_BUFFER_DELAY,	mixer_set_target_buffer_delay },
 	{0,NULL}
 };
 
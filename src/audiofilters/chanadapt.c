@@ -19,50 +19,94 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/msfilter.h"
 #include "mediastreamer2/mschanadapter.h"
+#include "pcmformat.h"
 
 /*
  This filter transforms stereo buffers to mono and vice versa.
+ When its second input is connected, a mono to stereo adapter takes the left channel from the first input
+ and the right channel from the second one.
 */
 
+/*largest number of samples interleaved at once, 20 ms at 48 kHz*/
+#define ADAPTER_MAX_CHUNK 960
+/*when one input of the interleaving stops, the audio of the other one is not kept beyond this amount*/
+#define ADAPTER_MAX_BUFFERED (8*ADAPTER_MAX_CHUNK)
+
 typedef struct AdapterState{
 	int inputchans;
 	int outputchans;
+	MSBufferizer *inputs[2];
 }AdapterState;
 
 static void adapter_init(MSFilter *f){
 	AdapterState *s=ms_new0(AdapterState,1);
 	s->inputchans=1;
 	s->outputchans=1;
+	s->inputs[0]=ms_bufferizer_new();
+	s->inputs[1]=ms_bufferizer_new();
 	f->data=s;
 }
 
 static void adapter_uninit(MSFilter *f){
-	ms_free(f->data);
+	AdapterState *s=(AdapterState*)f->data;
+	ms_bufferizer_destroy(s->inputs[0]);
+	ms_bufferizer_destroy(s->inputs[1]);
+	ms_free(s);
+}
+
+static void adapter_interleave(MSFilter *f, AdapterState *s){
+	int16_t left[ADAPTER_MAX_CHUNK];
+	int16_t right[ADAPTER_MAX_CHUNK];
+	mblk_t *om;
+	int nsamples;
+	int i;
+
+	ms_bufferizer_put_from_queue(s->inputs[0],f->inputs[0]);
+	ms_bufferizer_put_from_queue(s->inputs[1],f->inputs[1]);
+	while((nsamples=(int)MIN(ms_bufferizer_get_avail(s->inputs[0]),ms_bufferizer_get_avail(s->inputs[1]))/2)>0){
+		nsamples=MIN(nsamples,ADAPTER_MAX_CHUNK);
+		ms_bufferizer_read(s->inputs[0],(uint8_t*)left,nsamples*2);
+		ms_bufferizer_read(s->inputs[1],(uint8_t*)right,nsamples*2);
+		om=allocb(nsamples*4,0);
+		ms_pcm_interleave_stereo(left,right,(int16_t*)om->b_wptr,nsamples);
+		om->b_wptr+=nsamples*4;
+		ms_queue_put(f->outputs[0],om);
+	}
+	for(i=0;i<2;++i){
+		if (ms_bufferizer_get_avail(s->inputs[i])>ADAPTER_MAX_BUFFERED*2){
+			ms_warning("MSChannelAdapter: no audio on input %i, discarding the audio of input %i",1-i,i);
+			ms_bufferizer_flush(s->inputs[i]);
+		}
+	}
 }
 
 static void adapter_process(MSFilter *f){
 	AdapterState *s=(AdapterState*)f->data;
 	mblk_t *im,*om;
 	size_t msgsize;
-	
+
+	if (f->inputs[1]!=NULL){
+		if (s->inputchans==1 && s->outputchans==2){
+			adapter_interleave(f,s);
+			return;
+		}
+		ms_queue_flush(f->inputs[1]);
+	}
 	while((im=ms_queue_get(f->inputs[0]))!=NULL){
 		if (s->inputchans==s->outputchans){
 			ms_queue_put(f->outputs[0],im);
 		}else if (s->inputchans==2){
 			msgsize=msgdsize(im)/2;
 			om=allocb(msgsize,0);
-			for (;im->b_rptr<im->b_wptr;im->b_rptr+=4,om->b_wptr+=2){
-				*(int16_t*)om->b_wptr=*(int16_t*)im->b_rptr;
-			}
+			ms_pcm_stereo_to_mono((int16_t*)im->b_rptr,(int16_t*)om->b_wptr,(int)(msgsize/2));
+			om->b_wptr+=msgsize;
 			ms_queue_put(f->outputs[0],om);
 			freemsg(im);
 		}else if (s->outputchans==2){
 			msgsize=msgdsize(im)*2;
 			om=allocb(msgsize,0);
-			for (;im->b_rptr<im->b_wptr;im->b_rptr+=2,om->b_wptr+=4){
-				((int16_t*)om->b_wptr)[0]=*(int16_t*)im->b_rptr;
-				((int16_t*)om->b_wptr)[1]=*(int16_t*)im->b_rptr;
-			}
+			ms_pcm_mono_to_stereo((int16_t*)im->b_rptr,(int16_t*)om->b_wptr,(int)(msgsize/4));
+			om->b_wptr+=msgsize;
 			ms_queue_put(f->outputs[0],om);
 			freemsg(im);
 		}
@@ -110,7 +154,7 @@ MSFilterDesc ms_channel_adapter_desc={
 	N_("A filter that converts from mono to stereo and vice versa."),
 	MS_FILTER_OTHER,
 	NULL,
-	1,
+	2,
 	1,
 	adapter_init,
 	NULL,
@@ -127,7 +171,7 @@ MSFilterDesc ms_channel_adapter_desc={
 	.name="MSChannelAdapter",
 	.text=N_("A filter that converts from mono to stereo and vice versa."),
 	.category=MS_FILTER_OTHER,
-	.ninputs=1,
+	.ninputs=2,
 	.noutputs=1,
 	.init=adapter_init,
 	.process=adapter_process,
@@ -21,6 +21,13 @@
 #include "mediastreamer2/mscommon.h"
 #include "mediastreamer2/flowcontrol.h"
 
+#include <math.h>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#define alloca _alloca
+#endif
+
 void ms_audio_flow_controller_init(MSAudioFlowController *ctl)
 {
 	ctl->target_samples = 0;
@@ -98,3 +105,241 @@ mblk_t *ms_audio_flow_controller_process(MSAudioFlowController *ctl, mblk_t *m){
 	}
 	return m;
 }
+
+/*shortest and longest period that can be removed or repeated, in milliseconds: they cover the pitch of human voices*/
+#define STRETCH_MIN_PERIOD_MS 3
+#define STRETCH_MAX_PERIOD_MS 15
+#define STRETCH_OVERLAP_MS 5
+/*minimum similarity between the two cross-faded segments for a correction to be applied*/
+#define STRETCH_MIN_CORRELATION 0.6f
+/*energy per sample under which a segment is considered as silence, and can be corrected whatever its shape*/
+#define STRETCH_SILENCE_ENERGY (300.0f*300.0f)
+/*the amount of audio buffered is never let above this multiple of the target, whatever the speed change allowed*/
+#define STRETCH_MAX_DEPTH_FACTOR 3
+/*nor above the target plus this duration, so that small targets leave room for the jitter of the inputs*/
+#define STRETCH_MIN_MAX_DEPTH_MARGIN_MS 60
+
+struct _MSAudioTimeStretcher{
+	int rate;
+	int nchannels;
+	int target; /*in samples per channel*/
+	int max_depth; /*in samples per channel, the excess is discarded at once*/
+	int min_period;
+	int max_period;
+	int overlap;
+	int search_step;
+	int16_t *work; /*interleaved audio already taken from the input but not output yet*/
+	int work_len; /*in samples per channel*/
+	int work_size;
+	float avg_depth;
+	float debt; /*samples to remove (positive) or to insert (negative)*/
+	float max_ratio;
+	int64_t correction;
+	bool_t buffering; /*waiting for the target depth to be reached, at start or after an underrun*/
+};
+
+MSAudioTimeStretcher *ms_audio_time_stretcher_new(int rate, int nchannels){
+	MSAudioTimeStretcher *ts = ms_new0(MSAudioTimeStretcher, 1);
+	ts->rate = rate;
+	ts->nchannels = nchannels;
+	ts->min_period = (STRETCH_MIN_PERIOD_MS * rate) / 1000;
+	ts->max_period = (STRETCH_MAX_PERIOD_MS * rate) / 1000;
+	ts->overlap = (STRETCH_OVERLAP_MS * rate) / 1000;
+	/*the best period is first searched on a grid roughly equivalent to 8 kHz sampling, then refined*/
+	ts->search_step = MAX(1, rate / 8000);
+	ts->max_ratio = 0.04f;
+	ts->avg_depth = -1;
+	ts->buffering = TRUE;
+	ms_audio_time_stretcher_set_target(ts, 20);
+	return ts;
+}
+
+void ms_audio_time_stretcher_set_target(MSAudioTimeStretcher *ts, int target_ms){
+	ts->target = (target_ms * ts->rate) / 1000;
+	ts->max_depth = MAX(STRETCH_MAX_DEPTH_FACTOR * ts->target, ts->target + (STRETCH_MIN_MAX_DEPTH_MARGIN_MS * ts->rate) / 1000);
+}
+
+int ms_audio_time_stretcher_get_max_depth(const MSAudioTimeStretcher *ts){
+	return (ts->max_depth * 1000) / ts->rate;
+}
+
+void ms_audio_time_stretcher_set_max_speed_change(MSAudioTimeStretcher *ts, float ratio){
+	ts->max_ratio = ratio;
+}
+
+int64_t ms_audio_time_stretcher_get_correction(const MSAudioTimeStretcher *ts){
+	return ts->correction;
+}
+
+void ms_audio_time_stretcher_destroy(MSAudioTimeStretcher *ts){
+	if (ts->work) ms_free(ts->work);
+	ms_free(ts);
+}
+
+static float segment_energy(const int16_t *x, int len){
+	float en = 0;
+	int i;
+	for (i = 0; i < len; ++i) en += (float)x[i] * (float)x[i];
+	return en;
+}
+
+static float segment_correlation(const int16_t *a, const int16_t *b, int len, float energy_a){
+	float acc = 0;
+	float energy_b = 0;
+	int i;
+	for (i = 0; i < len; ++i){
+		acc += (float)a[i] * (float)b[i];
+		energy_b += (float)b[i] * (float)b[i];
+	}
+	if (energy_a == 0 || energy_b == 0) return 0;
+	return acc / (float)sqrt((double)energy_a * (double)energy_b);
+}
+
+/*
+ * Looks for the period p in [min_period, max_period] for which the segment starting at p is the most similar to the
+ * segment starting at the beginning of the work buffer. Returns the period, and its correlation in corr.
+ */
+static int find_best_period(MSAudioTimeStretcher *ts, int max_period, float *corr, float *energy){
+	int len = ts->overlap * ts->nchannels;
+	float ea = segment_energy(ts->work, len);
+	float best_corr = -1;
+	int best = ts->min_period;
+	int p, from, to;
+
+	for (p = ts->min_period; p <= max_period; p += ts->search_step){
+		float c = segment_correlation(ts->work, ts->work + p * ts->nchannels, len, ea);
+		if (c > best_corr){
+			best_corr = c;
+			best = p;
+		}
+	}
+	from = MAX(ts->min_period, best - ts->search_step + 1);
+	to = MIN(max_period, best + ts->search_step - 1);
+	for (p = from; p <= to; ++p){
+		float c = segment_correlation(ts->work, ts->work + p * ts->nchannels, len, ea);
+		if (c > best_corr){
+			best_corr = c;
+			best = p;
+		}
+	}
+	*corr = best_corr;
+	*energy = ea / (float)len;
+	return best;
+}
+
+/*cross-fades from a to b over len interleaved samples, writing into out (that may be b)*/
+static void cross_fade(const int16_t *a, const int16_t *b, int16_t *out, int nframes, int nchannels){
+	int i, c;
+	for (i = 0; i < nframes; ++i){
+		int wb = (i << 15) / nframes;
+		int wa = (1 << 15) - wb;
+		for (c = 0; c < nchannels; ++c){
+			int k = i * nchannels + c;
+			out[k] = (int16_t)(((int)a[k] * wa + (int)b[k] * wb) >> 15);
+		}
+	}
+}
+
+/*removes one period: the audio continues seamlessly from the beginning of the work buffer to the segment starting at period*/
+static void time_stretcher_accelerate(MSAudioTimeStretcher *ts, int period){
+	int nch = ts->nchannels;
+	cross_fade(ts->work, ts->work + period * nch, ts->work + period * nch, ts->overlap, nch);
+	memmove(ts->work, ts->work + period * nch, (ts->work_len - period) * nch * sizeof(int16_t));
+	ts->work_len -= period;
+}
+
+/*repeats one period: the segment starting at period is followed again by the beginning of the work buffer*/
+static void time_stretcher_slow_down(MSAudioTimeStretcher *ts, int period){
+	int nch = ts->nchannels;
+	int16_t *tmp = (int16_t*)alloca(ts->overlap * nch * sizeof(int16_t));
+
+	cross_fade(ts->work + period * nch, ts->work, tmp, ts->overlap, nch);
+	memmove(ts->work + period * nch, ts->work, ts->work_len * nch * sizeof(int16_t));
+	memcpy(ts->work + period * nch, tmp, ts->overlap * nch * sizeof(int16_t));
+	ts->work_len += period;
+}
+
+static void time_stretcher_fill(MSAudioTimeStretcher *ts, MSBufferizer *input, int wanted){
+	int frame_size = 2 * ts->nchannels;
+	int avail = (int)ms_bufferizer_get_avail(input) / frame_size;
+	int toread = MIN(avail, wanted - ts->work_len);
+
+	if (toread > 0){
+		ms_bufferizer_read(input, (uint8_t*)(ts->work + ts->work_len * ts->nchannels), toread * frame_size);
+		ts->work_len += toread;
+	}
+}
+
+int ms_audio_time_stretcher_read(MSAudioTimeStretcher *ts, MSBufferizer *input, int16_t *out, int nsamples){
+	int frame_size = 2 * ts->nchannels;
+	int lookahead = nsamples + ts->max_period + ts->overlap;
+	int depth;
+
+	/*room for the lookahead, plus one period that may be inserted*/
+	if (ts->work_size < lookahead + ts->max_period){
+		ts->work_size = lookahead + ts->max_period;
+		ts->work = ms_realloc(ts->work, ts->work_size * frame_size);
+	}
+	time_stretcher_fill(ts, input, lookahead);
+	depth = ts->work_len + (int)ms_bufferizer_get_avail(input) / frame_size - nsamples;
+	if (depth > ts->max_depth){
+		/*the input is faster than what stretching can absorb: drop the excess instead of letting the latency grow*/
+		int skip = MIN(depth - ts->target, (int)ms_bufferizer_get_avail(input) / frame_size);
+		ms_warning("MSAudioTimeStretcher: %i ms buffered, %i ms in excess dropped", (depth * 1000) / ts->rate, (skip * 1000) / ts->rate);
+		ms_bufferizer_skip_bytes(input, skip * frame_size);
+		depth -= skip;
+		ts->correction += skip;
+		ts->avg_depth = (float)depth;
+		ts->debt = 0;
+	}
+	if (ts->work_len < nsamples){
+		ts->buffering = TRUE;
+		return 0;
+	}
+	if (ts->buffering){
+		if (depth < ts->target) return 0;
+		ts->buffering = FALSE;
+	}
+
+	if (ts->avg_depth < 0) ts->avg_depth = (float)depth;
+	else ts->avg_depth = 0.95f * ts->avg_depth + 0.05f * (float)depth;
+
+	if (ts->avg_depth > (float)(ts->target + MAX(ts->target / 2, nsamples))){
+		ts->debt += ts->max_ratio * (float)nsamples;
+	}else if (ts->avg_depth < (float)(ts->target / 2)){
+		ts->debt -= ts->max_ratio * (float)nsamples;
+	}else{
+		ts->debt *= 0.9f; /*in the target range: forget corrections not made yet*/
+	}
+
+	if ((ts->debt >= (float)ts->min_period && ts->work_len >= lookahead)
+		|| (ts->debt <= -(float)ts->min_period && ts->work_len >= ts->min_period + ts->overlap)){
+		float corr, energy;
+		/*when no similar enough period is found, the correction is postponed unless it has been delayed for too long*/
+		bool_t forced = ts->debt > (float)(4 * ts->max_period) || ts->debt < -(float)(4 * ts->max_period);
+		/*when slowing down, the buffer may be too short to search among all periods*/
+		int max_period = MIN(ts->max_period, ts->work_len - ts->overlap);
+		int period;
+		/*no more than the debt is corrected, otherwise the debt changes sign and the next correction goes the other way*/
+		if (!forced) max_period = MIN(max_period, (int)fabsf(ts->debt));
+		period = find_best_period(ts, max_period, &corr, &energy);
+		if (corr >= STRETCH_MIN_CORRELATION || energy < STRETCH_SILENCE_ENERGY || forced){
+			if (ts->debt > 0){
+				time_stretcher_accelerate(ts, period);
+				ts->debt = MAX(ts->debt - (float)period, 0);
+				ts->correction += period;
+				/*removing a period may leave less than what needs to be output*/
+				time_stretcher_fill(ts, input, lookahead);
+			}else{
+				time_stretcher_slow_down(ts, period);
+				ts->debt = MIN(ts->debt + (float)period, 0);
+				ts->correction -= period;
+			}
+		}
+	}
+	if (ts->work_len < nsamples) return 0;
+	memcpy(out, ts->work, nsamples * frame_size);
+	ts->work_len -= nsamples;
+	memmove(ts->work, ts->work + nsamples * ts->nchannels, ts->work_len * frame_size);
+	return nsamples;
+}
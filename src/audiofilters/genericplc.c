@@ -24,6 +24,16 @@
 #include "mediastreamer2/dsptools.h"
 #include <math.h>
 
+#if !defined(MS_FIXED_POINT)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PLC_USE_SSE2
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PLC_USE_NEON
+#endif
+#endif
+
 #define PI 3.14159265
 
 plc_context_t *generic_plc_create_context(int sample_rate) {
@@ -44,6 +54,11 @@ plc_context_t *generic_plc_create_context(int sample_rate) {
 	context->plc_index=0;
 	context->plc_samples_used=0;
 	context->sample_rate = sample_rate;
+	context->time_domain_buffer = ms_malloc0(sample_rate*PLC_BUFFER_LEN*sizeof(ms_word16_t));
+	context->freq_domain_buffer = ms_malloc0(sample_rate*PLC_BUFFER_LEN*sizeof(ms_word16_t));
+	context->freq_domain_buffer_double = ms_malloc0(2*sample_rate*PLC_BUFFER_LEN*sizeof(ms_word16_t));
+	context->time_domain_buffer_double = ms_malloc0(2*sample_rate*PLC_BUFFER_LEN*sizeof(ms_word16_t));
+	context->transition_buffer = ms_malloc0(sample_rate*sizeof(int16_t)*TRANSITION_DELAY/1000);
 
 	/* initialise the fft contexts, one with sample number being the plc buffer length,
 	 * the complex to real is twice that number as buffer is doubled in frequency domain */
@@ -63,47 +78,133 @@ void generic_plc_destroy_context(plc_context_t *context) {
 	ms_free(context->plc_buffer);
 	ms_free(context->hamming_window);
 	ms_free(context->plc_out_buffer);
+	ms_free(context->time_domain_buffer);
+	ms_free(context->freq_domain_buffer);
+	ms_free(context->freq_domain_buffer_double);
+	ms_free(context->time_domain_buffer_double);
+	ms_free(context->transition_buffer);
 	ms_fft_destroy(context->fft_to_frequency_context);
 	ms_fft_destroy(context->fft_to_time_context);
 
 	ms_free(context);
 }
 
-void generic_plc_fftbf(plc_context_t *context, int16_t *input_buffer, int16_t *output_buffer, size_t input_buffer_len) {
-	/* Allocate temporary buffers to perform FFT-> double buffer size in frequency domain -> inverse FFT */
-	ms_word16_t *time_domain_buffer = ms_malloc0(input_buffer_len*sizeof(ms_word16_t));
-	ms_word16_t *freq_domain_buffer = ms_malloc0(input_buffer_len*sizeof(ms_word16_t));
-	ms_word16_t *freq_domain_buffer_double = ms_malloc0(2*input_buffer_len*sizeof(ms_word16_t));
-	ms_word16_t *time_domain_buffer_double = ms_malloc0(2*input_buffer_len*sizeof(ms_word16_t));
-	size_t i;
+/* apply the window to the input signal, converting it to ms_word16_t */
+static void plc_apply_window(const int16_t *input, const float *window, ms_word16_t *output, size_t len) {
+	size_t i = 0;
+#if defined(PLC_USE_SSE2)
+	for (; i + 8 <= len; i += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(input + i));
+		/* sign extend the 16 bits samples to 32 bits */
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+		_mm_storeu_ps(output + i, _mm_mul_ps(lo, _mm_loadu_ps(window + i)));
+		_mm_storeu_ps(output + i + 4, _mm_mul_ps(hi, _mm_loadu_ps(window + i + 4)));
+	}
+#elif defined(PLC_USE_NEON)
+	for (; i + 8 <= len; i += 8) {
+		int16x8_t s = vld1q_s16(input + i);
+		float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+		float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+		vst1q_f32(output + i, vmulq_f32(lo, vld1q_f32(window + i)));
+		vst1q_f32(output + i + 4, vmulq_f32(hi, vld1q_f32(window + i + 4)));
+	}
+#endif
+	for (; i < len; i++) {
+		output[i] = (ms_word16_t)((float)input[i]*window[i]);
+	}
+}
 
-	/* convert to ms_word16_t the input buffer */
-	for (i=0; i<input_buffer_len; i++) {
-		time_domain_buffer[i] = (ms_word16_t)((float)input_buffer[i]*context->hamming_window[i]);
+/* double the number of samples in frequency domain: each bin is attenuated and followed by a zero */
+static void plc_stretch_spectrum(const ms_word16_t *input, ms_word16_t *output, size_t len) {
+	size_t i = 0;
+#if defined(PLC_USE_SSE2)
+	__m128 zero = _mm_setzero_ps();
+	__m128 attenuation = _mm_set1_ps(ENERGY_ATTENUATION);
+	for (; i + 4 <= len; i += 4) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(input + i), attenuation);
+		_mm_storeu_ps(output + 2*i, _mm_unpacklo_ps(v, zero));
+		_mm_storeu_ps(output + 2*i + 4, _mm_unpackhi_ps(v, zero));
+	}
+#elif defined(PLC_USE_NEON)
+	float32x4_t zero = vdupq_n_f32(0);
+	for (; i + 4 <= len; i += 4) {
+		float32x4x2_t v;
+		v.val[0] = vmulq_n_f32(vld1q_f32(input + i), ENERGY_ATTENUATION);
+		v.val[1] = zero;
+		vst2q_f32(output + 2*i, v);
 	}
+#endif
+	for (; i < len; i++) {
+		output[2*i] = input[i]*ENERGY_ATTENUATION;
+		output[2*i+1] = 0;
+	}
+}
+
+/* the conversions to int16_t saturate, like the vector instructions */
+static int16_t plc_saturate(float value) {
+	if (value >= 32767.0f) return 32767;
+	if (value <= -32768.0f) return -32768;
+	return (int16_t)value;
+}
+
+/* convert back to int16_t, values are truncated and saturated */
+void generic_plc_to_int16(const ms_word16_t *input, int16_t *output, size_t len) {
+	size_t i = 0;
+#if defined(PLC_USE_SSE2)
+	for (; i + 8 <= len; i += 8) {
+		__m128i lo = _mm_cvttps_epi32(_mm_loadu_ps(input + i));
+		__m128i hi = _mm_cvttps_epi32(_mm_loadu_ps(input + i + 4));
+		_mm_storeu_si128((__m128i *)(output + i), _mm_packs_epi32(lo, hi));
+	}
+#elif defined(PLC_USE_NEON)
+	for (; i + 8 <= len; i += 8) {
+		int16x4_t lo = vqmovn_s32(vcvtq_s32_f32(vld1q_f32(input + i)));
+		int16x4_t hi = vqmovn_s32(vcvtq_s32_f32(vld1q_f32(input + i + 4)));
+		vst1q_s16(output + i, vcombine_s16(lo, hi));
+	}
+#endif
+	for (; i < len; i++) {
+		output[i] = plc_saturate((float)input[i]);
+	}
+}
+
+void generic_plc_fftbf(plc_context_t *context, int16_t *input_buffer, int16_t *output_buffer, size_t input_buffer_len) {
+	/* FFT -> double buffer size in frequency domain -> inverse FFT, using the buffers of the context */
+	plc_apply_window(input_buffer, context->hamming_window, context->time_domain_buffer, input_buffer_len);
 
 	/* FFT */
-	ms_fft(context->fft_to_frequency_context, time_domain_buffer, freq_domain_buffer);
+	ms_fft(context->fft_to_frequency_context, context->time_domain_buffer, context->freq_domain_buffer);
 
 	/* double the number of sample in frequency domain */
-	for (i=0; i<input_buffer_len; i++) {
-		freq_domain_buffer_double[2*i] = freq_domain_buffer[i]*ENERGY_ATTENUATION;
-		freq_domain_buffer_double[2*i+1]  = 0;//freq_domain_buffer[i]/2 ;
-	}
+	plc_stretch_spectrum(context->freq_domain_buffer, context->freq_domain_buffer_double, input_buffer_len);
 
 	/* inverse FFT, we have twice the number of original samples, discard the first half and use the second as new samples */
-	ms_ifft(context->fft_to_time_context, freq_domain_buffer_double, time_domain_buffer_double);
-
-	ms_free(time_domain_buffer);
-	ms_free(freq_domain_buffer);
-	ms_free(freq_domain_buffer_double);
+	ms_ifft(context->fft_to_time_context, context->freq_domain_buffer_double, context->time_domain_buffer_double);
 
 	/* copy generated signal to the plc_out_buffer */
-	for (i=0; i<2*input_buffer_len; i++) {
-		output_buffer[i] = (int16_t)(time_domain_buffer_double[i]);
-	}
+	generic_plc_to_int16(context->time_domain_buffer_double, output_buffer, 2*input_buffer_len);
+}
 
-	ms_free(time_domain_buffer_double);
+/* fade out the signal: the sample i is multiplied by 1+(start-i)/length */
+void generic_plc_fade_out(int16_t *data, int len, float start, float length) {
+	int i = 0;
+#if defined(PLC_USE_SSE2)
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 vlength = _mm_set1_ps(length);
+	__m128 offset = _mm_setr_ps(start, start - 1, start - 2, start - 3);
+	for (; i + 8 <= len; i += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(data + i));
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+		__m128 glo = _mm_add_ps(one, _mm_div_ps(_mm_sub_ps(offset, _mm_set1_ps((float)i)), vlength));
+		__m128 ghi = _mm_add_ps(one, _mm_div_ps(_mm_sub_ps(offset, _mm_set1_ps((float)(i + 4))), vlength));
+		_mm_storeu_si128((__m128i *)(data + i), _mm_packs_epi32(_mm_cvttps_epi32(_mm_mul_ps(glo, lo)), _mm_cvttps_epi32(_mm_mul_ps(ghi, hi))));
+	}
+#endif
+	for (; i < len; i++) {
+		data[i] = plc_saturate((1.0f + (start - (float)i)/length) * (float)data[i]);
+	}
 }
 
 void generic_plc_generate_samples(plc_context_t *context, int16_t *data, uint16_t sample_nbr) {
@@ -166,14 +267,19 @@ void generic_plc_generate_samples(plc_context_t *context, int16_t *data, uint16_
 
 	/* adjust volume when PLC_DECREASE_START samples point is reached */
 	if ( context->plc_samples_used + sample_nbr > PLC_DECREASE_START*context->sample_rate/1000 ) {
-		int i = PLC_DECREASE_START*context->sample_rate/1000 - context->plc_samples_used;
-		if (i<0) i=0;
-		for (; i<sample_nbr; i++) {
-			if (context->plc_samples_used+i>=MAX_PLC_LEN*context->sample_rate/1000) {
-				data[i] = 0;
-			} else {
-				data[i] = (int16_t)((1.0+((float)(PLC_DECREASE_START*context->sample_rate/1000 - (context->plc_samples_used + i))/(float)((MAX_PLC_LEN-PLC_DECREASE_START)*context->sample_rate/1000))) * (float)data[i]);
-			}
+		int decrease_start = PLC_DECREASE_START*context->sample_rate/1000 - context->plc_samples_used;
+		int silence_start = MAX_PLC_LEN*context->sample_rate/1000 - context->plc_samples_used;
+		if (decrease_start<0) decrease_start=0;
+		if (silence_start>sample_nbr) silence_start=sample_nbr;
+		if (silence_start>decrease_start) {
+			generic_plc_fade_out(data + decrease_start, silence_start - decrease_start,
+				(float)(PLC_DECREASE_START*context->sample_rate/1000 - (context->plc_samples_used + decrease_start)),
+				(float)((MAX_PLC_LEN-PLC_DECREASE_START)*context->sample_rate/1000));
+		} else {
+			silence_start = decrease_start;
+		}
+		if (silence_start<sample_nbr) {
+			memset(data + silence_start, 0, (sample_nbr - silence_start)*sizeof(int16_t));
 		}
 	}
 	context->plc_samples_used += sample_nbr;
@@ -193,7 +299,7 @@ void generic_plc_update_plc_buffer(plc_context_t *context, unsigned char *data,
 
 void generic_plc_update_continuity_buffer(plc_context_t *context, unsigned char *data, size_t data_len) {
 	size_t transitionBufferSize = context->sample_rate*sizeof(int16_t)*TRANSITION_DELAY/1000;
-	unsigned char *buffer=ms_malloc(transitionBufferSize);
+	unsigned char *buffer=context->transition_buffer;
 
 	/* get the last TRANSITION_DELAY ms in a temp buffer */
 	memcpy(buffer, data+data_len-transitionBufferSize, transitionBufferSize);
@@ -203,15 +309,31 @@ void generic_plc_update_continuity_buffer(plc_context_t *context, unsigned char
 	memcpy(data, context->continuity_buffer, transitionBufferSize);
 	/* store in context for next msg the last TRANSITION_DELAY ms of current msg */
 	memcpy(context->continuity_buffer, buffer, transitionBufferSize);
-
-	ms_free(buffer);
 }
 
 
 /** Transition mix function, mix last received data with local generated one for smooth transition */
 void generic_plc_transition_mix(int16_t *inout_buffer, int16_t *continuity_buffer, uint16_t fading_sample_nbr) {
-	uint16_t i;
-	for (i=0; i<fading_sample_nbr; i++) {
+	uint16_t i = 0;
+#if defined(PLC_USE_SSE2)
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 count = _mm_set1_ps((float)fading_sample_nbr);
+	__m128 index = _mm_setr_ps(0, 1, 2, 3);
+	for (; i + 8 <= fading_sample_nbr; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(continuity_buffer + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(inout_buffer + i));
+		__m128 alo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16));
+		__m128 ahi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16));
+		__m128 blo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16));
+		__m128 bhi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(b, b), 16));
+		__m128 plo = _mm_div_ps(_mm_add_ps(index, _mm_set1_ps((float)i)), count);
+		__m128 phi = _mm_div_ps(_mm_add_ps(index, _mm_set1_ps((float)(i + 4))), count);
+		__m128 rlo = _mm_add_ps(_mm_mul_ps(alo, _mm_sub_ps(one, plo)), _mm_mul_ps(blo, plo));
+		__m128 rhi = _mm_add_ps(_mm_mul_ps(ahi, _mm_sub_ps(one, phi)), _mm_mul_ps(bhi, phi));
+		_mm_storeu_si128((__m128i *)(inout_buffer + i), _mm_packs_epi32(_mm_cvttps_epi32(rlo), _mm_cvttps_epi32(rhi)));
+	}
+#endif
+	for (; i<fading_sample_nbr; i++) {
 		float progress = ((float) i)/fading_sample_nbr;
 		inout_buffer[i] = (int16_t)((float)continuity_buffer[i]*(1-progress) + (float)inout_buffer[i]*progress);
 	}
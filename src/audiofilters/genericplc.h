@@ -20,6 +20,8 @@
 #ifndef genericplc_h
 #define genericplc_h
 
+#include "mediastreamer2/dsptools.h"
+
 /* define transition duration in ms when starting/ending a comfort noise period - it introduces an equivalent delay */
 #define TRANSITION_DELAY 5
 
@@ -46,6 +48,12 @@ typedef struct {
 	void *fft_to_frequency_context; /**< context for the FFT */
 	void *fft_to_time_context; /**< context for the inverse FFT */
 	int sample_rate; /**< sample rate of the audio signal */
+	/* working buffers, allocated once so that concealing a frame does not allocate memory */
+	ms_word16_t *time_domain_buffer; /**< windowed plc buffer, sample_rate*PLC_BUFFER_LEN samples */
+	ms_word16_t *freq_domain_buffer; /**< its spectrum */
+	ms_word16_t *freq_domain_buffer_double; /**< the spectrum stretched to twice the number of samples */
+	ms_word16_t *time_domain_buffer_double; /**< the generated signal, 2*sample_rate*PLC_BUFFER_LEN samples */
+	unsigned char *transition_buffer; /**< TRANSITION_DELAY ms of signal, used when delaying the incoming frames */
 }plc_context_t;
 
 
@@ -56,5 +64,8 @@ void generic_plc_fftbf(plc_context_t *context, int16_t *input_buffer, int16_t *o
 void generic_plc_generate_samples(plc_context_t *context, int16_t *data, uint16_t sample_nbr);
 void generic_plc_update_plc_buffer(plc_context_t *context, unsigned char *data, size_t data_len);
 void generic_plc_update_continuity_buffer(plc_context_t *context, unsigned char *data, size_t data_len);
+/* conversion of the generated signal and fading of the samples, saturated to the int16_t range */
+void generic_plc_to_int16(const ms_word16_t *input, int16_t *output, size_t len);
+void generic_plc_fade_out(int16_t *data, int len, float start, float length);
 
 #endif /* genericplc_h */
@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/msfileplayer.h"
 #include "waveheader.h"
+#include "pcmformat.h"
 #include "mediastreamer2/msticker.h"
 
 #ifdef HAVE_PCAP
@@ -264,16 +265,6 @@ static void player_uninit(MSFilter *f){
 	ms_free(d);
 }
 
-static void swap_bytes(unsigned char *bytes, int len){
-	int i;
-	unsigned char tmp;
-	for(i=0;i<len;i+=2){
-		tmp=bytes[i];
-		bytes[i]=bytes[i+1];
-		bytes[i+1]=tmp;
-	}
-}
-
 static void player_process(MSFilter *f){
 	PlayerData *d=(PlayerData*)f->data;
 	int nsamples=(f->ticker->interval*d->rate*d->nchannels)/1000;
@@ -366,7 +357,7 @@ static void player_process(MSFilter *f){
 				d->pause_time-=f->ticker->interval;
 			}else{
 				err=read(d->fd,om->b_wptr,bytes);
-				if (d->swap) swap_bytes(om->b_wptr,bytes);
+				if (d->swap) ms_pcm_swap_bytes(om->b_wptr,om->b_wptr,bytes/2);
 			}
 			if (err>=0){
 				if (err!=0){
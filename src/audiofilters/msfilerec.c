@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/msfilerec.h"
 #include "waveheader.h"
+#include "pcmformat.h"
 
 
 static int rec_close(MSFilter *f, void *arg);
@@ -52,16 +53,6 @@ static void rec_init(MSFilter *f){
 	f->data=s;
 }
 
-static void swap_bytes(unsigned char *bytes, int len){
-	int i;
-	unsigned char tmp;
-	for(i=0;i<len;i+=2){
-		tmp=bytes[i];
-		bytes[i]=bytes[i+1];
-		bytes[i+1]=tmp;
-	}
-}
-
 static void rec_process(MSFilter *f){
 	RecState *s=(RecState*)f->data;
 	mblk_t *m;
@@ -77,7 +68,7 @@ static void rec_process(MSFilter *f){
 					len = s->max_size - s->size;
 					max_size_reached = 1;
 				}
-				if (s->swap) swap_bytes(it->b_wptr,len);
+				if (s->swap) ms_pcm_swap_bytes(it->b_rptr,it->b_rptr,len/2);
 				if ((err=write(s->fd,it->b_rptr,len))!=len){
 					if (err<0)
 						ms_warning("MSFileRec: fail to write %i bytes: %s",len,strerror(errno));
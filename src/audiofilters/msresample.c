@@ -18,6 +18,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "mediastreamer2/msfilter.h"
+#include "pcmformat.h"
 
 #ifdef _MSC_VER
 #include <malloc.h>
@@ -87,18 +88,15 @@ static int resample_channel_adapt(int in_nchannels, int out_nchannels, mblk_t *i
 	if ((in_nchannels == 2) && (out_nchannels == 1)) {
 		size_t msgsize = msgdsize(im) / 2;
 		*om = allocb(msgsize, 0);
-		for (; im->b_rptr < im->b_wptr; im->b_rptr += 4, (*om)->b_wptr += 2) {
-			*(int16_t *)(*om)->b_wptr = *(int16_t *)im->b_rptr;
-		}
+		ms_pcm_stereo_to_mono((int16_t *)im->b_rptr, (int16_t *)(*om)->b_wptr, (int)(msgsize / 2));
+		(*om)->b_wptr += msgsize;
 		mblk_meta_copy(im, *om);
 		return 1;
 	} else if ((in_nchannels == 1) && (out_nchannels == 2)) {
 		size_t msgsize = msgdsize(im) * 2;
 		*om = allocb(msgsize, 0);
-		for (; im->b_rptr < im->b_wptr; im->b_rptr += 2, (*om)->b_wptr += 4) {
-			((int16_t *)(*om)->b_wptr)[0] = *(int16_t *)im->b_rptr;
-			((int16_t *)(*om)->b_wptr)[1] = *(int16_t *)im->b_rptr;
-		}
+		ms_pcm_mono_to_stereo((int16_t *)im->b_rptr, (int16_t *)(*om)->b_wptr, (int)(msgsize / 4));
+		(*om)->b_wptr += msgsize;
 		mblk_meta_copy(im, *om);
 		return 1;
 	}
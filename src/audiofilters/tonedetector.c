@@ -31,55 +31,132 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define M_PI       3.14159265358979323846
 #endif
 
-#define MAX_SCANS 10
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/*tones are evaluated by blocks of this size, matching the width of the vector unit*/
+#define TONE_BLOCK 4
 
 static const float energy_min_threshold=0.01f;
 
 typedef struct _GoertzelState{
 	uint64_t starttime;
 	int dur;
-	float coef;
 	bool_t event_sent;
 	bool_t pad[3];
 }GoertzelState;
 
-static void goertzel_state_init(GoertzelState *gs, int frequency, int sampling_frequency){
-	gs->coef=(float)2*(float)cos(2*M_PI*((float)frequency/(float)sampling_frequency));
-	gs->starttime=0;
-	gs->dur=0;
+/*
+ * Bank of goertzel filters, one per scanned frequency, stored as arrays so that TONE_BLOCK frequencies are run
+ * at once. The arrays are allocated by multiples of TONE_BLOCK, unused lanes have a null coefficient.
+ */
+typedef struct _ToneBank{
+	float *coefs;
+	float *energies; /*relative energy of each tone over the last analyzed frame*/
+	float *frame; /*the current frame, converted to float*/
+	int ntones;
+	int capacity;
+	int frame_samples;
+}ToneBank;
+
+static float goertzel_coef(int frequency, int sampling_frequency){
+	return (float)2*(float)cos(2*M_PI*((float)frequency/(float)sampling_frequency));
 }
 
-static float goertzel_state_run(GoertzelState *gs,int16_t  *samples, int nsamples, float total_energy){
-	int i;
-	float tmp;
-	float q1=0;
-	float q2=0;
-	float freq_en;
+static void tone_bank_grow(ToneBank *bank, int capacity){
+	bank->coefs=ms_realloc(bank->coefs,capacity*sizeof(float));
+	bank->energies=ms_realloc(bank->energies,capacity*sizeof(float));
+	memset(bank->coefs+bank->capacity,0,(capacity-bank->capacity)*sizeof(float));
+	memset(bank->energies+bank->capacity,0,(capacity-bank->capacity)*sizeof(float));
+	bank->capacity=capacity;
+}
 
-	for(i=0;i<nsamples;++i){
-		tmp=q1;
-		q1=(gs->coef*q1) - q2 + (float)samples[i];
-		q2=tmp;
-	}
-	
-	freq_en= (q1*q1) + (q2*q2) - (q1*q2*gs->coef);
-	/*return a relative frequency energy compared over the total signal energy */
-	return freq_en/(total_energy*(float)nsamples*0.5f);
+static void tone_bank_uninit(ToneBank *bank){
+	if (bank->coefs) ms_free(bank->coefs);
+	if (bank->energies) ms_free(bank->energies);
+	if (bank->frame) ms_free(bank->frame);
+	memset(bank,0,sizeof(*bank));
 }
 
-static float compute_energy(int16_t *samples, int nsamples){
+/*converts the frame to float and returns its total energy, in a single pass over the samples*/
+static float tone_bank_load_frame(ToneBank *bank, const int16_t *samples, int nsamples){
 	float en=0;
 	int i;
+	if (bank->frame_samples<nsamples){
+		bank->frame=ms_realloc(bank->frame,nsamples*sizeof(float));
+		bank->frame_samples=nsamples;
+	}
 	for(i=0;i<nsamples;++i){
 		float s=(float)samples[i];
+		bank->frame[i]=s;
 		en+=s*s;
 	}
 	return en;
 }
 
+/*runs TONE_BLOCK goertzel filters over the frame, and writes their energy relative to total_energy*/
+static void tone_bank_run_block(const float *coefs, const float *x, int nsamples, float total_energy, float *energies){
+	int i;
+#if defined(__SSE__)
+	__m128 coef=_mm_loadu_ps(coefs);
+	__m128 q1=_mm_setzero_ps();
+	__m128 q2=_mm_setzero_ps();
+	__m128 tmp;
+	__m128 en;
+	for(i=0;i<nsamples;++i){
+		tmp=q1;
+		q1=_mm_add_ps(_mm_sub_ps(_mm_mul_ps(coef,q1),q2),_mm_set1_ps(x[i]));
+		q2=tmp;
+	}
+	en=_mm_sub_ps(_mm_add_ps(_mm_mul_ps(q1,q1),_mm_mul_ps(q2,q2)),_mm_mul_ps(_mm_mul_ps(q1,q2),coef));
+	_mm_storeu_ps(energies,_mm_div_ps(en,_mm_set1_ps(total_energy*(float)nsamples*0.5f)));
+#elif defined(__ARM_NEON__)
+	float32x4_t coef=vld1q_f32(coefs);
+	float32x4_t q1=vdupq_n_f32(0);
+	float32x4_t q2=vdupq_n_f32(0);
+	float32x4_t tmp;
+	float32x4_t en;
+	float norm=1.0f/(total_energy*(float)nsamples*0.5f);
+	for(i=0;i<nsamples;++i){
+		tmp=q1;
+		q1=vaddq_f32(vsubq_f32(vmulq_f32(coef,q1),q2),vdupq_n_f32(x[i]));
+		q2=tmp;
+	}
+	en=vsubq_f32(vaddq_f32(vmulq_f32(q1,q1),vmulq_f32(q2,q2)),vmulq_f32(vmulq_f32(q1,q2),coef));
+	vst1q_f32(energies,vmulq_n_f32(en,norm));
+#else
+	float q1[TONE_BLOCK]={0};
+	float q2[TONE_BLOCK]={0};
+	int k;
+	for(i=0;i<nsamples;++i){
+		for(k=0;k<TONE_BLOCK;++k){
+			float tmp=q1[k];
+			q1[k]=(coefs[k]*q1[k]) - q2[k] + x[i];
+			q2[k]=tmp;
+		}
+	}
+	for(k=0;k<TONE_BLOCK;++k){
+		float freq_en=(q1[k]*q1[k]) + (q2[k]*q2[k]) - (q1[k]*q2[k]*coefs[k]);
+		/*return a relative frequency energy compared over the total signal energy */
+		energies[k]=freq_en/(total_energy*(float)nsamples*0.5f);
+	}
+#endif
+}
+
+static void tone_bank_run(ToneBank *bank, int nsamples, float total_energy){
+	int i;
+	for(i=0;i<bank->ntones;i+=TONE_BLOCK){
+		tone_bank_run_block(bank->coefs+i,bank->frame,nsamples,total_energy,bank->energies+i);
+	}
+}
+
 typedef struct _DetectorState{
-	MSToneDetectorDef tone_def[MAX_SCANS];
-	GoertzelState tone_gs[MAX_SCANS];
+	MSToneDetectorDef *tone_def;
+	GoertzelState *tone_gs;
+	ToneBank bank;
 	int nscans;
 	MSBufferizer *buf;
 	int rate;
@@ -99,41 +176,65 @@ static void detector_init(MSFilter *f){
 static void detector_uninit(MSFilter *f){
 	DetectorState *s=(DetectorState *)f->data;
 	ms_bufferizer_destroy (s->buf);
+	tone_bank_uninit(&s->bank);
+	if (s->tone_def) ms_free(s->tone_def);
+	if (s->tone_gs) ms_free(s->tone_gs);
 	ms_free(f->data);
 }
 
-static int find_free_slot(DetectorState *s){
-	int i;
-	for(i=0;i<MAX_SCANS;++i){
-		if (s->tone_def[i].frequency==0) return i;
-	}
-	ms_error("No more free tone detector scans allowed, maximum reached.");
-	return -1;
-}
-
 static int detector_add_scan(MSFilter *f, void *arg){
 	DetectorState *s=(DetectorState *)f->data;
 	MSToneDetectorDef *def=(MSToneDetectorDef*)arg;
-	int i=find_free_slot(s);
-	if (i!=-1){
-		s->tone_def[i]=*def;
-		s->nscans++;
-		goertzel_state_init(&s->tone_gs[i],def->frequency,s->rate);
-		return 0;
+	int i;
+
+	ms_filter_lock(f);
+	i=s->nscans;
+	if (i==s->bank.capacity){
+		int capacity=s->bank.capacity+TONE_BLOCK;
+		tone_bank_grow(&s->bank,capacity);
+		s->tone_def=ms_realloc(s->tone_def,capacity*sizeof(MSToneDetectorDef));
+		s->tone_gs=ms_realloc(s->tone_gs,capacity*sizeof(GoertzelState));
 	}
-	return -1;
+	s->tone_def[i]=*def;
+	memset(&s->tone_gs[i],0,sizeof(GoertzelState));
+	s->bank.coefs[i]=goertzel_coef(def->frequency,s->rate);
+	s->bank.energies[i]=0;
+	s->nscans++;
+	s->bank.ntones=s->nscans;
+	ms_filter_unlock(f);
+	return 0;
 }
 
 static int detector_clear_scans(MSFilter *f, void *arg){
 	DetectorState *s=(DetectorState *)f->data;
-	memset(&s->tone_def,0,sizeof(s->tone_def));
+	ms_filter_lock(f);
 	s->nscans=0;
+	s->bank.ntones=0;
+	memset(s->bank.coefs,0,s->bank.capacity*sizeof(float));
+	ms_filter_unlock(f);
 	return 0;
 }
 
 static int detector_set_rate(MSFilter *f, void *arg){
 	DetectorState *s=(DetectorState *)f->data;
+	int i;
+	ms_filter_lock(f);
 	s->rate = *((int*) arg);
+	s->framesize=2*(s->frame_ms*s->rate)/1000;
+	for(i=0;i<s->nscans;++i){
+		s->bank.coefs[i]=goertzel_coef(s->tone_def[i].frequency,s->rate);
+	}
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int detector_get_energies(MSFilter *f, void *arg){
+	DetectorState *s=(DetectorState *)f->data;
+	MSToneDetectorEnergies *en=(MSToneDetectorEnergies*)arg;
+	ms_filter_lock(f);
+	en->count=MIN(en->count,s->nscans);
+	if (en->count>0) memcpy(en->energies,s->bank.energies,en->count*sizeof(float));
+	ms_filter_unlock(f);
 	return 0;
 }
 
@@ -143,12 +244,15 @@ static void end_all_tones(DetectorState *s){
 		GoertzelState *gs=&s->tone_gs[i];
 		gs->dur=0;
 		gs->event_sent=FALSE;
+		s->bank.energies[i]=0;
 	}
 }
 
 static void detector_process(MSFilter *f){
 	DetectorState *s=(DetectorState *)f->data;
 	mblk_t *m;
+	MSList *events=NULL;
+	MSList *elem;
 	
 	while ((m=ms_queue_get(f->inputs[0]))!=NULL){
 		ms_queue_put(f->outputs[0],m);
@@ -156,26 +260,28 @@ static void detector_process(MSFilter *f){
 			ms_bufferizer_put(s->buf,dupmsg(m));
 		}
 	}
+	ms_filter_lock(f);
 	if (s->nscans>0){
 		uint8_t *buf=alloca(s->framesize);
+		int nsamples=s->framesize/2;
 
 		while(ms_bufferizer_read(s->buf,buf,s->framesize)!=0){
-			float en=compute_energy((int16_t*)buf,s->framesize/2);
+			float en=tone_bank_load_frame(&s->bank,(int16_t*)buf,nsamples);
 			if (en>energy_min_threshold*(32767.0*32767.0*0.7)){
 				int i;
+				tone_bank_run(&s->bank,nsamples,en);
 				for(i=0;i<s->nscans;++i){
 					GoertzelState *gs=&s->tone_gs[i];
 					MSToneDetectorDef *tone_def=&s->tone_def[i];
-					float freq_en=goertzel_state_run(gs,(int16_t*)buf,s->framesize/2,en);
-					if (freq_en>=tone_def->min_amplitude){
+					if (s->bank.energies[i]>=tone_def->min_amplitude){
 						if (gs->dur==0) gs->starttime=f->ticker->time;
 						gs->dur+=s->frame_ms;
 						if (gs->dur>=tone_def->min_duration && !gs->event_sent){
-							MSToneDetectorEvent event;
+							MSToneDetectorEvent *event=ms_new0(MSToneDetectorEvent,1);
 						
-							strncpy(event.tone_name,tone_def->tone_name,sizeof(event.tone_name));
-							event.tone_start_time=gs->starttime;
-							ms_filter_notify(f,MS_TONE_DETECTOR_EVENT,&event);
+							strncpy(event->tone_name,tone_def->tone_name,sizeof(event->tone_name));
+							event->tone_start_time=gs->starttime;
+							events=bctbx_list_append(events,event);
 							gs->event_sent=TRUE;
 						}
 					}else{
@@ -187,11 +293,18 @@ static void detector_process(MSFilter *f){
 			}else end_all_tones(s);
 		}
 	}
+	ms_filter_unlock(f);
+	/*the listeners may call the methods of the filter, they are notified once the lock is released*/
+	for(elem=events;elem!=NULL;elem=elem->next){
+		ms_filter_notify(f,MS_TONE_DETECTOR_EVENT,elem->data);
+	}
+	bctbx_list_free_with_data(events,ms_free);
 }
 
 static MSFilterMethod detector_methods[]={
 	{	MS_TONE_DETECTOR_ADD_SCAN, 		detector_add_scan	},
 	{	MS_TONE_DETECTOR_CLEAR_SCANS,	detector_clear_scans	},
+	{	MS_TONE_DETECTOR_GET_ENERGIES,	detector_get_energies	},
 	{	MS_FILTER_SET_SAMPLE_RATE,	detector_set_rate	},
 	{	0	,	NULL}
 };
@@ -31,6 +31,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/msfilter.h"
 #include "mediastreamer2/mseventqueue.h"
+#include "mediastreamer2/msworkerpool.h"
 #include "basedescs.h"
 
 #if !defined(_WIN32_WCE)
@@ -69,6 +70,7 @@ MS2_DEPRECATED static MSFactory *fallback_factory=NULL;
 static void ms_fmt_descriptor_destroy(MSFmtDescriptor *obj);
 
 #define DEFAULT_MAX_PAYLOAD_SIZE 1440
+#define DTLS_WORKER_THREADS 2
 
 int ms_factory_get_payload_max_size(MSFactory *factory){
 	return factory->max_payload_size;
@@ -107,6 +109,32 @@ void ms_factory_set_cpu_count(MSFactory *obj, unsigned int c) {
 	obj->cpu_count = c;
 }
 
+MSWorkerPool * ms_factory_get_worker_pool(MSFactory *obj) {
+	MSWorkerPool *pool;
+	ms_mutex_lock(&obj->worker_pool_lock);
+	if (obj->worker_pool == NULL) {
+		obj->worker_pool = ms_worker_pool_new(MAX(1, obj->cpu_count));
+	}
+	pool = obj->worker_pool;
+	ms_mutex_unlock(&obj->worker_pool_lock);
+	return pool;
+}
+
+MSWorkerPool * ms_factory_get_dtls_worker_pool(MSFactory *obj) {
+	MSWorkerPool *pool;
+	ms_mutex_lock(&obj->worker_pool_lock);
+	if (obj->dtls_worker_pool == NULL) {
+		obj->dtls_worker_pool = ms_worker_pool_new(MIN(DTLS_WORKER_THREADS, MAX(1, obj->cpu_count)));
+	}
+	pool = obj->dtls_worker_pool;
+	ms_mutex_unlock(&obj->worker_pool_lock);
+	return pool;
+}
+
+struct _MSStaticImageCache * ms_factory_get_static_image_cache(MSFactory *obj) {
+	return obj->static_image_cache;
+}
+
 void ms_factory_add_platform_tag(MSFactory *obj, const char *tag) {
 	if ((tag == NULL) || (tag[0] == '\0')) return;
 	if (bctbx_list_find_custom(obj->platform_tags, (bctbx_compare_func)strcasecmp, tag) == NULL) {
@@ -141,15 +169,31 @@ static MSFilterStats *find_or_create_stats(MSFactory *factory, MSFilterDesc *des
 	return ret;
 }
 
-void ms_factory_init(MSFactory *obj){
-	int i;
+unsigned int ms_factory_detect_cpu_count(void){
 	long num_cpu=1;
-	char *debug_log_enabled = NULL;
-	char *tags;
 #ifdef _WIN32
 	SYSTEM_INFO sysinfo;
 #endif
 
+#ifdef _WIN32 /*fixme to be tested*/
+	GetNativeSystemInfo( &sysinfo );
+
+	num_cpu = sysinfo.dwNumberOfProcessors;
+#elif __APPLE__ || __linux
+	num_cpu = sysconf( _SC_NPROCESSORS_CONF); /*check the number of processors configured, not just the one that are currently active.*/
+#elif __QNX__
+	num_cpu = _syspage_ptr->num_cpu;
+#else
+#warning "There is no code that detects the number of CPU for this platform."
+#endif
+	return num_cpu>0 ? (unsigned int)num_cpu : 1;
+}
+
+void ms_factory_init(MSFactory *obj){
+	int i;
+	char *debug_log_enabled = NULL;
+	char *tags;
+
 #if defined(ENABLE_NLS)
 	bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
 #endif
@@ -166,18 +210,8 @@ void ms_factory_init(MSFactory *obj){
 		ms_factory_register_filter(obj,ms_base_filter_descs[i]);
 	}
 
-#ifdef _WIN32 /*fixme to be tested*/
-	GetNativeSystemInfo( &sysinfo );
-
-	num_cpu = sysinfo.dwNumberOfProcessors;
-#elif __APPLE__ || __linux
-	num_cpu = sysconf( _SC_NPROCESSORS_CONF); /*check the number of processors configured, not just the one that are currently active.*/
-#elif __QNX__
-	num_cpu = _syspage_ptr->num_cpu;
-#else
-#warning "There is no code that detects the number of CPU for this platform."
-#endif
-	ms_factory_set_cpu_count(obj,num_cpu);
+	ms_factory_set_cpu_count(obj,ms_factory_detect_cpu_count());
+	ms_mutex_init(&obj->worker_pool_lock,NULL);
 	ms_factory_set_mtu(obj,MS_MTU_DEFAULT);
 #ifdef _WIN32
 	ms_factory_add_platform_tag(obj, "win32");
@@ -235,6 +269,9 @@ void ms_factory_destroy(MSFactory *factory){
 	if (factory->voip_uninit_func) factory->voip_uninit_func(factory);
 	ms_factory_uninit_plugins(factory);
 	if (factory->evq) ms_factory_destroy_event_queue(factory);
+	if (factory->worker_pool) ms_worker_pool_destroy(factory->worker_pool);
+	if (factory->dtls_worker_pool) ms_worker_pool_destroy(factory->dtls_worker_pool);
+	ms_mutex_destroy(&factory->worker_pool_lock);
 	factory->formats=bctbx_list_free_with_data(factory->formats,(void(*)(void*))ms_fmt_descriptor_destroy);
 	factory->desc_list=bctbx_list_free(factory->desc_list);
 	bctbx_list_for_each(factory->stats_list,ms_free);
@@ -447,6 +484,8 @@ void ms_factory_reset_statistics(MSFactory *obj){
 		MSFilterStats *stats=(MSFilterStats *)elem->data;
 		stats->elapsed=0;
 		stats->count=0;
+		stats->scaling_elapsed=0;
+		stats->scaling_count=0;
 	}
 }
 
@@ -461,6 +500,7 @@ void ms_factory_log_statistics(MSFactory *obj){
 	bctbx_list_t *sorted=NULL;
 	bctbx_list_t *elem;
 	uint64_t total=1;
+	bool_t scaling_header=FALSE;
 	for(elem=obj->stats_list;elem!=NULL;elem=elem->next){
 		MSFilterStats *stats=(MSFilterStats *)elem->data;
 		sorted=bctbx_list_insert_sorted(sorted,stats,(bctbx_compare_func)usage_compare);
@@ -477,6 +517,17 @@ void ms_factory_log_statistics(MSFactory *obj){
 		ms_message("%-19s %-9i %-19g %-10g",stats->name,stats->count,tpt,percentage);
 	}
 	ms_message("===========================================================");
+	for(elem=sorted;elem!=NULL;elem=elem->next){
+		MSFilterStats *stats=(MSFilterStats *)elem->data;
+		if (stats->scaling_count==0) continue;
+		if (!scaling_header){
+			ms_message("Name                Pictures  Scaling time/picture (ms)");
+			ms_message("-----------------------------------------------------------");
+			scaling_header=TRUE;
+		}
+		ms_message("%-19s %-9i %-19g",stats->name,stats->scaling_count,((double)stats->scaling_elapsed*1e-6)/(double)stats->scaling_count);
+	}
+	if (scaling_header) ms_message("===========================================================");
 	bctbx_list_free(sorted);
 }
 
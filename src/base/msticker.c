@@ -47,6 +47,11 @@ static uint64_t get_cur_time_ms(void *);
 static int wait_next_tick(void *, uint64_t virt_ticker_time);
 static void remove_tasks_for_filter(MSTicker *ticker, MSFilter *f);
 
+typedef struct _MSTickerCallbackEntry{
+	MSTickerCallback func;
+	void *user_data;
+}MSTickerCallbackEntry;
+
 static void ms_ticker_start(MSTicker *s){
 	s->run=TRUE;
 	ms_thread_create(&s->thread,NULL,ms_ticker_run,s);
@@ -57,6 +62,7 @@ static void ms_ticker_init(MSTicker *ticker, const MSTickerParams *params)
 	ms_mutex_init(&ticker->lock,NULL);
 	ticker->execution_list=NULL;
 	ticker->task_list=NULL;
+	ticker->tick_end_callbacks=NULL;
 	ticker->ticks=1;
 	ticker->time=0;
 	ticker->interval=TICKER_INTERVAL;
@@ -108,6 +114,10 @@ void ms_ticker_set_priority(MSTicker *ticker, MSTickerPrio prio){
 static void ms_ticker_uninit(MSTicker *ticker)
 {
 	ms_ticker_stop(ticker);
+	if (ticker->tick_end_callbacks){
+		ms_warning("%s: destroyed while having tick end callbacks registered.",ticker->name);
+		bctbx_list_free_with_data(ticker->tick_end_callbacks,ms_free);
+	}
 	ms_free(ticker->name);
 	ms_mutex_destroy(&ticker->lock);
 }
@@ -286,6 +296,37 @@ static void run_tasks(MSTicker *ticker){
 	ticker->task_list=NULL;
 }
 
+static void run_tick_end_callbacks(MSTicker *ticker){
+	bctbx_list_t *elem;
+	for (elem=ticker->tick_end_callbacks;elem!=NULL;elem=elem->next){
+		MSTickerCallbackEntry *entry=(MSTickerCallbackEntry*)elem->data;
+		entry->func(ticker,entry->user_data);
+	}
+}
+
+void ms_ticker_add_tick_end_callback(MSTicker *ticker, MSTickerCallback func, void *user_data){
+	MSTickerCallbackEntry *entry=ms_new0(MSTickerCallbackEntry,1);
+	entry->func=func;
+	entry->user_data=user_data;
+	ms_mutex_lock(&ticker->lock);
+	ticker->tick_end_callbacks=bctbx_list_append(ticker->tick_end_callbacks,entry);
+	ms_mutex_unlock(&ticker->lock);
+}
+
+void ms_ticker_remove_tick_end_callback(MSTicker *ticker, MSTickerCallback func, void *user_data){
+	bctbx_list_t *elem;
+	ms_mutex_lock(&ticker->lock);
+	for (elem=ticker->tick_end_callbacks;elem!=NULL;elem=elem->next){
+		MSTickerCallbackEntry *entry=(MSTickerCallbackEntry*)elem->data;
+		if (entry->func==func && entry->user_data==user_data){
+			ticker->tick_end_callbacks=bctbx_list_remove_link(ticker->tick_end_callbacks,elem);
+			ms_free(entry);
+			break;
+		}
+	}
+	ms_mutex_unlock(&ticker->lock);
+}
+
 static void remove_tasks_for_filter(MSTicker *ticker, MSFilter *f){
 	bctbx_list_t *elem,*nextelem;
 	for (elem=ticker->task_list;elem!=NULL;elem=nextelem){
@@ -434,6 +475,7 @@ void * ms_ticker_run(void *arg)
 #endif
 			run_tasks(s);
 			run_graphs(s,s->execution_list,FALSE);
+			run_tick_end_callbacks(s);
 #if TICKER_MEASUREMENTS
 			ms_get_cur_time(&end);
 			iload=100*((end.tv_sec-begin.tv_sec)*1000.0 + (end.tv_nsec-begin.tv_nsec)/1000000.0)/(double)s->interval;
@@ -0,0 +1,205 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "mediastreamer2/msworkerpool.h"
+
+typedef struct _MSWorkerJob{
+	struct _MSWorkerJob *next;
+	MSWorkerFunc func;
+	void *data;
+}MSWorkerJob;
+
+struct _MSWorkerPool{
+	ms_mutex_t lock;
+	ms_cond_t cond;
+	ms_thread_t *threads;
+	int nthreads;
+	MSWorkerJob *first;
+	MSWorkerJob *last;
+	bool_t run;
+};
+
+/*shared state of a ms_worker_pool_run() invocation. It is reference counted by the caller and the helper jobs, so that
+the caller does not wait for the helpers still queued behind other jobs: they find nothing left to do and release it*/
+typedef struct _MSWorkerBatch{
+	ms_mutex_t lock;
+	ms_cond_t cond;
+	MSWorkerFunc func;
+	void **data;
+	int count;
+	int next;
+	int done;
+	int refs;
+}MSWorkerBatch;
+
+static MSWorkerJob *ms_worker_pool_pop(MSWorkerPool *pool){
+	MSWorkerJob *job = pool->first;
+	if (job){
+		pool->first = job->next;
+		if (pool->first == NULL) pool->last = NULL;
+	}
+	return job;
+}
+
+static void *ms_worker_pool_thread(void *arg){
+	MSWorkerPool *pool = (MSWorkerPool*)arg;
+	MSWorkerJob *job;
+
+	ms_mutex_lock(&pool->lock);
+	while(1){
+		job = ms_worker_pool_pop(pool);
+		if (job == NULL){
+			if (!pool->run) break;
+			ms_cond_wait(&pool->cond, &pool->lock);
+			continue;
+		}
+		ms_mutex_unlock(&pool->lock);
+		job->func(job->data);
+		ms_free(job);
+		ms_mutex_lock(&pool->lock);
+	}
+	ms_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+MSWorkerPool *ms_worker_pool_new(int nthreads){
+	MSWorkerPool *pool = ms_new0(MSWorkerPool, 1);
+	int i;
+
+	ms_mutex_init(&pool->lock, NULL);
+	ms_cond_init(&pool->cond, NULL);
+	pool->run = TRUE;
+	if (nthreads > 0){
+		pool->threads = ms_new0(ms_thread_t, nthreads);
+		for (i = 0; i < nthreads; ++i){
+			if (ms_thread_create(&pool->threads[i], NULL, ms_worker_pool_thread, pool) != 0){
+				ms_error("MSWorkerPool: could not create thread %i", i);
+				break;
+			}
+		}
+		pool->nthreads = i;
+	}
+	ms_message("MSWorkerPool [%p] created with %i threads", pool, pool->nthreads);
+	return pool;
+}
+
+int ms_worker_pool_get_thread_count(const MSWorkerPool *pool){
+	return pool->nthreads;
+}
+
+void ms_worker_pool_post(MSWorkerPool *pool, MSWorkerFunc func, void *data){
+	MSWorkerJob *job;
+
+	if (pool->nthreads == 0){
+		func(data);
+		return;
+	}
+	job = ms_new0(MSWorkerJob, 1);
+	job->func = func;
+	job->data = data;
+	ms_mutex_lock(&pool->lock);
+	if (pool->last) pool->last->next = job;
+	else pool->first = job;
+	pool->last = job;
+	ms_cond_signal(&pool->cond);
+	ms_mutex_unlock(&pool->lock);
+}
+
+static void ms_worker_batch_unref(MSWorkerBatch *batch){
+	bool_t last;
+
+	ms_mutex_lock(&batch->lock);
+	last = (--batch->refs == 0);
+	ms_mutex_unlock(&batch->lock);
+	if (last){
+		ms_cond_destroy(&batch->cond);
+		ms_mutex_destroy(&batch->lock);
+		ms_free(batch);
+	}
+}
+
+/*runs the jobs of a batch until none is left. The data array belongs to the caller of ms_worker_pool_run(),
+it is not accessed anymore once all the jobs are claimed*/
+static void ms_worker_batch_process(MSWorkerBatch *batch){
+	int index;
+
+	ms_mutex_lock(&batch->lock);
+	while (batch->next < batch->count){
+		index = batch->next++;
+		ms_mutex_unlock(&batch->lock);
+		batch->func(batch->data[index]);
+		ms_mutex_lock(&batch->lock);
+		if (++batch->done == batch->count) ms_cond_signal(&batch->cond);
+	}
+	ms_mutex_unlock(&batch->lock);
+}
+
+static void ms_worker_batch_helper(void *data){
+	MSWorkerBatch *batch = (MSWorkerBatch*)data;
+
+	ms_worker_batch_process(batch);
+	ms_worker_batch_unref(batch);
+}
+
+void ms_worker_pool_run(MSWorkerPool *pool, MSWorkerFunc func, void **data, int count){
+	MSWorkerBatch *batch;
+	int i, nhelpers;
+
+	if (count <= 0) return;
+	if (pool == NULL || pool->nthreads == 0 || count == 1){
+		for (i = 0; i < count; ++i) func(data[i]);
+		return;
+	}
+	batch = ms_new0(MSWorkerBatch, 1);
+	ms_mutex_init(&batch->lock, NULL);
+	ms_cond_init(&batch->cond, NULL);
+	batch->func = func;
+	batch->data = data;
+	batch->count = count;
+	nhelpers = MIN(count - 1, pool->nthreads);
+	batch->refs = nhelpers + 1;
+	for (i = 0; i < nhelpers; ++i){
+		ms_worker_pool_post(pool, ms_worker_batch_helper, batch);
+	}
+	ms_worker_batch_process(batch);
+
+	/*only wait for the jobs claimed by helpers to finish, not for the helpers that haven't started yet*/
+	ms_mutex_lock(&batch->lock);
+	while (batch->done < batch->count){
+		ms_cond_wait(&batch->cond, &batch->lock);
+	}
+	ms_mutex_unlock(&batch->lock);
+	ms_worker_batch_unref(batch);
+}
+
+void ms_worker_pool_destroy(MSWorkerPool *pool){
+	int i;
+
+	ms_mutex_lock(&pool->lock);
+	pool->run = FALSE;
+	ms_cond_broadcast(&pool->cond);
+	ms_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->nthreads; ++i){
+		ms_thread_join(pool->threads[i], NULL);
+	}
+	if (pool->threads) ms_free(pool->threads);
+	ms_cond_destroy(&pool->cond);
+	ms_mutex_destroy(&pool->lock);
+	ms_free(pool);
+}
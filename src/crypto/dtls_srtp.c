@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/mediastream.h"
 #include "mediastreamer2/dtls_srtp.h"
+#include "mediastreamer2/msworkerpool.h"
 
 #ifdef _WIN32
 #include <malloc.h>
@@ -58,6 +59,16 @@ typedef struct _DtlsRawPacket {
 
 #define READ_TIMEOUT_MS 1000
 
+/**
+ * a handshake step run by a thread of the worker pool, one per channel
+ */
+typedef struct _DtlsHandshakeJob {
+	struct _MSDtlsSrtpContext *ctx;
+	bool_t is_rtp;
+	bool_t pending; /**< the job is queued or running */
+	bool_t completed; /**< the handshake completed and the keys are waiting to be given to srtp */
+} DtlsHandshakeJob;
+
 struct _MSDtlsSrtpContext{
 	MSMediaStreamSessions *stream_sessions;
 	MSDtlsSrtpRole role; /**< can be unset(at init on caller side), client or server */
@@ -77,6 +88,15 @@ struct _MSDtlsSrtpContext{
 
 	uint64_t rtp_time_reference; /**< an epoch in ms, used to manage retransmission when we are client */
 	uint64_t rtcp_time_reference; /**< an epoch in ms, used to manage retransmission when we are client */
+
+	MSWorkerPool *worker_pool; /**< when set, the handshake steps are computed by this pool instead of the thread receiving the packets */
+	DtlsHandshakeJob rtp_job;
+	DtlsHandshakeJob rtcp_job;
+	ms_mutex_t jobs_mutex; /**< protects the incoming buffers, the jobs and the stats */
+	ms_cond_t jobs_cond; /**< signaled when a job is over */
+
+	uint64_t handshake_start; /**< an epoch in ms, when the handshake started on RTP channel */
+	MSDtlsSrtpStats stats;
 };
 
 /***********************************************/
@@ -121,6 +141,39 @@ static ORTP_INLINE uint64_t get_timeval_in_millis(void) {
 	return (1000LL*t.tv_sec)+(t.tv_usec/1000LL);
 }
 
+static ORTP_INLINE uint64_t get_timeval_in_micros(void) {
+	struct timeval t;
+	ortp_gettimeofday(&t,NULL);
+	return (1000000LL*t.tv_sec)+t.tv_usec;
+}
+
+/**
+ * Run the bctoolbox handshake and account the time spent computing it.
+ * Must be called with the ssl context mutex locked.
+ */
+static int ms_dtls_srtp_handshake_step(MSDtlsSrtpContext *ctx, bctbx_ssl_context_t *ssl) {
+	uint64_t start = get_timeval_in_micros();
+	int ret = bctbx_ssl_handshake(ssl);
+	uint64_t elapsed = get_timeval_in_micros() - start;
+
+	ms_mutex_lock(&ctx->jobs_mutex);
+	ctx->stats.handshake_processing_time += elapsed;
+	if (elapsed > ctx->stats.handshake_max_step_time) ctx->stats.handshake_max_step_time = elapsed;
+	ctx->stats.handshake_steps++;
+	ms_mutex_unlock(&ctx->jobs_mutex);
+	return ret;
+}
+
+static void ms_dtls_srtp_log_handshake_error(MSDtlsSrtpContext *ctx, int ret) {
+	/* report the error in logs only when different than requested read(waiting for data) */
+	if (ret<0 && ret != BCTBX_ERROR_NET_WANT_READ) {
+		char err_str[512];
+		err_str[0]='\0';
+		bctbx_strerror(ret, err_str, 512);
+		ms_warning("DTLS handhake returns -0x%x : %s [on sessions: %p rtp session %p]", -ret, err_str, ctx->stream_sessions, ctx->stream_sessions->rtp_session);
+	}
+}
+
 /**
  * @Brief Compute the certificate fingerprint(hash of DER formated certificate)
  * hash function to use shall be the same used by certificate signature(this is a way to ensure that the hash function is available at both ends as they already agreed on certificate)
@@ -192,44 +245,56 @@ static MSCryptoSuite ms_dtls_srtp_bctbx_protection_profile_to_ms_crypto_suite(bc
 			return MS_NO_CIPHER_SHA1_80;
 		case BCTBX_SRTP_NULL_HMAC_SHA1_32: /* this profile is defined in DTLS-SRTP rfc but not implemented by libsrtp */
 			return MS_CRYPTO_SUITE_INVALID;
+		/* the AEAD_AES_128_GCM and AEAD_AES_256_GCM profiles (RFC 7714) are not negotiated by the bctoolbox DTLS stack yet,
+		 * they can only be used with keys exchanged through SDES */
 		default:
 			return MS_CRYPTO_SUITE_INVALID;
 	}
 }
 
-static void schedule_rtp(struct _RtpTransportModifier *t) {
-	MSDtlsSrtpContext *ctx = (MSDtlsSrtpContext *)t->data;
-	/* it is not a dtls packet, but manage anyway the retransmission timer */
-	if (ctx->role == MSDtlsSrtpRoleIsClient) { /* only if we are client */
-		uint64_t current_time = get_timeval_in_millis();
-		if (ctx->rtp_time_reference>0) { /* only when retransmission timer is armed */
-			if (current_time - ctx->rtp_time_reference > READ_TIMEOUT_MS) {
-				ms_message("DTLS repeating rtp ssl_handshake for context [%p]",ctx);
-				ms_mutex_lock(&ctx->rtp_dtls_context->ssl_context_mutex);
-				bctbx_ssl_handshake(ctx->rtp_dtls_context->ssl);
-				ms_mutex_unlock(&ctx->rtp_dtls_context->ssl_context_mutex);
-				ctx->rtp_time_reference = get_timeval_in_millis();
-			}
+/**
+ * Run by a thread of the worker pool: feed the DTLS engine with the packets received on the channel until it waits for more.
+ */
+static void ms_dtls_srtp_handshake_job(void *data) {
+	DtlsHandshakeJob *job = (DtlsHandshakeJob *)data;
+	MSDtlsSrtpContext *ctx = job->ctx;
+	DtlsBcToolBoxContext *dtls_context = (job->is_rtp == TRUE)?ctx->rtp_dtls_context:ctx->rtcp_dtls_context;
+	DtlsRawPacket **incoming_buffer = (job->is_rtp == TRUE)?&ctx->rtp_incoming_buffer:&ctx->rtcp_incoming_buffer;
+	int ret;
+
+	while (1) {
+		ms_mutex_lock(&dtls_context->ssl_context_mutex);
+		ret = ms_dtls_srtp_handshake_step(ctx, dtls_context->ssl);
+		ms_mutex_unlock(&dtls_context->ssl_context_mutex);
+		ms_dtls_srtp_log_handshake_error(ctx, ret);
+
+		ms_mutex_lock(&ctx->jobs_mutex);
+		/* packets may have been queued once the engine had read the buffer */
+		if (ret == BCTBX_ERROR_NET_WANT_READ && *incoming_buffer != NULL) {
+			ms_mutex_unlock(&ctx->jobs_mutex);
+			continue;
 		}
+		if (ret == 0) job->completed = TRUE;
+		job->pending = FALSE;
+		ms_cond_signal(&ctx->jobs_cond);
+		ms_mutex_unlock(&ctx->jobs_mutex);
+		return;
 	}
-
 }
-static void schedule_rtcp(struct _RtpTransportModifier *t) {
-	MSDtlsSrtpContext *ctx = (MSDtlsSrtpContext *)t->data;
-	if (ctx->role == MSDtlsSrtpRoleIsClient) { /* only if we are client */
-		uint64_t current_time = get_timeval_in_millis();
-		if (ctx->rtcp_time_reference>0) { /* only when retransmission timer is armed */
-			if (current_time - ctx->rtcp_time_reference > READ_TIMEOUT_MS) {
-				ms_message("DTLS repeating rtcp ssl_handshake for context [%p]",ctx);
-				ms_mutex_lock(&ctx->rtcp_dtls_context->ssl_context_mutex);
-				bctbx_ssl_handshake(ctx->rtcp_dtls_context->ssl);
-				ms_mutex_unlock(&ctx->rtcp_dtls_context->ssl_context_mutex);
-				ctx->rtcp_time_reference = get_timeval_in_millis();
-			}
-		}
 
+static void ms_dtls_srtp_post_handshake_job(MSDtlsSrtpContext *ctx, bool_t is_rtp) {
+	DtlsHandshakeJob *job = (is_rtp == TRUE)?&ctx->rtp_job:&ctx->rtcp_job;
+	bool_t post = FALSE;
+
+	ms_mutex_lock(&ctx->jobs_mutex);
+	if (!job->pending) { /* a running job reads the packets queued meanwhile */
+		job->pending = TRUE;
+		post = TRUE;
 	}
+	ms_mutex_unlock(&ctx->jobs_mutex);
+	if (post) ms_worker_pool_post(ctx->worker_pool, ms_dtls_srtp_handshake_job, job);
 }
+
 /**
  * Check if the incoming message is a DTLS packet.
  * If it is, store it in the context incoming buffer and call the polarssl function wich will process it.
@@ -269,6 +334,7 @@ static bool_t ms_dtls_srtp_process_dtls_packet(mblk_t *msg, MSDtlsSrtpContext *c
 		ms_message("DTLS Receive %s packet len %d sessions: %p rtp session %p", is_rtp==TRUE?"RTP":"RTCP", (int)msgLength, ctx->stream_sessions, ctx->stream_sessions->rtp_session);
 
 		/* store the packet in the incoming buffer */
+		ms_mutex_lock(&ctx->jobs_mutex);
 		if (is_rtp == TRUE) {
 			if (ctx->rtp_incoming_buffer==NULL) { /* buffer is empty */
 				ctx->rtp_incoming_buffer = incoming_dtls_packet;
@@ -286,7 +352,8 @@ static bool_t ms_dtls_srtp_process_dtls_packet(mblk_t *msg, MSDtlsSrtpContext *c
 				last_packet->next = incoming_dtls_packet;
 			}
 		}
-		
+		ms_mutex_unlock(&ctx->jobs_mutex);
+
 		/* while DTLS handshake is on going route DTLS packets to bctoolbox engine through ssl_handshake() */
 		if (channel_status != DTLS_STATUS_HANDSHAKE_OVER) {
 			/* role is unset but we receive a packet: we are caller and shall initialise as server and then process the incoming packet */
@@ -294,9 +361,18 @@ static bool_t ms_dtls_srtp_process_dtls_packet(mblk_t *msg, MSDtlsSrtpContext *c
 				ms_dtls_srtp_set_role(ctx, MSDtlsSrtpRoleIsServer); /* this call will update role and complete server setup */
 				ms_dtls_srtp_start(ctx); /* complete the ssl setup and change channel_status to DTLS_STATUS_HANDSHAKE_ONGOING on both RTP and RTCP channel*/
 			}
+			if (ctx->worker_pool != NULL) {
+				/* the packet is processed by the worker pool, the keys are given to srtp by the schedule functions once the handshake is over */
+				ms_dtls_srtp_post_handshake_job(ctx, is_rtp);
+				*ret = BCTBX_ERROR_NET_WANT_READ;
+				if (ctx->role == MSDtlsSrtpRoleIsClient) {
+					*time_reference = get_timeval_in_millis();
+				}
+				return TRUE;
+			}
 			ms_mutex_lock(mutex);
 			/* process the packet and store result */
-			*ret = bctbx_ssl_handshake(ssl);
+			*ret = ms_dtls_srtp_handshake_step(ctx, ssl);
 
 			/* if we are client, manage the retransmission timer */
 			if (ctx->role == MSDtlsSrtpRoleIsClient) {
@@ -309,15 +385,10 @@ static bool_t ms_dtls_srtp_process_dtls_packet(mblk_t *msg, MSDtlsSrtpContext *c
 			ms_mutex_lock(mutex);
 			*ret = bctbx_ssl_read(ssl, buf, msgLength);
 			ms_mutex_unlock(mutex);
+			ms_free(buf);
 		}
 
-		/* report the error in logs only when different than requested read(waiting for data) */
-		if (*ret<0 && *ret != BCTBX_ERROR_NET_WANT_READ) {
-			char err_str[512];
-			err_str[0]='\0';
-			bctbx_strerror(*ret, err_str, 512);
-			ms_warning("DTLS handhake returns -0x%x : %s [on sessions: %p rtp session %p]", -*ret, err_str, ctx->stream_sessions, ctx->stream_sessions->rtp_session);
-		}
+		ms_dtls_srtp_log_handshake_error(ctx, *ret);
 
 		return TRUE;
 	}
@@ -417,17 +488,21 @@ static int ms_dtls_srtp_rtcp_sendData (void *ctx, const unsigned char *data, siz
 
 static int ms_dtls_srtp_rtp_DTLSread (void *ctx, unsigned char *buf, size_t len) {
 	MSDtlsSrtpContext *context = (MSDtlsSrtpContext *)ctx;
+	DtlsRawPacket *packet;
 
 	/* do we have something in the incoming buffer */
-	if (context->rtp_incoming_buffer == NULL) {
+	ms_mutex_lock(&context->jobs_mutex);
+	packet = context->rtp_incoming_buffer;
+	if (packet != NULL) context->rtp_incoming_buffer = packet->next;
+	ms_mutex_unlock(&context->jobs_mutex);
+
+	if (packet == NULL) {
 		return BCTBX_ERROR_NET_WANT_READ;
 	} else { /* read the first packet in the buffer and delete it */
-		DtlsRawPacket *next_packet = context->rtp_incoming_buffer->next;
-		size_t dataLength = context->rtp_incoming_buffer->length;
-		memcpy(buf, context->rtp_incoming_buffer->data, dataLength);
-		ms_free(context->rtp_incoming_buffer->data);
-		ms_free(context->rtp_incoming_buffer);
-		context->rtp_incoming_buffer = next_packet;
+		size_t dataLength = packet->length;
+		memcpy(buf, packet->data, dataLength);
+		ms_free(packet->data);
+		ms_free(packet);
 
 		return dataLength;
 	}
@@ -435,17 +510,21 @@ static int ms_dtls_srtp_rtp_DTLSread (void *ctx, unsigned char *buf, size_t len)
 
 static int ms_dtls_srtp_rtcp_DTLSread (void *ctx, unsigned char *buf, size_t len) {
 	MSDtlsSrtpContext *context = (MSDtlsSrtpContext *)ctx;
+	DtlsRawPacket *packet;
 
 	/* do we have something in the incoming buffer */
-	if (context->rtcp_incoming_buffer == NULL) {
+	ms_mutex_lock(&context->jobs_mutex);
+	packet = context->rtcp_incoming_buffer;
+	if (packet != NULL) context->rtcp_incoming_buffer = packet->next;
+	ms_mutex_unlock(&context->jobs_mutex);
+
+	if (packet == NULL) {
 		return BCTBX_ERROR_NET_WANT_READ;
 	} else { /* read the first packet in the buffer and delete it */
-		DtlsRawPacket *next_packet = context->rtcp_incoming_buffer->next;
-		size_t dataLength = context->rtcp_incoming_buffer->length;
-		memcpy(buf, context->rtcp_incoming_buffer->data, dataLength);
-		ms_free(context->rtcp_incoming_buffer->data);
-		ms_free(context->rtcp_incoming_buffer);
-		context->rtcp_incoming_buffer = next_packet;
+		size_t dataLength = packet->length;
+		memcpy(buf, packet->data, dataLength);
+		ms_free(packet->data);
+		ms_free(packet);
 
 		return dataLength;
 	}
@@ -464,6 +543,202 @@ static int ms_dtls_srtp_rtcp_DTLSread (void *ctx, unsigned char *buf, size_t len
 /*******************************************************/
 /**** Transport Modifier Sender/Receiver functions  ****/
 
+/* handshake is over, give the keys to srtp : 128 bits client write - 128 bits server write - 112 bits client salt - 112 server salt */
+static void ms_dtls_srtp_rtp_handshake_over(MSDtlsSrtpContext *ctx) {
+	int ret;
+	MSCryptoSuite agreed_srtp_protection_profile = MS_CRYPTO_SUITE_INVALID;
+
+	ctx->rtp_channel_status = DTLS_STATUS_HANDSHAKE_OVER;
+
+	ms_mutex_lock(&ctx->jobs_mutex);
+	ctx->stats.handshake_duration = get_timeval_in_millis() - ctx->handshake_start;
+	ms_message("DTLS handshake on RTP channel over in %llu ms, %llu us spent computing %i steps [context %p]", (unsigned long long)ctx->stats.handshake_duration
+		, (unsigned long long)ctx->stats.handshake_processing_time, ctx->stats.handshake_steps, ctx);
+	ms_mutex_unlock(&ctx->jobs_mutex);
+
+	/* check the srtp profile get selected during handshake */
+	agreed_srtp_protection_profile = ms_dtls_srtp_bctbx_protection_profile_to_ms_crypto_suite(bctbx_ssl_get_dtls_srtp_protection_profile(ctx->rtp_dtls_context->ssl));
+	if ( agreed_srtp_protection_profile == MS_CRYPTO_SUITE_INVALID) {
+		ms_message("DTLS Handshake successful but unable to agree on srtp_profile to use");
+	} else {
+		if (ms_dtls_srtp_check_certificate_fingerprint(bctbx_ssl_get_peer_certificate(ctx->rtp_dtls_context->ssl), (const char *)(ctx->peer_fingerprint)) == 1) {
+			char dtls_srtp_key_material[128];
+			size_t dtls_srt_key_material_length = 128;
+			uint8_t *key = (uint8_t *)ms_malloc0(256);
+			ms_message("DTLS Handshake on RTP channel successful and fingerprints match, srtp protection profile %d", agreed_srtp_protection_profile);
+
+			ctx->rtp_time_reference = 0; /* unarm the timer */
+			ret = bctbx_ssl_get_dtls_srtp_key_material(ctx->rtp_dtls_context->ssl, dtls_srtp_key_material, &dtls_srt_key_material_length);
+			if (ret < 0) {
+				ms_error("DTLS RTP Handshake : Unable to retrieve DTLS SRTP key material [-0x%x]", -ret);
+				ms_free(key);
+				return;
+			}
+
+			if (ctx->role == MSDtlsSrtpRoleIsServer) {
+				/* reception(client write) key and salt +16bits padding */
+				memcpy(key, dtls_srtp_key_material, DTLS_SRTP_KEY_LEN);
+				memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN, DTLS_SRTP_SALT_LEN);
+				ms_media_stream_sessions_set_srtp_recv_key(ctx->stream_sessions, agreed_srtp_protection_profile, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTP_STREAM);
+				/* emission(server write) key and salt +16bits padding */
+				memcpy(key, dtls_srtp_key_material+DTLS_SRTP_KEY_LEN, DTLS_SRTP_KEY_LEN);
+				memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, DTLS_SRTP_SALT_LEN);
+				ms_media_stream_sessions_set_srtp_send_key(ctx->stream_sessions, agreed_srtp_protection_profile, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTP_STREAM);
+			} else if (ctx->role == MSDtlsSrtpRoleIsClient){ /* this enpoint act as DTLS client */
+				/* emission(client write) key and salt +16bits padding */
+				memcpy(key, dtls_srtp_key_material, DTLS_SRTP_KEY_LEN);
+				memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN, DTLS_SRTP_SALT_LEN);
+				ms_media_stream_sessions_set_srtp_send_key(ctx->stream_sessions, agreed_srtp_protection_profile, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTP_STREAM);
+				/* reception(server write) key and salt +16bits padding */
+				memcpy(key, dtls_srtp_key_material+DTLS_SRTP_KEY_LEN, DTLS_SRTP_KEY_LEN);
+				memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, DTLS_SRTP_SALT_LEN);
+				ms_media_stream_sessions_set_srtp_recv_key(ctx->stream_sessions, agreed_srtp_protection_profile, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTP_STREAM);
+			}
+
+			ms_free(key);
+
+			ms_dtls_srtp_check_channels_status(ctx);
+		}
+	}
+
+	if (ctx->role != MSDtlsSrtpRoleIsServer) { /* close the connection only if we are client, if we are server, the client may ask again for last packets */
+		/*FireFox version 43 requires DTLS channel to be kept openned, probably a bug in FireFox ret = ssl_close_notify( &(ctx->rtp_dtls_context->ssl) );*/
+		
+	}
+}
+
+/* rtcp handshake is over, give the keys to srtp : 128 bits client write - 128 bits server write - 112 bits client salt - 112 server salt */
+static void ms_dtls_srtp_rtcp_handshake_over(MSDtlsSrtpContext *ctx) {
+	int ret;
+	MSCryptoSuite agreed_srtp_protection_profile = MS_CRYPTO_SUITE_INVALID;
+
+	ctx->rtcp_channel_status = DTLS_STATUS_HANDSHAKE_OVER;
+
+	/* check the srtp profile get selected during handshake */
+	agreed_srtp_protection_profile = ms_dtls_srtp_bctbx_protection_profile_to_ms_crypto_suite(bctbx_ssl_get_dtls_srtp_protection_profile(ctx->rtcp_dtls_context->ssl));
+	if ( agreed_srtp_protection_profile == MS_CRYPTO_SUITE_INVALID) {
+		ms_error("DTLS RTCP Handshake successful but unable to agree on srtp_profile to use");
+	} else {
+		if (ms_dtls_srtp_check_certificate_fingerprint(bctbx_ssl_get_peer_certificate(ctx->rtcp_dtls_context->ssl), (const char *)(ctx->peer_fingerprint)) == 1) {
+			char dtls_srtp_key_material[128];
+			size_t dtls_srt_key_material_length = 128;
+			uint8_t *key = (uint8_t *)ms_malloc0(256);
+
+			ms_message("DTLS RTCP Handshake successful and fingerprints match, srtp protection profile %d", agreed_srtp_protection_profile);
+
+			ctx->rtcp_time_reference = 0; /* unarm the timer */
+
+			ret = bctbx_ssl_get_dtls_srtp_key_material(ctx->rtcp_dtls_context->ssl, dtls_srtp_key_material, &dtls_srt_key_material_length);
+			if (ret < 0) {
+				ms_error("DTLS RTCP Handshake : Unable to retrieve DTLS SRTP key material [-0x%x]", -ret);
+				ms_free(key);
+				return;
+			}
+
+			if (ctx->role == MSDtlsSrtpRoleIsServer) {
+				/* reception(client write) key and salt +16bits padding */
+				memcpy(key, dtls_srtp_key_material, DTLS_SRTP_KEY_LEN);
+				memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN, DTLS_SRTP_SALT_LEN);
+				ms_media_stream_sessions_set_srtp_recv_key(ctx->stream_sessions, MS_AES_128_SHA1_80, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTCP_STREAM);
+				/* emission(server write) key and salt +16bits padding */
+				memcpy(key, dtls_srtp_key_material+DTLS_SRTP_KEY_LEN, DTLS_SRTP_KEY_LEN);
+				memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, DTLS_SRTP_SALT_LEN);
+				ms_media_stream_sessions_set_srtp_send_key(ctx->stream_sessions, MS_AES_128_SHA1_80, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTCP_STREAM);
+			} else if (ctx->role == MSDtlsSrtpRoleIsClient){ /* this enpoint act as DTLS client */
+				/* emission(client write) key and salt +16bits padding */
+				memcpy(key, dtls_srtp_key_material, DTLS_SRTP_KEY_LEN);
+				memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN, DTLS_SRTP_SALT_LEN);
+				ms_media_stream_sessions_set_srtp_send_key(ctx->stream_sessions, MS_AES_128_SHA1_80, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTCP_STREAM);
+				/* reception(server write) key and salt +16bits padding */
+				memcpy(key, dtls_srtp_key_material+DTLS_SRTP_KEY_LEN, DTLS_SRTP_KEY_LEN);
+				memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, DTLS_SRTP_SALT_LEN);
+				ms_media_stream_sessions_set_srtp_recv_key(ctx->stream_sessions, MS_AES_128_SHA1_80, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTCP_STREAM);
+			}
+
+			ms_free(key);
+
+			ms_dtls_srtp_check_channels_status(ctx);
+		}
+	}
+
+	if (ctx->role != MSDtlsSrtpRoleIsServer) { /* close the connection only if we are client, if we are server, the client may ask again for last packets */
+	/*FireFox version 43 requires DTLS channel to be kept openned, probably a bug in FireFox  ret = ssl_close_notify( &(ctx->rtcp_dtls_context->ssl) );*/
+	}
+}
+
+/**
+ * Give the keys to srtp once a handshake computed by the worker pool is over. Called by the thread receiving the packets.
+ */
+static void ms_dtls_srtp_apply_handshake_job(MSDtlsSrtpContext *ctx, bool_t is_rtp) {
+	DtlsHandshakeJob *job = (is_rtp == TRUE)?&ctx->rtp_job:&ctx->rtcp_job;
+	DtlsBcToolBoxContext *dtls_context = (is_rtp == TRUE)?ctx->rtp_dtls_context:ctx->rtcp_dtls_context;
+	uint8_t channel_status = (is_rtp == TRUE)?(ctx->rtp_channel_status):(ctx->rtcp_channel_status);
+	bool_t completed;
+
+	ms_mutex_lock(&ctx->jobs_mutex);
+	completed = job->completed;
+	job->completed = FALSE;
+	ms_mutex_unlock(&ctx->jobs_mutex);
+
+	if (completed && channel_status == DTLS_STATUS_HANDSHAKE_ONGOING) {
+		ms_mutex_lock(&dtls_context->ssl_context_mutex);
+		if (is_rtp == TRUE) {
+			ms_dtls_srtp_rtp_handshake_over(ctx);
+		} else {
+			ms_dtls_srtp_rtcp_handshake_over(ctx);
+		}
+		ms_mutex_unlock(&dtls_context->ssl_context_mutex);
+	}
+}
+
+static void schedule_rtp(struct _RtpTransportModifier *t) {
+	MSDtlsSrtpContext *ctx = (MSDtlsSrtpContext *)t->data;
+	if (ctx->worker_pool != NULL) {
+		ms_dtls_srtp_apply_handshake_job(ctx, TRUE);
+	}
+	/* it is not a dtls packet, but manage anyway the retransmission timer */
+	if (ctx->role == MSDtlsSrtpRoleIsClient) { /* only if we are client */
+		uint64_t current_time = get_timeval_in_millis();
+		if (ctx->rtp_time_reference>0) { /* only when retransmission timer is armed */
+			if (current_time - ctx->rtp_time_reference > READ_TIMEOUT_MS) {
+				ms_message("DTLS repeating rtp ssl_handshake for context [%p]",ctx);
+				if (ctx->worker_pool != NULL) {
+					ms_dtls_srtp_post_handshake_job(ctx, TRUE);
+				} else {
+					ms_mutex_lock(&ctx->rtp_dtls_context->ssl_context_mutex);
+					ms_dtls_srtp_handshake_step(ctx, ctx->rtp_dtls_context->ssl);
+					ms_mutex_unlock(&ctx->rtp_dtls_context->ssl_context_mutex);
+				}
+				ctx->rtp_time_reference = get_timeval_in_millis();
+			}
+		}
+	}
+
+}
+static void schedule_rtcp(struct _RtpTransportModifier *t) {
+	MSDtlsSrtpContext *ctx = (MSDtlsSrtpContext *)t->data;
+	if (ctx->worker_pool != NULL) {
+		ms_dtls_srtp_apply_handshake_job(ctx, FALSE);
+	}
+	if (ctx->role == MSDtlsSrtpRoleIsClient) { /* only if we are client */
+		uint64_t current_time = get_timeval_in_millis();
+		if (ctx->rtcp_time_reference>0) { /* only when retransmission timer is armed */
+			if (current_time - ctx->rtcp_time_reference > READ_TIMEOUT_MS) {
+				ms_message("DTLS repeating rtcp ssl_handshake for context [%p]",ctx);
+				if (ctx->worker_pool != NULL) {
+					ms_dtls_srtp_post_handshake_job(ctx, FALSE);
+				} else {
+					ms_mutex_lock(&ctx->rtcp_dtls_context->ssl_context_mutex);
+					ms_dtls_srtp_handshake_step(ctx, ctx->rtcp_dtls_context->ssl);
+					ms_mutex_unlock(&ctx->rtcp_dtls_context->ssl_context_mutex);
+				}
+				ctx->rtcp_time_reference = get_timeval_in_millis();
+			}
+		}
+
+	}
+}
+
 static int ms_dtls_srtp_rtp_process_on_receive(struct _RtpTransportModifier *t, mblk_t *msg){
 	MSDtlsSrtpContext *ctx = (MSDtlsSrtpContext *)t->data;
 
@@ -483,60 +758,8 @@ static int ms_dtls_srtp_rtp_process_on_receive(struct _RtpTransportModifier *t,
 	/* check if it is a DTLS packet and process it */
 	if (ms_dtls_srtp_process_dtls_packet(msg, ctx, &ret, TRUE) == TRUE){
 		
-		if ((ret==0) && (ctx->rtp_channel_status == DTLS_STATUS_HANDSHAKE_ONGOING)) { /* handshake is over, give the keys to srtp : 128 bits client write - 128 bits server write - 112 bits client salt - 112 server salt */
-			MSCryptoSuite agreed_srtp_protection_profile = MS_CRYPTO_SUITE_INVALID;
-
-			ctx->rtp_channel_status = DTLS_STATUS_HANDSHAKE_OVER;
-
-			/* check the srtp profile get selected during handshake */
-			agreed_srtp_protection_profile = ms_dtls_srtp_bctbx_protection_profile_to_ms_crypto_suite(bctbx_ssl_get_dtls_srtp_protection_profile(ctx->rtp_dtls_context->ssl));
-			if ( agreed_srtp_protection_profile == MS_CRYPTO_SUITE_INVALID) {
-				ms_message("DTLS Handshake successful but unable to agree on srtp_profile to use");
-			} else {
-				if (ms_dtls_srtp_check_certificate_fingerprint(bctbx_ssl_get_peer_certificate(ctx->rtp_dtls_context->ssl), (const char *)(ctx->peer_fingerprint)) == 1) {
-					char dtls_srtp_key_material[128];
-					size_t dtls_srt_key_material_length = 128;
-					uint8_t *key = (uint8_t *)ms_malloc0(256);
-					ms_message("DTLS Handshake on RTP channel successful and fingerprints match, srtp protection profile %d", agreed_srtp_protection_profile);
-
-					ctx->rtp_time_reference = 0; /* unarm the timer */
-					ret = bctbx_ssl_get_dtls_srtp_key_material(ctx->rtp_dtls_context->ssl, dtls_srtp_key_material, &dtls_srt_key_material_length);
-					if (ret < 0) {
-						ms_error("DTLS RTP Handshake : Unable to retrieve DTLS SRTP key material [-0x%x]", -ret);
-						return 0;
-					}
-
-					if (ctx->role == MSDtlsSrtpRoleIsServer) {
-						/* reception(client write) key and salt +16bits padding */
-						memcpy(key, dtls_srtp_key_material, DTLS_SRTP_KEY_LEN);
-						memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN, DTLS_SRTP_SALT_LEN);
-						ms_media_stream_sessions_set_srtp_recv_key(ctx->stream_sessions, agreed_srtp_protection_profile, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTP_STREAM);
-						/* emission(server write) key and salt +16bits padding */
-						memcpy(key, dtls_srtp_key_material+DTLS_SRTP_KEY_LEN, DTLS_SRTP_KEY_LEN);
-						memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, DTLS_SRTP_SALT_LEN);
-						ms_media_stream_sessions_set_srtp_send_key(ctx->stream_sessions, agreed_srtp_protection_profile, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTP_STREAM);
-					} else if (ctx->role == MSDtlsSrtpRoleIsClient){ /* this enpoint act as DTLS client */
-						/* emission(client write) key and salt +16bits padding */
-						memcpy(key, dtls_srtp_key_material, DTLS_SRTP_KEY_LEN);
-						memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN, DTLS_SRTP_SALT_LEN);
-						ms_media_stream_sessions_set_srtp_send_key(ctx->stream_sessions, agreed_srtp_protection_profile, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTP_STREAM);
-						/* reception(server write) key and salt +16bits padding */
-						memcpy(key, dtls_srtp_key_material+DTLS_SRTP_KEY_LEN, DTLS_SRTP_KEY_LEN);
-						memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, DTLS_SRTP_SALT_LEN);
-						ms_media_stream_sessions_set_srtp_recv_key(ctx->stream_sessions, agreed_srtp_protection_profile, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTP_STREAM);
-					}
-
-					ms_free(key);
-
-					ms_dtls_srtp_check_channels_status(ctx);
-				}
-			}
-
-			if (ctx->role != MSDtlsSrtpRoleIsServer) { /* close the connection only if we are client, if we are server, the client may ask again for last packets */
-				/*FireFox version 43 requires DTLS channel to be kept openned, probably a bug in FireFox ret = ssl_close_notify( &(ctx->rtp_dtls_context->ssl) );*/
-				
-			}
-
+		if ((ret==0) && (ctx->rtp_channel_status == DTLS_STATUS_HANDSHAKE_ONGOING)) {
+			ms_dtls_srtp_rtp_handshake_over(ctx);
 		}
 		return 0;
 	}
@@ -562,60 +785,8 @@ static int ms_dtls_srtp_rtcp_process_on_receive(struct _RtpTransportModifier *t,
 	/* check if it is a DTLS packet and process it */
 	if (ms_dtls_srtp_process_dtls_packet(msg, ctx, &ret, FALSE) == TRUE){
 
-		if ((ret==0) && (ctx->rtcp_channel_status == DTLS_STATUS_HANDSHAKE_ONGOING)) { /* rtcp handshake is over, give the keys to srtp : 128 bits client write - 128 bits server write - 112 bits client salt - 112 server salt */
-			MSCryptoSuite agreed_srtp_protection_profile = MS_CRYPTO_SUITE_INVALID;
-
-			ctx->rtcp_channel_status = DTLS_STATUS_HANDSHAKE_OVER;
-
-			/* check the srtp profile get selected during handshake */
-			agreed_srtp_protection_profile = ms_dtls_srtp_bctbx_protection_profile_to_ms_crypto_suite(bctbx_ssl_get_dtls_srtp_protection_profile(ctx->rtcp_dtls_context->ssl));
-			if ( agreed_srtp_protection_profile == MS_CRYPTO_SUITE_INVALID) {
-				ms_error("DTLS RTCP Handshake successful but unable to agree on srtp_profile to use");
-			} else {
-				if (ms_dtls_srtp_check_certificate_fingerprint(bctbx_ssl_get_peer_certificate(ctx->rtcp_dtls_context->ssl), (const char *)(ctx->peer_fingerprint)) == 1) {
-					char dtls_srtp_key_material[128];
-					size_t dtls_srt_key_material_length = 128;
-					uint8_t *key = (uint8_t *)ms_malloc0(256);
-
-					ms_message("DTLS RTCP Handshake successful and fingerprints match, srtp protection profile %d", agreed_srtp_protection_profile);
-
-					ctx->rtcp_time_reference = 0; /* unarm the timer */
-
-					ret = bctbx_ssl_get_dtls_srtp_key_material(ctx->rtcp_dtls_context->ssl, dtls_srtp_key_material, &dtls_srt_key_material_length);
-					if (ret < 0) {
-						ms_error("DTLS RTCP Handshake : Unable to retrieve DTLS SRTP key material [-0x%x]", -ret);
-						return 0;
-					}
-
-					if (ctx->role == MSDtlsSrtpRoleIsServer) {
-						/* reception(client write) key and salt +16bits padding */
-						memcpy(key, dtls_srtp_key_material, DTLS_SRTP_KEY_LEN);
-						memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN, DTLS_SRTP_SALT_LEN);
-						ms_media_stream_sessions_set_srtp_recv_key(ctx->stream_sessions, MS_AES_128_SHA1_80, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTCP_STREAM);
-						/* emission(server write) key and salt +16bits padding */
-						memcpy(key, dtls_srtp_key_material+DTLS_SRTP_KEY_LEN, DTLS_SRTP_KEY_LEN);
-						memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, DTLS_SRTP_SALT_LEN);
-						ms_media_stream_sessions_set_srtp_send_key(ctx->stream_sessions, MS_AES_128_SHA1_80, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTCP_STREAM);
-					} else if (ctx->role == MSDtlsSrtpRoleIsClient){ /* this enpoint act as DTLS client */
-						/* emission(client write) key and salt +16bits padding */
-						memcpy(key, dtls_srtp_key_material, DTLS_SRTP_KEY_LEN);
-						memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN, DTLS_SRTP_SALT_LEN);
-						ms_media_stream_sessions_set_srtp_send_key(ctx->stream_sessions, MS_AES_128_SHA1_80, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTCP_STREAM);
-						/* reception(server write) key and salt +16bits padding */
-						memcpy(key, dtls_srtp_key_material+DTLS_SRTP_KEY_LEN, DTLS_SRTP_KEY_LEN);
-						memcpy(key + DTLS_SRTP_KEY_LEN, dtls_srtp_key_material+2*DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, DTLS_SRTP_SALT_LEN);
-						ms_media_stream_sessions_set_srtp_recv_key(ctx->stream_sessions, MS_AES_128_SHA1_80, (const char *)key, DTLS_SRTP_KEY_LEN+DTLS_SRTP_SALT_LEN, MSSRTP_RTCP_STREAM);
-					}
-
-					ms_free(key);
-
-					ms_dtls_srtp_check_channels_status(ctx);
-				}
-			}
-
-			if (ctx->role != MSDtlsSrtpRoleIsServer) { /* close the connection only if we are client, if we are server, the client may ask again for last packets */
-			/*FireFox version 43 requires DTLS channel to be kept openned, probably a bug in FireFox  ret = ssl_close_notify( &(ctx->rtcp_dtls_context->ssl) );*/
-			}
+		if ((ret==0) && (ctx->rtcp_channel_status == DTLS_STATUS_HANDSHAKE_ONGOING)) {
+			ms_dtls_srtp_rtcp_handshake_over(ctx);
 		}
 
 		return 0;
@@ -717,8 +888,20 @@ static int ms_dtls_srtp_initialise_bctbx_dtls_context(DtlsBcToolBoxContext *dtls
 /***********************************************/
 /**** Private to mediastreamer2 functions ****/
 /* header declared in voip/private.h */
+void ms_dtls_srtp_wait_for_handshake_jobs(MSDtlsSrtpContext *dtls_context) {
+	if (dtls_context!=NULL) {
+		ms_mutex_lock(&dtls_context->jobs_mutex);
+		while (dtls_context->rtp_job.pending || dtls_context->rtcp_job.pending) {
+			ms_cond_wait(&dtls_context->jobs_cond, &dtls_context->jobs_mutex);
+		}
+		ms_mutex_unlock(&dtls_context->jobs_mutex);
+	}
+}
+
 void ms_dtls_srtp_set_stream_sessions(MSDtlsSrtpContext *dtls_context, MSMediaStreamSessions *stream_sessions) {
 	if (dtls_context!=NULL) {
+		/* a running job sends its packets through the sessions */
+		ms_dtls_srtp_wait_for_handshake_jobs(dtls_context);
 		dtls_context->stream_sessions = stream_sessions;
 	}
 }
@@ -741,6 +924,23 @@ void ms_dtls_srtp_set_peer_fingerprint(MSDtlsSrtpContext *context, const char *p
 	}
 }
 
+void ms_dtls_srtp_set_worker_pool(MSDtlsSrtpContext *context, MSWorkerPool *pool) {
+	if (context) {
+		ms_dtls_srtp_wait_for_handshake_jobs(context);
+		context->worker_pool = pool;
+	}
+}
+
+void ms_dtls_srtp_get_stats(MSDtlsSrtpContext *context, MSDtlsSrtpStats *stats) {
+	if (context) {
+		ms_mutex_lock(&context->jobs_mutex);
+		*stats = context->stats;
+		ms_mutex_unlock(&context->jobs_mutex);
+	} else {
+		memset(stats, 0, sizeof(MSDtlsSrtpStats));
+	}
+}
+
 void ms_dtls_srtp_set_role(MSDtlsSrtpContext *context, MSDtlsSrtpRole role) {
 	if (context) {
 		ms_mutex_lock(&context->rtp_dtls_context->ssl_context_mutex);
@@ -797,6 +997,12 @@ MSDtlsSrtpContext* ms_dtls_srtp_context_new(MSMediaStreamSessions *sessions, MSD
 	userData->rtcp_incoming_buffer = NULL;
 	userData->rtp_channel_status = DTLS_STATUS_CONTEXT_NOT_READY;
 	userData->rtcp_channel_status = DTLS_STATUS_CONTEXT_NOT_READY;
+	userData->rtp_job.ctx = userData;
+	userData->rtp_job.is_rtp = TRUE;
+	userData->rtcp_job.ctx = userData;
+	userData->rtcp_job.is_rtp = FALSE;
+	ms_mutex_init(&userData->jobs_mutex, NULL);
+	ms_cond_init(&userData->jobs_cond, NULL);
 	ms_dtls_srtp_set_transport(userData, s);
 
 	ret = ms_dtls_srtp_initialise_bctbx_dtls_context(rtp_dtls_context, params, s);
@@ -834,7 +1040,8 @@ void ms_dtls_srtp_start(MSDtlsSrtpContext* context) {
 		/* complete ssl setup*/
 		bctbx_ssl_context_setup(context->rtp_dtls_context->ssl, context->rtp_dtls_context->ssl_config);
 		/* and start the handshake */
-		bctbx_ssl_handshake(context->rtp_dtls_context->ssl);
+		context->handshake_start = get_timeval_in_millis();
+		ms_dtls_srtp_handshake_step(context, context->rtp_dtls_context->ssl);
 		context->rtp_time_reference = get_timeval_in_millis(); /* arm the timer for retransmission */
 		context->rtp_channel_status = DTLS_STATUS_HANDSHAKE_ONGOING;
 		ms_mutex_unlock(&context->rtp_dtls_context->ssl_context_mutex);
@@ -845,7 +1052,7 @@ void ms_dtls_srtp_start(MSDtlsSrtpContext* context) {
 			/* complete ssl setup*/
 			bctbx_ssl_context_setup(context->rtcp_dtls_context->ssl, context->rtcp_dtls_context->ssl_config);
 			/* and start the handshake */
-			bctbx_ssl_handshake(context->rtcp_dtls_context->ssl);
+			ms_dtls_srtp_handshake_step(context, context->rtcp_dtls_context->ssl);
 			context->rtcp_time_reference = get_timeval_in_millis(); /* arm the timer for retransmission */
 			context->rtcp_channel_status = DTLS_STATUS_HANDSHAKE_ONGOING;
 			ms_mutex_unlock(&context->rtcp_dtls_context->ssl_context_mutex);
@@ -859,6 +1066,7 @@ void ms_dtls_srtp_start(MSDtlsSrtpContext* context) {
 			bctbx_ssl_config_set_endpoint(context->rtp_dtls_context->ssl_config, BCTBX_SSL_IS_SERVER);
 			/* complete ssl setup*/
 			bctbx_ssl_context_setup(context->rtp_dtls_context->ssl, context->rtp_dtls_context->ssl_config);
+			context->handshake_start = get_timeval_in_millis();
 			context->rtp_channel_status = DTLS_STATUS_HANDSHAKE_ONGOING;
 			ms_mutex_unlock(&context->rtp_dtls_context->ssl_context_mutex);
 
@@ -877,6 +1085,9 @@ void ms_dtls_srtp_start(MSDtlsSrtpContext* context) {
 }
 
 void ms_dtls_srtp_context_destroy(MSDtlsSrtpContext *ctx) {
+	/* the jobs still queued or running use the contexts */
+	ms_dtls_srtp_wait_for_handshake_jobs(ctx);
+
 	/* clean bctoolbox contexts */
 	ms_dtls_srtp_bctbx_context_free(ctx->rtp_dtls_context);
 	ms_dtls_srtp_bctbx_context_free(ctx->rtcp_dtls_context);
@@ -895,6 +1106,8 @@ void ms_dtls_srtp_context_destroy(MSDtlsSrtpContext *ctx) {
 		ctx->rtcp_incoming_buffer = next_packet;
 	}
 
+	ms_mutex_destroy(&ctx->jobs_mutex);
+	ms_cond_destroy(&ctx->jobs_cond);
 	ms_free(ctx);
 	ms_message("DTLS-SRTP context destroyed");
 }
@@ -97,6 +97,16 @@ static void check_and_create_srtp_context(MSMediaStreamSessions *sessions) {
 		sessions->srtp_context=ms_srtp_context_new();
 }
 /**** Sender functions ****/
+/*
+ * srtp protects the packet in place and appends its trailer: a message that is already contiguous, aligned, not shared
+ * and large enough does not need to be copied by msgpullup().
+ */
+static void prepare_for_protection(mblk_t *m, int size){
+	if (m->b_cont==NULL && m->b_datap->db_ref==1 && ((intptr_t)m->b_rptr & 3)==0 && (m->b_datap->db_lim-m->b_rptr)>=size)
+		return;
+	msgpullup(m,size);
+}
+
 static int _process_on_send(RtpSession* session,MSSrtpStreamContext *ctx, mblk_t *m){
 	int slen;
 	err_status_t err;
@@ -113,7 +123,7 @@ static int _process_on_send(RtpSession* session,MSSrtpStreamContext *ctx, mblk_t
 			slen = 0; /*droping packets*/
 		} else {
 			/* defragment incoming message and enlarge the buffer for srtp to write its data */
-			msgpullup(m,slen+SRTP_MAX_TRAILER_LEN+4 /*for 32 bits alignment*/);
+			prepare_for_protection(m,slen+SRTP_MAX_TRAILER_LEN+4 /*for 32 bits alignment*/);
 			err=srtp_protect(ctx->srtp,m->b_rptr,&slen);
 		}
 		ms_mutex_unlock(&ctx->mutex);
@@ -125,7 +135,7 @@ static int _process_on_send(RtpSession* session,MSSrtpStreamContext *ctx, mblk_t
 			slen = 0; /*droping packets*/
 		} else {
 		/* defragment incoming message and enlarge the buffer for srtp to write its data */
-			msgpullup(m,slen+SRTP_MAX_TRAILER_LEN+4 /*for 32 bits alignment*/ + 4 /*required by srtp_protect_rtcp*/);
+			prepare_for_protection(m,slen+SRTP_MAX_TRAILER_LEN+4 /*for 32 bits alignment*/ + 4 /*required by srtp_protect_rtcp*/);
 			err=srtp_protect_rtcp(ctx->srtp,m->b_rptr,&slen);
 		}
 		ms_mutex_unlock(&ctx->mutex);
@@ -280,6 +290,19 @@ static int ms_set_srtp_crypto_policy(MSCryptoSuite suite, crypto_policy_t *polic
 		case MS_AES_256_SHA1_32:
 			crypto_policy_set_aes_cm_256_hmac_sha1_32(policy);
 			break;
+#ifdef HAVE_SRTP_GCM
+		case MS_AEAD_AES_128_GCM:
+			crypto_policy_set_aes_gcm_128_16_auth(policy);
+			break;
+		case MS_AEAD_AES_256_GCM:
+			crypto_policy_set_aes_gcm_256_16_auth(policy);
+			break;
+#else
+		case MS_AEAD_AES_128_GCM:
+		case MS_AEAD_AES_256_GCM:
+			ms_error("AES-GCM crypto suites are not supported by this libsrtp");
+			return -1;
+#endif
 		case MS_CRYPTO_SUITE_INVALID:
 			return -1;
 			break;
@@ -408,6 +431,22 @@ bool_t ms_srtp_supported(void){
 	return TRUE;
 }
 
+bool_t ms_srtp_crypto_suite_supported(MSCryptoSuite suite){
+	switch(suite){
+		case MS_CRYPTO_SUITE_INVALID:
+			return FALSE;
+		case MS_AEAD_AES_128_GCM:
+		case MS_AEAD_AES_256_GCM:
+#ifdef HAVE_SRTP_GCM
+			return TRUE;
+#else
+			return FALSE;
+#endif
+		default:
+			return TRUE;
+	}
+}
+
 
 int ms_media_stream_sessions_set_srtp_recv_key_b64(MSMediaStreamSessions *sessions, MSCryptoSuite suite, const char* b64_key){
 	int retval;
@@ -513,6 +552,10 @@ bool_t ms_srtp_supported(void){
 	return FALSE;
 }
 
+bool_t ms_srtp_crypto_suite_supported(MSCryptoSuite suite){
+	return FALSE;
+}
+
 int ms_srtp_init(void) {
 	return -1;
 }
@@ -0,0 +1,238 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msticker.h"
+#include "mediastreamer2/mspacer.h"
+
+#define DEFAULT_PACING_FACTOR 2.5f
+/*
+ * The MSRtpSend shifts the timestamps of the packets that are late by more than 200ms, which must not happen to the
+ * packets of a frame.
+ */
+#define MAX_QUEUE_DELAY_MS 100
+#define MAX_BATCHES 16
+
+/*the packets received during a tick, of which bytes are still queued*/
+typedef struct _PacerBatch{
+	uint64_t time;
+	int bytes;
+}PacerBatch;
+
+typedef struct _PacerState{
+	queue_t q;
+	PacerBatch batches[MAX_BATCHES]; /*the oldest first*/
+	int nbatches;
+	RtpSession *priority_session;
+	uint64_t priority_sent; /*bytes sent by the priority session at the previous tick*/
+	uint64_t last_time;
+	float factor;
+	float budget; /*bytes that can still be sent, negative when the last packet sent exceeded it*/
+	int bitrate;
+	int queue_delay; /*ms, the time the oldest packet queued has waited at the end of the last tick*/
+}PacerState;
+
+static void pacer_init(MSFilter *f){
+	PacerState *s=ms_new0(PacerState,1);
+	qinit(&s->q);
+	s->factor=DEFAULT_PACING_FACTOR;
+	f->data=s;
+}
+
+static void pacer_preprocess(MSFilter *f){
+	PacerState *s=(PacerState*)f->data;
+	s->last_time=f->ticker->time;
+	s->budget=0;
+}
+
+static void pacer_flush(PacerState *s){
+	flushq(&s->q,0);
+	s->nbatches=0;
+	s->queue_delay=0;
+}
+
+static void pacer_queue(PacerState *s, MSQueue *input, uint64_t time){
+	int bytes=0;
+	mblk_t *im;
+
+	while((im=ms_queue_get(input))!=NULL){
+		bytes+=(int)msgdsize(im);
+		putq(&s->q,im);
+	}
+	if (bytes==0) return;
+	if (s->nbatches==MAX_BATCHES) s->batches[MAX_BATCHES-1].bytes+=bytes;
+	else{
+		s->batches[s->nbatches].time=time;
+		s->batches[s->nbatches].bytes=bytes;
+		s->nbatches++;
+	}
+}
+
+static void pacer_dequeue(PacerState *s, MSQueue *output){
+	mblk_t *om=getq(&s->q);
+	int size=(int)msgdsize(om);
+
+	s->budget-=size;
+	while(size>0 && s->nbatches>0){
+		int n=MIN(size,s->batches[0].bytes);
+		size-=n;
+		s->batches[0].bytes-=n;
+		if (s->batches[0].bytes==0){
+			s->nbatches--;
+			memmove(&s->batches[0],&s->batches[1],s->nbatches*sizeof(PacerBatch));
+		}
+	}
+	ms_queue_put(output,om);
+}
+
+/*the bytes to send during this tick so that no packet waits more than MAX_QUEUE_DELAY_MS*/
+static int pacer_get_late_bytes(PacerState *s, uint64_t now, int interval){
+	int late_bytes=0;
+	int cumulated=0;
+	int i;
+
+	for(i=0;i<s->nbatches;++i){
+		int64_t left=(int64_t)(s->batches[i].time+MAX_QUEUE_DELAY_MS-now);
+		int ticks=(int)MAX(1,left/interval);
+		cumulated+=s->batches[i].bytes;
+		late_bytes=MAX(late_bytes,cumulated/ticks);
+	}
+	return late_bytes;
+}
+
+static void pacer_process(MSFilter *f){
+	PacerState *s=(PacerState*)f->data;
+	float rate,tick_budget;
+	int late_bytes,sent=0;
+
+	pacer_queue(s,f->inputs[0],f->ticker->time);
+
+	ms_filter_lock(f);
+	if (s->bitrate<=0){
+		while(!qempty(&s->q)) pacer_dequeue(s,f->outputs[0]);
+		s->budget=0;
+		s->last_time=f->ticker->time;
+		s->queue_delay=0;
+		ms_filter_unlock(f);
+		return;
+	}
+	rate=s->factor*s->bitrate;
+	tick_budget=rate*f->ticker->interval/8000;
+	s->budget+=rate*(float)(f->ticker->time-s->last_time)/8000;
+	s->last_time=f->ticker->time;
+	if (s->priority_session){
+		uint64_t priority_sent=rtp_session_get_stats(s->priority_session)->sent;
+		/*the priority packets have already been sent, the video waits*/
+		if (priority_sent>s->priority_sent) s->budget-=(float)(priority_sent-s->priority_sent);
+		s->priority_sent=priority_sent;
+	}
+	ms_filter_unlock(f);
+
+	/*the frames larger than the pacing rate allows, like the key frames at a low bitrate, are sent faster*/
+	late_bytes=pacer_get_late_bytes(s,f->ticker->time,f->ticker->interval);
+	while(!qempty(&s->q) && (s->budget>0 || sent<late_bytes)){
+		int size=(int)msgdsize(peekq(&s->q));
+		pacer_dequeue(s,f->outputs[0]);
+		sent+=size;
+	}
+	/*neither the time the link stayed idle allows a burst afterwards, nor an excess delays the next packets for long*/
+	if (qempty(&s->q)) s->budget=MIN(s->budget,0);
+	s->budget=MAX(s->budget,-tick_budget);
+	s->queue_delay=s->nbatches>0 ? (int)(f->ticker->time-s->batches[0].time) : 0;
+}
+
+static void pacer_postprocess(MSFilter *f){
+	pacer_flush((PacerState*)f->data);
+}
+
+static void pacer_uninit(MSFilter *f){
+	PacerState *s=(PacerState*)f->data;
+	pacer_flush(s);
+	ms_free(s);
+}
+
+static int pacer_set_bitrate(MSFilter *f, void *arg){
+	PacerState *s=(PacerState*)f->data;
+	ms_filter_lock(f);
+	s->bitrate=*(int*)arg;
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int pacer_get_bitrate(MSFilter *f, void *arg){
+	PacerState *s=(PacerState*)f->data;
+	*(int*)arg=s->bitrate;
+	return 0;
+}
+
+static int pacer_set_factor(MSFilter *f, void *arg){
+	PacerState *s=(PacerState*)f->data;
+	float factor=*(float*)arg;
+	if (factor<1){
+		ms_error("MSPacer: the pacing rate cannot be lower than the bitrate (factor %f)",factor);
+		return -1;
+	}
+	ms_filter_lock(f);
+	s->factor=factor;
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int pacer_set_priority_session(MSFilter *f, void *arg){
+	PacerState *s=(PacerState*)f->data;
+	RtpSession *session=(RtpSession*)arg;
+	ms_filter_lock(f);
+	s->priority_session=session;
+	if (session) s->priority_sent=rtp_session_get_stats(session)->sent;
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int pacer_get_queue_delay(MSFilter *f, void *arg){
+	PacerState *s=(PacerState*)f->data;
+	*(int*)arg=s->queue_delay;
+	return 0;
+}
+
+static MSFilterMethod pacer_methods[]={
+	{	MS_FILTER_SET_BITRATE,		pacer_set_bitrate		},
+	{	MS_FILTER_GET_BITRATE,		pacer_get_bitrate		},
+	{	MS_PACER_SET_FACTOR,		pacer_set_factor		},
+	{	MS_PACER_SET_PRIORITY_SESSION,	pacer_set_priority_session	},
+	{	MS_PACER_GET_QUEUE_DELAY,	pacer_get_queue_delay		},
+	{	0,				NULL				}
+};
+
+MSFilterDesc ms_pacer_desc={
+	MS_PACER_ID,
+	"MSPacer",
+	"Spreads the packets of the video frames over time",
+	MS_FILTER_OTHER,
+	NULL,
+	1,
+	1,
+	pacer_init,
+	pacer_preprocess,
+	pacer_process,
+	pacer_postprocess,
+	pacer_uninit,
+	pacer_methods
+};
+
+MS_FILTER_DESC_EXPORT(ms_pacer_desc)
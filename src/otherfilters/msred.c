@@ -0,0 +1,379 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msticker.h"
+#include "mediastreamer2/msred.h"
+
+#include "ortp/rtp.h"
+
+#define RED_HEADER_SIZE 4
+#define RED_PRIMARY_HEADER_SIZE 1
+/*the fields of the RFC 2198 header*/
+#define MAX_TS_OFFSET 0x3fff
+#define MAX_BLOCK_LENGTH 0x3ff
+
+#define MAX_DISTANCE MS_RED_ENC_MAX_DISTANCE
+/*redundant blocks accepted in the packets received*/
+#define MAX_BLOCKS 8
+/*no frame is looked for in the jitter buffer once the stream has been interrupted for this long*/
+#define MAX_RECOVERY_TIME_MS 500
+
+typedef struct _RedBlock{
+	uint32_t ts_offset;
+	int pt;
+	int offset;
+	int len;
+}RedBlock;
+
+/*
+ * Parses the headers of a RED payload. The last block is the primary encoding.
+ * Returns the number of blocks, or -1 if the payload is not a valid RED payload.
+ */
+static int parse_red_payload(const uint8_t *data, int size, RedBlock *blocks, int max_blocks){
+	int nblocks=0;
+	int pos=0;
+	int offset;
+	int i;
+
+	while(pos<size && (data[pos] & 0x80)){
+		if (pos+RED_HEADER_SIZE>size || nblocks==max_blocks-1) return -1;
+		blocks[nblocks].pt=data[pos] & 0x7f;
+		blocks[nblocks].ts_offset=((uint32_t)data[pos+1]<<6) | (data[pos+2]>>2);
+		blocks[nblocks].len=((data[pos+2] & 0x3)<<8) | data[pos+3];
+		nblocks++;
+		pos+=RED_HEADER_SIZE;
+	}
+	if (pos>=size) return -1;
+	blocks[nblocks].pt=data[pos] & 0x7f;
+	blocks[nblocks].ts_offset=0;
+	pos+=RED_PRIMARY_HEADER_SIZE;
+	offset=pos;
+	for(i=0;i<nblocks;++i){
+		blocks[i].offset=offset;
+		offset+=blocks[i].len;
+	}
+	if (offset>size) return -1;
+	blocks[nblocks].offset=offset;
+	blocks[nblocks].len=size-offset;
+	return nblocks+1;
+}
+
+/*
+ * Encoder
+ */
+
+typedef struct _RedEncState{
+	mblk_t *history[MAX_DISTANCE]; /*the previous frames, the most recent first*/
+	int primary_pt;
+	int distance;
+}RedEncState;
+
+static void red_enc_init(MSFilter *f){
+	RedEncState *s=ms_new0(RedEncState,1);
+	s->primary_pt=-1;
+	s->distance=1;
+	f->data=s;
+}
+
+static void red_enc_flush_history(RedEncState *s){
+	int i;
+	for(i=0;i<MAX_DISTANCE;++i){
+		if (s->history[i]){
+			freemsg(s->history[i]);
+			s->history[i]=NULL;
+		}
+	}
+}
+
+static void red_enc_process(MSFilter *f){
+	RedEncState *s=(RedEncState*)f->data;
+	mblk_t *im;
+
+	while((im=ms_queue_get(f->inputs[0]))!=NULL){
+		uint32_t ts=mblk_get_timestamp_info(im);
+		mblk_t *blocks[MAX_DISTANCE];
+		int nblocks=0;
+		int size;
+		int i;
+		mblk_t *om;
+
+		if (im->b_cont) msgpullup(im,-1);
+		size=(int)(im->b_wptr-im->b_rptr);
+		/*the oldest frame first, as long as its distance in time and its size fit in the header*/
+		for(i=s->distance-1;i>=0;--i){
+			mblk_t *h=s->history[i];
+			uint32_t ts_offset;
+			if (h==NULL) continue;
+			ts_offset=ts-mblk_get_timestamp_info(h);
+			if (ts_offset==0 || ts_offset>MAX_TS_OFFSET || h->b_wptr-h->b_rptr>MAX_BLOCK_LENGTH) continue;
+			blocks[nblocks++]=h;
+			size+=RED_HEADER_SIZE+(int)(h->b_wptr-h->b_rptr);
+		}
+		om=allocb(size+RED_PRIMARY_HEADER_SIZE,0);
+		for(i=0;i<nblocks;++i){
+			uint32_t ts_offset=ts-mblk_get_timestamp_info(blocks[i]);
+			int len=(int)(blocks[i]->b_wptr-blocks[i]->b_rptr);
+			om->b_wptr[0]=(uint8_t)(0x80 | s->primary_pt);
+			om->b_wptr[1]=(uint8_t)(ts_offset>>6);
+			om->b_wptr[2]=(uint8_t)(((ts_offset & 0x3f)<<2) | (len>>8));
+			om->b_wptr[3]=(uint8_t)(len & 0xff);
+			om->b_wptr+=RED_HEADER_SIZE;
+		}
+		*om->b_wptr++=(uint8_t)s->primary_pt;
+		for(i=0;i<nblocks;++i){
+			int len=(int)(blocks[i]->b_wptr-blocks[i]->b_rptr);
+			memcpy(om->b_wptr,blocks[i]->b_rptr,len);
+			om->b_wptr+=len;
+		}
+		memcpy(om->b_wptr,im->b_rptr,im->b_wptr-im->b_rptr);
+		om->b_wptr+=im->b_wptr-im->b_rptr;
+		mblk_meta_copy(im,om);
+		ms_queue_put(f->outputs[0],om);
+
+		/*the frame is kept for the next packets*/
+		if (s->history[MAX_DISTANCE-1]) freemsg(s->history[MAX_DISTANCE-1]);
+		memmove(&s->history[1],&s->history[0],(MAX_DISTANCE-1)*sizeof(mblk_t*));
+		s->history[0]=im;
+	}
+}
+
+static void red_enc_postprocess(MSFilter *f){
+	red_enc_flush_history((RedEncState*)f->data);
+}
+
+static void red_enc_uninit(MSFilter *f){
+	RedEncState *s=(RedEncState*)f->data;
+	red_enc_flush_history(s);
+	ms_free(s);
+}
+
+static int red_enc_set_primary_payload_type(MSFilter *f, void *arg){
+	RedEncState *s=(RedEncState*)f->data;
+	s->primary_pt=*(int*)arg;
+	return 0;
+}
+
+static int red_enc_set_distance(MSFilter *f, void *arg){
+	RedEncState *s=(RedEncState*)f->data;
+	int distance=*(int*)arg;
+	if (distance<0 || distance>MAX_DISTANCE){
+		ms_error("MSRedEnc: unsupported distance %i",distance);
+		return -1;
+	}
+	s->distance=distance;
+	return 0;
+}
+
+static MSFilterMethod red_enc_methods[]={
+	{	MS_RED_ENC_SET_PRIMARY_PAYLOAD_TYPE,	red_enc_set_primary_payload_type	},
+	{	MS_RED_ENC_SET_DISTANCE,		red_enc_set_distance			},
+	{	0,					NULL					}
+};
+
+MSFilterDesc ms_red_enc_desc={
+	MS_RED_ENC_ID,
+	"MSRedEnc",
+	"Adds redundant audio data to the encoded frames (RFC 2198)",
+	MS_FILTER_OTHER,
+	NULL,
+	1,
+	1,
+	red_enc_init,
+	NULL,
+	red_enc_process,
+	red_enc_postprocess,
+	red_enc_uninit,
+	red_enc_methods
+};
+
+MS_FILTER_DESC_EXPORT(ms_red_enc_desc)
+
+/*
+ * Decoder
+ */
+
+typedef struct _RedDecState{
+	MSRtpPayloadPickerContext picker_context;
+	MSConcealerContext *concealer;
+	int primary_pt;
+	int sample_rate;
+	uint32_t last_ts;
+	uint32_t ptime_ts; /*the duration of a frame, in RTP timestamp units*/
+	uint16_t last_seq;
+	bool_t receiving;
+	int recovered;
+}RedDecState;
+
+static void red_dec_init(MSFilter *f){
+	RedDecState *s=ms_new0(RedDecState,1);
+	s->primary_pt=-1;
+	s->sample_rate=8000;
+	f->data=s;
+}
+
+static void red_dec_preprocess(MSFilter *f){
+	RedDecState *s=(RedDecState*)f->data;
+	s->concealer=ms_concealer_context_new(MAX_RECOVERY_TIME_MS);
+	s->receiving=FALSE;
+}
+
+static int frame_duration_ms(RedDecState *s){
+	return (int)((uint64_t)s->ptime_ts*1000/s->sample_rate);
+}
+
+/*looks for the copy of the frame with the given timestamp in a packet of the jitter buffer, returns it or NULL*/
+static mblk_t *find_redundant_frame(RedDecState *s, mblk_t *packet, uint32_t ts){
+	RedBlock blocks[MAX_BLOCKS];
+	uint8_t *payload=NULL;
+	int size=rtp_get_payload(packet,&payload);
+	uint32_t packet_ts=rtp_get_timestamp(packet);
+	int nblocks;
+	int i;
+
+	if (payload==NULL || size<=0) return NULL;
+	nblocks=parse_red_payload(payload,size,blocks,MAX_BLOCKS);
+	for(i=0;i<nblocks-1;++i){
+		if (blocks[i].pt==s->primary_pt && packet_ts-blocks[i].ts_offset==ts && blocks[i].len>0){
+			/*the packet stays in the jitter buffer, its data is shared but not modified*/
+			mblk_t *m=dupb(packet);
+			m->b_rptr=payload+blocks[i].offset;
+			m->b_wptr=m->b_rptr+blocks[i].len;
+			return m;
+		}
+	}
+	return NULL;
+}
+
+/*called when the next frame should have been decoded already: gives its redundant copy to the decoder if one was received*/
+static void red_dec_recover(MSFilter *f, RedDecState *s){
+	uint16_t missing_seq=(uint16_t)(s->last_seq+1);
+	uint32_t missing_ts=s->last_ts+s->ptime_ts;
+	mblk_t *m=NULL;
+
+	/*the missing packet may be in the jitter buffer, held for later: the decoder will conceal it*/
+	if (s->picker_context.picker(&s->picker_context,missing_seq)==NULL){
+		int i;
+		for(i=1;i<=MAX_DISTANCE && m==NULL;++i){
+			mblk_t *next=s->picker_context.picker(&s->picker_context,(uint16_t)(missing_seq+i));
+			if (next) m=find_redundant_frame(s,next,missing_ts);
+		}
+	}
+	if (m){
+		mblk_set_cseq(m,missing_seq);
+		mblk_set_timestamp_info(m,missing_ts);
+		ms_queue_put(f->outputs[0],m);
+		s->recovered++;
+	}
+	/*either recovered or concealed by the decoder, the frame is not to be expected anymore*/
+	s->last_seq=missing_seq;
+	s->last_ts=missing_ts;
+	ms_concealer_inc_sample_time(s->concealer,f->ticker->time,frame_duration_ms(s),m!=NULL);
+}
+
+static void red_dec_process(MSFilter *f){
+	RedDecState *s=(RedDecState*)f->data;
+	mblk_t *im;
+
+	while((im=ms_queue_get(f->inputs[0]))!=NULL){
+		RedBlock blocks[MAX_BLOCKS];
+		uint16_t seq=mblk_get_cseq(im);
+		uint32_t ts=mblk_get_timestamp_info(im);
+		int nblocks;
+
+		if (im->b_cont) msgpullup(im,-1);
+		nblocks=parse_red_payload(im->b_rptr,(int)(im->b_wptr-im->b_rptr),blocks,MAX_BLOCKS);
+		if (nblocks>0 && blocks[nblocks-1].pt==s->primary_pt){
+			/*the decoder is given the primary encoding*/
+			im->b_rptr+=blocks[nblocks-1].offset;
+		}
+		/*otherwise it is not a RED payload, and is given to the decoder as it is*/
+		if (s->receiving && (uint16_t)(seq-s->last_seq)==1 && ts!=s->last_ts) s->ptime_ts=ts-s->last_ts;
+		s->receiving=TRUE;
+		s->last_seq=seq;
+		s->last_ts=ts;
+		ms_queue_put(f->outputs[0],im);
+		if (s->ptime_ts>0) ms_concealer_inc_sample_time(s->concealer,f->ticker->time,frame_duration_ms(s),TRUE);
+	}
+	if (s->picker_context.picker && s->ptime_ts>0 && ms_concealer_context_is_concealement_required(s->concealer,f->ticker->time)){
+		red_dec_recover(f,s);
+	}
+}
+
+static void red_dec_postprocess(MSFilter *f){
+	RedDecState *s=(RedDecState*)f->data;
+	ms_message("MSRedDec: %i frames recovered from redundant data",s->recovered);
+	ms_concealer_context_destroy(s->concealer);
+	s->concealer=NULL;
+}
+
+static void red_dec_uninit(MSFilter *f){
+	ms_free(f->data);
+}
+
+static int red_dec_set_primary_payload_type(MSFilter *f, void *arg){
+	RedDecState *s=(RedDecState*)f->data;
+	s->primary_pt=*(int*)arg;
+	return 0;
+}
+
+static int red_dec_set_sample_rate(MSFilter *f, void *arg){
+	RedDecState *s=(RedDecState*)f->data;
+	if (*(int*)arg<=0) return -1;
+	s->sample_rate=*(int*)arg;
+	return 0;
+}
+
+static int red_dec_set_rtp_payload_picker(MSFilter *f, void *arg){
+	RedDecState *s=(RedDecState*)f->data;
+	s->picker_context=*(MSRtpPayloadPickerContext*)arg;
+	return 0;
+}
+
+static int red_dec_get_recovered_frames(MSFilter *f, void *arg){
+	RedDecState *s=(RedDecState*)f->data;
+	*(int*)arg=s->recovered;
+	return 0;
+}
+
+static MSFilterMethod red_dec_methods[]={
+	{	MS_RED_DEC_SET_PRIMARY_PAYLOAD_TYPE,	red_dec_set_primary_payload_type	},
+	{	MS_FILTER_SET_SAMPLE_RATE,		red_dec_set_sample_rate			},
+	{	MS_RED_DEC_SET_RTP_PAYLOAD_PICKER,	red_dec_set_rtp_payload_picker		},
+	{	MS_RED_DEC_GET_RECOVERED_FRAMES,	red_dec_get_recovered_frames		},
+	{	0,					NULL					}
+};
+
+MSFilterDesc ms_red_dec_desc={
+	MS_RED_DEC_ID,
+	"MSRedDec",
+	"Recovers the lost audio frames from redundant data (RFC 2198)",
+	MS_FILTER_OTHER,
+	NULL,
+	1,
+	1,
+	red_dec_init,
+	red_dec_preprocess,
+	red_dec_process,
+	red_dec_postprocess,
+	red_dec_uninit,
+	red_dec_methods
+};
+
+MS_FILTER_DESC_EXPORT(ms_red_dec_desc)
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/msfactory.h"
 #include "mediastreamer2/msrtp.h"
+#include "mediastreamer2/msrtpmultiplexer.h"
 #include "mediastreamer2/msticker.h"
 
 #include "ortp/telephonyevents.h"
@@ -701,16 +702,19 @@ static void receiver_process(MSFilter * f)
 		d->starting=FALSE;
 	}
 
-	timestamp = (uint32_t) (f->ticker->time * (d->rate/1000));
-	while ((m = rtp_session_recvm_with_ts(d->session, timestamp)) != NULL) {
-		if (receiver_check_payload_type(f, d, m)){
-			mblk_set_timestamp_info(m, rtp_get_timestamp(m));
-			mblk_set_marker_info(m, rtp_get_markbit(m));
-			mblk_set_cseq(m, rtp_get_seqnumber(m));
-			rtp_get_payload(m,&m->b_rptr);
-			ms_queue_put(f->outputs[0], m);
-		}else{
-			freemsg(m);
+	/*when the sockets are read through a MSRtpRecvMultiplexer, nothing is done until packets arrive*/
+	if (!ms_rtp_recv_multiplexer_session_idle(d->session)){
+		timestamp = (uint32_t) (f->ticker->time * (d->rate/1000));
+		while ((m = rtp_session_recvm_with_ts(d->session, timestamp)) != NULL) {
+			if (receiver_check_payload_type(f, d, m)){
+				mblk_set_timestamp_info(m, rtp_get_timestamp(m));
+				mblk_set_marker_info(m, rtp_get_markbit(m));
+				mblk_set_cseq(m, rtp_get_seqnumber(m));
+				rtp_get_payload(m,&m->b_rptr);
+				ms_queue_put(f->outputs[0], m);
+			}else{
+				freemsg(m);
+			}
 		}
 	}
 	/*every second compute recv bandwidth*/
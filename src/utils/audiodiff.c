@@ -20,10 +20,20 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/mscommon.h"
 #include "mediastreamer2/msutils.h"
+#include "mediastreamer2/msfactory.h"
+#include "mediastreamer2/msworkerpool.h"
 #include "waveheader.h"
+#include "pcmformat.h"
+#include "audiodiff.h"
 
 #include <math.h>
 
+#ifndef MS_FIXED_POINT
+/*the cross correlation is computed in the frequency domain, which requires floating point ffts*/
+#include "kiss_fftr.h"
+#define AUDIODIFF_USE_FFT 1
+#endif
+
 typedef struct {
 	int rate;
 	int nchannels;
@@ -90,18 +100,18 @@ static int file_info_read(FileInfo *fi, int zero_pad_samples, int zero_pad_end_s
 	return err;
 }
 
-static int64_t scalar_product(int16_t *s1, int16_t *s2, int n, int step){
+static int64_t scalar_product(int16_t *s1, int16_t *s2, int n){
 	int64_t acc = 0;
 	int i;
 	
 	for (i=0; i< n-4; i += 4){
-		acc += s1[i*step] * s2[i*step];
-		acc += s1[(i+1)*step] * s2[(i+1)*step];
-		acc += s1[(i+2)*step] * s2[(i+2)*step];
-		acc += s1[(i+3)*step] * s2[(i+3)*step];
+		acc += s1[i] * s2[i];
+		acc += s1[i+1] * s2[i+1];
+		acc += s1[i+2] * s2[i+2];
+		acc += s1[i+3] * s2[i+3];
 	}
 	for (; i< n; i++){
-		acc += s1[i*step] * s2[i*step];
+		acc += s1[i] * s2[i];
 	}
 	return acc;
 }
@@ -148,30 +158,108 @@ static void progress_context_update(ProgressContext *ctx, int cur_progress){
 	}
 }
 
+#ifdef AUDIODIFF_USE_FFT
+
+static int fft_size_for(int n){
+	int nfft = 2;
+	while (nfft < n) nfft <<= 1;
+	return nfft;
+}
+
+/*
+ * Computes the raw (not normalized) cross correlation of s1 and s2 for shifts in [0 ; xcorr_nsamples[ , as
+ * the inverse fft of conj(S1).S2. The fft size covers the n1 + xcorr_nsamples - 1 samples of s2 involved, so that
+ * the circular correlation never wraps.
+**/
+static void fft_cross_correlation(const int16_t *s1, int n1, const int16_t *s2, float *xcorr, int xcorr_nsamples, ProgressContext *pctx){
+	int n2 = n1 + xcorr_nsamples - 1;
+	int nfft = fft_size_for(n2);
+	int nfreq = nfft/2 + 1;
+	kiss_fftr_cfg forward = kiss_fftr_alloc(nfft, 0, NULL, NULL);
+	kiss_fftr_cfg backward = kiss_fftr_alloc(nfft, 1, NULL, NULL);
+	kiss_fft_scalar *time1 = ms_new0(kiss_fft_scalar, nfft);
+	kiss_fft_scalar *time2 = ms_new0(kiss_fft_scalar, nfft);
+	kiss_fft_cpx *freq1 = ms_new0(kiss_fft_cpx, nfreq);
+	kiss_fft_cpx *freq2 = ms_new0(kiss_fft_cpx, nfreq);
+	/*the samples are converted to [-1,1[ floats, scale the correlation back to the range of the int16 products*/
+	float scale = (32768.0f*32768.0f)/(float)nfft;
+	int i;
+
+	ms_pcm_int16_to_float(s1, time1, n1);
+	ms_pcm_int16_to_float(s2, time2, n2);
+	kiss_fftr(forward, time1, freq1);
+	progress_context_update(pctx, 25);
+	kiss_fftr(forward, time2, freq2);
+	progress_context_update(pctx, 50);
+	for (i = 0; i < nfreq; ++i){
+		kiss_fft_scalar re = freq1[i].r*freq2[i].r + freq1[i].i*freq2[i].i;
+		kiss_fft_scalar im = freq1[i].r*freq2[i].i - freq1[i].i*freq2[i].r;
+		freq1[i].r = re;
+		freq1[i].i = im;
+	}
+	kiss_fftri(backward, freq1, time1);
+	progress_context_update(pctx, 75);
+	for (i = 0; i < xcorr_nsamples; ++i) xcorr[i] = time1[i]*scale;
+
+	ms_free(freq2);
+	ms_free(freq1);
+	ms_free(time2);
+	ms_free(time1);
+	kiss_fftr_free(backward);
+	kiss_fftr_free(forward);
+}
+
+#endif
+
+void ms_audio_diff_cross_correlation(const int16_t *s1, int n1, const int16_t *s2, float *xcorr, int xcorr_nsamples){
+	ProgressContext pctx;
+#ifndef AUDIODIFF_USE_FFT
+	int i;
+#endif
+
+	progress_context_init(&pctx, NULL, NULL);
+#ifdef AUDIODIFF_USE_FFT
+	fft_cross_correlation(s1, n1, s2, xcorr, xcorr_nsamples, &pctx);
+#else
+	for (i = 0; i < xcorr_nsamples; ++i) xcorr[i] = (float)scalar_product((int16_t*)s1, (int16_t*)s2 + i, n1);
+#endif
+}
+
 /* This function assumes the following:
  * - s1's length is inferior to s2's length
  * - s2 has been padded with 'len' initial and trailing zeroes 
  * The output is a normalized cross correlation.
 **/
-static int compute_cross_correlation(int16_t *s1, int n1, int16_t *s2_padded, float *xcorr, int xcorr_nsamples, ProgressContext *pctx, int step, int64_t *s1_energy){
+static int compute_cross_correlation(int16_t *s1, int n1, int16_t *s2_padded, float *xcorr, int xcorr_nsamples, ProgressContext *pctx, int64_t *s1_energy){
 	int max_index = 0;
 	int i;
-	int64_t tmp,max=0;
-	int64_t norm1 = scalar_product(s1, s1, n1, step);
-	int64_t norm2 = scalar_product(s2_padded, s2_padded, n1, step) - s2_padded[step*(n1-1)]*s2_padded[step*(n1-1)];
+	double tmp,max=0;
+	int64_t norm1 = scalar_product(s1, s1, n1);
+	int64_t norm2 = scalar_product(s2_padded, s2_padded, n1) - s2_padded[n1-1]*s2_padded[n1-1];
 	
+#ifdef AUDIODIFF_USE_FFT
+	fft_cross_correlation(s1, n1, s2_padded, xcorr, xcorr_nsamples, pctx);
+#endif
 	for (i=0; i<xcorr_nsamples; i++){
-		norm2 += s2_padded[step*(i+n1-1)]*s2_padded[step*(i+n1-1)];
-		tmp = scalar_product(s1, s2_padded + i*step, n1, step);
-		xcorr[i] = (float)((double)tmp / sqrt((double)(norm1)*(double)norm2));
+		norm2 += s2_padded[i+n1-1]*s2_padded[i+n1-1];
+#ifdef AUDIODIFF_USE_FFT
+		/*over a silent window the product is exactly zero, don't let the fft rounding noise pretend otherwise*/
+		tmp = norm2 != 0 ? xcorr[i] : 0;
+#else
+		tmp = (double)scalar_product(s1, s2_padded + i, n1);
+#endif
+		xcorr[i] = (float)(tmp / sqrt((double)(norm1)*(double)norm2));
 		tmp = tmp < 0 ? -tmp : tmp;
 		if (tmp > max){
 			max = tmp;
 			max_index = i;
 		}
-		norm2 -= s2_padded[step*i]*s2_padded[step*i];
+		norm2 -= s2_padded[i]*s2_padded[i];
+#ifndef AUDIODIFF_USE_FFT
 		progress_context_update(pctx, 100 * i/xcorr_nsamples);
+#endif
 	}
+	progress_context_update(pctx, 100);
 	if (s1_energy) *s1_energy = norm1;
 	return max_index;
 }
@@ -189,17 +277,26 @@ static int _ms_audio_diff_one_chunk(int16_t *s1, int16_t *s2, int nsamples, int
 	if (nchannels == 2){
 		float *xcorr_r = ms_new0(float, xcorr_size);
 		float *xcorr_l = ms_new0(float, xcorr_size);
+		/*the correlations read nsamples + xcorr_size - 1 samples of s2*/
+		int s2_nsamples = nsamples + xcorr_size - 1;
+		int16_t *s1_r = ms_new(int16_t, nsamples);
+		int16_t *s1_l = ms_new(int16_t, nsamples);
+		int16_t *s2_r = ms_new(int16_t, s2_nsamples);
+		int16_t *s2_l = ms_new(int16_t, s2_nsamples);
 		double max = 0;
 		double max_r, max_l;
 		int i;
 		
+		/*each channel is correlated separately, on contiguous samples*/
+		ms_pcm_deinterleave_stereo(s1, s1_r, s1_l, nsamples);
+		ms_pcm_deinterleave_stereo(s2, s2_r, s2_l, s2_nsamples);
 		progress_context_push(pctx, &local_pctx, 0.5);
-		max_index_r = compute_cross_correlation(s1, nsamples, s2, xcorr_r, xcorr_size, &local_pctx, 2, &er);
+		max_index_r = compute_cross_correlation(s1_r, nsamples, s2_r, xcorr_r, xcorr_size, &local_pctx, &er);
 		max_r = xcorr_r[max_index_r];
 		progress_context_pop(pctx, &local_pctx);
 
 		progress_context_push(pctx, &local_pctx, 0.5);
-		max_index_l = compute_cross_correlation(s1 + 1, nsamples, s2 + 1, xcorr_l, xcorr_size, &local_pctx, 2, &el);
+		max_index_l = compute_cross_correlation(s1_l, nsamples, s2_l, xcorr_l, xcorr_size, &local_pctx, &el);
 		max_l = xcorr_l[max_index_l];
 		progress_context_pop(pctx, &local_pctx);
 		
@@ -222,10 +319,14 @@ static int _ms_audio_diff_one_chunk(int16_t *s1, int16_t *s2, int nsamples, int
 		if (s1_energy) *s1_energy = (er + el)/2;
 		ms_free(xcorr_r);
 		ms_free(xcorr_l);
+		ms_free(s1_r);
+		ms_free(s1_l);
+		ms_free(s2_r);
+		ms_free(s2_l);
 	}else{
 		float *xcorr = ms_new0(float, xcorr_size);
 		progress_context_push(pctx, &local_pctx, 1.0);
-		max_index_r = compute_cross_correlation(s1, nsamples , s2, xcorr, xcorr_size, &local_pctx, 1, s1_energy);
+		max_index_r = compute_cross_correlation(s1, nsamples , s2, xcorr, xcorr_size, &local_pctx, s1_energy);
 		progress_context_pop(pctx, &local_pctx);
 		*ret = xcorr[max_index_r];
 		max_pos = max_index_r-max_shift_samples;
@@ -235,39 +336,85 @@ static int _ms_audio_diff_one_chunk(int16_t *s1, int16_t *s2, int nsamples, int
 	return max_pos;
 }
 
-static int _ms_audio_diff_chunked(FileInfo *fi1, FileInfo *fi2, double *ret, int max_shift_samples, int chunk_size_samples, ProgressContext *pctx){
-	int cur_chunk_samples;
-	int samples = 0;
-	int step = fi1->nchannels;
+typedef struct _ChunkJob{
+	struct _ChunkedDiffContext *ctx;
+	int offset;
+	int nsamples;
+	int maxpos;
+	double ret;
+	int64_t energy;
+}ChunkJob;
+
+typedef struct _ChunkedDiffContext{
+	FileInfo *fi1;
+	FileInfo *fi2;
+	int max_shift_samples;
+	ms_mutex_t lock;
+	ProgressContext *pctx;
+	int done_samples;
+}ChunkedDiffContext;
+
+static void chunk_job_run(void *data){
+	ChunkJob *job = (ChunkJob*)data;
+	ChunkedDiffContext *ctx = job->ctx;
+	int step = ctx->fi1->nchannels;
+	ProgressContext local_pctx;
+
+	/*chunks run concurrently: progress is only reported when a chunk is completed, under the lock*/
+	progress_context_init(&local_pctx, NULL, NULL);
+	job->maxpos = _ms_audio_diff_one_chunk(ctx->fi1->buffer + job->offset*step, ctx->fi2->buffer + job->offset*step, job->nsamples,
+		ctx->max_shift_samples, ctx->fi1->nchannels, &job->ret, &job->energy, &local_pctx);
+	ms_mutex_lock(&ctx->lock);
+	ctx->done_samples += job->nsamples;
+	progress_context_update(ctx->pctx, (int)(100 * (int64_t)ctx->done_samples / ctx->fi1->nsamples));
+	ms_mutex_unlock(&ctx->lock);
+}
+
+static int _ms_audio_diff_chunked(FileInfo *fi1, FileInfo *fi2, double *ret, int max_shift_samples, int chunk_size_samples, int nthreads, ProgressContext *pctx){
 	double cum_res = 0;
 	int64_t cum_maxpos = 0;
 	int maxpos;
-	int num_chunks = (fi1->nsamples + chunk_size_samples) / chunk_size_samples;
+	int num_chunks = (fi1->nsamples + chunk_size_samples - 1) / chunk_size_samples;
 	int *max_pos_table = ms_new0(int, num_chunks);
 	int64_t *chunk_energies = ms_new0(int64_t, num_chunks);
+	ChunkJob *jobs = ms_new0(ChunkJob, num_chunks);
+	void **job_ptrs = ms_new0(void*, num_chunks);
+	ChunkedDiffContext ctx;
+	MSWorkerPool *pool;
 	double variance = 0;
-	int i=0;
-	ProgressContext local_pctx;
+	int i;
 	int64_t tot_energy = 0;
-	
-	do{
-		double chunk_ret = 0;
-		int64_t chunk_energy;
-		cur_chunk_samples = MIN(chunk_size_samples, fi1->nsamples - samples);
-		progress_context_push(pctx, &local_pctx, (float)cur_chunk_samples/(float)fi1->nsamples);
-		maxpos = _ms_audio_diff_one_chunk(fi1->buffer + samples*step, fi2->buffer + samples*step, cur_chunk_samples, max_shift_samples,
-					 fi1->nchannels, &chunk_ret, &chunk_energy, &local_pctx);
-		progress_context_pop(pctx, &local_pctx);
-		samples += chunk_size_samples;
-		cum_res += chunk_ret * chunk_energy;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.fi1 = fi1;
+	ctx.fi2 = fi2;
+	ctx.max_shift_samples = max_shift_samples;
+	ctx.pctx = pctx;
+	ms_mutex_init(&ctx.lock, NULL);
+	for (i = 0; i < num_chunks; ++i){
+		jobs[i].ctx = &ctx;
+		jobs[i].offset = i * chunk_size_samples;
+		jobs[i].nsamples = MIN(chunk_size_samples, fi1->nsamples - jobs[i].offset);
+		job_ptrs[i] = &jobs[i];
+	}
+	/*the calling thread takes part in the processing, hence one thread less in the pool*/
+	pool = ms_worker_pool_new(MIN(nthreads, num_chunks) - 1);
+	ms_worker_pool_run(pool, chunk_job_run, job_ptrs, num_chunks);
+	ms_worker_pool_destroy(pool);
+	ms_mutex_destroy(&ctx.lock);
+
+	/*results are accumulated in chunk order, so that they don't depend on the scheduling of the threads*/
+	for (i = 0; i < num_chunks; ++i){
+		int64_t chunk_energy = jobs[i].energy;
+		cum_res += jobs[i].ret * chunk_energy;
 		ms_message("chunk_energy is %li", (long int) chunk_energy);
 		chunk_energies[i] = chunk_energy;
-		max_pos_table[i] = maxpos; 
-		cum_maxpos += maxpos * chunk_energy;
+		max_pos_table[i] = jobs[i].maxpos;
+		cum_maxpos += jobs[i].maxpos * chunk_energy;
 		tot_energy += chunk_energy;
-		i++;
-	}while(samples < fi1->nsamples);
-	num_chunks = i;
+	}
+	ms_free(job_ptrs);
+	ms_free(jobs);
 	
 	ms_message("tot_energy is %li", (long int) tot_energy);
 	maxpos = (int)(cum_maxpos / tot_energy);
@@ -351,7 +498,8 @@ int ms_audio_diff(const char *ref_file, const char *matched_file, double *ret, c
 		maxpos = _ms_audio_diff_one_chunk(fi1->buffer, fi2->buffer, fi1->nsamples, max_shift_samples, fi1->nchannels, ret, NULL, &pctx);
 	}else{
 		int chunk_size_samples = params->chunk_size_ms * fi1->rate / 1000;
-		maxpos = _ms_audio_diff_chunked(fi1, fi2, ret, max_shift_samples, chunk_size_samples, &pctx);
+		int nthreads = params->max_threads > 0 ? params->max_threads : (int)ms_factory_detect_cpu_count();
+		maxpos = _ms_audio_diff_chunked(fi1, fi2, ret, max_shift_samples, chunk_size_samples, nthreads, &pctx);
 	}
 	ms_message("Max cross-correlation obtained at position [%i], similarity factor=[%g]", maxpos, *ret);
 end:
@@ -0,0 +1,33 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef AUDIODIFF_H
+#define AUDIODIFF_H
+
+#include "mediastreamer2/mscommon.h"
+
+/**
+ * @brief Compute the raw (not normalized) cross correlation used by ms_audio_diff(), for the tester.
+ * xcorr[i] is the scalar product of the n1 samples of s1 with the n1 samples of s2 starting at i, for i in
+ * [0 ; xcorr_nsamples[. s2 must have n1 + xcorr_nsamples - 1 samples. It is computed in the frequency domain unless
+ * mediastreamer2 is built for fixed point.
+ */
+extern void ms_audio_diff_cross_correlation(const int16_t *s1, int n1, const int16_t *s2, float *xcorr, int xcorr_nsamples);
+
+#endif
@@ -87,6 +87,8 @@ static inline int avcodec_decode_video2(AVCodecContext *avctx, AVFrame *picture,
 #define AV_PIX_FMT_UYVY422 PIX_FMT_UYVY422
 #define AV_PIX_FMT_YUYV422 PIX_FMT_YUYV422
 #define AV_PIX_FMT_RGB565 PIX_FMT_RGB565
+#define AV_PIX_FMT_NV12 PIX_FMT_NV12
+#define AV_PIX_FMT_NV21 PIX_FMT_NV21
 
 #endif
 
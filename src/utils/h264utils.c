@@ -20,57 +20,102 @@
 #include "h264utils.h"
 #include <mediastreamer2/msqueue.h>
 
-static void  push_nalu(const uint8_t *begin, const uint8_t *end, MSQueue *nalus){
-    unsigned ecount = 0;
-    const uint8_t *src=begin;
-    size_t nalu_len = (end-begin);
-    uint8_t nalu_byte  = *src++;
-    
-    mblk_t *m=allocb(nalu_len,0);
-    
-    // Removal of the 3 in a 003x sequence
-    // This emulation prevention byte is normally part of a NAL unit.
-    /* H.264 standard sys in par 7.4.1 page 58
-     emulation_prevention_three_byte is a byte equal to 0x03.
-     When an emulation_prevention_three_byte is present in a NAL unit, it shall be discarded by the decoding process.
-     Within the NAL unit, the following three-byte sequence shall not occur at any byte-aligned position: 0x000000, 0x000001, 0x00002
-     */
-    *m->b_wptr++=nalu_byte;
-    while (src<end-3) {
-        if (src[0]==0 && src[1]==0 && src[2]==3){
-            *m->b_wptr++=0;
-            *m->b_wptr++=0;
-            // drop the emulation_prevention_three_byte
-            src+=3;
-            ++ecount;
-            continue;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Returns a pointer on the first 0x00 0x00 <third> sequence found in [p, end), or end.
+ * Blocks of 16 bytes that do not contain two consecutive zero bytes are skipped with SIMD instructions.
+ */
+static const uint8_t *find_zero_zero_sequence(const uint8_t *p, const uint8_t *end, uint8_t third){
+    while (p+3<=end){
+        size_t count;
+#if defined(__SSE2__)
+        if (p+17<=end){
+            const __m128i zero=_mm_setzero_si128();
+            __m128i pairs=_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), zero),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p+1)), zero));
+            if (_mm_movemask_epi8(pairs)==0){
+                p+=16;
+                continue;
+            }
+        }
+#elif defined(__ARM_NEON__)
+        if (p+17<=end){
+            uint8x16_t pairs=vandq_u8(vceqq_u8(vld1q_u8(p), vdupq_n_u8(0)), vceqq_u8(vld1q_u8(p+1), vdupq_n_u8(0)));
+            uint64x2_t halves=vreinterpretq_u64_u8(pairs);
+            if ((vgetq_lane_u64(halves, 0) | vgetq_lane_u64(halves, 1))==0){
+                p+=16;
+                continue;
+            }
+        }
+#endif
+        /*there are two consecutive zero bytes in the next 16 bytes, or the end is near*/
+        count=(size_t)(end-p-2);
+        if (count>16) count=16;
+        for (; count>0; --count, ++p){
+            if (p[0]==0 && p[1]==0 && p[2]==third) return p;
         }
-        *m->b_wptr++=*src++;
     }
-    *m->b_wptr++=*src++;
-    *m->b_wptr++=*src++;
-    *m->b_wptr++=*src++;
-    
+    return end;
+}
+
+static void push_nalu(const uint8_t *begin, const uint8_t *end, mblk_t *frame, MSQueue *nalus){
+    mblk_t *m;
+
+    /*the trailing zero bytes belong to the start code of the next nal unit*/
+    while (end>begin && end[-1]==0) --end;
+    if (end==begin) return;
+    if (frame){
+        m=dupb(frame);
+        m->b_rptr=(uint8_t *)begin;
+        m->b_wptr=(uint8_t *)end;
+    }else{
+        m=allocb((int)(end-begin),0);
+        memcpy(m->b_wptr, begin, end-begin);
+        m->b_wptr+=end-begin;
+    }
     ms_queue_put(nalus, m);
 }
 
+static void slice_bitstream(const uint8_t *bitstream, size_t size, mblk_t *frame, MSQueue *nalus){
+    const uint8_t *end=bitstream+size;
+    const uint8_t *start_code=find_zero_zero_sequence(bitstream, end, 1);
+
+    while (start_code<end){
+        const uint8_t *begin=start_code+3;
+        start_code=find_zero_zero_sequence(begin, end, 1);
+        push_nalu(begin, start_code, frame, nalus);
+    }
+}
+
 void ms_h264_bitstream_to_nalus(const uint8_t *bitstream, size_t size, MSQueue *nalus){
-    size_t i;
-    const uint8_t *p,*begin=NULL;
-    int zeroes=0;
-    
-    for(i=0,p=bitstream;i<size;++i){
-        if (*p==0){
-            ++zeroes;
-        }else if (zeroes>=2 && *p==1 ){
-            if (begin){
-                push_nalu(begin, p-zeroes, nalus);
-            }
-            begin=p+1;
-        }else zeroes=0;
-        ++p;
+    slice_bitstream(bitstream, size, NULL, nalus);
+}
+
+void ms_h264_frame_to_nalus(mblk_t *frame, MSQueue *nalus){
+    if (frame->b_cont) msgpullup(frame, -1);
+    slice_bitstream(frame->b_rptr, frame->b_wptr-frame->b_rptr, frame, nalus);
+}
+
+size_t ms_h264_nalu_remove_emulation_prevention_bytes(const uint8_t *src, size_t size, uint8_t *dst){
+    /*H.264 standard, 7.4.1: an emulation_prevention_three_byte is a 0x03 byte following two zero bytes within a nal unit,
+     and shall be discarded by the decoding process.*/
+    const uint8_t *end=src+size;
+    uint8_t *out=dst;
+
+    while (src<end){
+        const uint8_t *epb=find_zero_zero_sequence(src, end, 3);
+        size_t count=(epb<end) ? (size_t)(epb+2-src) : (size_t)(end-src);
+        memmove(out, src, count);
+        out+=count;
+        src+=count;
+        if (epb<end) src++;
     }
-    if (begin) push_nalu(begin, p, nalus);
+    return out-dst;
 }
 
 MSH264NaluType ms_h264_nalu_get_type(const mblk_t *nalu) {
@@ -43,12 +43,35 @@ MSH264NaluType ms_h264_nalu_get_type(const mblk_t *nalu);
  *
  * Nal units are stored in freshly allocated mblk_t buffers which are pushed into
  * a queue. This function does not alter the buffer where the bitstream is contained in.
+ * The nal units keep their emulation prevention bytes, as expected by RTP packetization,
+ * see ms_h264_nalu_remove_emulation_prevention_bytes() to parse them.
  * @param bitstream Pointer on a memory segment that contains the bitstream to slice.
  * @param size Size of the memory segment.
  * @param nalus A queue where produced nal units will be pushed into.
  */
 void ms_h264_bitstream_to_nalus(const uint8_t *bitstream, size_t size, MSQueue *nalus);
 
+/**
+ * Slices a bitstream contained in a mblk_t into several nal units, without copying it.
+ *
+ * Same as ms_h264_bitstream_to_nalus() except that the nal units pushed into the queue are
+ * views (see dupb()) on the buffer of the frame. The frame can be freed afterwards, its buffer
+ * is released when the last nal unit is freed.
+ * @param frame Buffer containing the bitstream to slice. It is made contiguous if needed.
+ * @param nalus A queue where produced nal units will be pushed into.
+ */
+void ms_h264_frame_to_nalus(mblk_t *frame, MSQueue *nalus);
+
+/**
+ * Removes the emulation prevention bytes of a nal unit, giving its raw byte sequence payload,
+ * for example to parse a SPS.
+ * @param src The nal unit.
+ * @param size Size of the nal unit.
+ * @param dst Where the payload is written, at least size bytes long. It can be src.
+ * @return The size of the payload.
+ */
+size_t ms_h264_nalu_remove_emulation_prevention_bytes(const uint8_t *src, size_t size, uint8_t *dst);
+
 /**
  * Slices a frame into several nal units.
  *
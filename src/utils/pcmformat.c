@@ -0,0 +1,199 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "pcmformat.h"
+
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+void ms_pcm_mono_to_stereo(const int16_t *mono, int16_t *stereo, int nsamples){
+	int i = 0;
+#if defined(__SSE2__)
+	for (; i + 8 <= nsamples; i += 8){
+		__m128i v = _mm_loadu_si128((const __m128i *)(mono + i));
+		_mm_storeu_si128((__m128i *)(stereo + 2*i), _mm_unpacklo_epi16(v, v));
+		_mm_storeu_si128((__m128i *)(stereo + 2*i + 8), _mm_unpackhi_epi16(v, v));
+	}
+#elif defined(__ARM_NEON__)
+	for (; i + 8 <= nsamples; i += 8){
+		int16x8x2_t v;
+		v.val[0] = v.val[1] = vld1q_s16(mono + i);
+		vst2q_s16(stereo + 2*i, v);
+	}
+#endif
+	for (; i < nsamples; ++i){
+		stereo[2*i] = stereo[2*i + 1] = mono[i];
+	}
+}
+
+void ms_pcm_stereo_to_mono(const int16_t *stereo, int16_t *mono, int nsamples){
+	int i = 0;
+	/*when done in place, the samples written are always behind the ones read*/
+#if defined(__SSE2__)
+	for (; i + 8 <= nsamples; i += 8){
+		__m128i a = _mm_loadu_si128((const __m128i *)(stereo + 2*i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(stereo + 2*i + 8));
+		/*sign extend the left samples to 32 bits, so that packing does not saturate*/
+		a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+		_mm_storeu_si128((__m128i *)(mono + i), _mm_packs_epi32(a, b));
+	}
+#elif defined(__ARM_NEON__)
+	for (; i + 8 <= nsamples; i += 8){
+		int16x8x2_t v = vld2q_s16(stereo + 2*i);
+		vst1q_s16(mono + i, v.val[0]);
+	}
+#endif
+	for (; i < nsamples; ++i){
+		mono[i] = stereo[2*i];
+	}
+}
+
+void ms_pcm_interleave_stereo(const int16_t *left, const int16_t *right, int16_t *stereo, int nsamples){
+	int i = 0;
+#if defined(__SSE2__)
+	for (; i + 8 <= nsamples; i += 8){
+		__m128i l = _mm_loadu_si128((const __m128i *)(left + i));
+		__m128i r = _mm_loadu_si128((const __m128i *)(right + i));
+		_mm_storeu_si128((__m128i *)(stereo + 2*i), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128((__m128i *)(stereo + 2*i + 8), _mm_unpackhi_epi16(l, r));
+	}
+#elif defined(__ARM_NEON__)
+	for (; i + 8 <= nsamples; i += 8){
+		int16x8x2_t v;
+		v.val[0] = vld1q_s16(left + i);
+		v.val[1] = vld1q_s16(right + i);
+		vst2q_s16(stereo + 2*i, v);
+	}
+#endif
+	for (; i < nsamples; ++i){
+		stereo[2*i] = left[i];
+		stereo[2*i + 1] = right[i];
+	}
+}
+
+void ms_pcm_deinterleave_stereo(const int16_t *stereo, int16_t *left, int16_t *right, int nsamples){
+	int i = 0;
+#if defined(__SSE2__)
+	for (; i + 8 <= nsamples; i += 8){
+		__m128i a = _mm_loadu_si128((const __m128i *)(stereo + 2*i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(stereo + 2*i + 8));
+		_mm_storeu_si128((__m128i *)(left + i), _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+			_mm_srai_epi32(_mm_slli_epi32(b, 16), 16)));
+		_mm_storeu_si128((__m128i *)(right + i), _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16)));
+	}
+#elif defined(__ARM_NEON__)
+	for (; i + 8 <= nsamples; i += 8){
+		int16x8x2_t v = vld2q_s16(stereo + 2*i);
+		vst1q_s16(left + i, v.val[0]);
+		vst1q_s16(right + i, v.val[1]);
+	}
+#endif
+	for (; i < nsamples; ++i){
+		left[i] = stereo[2*i];
+		right[i] = stereo[2*i + 1];
+	}
+}
+
+void ms_pcm_swap_bytes(const void *in, void *out, int nsamples){
+	const uint8_t *src = (const uint8_t *)in;
+	uint8_t *dst = (uint8_t *)out;
+	int i = 0;
+#if defined(__SSE2__)
+	for (; i + 8 <= nsamples; i += 8){
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + 2*i));
+		_mm_storeu_si128((__m128i *)(dst + 2*i), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+	}
+#elif defined(__ARM_NEON__)
+	for (; i + 8 <= nsamples; i += 8){
+		vst1q_u8(dst + 2*i, vrev16q_u8(vld1q_u8(src + 2*i)));
+	}
+#endif
+	for (; i < nsamples; ++i){
+		uint8_t tmp = src[2*i];
+		dst[2*i] = src[2*i + 1];
+		dst[2*i + 1] = tmp;
+	}
+}
+
+void ms_pcm_from_big_endian(int16_t *samples, int nsamples){
+#ifndef WORDS_BIGENDIAN
+	ms_pcm_swap_bytes(samples, samples, nsamples);
+#endif
+}
+
+void ms_pcm_to_big_endian(int16_t *samples, int nsamples){
+#ifndef WORDS_BIGENDIAN
+	ms_pcm_swap_bytes(samples, samples, nsamples);
+#endif
+}
+
+void ms_pcm_int16_to_float(const int16_t *in, float *out, int nsamples){
+	const float scale = 1.0f / 32768.0f;
+	int i = 0;
+#if defined(__SSE2__)
+	__m128 vscale = _mm_set1_ps(scale);
+	for (; i + 8 <= nsamples; i += 8){
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+		_mm_storeu_ps(out + i, _mm_mul_ps(lo, vscale));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(hi, vscale));
+	}
+#elif defined(__ARM_NEON__)
+	for (; i + 8 <= nsamples; i += 8){
+		int16x8_t v = vld1q_s16(in + i);
+		vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+		vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+	}
+#endif
+	for (; i < nsamples; ++i){
+		out[i] = (float)in[i] * scale;
+	}
+}
+
+void ms_pcm_float_to_int16(const float *in, int16_t *out, int nsamples){
+	int i = 0;
+#if defined(__SSE2__)
+	__m128 vscale = _mm_set1_ps(32768.0f);
+	__m128 vmax = _mm_set1_ps(32767.0f);
+	__m128 vmin = _mm_set1_ps(-32768.0f);
+	for (; i + 8 <= nsamples; i += 8){
+		/*clamping before the conversion, which would otherwise give 0x80000000 for large values*/
+		__m128 lo = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), vscale), vmax), vmin);
+		__m128 hi = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), vscale), vmax), vmin);
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+	}
+#endif
+	for (; i < nsamples; ++i){
+		float v = in[i] * 32768.0f;
+		if (v > 32767.0f) v = 32767.0f;
+		else if (v < -32768.0f) v = -32768.0f;
+		out[i] = (int16_t)lrintf(v);
+	}
+}
@@ -0,0 +1,77 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef PCMFORMAT_H
+#define PCMFORMAT_H
+
+#include "mediastreamer2/mscommon.h"
+
+/**
+ * @brief Conversions of 16 bits PCM buffers between channel layouts, byte orders and sample formats.
+ * They use SSE2 or NEON when available. Unless stated otherwise, input and output must not overlap.
+ * Sample counts are numbers of samples per channel.
+ */
+
+/**
+ * @brief Duplicate a mono signal into both channels of an interleaved stereo buffer of 2*nsamples samples.
+ */
+extern void ms_pcm_mono_to_stereo(const int16_t *mono, int16_t *stereo, int nsamples);
+
+/**
+ * @brief Extract the left channel of an interleaved stereo buffer. The output may be the input buffer itself.
+ */
+extern void ms_pcm_stereo_to_mono(const int16_t *stereo, int16_t *mono, int nsamples);
+
+/**
+ * @brief Interleave two mono buffers into a stereo buffer of 2*nsamples samples.
+ */
+extern void ms_pcm_interleave_stereo(const int16_t *left, const int16_t *right, int16_t *stereo, int nsamples);
+
+/**
+ * @brief Split an interleaved stereo buffer into two mono buffers.
+ */
+extern void ms_pcm_deinterleave_stereo(const int16_t *stereo, int16_t *left, int16_t *right, int nsamples);
+
+/**
+ * @brief Swap the byte order of nsamples samples. The output may be the input buffer itself.
+ * Buffers do not need to be aligned on a sample boundary.
+ */
+extern void ms_pcm_swap_bytes(const void *in, void *out, int nsamples);
+
+/**
+ * @brief Convert samples to host byte order from big endian (network order), in place.
+ */
+extern void ms_pcm_from_big_endian(int16_t *samples, int nsamples);
+
+/**
+ * @brief Convert samples from host byte order to big endian (network order), in place.
+ */
+extern void ms_pcm_to_big_endian(int16_t *samples, int nsamples);
+
+/**
+ * @brief Convert samples to floats in the [-1,1[ range.
+ */
+extern void ms_pcm_int16_to_float(const int16_t *in, float *out, int nsamples);
+
+/**
+ * @brief Convert floats in the [-1,1[ range to samples, rounding to nearest and saturating out of range values.
+ */
+extern void ms_pcm_float_to_int16(const float *in, int16_t *out, int nsamples);
+
+#endif
@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/mscommon.h"
 #include "mediastreamer2/msvideo.h"
 #include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msfactory.h"
 #include "mediastreamer2/msticker.h"
 #include "mediastreamer2/mswebcam.h"
 
@@ -309,20 +310,155 @@ static mblk_t * generate_black_yuv_frame(MSVideoSize *reqsize) {
 	return m;
 }
 
-mblk_t *ms_load_jpeg_as_yuv(const char *jpgpath, MSVideoSize *reqsize) {
-	mblk_t *m = NULL;
-	if (jpgpath != NULL) {
+static mblk_t *load_jpeg_as_yuv(const char *jpgpath, MSVideoSize *reqsize) {
 #ifdef MS2_WINDOWS_UNIVERSAL
-		m = _ms_winrt_load_jpeg_as_yuv(jpgpath, reqsize);
+	return _ms_winrt_load_jpeg_as_yuv(jpgpath, reqsize);
 #else
-		m = _ms_load_jpeg_as_yuv(jpgpath, reqsize);
+	return _ms_load_jpeg_as_yuv(jpgpath, reqsize);
 #endif
+}
+
+mblk_t *ms_load_jpeg_as_yuv(const char *jpgpath, MSVideoSize *reqsize) {
+	mblk_t *m = NULL;
+	if (jpgpath != NULL) {
+		m = load_jpeg_as_yuv(jpgpath, reqsize);
 	}
 	if (m == NULL) m = generate_black_yuv_frame(reqsize);
 	return m;
 }
 
 
+/*
+ * Cache of the decoded pictures, shared by the static image filters of a factory, so that a picture sent on many streams
+ * is decoded and scaled once. The entries are kept from the most to the least recently used one, the latter being evicted
+ * when the memory limit is reached. The filters run in different tickers and the reference count of a data block is not
+ * atomic, so each of them gets its own copy of the cached picture.
+ */
+
+#define STATIC_IMAGE_CACHE_DEFAULT_MAX_MEMORY (16*1024*1024)
+
+typedef struct _MSStaticImageCacheEntry {
+	char *path;
+	MSVideoSize reqsize; /*the size requested, the key of the entry with the path*/
+	MSVideoSize vsize; /*the size of the picture, that the decoder of some platforms does not change*/
+	mblk_t *pic;
+	size_t memory;
+} MSStaticImageCacheEntry;
+
+struct _MSStaticImageCache {
+	ms_mutex_t lock;
+	bctbx_list_t *entries;
+	size_t max_memory;
+	MSStaticImageCacheStats stats;
+};
+
+static void static_image_cache_entry_free(MSStaticImageCacheEntry *entry) {
+	ms_free(entry->path);
+	freemsg(entry->pic);
+	ms_free(entry);
+}
+
+static void static_image_cache_evict(MSStaticImageCache *cache, size_t needed) {
+	while (cache->entries != NULL && cache->stats.memory + needed > cache->max_memory) {
+		bctbx_list_t *last = bctbx_list_last_elem(cache->entries);
+		MSStaticImageCacheEntry *entry = (MSStaticImageCacheEntry *)last->data;
+		cache->stats.memory -= entry->memory;
+		cache->stats.entries--;
+		cache->stats.evictions++;
+		cache->entries = bctbx_list_erase_link(cache->entries, last);
+		static_image_cache_entry_free(entry);
+	}
+}
+
+MSStaticImageCache *ms_static_image_cache_new(void) {
+	MSStaticImageCache *cache = ms_new0(MSStaticImageCache, 1);
+	ms_mutex_init(&cache->lock, NULL);
+	cache->max_memory = STATIC_IMAGE_CACHE_DEFAULT_MAX_MEMORY;
+	return cache;
+}
+
+void ms_static_image_cache_destroy(MSStaticImageCache *cache) {
+	ms_static_image_cache_flush(cache);
+	ms_mutex_destroy(&cache->lock);
+	ms_free(cache);
+}
+
+mblk_t *ms_static_image_cache_get(MSStaticImageCache *cache, const char *path, MSVideoSize *vsize) {
+	MSStaticImageCacheEntry *entry = NULL;
+	MSVideoSize reqsize = *vsize;
+	bctbx_list_t *it;
+	mblk_t *pic;
+
+	ms_mutex_lock(&cache->lock);
+	for (it = cache->entries; it != NULL; it = bctbx_list_next(it)) {
+		MSStaticImageCacheEntry *e = (MSStaticImageCacheEntry *)it->data;
+		if (ms_video_size_equal(e->reqsize, reqsize) && strcmp(e->path, path) == 0) {
+			entry = e;
+			break;
+		}
+	}
+	if (entry != NULL) {
+		/* Move the entry to the head, as the most recently used. */
+		cache->entries = bctbx_list_erase_link(cache->entries, it);
+		cache->entries = bctbx_list_prepend(cache->entries, entry);
+		cache->stats.hits++;
+		*vsize = entry->vsize;
+		pic = copymsg(entry->pic);
+		ms_mutex_unlock(&cache->lock);
+		return pic;
+	}
+	cache->stats.misses++;
+	ms_mutex_unlock(&cache->lock);
+
+	/* Decode without the lock, the other pictures can be served meanwhile. */
+	pic = load_jpeg_as_yuv(path, vsize);
+	if (pic == NULL) return NULL;
+
+	entry = ms_new0(MSStaticImageCacheEntry, 1);
+	entry->path = ms_strdup(path);
+	entry->reqsize = reqsize;
+	entry->vsize = *vsize;
+	entry->pic = pic;
+	entry->memory = (size_t)(pic->b_datap->db_lim - pic->b_datap->db_base);
+	if (entry->memory > cache->max_memory) {
+		/* Too big to be cached. */
+		entry->pic = NULL;
+		static_image_cache_entry_free(entry);
+		return pic;
+	}
+	ms_mutex_lock(&cache->lock);
+	/* The same picture may have been decoded concurrently: both entries are kept, the older one will be evicted first. */
+	static_image_cache_evict(cache, entry->memory);
+	cache->entries = bctbx_list_prepend(cache->entries, entry);
+	cache->stats.memory += entry->memory;
+	cache->stats.entries++;
+	pic = copymsg(entry->pic);
+	ms_mutex_unlock(&cache->lock);
+	return pic;
+}
+
+void ms_static_image_cache_set_max_memory(MSStaticImageCache *cache, size_t max_memory) {
+	ms_mutex_lock(&cache->lock);
+	cache->max_memory = max_memory;
+	static_image_cache_evict(cache, 0);
+	ms_mutex_unlock(&cache->lock);
+}
+
+void ms_static_image_cache_get_stats(MSStaticImageCache *cache, MSStaticImageCacheStats *stats) {
+	ms_mutex_lock(&cache->lock);
+	*stats = cache->stats;
+	ms_mutex_unlock(&cache->lock);
+}
+
+void ms_static_image_cache_flush(MSStaticImageCache *cache) {
+	ms_mutex_lock(&cache->lock);
+	cache->entries = bctbx_list_free_with_data(cache->entries, (bctbx_list_free_func)static_image_cache_entry_free);
+	cache->stats.memory = 0;
+	cache->stats.entries = 0;
+	ms_mutex_unlock(&cache->lock);
+}
+
+
 #ifndef PACKAGE_DATA_DIR
 #define PACKAGE_DATA_DIR "share"
 #endif
@@ -382,6 +518,10 @@ void static_image_uninit(MSFilter *f){
 
 void static_image_preprocess(MSFilter *f){
 	SIData *d=(SIData*)f->data;
+	MSStaticImageCache *cache = ms_factory_get_static_image_cache(f->factory);
+	if (d->pic==NULL && d->nowebcamimage && cache) {
+		d->pic = ms_static_image_cache_get(cache, d->nowebcamimage, &d->vsize);
+	}
 	if (d->pic==NULL) {
 		d->pic = ms_load_jpeg_as_yuv(d->nowebcamimage, &d->vsize);
 	}
@@ -75,12 +75,13 @@ static void pixconv_process(MSFilter *f){
 					s->scaler=ms_scaler_create_context(inbuf.w, inbuf.h,
 						s->in_fmt,inbuf.w,inbuf.h,
 						s->out_fmt,MS_SCALER_METHOD_BILINEAR);
+					if (s->scaler!=NULL) ms_scaler_context_enable_slicing(s->scaler,ms_factory_get_worker_pool(f->factory));
 				}
 				if (s->in_fmt==MS_RGB24_REV){
 					inbuf.planes[0]+=inbuf.strides[0]*(inbuf.h-1);
 					inbuf.strides[0]=-inbuf.strides[0];
 				}
-				if (ms_scaler_process (s->scaler,inbuf.planes,inbuf.strides, s->outbuf.planes, s->outbuf.strides)<0){
+				if (ms_scaler_process_in_filter(f,s->scaler,inbuf.planes,inbuf.strides, s->outbuf.planes, s->outbuf.strides)<0){
 					ms_error("MSPixConv: Error in ms_sws_scale().");
 				}
 			}
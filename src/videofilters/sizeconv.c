@@ -92,7 +92,7 @@ static mblk_t *size_conv_alloc_mblk(SizeConvState *s){
 	return dupmsg(s->om);
 }
 
-static MSScalerContext * get_resampler(SizeConvState *s, int w, int h){
+static MSScalerContext * get_resampler(MSFilter *f, SizeConvState *s, int w, int h){
 	if (s->in_vsize.width!=w ||
 		s->in_vsize.height!=h || s->sws_ctx==NULL){
 		if (s->sws_ctx!=NULL){
@@ -102,6 +102,7 @@ static MSScalerContext * get_resampler(SizeConvState *s, int w, int h){
 		s->sws_ctx=ms_scaler_create_context(w,h,MS_YUV420P,
 			s->target_vsize.width,s->target_vsize.height,MS_YUV420P,
 			MS_SCALER_METHOD_BILINEAR);
+		if (s->sws_ctx!=NULL) ms_scaler_context_enable_slicing(s->sws_ctx,ms_factory_get_worker_pool(f->factory));
 		s->in_vsize.width=w;
 		s->in_vsize.height=h;
 	}
@@ -150,9 +151,9 @@ static void size_conv_process(MSFilter *f){
 				inbuf.h==s->target_vsize.height){
 				ms_queue_put(f->outputs[0],im);
 			}else{
-				MSScalerContext *sws_ctx=get_resampler(s,inbuf.w,inbuf.h);
+				MSScalerContext *sws_ctx=get_resampler(f,s,inbuf.w,inbuf.h);
 				mblk_t *om=size_conv_alloc_mblk(s);
-				if (ms_scaler_process(sws_ctx,inbuf.planes,inbuf.strides,s->outbuf.planes, s->outbuf.strides)<0){
+				if (ms_scaler_process_in_filter(f,sws_ctx,inbuf.planes,inbuf.strides,s->outbuf.planes, s->outbuf.strides)<0){
 					ms_error("MSSizeConv: error in ms_scaler_process().");
 					freemsg(om);
 				}else{
@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/msvideo.h"
 #include "mediastreamer2/msticker.h"
 #include "mediastreamer2/mscodecutils.h"
+#include "mediastreamer2/msencoderthread.h"
 
 #ifdef _WIN32
 #include <ws2tcpip.h>
@@ -138,10 +139,14 @@ typedef struct EncState{
 	uint32_t framenum;
 	MSVideoStarter starter;
 	bool_t req_vfu;
+	bool_t async_enabled;
 	const MSVideoConfiguration *vconf_list;
 	MSVideoConfiguration vconf;
+	MSEncoderThread *encoder_thread;
 }EncState;
 
+#define MAX_PENDING_FRAMES 1 /*in asynchronous mode, number of frames that can wait while the previous one is being encoded*/
+
 static bool_t parse_video_fmtp(const char *fmtp, float *fps, MSVideoSize *vsize){
 	char *tmp=ms_strdup(fmtp);
 	char *semicolon;
@@ -394,6 +399,16 @@ static void enc_postprocess(MSFilter *f){
 	}
 }
 
+static void enc_detach(MSFilter *f){
+	EncState *s=(EncState*)f->data;
+	/*the encoder thread must be stopped without the filter lock, that it takes to encode*/
+	if (s->encoder_thread!=NULL){
+		ms_encoder_thread_destroy(s->encoder_thread);
+		s->encoder_thread=NULL;
+	}
+	enc_postprocess(f);
+}
+
 static void add_rfc2190_header(mblk_t **packet, AVCodecContext *context, bool_t is_iframe){
 	mblk_t *header;
 	header = allocb(4, 0);
@@ -449,7 +464,7 @@ static int get_gbsc_bytealigned(uint8_t *begin, uint8_t *end){
 }
 #endif
 
-static void rfc2190_generate_packets(MSFilter *f, EncState *s, mblk_t *frame, uint32_t timestamp, bool_t is_iframe){
+static void rfc2190_generate_packets(MSQueue *out, EncState *s, mblk_t *frame, uint32_t timestamp, bool_t is_iframe){
 	mblk_t *packet=NULL;
 
 	while (frame->b_rptr<frame->b_wptr){
@@ -459,13 +474,13 @@ static void rfc2190_generate_packets(MSFilter *f, EncState *s, mblk_t *frame, ui
 			packet->b_rptr + get_gbsc_bytealigned(packet->b_rptr, MIN(packet->b_rptr+s->mtu,frame->b_wptr));
 		add_rfc2190_header(&packet, &s->av_context ,is_iframe);
 		mblk_set_timestamp_info(packet,timestamp);
-		ms_queue_put(f->outputs[0],packet);
+		ms_queue_put(out,packet);
 	}
 	/* the marker bit is set on the last packet, if any.*/
 	mblk_set_marker_info(packet,TRUE);
 }
 
-static void mpeg4_fragment_and_send(MSFilter *f,EncState *s,mblk_t *frame, uint32_t timestamp){
+static void mpeg4_fragment_and_send(MSQueue *out, EncState *s,mblk_t *frame, uint32_t timestamp){
 	uint8_t *rptr;
 	mblk_t *packet=NULL;
 	int len;
@@ -475,14 +490,14 @@ static void mpeg4_fragment_and_send(MSFilter *f,EncState *s,mblk_t *frame, uint3
 		packet->b_rptr=rptr;
 		packet->b_wptr=rptr+len;
 		mblk_set_timestamp_info(packet,timestamp);
-		ms_queue_put(f->outputs[0],packet);
+		ms_queue_put(out,packet);
 		rptr+=len;
 	}
 	/*set marker bit on last packet*/
 	mblk_set_marker_info(packet,TRUE);
 }
 
-static void rfc4629_generate_follow_on_packets(MSFilter *f, EncState *s, mblk_t *frame, uint32_t timestamp, uint8_t *psc, uint8_t *end, bool_t last_packet){
+static void rfc4629_generate_follow_on_packets(MSQueue *out, EncState *s, mblk_t *frame, uint32_t timestamp, uint8_t *psc, uint8_t *end, bool_t last_packet){
 	mblk_t *packet;
 	int len=end-psc;
 
@@ -502,7 +517,7 @@ static void rfc4629_generate_follow_on_packets(MSFilter *f, EncState *s, mblk_t
 		uint8_t *pos;
 		/*adjust the first packet generated*/
 		pos=packet->b_wptr=packet->b_rptr+s->mtu;
-		ms_queue_put(f->outputs[0],packet);
+		ms_queue_put(out,packet);
 		ms_debug("generating %i follow-on packets",num);
 		for (i=1;i<num;++i){
 			mblk_t *header;
@@ -517,9 +532,9 @@ static void rfc4629_generate_follow_on_packets(MSFilter *f, EncState *s, mblk_t
 			header->b_cont=packet;
 			packet=header;
 			mblk_set_timestamp_info(packet,timestamp);
-			ms_queue_put(f->outputs[0],packet);
+			ms_queue_put(out,packet);
 		}
-	}else ms_queue_put(f->outputs[0],packet);
+	}else ms_queue_put(out,packet);
 	/* the marker bit is set on the last packet, if any.*/
 	mblk_set_marker_info(packet,last_packet);
 }
@@ -597,7 +612,7 @@ struct jpeghdr_qtable {
  * send_packet(u_int8 *data, int len)  - Sends the packet to the network
  */
 
-static void mjpeg_fragment_and_send(MSFilter *f,EncState *s,mblk_t *frame, uint32_t timestamp,
+static void mjpeg_fragment_and_send(MSQueue *out, EncState *s,mblk_t *frame, uint32_t timestamp,
 							 uint8_t type,	uint8_t typespec, int dri,
 							 uint8_t q, mblk_t *lqt, mblk_t *cqt) {
 	struct jpeghdr jpghdr;
@@ -670,7 +685,7 @@ static void mjpeg_fragment_and_send(MSFilter *f,EncState *s,mblk_t *frame, uint3
 		packet->b_wptr=packet->b_wptr + data_len;
 
 		mblk_set_timestamp_info(packet,timestamp);
-		ms_queue_put(f->outputs[0],packet);
+		ms_queue_put(out,packet);
 
 		jpghdr.off += data_len;
 		bytes_left -= data_len;
@@ -742,10 +757,10 @@ static mblk_t *skip_jpeg_headers(mblk_t *full_frame, mblk_t **lqt, mblk_t **cqt)
 	return full_frame;
 }
 
-static void split_and_send(MSFilter *f, EncState *s, mblk_t *frame, bool_t is_iframe){
+static void split_and_send(MSFilter *f, EncState *s, mblk_t *frame, bool_t is_iframe, uint64_t frame_time, MSQueue *out){
 	uint8_t *lastpsc;
 	uint8_t *psc;
-	uint32_t timestamp=(uint32_t)(f->ticker->time*90LL);
+	uint32_t timestamp=(uint32_t)(frame_time*90LL);
 
 	if (s->codec==CODEC_ID_MPEG4
 #if HAVE_AVCODEC_SNOW
@@ -753,7 +768,7 @@ static void split_and_send(MSFilter *f, EncState *s, mblk_t *frame, bool_t is_if
 #endif
 	)
 	{
-		mpeg4_fragment_and_send(f,s,frame,timestamp);
+		mpeg4_fragment_and_send(out,s,frame,timestamp);
 		return;
 	}
 	else if (s->codec==CODEC_ID_MJPEG)
@@ -761,7 +776,7 @@ static void split_and_send(MSFilter *f, EncState *s, mblk_t *frame, bool_t is_if
 		mblk_t *lqt=NULL;
 		mblk_t *cqt=NULL;
 		skip_jpeg_headers(frame, &lqt, &cqt);
-		mjpeg_fragment_and_send(f,s,frame,timestamp,
+		mjpeg_fragment_and_send(out,s,frame,timestamp,
 								1, /* 420? */
 								0,
 								0, /* dri ?*/
@@ -777,30 +792,44 @@ static void split_and_send(MSFilter *f, EncState *s, mblk_t *frame, bool_t is_if
 		while(1){
 			psc=get_psc(lastpsc+2,frame->b_wptr,s->mtu);
 			if (psc!=NULL){
-				rfc4629_generate_follow_on_packets(f,s,frame,timestamp,lastpsc,psc,FALSE);
+				rfc4629_generate_follow_on_packets(out,s,frame,timestamp,lastpsc,psc,FALSE);
 				lastpsc=psc;
 			}else break;
 		}
 		/* send the end of frame */
-		rfc4629_generate_follow_on_packets(f,s,frame, timestamp,lastpsc,frame->b_wptr,TRUE);
+		rfc4629_generate_follow_on_packets(out,s,frame, timestamp,lastpsc,frame->b_wptr,TRUE);
 	}else if (f->desc->id==MS_H263_OLD_ENC_ID){
-		rfc2190_generate_packets(f,s,frame,timestamp,is_iframe);
+		rfc2190_generate_packets(out,s,frame,timestamp,is_iframe);
 	}else{
 		ms_fatal("Ca va tres mal.");
 	}
 }
 
-static void process_frame(MSFilter *f, mblk_t *inm){
+/*
+ * Encode a picture and put the resulting packets in out, with the filter lock held.
+ * It runs in the ticker thread, or in the encoder thread when asynchronous encoding is enabled,
+ * so frame_time must be used instead of f->ticker->time.
+ */
+static void process_frame(MSFilter *f, mblk_t *inm, uint64_t frame_time, MSQueue *out){
 	EncState *s=(EncState*)f->data;
 
 	AVCodecContext *c=&s->av_context;
 	int error,got_packet;
-	mblk_t *comp_buf=s->comp_buf;
-	int comp_buf_sz=comp_buf->b_datap->db_lim-comp_buf->b_datap->db_base;
+	mblk_t *comp_buf;
+	int comp_buf_sz;
 	YuvBuf yuv;
 	struct AVPacket packet;
 	memset(&packet, 0, sizeof(packet));
 
+	if (c->codec==NULL) return;
+	comp_buf=s->comp_buf;
+	comp_buf_sz=comp_buf->b_datap->db_lim-comp_buf->b_datap->db_base;
+	if (comp_buf->b_datap->db_ref>1){
+		/*the packets of the previous frame, which share its buffer, have not been sent yet (asynchronous encoding)*/
+		freemsg(comp_buf);
+		comp_buf=s->comp_buf=allocb(comp_buf_sz,0);
+	}
+
 	ms_yuv_buf_init_from_mblk(&yuv, inm);
 	/* convert image if necessary */
 	av_frame_unref(s->pict);
@@ -809,7 +838,7 @@ static void process_frame(MSFilter *f, mblk_t *inm){
 	/* timestamp used by ffmpeg, unset here */
 	s->pict->pts=AV_NOPTS_VALUE;
 
-	if (ms_video_starter_need_i_frame (&s->starter, f->ticker->time)){
+	if (ms_video_starter_need_i_frame (&s->starter, frame_time)){
 		/*sends an I frame at 2 seconds and 4 seconds after the beginning of the call*/
 		s->req_vfu=TRUE;
 	}
@@ -836,7 +865,7 @@ static void process_frame(MSFilter *f, mblk_t *inm){
 		bool_t is_iframe = FALSE;
 		s->framenum++;
 		if (s->framenum==1){
-			ms_video_starter_first_frame(&s->starter, f->ticker->time);
+			ms_video_starter_first_frame(&s->starter, frame_time);
 		}
 #ifdef AV_PKT_FLAG_KEY
 		if (packet.flags & AV_PKT_FLAG_KEY) {
@@ -847,21 +876,32 @@ static void process_frame(MSFilter *f, mblk_t *inm){
 			is_iframe = TRUE;
 		}
 		comp_buf->b_wptr+=packet.size;
-		split_and_send(f,s,comp_buf,is_iframe);
+		split_and_send(f,s,comp_buf,is_iframe,frame_time,out);
 	}
-	freemsg(inm);
 }
 
 static void enc_process(MSFilter *f){
 	mblk_t *inm;
 	EncState *s=(EncState*)f->data;
+	if (s->async_enabled && s->encoder_thread==NULL){
+		s->encoder_thread=ms_encoder_thread_new(f,process_frame,MAX_PENDING_FRAMES);
+		if (s->encoder_thread==NULL) s->async_enabled=FALSE;
+	}
+	if (s->encoder_thread!=NULL){
+		while((inm=ms_queue_get(f->inputs[0]))!=0){
+			ms_encoder_thread_push(s->encoder_thread,inm,f->ticker->time);
+		}
+		ms_encoder_thread_collect(s->encoder_thread,f->outputs[0]);
+		return;
+	}
 	if (s->av_context.codec==NULL) {
 		ms_queue_flush(f->inputs[0]);
 		return;
 	}
 	ms_filter_lock(f);
 	while((inm=ms_queue_get(f->inputs[0]))!=0){
-		process_frame(f,inm);
+		process_frame(f,inm,f->ticker->time,f->outputs[0]);
+		freemsg(inm);
 	}
 	ms_filter_unlock(f);
 }
@@ -958,6 +998,23 @@ static int enc_get_configuration_list(MSFilter *f, void *data) {
 	return 0;
 }
 
+static int enc_enable_async(MSFilter *f, void *arg){
+	EncState *s=(EncState*)f->data;
+	s->async_enabled=*(bool_t*)arg ? TRUE : FALSE;
+	return 0;
+}
+
+static int enc_get_async_stats(MSFilter *f, void *arg){
+	EncState *s=(EncState*)f->data;
+	MSVideoEncoderAsyncStats *stats=(MSVideoEncoderAsyncStats*)arg;
+	if (s->encoder_thread!=NULL){
+		ms_encoder_thread_get_stats(s->encoder_thread,stats);
+	}else{
+		memset(stats,0,sizeof(MSVideoEncoderAsyncStats));
+	}
+	return 0;
+}
+
 
 static MSFilterMethod methods[] = {
 	{ MS_FILTER_SET_FPS,                       enc_set_fps                },
@@ -972,6 +1029,8 @@ static MSFilterMethod methods[] = {
 	{ MS_VIDEO_ENCODER_REQ_VFU,                enc_req_vfu                },
 	{ MS_VIDEO_ENCODER_GET_CONFIGURATION_LIST, enc_get_configuration_list },
 	{ MS_VIDEO_ENCODER_SET_CONFIGURATION,      enc_set_configuration      },
+	{ MS_VIDEO_ENCODER_ENABLE_ASYNC,           enc_enable_async           },
+	{ MS_VIDEO_ENCODER_GET_ASYNC_STATS,        enc_get_async_stats        },
 	{ 0,                                       NULL                       }
 };
 
@@ -988,7 +1047,7 @@ MSFilterDesc ms_h263_enc_desc={
 	enc_h263_init,
 	enc_preprocess,
 	enc_process,
-	enc_postprocess,
+	enc_detach,
 	enc_uninit,
 	methods
 };
@@ -1004,7 +1063,7 @@ MSFilterDesc ms_h263_old_enc_desc={
 	enc_h263_init,
 	enc_preprocess,
 	enc_process,
-	enc_postprocess,
+	enc_detach,
 	enc_uninit,
 	methods
 };
@@ -1020,7 +1079,7 @@ MSFilterDesc ms_mpeg4_enc_desc={
 	enc_mpeg4_init,
 	enc_preprocess,
 	enc_process,
-	enc_postprocess,
+	enc_detach,
 	enc_uninit,
 	methods
 };
@@ -1036,7 +1095,7 @@ MSFilterDesc ms_snow_enc_desc={
 	enc_snow_init,
 	enc_preprocess,
 	enc_process,
-	enc_postprocess,
+	enc_detach,
 	enc_uninit,
 	methods
 };
@@ -1052,7 +1111,7 @@ MSFilterDesc ms_mjpeg_enc_desc={
 	enc_mjpeg_init,
 	enc_preprocess,
 	enc_process,
-	enc_postprocess,
+	enc_detach,
 	enc_uninit,
 	methods
 };
@@ -1070,7 +1129,7 @@ MSFilterDesc ms_h263_enc_desc={
 	.init=enc_h263_init,
 	.preprocess=enc_preprocess,
 	.process=enc_process,
-	.postprocess=enc_postprocess,
+	.postprocess=enc_detach,
 	.uninit=enc_uninit,
 	.methods=methods
 };
@@ -1086,7 +1145,7 @@ MSFilterDesc ms_h263_old_enc_desc={
 	.init=enc_h263_init,
 	.preprocess=enc_preprocess,
 	.process=enc_process,
-	.postprocess=enc_postprocess,
+	.postprocess=enc_detach,
 	.uninit=enc_uninit,
 	.methods=methods
 };
@@ -1102,7 +1161,7 @@ MSFilterDesc ms_mpeg4_enc_desc={
 	.init=enc_mpeg4_init,
 	.preprocess=enc_preprocess,
 	.process=enc_process,
-	.postprocess=enc_postprocess,
+	.postprocess=enc_detach,
 	.uninit=enc_uninit,
 	.methods=methods
 };
@@ -1122,7 +1181,7 @@ MSFilterDesc ms_snow_enc_desc={
 	.init=enc_snow_init,
 	.preprocess=enc_preprocess,
 	.process=enc_process,
-	.postprocess=enc_postprocess,
+	.postprocess=enc_detach,
 	.uninit=enc_uninit,
 	.methods=methods
 };
@@ -1138,7 +1197,7 @@ MSFilterDesc ms_mjpeg_enc_desc={
 	.init=enc_mjpeg_init,
 	.preprocess=enc_preprocess,
 	.process=enc_process,
-	.postprocess=enc_postprocess,
+	.postprocess=enc_detach,
 	.uninit=enc_uninit,
 	.methods=methods
 };
@@ -0,0 +1,351 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msfactory.h"
+#include "mediastreamer2/msticker.h"
+#include "mediastreamer2/msvideo.h"
+#include "mediastreamer2/msvideomixer.h"
+#include "mediastreamer2/msworkerpool.h"
+#include "layouts.h"
+
+typedef struct _VideoMixerInput {
+	mblk_t *pic; /*last picture received*/
+	MSRect slot; /*where the input is shown in the composed picture*/
+	MSRect pic_rect; /*where the last picture was drawn in its slot, keeping its aspect ratio*/
+	MSScalerContext *scaler;
+	MSVideoSize scaler_src;
+	MSVideoSize scaler_dst;
+	MSPicture *composed;
+	bool_t dirty; /*the slot needs to be composed again*/
+} VideoMixerInput;
+
+typedef struct _VideoMixerState {
+	VideoMixerInput inputs[MS_VIDEO_MIXER_MAX_INPUTS];
+	MSVideoSize vsize;
+	MSPicture composed;
+	mblk_t *composed_msg;
+	MSVideoMixerLayout layout;
+	int active_speaker;
+	float fps;
+	uint64_t last_output_time;
+	bool_t layout_changed;
+} VideoMixerState;
+
+static void video_mixer_init(MSFilter *f){
+	VideoMixerState *s=ms_new0(VideoMixerState,1);
+	MS_VIDEO_SIZE_ASSIGN(s->vsize,VGA);
+	s->layout=MSVideoMixerLayoutGrid;
+	s->fps=15;
+	f->data=s;
+}
+
+static void video_mixer_uninit(MSFilter *f){
+	ms_free(f->data);
+}
+
+static void fill_rect(MSPicture *pic, const MSRect *r){
+	int i;
+	for(i=0;i<r->h;i++){
+		memset(pic->planes[0]+(r->y+i)*pic->strides[0]+r->x,16,r->w);
+	}
+	for(i=0;i<r->h/2;i++){
+		memset(pic->planes[1]+(r->y/2+i)*pic->strides[1]+r->x/2,128,r->w/2);
+		memset(pic->planes[2]+(r->y/2+i)*pic->strides[2]+r->x/2,128,r->w/2);
+	}
+}
+
+/* Assign the slots to the connected inputs, the active speaker first in the active speaker layout. */
+static void video_mixer_compute_layout(MSFilter *f){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	VideoMixerInput *order[MS_VIDEO_MIXER_MAX_INPUTS];
+	MSRect rects[MS_VIDEO_MIXER_MAX_INPUTS];
+	MSRect all;
+	int i,n=0;
+
+	if (s->layout==MSVideoMixerLayoutActiveSpeaker && f->inputs[s->active_speaker]!=NULL){
+		order[n++]=&s->inputs[s->active_speaker];
+	}
+	for(i=0;i<MS_VIDEO_MIXER_MAX_INPUTS;i++){
+		if (f->inputs[i]==NULL) continue;
+		if (s->layout==MSVideoMixerLayoutActiveSpeaker && i==s->active_speaker) continue;
+		order[n++]=&s->inputs[i];
+	}
+	if (s->layout==MSVideoMixerLayoutActiveSpeaker){
+		ms_layout_compute_active_speaker(s->vsize,n,rects);
+	}else{
+		ms_layout_compute_grid(s->vsize,n,rects);
+	}
+	for(i=0;i<n;i++){
+		order[i]->slot=rects[i];
+		memset(&order[i]->pic_rect,0,sizeof(MSRect));
+		order[i]->dirty=TRUE;
+	}
+	all.x=0;
+	all.y=0;
+	all.w=s->vsize.width;
+	all.h=s->vsize.height;
+	fill_rect(&s->composed,&all);
+	s->layout_changed=FALSE;
+}
+
+static void video_mixer_preprocess(MSFilter *f){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	s->composed_msg=ms_yuv_buf_alloc(&s->composed,s->vsize.width,s->vsize.height);
+	s->last_output_time=0;
+	video_mixer_compute_layout(f);
+}
+
+/* Scale the last picture of an input into its slot. Slots do not overlap, so they can be composed in parallel. */
+static void video_mixer_compose_slot(void *data){
+	VideoMixerInput *input=(VideoMixerInput*)data;
+	MSPicture *composed=input->composed;
+	MSPicture src;
+	MSVideoSize slot_size,pic_size;
+	MSRect r;
+	uint8_t *dst_planes[3];
+	int dst_strides[3];
+
+	ms_yuv_buf_init_from_mblk(&src,input->pic);
+	slot_size.width=input->slot.w;
+	slot_size.height=input->slot.h;
+	pic_size.width=src.w;
+	pic_size.height=src.h;
+	ms_layout_center_rectangle(slot_size,pic_size,&r);
+	r.x=(input->slot.x+r.x) & ~0x1;
+	r.y=(input->slot.y+r.y) & ~0x1;
+	if (r.w<=0 || r.h<=0) return;
+	if (memcmp(&r,&input->pic_rect,sizeof(MSRect))!=0){
+		/*the borders left by the previous picture must be cleared*/
+		fill_rect(composed,&input->slot);
+		input->pic_rect=r;
+	}
+	if (input->scaler==NULL || !ms_video_size_equal(input->scaler_src,pic_size) || input->scaler_dst.width!=r.w || input->scaler_dst.height!=r.h){
+		if (input->scaler) ms_scaler_context_free(input->scaler);
+		input->scaler=ms_scaler_create_context(src.w,src.h,MS_YUV420P,r.w,r.h,MS_YUV420P,MS_SCALER_METHOD_BILINEAR);
+		input->scaler_src=pic_size;
+		input->scaler_dst.width=r.w;
+		input->scaler_dst.height=r.h;
+		if (input->scaler==NULL) return;
+	}
+	dst_planes[0]=composed->planes[0]+r.y*composed->strides[0]+r.x;
+	dst_planes[1]=composed->planes[1]+(r.y/2)*composed->strides[1]+r.x/2;
+	dst_planes[2]=composed->planes[2]+(r.y/2)*composed->strides[2]+r.x/2;
+	memcpy(dst_strides,composed->strides,sizeof(dst_strides));
+	ms_scaler_process(input->scaler,src.planes,src.strides,dst_planes,dst_strides);
+}
+
+/* The composed picture may still be used by the filters after this one, in which case it is copied before being changed. */
+static void video_mixer_make_composed_writable(VideoMixerState *s){
+	MSPicture copy;
+	mblk_t *m;
+
+	if (s->composed_msg->b_datap->db_ref==1) return;
+	m=ms_yuv_buf_alloc(&copy,s->vsize.width,s->vsize.height);
+	ms_yuv_buf_copy(s->composed.planes,s->composed.strides,copy.planes,copy.strides,s->vsize);
+	freemsg(s->composed_msg);
+	s->composed_msg=m;
+	s->composed=copy;
+}
+
+static void video_mixer_process(MSFilter *f){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	void *dirty[MS_VIDEO_MIXER_MAX_INPUTS];
+	int i,ndirty=0;
+
+	for(i=0;i<MS_VIDEO_MIXER_MAX_INPUTS;i++){
+		VideoMixerInput *input=&s->inputs[i];
+		mblk_t *m;
+		if (f->inputs[i]==NULL) continue;
+		if ((m=ms_queue_peek_last(f->inputs[i]))!=NULL){
+			ms_queue_remove(f->inputs[i],m);
+			if (input->pic) freemsg(input->pic);
+			input->pic=m;
+			input->dirty=TRUE;
+		}
+		ms_queue_flush(f->inputs[i]);
+	}
+
+	if (s->last_output_time!=0 && (f->ticker->time-s->last_output_time)<(uint64_t)(1000/s->fps)) return;
+	s->last_output_time=f->ticker->time;
+
+	ms_filter_lock(f);
+	if (s->layout_changed){
+		video_mixer_make_composed_writable(s);
+		video_mixer_compute_layout(f);
+	}
+	for(i=0;i<MS_VIDEO_MIXER_MAX_INPUTS;i++){
+		VideoMixerInput *input=&s->inputs[i];
+		if (f->inputs[i]==NULL || !input->dirty || input->pic==NULL) continue;
+		input->dirty=FALSE;
+		dirty[ndirty++]=input;
+	}
+	if (ndirty>0){
+		video_mixer_make_composed_writable(s);
+		for(i=0;i<ndirty;i++){
+			((VideoMixerInput*)dirty[i])->composed=&s->composed;
+		}
+		if (ndirty>1){
+			/*the pool is shared with the other filters of the factory: ms_worker_pool_run() does not wait for the jobs
+			they posted, the ticker thread composes the slots that the busy workers could not take*/
+			ms_worker_pool_run(ms_factory_get_worker_pool(f->factory),video_mixer_compose_slot,dirty,ndirty);
+		}else{
+			video_mixer_compose_slot(dirty[0]);
+		}
+	}
+	ms_filter_unlock(f);
+	ms_queue_put(f->outputs[0],dupmsg(s->composed_msg));
+}
+
+static void video_mixer_postprocess(MSFilter *f){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	int i;
+	for(i=0;i<MS_VIDEO_MIXER_MAX_INPUTS;i++){
+		VideoMixerInput *input=&s->inputs[i];
+		if (input->pic){
+			freemsg(input->pic);
+			input->pic=NULL;
+		}
+		if (input->scaler){
+			ms_scaler_context_free(input->scaler);
+			input->scaler=NULL;
+		}
+		input->dirty=FALSE;
+	}
+	if (s->composed_msg){
+		freemsg(s->composed_msg);
+		s->composed_msg=NULL;
+	}
+}
+
+static int video_mixer_set_vsize(MSFilter *f, void *arg){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	MSVideoSize *vsize=(MSVideoSize*)arg;
+	if (f->ticker!=NULL){
+		ms_error("MSVideoMixer: the picture size cannot be changed while running");
+		return -1;
+	}
+	s->vsize.width=vsize->width & ~0x1;
+	s->vsize.height=vsize->height & ~0x1;
+	return 0;
+}
+
+static int video_mixer_get_vsize(MSFilter *f, void *arg){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	*(MSVideoSize*)arg=s->vsize;
+	return 0;
+}
+
+static int video_mixer_set_fps(MSFilter *f, void *arg){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	float fps=*(float*)arg;
+	if (fps<=0) return -1;
+	s->fps=fps;
+	return 0;
+}
+
+static int video_mixer_get_fps(MSFilter *f, void *arg){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	*(float*)arg=s->fps;
+	return 0;
+}
+
+static int video_mixer_get_pix_fmt(MSFilter *f, void *arg){
+	*(MSPixFmt*)arg=MS_YUV420P;
+	return 0;
+}
+
+static int video_mixer_set_layout(MSFilter *f, void *arg){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	ms_filter_lock(f);
+	s->layout=*(MSVideoMixerLayout*)arg;
+	s->layout_changed=TRUE;
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int video_mixer_set_active_speaker(MSFilter *f, void *arg){
+	VideoMixerState *s=(VideoMixerState*)f->data;
+	int pin=*(int*)arg;
+	if (pin<0 || pin>=MS_VIDEO_MIXER_MAX_INPUTS){
+		ms_error("MSVideoMixer: invalid active speaker pin %i",pin);
+		return -1;
+	}
+	ms_filter_lock(f);
+	if (pin!=s->active_speaker){
+		s->active_speaker=pin;
+		if (s->layout==MSVideoMixerLayoutActiveSpeaker) s->layout_changed=TRUE;
+	}
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static MSFilterMethod video_mixer_methods[]={
+	{	MS_FILTER_SET_VIDEO_SIZE,		video_mixer_set_vsize		},
+	{	MS_FILTER_GET_VIDEO_SIZE,		video_mixer_get_vsize		},
+	{	MS_FILTER_SET_FPS,			video_mixer_set_fps		},
+	{	MS_FILTER_GET_FPS,			video_mixer_get_fps		},
+	{	MS_FILTER_GET_PIX_FMT,			video_mixer_get_pix_fmt		},
+	{	MS_VIDEO_MIXER_SET_LAYOUT,		video_mixer_set_layout		},
+	{	MS_VIDEO_MIXER_SET_ACTIVE_SPEAKER,	video_mixer_set_active_speaker	},
+	{	0,					NULL				}
+};
+
+#ifdef _MSC_VER
+
+MSFilterDesc ms_video_mixer_desc={
+	MS_VIDEO_MIXER_ID,
+	"MSVideoMixer",
+	N_("A filter that composes several video inputs into a single picture."),
+	MS_FILTER_OTHER,
+	NULL,
+	MS_VIDEO_MIXER_MAX_INPUTS,
+	1,
+	video_mixer_init,
+	video_mixer_preprocess,
+	video_mixer_process,
+	video_mixer_postprocess,
+	video_mixer_uninit,
+	video_mixer_methods
+};
+
+#else
+
+MSFilterDesc ms_video_mixer_desc={
+	.id=MS_VIDEO_MIXER_ID,
+	.name="MSVideoMixer",
+	.text=N_("A filter that composes several video inputs into a single picture."),
+	.category=MS_FILTER_OTHER,
+	.ninputs=MS_VIDEO_MIXER_MAX_INPUTS,
+	.noutputs=1,
+	.init=video_mixer_init,
+	.preprocess=video_mixer_preprocess,
+	.process=video_mixer_process,
+	.postprocess=video_mixer_postprocess,
+	.uninit=video_mixer_uninit,
+	.methods=video_mixer_methods
+};
+
+#endif
+
+MS_FILTER_DESC_EXPORT(ms_video_mixer_desc)
@@ -0,0 +1,371 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msticker.h"
+#include "mediastreamer2/mscodecutils.h"
+#include "mediastreamer2/msvideoswitcher.h"
+#include "mediastreamer2/formats.h"
+
+/*minimum interval between two key frame requests sent to a participant*/
+#define MIN_KEY_FRAME_REQUEST_INTERVAL 1000
+
+typedef bool_t (*KeyFrameDetectorFunc)(const mblk_t *m);
+
+typedef struct _SwitcherInput {
+	MSIFrameRequestsLimiterCtx iframe_limiter;
+	bool_t fir_requested; /*send a FIR rather than a PLI*/
+} SwitcherInput;
+
+typedef struct _SwitcherOutput {
+	int current_source; /*-1 when nothing is forwarded*/
+	int next_source; /*-1 when no switch is pending*/
+	uint32_t ts_offset;
+	uint32_t last_ts;
+	uint64_t last_ts_time;
+	bool_t ts_initialized;
+} SwitcherOutput;
+
+typedef struct _VideoSwitcherState {
+	SwitcherInput inputs[MS_VIDEO_SWITCHER_MAX_INPUTS];
+	SwitcherOutput outputs[MS_VIDEO_SWITCHER_MAX_INPUTS];
+	KeyFrameDetectorFunc is_key_frame_start;
+	int focus;
+	int previous_focus;
+	int clock_rate;
+} VideoSwitcherState;
+
+/*
+ * A VP8 payload (RFC7741) starts a key frame if it is the beginning of the first partition and the P bit of the VP8
+ * payload header is not set.
+ */
+static bool_t vp8_is_key_frame_start(const mblk_t *m){
+	const uint8_t *p=m->b_rptr;
+	const uint8_t *end=m->b_wptr;
+	uint8_t desc;
+
+	if (p>=end) return FALSE;
+	desc=*p++;
+	if (!(desc & 0x10) || (desc & 0x07)!=0) return FALSE; /*S bit and partition index*/
+	if (desc & 0x80){
+		uint8_t ext;
+		if (p>=end) return FALSE;
+		ext=*p++;
+		if (ext & 0x80){ /*picture id, 7 or 15 bits*/
+			if (p>=end) return FALSE;
+			p+=(*p & 0x80) ? 2 : 1;
+		}
+		if (ext & 0x40) p++; /*TL0PICIDX*/
+		if (ext & 0x30) p++; /*TID and KEYIDX*/
+	}
+	if (p>=end) return FALSE;
+	return (*p & 0x01)==0;
+}
+
+static bool_t h264_nal_starts_key_frame(uint8_t nal_type){
+	return nal_type==7 /*SPS*/ || nal_type==5 /*IDR*/;
+}
+
+/*
+ * A H264 payload (RFC6184) starts a key frame if it carries a SPS or the beginning of an IDR slice, directly or
+ * within a STAP-A or FU-A packet.
+ */
+static bool_t h264_is_key_frame_start(const mblk_t *m){
+	const uint8_t *p=m->b_rptr;
+	const uint8_t *end=m->b_wptr;
+	uint8_t nal_type;
+
+	if (p>=end) return FALSE;
+	nal_type=*p & 0x1f;
+	if (nal_type==24){
+		p++;
+		while (p+2<end){
+			int size=(p[0]<<8) | p[1];
+			p+=2;
+			if (size==0 || p+size>end) break;
+			if (h264_nal_starts_key_frame(*p & 0x1f)) return TRUE;
+			p+=size;
+		}
+		return FALSE;
+	}else if (nal_type==28){
+		if (p+1>=end) return FALSE;
+		return (p[1] & 0x80) && h264_nal_starts_key_frame(p[1] & 0x1f);
+	}
+	return h264_nal_starts_key_frame(nal_type);
+}
+
+static void video_switcher_init(MSFilter *f){
+	VideoSwitcherState *s=ms_new0(VideoSwitcherState,1);
+	int i;
+	for (i=0;i<MS_VIDEO_SWITCHER_MAX_INPUTS;++i){
+		ms_iframe_requests_limiter_init(&s->inputs[i].iframe_limiter,MIN_KEY_FRAME_REQUEST_INTERVAL);
+		s->outputs[i].current_source=-1;
+		s->outputs[i].next_source=-1;
+	}
+	s->focus=-1;
+	s->previous_focus=-1;
+	s->clock_rate=90000;
+	s->is_key_frame_start=vp8_is_key_frame_start;
+	f->data=s;
+}
+
+static void video_switcher_uninit(MSFilter *f){
+	ms_free(f->data);
+}
+
+static void request_key_frame(VideoSwitcherState *s, int pin, bool_t fir){
+	SwitcherInput *input=&s->inputs[pin];
+	ms_iframe_requests_limiter_request_iframe(&input->iframe_limiter);
+	if (fir) input->fir_requested=TRUE;
+}
+
+/*the source an output must forward when the focus is given to a participant*/
+static int get_source_for_output(VideoSwitcherState *s, int pin){
+	if (pin!=s->focus) return s->focus;
+	return s->previous_focus;
+}
+
+static void update_sources(MSFilter *f){
+	VideoSwitcherState *s=(VideoSwitcherState*)f->data;
+	int i;
+
+	for (i=0;i<MS_VIDEO_SWITCHER_MAX_INPUTS;++i){
+		SwitcherOutput *output=&s->outputs[i];
+		int source;
+
+		if (f->outputs[i]==NULL){
+			/*the pin may be reused by another participant*/
+			memset(output,0,sizeof(SwitcherOutput));
+			output->current_source=output->next_source=-1;
+			continue;
+		}
+		source=get_source_for_output(s,i);
+		if (source!=-1 && f->inputs[source]==NULL) source=-1;
+		if (source==output->current_source){
+			output->next_source=-1;
+		}else if (source==-1){
+			output->current_source=output->next_source=-1;
+		}else if (source!=output->next_source){
+			/*keep forwarding the current source until the new one sends a key frame*/
+			output->next_source=source;
+			request_key_frame(s,source,TRUE);
+		}
+	}
+}
+
+static void video_switcher_preprocess(MSFilter *f){
+	VideoSwitcherState *s=(VideoSwitcherState*)f->data;
+	int i;
+
+	ms_filter_lock(f);
+	if (s->focus==-1){
+		for (i=0;i<MS_VIDEO_SWITCHER_MAX_INPUTS;++i){
+			if (f->inputs[i]!=NULL){
+				s->focus=i;
+				break;
+			}
+		}
+	}
+	update_sources(f);
+	ms_filter_unlock(f);
+}
+
+static void switch_source(MSFilter *f, SwitcherOutput *output, uint32_t ts){
+	VideoSwitcherState *s=(VideoSwitcherState*)f->data;
+	if (output->ts_initialized){
+		/*continue the timestamps of the previous source, advanced by the time elapsed since its last frame*/
+		uint32_t elapsed=(uint32_t)(((f->ticker->time-output->last_ts_time)*(uint64_t)s->clock_rate)/1000);
+		if (elapsed==0) elapsed=1;
+		output->ts_offset=output->last_ts+elapsed-ts;
+	}
+	output->current_source=output->next_source;
+	output->next_source=-1;
+}
+
+static void forward_packet(MSFilter *f, int pin, SwitcherOutput *output, mblk_t *m){
+	mblk_t *dup=dupmsg(m);
+	uint32_t ts=mblk_get_timestamp_info(m)+output->ts_offset;
+
+	if (!output->ts_initialized || ts!=output->last_ts){
+		output->last_ts=ts;
+		output->last_ts_time=f->ticker->time;
+		output->ts_initialized=TRUE;
+	}
+	mblk_set_timestamp_info(dup,ts);
+	ms_queue_put(f->outputs[pin],dup);
+}
+
+static void send_key_frame_requests(MSFilter *f){
+	VideoSwitcherState *s=(VideoSwitcherState*)f->data;
+	int i;
+
+	for (i=0;i<MS_VIDEO_SWITCHER_MAX_INPUTS;++i){
+		SwitcherInput *input=&s->inputs[i];
+		if (f->inputs[i]==NULL) continue;
+		if (ms_iframe_requests_limiter_iframe_requested(&input->iframe_limiter,f->ticker->time)){
+			ms_filter_notify(f,input->fir_requested ? MS_VIDEO_SWITCHER_SEND_FIR : MS_VIDEO_SWITCHER_SEND_PLI,&i);
+			ms_iframe_requests_limiter_notify_iframe_sent(&input->iframe_limiter,f->ticker->time);
+			input->fir_requested=FALSE;
+		}
+	}
+}
+
+static void video_switcher_process(MSFilter *f){
+	VideoSwitcherState *s=(VideoSwitcherState*)f->data;
+	int i,j;
+	mblk_t *m;
+
+	ms_filter_lock(f);
+	for (i=0;i<MS_VIDEO_SWITCHER_MAX_INPUTS;++i){
+		if (f->inputs[i]==NULL) continue;
+		while((m=ms_queue_get(f->inputs[i]))!=NULL){
+			bool_t key_frame_start=s->is_key_frame_start(m);
+
+			if (key_frame_start){
+				/*a pending request is satisfied by this key frame, whoever asked for it*/
+				s->inputs[i].iframe_limiter.iframe_required=FALSE;
+				s->inputs[i].fir_requested=FALSE;
+			}
+			for (j=0;j<MS_VIDEO_SWITCHER_MAX_INPUTS;++j){
+				SwitcherOutput *output=&s->outputs[j];
+				if (f->outputs[j]==NULL) continue;
+				if (key_frame_start && output->next_source==i)
+					switch_source(f,output,mblk_get_timestamp_info(m));
+				if (output->current_source==i)
+					forward_packet(f,j,output,m);
+			}
+			freemsg(m);
+		}
+	}
+	send_key_frame_requests(f);
+	ms_filter_unlock(f);
+}
+
+static int video_switcher_set_input_fmt(MSFilter *f, void *arg){
+	VideoSwitcherState *s=(VideoSwitcherState*)f->data;
+	const MSPinFormat *pinfmt=(const MSPinFormat*)arg;
+	const MSFmtDescriptor *fmt=pinfmt->fmt;
+
+	if (fmt==NULL || fmt->encoding==NULL) return -1;
+	if (strcasecmp(fmt->encoding,"VP8")==0){
+		s->is_key_frame_start=vp8_is_key_frame_start;
+	}else if (strcasecmp(fmt->encoding,"H264")==0){
+		s->is_key_frame_start=h264_is_key_frame_start;
+	}else{
+		ms_error("MSVideoSwitcher: unsupported encoding %s",fmt->encoding);
+		return -1;
+	}
+	if (fmt->rate>0) s->clock_rate=fmt->rate;
+	return 0;
+}
+
+static int check_pin(MSFilter *f, int pin){
+	if (pin<0 || pin>=MS_VIDEO_SWITCHER_MAX_INPUTS){
+		ms_error("MSVideoSwitcher: invalid pin %i",pin);
+		return -1;
+	}
+	return 0;
+}
+
+static int video_switcher_set_focus(MSFilter *f, void *arg){
+	VideoSwitcherState *s=(VideoSwitcherState*)f->data;
+	int pin=*(int*)arg;
+
+	if (check_pin(f,pin)!=0) return -1;
+	ms_filter_lock(f);
+	if (pin!=s->focus){
+		ms_message("MSVideoSwitcher: focus given to pin %i",pin);
+		s->previous_focus=s->focus;
+		s->focus=pin;
+		update_sources(f);
+	}
+	ms_filter_unlock(f);
+	return 0;
+}
+
+/*a key frame request from a participant is for the source it is being forwarded*/
+static int notify_key_frame_request(MSFilter *f, int pin, bool_t fir){
+	VideoSwitcherState *s=(VideoSwitcherState*)f->data;
+	int source;
+
+	if (check_pin(f,pin)!=0) return -1;
+	ms_filter_lock(f);
+	source=s->outputs[pin].current_source;
+	if (source!=-1) request_key_frame(s,source,fir);
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int video_switcher_notify_pli(MSFilter *f, void *arg){
+	return notify_key_frame_request(f,*(int*)arg,FALSE);
+}
+
+static int video_switcher_notify_fir(MSFilter *f, void *arg){
+	return notify_key_frame_request(f,*(int*)arg,TRUE);
+}
+
+static MSFilterMethod video_switcher_methods[]={
+	{	MS_FILTER_SET_INPUT_FMT,		video_switcher_set_input_fmt	},
+	{	MS_VIDEO_SWITCHER_SET_FOCUS,		video_switcher_set_focus	},
+	{	MS_VIDEO_SWITCHER_NOTIFY_PLI,		video_switcher_notify_pli	},
+	{	MS_VIDEO_SWITCHER_NOTIFY_FIR,		video_switcher_notify_fir	},
+	{	0,					NULL				}
+};
+
+#ifdef _MSC_VER
+
+MSFilterDesc ms_video_switcher_desc={
+	MS_VIDEO_SWITCHER_ID,
+	"MSVideoSwitcher",
+	N_("A filter that forwards encoded video between the participants of a conference."),
+	MS_FILTER_OTHER,
+	NULL,
+	MS_VIDEO_SWITCHER_MAX_INPUTS,
+	MS_VIDEO_SWITCHER_MAX_INPUTS,
+	video_switcher_init,
+	video_switcher_preprocess,
+	video_switcher_process,
+	NULL,
+	video_switcher_uninit,
+	video_switcher_methods
+};
+
+#else
+
+MSFilterDesc ms_video_switcher_desc={
+	.id=MS_VIDEO_SWITCHER_ID,
+	.name="MSVideoSwitcher",
+	.text=N_("A filter that forwards encoded video between the participants of a conference."),
+	.category=MS_FILTER_OTHER,
+	.ninputs=MS_VIDEO_SWITCHER_MAX_INPUTS,
+	.noutputs=MS_VIDEO_SWITCHER_MAX_INPUTS,
+	.init=video_switcher_init,
+	.preprocess=video_switcher_preprocess,
+	.process=video_switcher_process,
+	.uninit=video_switcher_uninit,
+	.methods=video_switcher_methods
+};
+
+#endif
+
+MS_FILTER_DESC_EXPORT(ms_video_switcher_desc)
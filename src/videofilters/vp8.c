@@ -23,6 +23,7 @@
 #include "mediastreamer2/msticker.h"
 #include "mediastreamer2/msvideo.h"
 #include "mediastreamer2/mscodecutils.h"
+#include "mediastreamer2/msencoderthread.h"
 #include "vp8rtpfmt.h"
 
 #define PICTURE_ID_ON_16_BITS
@@ -81,27 +82,76 @@ typedef struct EncFramesState {
 	vpx_codec_pts_t last_independent_frame;
 } EncFramesState;
 
+/*
+ * State of the controller adapting the encoder speed to the load of the host.
+ * Every LOAD_CONTROL_PERIOD, it compares the ticker load and the mean encoding time of a frame
+ * (relative to the frame interval) to thresholds, and acts on cpu-used, the number of threads,
+ * and as a last resort on the configuration, whose frame rate it lowers.
+ */
+typedef struct EncLoadControl {
+	uint64_t period_start; /*frame time at which the current measurement period started*/
+	uint64_t encode_time; /*cumulated encoding time during the period, in microseconds*/
+	uint64_t last_frame_time; /*frame time of the last encoded frame*/
+	int nframes; /*number of frames encoded during the period*/
+	int cpuused_increase; /*added to the cpu-used value chosen at preprocess*/
+	int threads; /*number of threads chosen by the controller, 0 until it changes it*/
+	int underload_count; /*number of consecutive periods with low load*/
+	MSVideoConfiguration configured_vconf; /*configuration to restore once the load allows it, valid when fps_lowered is set*/
+	bool_t enabled;
+	bool_t fps_lowered; /*the frame rate of the configuration was lowered, so frames must be skipped*/
+	bool_t overloaded; /*no lighter setting was left, reported once*/
+} EncLoadControl;
+
+#define MAX_SIMULCAST_LAYERS 3 /*including the full resolution one*/
+#define MIN_SIMULCAST_LAYER_WIDTH 128
+
+/*
+ * In simulcast mode, the picture is also encoded at lower resolutions, each layer being half the size of the previous one,
+ * and each layer is sent on its own output, so to its own RTP session with its own SSRC. Layer 0 has the full resolution.
+ * When libvpx supports it, the layers are encoded by its multi-resolution encoder, which reuses the motion analysis of
+ * the lower layers for the upper ones.
+ */
 typedef struct EncState {
-	vpx_codec_ctx_t codec;
-	vpx_codec_enc_cfg_t cfg;
+	vpx_codec_ctx_t codec[MAX_SIMULCAST_LAYERS]; /*one per layer, contiguous as required by vpx_codec_enc_init_multi()*/
+	vpx_codec_enc_cfg_t cfg[MAX_SIMULCAST_LAYERS];
 	vpx_codec_pts_t frame_count;
+	vpx_codec_pts_t pts; /*timestamp of the next picture given to libvpx, in units of its timebase*/
 	vpx_codec_iface_t *iface;
 	vpx_codec_flags_t flags;
 	EncFramesState frames_state;
-	Vp8RtpFmtPackerCtx packer;
+	Vp8RtpFmtPackerCtx packer[MAX_SIMULCAST_LAYERS];
+	mblk_t *layer_pics[MAX_SIMULCAST_LAYERS]; /*downscaled pictures of the layers above 0*/
+	MSPicture layer_yuv[MAX_SIMULCAST_LAYERS];
+	MSScalerContext *layer_scalers[MAX_SIMULCAST_LAYERS]; /*from the previous layer*/
+	int simulcast_layers; /*number of layers requested*/
+	int nlayers; /*number of layers encoded*/
 	MSVideoStarter starter;
 	MSVideoConfiguration vconf;
 	const MSVideoConfiguration *vconf_list;
+	MSEncoderThread *encoder_thread;
+	EncLoadControl load_control;
+	int cpuused;
 	int last_fir_seq_nr;
 	uint16_t picture_id;
 	uint16_t last_sli_id;
 	bool_t force_keyframe;
 	bool_t invalid_frame_reported;
 	bool_t avpf_enabled;
+	bool_t async_enabled;
+	bool_t multi_res; /*the layers are encoded by the multi-resolution encoder of libvpx, not independently*/
 	bool_t ready;
 } EncState;
 
 #define MIN_KEY_FRAME_DIST 4 /*since one i-frame is allowed to be 4 times bigger of the target bitrate*/
+#define MAX_PENDING_FRAMES 1 /*in asynchronous mode, number of frames that can wait while the previous one is being encoded*/
+
+#define MAX_CPUUSED 16
+#define LOAD_CONTROL_PERIOD 1000 /*ms*/
+#define HIGH_TICKER_LOAD 80.f /*percent*/
+#define LOW_TICKER_LOAD 50.f
+#define HIGH_ENCODING_RATIO 0.7f /*mean encoding time over frame interval, frames are dropped or late above 1*/
+#define LOW_ENCODING_RATIO 0.3f
+#define UNDERLOAD_PERIODS 5 /*number of low load periods before undoing the last measure of the controller*/
 
 static bool_t should_generate_key_frame(EncState *s, int min_interval);
 static void enc_reset_frames_state(EncState *s);
@@ -124,6 +174,7 @@ static void enc_init(MSFilter *f) {
 	s->picture_id = ortp_random() & 0x007F;
 #endif
 	s->avpf_enabled = FALSE;
+	s->simulcast_layers = 1;
 	enc_reset_frames_state(s);
 	f->data = s;
 }
@@ -143,11 +194,108 @@ static void enc_reset_frames_state(EncState *s){
 	s->frames_state.reconstruct.type=VP8_LAST_FRAME;
 }
 
+/* Token partitions can be encoded and decoded in parallel, use about one per thread (the value is a log2). */
+static int enc_token_partitions_for_threads(int threads) {
+	if (threads >= 8) return 3;
+	if (threads >= 4) return 2;
+	if (threads >= 2) return 1;
+	return 0;
+}
+
+/* Number of threads used when the load controller has not changed it. */
+static int enc_get_default_threads(MSFilter *f) {
+#if TARGET_IPHONE_SIMULATOR
+	return 1; /*workaround to remove crash on ipad simulator*/
+#else
+	return ms_factory_get_cpu_count(f->factory);
+#endif
+}
+
+/* Number of simulcast layers that can be encoded: they must be requested, have their output connected and not be too small. */
+static int enc_get_layer_count(MSFilter *f) {
+	EncState *s = (EncState *)f->data;
+	int width = s->vconf.vsize.width;
+	int nlayers = 1;
+
+	while (nlayers < s->simulcast_layers && f->outputs[nlayers] != NULL) {
+		width = (width + 1) / 2;
+		if (width < MIN_SIMULCAST_LAYER_WIDTH) break;
+		nlayers++;
+	}
+	return nlayers;
+}
+
+/*
+ * Share the bitrate of the configuration between the simulcast layers, from the smallest one, which is always encoded.
+ * The layers get the bitrate of the configuration of the list for their size, the largest encoded layer gets what remains,
+ * and the layers that do not fit are disabled: libvpx skips the layers whose target bitrate is 0.
+ */
+static void enc_allocate_layers_bitrate(MSFilter *f) {
+	EncState *s = (EncState *)f->data;
+	int bitrates[MAX_SIMULCAST_LAYERS] = { 0 };
+	int remaining = s->vconf.required_bitrate;
+	int cpu_count = ms_factory_get_cpu_count(f->factory);
+	int top = s->nlayers - 1;
+	int i;
+
+	for (i = s->nlayers - 1; i >= 0; i--) {
+		MSVideoConfiguration vconf;
+		MSVideoSize vsize;
+		int needed;
+
+		vsize.width = (int)s->cfg[i].g_w;
+		vsize.height = (int)s->cfg[i].g_h;
+		vconf = ms_video_find_best_configuration_for_size(s->vconf_list, vsize, cpu_count);
+		needed = (vconf.required_bitrate > 0) ? vconf.required_bitrate : vconf.bitrate_limit;
+		if (i < s->nlayers - 1 && needed > remaining) break;
+		bitrates[i] = MIN(needed, remaining);
+		remaining -= bitrates[i];
+		top = i;
+	}
+	bitrates[top] += remaining;
+	for (i = 0; i < s->nlayers; i++) {
+		s->cfg[i].rc_target_bitrate = (unsigned int)(((float)bitrates[i]) * 0.92f / 1024.0f);
+		ms_message("VP8 encoder [%p]: simulcast layer %i is %ux%u at %ikbits/s", f, i, s->cfg[i].g_w, s->cfg[i].g_h, (int)s->cfg[i].rc_target_bitrate);
+	}
+}
+
+static vpx_codec_err_t enc_init_layers(MSFilter *f) {
+	EncState *s = (EncState *)f->data;
+	vpx_rational_t dsf[MAX_SIMULCAST_LAYERS];
+	vpx_codec_err_t res;
+	int i;
+
+	for (i = 0; i < MAX_SIMULCAST_LAYERS; i++) {
+		dsf[i].num = 2;
+		dsf[i].den = 1;
+	}
+	res = vpx_codec_enc_init_multi(s->codec, s->iface, s->cfg, s->nlayers, s->flags, dsf);
+	s->multi_res = (res == VPX_CODEC_OK);
+	if (!s->multi_res) {
+		/* libvpx was built without multi-resolution encoding support. */
+		ms_warning("VP8 encoder [%p]: multi-resolution encoding not available (%s), encoding the layers independently", f, vpx_codec_err_to_string(res));
+		for (i = 0; i < s->nlayers; i++) {
+			res = vpx_codec_enc_init(&s->codec[i], s->iface, &s->cfg[i], s->flags);
+			if (res) {
+				while (--i >= 0) vpx_codec_destroy(&s->codec[i]);
+				return res;
+			}
+		}
+	}
+	for (i = 1; i < s->nlayers; i++) {
+		s->layer_pics[i] = ms_yuv_buf_alloc(&s->layer_yuv[i], (int)s->cfg[i].g_w, (int)s->cfg[i].g_h);
+		s->layer_scalers[i] = ms_scaler_create_context((int)s->cfg[i - 1].g_w, (int)s->cfg[i - 1].g_h, MS_YUV420P,
+			(int)s->cfg[i].g_w, (int)s->cfg[i].g_h, MS_YUV420P, MS_SCALER_METHOD_BILINEAR);
+	}
+	return VPX_CODEC_OK;
+}
+
 static void enc_preprocess(MSFilter *f) {
 	EncState *s = (EncState *)f->data;
 	vpx_codec_err_t res;
 	vpx_codec_caps_t caps;
 	int cpuused=0;
+	int i;
 
 	/* Populate encoder configuration */
 	s->flags = 0;
@@ -155,63 +303,80 @@ static void enc_preprocess(MSFilter *f) {
 	if ((s->avpf_enabled == TRUE) && (caps & VPX_CODEC_CAP_OUTPUT_PARTITION)) {
 		s->flags |= VPX_CODEC_USE_OUTPUT_PARTITION;
 	}
-	res = vpx_codec_enc_config_default(s->iface, &s->cfg, 0);
+	res = vpx_codec_enc_config_default(s->iface, &s->cfg[0], 0);
 	if (res) {
 		ms_error("Failed to get config: %s", vpx_codec_err_to_string(res));
 		return;
 	}
-	s->cfg.rc_target_bitrate = (unsigned int)(((float)s->vconf.required_bitrate) * 0.92f / 1024.0f); //0.92=take into account IP/UDP/RTP overhead, in average.
-	s->cfg.g_pass = VPX_RC_ONE_PASS; /* -p 1 */
-	s->cfg.g_timebase.num = 1;
-	s->cfg.g_timebase.den = (int)s->vconf.fps;
-	s->cfg.rc_end_usage = VPX_CBR; /* --end-usage=cbr */
+	s->cfg[0].rc_target_bitrate = (unsigned int)(((float)s->vconf.required_bitrate) * 0.92f / 1024.0f); //0.92=take into account IP/UDP/RTP overhead, in average.
+	s->cfg[0].g_pass = VPX_RC_ONE_PASS; /* -p 1 */
+	s->cfg[0].g_timebase.num = 1;
+	s->cfg[0].g_timebase.den = (int)s->vconf.fps;
+	s->cfg[0].rc_end_usage = VPX_CBR; /* --end-usage=cbr */
 	if (s->avpf_enabled == TRUE) {
-		s->cfg.kf_mode = VPX_KF_DISABLED;
+		s->cfg[0].kf_mode = VPX_KF_DISABLED;
 	} else {
-		s->cfg.kf_mode = VPX_KF_AUTO; /* encoder automatically places keyframes */
-		s->cfg.kf_max_dist = 10 * s->cfg.g_timebase.den; /* 1 keyframe each 10s. */
+		s->cfg[0].kf_mode = VPX_KF_AUTO; /* encoder automatically places keyframes */
+		s->cfg[0].kf_max_dist = 10 * s->cfg[0].g_timebase.den; /* 1 keyframe each 10s. */
 	}
-#if TARGET_IPHONE_SIMULATOR
-	s->cfg.g_threads = 1; /*workaround to remove crash on ipad simulator*/
-#else
-	s->cfg.g_threads = ms_factory_get_cpu_count(f->factory);
-#endif
-	ms_message("VP8 g_threads=%d", s->cfg.g_threads);
-	s->cfg.rc_undershoot_pct = 95; /* --undershoot-pct=95 */
-	s->cfg.g_error_resilient = VPX_ERROR_RESILIENT_DEFAULT|VPX_ERROR_RESILIENT_PARTITIONS;
-	s->cfg.g_lag_in_frames = 0;
+	s->cfg[0].g_threads = s->load_control.threads ? s->load_control.threads : enc_get_default_threads(f);
+	ms_message("VP8 g_threads=%d", s->cfg[0].g_threads);
+	s->cfg[0].rc_undershoot_pct = 95; /* --undershoot-pct=95 */
+	s->cfg[0].g_error_resilient = VPX_ERROR_RESILIENT_DEFAULT|VPX_ERROR_RESILIENT_PARTITIONS;
+	s->cfg[0].g_lag_in_frames = 0;
 
 
 #if defined(ANDROID) || (TARGET_OS_IPHONE == 1) || defined(__arm__) || defined(_M_ARM)
-	cpuused = 10 - s->cfg.g_threads; /*cpu/quality tradeoff: positive values decrease CPU usage at the expense of quality*/
+	cpuused = 10 - s->cfg[0].g_threads; /*cpu/quality tradeoff: positive values decrease CPU usage at the expense of quality*/
 	if (cpuused < 7) cpuused = 7; /*values beneath 7 consume too much CPU*/
-	if( s->cfg.g_threads == 1 ){
+	if( s->cfg[0].g_threads == 1 ){
 		/* on mono-core iOS devices, we reduce the quality a bit more due to VP8 being slower with new Clang compilers */
 		cpuused = 16;
 	}
 #endif
 
-	s->cfg.g_w = s->vconf.vsize.width;
-	s->cfg.g_h = s->vconf.vsize.height;
+	cpuused += s->load_control.cpuused_increase;
+	if (cpuused > MAX_CPUUSED) cpuused = MAX_CPUUSED;
+	s->cpuused = cpuused;
+
+	s->cfg[0].g_w = s->vconf.vsize.width;
+	s->cfg[0].g_h = s->vconf.vsize.height;
+
+	s->nlayers = enc_get_layer_count(f);
+	for (i = 1; i < s->nlayers; i++) {
+		s->cfg[i] = s->cfg[i - 1];
+		s->cfg[i].g_w = (s->cfg[i - 1].g_w + 1) / 2;
+		s->cfg[i].g_h = (s->cfg[i - 1].g_h + 1) / 2;
+	}
+	if (s->nlayers > 1) enc_allocate_layers_bitrate(f);
 
 	/* Initialize codec */
-	res =  vpx_codec_enc_init(&s->codec, s->iface, &s->cfg, s->flags);
+	if (s->nlayers > 1) {
+		res = enc_init_layers(f);
+	} else {
+		res = vpx_codec_enc_init(&s->codec[0], s->iface, &s->cfg[0], s->flags);
+	}
 	if (res) {
-		ms_error("vpx_codec_enc_init failed: %s (%s)", vpx_codec_err_to_string(res), vpx_codec_error_detail(&s->codec));
+		ms_error("vpx_codec_enc_init failed: %s (%s)", vpx_codec_err_to_string(res), vpx_codec_error_detail(&s->codec[0]));
+		s->nlayers = 0;
 		return;
 	}
-	vpx_codec_control(&s->codec, VP8E_SET_CPUUSED, cpuused);
-	vpx_codec_control(&s->codec, VP8E_SET_STATIC_THRESHOLD, 0);
-	vpx_codec_control(&s->codec, VP8E_SET_ENABLEAUTOALTREF, !s->avpf_enabled);
-	vpx_codec_control(&s->codec, VP8E_SET_MAX_INTRA_BITRATE_PCT, 400); /*limite iFrame size to 4 pframe*/
-	if (s->flags & VPX_CODEC_USE_OUTPUT_PARTITION) {
-		vpx_codec_control(&s->codec, VP8E_SET_TOKEN_PARTITIONS, 2); /* Output 4 partitions per frame */
-	} else {
-		vpx_codec_control(&s->codec, VP8E_SET_TOKEN_PARTITIONS, 0);
+	for (i = 0; i < s->nlayers; i++) {
+		vpx_codec_control(&s->codec[i], VP8E_SET_CPUUSED, cpuused);
+		vpx_codec_control(&s->codec[i], VP8E_SET_STATIC_THRESHOLD, 0);
+		vpx_codec_control(&s->codec[i], VP8E_SET_ENABLEAUTOALTREF, !s->avpf_enabled);
+		vpx_codec_control(&s->codec[i], VP8E_SET_MAX_INTRA_BITRATE_PCT, 400); /*limite iFrame size to 4 pframe*/
+		if (s->flags & VPX_CODEC_USE_OUTPUT_PARTITION) {
+			vpx_codec_control(&s->codec[i], VP8E_SET_TOKEN_PARTITIONS, 2); /* Output 4 partitions per frame */
+		} else if (s->load_control.threads > 1) {
+			vpx_codec_control(&s->codec[i], VP8E_SET_TOKEN_PARTITIONS, enc_token_partitions_for_threads(s->load_control.threads));
+		} else {
+			vpx_codec_control(&s->codec[i], VP8E_SET_TOKEN_PARTITIONS, 0);
+		}
+		vp8rtpfmt_packer_init(&s->packer[i]);
 	}
 
 	s->invalid_frame_reported = FALSE;
-	vp8rtpfmt_packer_init(&s->packer);
 	if (s->avpf_enabled == TRUE) {
 		s->force_keyframe = TRUE;
 	} else if (s->frame_count == 0) {
@@ -424,144 +589,382 @@ static bool_t is_frame_independent(unsigned int flags){
 	return FALSE;
 }
 
-static void enc_process(MSFilter *f) {
-	mblk_t *im;
-	uint64_t timems = f->ticker->time;
-	uint32_t timestamp = (uint32_t)(timems*90);
+static void enc_set_threads(EncState *s, int threads) {
+	vpx_codec_err_t err;
+	int i;
+	s->load_control.threads = threads;
+	for (i = 0; i < s->nlayers; i++) {
+		s->cfg[i].g_threads = threads;
+		err = vpx_codec_enc_config_set(&s->codec[i], &s->cfg[i]);
+		if (err) {
+			ms_error("VP8: could not change the number of threads of layer %i: %s", i, vpx_codec_err_to_string(err));
+			continue;
+		}
+		if (!(s->flags & VPX_CODEC_USE_OUTPUT_PARTITION)) {
+			vpx_codec_control(&s->codec[i], VP8E_SET_TOKEN_PARTITIONS, enc_token_partitions_for_threads(threads));
+		}
+	}
+}
+
+static void enc_set_cpuused(EncState *s, int cpuused) {
+	int i;
+	for (i = 0; i < s->nlayers; i++) {
+		vpx_codec_control(&s->codec[i], VP8E_SET_CPUUSED, cpuused);
+	}
+}
+
+/*
+ * Give the frame rate and the bitrate of the configuration to the running encoders. Unlike a restart of the encoders,
+ * this does not produce a key frame.
+ */
+static void enc_update_frame_rate(MSFilter *f) {
+	EncState *s = (EncState *)f->data;
+	int den = s->cfg[0].g_timebase.den;
+	vpx_codec_err_t err;
+	int i;
+
+	/* libvpx converts the timestamps with the timebase, they must keep increasing with the new one. */
+	s->pts = (s->pts * (int)s->vconf.fps + den - 1) / den;
+	s->cfg[0].rc_target_bitrate = (unsigned int)(((float)s->vconf.required_bitrate) * 0.92f / 1024.0f);
+	for (i = 0; i < s->nlayers; i++) {
+		s->cfg[i].g_timebase.den = (int)s->vconf.fps;
+		if (s->avpf_enabled != TRUE) s->cfg[i].kf_max_dist = 10 * s->cfg[i].g_timebase.den;
+	}
+	if (s->nlayers > 1) enc_allocate_layers_bitrate(f);
+	for (i = 0; i < s->nlayers; i++) {
+		err = vpx_codec_enc_config_set(&s->codec[i], &s->cfg[i]);
+		if (err) ms_error("VP8 encoder [%p]: could not change the frame rate: %s", f, vpx_codec_err_to_string(err));
+	}
+}
+
+/*
+ * Switch to the configuration of the list with the nearest picture size and the highest frame rate below the current one.
+ * The picture size is not changed: it is decided by the whole graph.
+ */
+static bool_t enc_lower_frame_rate(MSFilter *f) {
+	EncState *s = (EncState *)f->data;
+	const MSVideoConfiguration *vconf_it = s->vconf_list;
+	const MSVideoConfiguration *best = NULL;
+	int cpu_count = ms_factory_get_cpu_count(f->factory);
+	int ref_pixels = s->vconf.vsize.width * s->vconf.vsize.height;
+	int min_score = INT32_MAX;
+
+	while (TRUE) {
+		int score = abs(vconf_it->vsize.width * vconf_it->vsize.height - ref_pixels);
+		if (cpu_count >= vconf_it->mincpu && vconf_it->fps < s->vconf.fps) {
+			if (score < min_score || (score == min_score && vconf_it->fps > best->fps)) {
+				best = vconf_it;
+				min_score = score;
+			}
+		}
+		if (vconf_it->required_bitrate == 0) break;
+		vconf_it++;
+	}
+	if (best == NULL) return FALSE;
+	ms_message("VP8 encoder [%p]: lowering frame rate from %f to %f because of the load", f, s->vconf.fps, best->fps);
+	if (!s->load_control.fps_lowered) {
+		s->load_control.configured_vconf = s->vconf;
+		s->load_control.fps_lowered = TRUE;
+	}
+	s->vconf.fps = best->fps;
+	s->vconf.bitrate_limit = best->bitrate_limit;
+	if (s->vconf.required_bitrate > s->vconf.bitrate_limit) s->vconf.required_bitrate = s->vconf.bitrate_limit;
+	enc_update_frame_rate(f);
+	return TRUE;
+}
+
+/* Go back to the frame rate and the bitrate of the configuration that was lowered. */
+static void enc_restore_frame_rate(MSFilter *f) {
+	EncState *s = (EncState *)f->data;
+	EncLoadControl *lc = &s->load_control;
+
+	ms_message("VP8 encoder [%p]: restoring frame rate from %f to %f", f, s->vconf.fps, lc->configured_vconf.fps);
+	s->vconf.fps = lc->configured_vconf.fps;
+	s->vconf.bitrate_limit = lc->configured_vconf.bitrate_limit;
+	s->vconf.required_bitrate = lc->configured_vconf.required_bitrate;
+	lc->fps_lowered = FALSE;
+	lc->overloaded = FALSE;
+	enc_update_frame_rate(f);
+}
+
+/* Whether the controller has changed a setting that it can restore. */
+static bool_t enc_load_control_active(MSFilter *f) {
+	EncState *s = (EncState *)f->data;
+	EncLoadControl *lc = &s->load_control;
+	return lc->fps_lowered || lc->cpuused_increase > 0 || (lc->threads != 0 && lc->threads != enc_get_default_threads(f));
+}
+
+/* Called with the filter lock held after each encoded frame, with the time spent encoding it. */
+static void enc_adapt_to_load(MSFilter *f, uint64_t frame_time, uint64_t encode_time) {
+	EncState *s = (EncState *)f->data;
+	EncLoadControl *lc = &s->load_control;
+	float encoding_ratio;
+	float load;
+	int cpu_count;
+
+	if (lc->nframes == 0) lc->period_start = frame_time;
+	lc->encode_time += encode_time;
+	lc->nframes++;
+	if (frame_time - lc->period_start < LOAD_CONTROL_PERIOD) return;
+
+	encoding_ratio = ((float)lc->encode_time / (float)lc->nframes) * s->vconf.fps / 1000000.f;
+	load = ms_ticker_get_average_load(f->ticker);
+	lc->encode_time = 0;
+	lc->nframes = 0;
+	cpu_count = ms_factory_get_cpu_count(f->factory);
+
+	if (load > HIGH_TICKER_LOAD || encoding_ratio > HIGH_ENCODING_RATIO) {
+		lc->underload_count = 0;
+		if (load > HIGH_TICKER_LOAD && encoding_ratio < LOW_ENCODING_RATIO && s->cfg[0].g_threads > 1) {
+			/* The host is busy but the encoder is not the problem: its threads only add contention. */
+			ms_message("VP8 encoder [%p]: load=%f%%, reducing threads to %i", f, load, s->cfg[0].g_threads - 1);
+			enc_set_threads(s, s->cfg[0].g_threads - 1);
+		} else if (s->cpuused < MAX_CPUUSED) {
+			int cpuused = MIN(s->cpuused + 2, MAX_CPUUSED);
+			lc->cpuused_increase += cpuused - s->cpuused;
+			s->cpuused = cpuused;
+			ms_message("VP8 encoder [%p]: load=%f%% encoding ratio=%f, setting cpu-used to %i", f, load, encoding_ratio, s->cpuused);
+			enc_set_cpuused(s, s->cpuused);
+		} else if (load <= HIGH_TICKER_LOAD && (int)s->cfg[0].g_threads < cpu_count) {
+			ms_message("VP8 encoder [%p]: encoding ratio=%f, increasing threads to %i", f, encoding_ratio, s->cfg[0].g_threads + 1);
+			enc_set_threads(s, s->cfg[0].g_threads + 1);
+		} else if (!enc_lower_frame_rate(f) && !lc->overloaded) {
+			ms_warning("VP8 encoder [%p]: load=%f%% encoding ratio=%f, no lighter configuration available", f, load, encoding_ratio);
+			lc->overloaded = TRUE;
+		}
+	} else if (load < LOW_TICKER_LOAD && encoding_ratio < LOW_ENCODING_RATIO && enc_load_control_active(f)) {
+		/* The measures are undone one at a time, the last one first, after several quiet periods. */
+		if (++lc->underload_count >= UNDERLOAD_PERIODS) {
+			int default_threads = enc_get_default_threads(f);
+			lc->underload_count = 0;
+			if (lc->fps_lowered) {
+				/* The encoding time relative to the frame interval grows with the frame rate. */
+				if (encoding_ratio * lc->configured_vconf.fps / s->vconf.fps < HIGH_ENCODING_RATIO) enc_restore_frame_rate(f);
+			} else if (lc->threads != 0 && lc->threads != default_threads) {
+				int threads = lc->threads + ((lc->threads < default_threads) ? 1 : -1);
+				ms_message("VP8 encoder [%p]: load=%f%% encoding ratio=%f, setting threads back to %i", f, load, encoding_ratio, threads);
+				enc_set_threads(s, threads);
+			} else {
+				lc->cpuused_increase--;
+				s->cpuused--;
+				ms_message("VP8 encoder [%p]: load=%f%% encoding ratio=%f, setting cpu-used back to %i", f, load, encoding_ratio, s->cpuused);
+				enc_set_cpuused(s, s->cpuused);
+			}
+		}
+	} else {
+		lc->underload_count = 0;
+	}
+}
+
+/* Scale the picture down for each simulcast layer, from the previous layer, and wrap them into libvpx images. */
+static void enc_wrap_layers(EncState *s, MSPicture *yuv, vpx_image_t *img) {
+	int i;
+	vpx_img_wrap(&img[0], VPX_IMG_FMT_I420, s->vconf.vsize.width, s->vconf.vsize.height, 1, yuv->planes[0]);
+	for (i = 1; i < s->nlayers; i++) {
+		MSPicture *src = (i == 1) ? yuv : &s->layer_yuv[i - 1];
+		ms_scaler_process(s->layer_scalers[i], src->planes, src->strides, s->layer_yuv[i].planes, s->layer_yuv[i].strides);
+		vpx_img_wrap(&img[i], VPX_IMG_FMT_I420, s->cfg[i].g_w, s->cfg[i].g_h, 1, s->layer_yuv[i].planes[0]);
+	}
+}
+
+static vpx_codec_err_t enc_encode_layers(EncState *s, vpx_image_t *img, unsigned int flags) {
+	unsigned long deadline = 1000000L/(2*(int)s->vconf.fps); /*encoder has half a framerate interval to encode*/
+	vpx_codec_err_t err = VPX_CODEC_OK;
+	int i;
+
+	if (s->nlayers == 1 || s->multi_res) {
+		/* The multi-resolution encoder takes the images of all the layers at once. */
+		return vpx_codec_encode(&s->codec[0], img, s->pts, 1, flags, deadline);
+	}
+	for (i = 0; i < s->nlayers && err == VPX_CODEC_OK; i++) {
+		if (s->cfg[i].rc_target_bitrate > 0) err = vpx_codec_encode(&s->codec[i], &img[i], s->pts, 1, flags, deadline);
+	}
+	return err;
+}
+
+/* Pack the encoded frame of a layer into RTP payloads. */
+static void enc_pack_layer(MSFilter *f, int layer, bool_t is_ref_frame, uint32_t timestamp, MSQueue *output) {
+	EncState *s = (EncState *)f->data;
+	vpx_codec_iter_t iter = NULL;
+	const vpx_codec_cx_pkt_t *pkt;
+	bctbx_list_t *list = NULL;
+
+	while( (pkt = vpx_codec_get_cx_data(&s->codec[layer], &iter)) ) {
+		if ((pkt->kind == VPX_CODEC_CX_FRAME_PKT) && (pkt->data.frame.sz > 0)) {
+			Vp8RtpFmtPacket *packet = ms_new0(Vp8RtpFmtPacket, 1);
+
+			packet->m = allocb(pkt->data.frame.sz, 0);
+			memcpy(packet->m->b_wptr, pkt->data.frame.buf, pkt->data.frame.sz);
+			packet->m->b_wptr += pkt->data.frame.sz;
+			mblk_set_timestamp_info(packet->m, timestamp);
+			packet->pd = ms_new0(Vp8RtpFmtPayloadDescriptor, 1);
+			packet->pd->start_of_partition = TRUE;
+			/* The reference frames are not tracked in simulcast mode, every frame is a reference. */
+			packet->pd->non_reference_frame = s->avpf_enabled && s->nlayers == 1 && !is_ref_frame;
+			if (s->avpf_enabled == TRUE) {
+				packet->pd->extended_control_bits_present = TRUE;
+				packet->pd->pictureid_present = TRUE;
+				packet->pd->pictureid = s->picture_id;
+			} else {
+				packet->pd->extended_control_bits_present = FALSE;
+				packet->pd->pictureid_present = FALSE;
+			}
+			if (s->flags & VPX_CODEC_USE_OUTPUT_PARTITION) {
+				packet->pd->pid = (uint8_t)pkt->data.frame.partition_id;
+				if (!(pkt->data.frame.flags & VPX_FRAME_IS_FRAGMENT)) {
+					mblk_set_marker_info(packet->m, TRUE);
+				}
+			} else {
+				packet->pd->pid = 0;
+				mblk_set_marker_info(packet->m, TRUE);
+			}
+			list = bctbx_list_append(list, packet);
+		}
+	}
+	vp8rtpfmt_packer_process(&s->packer[layer], list, output, f->factory);
+}
+
+/*
+ * Encode a picture and put the resulting packets in output, with the filter lock held.
+ * It runs in the ticker thread, or in the encoder thread when asynchronous encoding is enabled,
+ * so frame_time must be used instead of f->ticker->time.
+ */
+static void enc_encode_frame(MSFilter *f, mblk_t *im, uint64_t frame_time, MSQueue *output) {
+	uint32_t timestamp = (uint32_t)(frame_time*90);
 	EncState *s = (EncState *)f->data;
 	unsigned int flags = 0;
 	vpx_codec_err_t err;
 	MSPicture yuv;
+	vpx_image_t img[MAX_SIMULCAST_LAYERS];
+	MSTimeSpec start, stop;
 	bool_t is_ref_frame=FALSE;
-
-	ms_filter_lock(f);
+	int i;
 
 #ifdef AVPF_DEBUG
 	ms_message("VP8 enc_process:");
 #endif
 
-	if (!s->ready) {
-		ms_queue_flush(f->inputs[0]);
-		ms_filter_unlock(f);
+	if (!s->ready) return;
+	if (s->load_control.fps_lowered && s->load_control.last_frame_time != 0
+		&& (frame_time - s->load_control.last_frame_time) < (uint64_t)(900.f / s->vconf.fps)) {
+		/* Pictures arrive faster than the frame rate of the configuration chosen by the load controller. */
 		return;
 	}
+	s->load_control.last_frame_time = frame_time;
 
-	if ((im = ms_queue_peek_last(f->inputs[0])) != NULL) {
-		vpx_image_t img;
+	flags = 0;
+	ms_get_cur_time(&start);
+	ms_yuv_buf_init_from_mblk(&yuv, im);
+	enc_wrap_layers(s, &yuv, img);
 
-		flags = 0;
-		ms_yuv_buf_init_from_mblk(&yuv, im);
-		vpx_img_wrap(&img, VPX_IMG_FMT_I420, s->vconf.vsize.width, s->vconf.vsize.height, 1, yuv.planes[0]);
-
-		if ((s->avpf_enabled != TRUE) && ms_video_starter_need_i_frame(&s->starter, f->ticker->time)) {
-			s->force_keyframe = TRUE;
-		}
-		if (s->force_keyframe == TRUE) {
-			ms_message("Forcing vp8 key frame for filter [%p]", f);
-			flags = VPX_EFLAG_FORCE_KF;
-		} else if (s->avpf_enabled == TRUE) {
-			if (s->frame_count == 0) s->force_keyframe = TRUE;
-			enc_fill_encoder_flags(s, &flags);
-		}
+	if ((s->avpf_enabled != TRUE) && ms_video_starter_need_i_frame(&s->starter, frame_time)) {
+		s->force_keyframe = TRUE;
+	}
+	if (s->force_keyframe == TRUE) {
+		ms_message("Forcing vp8 key frame for filter [%p]", f);
+		flags = VPX_EFLAG_FORCE_KF;
+	} else if (s->avpf_enabled == TRUE && s->nlayers == 1) {
+		if (s->frame_count == 0) s->force_keyframe = TRUE;
+		enc_fill_encoder_flags(s, &flags);
+	}
 
 #ifdef AVPF_DEBUG
-		ms_message("VP8 encoder frames state:");
-		ms_message("\tgolden: count=%" PRIi64 ", picture_id=0x%04x, ack=%s",
-			s->frames_state.golden.count, s->frames_state.golden.picture_id, (s->frames_state.golden.acknowledged == TRUE) ? "Y" : "N");
-		ms_message("\taltref: count=%" PRIi64 ", picture_id=0x%04x, ack=%s",
-			s->frames_state.altref.count, s->frames_state.altref.picture_id, (s->frames_state.altref.acknowledged == TRUE) ? "Y" : "N");
+	ms_message("VP8 encoder frames state:");
+	ms_message("\tgolden: count=%" PRIi64 ", picture_id=0x%04x, ack=%s",
+		s->frames_state.golden.count, s->frames_state.golden.picture_id, (s->frames_state.golden.acknowledged == TRUE) ? "Y" : "N");
+	ms_message("\taltref: count=%" PRIi64 ", picture_id=0x%04x, ack=%s",
+		s->frames_state.altref.count, s->frames_state.altref.picture_id, (s->frames_state.altref.acknowledged == TRUE) ? "Y" : "N");
 #endif
-		err = vpx_codec_encode(&s->codec, &img, s->frame_count, 1, flags, 1000000LL/(2*(int)s->vconf.fps)); /*encoder has half a framerate interval to encode*/
-		if (err) {
-			ms_error("vpx_codec_encode failed : %d %s (%s)\n", err, vpx_codec_err_to_string(err), vpx_codec_error_detail(&s->codec));
-		} else {
-			vpx_codec_iter_t iter = NULL;
-			const vpx_codec_cx_pkt_t *pkt;
-			bctbx_list_t *list = NULL;
-
-			/* Update the frames state. */
-			is_ref_frame=FALSE;
-			if (flags & VPX_EFLAG_FORCE_KF) {
-				enc_mark_reference_frame_as_sent(s, VP8_GOLD_FRAME);
-				enc_mark_reference_frame_as_sent(s, VP8_ALTR_FRAME);
-				s->frames_state.golden.is_independant=TRUE;
-				s->frames_state.altref.is_independant=TRUE;
-				s->frames_state.last_independent_frame=s->frame_count;
-				s->force_keyframe = FALSE;
-				is_ref_frame=TRUE;
-			}else if (flags & VP8_EFLAG_FORCE_GF) {
-				enc_mark_reference_frame_as_sent(s, VP8_GOLD_FRAME);
-				is_ref_frame=TRUE;
-			}else if (flags & VP8_EFLAG_FORCE_ARF) {
-				enc_mark_reference_frame_as_sent(s, VP8_ALTR_FRAME);
-				is_ref_frame=TRUE;
-			}else if (flags & VP8_EFLAG_NO_REF_LAST) {
-				enc_mark_reference_frame_as_sent(s, VP8_LAST_FRAME);
-				is_ref_frame=is_reconstruction_frame_sane(s,flags);
-			}
-			if (is_frame_independent(flags)){
-				s->frames_state.last_independent_frame=s->frame_count;
-			}
-
-			/* Pack the encoded frame. */
-			while( (pkt = vpx_codec_get_cx_data(&s->codec, &iter)) ) {
-				if ((pkt->kind == VPX_CODEC_CX_FRAME_PKT) && (pkt->data.frame.sz > 0)) {
-					Vp8RtpFmtPacket *packet = ms_new0(Vp8RtpFmtPacket, 1);
-
-					packet->m = allocb(pkt->data.frame.sz, 0);
-					memcpy(packet->m->b_wptr, pkt->data.frame.buf, pkt->data.frame.sz);
-					packet->m->b_wptr += pkt->data.frame.sz;
-					mblk_set_timestamp_info(packet->m, timestamp);
-					packet->pd = ms_new0(Vp8RtpFmtPayloadDescriptor, 1);
-					packet->pd->start_of_partition = TRUE;
-					packet->pd->non_reference_frame = s->avpf_enabled && !is_ref_frame;
-					if (s->avpf_enabled == TRUE) {
-						packet->pd->extended_control_bits_present = TRUE;
-						packet->pd->pictureid_present = TRUE;
-						packet->pd->pictureid = s->picture_id;
-					} else {
-						packet->pd->extended_control_bits_present = FALSE;
-						packet->pd->pictureid_present = FALSE;
-					}
-					if (s->flags & VPX_CODEC_USE_OUTPUT_PARTITION) {
-						packet->pd->pid = (uint8_t)pkt->data.frame.partition_id;
-						if (!(pkt->data.frame.flags & VPX_FRAME_IS_FRAGMENT)) {
-							mblk_set_marker_info(packet->m, TRUE);
-						}
-					} else {
-						packet->pd->pid = 0;
-						mblk_set_marker_info(packet->m, TRUE);
-					}
-					list = bctbx_list_append(list, packet);
-				}
-			}
+	err = enc_encode_layers(s, img, flags);
+	s->pts++;
+	ms_get_cur_time(&stop);
+	if (err) {
+		ms_error("vpx_codec_encode failed : %d %s (%s)\n", err, vpx_codec_err_to_string(err), vpx_codec_error_detail(&s->codec[0]));
+	} else {
+		/* Update the frames state. */
+		is_ref_frame=FALSE;
+		if (flags & VPX_EFLAG_FORCE_KF) {
+			enc_mark_reference_frame_as_sent(s, VP8_GOLD_FRAME);
+			enc_mark_reference_frame_as_sent(s, VP8_ALTR_FRAME);
+			s->frames_state.golden.is_independant=TRUE;
+			s->frames_state.altref.is_independant=TRUE;
+			s->frames_state.last_independent_frame=s->frame_count;
+			s->force_keyframe = FALSE;
+			is_ref_frame=TRUE;
+		}else if (flags & VP8_EFLAG_FORCE_GF) {
+			enc_mark_reference_frame_as_sent(s, VP8_GOLD_FRAME);
+			is_ref_frame=TRUE;
+		}else if (flags & VP8_EFLAG_FORCE_ARF) {
+			enc_mark_reference_frame_as_sent(s, VP8_ALTR_FRAME);
+			is_ref_frame=TRUE;
+		}else if (flags & VP8_EFLAG_NO_REF_LAST) {
+			enc_mark_reference_frame_as_sent(s, VP8_LAST_FRAME);
+			is_ref_frame=is_reconstruction_frame_sane(s,flags);
+		}
+		if (is_frame_independent(flags)){
+			s->frames_state.last_independent_frame=s->frame_count;
+		}
 
 #ifdef AVPF_DEBUG
-			ms_message("VP8 encoder picture_id=%i ***| %s | %s | %s | %s", (int)s->picture_id,
-				(flags & VPX_EFLAG_FORCE_KF) ? "KF " : (flags & VP8_EFLAG_FORCE_GF) ? "GF " :  (flags & VP8_EFLAG_FORCE_ARF) ? "ARF" : "   ",
-				(flags & VP8_EFLAG_NO_REF_GF) ? "NOREFGF" : "       ",
-				(flags & VP8_EFLAG_NO_REF_ARF) ? "NOREFARF" : "        ",
-				(flags & VP8_EFLAG_NO_REF_LAST) ? "NOREFLAST" : "         ");
+		ms_message("VP8 encoder picture_id=%i ***| %s | %s | %s | %s", (int)s->picture_id,
+			(flags & VPX_EFLAG_FORCE_KF) ? "KF " : (flags & VP8_EFLAG_FORCE_GF) ? "GF " :  (flags & VP8_EFLAG_FORCE_ARF) ? "ARF" : "   ",
+			(flags & VP8_EFLAG_NO_REF_GF) ? "NOREFGF" : "       ",
+			(flags & VP8_EFLAG_NO_REF_ARF) ? "NOREFARF" : "        ",
+			(flags & VP8_EFLAG_NO_REF_LAST) ? "NOREFLAST" : "         ");
 #endif
 
-			vp8rtpfmt_packer_process(&s->packer, list, f->outputs[0], f->factory);
+		/* Pack the encoded frames. In simulcast mode, the encoding is synchronous so the outputs of the layers can be used directly. */
+		for (i = 0; i < s->nlayers; i++) {
+			enc_pack_layer(f, i, is_ref_frame, timestamp, (i == 0) ? output : f->outputs[i]);
+		}
 
-			/* Handle video starter if AVPF is not enabled. */
-			s->frame_count++;
-			if ((s->avpf_enabled != TRUE) && (s->frame_count == 1)) {
-				ms_video_starter_first_frame(&s->starter, f->ticker->time);
-			}
+		/* Handle video starter if AVPF is not enabled. */
+		s->frame_count++;
+		if ((s->avpf_enabled != TRUE) && (s->frame_count == 1)) {
+			ms_video_starter_first_frame(&s->starter, frame_time);
+		}
 
-			/* Increment the pictureID. */
-			s->picture_id++;
+		/* Increment the pictureID. */
+		s->picture_id++;
 #ifdef PICTURE_ID_ON_16_BITS
-			if (s->picture_id == 0)
-				s->picture_id = 0x8000;
+		if (s->picture_id == 0)
+			s->picture_id = 0x8000;
 #else
-			if (s->picture_id == 0x0080)
-				s->picture_id = 0;
+		if (s->picture_id == 0x0080)
+			s->picture_id = 0;
 #endif
+		if (s->load_control.enabled) {
+			enc_adapt_to_load(f, frame_time, (stop.tv_sec - start.tv_sec) * 1000000LL + (stop.tv_nsec - start.tv_nsec) / 1000);
+		}
+	}
+}
+
+static void enc_process(MSFilter *f) {
+	EncState *s = (EncState *)f->data;
+	mblk_t *im;
+
+	if (s->async_enabled && s->simulcast_layers > 1) {
+		ms_warning("VP8 encoder [%p]: asynchronous encoding is not available in simulcast mode", f);
+		s->async_enabled = FALSE;
+	}
+	if (s->async_enabled && s->encoder_thread == NULL) {
+		s->encoder_thread = ms_encoder_thread_new(f, enc_encode_frame, MAX_PENDING_FRAMES);
+		if (s->encoder_thread == NULL) s->async_enabled = FALSE;
+	}
+	if (s->encoder_thread != NULL) {
+		/* As in synchronous mode, only the most recent picture is encoded. */
+		if ((im = ms_queue_peek_last(f->inputs[0])) != NULL) {
+			ms_queue_remove(f->inputs[0], im);
+			ms_encoder_thread_push(s->encoder_thread, im, f->ticker->time);
 		}
+		ms_queue_flush(f->inputs[0]);
+		ms_encoder_thread_collect(s->encoder_thread, f->outputs[0]);
+		return;
+	}
+
+	ms_filter_lock(f);
+	if ((im = ms_queue_peek_last(f->inputs[0])) != NULL) {
+		enc_encode_frame(f, im, f->ticker->time, f->outputs[0]);
 	}
 	ms_filter_unlock(f);
 	ms_queue_flush(f->inputs[0]);
@@ -569,19 +972,48 @@ static void enc_process(MSFilter *f) {
 
 static void enc_postprocess(MSFilter *f) {
 	EncState *s = (EncState *)f->data;
-	if (s->ready) vpx_codec_destroy(&s->codec);
-	vp8rtpfmt_packer_uninit(&s->packer);
+	int i;
+	for (i = 0; i < s->nlayers; i++) {
+		if (s->ready) vpx_codec_destroy(&s->codec[i]);
+		vp8rtpfmt_packer_uninit(&s->packer[i]);
+		if (s->layer_pics[i] != NULL) {
+			freemsg(s->layer_pics[i]);
+			s->layer_pics[i] = NULL;
+		}
+		if (s->layer_scalers[i] != NULL) {
+			ms_scaler_context_free(s->layer_scalers[i]);
+			s->layer_scalers[i] = NULL;
+		}
+	}
+	s->nlayers = 0;
 	s->ready = FALSE;
 }
 
+static void enc_detach(MSFilter *f) {
+	EncState *s = (EncState *)f->data;
+	/* The encoder thread must be stopped without the filter lock, that it takes to encode. */
+	if (s->encoder_thread != NULL) {
+		ms_encoder_thread_destroy(s->encoder_thread);
+		s->encoder_thread = NULL;
+	}
+	enc_postprocess(f);
+}
+
 static int enc_set_configuration(MSFilter *f, void *data) {
 	EncState *s = (EncState *)f->data;
 	const MSVideoConfiguration *vconf = (const MSVideoConfiguration *)data;
-	if (vconf != &s->vconf) memcpy(&s->vconf, vconf, sizeof(MSVideoConfiguration));
+	if (vconf != &s->vconf) {
+		memcpy(&s->vconf, vconf, sizeof(MSVideoConfiguration));
+		/* The new configuration replaces the one whose frame rate was lowered by the load controller. */
+		s->load_control.fps_lowered = FALSE;
+	} else if (s->load_control.fps_lowered) {
+		/* Only the bitrate changes, it will be restored with the frame rate. */
+		s->load_control.configured_vconf.required_bitrate = MIN(s->vconf.required_bitrate, s->load_control.configured_vconf.bitrate_limit);
+	}
 
 	if (s->vconf.required_bitrate > s->vconf.bitrate_limit)
 		s->vconf.required_bitrate = s->vconf.bitrate_limit;
-	s->cfg.rc_target_bitrate = (unsigned int)(((float)s->vconf.required_bitrate) * 0.92f / 1024.0f); //0.92=take into account IP/UDP/RTP overhead, in average.
+	s->cfg[0].rc_target_bitrate = (unsigned int)(((float)s->vconf.required_bitrate) * 0.92f / 1024.0f); //0.92=take into account IP/UDP/RTP overhead, in average.
 	if (s->ready) {
 		ms_filter_lock(f);
 		enc_postprocess(f);
@@ -600,6 +1032,7 @@ static int enc_set_vsize(MSFilter *f, void *data) {
 	MSVideoSize *vs = (MSVideoSize *)data;
 	EncState *s = (EncState *)f->data;
 	best_vconf = ms_video_find_best_configuration_for_size(s->vconf_list, *vs, ms_factory_get_cpu_count(f->factory));
+	s->load_control.fps_lowered = FALSE;
 	s->vconf.vsize = *vs;
 	s->vconf.fps = best_vconf.fps;
 	s->vconf.bitrate_limit = best_vconf.bitrate_limit;
@@ -617,6 +1050,7 @@ static int enc_get_vsize(MSFilter *f, void *data) {
 static int enc_set_fps(MSFilter *f, void *data) {
 	EncState *s = (EncState *)f->data;
 	float *fps = (float *)data;
+	s->load_control.fps_lowered = FALSE;
 	s->vconf.fps = *fps;
 	enc_set_configuration(f, &s->vconf);
 	return 0;
@@ -671,7 +1105,7 @@ static int enc_notify_pli(MSFilter *f, void *data) {
 	ms_message("VP8: PLI requested");
 	if (should_generate_key_frame(s,MIN_KEY_FRAME_DIST)){
 		ms_message("VP8: PLI accepted");
-		if (s->avpf_enabled == TRUE) {
+		if (s->avpf_enabled == TRUE && s->nlayers == 1) {
 			s->invalid_frame_reported = TRUE;
 		} else {
 			s->force_keyframe = TRUE;
@@ -775,6 +1209,54 @@ static int enc_enable_avpf(MSFilter *f, void *data) {
 	return 0;
 }
 
+static int enc_enable_async(MSFilter *f, void *data) {
+	EncState *s = (EncState *)f->data;
+	s->async_enabled = *((bool_t *)data) ? TRUE : FALSE;
+	return 0;
+}
+
+static int enc_enable_load_adaptation(MSFilter *f, void *data) {
+	EncState *s = (EncState *)f->data;
+	ms_filter_lock(f);
+	s->load_control.enabled = *((bool_t *)data) ? TRUE : FALSE;
+	ms_filter_unlock(f);
+	return 0;
+}
+
+static int enc_set_simulcast_layers(MSFilter *f, void *data) {
+	EncState *s = (EncState *)f->data;
+	int layers = *(int *)data;
+	if (layers < 1 || layers > MAX_SIMULCAST_LAYERS) {
+		ms_error("VP8 encoder [%p]: invalid number of simulcast layers %i", f, layers);
+		return -1;
+	}
+	s->simulcast_layers = layers;
+	return 0;
+}
+
+static int enc_get_layers_threads(MSFilter *f, void *data) {
+	EncState *s = (EncState *)f->data;
+	MSVideoEncoderLayersThreads *lt = (MSVideoEncoderLayersThreads *)data;
+	int i;
+	memset(lt, 0, sizeof(*lt));
+	lt->nlayers = s->nlayers;
+	for (i = 0; i < s->nlayers; i++) {
+		lt->threads[i] = (int)s->cfg[i].g_threads;
+	}
+	return 0;
+}
+
+static int enc_get_async_stats(MSFilter *f, void *data) {
+	EncState *s = (EncState *)f->data;
+	MSVideoEncoderAsyncStats *stats = (MSVideoEncoderAsyncStats *)data;
+	if (s->encoder_thread != NULL) {
+		ms_encoder_thread_get_stats(s->encoder_thread, stats);
+	} else {
+		memset(stats, 0, sizeof(MSVideoEncoderAsyncStats));
+	}
+	return 0;
+}
+
 static MSFilterMethod enc_methods[] = {
 	{ MS_FILTER_SET_VIDEO_SIZE,                enc_set_vsize              },
 	{ MS_FILTER_SET_FPS,                       enc_set_fps                },
@@ -792,6 +1274,11 @@ static MSFilterMethod enc_methods[] = {
 	{ MS_VIDEO_ENCODER_SET_CONFIGURATION_LIST, enc_set_configuration_list },
 	{ MS_VIDEO_ENCODER_SET_CONFIGURATION,      enc_set_configuration      },
 	{ MS_VIDEO_ENCODER_ENABLE_AVPF,            enc_enable_avpf            },
+	{ MS_VIDEO_ENCODER_ENABLE_ASYNC,           enc_enable_async           },
+	{ MS_VIDEO_ENCODER_GET_ASYNC_STATS,        enc_get_async_stats        },
+	{ MS_VIDEO_ENCODER_ENABLE_LOAD_ADAPTATION, enc_enable_load_adaptation },
+	{ MS_VIDEO_ENCODER_SET_SIMULCAST_LAYERS,   enc_set_simulcast_layers   },
+	{ MS_VIDEO_ENCODER_GET_LAYERS_THREADS,     enc_get_layers_threads     },
 	{ 0,                                       NULL                       }
 };
 
@@ -800,7 +1287,7 @@ static MSFilterMethod enc_methods[] = {
 #define MS_VP8_ENC_CATEGORY    MS_FILTER_ENCODER
 #define MS_VP8_ENC_ENC_FMT     "VP8"
 #define MS_VP8_ENC_NINPUTS     1 /*MS_YUV420P is assumed on this input */
-#define MS_VP8_ENC_NOUTPUTS    1
+#define MS_VP8_ENC_NOUTPUTS    MAX_SIMULCAST_LAYERS /*one per simulcast layer*/
 #define MS_VP8_ENC_FLAGS       0
 
 #ifdef _MSC_VER
@@ -816,7 +1303,7 @@ MSFilterDesc ms_vp8_enc_desc = {
 	enc_init,
 	enc_preprocess,
 	enc_process,
-	enc_postprocess,
+	enc_detach,
 	enc_uninit,
 	enc_methods,
 	MS_VP8_ENC_FLAGS
@@ -835,7 +1322,7 @@ MSFilterDesc ms_vp8_enc_desc = {
 	.init = enc_init,
 	.preprocess = enc_preprocess,
 	.process = enc_process,
-	.postprocess = enc_postprocess,
+	.postprocess = enc_detach,
 	.uninit = enc_uninit,
 	.methods = enc_methods,
 	.flags = MS_VP8_ENC_FLAGS
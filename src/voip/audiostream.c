@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/msitc.h"
 #include "mediastreamer2/msvaddtx.h"
 #include "mediastreamer2/msgenericplc.h"
+#include "mediastreamer2/msred.h"
 #include "mediastreamer2/mseventqueue.h"
 #include "private.h"
 
@@ -83,6 +84,8 @@ static void audio_stream_free(AudioStream *stream) {
 	if (stream->av_recorder.resampler) ms_filter_destroy(stream->av_recorder.resampler);
 	if (stream->av_recorder.video_input) ms_filter_destroy(stream->av_recorder.video_input);
 	if (stream->vaddtx) ms_filter_destroy(stream->vaddtx);
+	if (stream->red_enc) ms_filter_destroy(stream->red_enc);
+	if (stream->red_dec) ms_filter_destroy(stream->red_dec);
 	if (stream->outbound_mixer) ms_filter_destroy(stream->outbound_mixer);
 	if (stream->recorder_file) ms_free(stream->recorder_file);
 	if (stream->rtp_io_session) rtp_session_destroy(stream->rtp_io_session);
@@ -140,10 +143,11 @@ static bool_t audio_stream_payload_type_changed(RtpSession *session, void *data)
 		//dec = ms_filter_create_decoder(pt->mime_type);
 		dec = ms_factory_create_decoder(stream->ms.factory, pt->mime_type);
 		if (dec != NULL) {
+			MSFilter *prevFilter = stream->red_dec ? stream->red_dec : stream->ms.rtprecv;
 			MSFilter *nextFilter = stream->ms.decoder->outputs[0]->next.filter;
 
 			ms_message("Replacing decoder on the fly");
-			ms_filter_unlink(stream->ms.rtprecv, 0, stream->ms.decoder, 0);
+			ms_filter_unlink(prevFilter, 0, stream->ms.decoder, 0);
 			ms_filter_unlink(stream->ms.decoder, 0, nextFilter, 0);
 			ms_filter_postprocess(stream->ms.decoder);
 			ms_filter_destroy(stream->ms.decoder);
@@ -152,7 +156,7 @@ static bool_t audio_stream_payload_type_changed(RtpSession *session, void *data)
 			if (stream->write_resampler){
 				audio_stream_configure_resampler(stream, stream->write_resampler,stream->ms.decoder,stream->soundwrite);
 			}
-			ms_filter_link(stream->ms.rtprecv, 0, stream->ms.decoder, 0);
+			ms_filter_link(prevFilter, 0, stream->ms.decoder, 0);
 			ms_filter_link(stream->ms.decoder, 0, nextFilter, 0);
 			ms_filter_preprocess(stream->ms.decoder, stream->ms.sessions.ticker);
 			stream->ms.current_pt=pt;
@@ -741,7 +745,13 @@ static void configure_decoder(AudioStream *stream, PayloadType *pt, int sample_r
 	ms_filter_call_method(stream->ms.decoder,MS_FILTER_SET_SAMPLE_RATE,&sample_rate);
 	ms_filter_call_method(stream->ms.decoder,MS_FILTER_SET_NCHANNELS,&nchannels);
 	if (pt->recv_fmtp!=NULL) ms_filter_call_method(stream->ms.decoder,MS_FILTER_ADD_FMTP,(void*)pt->recv_fmtp);
-	if (ms_filter_has_method(stream->ms.decoder, MS_AUDIO_DECODER_SET_RTP_PAYLOAD_PICKER) || ms_filter_has_method(stream->ms.decoder, MS_FILTER_SET_RTP_PAYLOAD_PICKER)) {
+	if (stream->red_dec) {
+		/*the jitter buffer holds RED payloads, that only the RED decoder understands*/
+		MSRtpPayloadPickerContext picker_context;
+		picker_context.filter_graph_manager=stream;
+		picker_context.picker=&audio_stream_payload_picker;
+		ms_filter_call_method(stream->red_dec,MS_RED_DEC_SET_RTP_PAYLOAD_PICKER, &picker_context);
+	} else if (ms_filter_has_method(stream->ms.decoder, MS_AUDIO_DECODER_SET_RTP_PAYLOAD_PICKER) || ms_filter_has_method(stream->ms.decoder, MS_FILTER_SET_RTP_PAYLOAD_PICKER)) {
 		MSRtpPayloadPickerContext picker_context;
 		ms_message("Decoder has FEC capabilities");
 		picker_context.filter_graph_manager=stream;
@@ -750,6 +760,22 @@ static void configure_decoder(AudioStream *stream, PayloadType *pt, int sample_r
 	}
 }
 
+/*
+ * The fmtp of the RFC 2198 "red" payload type lists the payload types of the encodings of each packet, the primary one
+ * last, for example "111/111" for one redundant copy of an opus frame. Returns the primary payload type and the number
+ * of redundant encodings, or -1.
+ */
+static int get_red_primary_payload_type(const PayloadType *pt, int *distance){
+	const char *fmtp=pt->send_fmtp ? pt->send_fmtp : pt->recv_fmtp;
+	const char *p;
+	int primary;
+
+	if (fmtp==NULL || sscanf(fmtp,"%d",&primary)!=1 || primary<0 || primary>127) return -1;
+	*distance=0;
+	for(p=strchr(fmtp,'/');p!=NULL;p=strchr(p+1,'/')) (*distance)++;
+	return primary;
+}
+
 static int get_usable_telephone_event(RtpProfile *profile, int clock_rate){
 	int i;
 	int fallback_pt=-1;
@@ -782,6 +808,8 @@ int audio_stream_start_from_io(AudioStream *stream, RtpProfile *profile, const c
 	bool_t has_builtin_ec=FALSE;
 	bool_t resampler_missing = FALSE;
 	bool_t skip_encoder_and_decoder = FALSE;
+	int red_primary_pt = -1;
+	int red_distance = 0;
 
 	if (!ms_media_stream_io_is_consistent(io)) return -1;
 
@@ -850,6 +878,21 @@ int audio_stream_start_from_io(AudioStream *stream, RtpProfile *profile, const c
 		ms_error("audiostream.c: undefined payload type.");
 		return -1;
 	}
+	if (strcasecmp(pt->mime_type,"red")==0){
+		/*redundant audio: the session keeps the red payload type, the codec is the one of the primary encoding*/
+		red_primary_pt=get_red_primary_payload_type(pt,&red_distance);
+		pt=red_primary_pt>=0 ? rtp_profile_get_payload(profile,red_primary_pt) : NULL;
+		if (pt==NULL || strcasecmp(pt->mime_type,"red")==0){
+			ms_error("audiostream.c: no usable primary encoding for red payload type %i.",payload);
+			return -1;
+		}
+		if (red_distance>MS_RED_ENC_MAX_DISTANCE){
+			/*the peer decodes the packets whatever the number of copies they carry*/
+			ms_warning("audiostream.c: %i redundant copies requested by red payload type %i, only %i are sent.",red_distance,payload,MS_RED_ENC_MAX_DISTANCE);
+			red_distance=MS_RED_ENC_MAX_DISTANCE;
+		}
+		ms_message("Audio stream [%p] sends %s with %i redundant copies (RFC 2198)",stream,pt->mime_type,red_distance);
+	}
 	nchannels=pt->channels;
 	stream->ms.current_pt=pt;
 	tev_pt = get_usable_telephone_event(profile, pt->clock_rate);
@@ -888,6 +931,16 @@ int audio_stream_start_from_io(AudioStream *stream, RtpProfile *profile, const c
 	if (!skip_encoder_and_decoder) {
 		stream->ms.encoder=ms_factory_create_encoder(stream->ms.factory, pt->mime_type);
 		stream->ms.decoder=ms_factory_create_decoder(stream->ms.factory, pt->mime_type);
+		if (red_primary_pt>=0){
+			stream->red_enc=ms_factory_create_filter(stream->ms.factory, MS_RED_ENC_ID);
+			stream->red_dec=ms_factory_create_filter(stream->ms.factory, MS_RED_DEC_ID);
+			ms_filter_call_method(stream->red_enc,MS_RED_ENC_SET_PRIMARY_PAYLOAD_TYPE,&red_primary_pt);
+			if (ms_filter_call_method(stream->red_enc,MS_RED_ENC_SET_DISTANCE,&red_distance)!=0){
+				ms_error("audiostream.c: the RED encoder refused %i redundant copies.",red_distance);
+			}
+			ms_filter_call_method(stream->red_dec,MS_RED_DEC_SET_PRIMARY_PAYLOAD_TYPE,&red_primary_pt);
+			ms_filter_call_method(stream->red_dec,MS_FILTER_SET_SAMPLE_RATE,&pt->clock_rate);
+		}
 	}
 
 	/* sample rate is already set for rtpsend and rtprcv, check if we have to adjust it to */
@@ -1123,6 +1176,9 @@ int audio_stream_start_from_io(AudioStream *stream, RtpProfile *profile, const c
 		case MSQosAnalyzerAlgorithmStateful:
 			stream->ms.rc=ms_bandwidth_bitrate_controller_new(stream->ms.sessions.rtp_session, skip_encoder_and_decoder ? stream->soundwrite : stream->ms.encoder, NULL, NULL);
 			break;
+		case MSQosAnalyzerAlgorithmDelayGradient:
+			stream->ms.rc=ms_delay_gradient_bitrate_controller_new(stream->ms.sessions.rtp_session, skip_encoder_and_decoder ? stream->soundwrite : stream->ms.encoder, NULL, NULL);
+			break;
 		}
 	}
 
@@ -1195,11 +1251,15 @@ int audio_stream_start_from_io(AudioStream *stream, RtpProfile *profile, const c
 		ms_connection_helper_link(&h,stream->vaddtx,0,0);
 	if (!skip_encoder_and_decoder)
 		ms_connection_helper_link(&h,stream->ms.encoder,0,0);
+	if (stream->red_enc)
+		ms_connection_helper_link(&h,stream->red_enc,0,0);
 	ms_connection_helper_link(&h,stream->ms.rtpsend,0,-1);
 
 	/*receiving graph*/
 	ms_connection_helper_start(&h);
 	ms_connection_helper_link(&h,stream->ms.rtprecv,-1,0);
+	if (stream->red_dec)
+		ms_connection_helper_link(&h,stream->red_dec,0,0);
 	if (!skip_encoder_and_decoder)
 		ms_connection_helper_link(&h,stream->ms.decoder,0,0);
 	if (stream->plc)
@@ -1705,11 +1765,15 @@ void audio_stream_stop(AudioStream * stream){
 				ms_connection_helper_unlink(&h,stream->vaddtx,0,0);
 			if (stream->ms.encoder)
 				ms_connection_helper_unlink(&h,stream->ms.encoder,0,0);
+			if (stream->red_enc)
+				ms_connection_helper_unlink(&h,stream->red_enc,0,0);
 			ms_connection_helper_unlink(&h,stream->ms.rtpsend,0,-1);
 
 			/*dismantle the receiving graph*/
 			ms_connection_helper_start(&h);
 			ms_connection_helper_unlink(&h,stream->ms.rtprecv,-1,0);
+			if (stream->red_dec)
+				ms_connection_helper_unlink(&h,stream->red_dec,0,0);
 			if (stream->ms.decoder)
 				ms_connection_helper_unlink(&h,stream->ms.decoder,0,0);
 			if (stream->plc!=NULL)
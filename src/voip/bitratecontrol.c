@@ -47,7 +47,7 @@ struct _MSBitrateController{
 	enum state_t state;
 	int stable_count;
 	int probing_up_count;
-
+	MSRtpFec *fec;
 };
 
 MSBitrateController *ms_bitrate_controller_new(MSQosAnalyzer *qosanalyzer, MSBitrateDriver *driver){
@@ -120,6 +120,7 @@ static void state_machine(MSBitrateController *obj){
 
 void ms_bitrate_controller_process_rtcp(MSBitrateController *obj, mblk_t *rtcp){
 	if (ms_qos_analyzer_process_rtcp(obj->analyzer,rtcp)){
+		if (obj->fec && obj->analyzer->lre) ms_rtp_fec_set_loss_rate(obj->fec,ortp_loss_rate_estimator_get_value(obj->analyzer->lre));
 		state_machine(obj);
 	}
 }
@@ -132,6 +133,10 @@ MSQosAnalyzer * ms_bitrate_controller_get_qos_analyzer(MSBitrateController *obj)
 	return obj->analyzer;
 }
 
+void ms_bitrate_controller_set_fec(MSBitrateController *obj, MSRtpFec *fec){
+	obj->fec=fec;
+}
+
 void ms_bitrate_controller_destroy(MSBitrateController *obj){
 	ms_qos_analyzer_unref(obj->analyzer);
 	ms_bitrate_driver_unref(obj->driver);
@@ -156,3 +161,9 @@ MSBitrateController *ms_bandwidth_bitrate_controller_new(RtpSession *asession, M
 	                                 ms_bandwidth_bitrate_driver_new(asession, aenc, vsession, venc));
 }
 
+MSBitrateController *ms_delay_gradient_bitrate_controller_new(RtpSession *asession, MSFilter *aenc, RtpSession *vsession, MSFilter *venc){
+	return ms_bitrate_controller_new(
+	                                 ms_delay_gradient_qos_analyzer_new(vsession?vsession:asession),
+	                                 ms_bandwidth_bitrate_driver_new(asession, aenc, vsession, venc));
+}
+
@@ -52,6 +52,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define ICE_NOMINATION_DELAY		1000	/* In milliseconds */
 #define ICE_MAX_RETRANSMISSIONS		7
 #define ICE_MAX_STUN_REQUEST_RETRANSMISSIONS	7
+#define ICE_INDEX_INITIAL_SIZE		16
+#define ICE_TIMER_WHEEL_SLOTS		256
+#define ICE_TIMER_WHEEL_RESOLUTION	10	/* In milliseconds */
 
 
 typedef struct _Type_ComponentID {
@@ -71,12 +74,6 @@ typedef struct _CheckList_RtpSession {
 	const RtpSession *rtp_session;
 } CheckList_RtpSession;
 
-typedef struct _CheckList_RtpSession_Time {
-	IceCheckList *cl;
-	const RtpSession *rtp_session;
-	MSTimeSpec time;
-} CheckList_RtpSession_Time;
-
 typedef struct _CheckList_Bool {
 	IceCheckList *cl;
 	bool_t result;
@@ -113,6 +110,46 @@ typedef struct _LosingRemoteCandidate_InProgress_Failed {
 	bool_t failed_candidates;
 } LosingRemoteCandidate_InProgress_Failed;
 
+typedef struct _IceIndexEntry {
+	struct _IceIndexEntry *next;
+	uint32_t hash;
+	void *data;
+} IceIndexEntry;
+
+/* Hash table with chained buckets, the number of buckets being a power of 2. */
+typedef struct _IceIndex {
+	IceIndexEntry **buckets;
+	int size;
+	int count;
+} IceIndex;
+
+struct _IceCheckListIndexes {
+	IceIndex local_candidates;	/* IceCandidate structures by transport address */
+	IceIndex remote_candidates;	/* IceCandidate structures by transport address */
+	IceIndex pairs;	/* IceCandidatePair structures by local and remote candidates */
+	IceIndex transactions;	/* IceTransaction structures by transaction ID */
+	IceIndex pair_transactions;	/* Latest IceTransaction structure of each candidate pair */
+};
+
+typedef void (*IceTimerFunc)(IceCheckList *cl, void *data, RtpSession *rtp_session, MSTimeSpec curtime);
+
+typedef struct _IceTimer {
+	struct _IceTimer *next;
+	struct _IceTimer *prev;
+	uint64_t tick;	/* Tick of the timer wheel at which the timer expires */
+	IceTimerFunc func;
+	void *data;
+	bool_t scheduled;
+} IceTimer;
+
+/* Hashed timer wheel: a timer expiring at a given tick is linked in the slot tick % ICE_TIMER_WHEEL_SLOTS,
+ * so that each iteration only looks at the slots of the ticks elapsed since the previous one. */
+struct _IceTimerWheel {
+	IceTimer *slots[ICE_TIMER_WHEEL_SLOTS];
+	uint64_t next_tick;	/* First tick that has not been processed yet */
+	IceTimer keepalive;
+};
+
 
 static MSTimeSpec ice_current_time(void);
 static MSTimeSpec ice_add_ms(MSTimeSpec orig, uint32_t ms);
@@ -127,7 +164,6 @@ static void ice_check_list_deallocate_rtcp_turn_candidate(IceCheckList *cl);
 static void ice_check_list_deallocate_turn_candidates(IceCheckList *cl);
 static int ice_compare_transport_addresses(const IceTransportAddress *ta1, const IceTransportAddress *ta2);
 static int ice_compare_pair_priorities(const IceCandidatePair *p1, const IceCandidatePair *p2);
-static int ice_compare_pairs(const IceCandidatePair *p1, const IceCandidatePair *p2);
 static int ice_compare_candidates(const IceCandidate *c1, const IceCandidate *c2);
 static int ice_find_host_candidate(const IceCandidate *candidate, const uint16_t *componentID);
 static int ice_find_candidate_from_type_and_componentID(const IceCandidate *candidate, const Type_ComponentID *tc);
@@ -145,6 +181,13 @@ static void ice_check_list_remove_stun_server_request(IceCheckList *cl, UInt96 *
 static IceStunServerRequest * ice_check_list_get_stun_server_request(IceCheckList *cl, UInt96 *tr_id);
 static void ice_transport_address_to_printable_ip_address(const IceTransportAddress *taddr, char *printable_ip, size_t printable_ip_size);
 static void ice_stun_server_request_add_transaction(IceStunServerRequest *request, IceStunServerRequestTransaction *transaction);
+static int ice_find_candidate_from_transport_address(const IceCandidate *candidate, const IceTransportAddress *taddr);
+static int ice_find_pair_from_candidates(const IceCandidatePair *pair, const LocalCandidate_RemoteCandidate *candidates);
+static int ice_find_pair_from_transactionID(const IceTransaction *transaction, const UInt96 *transactionID);
+static void ice_send_binding_request(IceCheckList *cl, IceCandidatePair *pair, const RtpSession *rtp_session);
+static void ice_send_keepalive_packets(IceCheckList *cl, const RtpSession *rtp_session);
+static void ice_pair_retransmission_timer_expired(IceCheckList *cl, IceCandidatePair *pair, RtpSession *rtp_session, MSTimeSpec curtime);
+static void ice_check_list_keepalive_timer_expired(IceCheckList *cl, void *data, RtpSession *rtp_session, MSTimeSpec curtime);
 
 
 /******************************************************************************
@@ -260,6 +303,302 @@ void ice_session_enable_message_integrity_check(IceSession *session,bool_t enabl
 	session->check_message_integrity=enable;
 }
 
+/******************************************************************************
+ * CHECK LIST INDEXES                                                         *
+ *****************************************************************************/
+
+static uint32_t ice_hash_bytes(uint32_t h, const void *data, size_t len)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	size_t i;
+	/* FNV-1a */
+	for (i = 0; i < len; i++) h = (h ^ bytes[i]) * 16777619u;
+	return h;
+}
+
+static uint32_t ice_hash_transport_address(const IceTransportAddress *taddr)
+{
+	uint32_t h = ice_hash_bytes(2166136261u, taddr->ip, strlen(taddr->ip));
+	return ice_hash_bytes(h, &taddr->port, sizeof(taddr->port));
+}
+
+static uint32_t ice_hash_candidates(const IceCandidate *local, const IceCandidate *remote)
+{
+	uint32_t h = ice_hash_bytes(2166136261u, &local, sizeof(local));
+	return ice_hash_bytes(h, &remote, sizeof(remote));
+}
+
+static uint32_t ice_hash_pair(const IceCandidatePair *pair)
+{
+	return ice_hash_bytes(2166136261u, &pair, sizeof(pair));
+}
+
+static uint32_t ice_hash_transaction_id(const UInt96 *tr_id)
+{
+	return ice_hash_bytes(2166136261u, tr_id->octet, sizeof(tr_id->octet));
+}
+
+static void ice_index_init(IceIndex *index)
+{
+	index->size = ICE_INDEX_INITIAL_SIZE;
+	index->buckets = ms_new0(IceIndexEntry *, index->size);
+	index->count = 0;
+}
+
+static void ice_index_clear(IceIndex *index)
+{
+	int i;
+	for (i = 0; i < index->size; i++) {
+		IceIndexEntry *entry = index->buckets[i];
+		while (entry != NULL) {
+			IceIndexEntry *next = entry->next;
+			ms_free(entry);
+			entry = next;
+		}
+		index->buckets[i] = NULL;
+	}
+	index->count = 0;
+}
+
+static void ice_index_uninit(IceIndex *index)
+{
+	ice_index_clear(index);
+	ms_free(index->buckets);
+}
+
+/* The entries are appended, so that a lookup returns the element that comes first in the corresponding list. */
+static void ice_index_append(IceIndex *index, IceIndexEntry *entry)
+{
+	IceIndexEntry **pe = &index->buckets[entry->hash & (index->size - 1)];
+	while (*pe != NULL) pe = &(*pe)->next;
+	entry->next = NULL;
+	*pe = entry;
+}
+
+static void ice_index_add(IceIndex *index, uint32_t hash, void *data)
+{
+	IceIndexEntry *entry = ms_new0(IceIndexEntry, 1);
+	if (index->count >= 2 * index->size) {
+		IceIndexEntry **old = index->buckets;
+		int old_size = index->size;
+		int i;
+		index->size *= 2;
+		index->buckets = ms_new0(IceIndexEntry *, index->size);
+		for (i = 0; i < old_size; i++) {
+			IceIndexEntry *it = old[i];
+			while (it != NULL) {
+				IceIndexEntry *next = it->next;
+				ice_index_append(index, it);
+				it = next;
+			}
+		}
+		ms_free(old);
+	}
+	entry->hash = hash;
+	entry->data = data;
+	ice_index_append(index, entry);
+	index->count++;
+}
+
+/* Returns the first element of the bucket for which func returns 0, like bctbx_list_find_custom() does. */
+static void * ice_index_find(const IceIndex *index, uint32_t hash, bctbx_compare_func func, const void *key)
+{
+	IceIndexEntry *entry;
+	for (entry = index->buckets[hash & (index->size - 1)]; entry != NULL; entry = entry->next) {
+		if ((entry->hash == hash) && (func(entry->data, key) == 0)) return entry->data;
+	}
+	return NULL;
+}
+
+static void ice_index_remove(IceIndex *index, uint32_t hash, const void *data)
+{
+	IceIndexEntry **pe = &index->buckets[hash & (index->size - 1)];
+	while (*pe != NULL) {
+		if ((*pe)->data == data) {
+			IceIndexEntry *entry = *pe;
+			*pe = entry->next;
+			ms_free(entry);
+			index->count--;
+			return;
+		}
+		pe = &(*pe)->next;
+	}
+}
+
+static void ice_index_add_candidate(IceIndex *index, IceCandidate *candidate)
+{
+	ice_index_add(index, ice_hash_transport_address(&candidate->taddr), candidate);
+}
+
+static void ice_index_remove_candidate(IceIndex *index, IceCandidate *candidate)
+{
+	ice_index_remove(index, ice_hash_transport_address(&candidate->taddr), candidate);
+}
+
+static IceCandidate * ice_index_find_candidate(const IceIndex *index, const IceTransportAddress *taddr)
+{
+	return (IceCandidate *)ice_index_find(index, ice_hash_transport_address(taddr), (bctbx_compare_func)ice_find_candidate_from_transport_address, taddr);
+}
+
+static void ice_check_list_add_pair(IceCheckList *cl, IceCandidatePair *pair)
+{
+	cl->pairs = bctbx_list_append(cl->pairs, pair);
+	ice_index_add(&cl->indexes->pairs, ice_hash_candidates(pair->local, pair->remote), pair);
+}
+
+/* Several pairs may share the same candidates (see ice_construct_valid_pair() and ice_add_losing_pair()),
+ * the one that is in the check list is preferred, otherwise the first one that has been added is returned. */
+static IceCandidatePair * ice_check_list_find_pair(const IceCheckList *cl, IceCandidate *local, IceCandidate *remote)
+{
+	const IceIndex *index = &cl->indexes->pairs;
+	uint32_t hash = ice_hash_candidates(local, remote);
+	IceIndexEntry *entry;
+	IceCandidatePair *pair;
+	IceCandidatePair *found = NULL;
+
+	for (entry = index->buckets[hash & (index->size - 1)]; entry != NULL; entry = entry->next) {
+		pair = (IceCandidatePair *)entry->data;
+		if ((entry->hash != hash) || (pair->local != local) || (pair->remote != remote)) continue;
+		if (pair->in_check_list == TRUE) return pair;
+		if (found == NULL) found = pair;
+	}
+	return found;
+}
+
+static int ice_find_transaction_from_pair(const IceTransaction *transaction, const IceCandidatePair *pair)
+{
+	return (transaction->pair != pair);
+}
+
+static IceTransaction * ice_find_transaction(const IceCheckList *cl, const IceCandidatePair *pair)
+{
+	return (IceTransaction *)ice_index_find(&cl->indexes->pair_transactions, ice_hash_pair(pair), (bctbx_compare_func)ice_find_transaction_from_pair, pair);
+}
+
+static struct _IceCheckListIndexes * ice_check_list_indexes_new(void)
+{
+	struct _IceCheckListIndexes *indexes = ms_new0(struct _IceCheckListIndexes, 1);
+	ice_index_init(&indexes->local_candidates);
+	ice_index_init(&indexes->remote_candidates);
+	ice_index_init(&indexes->pairs);
+	ice_index_init(&indexes->transactions);
+	ice_index_init(&indexes->pair_transactions);
+	return indexes;
+}
+
+static void ice_check_list_indexes_destroy(struct _IceCheckListIndexes *indexes)
+{
+	ice_index_uninit(&indexes->local_candidates);
+	ice_index_uninit(&indexes->remote_candidates);
+	ice_index_uninit(&indexes->pairs);
+	ice_index_uninit(&indexes->transactions);
+	ice_index_uninit(&indexes->pair_transactions);
+	ms_free(indexes);
+}
+
+
+/******************************************************************************
+ * CHECK LIST TIMERS                                                          *
+ *****************************************************************************/
+
+static uint64_t ice_time_to_tick(MSTimeSpec ts, bool_t round_up)
+{
+	uint64_t ms = ((uint64_t)ts.tv_sec * 1000) + (uint64_t)(ts.tv_nsec / 1000000);
+	if (round_up == TRUE) ms += ICE_TIMER_WHEEL_RESOLUTION - 1;
+	return ms / ICE_TIMER_WHEEL_RESOLUTION;
+}
+
+static void ice_timer_init(IceTimer *timer, IceTimerFunc func, void *data)
+{
+	memset(timer, 0, sizeof(IceTimer));
+	timer->func = func;
+	timer->data = data;
+}
+
+static void ice_timer_link(struct _IceTimerWheel *wheel, IceTimer *timer)
+{
+	IceTimer **slot = &wheel->slots[timer->tick % ICE_TIMER_WHEEL_SLOTS];
+	timer->prev = NULL;
+	timer->next = *slot;
+	if (*slot != NULL) (*slot)->prev = timer;
+	*slot = timer;
+	timer->scheduled = TRUE;
+}
+
+static void ice_timer_cancel(struct _IceTimerWheel *wheel, IceTimer *timer)
+{
+	if (timer->scheduled == FALSE) return;
+	if (timer->prev != NULL) timer->prev->next = timer->next;
+	else wheel->slots[timer->tick % ICE_TIMER_WHEEL_SLOTS] = timer->next;
+	if (timer->next != NULL) timer->next->prev = timer->prev;
+	timer->next = timer->prev = NULL;
+	timer->scheduled = FALSE;
+}
+
+/* A timer expiring in the past is run at the next iteration. */
+static void ice_timer_schedule(struct _IceTimerWheel *wheel, IceTimer *timer, MSTimeSpec expiry)
+{
+	uint64_t tick = ice_time_to_tick(expiry, TRUE);
+	ice_timer_cancel(wheel, timer);
+	timer->tick = MAX(tick, wheel->next_tick);
+	ice_timer_link(wheel, timer);
+}
+
+static struct _IceTimerWheel * ice_timer_wheel_new(void)
+{
+	struct _IceTimerWheel *wheel = ms_new0(struct _IceTimerWheel, 1);
+	wheel->next_tick = ice_time_to_tick(ice_current_time(), FALSE);
+	ice_timer_init(&wheel->keepalive, ice_check_list_keepalive_timer_expired, NULL);
+	return wheel;
+}
+
+static void ice_timer_wheel_destroy(struct _IceTimerWheel *wheel)
+{
+	ms_free(wheel);
+}
+
+/* Run the timers that expired since the previous call. A timer function may only reschedule or cancel its own timer. */
+static void ice_check_list_run_timers(IceCheckList *cl, RtpSession *rtp_session, MSTimeSpec curtime)
+{
+	struct _IceTimerWheel *wheel = cl->timers;
+	uint64_t now = ice_time_to_tick(curtime, FALSE);
+
+	/* After a long pause, visiting each slot once is enough to find all the expired timers. */
+	if ((now >= wheel->next_tick) && ((now - wheel->next_tick) >= ICE_TIMER_WHEEL_SLOTS)) {
+		wheel->next_tick = now - ICE_TIMER_WHEEL_SLOTS + 1;
+	}
+	while (wheel->next_tick <= now) {
+		IceTimer **slot = &wheel->slots[wheel->next_tick % ICE_TIMER_WHEEL_SLOTS];
+		IceTimer *timer = *slot;
+		/* Detach the slot, the timers rescheduled meanwhile will be linked in later slots. */
+		*slot = NULL;
+		wheel->next_tick++;
+		while (timer != NULL) {
+			IceTimer *next = timer->next;
+			if (timer->tick <= now) {
+				timer->next = timer->prev = NULL;
+				timer->scheduled = FALSE;
+				timer->func(cl, timer->data, rtp_session, curtime);
+			} else {
+				/* The timer expires during a later turn of the wheel. */
+				ice_timer_link(wheel, timer);
+			}
+			timer = next;
+		}
+	}
+}
+
+static void ice_pair_schedule_retransmission(IceCheckList *cl, IceCandidatePair *pair)
+{
+	ice_timer_schedule(cl->timers, pair->retransmission_timer, ice_add_ms(pair->transmission_time, pair->rto));
+}
+
+static void ice_check_list_schedule_keepalive(IceCheckList *cl)
+{
+	ice_timer_schedule(cl->timers, &cl->timers->keepalive, ice_add_ms(cl->keepalive_time, cl->session->keepalive_timeout * 1000));
+}
+
+
 /******************************************************************************
  * CHECK LIST INITIALISATION AND DEINITIALISATION                             *
  *****************************************************************************/
@@ -282,6 +621,8 @@ static void ice_check_list_init(IceCheckList *cl)
 	memset(&cl->keepalive_time, 0, sizeof(cl->keepalive_time));
 	memset(&cl->gathering_start_time, 0, sizeof(cl->gathering_start_time));
 	memset(&cl->nomination_delay_start_time, 0, sizeof(cl->nomination_delay_start_time));
+	cl->indexes = ice_check_list_indexes_new();
+	cl->timers = ice_timer_wheel_new();
 }
 
 IceCheckList * ice_check_list_new(void)
@@ -331,6 +672,8 @@ static IceCandidatePair *ice_pair_new(IceCheckList *cl, IceCandidate* local_cand
 	pair->role = cl->session->role;
 	ice_compute_pair_priority(pair, &cl->session->role);
 	pair->retry_with_dummy_message_integrity=!cl->session->check_message_integrity;
+	pair->retransmission_timer = ms_new0(IceTimer, 1);
+	ice_timer_init(pair->retransmission_timer, (IceTimerFunc)ice_pair_retransmission_timer_expired, pair);
 	return pair;
 }
 
@@ -352,7 +695,13 @@ static void ice_free_valid_pair(IceValidCandidatePair *valid_pair)
 static void ice_free_candidate_pair(IceCandidatePair *pair, IceCheckList *cl)
 {
 	bctbx_list_t *elem;
-	while ((elem = bctbx_list_find(cl->check_list, pair)) != NULL) {
+	IceTransaction *transaction;
+	ice_index_remove(&cl->indexes->pairs, ice_hash_candidates(pair->local, pair->remote), pair);
+	transaction = ice_find_transaction(cl, pair);
+	if (transaction != NULL) ice_index_remove(&cl->indexes->pair_transactions, ice_hash_pair(pair), transaction);
+	ice_timer_cancel(cl->timers, pair->retransmission_timer);
+	ms_free(pair->retransmission_timer);
+	if (pair->in_check_list == TRUE) {
 		cl->check_list = bctbx_list_remove(cl->check_list, pair);
 	}
 	while ((elem = bctbx_list_find_custom(cl->valid_list, (bctbx_compare_func)ice_find_pair_in_valid_list, pair)) != NULL) {
@@ -379,6 +728,8 @@ void ice_check_list_destroy(IceCheckList *cl)
 	if (cl->remote_ufrag) ms_free(cl->remote_ufrag);
 	if (cl->remote_pwd) ms_free(cl->remote_pwd);
 	bctbx_list_for_each(cl->stun_server_requests, (void (*)(void*))ice_stun_server_request_free);
+	ice_index_clear(&cl->indexes->transactions);
+	ice_index_clear(&cl->indexes->pair_transactions);
 	bctbx_list_for_each(cl->transaction_list, (void (*)(void*))ice_free_transaction);
 	bctbx_list_for_each(cl->foundations, (void (*)(void*))ice_free_pair_foundation);
 	bctbx_list_for_each2(cl->pairs, (void (*)(void*,void*))ice_free_candidate_pair, cl);
@@ -397,6 +748,8 @@ void ice_check_list_destroy(IceCheckList *cl)
 	bctbx_list_free(cl->pairs);
 	bctbx_list_free(cl->remote_candidates);
 	bctbx_list_free(cl->local_candidates);
+	ice_check_list_indexes_destroy(cl->indexes);
+	ice_timer_wheel_destroy(cl->timers);
 	memset(cl, 0, sizeof(IceCheckList));
 	ms_free(cl);
 }
@@ -446,6 +799,7 @@ void ice_check_list_set_state(IceCheckList *cl, IceCheckListState state)
 {
 	if (cl->state != state) {
 		cl->state = state;
+		if (state == ICL_Completed) ice_check_list_schedule_keepalive(cl);
 		if (ice_find_check_list_from_state(cl->session, ICL_Running) == NULL) {
 			if (ice_find_check_list_from_state(cl->session, ICL_Failed) != NULL) {
 				/* Set the state of the session to Failed if at least one check list is in the Failed state. */
@@ -776,8 +1130,13 @@ void ice_session_set_max_connectivity_checks(IceSession *session, uint8_t max_co
 
 void ice_session_set_keepalive_timeout(IceSession *session, uint8_t timeout)
 {
+	int i;
 	if (timeout < ICE_DEFAULT_KEEPALIVE_TIMEOUT) timeout = ICE_DEFAULT_KEEPALIVE_TIMEOUT;
 	session->keepalive_timeout = timeout;
+	for (i = 0; i < ICE_SESSION_MAX_CHECK_LISTS; i++) {
+		if ((session->streams[i] != NULL) && (session->streams[i]->state == ICL_Completed))
+			ice_check_list_schedule_keepalive(session->streams[i]);
+	}
 }
 
 
@@ -1186,27 +1545,26 @@ void ice_session_select_candidates(IceSession *session)
  * TRANSACTION HANDLING                                                       *
  *****************************************************************************/
 
+static IceTransaction * ice_find_transaction_from_id(const IceCheckList *cl, const UInt96 *tr_id)
+{
+	return (IceTransaction *)ice_index_find(&cl->indexes->transactions, ice_hash_transaction_id(tr_id), (bctbx_compare_func)ice_find_pair_from_transactionID, tr_id);
+}
+
 static IceTransaction * ice_create_transaction(IceCheckList *cl, IceCandidatePair *pair, const UInt96 tr_id)
 {
 	IceTransaction *transaction = ms_new0(IceTransaction, 1);
+	IceTransaction *previous;
 	transaction->pair = pair;
 	transaction->transactionID = tr_id;
 	cl->transaction_list = bctbx_list_prepend(cl->transaction_list, transaction);
+	ice_index_add(&cl->indexes->transactions, ice_hash_transaction_id(&tr_id), transaction);
+	/* Only the latest transaction of a pair is looked up. */
+	previous = ice_find_transaction(cl, pair);
+	if (previous != NULL) ice_index_remove(&cl->indexes->pair_transactions, ice_hash_pair(pair), previous);
+	ice_index_add(&cl->indexes->pair_transactions, ice_hash_pair(pair), transaction);
 	return transaction;
 }
 
-static int ice_find_transaction_from_pair(const IceTransaction *transaction, const IceCandidatePair *pair)
-{
-	return (transaction->pair != pair);
-}
-
-static IceTransaction * ice_find_transaction(const IceCheckList *cl, const IceCandidatePair *pair)
-{
-	bctbx_list_t *elem = bctbx_list_find_custom(cl->transaction_list, (bctbx_compare_func)ice_find_transaction_from_pair, pair);
-	if (elem == NULL) return NULL;
-	return (IceTransaction *)elem->data;
-}
-
 
 /******************************************************************************
  * STUN PACKETS HANDLING                                                      *
@@ -1419,6 +1777,8 @@ static void ice_send_binding_request(IceCheckList *cl, IceCandidatePair *pair, c
 			if (pair->use_candidate == FALSE) {
 				ice_pair_set_state(pair, ICP_Waiting);
 				ice_check_list_queue_triggered_check(cl, pair);
+			} else {
+				ice_pair_schedule_retransmission(cl, pair);
 			}
 			return;
 		}
@@ -1509,6 +1869,7 @@ static void ice_send_binding_request(IceCheckList *cl, IceCandidatePair *pair, c
 			ice_pair_set_state(pair, ICP_InProgress);
 		}
 	}
+	if (pair->state == ICP_InProgress) ice_pair_schedule_retransmission(cl, pair);
 	if (buf != NULL) ms_free(buf);
 	ms_stun_message_destroy(msg);
 }
@@ -1888,14 +2249,12 @@ static IceCandidate * ice_learn_peer_reflexive_candidate(IceCheckList *cl, const
 {
 	char foundation[32];
 	IceCandidate *candidate = NULL;
-	bctbx_list_t *elem;
 	int componentID;
 
 	componentID = ice_get_componentID_from_rtp_session(evt_data);
 	if (componentID < 0) return NULL;
 
-	elem = bctbx_list_find_custom(cl->remote_candidates, (bctbx_compare_func)ice_find_candidate_from_transport_address, taddr);
-	if (elem == NULL) {
+	if (ice_index_find_candidate(&cl->indexes->remote_candidates, taddr) == NULL) {
 		ms_message("ice: Learned peer reflexive candidate %s:%d", taddr->ip, taddr->port);
 		/* Add peer reflexive candidate to the remote candidates list. */
 		memset(foundation, '\0', sizeof(foundation));
@@ -1915,7 +2274,6 @@ static IceCandidatePair * ice_trigger_connectivity_check_on_binding_request(IceC
 {
 	IceTransportAddress local_taddr;
 	LocalCandidate_RemoteCandidate candidates;
-	bctbx_list_t *elem;
 	IceCandidatePair *pair = NULL;
 	struct sockaddr_storage recv_addr;
 	socklen_t recv_addrlen = sizeof(recv_addr);
@@ -1925,46 +2283,38 @@ static IceCandidatePair * ice_trigger_connectivity_check_on_binding_request(IceC
 	memset(addr_str, 0, sizeof(addr_str));
 	ortp_recvaddr_to_sockaddr(&evt_data->packet->recv_addr, (struct sockaddr *)&recv_addr, &recv_addrlen);
 	ice_fill_transport_address_from_sockaddr(&local_taddr, (struct sockaddr *)&recv_addr, recv_addrlen);
-	elem = bctbx_list_find_custom(cl->local_candidates, (bctbx_compare_func)ice_find_candidate_from_transport_address, &local_taddr);
-	if (elem == NULL) {
+	candidates.local = ice_index_find_candidate(&cl->indexes->local_candidates, &local_taddr);
+	if (candidates.local == NULL) {
 		ice_transport_address_to_printable_ip_address(&local_taddr, addr_str, sizeof(addr_str));
 		ms_error("ice: Local candidate %s not found!", addr_str);
 		return NULL;
 	}
-	candidates.local = (IceCandidate *)elem->data;
 	if (prflx_candidate != NULL) {
 		candidates.remote = prflx_candidate;
 	} else {
-		elem = bctbx_list_find_custom(cl->remote_candidates, (bctbx_compare_func)ice_find_candidate_from_transport_address, remote_taddr);
-		if (elem == NULL) {
+		candidates.remote = ice_index_find_candidate(&cl->indexes->remote_candidates, remote_taddr);
+		if (candidates.remote == NULL) {
 			ice_transport_address_to_printable_ip_address(remote_taddr, addr_str, sizeof(addr_str));
 			ms_error("ice: Remote candidate %s not found!", addr_str);
 			return NULL;
 		}
-		candidates.remote = (IceCandidate *)elem->data;
 	}
-	elem = bctbx_list_find_custom(cl->check_list, (bctbx_compare_func)ice_find_pair_from_candidates, &candidates);
-	if (elem == NULL) {
+	/* Check if the pair is in the list of pairs even if it is not in the check list. */
+	pair = ice_check_list_find_pair(cl, candidates.local, candidates.remote);
+	if ((pair == NULL) || (pair->in_check_list == FALSE)) {
 		/* The pair is not in the check list yet. */
 		ms_message("ice: Add new candidate pair in the check list");
-		/* Check if the pair is in the list of pairs even if it is not in the check list. */
-		elem = bctbx_list_find_custom(cl->pairs, (bctbx_compare_func)ice_find_pair_from_candidates, &candidates);
-		if (elem == NULL) {
+		if (pair == NULL) {
 			pair = ice_pair_new(cl, candidates.local, candidates.remote);
-			cl->pairs = bctbx_list_append(cl->pairs, pair);
-		} else {
-			pair = (IceCandidatePair *)elem->data;
-		}
-		elem = bctbx_list_find(cl->check_list, pair);
-		if (elem == NULL) {
-			cl->check_list = bctbx_list_insert_sorted(cl->check_list, pair, (bctbx_compare_func)ice_compare_pair_priorities);
+			ice_check_list_add_pair(cl, pair);
 		}
+		cl->check_list = bctbx_list_insert_sorted(cl->check_list, pair, (bctbx_compare_func)ice_compare_pair_priorities);
+		pair->in_check_list = TRUE;
 		/* Set the state of the pair to Waiting and trigger a check. */
 		ice_pair_set_state(pair, ICP_Waiting);
 		ice_check_list_queue_triggered_check(cl, pair);
 	} else {
 		/* The pair has been found in the check list. */
-		pair = (IceCandidatePair *)elem->data;
 		switch (pair->state) {
 			case ICP_Waiting:
 			case ICP_Frozen:
@@ -2086,22 +2436,19 @@ static IceCandidate * ice_discover_peer_reflexive_candidate(IceCheckList *cl, co
 	IceTransportAddress taddr;
 	const MSStunAddress *xor_mapped_address;
 	IceCandidate *candidate = NULL;
-	bctbx_list_t *elem;
 	char taddr_str[64];
 
 	memset(&taddr, 0, sizeof(taddr));
 	xor_mapped_address = ms_stun_message_get_xor_mapped_address(msg);
 	ice_fill_transport_address_from_stun_address(&taddr, xor_mapped_address);
-	elem = bctbx_list_find_custom(cl->local_candidates, (bctbx_compare_func)ice_find_candidate_from_transport_address, &taddr);
-	if (elem == NULL) {
+	candidate = ice_index_find_candidate(&cl->indexes->local_candidates, &taddr);
+	if (candidate == NULL) {
 		memset(taddr_str, 0, sizeof(taddr_str));
 		ice_transport_address_to_printable_ip_address(&taddr, taddr_str, sizeof(taddr_str));
 		ms_message("ice: Discovered peer reflexive candidate %s", taddr_str);
 		/* Add peer reflexive candidate to the local candidates list. */
 		candidate = ice_add_local_candidate(cl, "prflx", taddr.family, taddr.ip, taddr.port, pair->local->componentID, pair->local);
 		ice_compute_candidate_foundation(candidate, cl);
-	} else {
-		candidate = (IceCandidate *)elem->data;
 	}
 	return candidate;
 }
@@ -2129,15 +2476,13 @@ static IceCandidatePair * ice_construct_valid_pair(IceCheckList *cl, RtpSession
 
 	candidates.local = candidate;
 	candidates.remote = succeeded_pair->remote;
-	elem = bctbx_list_find_custom(cl->check_list, (bctbx_compare_func)ice_find_pair_from_candidates, &candidates);
-	if (elem == NULL) {
+	pair = ice_check_list_find_pair(cl, candidates.local, candidates.remote);
+	if ((pair == NULL) || (pair->in_check_list == FALSE)) {
 		/* The candidate pair is not a known candidate pair, compute its priority and add it to the valid list. */
 		pair = ice_pair_new(cl, candidates.local, candidates.remote);
-		cl->pairs = bctbx_list_append(cl->pairs, pair);
-	} else {
-		/* The candidate pair is already in the check list, add it to the valid list. */
-		pair = (IceCandidatePair *)elem->data;
+		ice_check_list_add_pair(cl, pair);
 	}
+	/* Otherwise the candidate pair is already in the check list, add it to the valid list. */
 	valid_pair = ms_new0(IceValidCandidatePair, 1);
 	valid_pair->valid = pair;
 	valid_pair->generated_from = succeeded_pair;
@@ -2427,7 +2772,7 @@ static void ice_handle_received_binding_response(IceCheckList *cl, RtpSession *r
 	IceCandidatePair *valid_pair;
 	IceCandidate *candidate;
 	IceCandidatePairState succeeded_pair_previous_state;
-	bctbx_list_t *elem;
+	IceTransaction *transaction;
 	UInt96 tr_id = ms_stun_message_get_tr_id(msg);
 
 	if (cl->gathering_candidates == TRUE) {
@@ -2435,8 +2780,8 @@ static void ice_handle_received_binding_response(IceCheckList *cl, RtpSession *r
 			return;
 	}
 
-	elem = bctbx_list_find_custom(cl->transaction_list, (bctbx_compare_func)ice_find_pair_from_transactionID, &tr_id);
-	if (elem == NULL) {
+	transaction = ice_find_transaction_from_id(cl, &tr_id);
+	if (transaction == NULL) {
 		/* We received an error response concerning an unknown binding request, ignore it... */
 		char tr_id_str[25];
 		transactionID2string(&tr_id, tr_id_str);
@@ -2444,7 +2789,7 @@ static void ice_handle_received_binding_response(IceCheckList *cl, RtpSession *r
 		return;
 	}
 
-	succeeded_pair = (IceCandidatePair *)((IceTransaction *)elem->data)->pair;
+	succeeded_pair = transaction->pair;
 	if (ice_check_received_binding_response_addresses(rtp_session, evt_data, succeeded_pair, remote_addr) < 0) return;
 	if (ice_check_received_binding_response_attributes(msg, remote_addr,cl->session->check_message_integrity) < 0) return;
 
@@ -2500,13 +2845,13 @@ static void ice_handle_received_error_response(IceCheckList *cl, RtpSession *rtp
 		ice_handle_stun_server_error_response(cl, rtp_session, evt_data, msg);
 	} else {
 		UInt96 tr_id = ms_stun_message_get_tr_id(msg);
-		bctbx_list_t *elem = bctbx_list_find_custom(cl->transaction_list, (bctbx_compare_func)ice_find_pair_from_transactionID, &tr_id);
-		if (elem == NULL) {
+		IceTransaction *transaction = ice_find_transaction_from_id(cl, &tr_id);
+		if (transaction == NULL) {
 			/* We received an error response concerning an unknown binding request, ignore it... */
 			return;
 		}
 
-		pair = (IceCandidatePair *)((IceTransaction *)elem->data)->pair;
+		pair = transaction->pair;
 		if (ms_stun_message_has_error_code(msg)
 				&& (ms_stun_message_get_error_code(msg, NULL) == MS_STUN_ERROR_CODE_UNAUTHORIZED)
 				&& pair->retry_with_dummy_message_integrity) {
@@ -2732,7 +3077,6 @@ static void ice_remove_componentID(bctbx_list_t **list, uint16_t componentID){
 
 IceCandidate * ice_add_local_candidate(IceCheckList* cl, const char* type, int family, const char* ip, int port, uint16_t componentID, IceCandidate* base)
 {
-	bctbx_list_t *elem;
 	IceCandidate *candidate;
 
 	if (bctbx_list_size(cl->local_candidates) >= ICE_MAX_NB_CANDIDATES) {
@@ -2744,8 +3088,7 @@ IceCandidate * ice_add_local_candidate(IceCheckList* cl, const char* type, int f
 	if (candidate->base == NULL) candidate->base = base;
 	ice_compute_candidate_priority(candidate);
 
-	elem = bctbx_list_find_custom(cl->local_candidates, (bctbx_compare_func)ice_compare_candidates, candidate);
-	if (elem != NULL) {
+	if (ice_index_find(&cl->indexes->local_candidates, ice_hash_transport_address(&candidate->taddr), (bctbx_compare_func)ice_compare_candidates, candidate) != NULL) {
 		/* This candidate is already in the list, do not add it again. */
 		ms_free(candidate);
 		return NULL;
@@ -2753,13 +3096,13 @@ IceCandidate * ice_add_local_candidate(IceCheckList* cl, const char* type, int f
 
 	ice_add_componentID(&cl->local_componentIDs, &candidate->componentID);
 	cl->local_candidates = bctbx_list_append(cl->local_candidates, candidate);
+	ice_index_add_candidate(&cl->indexes->local_candidates, candidate);
 
 	return candidate;
 }
 
 IceCandidate * ice_add_remote_candidate(IceCheckList *cl, const char *type, int family, const char *ip, int port, uint16_t componentID, uint32_t priority, const char * const foundation, bool_t is_default)
 {
-	bctbx_list_t *elem;
 	IceCandidate *candidate;
 
 	if (bctbx_list_size(cl->local_candidates) >= ICE_MAX_NB_CANDIDATES) {
@@ -2772,8 +3115,7 @@ IceCandidate * ice_add_remote_candidate(IceCheckList *cl, const char *type, int
 	if (priority == 0) ice_compute_candidate_priority(candidate);
 	else candidate->priority = priority;
 
-	elem = bctbx_list_find_custom(cl->remote_candidates, (bctbx_compare_func)ice_compare_candidates, candidate);
-	if (elem != NULL) {
+	if (ice_index_find(&cl->indexes->remote_candidates, ice_hash_transport_address(&candidate->taddr), (bctbx_compare_func)ice_compare_candidates, candidate) != NULL) {
 		/* This candidate is already in the list, do not add it again. */
 		ms_free(candidate);
 		return NULL;
@@ -2783,6 +3125,7 @@ IceCandidate * ice_add_remote_candidate(IceCheckList *cl, const char *type, int
 	candidate->is_default = is_default;
 	ice_add_componentID(&cl->remote_componentIDs, &candidate->componentID);
 	cl->remote_candidates = bctbx_list_append(cl->remote_candidates, candidate);
+	ice_index_add_candidate(&cl->indexes->remote_candidates, candidate);
 	if (cl->session->turn_enabled) {
 		bctbx_list_t *elem = bctbx_list_find_custom(cl->local_candidates, (bctbx_compare_func)ice_find_host_candidate, &componentID);
 		if (elem != NULL) {
@@ -2845,8 +3188,8 @@ void ice_add_losing_pair(IceCheckList *cl, uint16_t componentID, int family, con
 	snprintf(taddr.ip, sizeof(taddr.ip), "%s", local_addr);
 	taddr.port = local_port;
 	taddr.family = family;
-	elem = bctbx_list_find_custom(cl->local_candidates, (bctbx_compare_func)ice_find_candidate_from_transport_address, &taddr);
-	if (elem == NULL) {
+	lr.local = ice_index_find_candidate(&cl->indexes->local_candidates, &taddr);
+	if (lr.local == NULL) {
 		/* Workaround to detect if the local candidate that has not been found has been added by the proxy server.
 		   If that is the case, add it to the local candidates now. */
 		elem = bctbx_list_find_custom(cl->remote_candidates, (bctbx_compare_func)ice_find_candidate_from_ip_address, local_addr);
@@ -2865,35 +3208,30 @@ void ice_add_losing_pair(IceCheckList *cl, uint16_t componentID, int family, con
 			ms_warning("ice: Local candidate %s should have been found", taddr_str);
 			return;
 		}
-	} else {
-		lr.local = (IceCandidate *)elem->data;
 	}
 	snprintf(taddr.ip, sizeof(taddr.ip), "%s", remote_addr);
 	taddr.port = remote_port;
 	taddr.family = family;
-	elem = bctbx_list_find_custom(cl->remote_candidates, (bctbx_compare_func)ice_find_candidate_from_transport_address, &taddr);
-	if (elem == NULL) {
+	lr.remote = ice_index_find_candidate(&cl->indexes->remote_candidates, &taddr);
+	if (lr.remote == NULL) {
 		ice_transport_address_to_printable_ip_address(&taddr, taddr_str, sizeof(taddr_str));
 		ms_warning("ice: Remote candidate %s should have been found", taddr_str);
 		return;
 	}
-	lr.remote = (IceCandidate *)elem->data;
 	if (added_missing_relay_candidate == TRUE) {
 		/* If we just added a missing relay candidate, also add the candidate pair. */
 		pair = ice_pair_new(cl, lr.local, lr.remote);
-		cl->pairs = bctbx_list_append(cl->pairs, pair);
+		ice_check_list_add_pair(cl, pair);
 	}
-	elem = bctbx_list_find_custom(cl->pairs, (bctbx_compare_func)ice_find_pair_from_candidates, &lr);
-	if (elem == NULL) {
+	pair = ice_check_list_find_pair(cl, lr.local, lr.remote);
+	if (pair == NULL) {
 		if (added_missing_relay_candidate == FALSE) {
 			/* Candidate pair has not been created but the candidates exist.
 			It must be that the local candidate is a reflexive or relayed candidate.
 			Therefore create this pair and use it. */
 			pair = ice_pair_new(cl, lr.local, lr.remote);
-			cl->pairs = bctbx_list_append(cl->pairs, pair);
+			ice_check_list_add_pair(cl, pair);
 		} else return;
-	} else {
-		pair = (IceCandidatePair *)elem->data;
 	}
 	elem = bctbx_list_find_custom(cl->valid_list, (bctbx_compare_func)ice_find_pair_in_valid_list, pair);
 	if (elem == NULL) {
@@ -3008,32 +3346,32 @@ static int ice_find_redundant_candidate(const IceCandidate *c1, const IceCandida
 static void ice_check_list_eliminate_redundant_candidates(IceCheckList *cl)
 {
 	bctbx_list_t *elem;
-	bctbx_list_t *other_elem;
+	bctbx_list_t *next;
 	IceCandidate *candidate;
 	IceCandidate *other_candidate;
-	bool_t elem_removed;
 
 	if (cl->state == ICL_Running) {
-		do {
-			elem_removed = FALSE;
-			/* Do not use bctbx_list_for_each2() here, we may remove list elements. */
-			for (elem = cl->local_candidates; elem != NULL; elem = elem->next) {
-				candidate = (IceCandidate *)elem->data;
-				other_elem = bctbx_list_find_custom(cl->local_candidates, (bctbx_compare_func)ice_find_redundant_candidate, candidate);
-				if (other_elem != NULL) {
-					other_candidate = (IceCandidate *)other_elem->data;
-					if (other_candidate->priority < candidate->priority) {
-						ice_free_candidate(other_candidate);
-						cl->local_candidates = bctbx_list_remove_link(cl->local_candidates, other_elem);
-					} else {
-						ice_free_candidate(candidate);
-						cl->local_candidates = bctbx_list_remove_link(cl->local_candidates, elem);
-					}
-					elem_removed = TRUE;
+		/* Do not use bctbx_list_for_each2() here, we may remove list elements. */
+		for (elem = cl->local_candidates; elem != NULL; elem = next) {
+			next = elem->next;
+			candidate = (IceCandidate *)elem->data;
+			/* The redundant candidates have the same transport address, so they are in the same bucket of the index. */
+			other_candidate = ice_index_find(&cl->indexes->local_candidates, ice_hash_transport_address(&candidate->taddr), (bctbx_compare_func)ice_find_redundant_candidate, candidate);
+			while (other_candidate != NULL) {
+				if (other_candidate->priority < candidate->priority) {
+					if ((next != NULL) && (next->data == other_candidate)) next = next->next;
+					ice_index_remove_candidate(&cl->indexes->local_candidates, other_candidate);
+					cl->local_candidates = bctbx_list_remove(cl->local_candidates, other_candidate);
+					ice_free_candidate(other_candidate);
+				} else {
+					ice_index_remove_candidate(&cl->indexes->local_candidates, candidate);
+					cl->local_candidates = bctbx_list_remove_link(cl->local_candidates, elem);
+					ice_free_candidate(candidate);
 					break;
 				}
+				other_candidate = ice_index_find(&cl->indexes->local_candidates, ice_hash_transport_address(&candidate->taddr), (bctbx_compare_func)ice_find_redundant_candidate, candidate);
 			}
-		} while (elem_removed);
+		}
 	}
 }
 
@@ -3137,7 +3475,7 @@ static void ice_form_candidate_pairs(IceCheckList *cl)
 			remote_candidate = (IceCandidate*)remote_list->data;
 			if (local_candidate->componentID == remote_candidate->componentID) {
 				pair = ice_pair_new(cl, local_candidate, remote_candidate);
-				cl->pairs = bctbx_list_append(cl->pairs, pair);
+				ice_check_list_add_pair(cl, pair);
 			}
 			remote_list = bctbx_list_next(remote_list);
 		}
@@ -3168,30 +3506,34 @@ static int ice_compare_candidates(const IceCandidate *c1, const IceCandidate *c2
 		&& (c1->priority == c2->priority));
 }
 
-static int ice_compare_pairs(const IceCandidatePair *p1, const IceCandidatePair *p2)
-{
-	return !((ice_compare_candidates(p1->local, p2->local) == 0)
-		&& (ice_compare_candidates(p1->remote, p2->remote) == 0));
-}
-
+/* The pairs are indexed again in the order of the list, since the replacement of the server reflexive candidates changed their keys. */
 static int ice_prune_duplicate_pair(IceCandidatePair *pair, bctbx_list_t **pairs, IceCheckList *cl)
 {
-	bctbx_list_t *other_pair = bctbx_list_find_custom(*pairs, (bctbx_compare_func)ice_compare_pairs, pair);
-	if (other_pair != NULL) {
-		IceCandidatePair *other_candidate_pair = (IceCandidatePair *)other_pair->data;
-		if (other_candidate_pair->priority > pair->priority) {
-			/* Found duplicate with higher priority so prune current pair. */
-			*pairs = bctbx_list_remove(*pairs, pair);
-			ice_free_candidate_pair(pair, cl);
-			return 1;
-		}
+	LocalCandidate_RemoteCandidate candidates;
+	IceCandidatePair *other_candidate_pair;
+
+	candidates.local = pair->local;
+	candidates.remote = pair->remote;
+	other_candidate_pair = (IceCandidatePair *)ice_index_find(&cl->indexes->pairs, ice_hash_candidates(pair->local, pair->remote), (bctbx_compare_func)ice_find_pair_from_candidates, &candidates);
+	if ((other_candidate_pair != NULL) && (other_candidate_pair->priority > pair->priority)) {
+		/* Found duplicate with higher priority so prune current pair. */
+		*pairs = bctbx_list_remove(*pairs, pair);
+		ice_free_candidate_pair(pair, cl);
+		return 1;
 	}
+	ice_index_add(&cl->indexes->pairs, ice_hash_candidates(pair->local, pair->remote), pair);
 	return 0;
 }
 
 static void ice_create_check_list(IceCandidatePair *pair, IceCheckList *cl)
 {
 	cl->check_list = bctbx_list_insert_sorted(cl->check_list, pair, (bctbx_compare_func)ice_compare_pair_priorities);
+	pair->in_check_list = TRUE;
+}
+
+static void ice_pair_clear_in_check_list(IceCandidatePair *pair)
+{
+	pair->in_check_list = FALSE;
 }
 
 /* Prune pairs according to 5.7.3. */
@@ -3200,11 +3542,13 @@ static void ice_prune_candidate_pairs(IceCheckList *cl)
 	bctbx_list_t *list;
 	bctbx_list_t *next;
 	bctbx_list_t *prev;
+	IceCandidatePair *pair;
 	int nb_pairs;
 	int nb_pairs_to_remove;
 	int i;
 
 	bctbx_list_for_each(cl->pairs, (void (*)(void*))ice_replace_srflx_by_base_in_pair);
+	ice_index_clear(&cl->indexes->pairs);
 	/* Do not use bctbx_list_for_each2() here, because ice_prune_duplicate_pair() can remove list elements. */
 	for (list = cl->pairs; list != NULL; list = list->next) {
 		next = list->next;
@@ -3215,6 +3559,7 @@ static void ice_prune_candidate_pairs(IceCheckList *cl)
 	}
 
 	/* Create the check list. */
+	bctbx_list_for_each(cl->check_list, (void (*)(void*))ice_pair_clear_in_check_list);
 	bctbx_list_free(cl->check_list);
 	cl->check_list = NULL;
 	bctbx_list_for_each2(cl->pairs, (void (*)(void*,void*))ice_create_check_list, cl);
@@ -3226,10 +3571,12 @@ static void ice_prune_candidate_pairs(IceCheckList *cl)
 		list = cl->check_list;
 		for (i = 0; i < (nb_pairs - 1); i++) list = bctbx_list_next(list);
 		for (i = 0; i < nb_pairs_to_remove; i++) {
-			cl->pairs = bctbx_list_remove(cl->pairs, list->data);
-			ice_free_candidate_pair(list->data, cl);
+			pair = (IceCandidatePair *)list->data;
 			prev = list->prev;
 			cl->check_list = bctbx_list_remove_link(cl->check_list, list);
+			pair->in_check_list = FALSE;
+			cl->pairs = bctbx_list_remove(cl->pairs, pair);
+			ice_free_candidate_pair(pair, cl);
 			list = prev;
 		}
 	}
@@ -3360,7 +3707,7 @@ static void ice_perform_regular_nomination(IceValidCandidatePair *valid_pair, Ch
 	}
 }
 
-static void ice_remove_waiting_and_frozen_pairs_from_list(bctbx_list_t **list, uint16_t componentID)
+static void ice_remove_waiting_and_frozen_pairs_from_list(IceCheckList *cl, bctbx_list_t **list, uint16_t componentID)
 {
 	IceCandidatePair *pair;
 	bctbx_list_t *elem;
@@ -3371,6 +3718,7 @@ static void ice_remove_waiting_and_frozen_pairs_from_list(bctbx_list_t **list, u
 		if (((pair->state == ICP_Waiting) || (pair->state == ICP_Frozen)) && (pair->local->componentID == componentID)) {
 			next = elem->next;
 			*list = bctbx_list_remove_link(*list, elem);
+			if (list == &cl->check_list) pair->in_check_list = FALSE;
 			if (next && next->prev) elem = next->prev;
 			else break;	/* The end of the list has been reached, prevent accessing a wrong list->next */
 		}
@@ -3388,8 +3736,8 @@ static void ice_stop_retransmission_for_in_progress_pair(IceCandidatePair *pair,
 static void ice_conclude_waiting_frozen_and_inprogress_pairs(const IceValidCandidatePair *valid_pair, IceCheckList *cl)
 {
 	if (valid_pair->valid->is_nominated == TRUE) {
-		ice_remove_waiting_and_frozen_pairs_from_list(&cl->check_list, valid_pair->valid->local->componentID);
-		ice_remove_waiting_and_frozen_pairs_from_list(&cl->triggered_checks_queue, valid_pair->valid->local->componentID);
+		ice_remove_waiting_and_frozen_pairs_from_list(cl, &cl->check_list, valid_pair->valid->local->componentID);
+		ice_remove_waiting_and_frozen_pairs_from_list(cl, &cl->triggered_checks_queue, valid_pair->valid->local->componentID);
 		bctbx_list_for_each2(cl->check_list, (void (*)(void*,void*))ice_stop_retransmission_for_in_progress_pair, &valid_pair->valid->local->componentID);
 	}
 }
@@ -3440,6 +3788,7 @@ static void ice_pair_stop_retransmissions(IceCandidatePair *pair, IceCheckList *
 	bctbx_list_t *elem;
 	if (pair->state == ICP_InProgress) {
 		ice_pair_set_state(pair, ICP_Failed);
+		ice_timer_cancel(cl->timers, pair->retransmission_timer);
 		elem = bctbx_list_find(cl->triggered_checks_queue, pair);
 		if (elem != NULL) {
 			cl->triggered_checks_queue = bctbx_list_remove_link(cl->triggered_checks_queue, elem);
@@ -3561,6 +3910,7 @@ static void ice_conclude_processing(IceCheckList *cl, RtpSession *rtp_session)
 				ice_dump_valid_list(cl);
 				/* Initialise keepalive time. */
 				cl->keepalive_time = ice_current_time();
+				ice_check_list_schedule_keepalive(cl);
 				ice_check_list_stop_retransmissions(cl);
 				result = ice_check_list_selected_valid_remote_candidate(cl, &rtp_remote_candidate, &rtcp_remote_candidate);
 				if (result == TRUE) {
@@ -3627,11 +3977,15 @@ static void ice_check_list_restart(IceCheckList *cl)
 	cl->remote_ufrag = cl->remote_pwd = NULL;
 
 	bctbx_list_for_each(cl->stun_server_requests, (void (*)(void*))ice_stun_server_request_free);
+	ice_index_clear(&cl->indexes->transactions);
+	ice_index_clear(&cl->indexes->pair_transactions);
 	bctbx_list_for_each(cl->transaction_list, (void (*)(void*))ice_free_transaction);
 	bctbx_list_for_each(cl->foundations, (void (*)(void*))ice_free_pair_foundation);
 	bctbx_list_for_each2(cl->pairs, (void (*)(void*,void*))ice_free_candidate_pair, cl);
 	bctbx_list_for_each(cl->valid_list, (void (*)(void*))ice_free_valid_pair);
 	bctbx_list_for_each(cl->remote_candidates, (void (*)(void*))ice_free_candidate);
+	ice_index_clear(&cl->indexes->remote_candidates);
+	ice_timer_cancel(cl->timers, &cl->timers->keepalive);
 	bctbx_list_free(cl->stun_server_requests);
 	bctbx_list_free(cl->transaction_list);
 	bctbx_list_free(cl->foundations);
@@ -3756,13 +4110,25 @@ static void ice_send_stun_server_requests(IceStunServerRequest *request, IceChec
 	}
 }
 
-static void ice_handle_connectivity_check_retransmission(IceCandidatePair *pair, const CheckList_RtpSession_Time *params)
+static void ice_pair_retransmission_timer_expired(IceCheckList *cl, IceCandidatePair *pair, RtpSession *rtp_session, MSTimeSpec curtime)
 {
-	if ((pair->state == ICP_InProgress) && (ice_compare_time(params->time, pair->transmission_time) >= pair->rto)) {
-		ice_send_binding_request(params->cl, pair, params->rtp_session);
+	if (pair->state != ICP_InProgress) return;
+	if (ice_compare_time(curtime, pair->transmission_time) >= pair->rto) {
+		ice_send_binding_request(cl, pair, rtp_session);
+	} else {
+		/* The timer wheel resolution is coarser than the time comparison, wait a bit more. */
+		ice_pair_schedule_retransmission(cl, pair);
 	}
 }
 
+static void ice_check_list_keepalive_timer_expired(IceCheckList *cl, void *data, RtpSession *rtp_session, MSTimeSpec curtime)
+{
+	if (cl->state != ICL_Completed) return;
+	ice_send_keepalive_packets(cl, rtp_session);
+	cl->keepalive_time = curtime;
+	ice_check_list_schedule_keepalive(cl);
+}
+
 static int ice_find_pair_from_state(const IceCandidatePair *pair, const IceCandidatePairState *state)
 {
 	return !(pair->state == *state);
@@ -3774,15 +4140,6 @@ static void ice_check_retransmissions_pending(const IceCandidatePair *pair, bool
 		*retransmissions_pending = TRUE;
 }
 
-static void ice_check_list_retransmit_connectivity_checks(IceCheckList *cl, RtpSession *rtp_session, MSTimeSpec curtime)
-{
-	CheckList_RtpSession_Time params;
-	params.cl = cl;
-	params.rtp_session = rtp_session;
-	params.time = curtime;
-	bctbx_list_for_each2(cl->check_list, (void (*)(void*,void*))ice_handle_connectivity_check_retransmission, &params);
-}
-
 static IceCandidatePair *ice_check_list_send_triggered_check(IceCheckList *cl, RtpSession *rtp_session)
 {
 	IceCandidatePair *pair = ice_check_list_pop_triggered_check(cl);
@@ -3826,13 +4183,8 @@ void ice_check_list_process(IceCheckList *cl, RtpSession *rtp_session)
 
 	switch (cl->state) {
 		case ICL_Completed:
-			/* Handle keepalive. */
-			if (ice_compare_time(curtime, cl->keepalive_time) >= (cl->session->keepalive_timeout * 1000)) {
-				ice_send_keepalive_packets(cl, rtp_session);
-				cl->keepalive_time = curtime;
-			}
-			/* Check if some retransmissions are needed. */
-			ice_check_list_retransmit_connectivity_checks(cl, rtp_session, curtime);
+			/* Handle keepalive and check if some retransmissions are needed. */
+			ice_check_list_run_timers(cl, rtp_session, curtime);
 			if (ice_compare_time(curtime, cl->ta_time) < cl->session->ta) return;
 			cl->ta_time = curtime;
 			/* Send a triggered connectivity check if there is one. */
@@ -3846,7 +4198,7 @@ void ice_check_list_process(IceCheckList *cl, RtpSession *rtp_session)
 				if (cl->session->state == IS_Completed) return;
 			}
 			/* Check if some retransmissions are needed. */
-			ice_check_list_retransmit_connectivity_checks(cl, rtp_session, curtime);
+			ice_check_list_run_timers(cl, rtp_session, curtime);
 			if (ice_compare_time(curtime, cl->ta_time) < cl->session->ta) return;
 			cl->ta_time = curtime;
 			/* Send a triggered connectivity check if there is one. */
@@ -3988,12 +4340,14 @@ void ice_check_list_remove_rtcp_candidates(IceCheckList *cl)
 
 	while ((elem = bctbx_list_find_custom(cl->local_candidates, (bctbx_compare_func)ice_find_candidate_with_componentID, &rtcp_componentID)) != NULL) {
 		IceCandidate *candidate = (IceCandidate *)elem->data;
+		ice_index_remove_candidate(&cl->indexes->local_candidates, candidate);
 		cl->local_candidates = bctbx_list_remove(cl->local_candidates, candidate);
 		ice_free_candidate(candidate);
 	}
 	ice_remove_componentID(&cl->remote_componentIDs, rtcp_componentID);
 	while ((elem = bctbx_list_find_custom(cl->remote_candidates, (bctbx_compare_func)ice_find_candidate_with_componentID, &rtcp_componentID)) != NULL) {
 		IceCandidate *candidate = (IceCandidate *)elem->data;
+		ice_index_remove_candidate(&cl->indexes->remote_candidates, candidate);
 		cl->remote_candidates = bctbx_list_remove(cl->remote_candidates, candidate);
 		ice_free_candidate(candidate);
 	}
@@ -164,3 +164,55 @@ void ms_layout_compute(MSVideoSize wsize, MSVideoSize vsize, MSVideoSize orig_ps
 		localrect->x,localrect->y,localrect->w,localrect->h);
 */
 }
+
+/**
+ * Split a picture of size wsize into n cells of the same size, on a grid as square as possible.
+ * The last row is centered when it is not complete. Positions and sizes are even, as required by YUV420P pictures.
+ * @arg rects the n cells, from left to right and top to bottom
+**/
+void ms_layout_compute_grid(MSVideoSize wsize, int n, MSRect *rects){
+	int cols=1,rows,w,h,i;
+
+	if (n<=0) return;
+	while (cols*cols<n) cols++;
+	rows=(n+cols-1)/cols;
+	w=(wsize.width/cols) & ~0x1;
+	h=(wsize.height/rows) & ~0x1;
+	for(i=0;i<n;i++){
+		int row=i/cols;
+		int in_row=(row==rows-1) ? n-row*cols : cols;
+		int x0=((wsize.width-in_row*w)/2) & ~0x1;
+		rects[i].x=x0+(i%cols)*w;
+		rects[i].y=row*h;
+		rects[i].w=w;
+		rects[i].h=h;
+	}
+}
+
+/**
+ * Give a main cell most of a picture of size wsize, and put the n-1 other cells in a strip below it,
+ * which takes a quarter of the height.
+ * @arg rects the n cells, the first one being the main cell
+**/
+void ms_layout_compute_active_speaker(MSVideoSize wsize, int n, MSRect *rects){
+	int strip_h,w,x0,i;
+
+	if (n<=0) return;
+	rects[0].x=0;
+	rects[0].y=0;
+	rects[0].w=wsize.width & ~0x1;
+	rects[0].h=wsize.height & ~0x1;
+	if (n==1) return;
+	strip_h=(wsize.height/4) & ~0x1;
+	rects[0].h=(wsize.height-strip_h) & ~0x1;
+	/*the thumbnails keep the aspect ratio of the whole picture when they fit*/
+	w=(strip_h*wsize.width/wsize.height) & ~0x1;
+	if (w*(n-1)>wsize.width) w=(wsize.width/(n-1)) & ~0x1;
+	x0=((wsize.width-w*(n-1))/2) & ~0x1;
+	for(i=1;i<n;i++){
+		rects[i].x=x0+(i-1)*w;
+		rects[i].y=rects[0].h;
+		rects[i].w=w;
+		rects[i].h=strip_h;
+	}
+}
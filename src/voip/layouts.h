@@ -33,6 +33,10 @@ void ms_layout_center_rectangle(MSVideoSize wsize, MSVideoSize vsize, MSRect *re
 void ms_layout_compute(MSVideoSize wsize, MSVideoSize vsize, MSVideoSize orig_psize,
                        int localrect_pos, float scalefactor, MSRect *mainrect, MSRect *localrect);
 
+void ms_layout_compute_grid(MSVideoSize wsize, int n, MSRect *rects);
+
+void ms_layout_compute_active_speaker(MSVideoSize wsize, int n, MSRect *rects);
+
 #ifdef __cplusplus
 }
 #endif
@@ -118,7 +118,7 @@ void media_stream_init(MediaStream *stream, MSFactory *factory, const MSMediaStr
 	}
 }
 
-RtpSession * ms_create_duplex_rtp_session(const char* local_ip, int loc_rtp_port, int loc_rtcp_port, int mtu) {
+static RtpSession * create_rtp_session(int mtu) {
 	RtpSession *rtpr;
 
 	rtpr = rtp_session_new(RTP_SESSION_SENDRECV);
@@ -127,16 +127,32 @@ RtpSession * ms_create_duplex_rtp_session(const char* local_ip, int loc_rtp_port
 	rtp_session_set_blocking_mode(rtpr, 0);
 	rtp_session_enable_adaptive_jitter_compensation(rtpr, TRUE);
 	rtp_session_set_symmetric_rtp(rtpr, TRUE);
-	rtp_session_set_local_addr(rtpr, local_ip, loc_rtp_port, loc_rtcp_port);
 	rtp_session_signal_connect(rtpr, "timestamp_jump", (RtpCallback)rtp_session_resync, NULL);
 	rtp_session_signal_connect(rtpr, "ssrc_changed", (RtpCallback)rtp_session_resync, NULL);
 	rtp_session_set_ssrc_changed_threshold(rtpr, 0);
 	rtp_session_set_rtcp_report_interval(rtpr, 2500);	/* At the beginning of the session send more reports. */
+	return rtpr;
+}
+
+RtpSession * ms_create_duplex_rtp_session(const char* local_ip, int loc_rtp_port, int loc_rtcp_port, int mtu) {
+	RtpSession *rtpr = create_rtp_session(mtu);
+
+	rtp_session_set_local_addr(rtpr, local_ip, loc_rtp_port, loc_rtcp_port);
 	rtp_session_set_multicast_loopback(rtpr,TRUE); /*very useful, specially for testing purposes*/
 	disable_checksums(rtp_session_get_rtp_socket(rtpr));
 	return rtpr;
 }
 
+RtpSession * ms_create_shared_port_rtp_session(MSRtpSharedPort *port, int mtu) {
+	RtpSession *rtpr = create_rtp_session(mtu);
+
+	if (ms_rtp_shared_port_add_session(port, rtpr) != 0) {
+		rtp_session_destroy(rtpr);
+		return NULL;
+	}
+	return rtpr;
+}
+
 int media_stream_join_multicast_group(MediaStream *stream, const char *ip){
 	return rtp_session_join_multicast_group(stream->sessions.rtp_session,ip);
 }
@@ -158,6 +174,9 @@ const char * media_stream_type_str(MediaStream *stream) {
 }
 
 void ms_media_stream_sessions_uninit(MSMediaStreamSessions *sessions){
+	if (sessions->dtls_context != NULL) {
+		ms_dtls_srtp_wait_for_handshake_jobs(sessions->dtls_context);
+	}
 	if (sessions->srtp_context) {
 		ms_srtp_context_delete(sessions->srtp_context);
 		sessions->srtp_context=NULL;
@@ -242,6 +261,10 @@ void media_stream_enable_dtls(MediaStream *stream, MSDtlsSrtpParams *params){
 	if (stream->sessions.dtls_context==NULL) {
 		ms_message("Start DTLS media stream context in stream session [%p]", &(stream->sessions));
 		stream->sessions.dtls_context=ms_dtls_srtp_context_new(&(stream->sessions), params);
+		/* keep the cryptographic operations of the handshake out of the ticker thread */
+		if (stream->sessions.dtls_context != NULL) {
+			ms_dtls_srtp_set_worker_pool(stream->sessions.dtls_context, ms_factory_get_dtls_worker_pool(stream->factory));
+		}
 	}
 }
 
@@ -502,6 +525,13 @@ MSCryptoSuite ms_crypto_suite_build_from_name_params(const MSCryptoSuiteNamePara
 		if (parameters && strstr(parameters,"UNENCRYPTED_SRTP")) goto error;
 		if (parameters && strstr(parameters,"UNAUTHENTICATED_SRTP")) goto error;
 		return MS_AES_256_SHA1_80;
+	}else if ( keywordcmp ("AEAD_AES_128_GCM", name) == 0 ){
+		/*the authentication of the AEAD suites cannot be disabled (RFC 7714), and unencrypted packets are not supported*/
+		if (parameters && (strstr(parameters,"UNENCRYPTED_SRTP") || strstr(parameters,"UNAUTHENTICATED_SRTP"))) goto error;
+		return MS_AEAD_AES_128_GCM;
+	}else if ( keywordcmp ("AEAD_AES_256_GCM", name) == 0 ){
+		if (parameters && (strstr(parameters,"UNENCRYPTED_SRTP") || strstr(parameters,"UNAUTHENTICATED_SRTP"))) goto error;
+		return MS_AEAD_AES_256_GCM;
 	}
 error:
 	ms_error("Unsupported crypto suite '%s' with parameters '%s'",name, parameters ? parameters : "");
@@ -534,6 +564,12 @@ int ms_crypto_suite_to_name_params(MSCryptoSuite cs, MSCryptoSuiteNameParams *pa
 		case MS_AES_256_SHA1_32:
 			params->name= "AES_256_CM_HMAC_SHA1_32";
 			break;
+		case MS_AEAD_AES_128_GCM:
+			params->name="AEAD_AES_128_GCM";
+			break;
+		case MS_AEAD_AES_256_GCM:
+			params->name="AEAD_AES_256_GCM";
+			break;
 	}
 	if (params->name==NULL) return -1;
 	return 0;
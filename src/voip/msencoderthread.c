@@ -0,0 +1,164 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "mediastreamer2/msencoderthread.h"
+
+typedef struct _MSEncoderThreadItem{
+	mblk_t *frame;
+	uint64_t frame_time;
+	uint64_t push_time;
+}MSEncoderThreadItem;
+
+struct _MSEncoderThread{
+	MSFilter *f;
+	MSEncoderThreadFunc func;
+	ms_mutex_t lock;
+	ms_cond_t cond;
+	ms_thread_t thread;
+	MSEncoderThreadItem *pending; /*circular buffer of max_pending frames*/
+	int max_pending;
+	int first;
+	int npending;
+	MSQueue output; /*packets waiting to be collected by the ticker thread*/
+	unsigned int encoded_frames;
+	unsigned int dropped_frames;
+	uint64_t cumulated_latency;
+	uint64_t max_latency;
+	bool_t run;
+};
+
+static void *ms_encoder_thread_run(void *arg){
+	MSEncoderThread *obj = (MSEncoderThread*)arg;
+	MSEncoderThreadItem item;
+	MSQueue encoded;
+	mblk_t *m;
+	uint64_t latency;
+
+	ms_queue_init(&encoded);
+	ms_mutex_lock(&obj->lock);
+	while(obj->run){
+		if (obj->npending == 0){
+			ms_cond_wait(&obj->cond, &obj->lock);
+			continue;
+		}
+		item = obj->pending[obj->first];
+		obj->first = (obj->first + 1) % obj->max_pending;
+		obj->npending--;
+		ms_mutex_unlock(&obj->lock);
+
+		ms_filter_lock(obj->f);
+		obj->func(obj->f, item.frame, item.frame_time, &encoded);
+		ms_filter_unlock(obj->f);
+		freemsg(item.frame);
+		latency = ms_get_cur_time_ms() - item.push_time;
+
+		ms_mutex_lock(&obj->lock);
+		while((m = ms_queue_get(&encoded)) != NULL){
+			ms_queue_put(&obj->output, m);
+		}
+		obj->encoded_frames++;
+		obj->cumulated_latency += latency;
+		if (latency > obj->max_latency) obj->max_latency = latency;
+	}
+	ms_mutex_unlock(&obj->lock);
+	return NULL;
+}
+
+MSEncoderThread *ms_encoder_thread_new(MSFilter *f, MSEncoderThreadFunc func, int max_pending){
+	MSEncoderThread *obj = ms_new0(MSEncoderThread, 1);
+
+	obj->f = f;
+	obj->func = func;
+	obj->max_pending = MAX(max_pending, 1);
+	obj->pending = ms_new0(MSEncoderThreadItem, obj->max_pending);
+	ms_queue_init(&obj->output);
+	ms_mutex_init(&obj->lock, NULL);
+	ms_cond_init(&obj->cond, NULL);
+	obj->run = TRUE;
+	if (ms_thread_create(&obj->thread, NULL, ms_encoder_thread_run, obj) != 0){
+		ms_error("MSEncoderThread: could not create the encoder thread of filter %s [%p]", f->desc->name, f);
+		ms_mutex_destroy(&obj->lock);
+		ms_cond_destroy(&obj->cond);
+		ms_free(obj->pending);
+		ms_free(obj);
+		return NULL;
+	}
+	ms_message("MSEncoderThread [%p] started for filter %s [%p]", obj, f->desc->name, f);
+	return obj;
+}
+
+void ms_encoder_thread_push(MSEncoderThread *obj, mblk_t *frame, uint64_t frame_time){
+	MSEncoderThreadItem *item;
+
+	ms_mutex_lock(&obj->lock);
+	if (obj->npending == obj->max_pending){
+		freemsg(obj->pending[obj->first].frame);
+		obj->first = (obj->first + 1) % obj->max_pending;
+		obj->npending--;
+		obj->dropped_frames++;
+	}
+	item = &obj->pending[(obj->first + obj->npending) % obj->max_pending];
+	item->frame = frame;
+	item->frame_time = frame_time;
+	item->push_time = ms_get_cur_time_ms();
+	obj->npending++;
+	ms_cond_signal(&obj->cond);
+	ms_mutex_unlock(&obj->lock);
+}
+
+void ms_encoder_thread_collect(MSEncoderThread *obj, MSQueue *output){
+	mblk_t *m;
+
+	ms_mutex_lock(&obj->lock);
+	while((m = ms_queue_get(&obj->output)) != NULL){
+		ms_queue_put(output, m);
+	}
+	ms_mutex_unlock(&obj->lock);
+}
+
+void ms_encoder_thread_get_stats(MSEncoderThread *obj, MSVideoEncoderAsyncStats *stats){
+	ms_mutex_lock(&obj->lock);
+	stats->encoded_frames = obj->encoded_frames;
+	stats->dropped_frames = obj->dropped_frames;
+	stats->mean_latency = obj->encoded_frames ? (float)obj->cumulated_latency / (float)obj->encoded_frames : 0;
+	stats->max_latency = (float)obj->max_latency;
+	ms_mutex_unlock(&obj->lock);
+}
+
+void ms_encoder_thread_destroy(MSEncoderThread *obj){
+	ms_mutex_lock(&obj->lock);
+	obj->run = FALSE;
+	ms_cond_signal(&obj->cond);
+	ms_mutex_unlock(&obj->lock);
+	ms_thread_join(obj->thread, NULL);
+
+	ms_message("MSEncoderThread [%p] stopped: %u frames encoded, %u dropped, mean latency %f ms", obj,
+		obj->encoded_frames, obj->dropped_frames,
+		obj->encoded_frames ? (float)obj->cumulated_latency / (float)obj->encoded_frames : 0.f);
+	while(obj->npending > 0){
+		freemsg(obj->pending[obj->first].frame);
+		obj->first = (obj->first + 1) % obj->max_pending;
+		obj->npending--;
+	}
+	ms_queue_flush(&obj->output);
+	ms_mutex_destroy(&obj->lock);
+	ms_cond_destroy(&obj->cond);
+	ms_free(obj->pending);
+	ms_free(obj);
+}
@@ -0,0 +1,288 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /*for sendmmsg()*/
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "msrtpendpoint.h"
+
+#ifdef HAVE_SENDMMSG
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#endif
+
+/*maximum number of messages given to a single sendmmsg() call (UIO_MAXIOV on linux)*/
+#define MAX_MESSAGES_PER_CALL 1024
+
+typedef struct _BatchedPacket{
+	mblk_t *m;
+	MSRtpEndpoint *ep;
+	ortp_socket_t sockfd;
+	int order;
+	socklen_t addrlen;
+	struct sockaddr_storage addr;
+}BatchedPacket;
+
+struct _MSRtpSendBatcher{
+	MSTicker *ticker;
+	bctbx_list_t *endpoints; /*list of MSRtpEndpoint*/
+	BatchedPacket *packets;
+	int npackets;
+	int max_packets;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr *msgs;
+	int max_msgs;
+	struct iovec *iovs;
+	int max_iovs;
+#endif
+	MSRtpSendBatcherStats stats;
+};
+
+static int compare_packets(const void *a, const void *b){
+	const BatchedPacket *pa=(const BatchedPacket*)a;
+	const BatchedPacket *pb=(const BatchedPacket*)b;
+	if (pa->sockfd!=pb->sockfd) return pa->sockfd<pb->sockfd ? -1 : 1;
+	/*keep the order in which the packets were sent on a given socket*/
+	return pa->order-pb->order;
+}
+
+#ifdef HAVE_SENDMMSG
+
+static void send_packets(MSRtpSendBatcher *obj, BatchedPacket *packets, int count){
+	int i;
+	int niovs=0;
+	int done=0;
+	int errors=0;
+	int last_errno=0;
+	mblk_t *m;
+
+	for(i=0;i<count;++i){
+		for(m=packets[i].m;m!=NULL;m=m->b_cont) niovs++;
+	}
+	if (count>obj->max_msgs){
+		obj->max_msgs=count;
+		obj->msgs=ms_realloc(obj->msgs,obj->max_msgs*sizeof(struct mmsghdr));
+	}
+	if (niovs>obj->max_iovs){
+		obj->max_iovs=niovs;
+		obj->iovs=ms_realloc(obj->iovs,obj->max_iovs*sizeof(struct iovec));
+	}
+	/*the fragments of the messages are given as they are, without being copied into a contiguous buffer*/
+	niovs=0;
+	for(i=0;i<count;++i){
+		struct msghdr *hdr=&obj->msgs[i].msg_hdr;
+		memset(hdr,0,sizeof(struct msghdr));
+		hdr->msg_name=packets[i].addrlen>0 ? &packets[i].addr : NULL;
+		hdr->msg_namelen=packets[i].addrlen;
+		hdr->msg_iov=&obj->iovs[niovs];
+		for(m=packets[i].m;m!=NULL;m=m->b_cont){
+			obj->iovs[niovs].iov_base=m->b_rptr;
+			obj->iovs[niovs].iov_len=m->b_wptr-m->b_rptr;
+			niovs++;
+			hdr->msg_iovlen++;
+		}
+	}
+	while(done<count){
+		int n=count-done;
+		int ret;
+		if (n>MAX_MESSAGES_PER_CALL) n=MAX_MESSAGES_PER_CALL;
+		ret=sendmmsg(packets[0].sockfd,&obj->msgs[done],n,0);
+		obj->stats.syscalls++;
+		if (ret<0){
+			if (errno==EINTR) continue;
+			/*the first message could not be sent, skip it and go on with the next ones*/
+			last_errno=errno;
+			errors++;
+			ret=1;
+		}
+		done+=ret;
+	}
+	if (errors>0){
+		ms_warning("MSRtpSendBatcher[%p]: %i packets could not be sent on socket %i: %s",obj,errors,(int)packets[0].sockfd,strerror(last_errno));
+		obj->stats.errors+=errors;
+	}
+}
+
+#else
+
+static void send_packets(MSRtpSendBatcher *obj, BatchedPacket *packets, int count){
+	int i;
+	for(i=0;i<count;++i){
+		BatchedPacket *p=&packets[i];
+		int ret=rtp_session_sendto(p->ep->session,p->ep->is_rtp,p->m,0,p->addrlen>0 ? (struct sockaddr*)&p->addr : NULL,p->addrlen);
+		obj->stats.syscalls++;
+		if (ret<0) obj->stats.errors++;
+	}
+}
+
+#endif
+
+/*called by the ticker thread at the end of every tick*/
+static void flush(MSTicker *ticker, void *data){
+	MSRtpSendBatcher *obj=(MSRtpSendBatcher*)data;
+	int count=obj->npackets;
+	int i,j;
+
+	if (count==0) return;
+	qsort(obj->packets,count,sizeof(BatchedPacket),compare_packets);
+	for(i=0;i<count;i=j){
+		for(j=i+1;j<count && obj->packets[j].sockfd==obj->packets[i].sockfd;++j);
+		send_packets(obj,&obj->packets[i],j-i);
+	}
+	for(i=0;i<count;++i) freemsg(obj->packets[i].m);
+	obj->npackets=0;
+	obj->stats.packets+=count;
+	obj->stats.flushes++;
+	obj->stats.last_flush_size=count;
+	if (count>obj->stats.max_flush_size) obj->stats.max_flush_size=count;
+}
+
+static void drop_endpoint_packets(MSRtpSendBatcher *obj, MSRtpEndpoint *ep){
+	int i,kept=0;
+	for(i=0;i<obj->npackets;++i){
+		if (obj->packets[i].ep==ep){
+			freemsg(obj->packets[i].m);
+		}else{
+			obj->packets[kept++]=obj->packets[i];
+		}
+	}
+	obj->npackets=kept;
+}
+
+int ms_rtp_send_batcher_send(MSRtpSendBatcher *obj, MSRtpEndpoint *ep, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	ortp_socket_t sockfd=ms_rtp_endpoint_get_socket(ep);
+	BatchedPacket *p;
+
+	/*
+	 * Only the packets sent by the ticker thread can be queued, the queue being flushed by this thread without locking.
+	 * The packets whose source address is chosen by the sender cannot be given to sendmmsg() as they are.
+	 */
+	if (sockfd==(ortp_socket_t)-1 || flags!=0 || tolen>(socklen_t)sizeof(struct sockaddr_storage)
+		|| m->recv_addr.family!=AF_UNSPEC || (unsigned long)ms_thread_self()!=obj->ticker->thread_id){
+		return rtp_session_sendto(ep->session,ep->is_rtp,m,flags,to,tolen);
+	}
+	if (obj->npackets==obj->max_packets){
+		obj->max_packets=obj->max_packets>0 ? 2*obj->max_packets : 64;
+		obj->packets=ms_realloc(obj->packets,obj->max_packets*sizeof(BatchedPacket));
+	}
+	p=&obj->packets[obj->npackets];
+	/*the caller frees the message once this function returns*/
+	p->m=dupmsg(m);
+	p->ep=ep;
+	p->sockfd=sockfd;
+	p->order=obj->npackets;
+	p->addrlen=to ? tolen : 0;
+	if (p->addrlen>0) memcpy(&p->addr,to,tolen);
+	obj->npackets++;
+	return (int)msgdsize(m);
+}
+
+void ms_rtp_send_batcher_forget_endpoint(MSRtpSendBatcher *obj, MSRtpEndpoint *ep){
+	ms_warning("MSRtpSendBatcher[%p]: session [%p] destroyed while being batched",obj,ep->session);
+	ms_mutex_lock(&obj->ticker->lock);
+	drop_endpoint_packets(obj,ep);
+	obj->endpoints=bctbx_list_remove(obj->endpoints,ep);
+	ep->batcher=NULL;
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+/*to be called with the ticker lock held, so that the ticker thread is not using the endpoint*/
+static void remove_endpoint(MSRtpSendBatcher *obj, MSRtpEndpoint *ep){
+	obj->endpoints=bctbx_list_remove(obj->endpoints,ep);
+	ep->batcher=NULL;
+	ms_rtp_endpoint_release(ep);
+}
+
+MSRtpSendBatcher *ms_rtp_send_batcher_new(MSTicker *ticker){
+	MSRtpSendBatcher *obj=ms_new0(MSRtpSendBatcher,1);
+	obj->ticker=ticker;
+	ms_ticker_add_tick_end_callback(ticker,flush,obj);
+	return obj;
+}
+
+int ms_rtp_send_batcher_add_session(MSRtpSendBatcher *obj, RtpSession *session){
+	MSRtpEndpoint *rtp_ep;
+	MSRtpEndpoint *rtcp_ep;
+	int ret=0;
+
+	ms_mutex_lock(&obj->ticker->lock);
+	rtp_ep=ms_rtp_endpoint_get(session,TRUE,TRUE);
+	rtcp_ep=ms_rtp_endpoint_get(session,FALSE,TRUE);
+	if (rtp_ep==NULL || rtcp_ep==NULL){
+		ms_error("MSRtpSendBatcher[%p]: session [%p] has no transport or already has a transport endpoint, it cannot be batched",obj,session);
+		ret=-1;
+	}else if (rtp_ep->batcher!=NULL || rtcp_ep->batcher!=NULL){
+		ms_error("MSRtpSendBatcher[%p]: session [%p] is already batched",obj,session);
+		ret=-1;
+	}
+	if (ret==0){
+		rtp_ep->batcher=obj;
+		rtcp_ep->batcher=obj;
+		obj->endpoints=bctbx_list_append(obj->endpoints,rtp_ep);
+		obj->endpoints=bctbx_list_append(obj->endpoints,rtcp_ep);
+	}else{
+		if (rtp_ep) ms_rtp_endpoint_release(rtp_ep);
+		if (rtcp_ep) ms_rtp_endpoint_release(rtcp_ep);
+	}
+	ms_mutex_unlock(&obj->ticker->lock);
+	return ret;
+}
+
+void ms_rtp_send_batcher_remove_session(MSRtpSendBatcher *obj, RtpSession *session){
+	bctbx_list_t *elem,*next;
+
+	ms_mutex_lock(&obj->ticker->lock);
+	flush(obj->ticker,obj);
+	for(elem=obj->endpoints;elem!=NULL;elem=next){
+		MSRtpEndpoint *ep=(MSRtpEndpoint*)elem->data;
+		next=elem->next;
+		if (ep->session==session) remove_endpoint(obj,ep);
+	}
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+void ms_rtp_send_batcher_get_stats(MSRtpSendBatcher *obj, MSRtpSendBatcherStats *stats){
+	ms_mutex_lock(&obj->ticker->lock);
+	*stats=obj->stats;
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+void ms_rtp_send_batcher_destroy(MSRtpSendBatcher *obj){
+	ms_ticker_remove_tick_end_callback(obj->ticker,flush,obj);
+	ms_mutex_lock(&obj->ticker->lock);
+	flush(obj->ticker,obj);
+	while(obj->endpoints!=NULL) remove_endpoint(obj,(MSRtpEndpoint*)obj->endpoints->data);
+	ms_mutex_unlock(&obj->ticker->lock);
+	if (obj->stats.syscalls>0){
+		ms_message("MSRtpSendBatcher[%p]: %llu packets sent with %llu system calls, at most %i per tick",obj,
+			(unsigned long long)obj->stats.packets,(unsigned long long)obj->stats.syscalls,obj->stats.max_flush_size);
+	}
+	if (obj->packets) ms_free(obj->packets);
+#ifdef HAVE_SENDMMSG
+	if (obj->msgs) ms_free(obj->msgs);
+	if (obj->iovs) ms_free(obj->iovs);
+#endif
+	ms_free(obj);
+}
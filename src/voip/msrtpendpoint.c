@@ -0,0 +1,131 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "msrtpendpoint.h"
+
+static int ms_rtp_endpoint_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
+	MSRtpEndpoint *ep=(MSRtpEndpoint*)t->data;
+	if (ep->shared_port && ms_rtp_shared_port_register_destination(ep->shared_port,ep,to,tolen)!=0){
+		ms_warning("MSRtpEndpoint: session [%p] sends to a new destination outside of the ticker thread, the packets coming from it will be demultiplexed by SSRC only",ep->session);
+	}
+	if (ep->retransmission) ms_rtp_retransmission_store(ep->retransmission,m);
+	if (ep->batcher) return ms_rtp_send_batcher_send(ep->batcher,ep,m,flags,to,tolen);
+	return rtp_session_sendto(ep->session,ep->is_rtp,m,flags,to,tolen);
+}
+
+static int ms_rtp_endpoint_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen){
+	MSRtpEndpoint *ep=(MSRtpEndpoint*)t->data;
+	int ret;
+	if (ep->multiplexer) ret=ms_rtp_recv_multiplexer_recv(ep->multiplexer,ep,m,flags,from,fromlen);
+	else if (ep->shared_port) ret=ms_rtp_shared_port_recv(ep->shared_port,ep,m,flags,from,fromlen);
+	else ret=rtp_session_recvfrom(ep->session,ep->is_rtp,m,flags,from,fromlen);
+	/*the packet is written at the end of the message, which the session moves once it is read*/
+	if (ret>0 && ep->retransmission) ms_rtp_retransmission_on_receive(ep->retransmission,m->b_wptr,ret);
+	if (ret>0 && ep->delay_gradient_analyzer) ms_delay_gradient_qos_analyzer_on_receive(ep->delay_gradient_analyzer,m,ret);
+	return ret;
+}
+
+static void ms_rtp_endpoint_close(RtpTransport *t){
+}
+
+static void ms_rtp_endpoint_destroy(RtpTransport *t){
+	MSRtpEndpoint *ep=(MSRtpEndpoint*)t->data;
+	/*the session is destroyed without having been removed from the batcher, multiplexer, shared port or retransmission handler,
+	or while the delay gradient analyzer is still attached to it*/
+	if (ep->batcher) ms_rtp_send_batcher_forget_endpoint(ep->batcher,ep);
+	if (ep->multiplexer) ms_rtp_recv_multiplexer_forget_endpoint(ep->multiplexer,ep);
+	if (ep->shared_port) ms_rtp_shared_port_forget_endpoint(ep->shared_port,ep);
+	if (ep->retransmission) ms_rtp_retransmission_forget_endpoint(ep->retransmission,ep);
+	if (ep->delay_gradient_analyzer) ms_delay_gradient_qos_analyzer_forget_endpoint(ep->delay_gradient_analyzer,ep);
+	flushq(&ep->recv_queue,0);
+	ms_free(ep);
+	ms_free(t);
+}
+
+MSRtpEndpoint *ms_rtp_endpoint_get(RtpSession *session, bool_t is_rtp, bool_t create){
+	RtpTransport *meta=NULL;
+	RtpTransport *t;
+	MSRtpEndpoint *ep;
+
+	if (is_rtp) rtp_session_get_transports(session,&meta,NULL);
+	else rtp_session_get_transports(session,NULL,&meta);
+	if (meta==NULL) return NULL;
+	t=meta_rtp_transport_get_endpoint(meta);
+	if (t!=NULL){
+		return t->t_sendto==ms_rtp_endpoint_sendto ? (MSRtpEndpoint*)t->data : NULL;
+	}
+	if (!create) return NULL;
+	t=ms_new0(RtpTransport,1);
+	ep=ms_new0(MSRtpEndpoint,1);
+	ep->transport=t;
+	ep->meta_transport=meta;
+	ep->session=session;
+	ep->is_rtp=is_rtp;
+	ep->polled_socket=(ortp_socket_t)-1;
+	qinit(&ep->recv_queue);
+	t->t_getsocket=NULL;
+	t->t_sendto=ms_rtp_endpoint_sendto;
+	t->t_recvfrom=ms_rtp_endpoint_recvfrom;
+	t->t_close=ms_rtp_endpoint_close;
+	t->t_destroy=ms_rtp_endpoint_destroy;
+	t->data=ep;
+	meta_rtp_transport_set_endpoint(meta,t);
+	return ep;
+}
+
+void ms_rtp_endpoint_release(MSRtpEndpoint *ep){
+	if (ep->batcher!=NULL || ep->multiplexer!=NULL || ep->shared_port!=NULL || ep->retransmission!=NULL
+		|| ep->delay_gradient_analyzer!=NULL) return;
+	meta_rtp_transport_set_endpoint(ep->meta_transport,NULL);
+	ms_rtp_endpoint_destroy(ep->transport);
+}
+
+ortp_socket_t ms_rtp_endpoint_get_socket(const MSRtpEndpoint *ep){
+	return ep->is_rtp ? rtp_session_get_rtp_socket(ep->session) : rtp_session_get_rtcp_socket(ep->session);
+}
+
+int ms_rtp_endpoint_read_queue(MSRtpEndpoint *ep, mblk_t *msg, struct sockaddr *from, socklen_t *fromlen){
+	mblk_t *m=getq(&ep->recv_queue);
+	int len;
+
+	if (m==NULL){
+#ifdef _WIN32
+		WSASetLastError(WSAEWOULDBLOCK);
+#else
+		errno=EWOULDBLOCK;
+#endif
+		return -1;
+	}
+	len=(int)(m->b_wptr-m->b_rptr);
+	if (len>(int)(msg->b_datap->db_lim-msg->b_wptr)) len=(int)(msg->b_datap->db_lim-msg->b_wptr);
+	memcpy(msg->b_wptr,m->b_rptr,len);
+	mblk_meta_copy(m,msg);
+	/*not copied by mblk_meta_copy()*/
+	msg->recv_addr=m->recv_addr;
+	if (from!=NULL && fromlen!=NULL){
+		if (*fromlen>m->net_addrlen) *fromlen=m->net_addrlen;
+		memcpy(from,&m->net_addr,*fromlen);
+	}
+	freemsg(m);
+	return len;
+}
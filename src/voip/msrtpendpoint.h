@@ -0,0 +1,98 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef msrtpendpoint_h
+#define msrtpendpoint_h
+
+#include "mediastreamer2/msrtpbatcher.h"
+#include "mediastreamer2/msrtpmultiplexer.h"
+#include "mediastreamer2/msrtpsharedport.h"
+#include "mediastreamer2/msrtpretransmission.h"
+#include "mediastreamer2/bitratecontrol.h"
+
+/*
+ * The RtpTransport endpoint installed on the RTP or RTCP meta transport of a session by the MSRtpSendBatcher, the
+ * MSRtpRecvMultiplexer, the MSRtpSharedPort, the MSRtpRetransmission and the delay gradient MSQosAnalyzer. It is
+ * shared by all of them, so that the sending of a session can be batched while its receiving is multiplexed or
+ * demultiplexed from a shared port.
+ */
+typedef struct _MSRtpEndpoint{
+	RtpTransport *transport;
+	RtpTransport *meta_transport;
+	RtpSession *session;
+	MSRtpSendBatcher *batcher;
+	MSRtpRecvMultiplexer *multiplexer;
+	MSRtpSharedPort *shared_port;
+	MSRtpRetransmission *retransmission;
+	MSQosAnalyzer *delay_gradient_analyzer; /*a reference owned by the endpoint*/
+	queue_t recv_queue; /*packets read by the multiplexer or the shared port that the session has not read yet*/
+	ortp_socket_t polled_socket; /*the socket registered by the multiplexer*/
+	int idle_ticks;
+	struct sockaddr_storage remote_addr; /*the last destination, registered by the shared port*/
+	socklen_t remote_addrlen;
+	uint32_t learnt_ssrc; /*the SSRC of the remote party learnt by the shared port*/
+	bool_t ssrc_learnt;
+	bool_t is_rtp;
+}MSRtpEndpoint;
+
+/*
+ * Returns the endpoint of the RTP or RTCP transport of the session, creating and installing it if needed and create
+ * is TRUE. Returns NULL if the transport has another kind of endpoint.
+ */
+MSRtpEndpoint *ms_rtp_endpoint_get(RtpSession *session, bool_t is_rtp, bool_t create);
+
+/*uninstalls and destroys the endpoint if none of its users remains*/
+void ms_rtp_endpoint_release(MSRtpEndpoint *ep);
+
+ortp_socket_t ms_rtp_endpoint_get_socket(const MSRtpEndpoint *ep);
+
+/*
+ * Hands over to the session the next packet of the receive queue of the endpoint, returns its size or -1 with
+ * EWOULDBLOCK if the queue is empty.
+ */
+int ms_rtp_endpoint_read_queue(MSRtpEndpoint *ep, mblk_t *msg, struct sockaddr *from, socklen_t *fromlen);
+
+/*called by the endpoint when the session sends a packet, returns the number of bytes sent or queued*/
+int ms_rtp_send_batcher_send(MSRtpSendBatcher *obj, MSRtpEndpoint *ep, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen);
+
+/*called by the endpoint when the session reads a packet, returns the size of the packet or -1 with EWOULDBLOCK*/
+int ms_rtp_recv_multiplexer_recv(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen);
+int ms_rtp_shared_port_recv(MSRtpSharedPort *obj, MSRtpEndpoint *ep, mblk_t *m, int flags, struct sockaddr *from, socklen_t *fromlen);
+
+/*
+ * Called by the endpoint before the session sends a packet to the given destination. Returns -1 if the destination is
+ * new and the caller is not the ticker thread, in which case it is not registered.
+ */
+int ms_rtp_shared_port_register_destination(MSRtpSharedPort *obj, MSRtpEndpoint *ep, const struct sockaddr *to, socklen_t tolen);
+
+/*called by the endpoint of the RTP transport when the session sends a packet, and when it has read one*/
+void ms_rtp_retransmission_store(MSRtpRetransmission *obj, mblk_t *m);
+void ms_rtp_retransmission_on_receive(MSRtpRetransmission *obj, const uint8_t *data, int len);
+
+/*called by the endpoint of the RTP transport when the session has read a packet, which is written at the end of the message*/
+void ms_delay_gradient_qos_analyzer_on_receive(MSQosAnalyzer *obj, const mblk_t *m, int len);
+
+/*called when the session is destroyed while still using the endpoint*/
+void ms_rtp_send_batcher_forget_endpoint(MSRtpSendBatcher *obj, MSRtpEndpoint *ep);
+void ms_rtp_recv_multiplexer_forget_endpoint(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep);
+void ms_rtp_shared_port_forget_endpoint(MSRtpSharedPort *obj, MSRtpEndpoint *ep);
+void ms_rtp_retransmission_forget_endpoint(MSRtpRetransmission *obj, MSRtpEndpoint *ep);
+void ms_delay_gradient_qos_analyzer_forget_endpoint(MSQosAnalyzer *obj, MSRtpEndpoint *ep);
+
+#endif
@@ -0,0 +1,568 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/msrtpfec.h"
+
+/*the FEC header of RFC 5109 followed by a level 0 header with a 16 bits mask*/
+#define FEC_HEADER_SIZE 10
+#define FEC_LEVEL_HEADER_SIZE 4
+#define FEC_MASK_SPAN 16
+
+#define MIN_GROUP_SIZE 2
+#define MAX_GROUP_SIZE FEC_MASK_SPAN
+#define DEFAULT_GROUP_SIZE 8
+/*below this loss rate no FEC packet is sent*/
+#define MIN_LOSS_RATE 1.0f
+/*the loss rate reported by the remote party is estimated as the MSQosAnalyzer does*/
+#define LOSS_RATE_MIN_INTERVAL 60
+#define LOSS_RATE_MIN_TIME 3000
+
+/*the media packets received are kept in a ring buffer until the FEC packets protecting them arrive*/
+#define HISTORY_SIZE 64
+#define MAX_PENDING_FEC 8
+/*a FEC packet still missing several packets is given up once the stream is this far beyond it*/
+#define MAX_FEC_AGE 32
+
+typedef struct _ReceivedPacket{
+	mblk_t *m;
+	uint16_t seq;
+}ReceivedPacket;
+
+struct _MSRtpFec{
+	RtpSession *session;
+	RtpTransportModifier *modifier; /*owned by the RTP transport of the session*/
+	OrtpLossRateEstimator *lre;
+	ms_mutex_t lock;
+	int payload_type;
+	int group_size;
+	/*sending side*/
+	uint8_t *xor_buf;
+	int xor_capacity;
+	int xor_len;
+	int count;
+	uint16_t base_seq;
+	uint16_t mask;
+	uint16_t fec_seq;
+	uint32_t fec_ssrc;
+	uint32_t group_ssrc;
+	uint32_t last_ts;
+	uint32_t ts_recovery;
+	uint16_t length_recovery;
+	uint8_t byte0_recovery;
+	uint8_t byte1_recovery;
+	/*receiving side*/
+	ReceivedPacket history[HISTORY_SIZE];
+	mblk_t *pending[MAX_PENDING_FEC];
+	int npending;
+	uint32_t recv_ssrc;
+	uint16_t highest_seq;
+	bool_t receiving;
+	MSRtpFecStats stats;
+};
+
+static uint16_t get_uint16(const uint8_t *p){
+	return (uint16_t)((p[0]<<8) | p[1]);
+}
+
+static uint32_t get_uint32(const uint8_t *p){
+	return ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | (uint32_t)p[3];
+}
+
+static void put_uint16(uint8_t *p, uint16_t val){
+	p[0]=(uint8_t)(val>>8);
+	p[1]=(uint8_t)(val & 0xff);
+}
+
+static void put_uint32(uint8_t *p, uint32_t val){
+	p[0]=(uint8_t)(val>>24);
+	p[1]=(uint8_t)((val>>16) & 0xff);
+	p[2]=(uint8_t)((val>>8) & 0xff);
+	p[3]=(uint8_t)(val & 0xff);
+}
+
+/*tells whether the datagram is a RTP packet, and not a RTCP packet multiplexed with RTP, a STUN or a DTLS packet*/
+static bool_t is_rtp_packet(const uint8_t *data, int len){
+	return len>=RTP_FIXED_HEADER_SIZE && (data[0]>>6)==2 && (data[1]<192 || data[1]>223);
+}
+
+static void xor_bytes(uint8_t *dst, const uint8_t *src, int len){
+	int i;
+	for(i=0;i<len;++i) dst[i]^=src[i];
+}
+
+/*
+ * Sending side
+ */
+
+static void reset_group(MSRtpFec *obj){
+	obj->count=0;
+	obj->mask=0;
+	obj->xor_len=0;
+	obj->ts_recovery=0;
+	obj->length_recovery=0;
+	obj->byte0_recovery=0;
+	obj->byte1_recovery=0;
+}
+
+static void add_to_group(MSRtpFec *obj, mblk_t *m){
+	const uint8_t *header=m->b_rptr;
+	uint16_t seq=get_uint16(header+2);
+	int len=(int)msgdsize(m)-RTP_FIXED_HEADER_SIZE;
+	int offset=0;
+	mblk_t *part;
+
+	if (obj->count==0){
+		obj->base_seq=seq;
+		obj->group_ssrc=get_uint32(header+8);
+	}
+	if (len>obj->xor_capacity){
+		obj->xor_buf=ms_realloc(obj->xor_buf,len);
+		obj->xor_capacity=len;
+	}
+	if (len>obj->xor_len){
+		memset(obj->xor_buf+obj->xor_len,0,len-obj->xor_len);
+		obj->xor_len=len;
+	}
+	/*the RTP header is protected field by field, the rest of the packet as a whole*/
+	obj->byte0_recovery^=header[0];
+	obj->byte1_recovery^=header[1];
+	obj->ts_recovery^=get_uint32(header+4);
+	obj->length_recovery^=(uint16_t)len;
+	obj->last_ts=get_uint32(header+4);
+	for(part=m;part!=NULL;part=part->b_cont){
+		const uint8_t *data=part->b_rptr;
+		int size=(int)(part->b_wptr-part->b_rptr);
+		if (part==m){
+			data+=RTP_FIXED_HEADER_SIZE;
+			size-=RTP_FIXED_HEADER_SIZE;
+		}
+		if (size<=0) continue;
+		xor_bytes(obj->xor_buf+offset,data,size);
+		offset+=size;
+	}
+	obj->mask|=(uint16_t)(1<<(FEC_MASK_SPAN-1-(uint16_t)(seq-obj->base_seq)));
+	obj->count++;
+}
+
+static mblk_t *make_fec_packet(MSRtpFec *obj){
+	mblk_t *fec=allocb(RTP_FIXED_HEADER_SIZE+FEC_HEADER_SIZE+FEC_LEVEL_HEADER_SIZE+obj->xor_len,0);
+	uint8_t *p=fec->b_wptr;
+
+	p[0]=0x80;
+	p[1]=(uint8_t)obj->payload_type;
+	put_uint16(p+2,obj->fec_seq++);
+	put_uint32(p+4,obj->last_ts);
+	/*a separate stream (RFC 5109 section 9): the receiver rebuilds the packets with the SSRC of the media stream*/
+	put_uint32(p+8,obj->fec_ssrc);
+	p+=RTP_FIXED_HEADER_SIZE;
+	/*E and L are zero: no extended mask, one protection level*/
+	p[0]=obj->byte0_recovery & 0x3f;
+	p[1]=obj->byte1_recovery;
+	put_uint16(p+2,obj->base_seq);
+	put_uint32(p+4,obj->ts_recovery);
+	put_uint16(p+8,obj->length_recovery);
+	p+=FEC_HEADER_SIZE;
+	put_uint16(p,(uint16_t)obj->xor_len);
+	put_uint16(p+2,obj->mask);
+	p+=FEC_LEVEL_HEADER_SIZE;
+	memcpy(p,obj->xor_buf,obj->xor_len);
+	fec->b_wptr=p+obj->xor_len;
+	obj->stats.packets_protected+=obj->count;
+	obj->stats.fec_packets_sent++;
+	reset_group(obj);
+	return fec;
+}
+
+static mblk_t *protect(MSRtpFec *obj, mblk_t *m){
+	mblk_t *fec=NULL;
+	uint16_t seq;
+	bool_t marker;
+
+	if (m->b_wptr-m->b_rptr<RTP_FIXED_HEADER_SIZE || !is_rtp_packet(m->b_rptr,(int)(m->b_wptr-m->b_rptr))) return NULL;
+	seq=get_uint16(m->b_rptr+2);
+	marker=(m->b_rptr[1] & 0x80)!=0;
+
+	ms_mutex_lock(&obj->lock);
+	if (obj->group_size==0){
+		reset_group(obj);
+		ms_mutex_unlock(&obj->lock);
+		return NULL;
+	}
+	if (obj->count>0 && (get_uint32(m->b_rptr+8)!=obj->group_ssrc || (uint16_t)(seq-obj->base_seq)>=FEC_MASK_SPAN)){
+		/*the packet does not fit in the mask of the current group, which is dropped unprotected if it has a single packet*/
+		if (obj->count>1) fec=make_fec_packet(obj);
+		else reset_group(obj);
+	}
+	add_to_group(obj,m);
+	/*the end of a frame closes the group if it is half full, so that the FEC packet is not held until the next frame*/
+	if (fec==NULL && (obj->count>=obj->group_size || (marker && obj->count*2>=obj->group_size))){
+		fec=make_fec_packet(obj);
+	}
+	ms_mutex_unlock(&obj->lock);
+	return fec;
+}
+
+/*
+ * Receiving side
+ */
+
+static mblk_t *find_received(MSRtpFec *obj, uint16_t seq){
+	ReceivedPacket *rp=&obj->history[seq % HISTORY_SIZE];
+	return rp->m!=NULL && rp->seq==seq ? rp->m : NULL;
+}
+
+static void store_received(MSRtpFec *obj, const uint8_t *data, int len, uint16_t seq){
+	ReceivedPacket *rp=&obj->history[seq % HISTORY_SIZE];
+	if (rp->m!=NULL){
+		if (rp->seq==seq) return;
+		freemsg(rp->m);
+	}
+	rp->m=allocb(len,0);
+	memcpy(rp->m->b_wptr,data,len);
+	rp->m->b_wptr+=len;
+	rp->seq=seq;
+}
+
+static void reset_receiving(MSRtpFec *obj){
+	int i;
+	for(i=0;i<HISTORY_SIZE;++i){
+		if (obj->history[i].m){
+			freemsg(obj->history[i].m);
+			obj->history[i].m=NULL;
+		}
+	}
+	for(i=0;i<obj->npending;++i) freemsg(obj->pending[i]);
+	obj->npending=0;
+}
+
+static void remove_pending(MSRtpFec *obj, int index){
+	freemsg(obj->pending[index]);
+	obj->npending--;
+	memmove(&obj->pending[index],&obj->pending[index+1],(obj->npending-index)*sizeof(mblk_t*));
+}
+
+/*rebuilds the packet whose sequence number is missing from the FEC packet and the other packets it protects*/
+static mblk_t *recover(MSRtpFec *obj, const uint8_t *fec, int fec_len, uint16_t missing_seq, const mblk_t *received){
+	const uint8_t *fec_header=fec+RTP_FIXED_HEADER_SIZE;
+	const uint8_t *level_header=fec_header+FEC_HEADER_SIZE;
+	const uint8_t *payload=level_header+FEC_LEVEL_HEADER_SIZE;
+	uint16_t base_seq=get_uint16(fec_header+2);
+	uint16_t mask=get_uint16(level_header+2);
+	int protection_len=get_uint16(level_header);
+	uint8_t byte0=fec_header[0];
+	uint8_t byte1=fec_header[1];
+	uint32_t ts=get_uint32(fec_header+4);
+	uint16_t length=get_uint16(fec_header+8);
+	mblk_t *m;
+	int i;
+
+	/*first pass on the header fields, which give the length of the missing packet*/
+	for(i=0;i<FEC_MASK_SPAN;++i){
+		const mblk_t *p;
+		if (!(mask & (1<<(FEC_MASK_SPAN-1-i)))) continue;
+		p=find_received(obj,(uint16_t)(base_seq+i));
+		if (p==NULL) continue;
+		byte0^=p->b_rptr[0];
+		byte1^=p->b_rptr[1];
+		ts^=get_uint32(p->b_rptr+4);
+		length^=(uint16_t)(p->b_wptr-p->b_rptr-RTP_FIXED_HEADER_SIZE);
+	}
+	if (length>protection_len || payload+length>fec+fec_len) return NULL;
+	m=allocb(RTP_FIXED_HEADER_SIZE+length,0);
+	m->b_wptr[0]=0x80 | (byte0 & 0x3f);
+	m->b_wptr[1]=byte1;
+	put_uint16(m->b_wptr+2,missing_seq);
+	put_uint32(m->b_wptr+4,ts);
+	put_uint32(m->b_wptr+8,obj->recv_ssrc);
+	memcpy(m->b_wptr+RTP_FIXED_HEADER_SIZE,payload,length);
+	for(i=0;i<FEC_MASK_SPAN;++i){
+		const mblk_t *p;
+		int len;
+		if (!(mask & (1<<(FEC_MASK_SPAN-1-i)))) continue;
+		p=find_received(obj,(uint16_t)(base_seq+i));
+		if (p==NULL) continue;
+		len=(int)(p->b_wptr-p->b_rptr)-RTP_FIXED_HEADER_SIZE;
+		if (len>length) len=length;
+		xor_bytes(m->b_wptr+RTP_FIXED_HEADER_SIZE,p->b_rptr+RTP_FIXED_HEADER_SIZE,len);
+	}
+	m->b_wptr+=RTP_FIXED_HEADER_SIZE+length;
+	/*the packet is handed over as if it had been received with the packet that allowed to rebuild it*/
+	mblk_meta_copy(received,m);
+	/*not copied by mblk_meta_copy()*/
+	m->recv_addr=received->recv_addr;
+	return m;
+}
+
+/*
+ * Tries to use a FEC packet, returns TRUE once it is no longer needed: all the packets it protects were received or
+ * rebuilt, or it cannot be used anymore.
+ */
+static bool_t process_pending(MSRtpFec *obj, const mblk_t *fec, const mblk_t *received, queue_t *recovered){
+	const uint8_t *fec_header=fec->b_rptr+RTP_FIXED_HEADER_SIZE;
+	uint16_t base_seq=get_uint16(fec_header+2);
+	uint16_t mask=get_uint16(fec_header+FEC_HEADER_SIZE+2);
+	uint16_t missing_seq=0;
+	int missing=0;
+	int i;
+	mblk_t *m;
+
+	for(i=0;i<FEC_MASK_SPAN;++i){
+		uint16_t seq=(uint16_t)(base_seq+i);
+		if (!(mask & (1<<(FEC_MASK_SPAN-1-i)))) continue;
+		if (find_received(obj,seq)==NULL){
+			missing_seq=seq;
+			missing++;
+		}
+	}
+	if (missing==0) return TRUE;
+	/*the media stream is not known yet*/
+	if (!obj->receiving) return FALSE;
+	if (missing>1){
+		if ((int16_t)(obj->highest_seq-base_seq)<MAX_FEC_AGE) return FALSE;
+		obj->stats.recoveries_failed++;
+		return TRUE;
+	}
+	m=recover(obj,fec->b_rptr,(int)(fec->b_wptr-fec->b_rptr),missing_seq,received);
+	if (m==NULL){
+		ms_warning("MSRtpFec[%p]: invalid FEC packet protecting packet %u",obj,missing_seq);
+		obj->stats.recoveries_failed++;
+		return TRUE;
+	}
+	store_received(obj,m->b_rptr,(int)(m->b_wptr-m->b_rptr),missing_seq);
+	putq(recovered,m);
+	obj->stats.packets_recovered++;
+	return TRUE;
+}
+
+static void process_all_pending(MSRtpFec *obj, const mblk_t *received, queue_t *recovered){
+	int i;
+	for(i=0;i<obj->npending;){
+		if (process_pending(obj,obj->pending[i],received,recovered)) remove_pending(obj,i);
+		else i++;
+	}
+}
+
+/*returns TRUE if the packet is a FEC packet, the packets rebuilt are added to the queue*/
+static bool_t on_receive(MSRtpFec *obj, mblk_t *m, queue_t *recovered){
+	const uint8_t *data=m->b_rptr;
+	int len=(int)(m->b_wptr-m->b_rptr);
+	uint32_t ssrc;
+	uint16_t seq;
+
+	if (!is_rtp_packet(data,len)) return FALSE;
+	if ((data[1] & 0x7f)==obj->payload_type){
+		mblk_t *fec;
+		if (len<RTP_FIXED_HEADER_SIZE+FEC_HEADER_SIZE+FEC_LEVEL_HEADER_SIZE || (data[RTP_FIXED_HEADER_SIZE] & 0xc0)!=0){
+			/*the extended masks and the additional protection levels are never sent*/
+			ms_warning("MSRtpFec[%p]: unsupported FEC packet discarded",obj);
+			return TRUE;
+		}
+		/*
+		 * The FEC packets have their own SSRC and sequence numbers, the stream they protect is the media stream received
+		 * on the session.
+		 */
+		ms_mutex_lock(&obj->lock);
+		obj->stats.fec_packets_received++;
+		if (obj->npending==MAX_PENDING_FEC){
+			obj->stats.recoveries_failed++;
+			remove_pending(obj,0);
+		}
+		fec=allocb(len,0);
+		memcpy(fec->b_wptr,data,len);
+		fec->b_wptr+=len;
+		obj->pending[obj->npending++]=fec;
+		process_all_pending(obj,m,recovered);
+		ms_mutex_unlock(&obj->lock);
+		return TRUE;
+	}
+	ssrc=get_uint32(data+8);
+	seq=get_uint16(data+2);
+	ms_mutex_lock(&obj->lock);
+	if (!obj->receiving || ssrc!=obj->recv_ssrc){
+		/*first packet, or the remote party restarted its stream*/
+		reset_receiving(obj);
+		obj->receiving=TRUE;
+		obj->recv_ssrc=ssrc;
+		obj->highest_seq=seq;
+	}
+	if ((int16_t)(seq-obj->highest_seq)>0) obj->highest_seq=seq;
+	store_received(obj,data,len,seq);
+	if (obj->npending>0) process_all_pending(obj,m,recovered);
+	ms_mutex_unlock(&obj->lock);
+	return FALSE;
+}
+
+/*
+ * Transport modifier
+ */
+
+static int ms_rtp_fec_process_on_send(RtpTransportModifier *t, mblk_t *m){
+	MSRtpFec *obj=(MSRtpFec*)t->data;
+	mblk_t *fec;
+
+	if (obj!=NULL && (fec=protect(obj,m))!=NULL){
+		RtpTransport *rtpt=NULL;
+		rtp_session_get_transports(obj->session,&rtpt,NULL);
+		/*
+		 * The FEC packet goes through the modifiers appended after this one, so that it is protected by SRTP like the
+		 * media packets. It leaves just before the packet that closed its group, the receiver waits for both anyway.
+		 */
+		meta_rtp_transport_modifier_inject_packet_to_send(rtpt,t,fec,0);
+		freemsg(fec);
+	}
+	return (int)msgdsize(m);
+}
+
+static int ms_rtp_fec_process_on_receive(RtpTransportModifier *t, mblk_t *m){
+	MSRtpFec *obj=(MSRtpFec*)t->data;
+	queue_t recovered;
+	mblk_t *rebuilt;
+	bool_t is_fec;
+
+	if (obj==NULL) return (int)msgdsize(m);
+	qinit(&recovered);
+	is_fec=on_receive(obj,m,&recovered);
+	if (!qempty(&recovered)){
+		RtpTransport *rtpt=NULL;
+		rtp_session_get_transports(obj->session,&rtpt,NULL);
+		/*the packets rebuilt are handed over to the session as if they had been received after this modifier*/
+		while((rebuilt=getq(&recovered))!=NULL) meta_rtp_transport_modifier_inject_packet_to_recv(rtpt,t,rebuilt,0);
+	}
+	/*the FEC packets are not given to the session*/
+	return is_fec ? 0 : (int)msgdsize(m);
+}
+
+static void ms_rtp_fec_transport_modifier_destroy(RtpTransportModifier *t){
+	MSRtpFec *obj=(MSRtpFec*)t->data;
+	if (obj!=NULL){
+		ms_warning("MSRtpFec[%p]: session [%p] destroyed before the FEC handler",obj,obj->session);
+		ms_mutex_lock(&obj->lock);
+		obj->modifier=NULL;
+		ms_mutex_unlock(&obj->lock);
+	}
+	ms_free(t);
+}
+
+/*
+ * Life cycle
+ */
+
+MSRtpFec *ms_rtp_fec_new(RtpSession *session, int payload_type){
+	MSRtpFec *obj;
+	RtpTransport *rtpt=NULL;
+
+	rtp_session_get_transports(session,&rtpt,NULL);
+	if (rtpt==NULL){
+		ms_error("MSRtpFec: session [%p] has no RTP transport",session);
+		return NULL;
+	}
+	obj=ms_new0(MSRtpFec,1);
+	obj->session=session;
+	obj->payload_type=payload_type;
+	obj->group_size=DEFAULT_GROUP_SIZE;
+	obj->fec_seq=(uint16_t)ortp_random();
+	do{
+		obj->fec_ssrc=ortp_random();
+	}while(obj->fec_ssrc==rtp_session_get_send_ssrc(session));
+	obj->lre=ortp_loss_rate_estimator_new(LOSS_RATE_MIN_INTERVAL,LOSS_RATE_MIN_TIME,session);
+	ms_mutex_init(&obj->lock,NULL);
+	obj->modifier=ms_new0(RtpTransportModifier,1);
+	obj->modifier->data=obj;
+	obj->modifier->t_process_on_send=ms_rtp_fec_process_on_send;
+	obj->modifier->t_process_on_receive=ms_rtp_fec_process_on_receive;
+	obj->modifier->t_destroy=ms_rtp_fec_transport_modifier_destroy;
+	meta_rtp_transport_append_modifier(rtpt,obj->modifier);
+	ms_message("MSRtpFec[%p] created for session [%p], FEC packets use payload type %i and SSRC %u",obj,session,payload_type,obj->fec_ssrc);
+	return obj;
+}
+
+void ms_rtp_fec_set_group_size(MSRtpFec *obj, int group_size){
+	if (group_size!=0 && group_size<MIN_GROUP_SIZE) group_size=MIN_GROUP_SIZE;
+	else if (group_size>MAX_GROUP_SIZE) group_size=MAX_GROUP_SIZE;
+	ms_mutex_lock(&obj->lock);
+	if (obj->group_size!=group_size){
+		ms_message("MSRtpFec[%p]: now protecting groups of %i packets",obj,group_size);
+		obj->group_size=group_size;
+	}
+	ms_mutex_unlock(&obj->lock);
+}
+
+void ms_rtp_fec_set_loss_rate(MSRtpFec *obj, float loss_rate){
+	int group_size=0;
+	int current;
+
+	/*
+	 * A group with a single loss is recovered: keep the groups small enough for the losses to fall in different
+	 * groups most of the time.
+	 */
+	if (loss_rate>=MIN_LOSS_RATE){
+		group_size=(int)(25.0f/loss_rate);
+		if (group_size<MIN_GROUP_SIZE) group_size=MIN_GROUP_SIZE;
+		else if (group_size>MAX_GROUP_SIZE) group_size=MAX_GROUP_SIZE;
+	}
+	ms_mutex_lock(&obj->lock);
+	current=obj->group_size;
+	ms_mutex_unlock(&obj->lock);
+	/*
+	 * The loss rate reported by the remote party is measured after the recovery, so it drops as soon as the FEC works:
+	 * the protection is raised at once but lowered one step per report, and stopped only from the largest groups.
+	 */
+	if (current!=0 && (group_size==0 || group_size>current)){
+		group_size=current<MAX_GROUP_SIZE ? current+1 : group_size;
+	}
+	ms_rtp_fec_set_group_size(obj,group_size);
+}
+
+void ms_rtp_fec_process_rtcp(MSRtpFec *obj, mblk_t *rtcp){
+	const report_block_t *rb=NULL;
+
+	if (rtcp_is_SR(rtcp)){
+		rb=rtcp_SR_get_report_block(rtcp,0);
+	}else if (rtcp_is_RR(rtcp)){
+		rb=rtcp_RR_get_report_block(rtcp,0);
+	}
+	if (rb && report_block_get_ssrc(rb)==rtp_session_get_send_ssrc(obj->session)
+		&& ortp_loss_rate_estimator_process_report_block(obj->lre,obj->session,rb)){
+		ms_rtp_fec_set_loss_rate(obj,ortp_loss_rate_estimator_get_value(obj->lre));
+	}
+}
+
+void ms_rtp_fec_get_stats(MSRtpFec *obj, MSRtpFecStats *stats){
+	ms_mutex_lock(&obj->lock);
+	*stats=obj->stats;
+	stats->group_size=obj->group_size;
+	ms_mutex_unlock(&obj->lock);
+}
+
+void ms_rtp_fec_destroy(MSRtpFec *obj){
+	/*there is no way to remove a modifier from its transport: it stays and lets the packets through*/
+	if (obj->modifier) obj->modifier->data=NULL;
+	ms_message("MSRtpFec[%p]: %llu packets protected by %llu FEC packets, %llu FEC packets received, %llu packets recovered",obj,
+		(unsigned long long)obj->stats.packets_protected,(unsigned long long)obj->stats.fec_packets_sent,
+		(unsigned long long)obj->stats.fec_packets_received,(unsigned long long)obj->stats.packets_recovered);
+	reset_receiving(obj);
+	ortp_loss_rate_estimator_destroy(obj->lre);
+	if (obj->xor_buf) ms_free(obj->xor_buf);
+	ms_mutex_destroy(&obj->lock);
+	ms_free(obj);
+}
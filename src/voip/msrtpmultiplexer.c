@@ -0,0 +1,356 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /*for recvmmsg()*/
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "msrtpendpoint.h"
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_RECVMMSG)
+#define MULTIPLEXER_SUPPORTED
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+/*number of packets read by a single recvmmsg() call*/
+#define RECV_BATCH_SIZE 32
+
+#define MAX_EVENTS 256
+
+/*an idle session is still processed from time to time, so that its RTCP reports are sent*/
+#define MAX_IDLE_TICKS 10
+
+#ifdef MULTIPLEXER_SUPPORTED
+#define CONTROL_SIZE (CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(sizeof(struct timeval)) + CMSG_SPACE(sizeof(int)))
+#endif
+
+struct _MSRtpRecvMultiplexer{
+	MSTicker *ticker;
+	bctbx_list_t *endpoints; /*list of MSRtpEndpoint*/
+	uint32_t polled_tick;
+	int tick_packets;
+#ifdef MULTIPLEXER_SUPPORTED
+	int epfd;
+	mblk_t *slots[RECV_BATCH_SIZE];
+	struct mmsghdr msgs[RECV_BATCH_SIZE];
+	struct iovec iovs[RECV_BATCH_SIZE];
+	struct sockaddr_storage addrs[RECV_BATCH_SIZE];
+	uint8_t controls[RECV_BATCH_SIZE][CONTROL_SIZE];
+#endif
+	MSRtpRecvMultiplexerStats stats;
+};
+
+#ifdef MULTIPLEXER_SUPPORTED
+
+static bool_t in_ticker_thread(MSRtpRecvMultiplexer *obj){
+	return (unsigned long)ms_thread_self()==obj->ticker->thread_id;
+}
+
+/*the sockets of a session are replaced when its local address is changed*/
+static void update_socket(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep){
+	ortp_socket_t sockfd=ms_rtp_endpoint_get_socket(ep);
+	struct epoll_event ev;
+
+	if (sockfd==ep->polled_socket) return;
+	if (ep->polled_socket!=(ortp_socket_t)-1){
+		/*fails if the socket is already closed, it is then already removed from the set*/
+		epoll_ctl(obj->epfd,EPOLL_CTL_DEL,ep->polled_socket,NULL);
+	}
+	ep->polled_socket=sockfd;
+	if (sockfd==(ortp_socket_t)-1) return;
+	memset(&ev,0,sizeof(ev));
+	ev.events=EPOLLIN;
+	ev.data.ptr=ep;
+	if (epoll_ctl(obj->epfd,EPOLL_CTL_ADD,sockfd,&ev)!=0){
+		ms_error("MSRtpRecvMultiplexer[%p]: cannot watch socket %i: %s",obj,(int)sockfd,strerror(errno));
+		ep->polled_socket=(ortp_socket_t)-1;
+	}
+}
+
+static void unwatch_socket(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep){
+	if (ep->polled_socket!=(ortp_socket_t)-1){
+		epoll_ctl(obj->epfd,EPOLL_CTL_DEL,ep->polled_socket,NULL);
+		ep->polled_socket=(ortp_socket_t)-1;
+	}
+}
+
+/*fill the metadata that rtp_session_recvfrom() would have set*/
+static void parse_control(MSRtpEndpoint *ep, mblk_t *m, struct msghdr *hdr){
+	struct cmsghdr *cmsg;
+	for(cmsg=CMSG_FIRSTHDR(hdr);cmsg!=NULL;cmsg=CMSG_NXTHDR(hdr,cmsg)){
+		if (cmsg->cmsg_level==IPPROTO_IP && cmsg->cmsg_type==IP_PKTINFO){
+			struct in_pktinfo *pi=(struct in_pktinfo*)CMSG_DATA(cmsg);
+			memcpy(&m->recv_addr.addr.ipi_addr,&pi->ipi_addr,sizeof(m->recv_addr.addr.ipi_addr));
+			m->recv_addr.family=AF_INET;
+		}else if (cmsg->cmsg_level==IPPROTO_IPV6 && cmsg->cmsg_type==IPV6_PKTINFO){
+			struct in6_pktinfo *pi=(struct in6_pktinfo*)CMSG_DATA(cmsg);
+			memcpy(&m->recv_addr.addr.ipi6_addr,&pi->ipi6_addr,sizeof(m->recv_addr.addr.ipi6_addr));
+			m->recv_addr.family=AF_INET6;
+		}
+#if defined(ORTP_TIMESTAMP)
+		else if (cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SO_TIMESTAMP){
+			memcpy(&m->timestamp,CMSG_DATA(cmsg),sizeof(struct timeval));
+		}
+#endif
+	}
+	if (m->recv_addr.family!=AF_UNSPEC){
+		int port=ep->is_rtp ? rtp_session_get_local_port(ep->session) : rtp_session_get_local_rtcp_port(ep->session);
+		m->recv_addr.port=htons((uint16_t)port);
+	}
+}
+
+static void drain_socket(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep){
+	int bufsize=ep->session->recv_buf_size;
+	int i,ret;
+
+	do{
+		for(i=0;i<RECV_BATCH_SIZE;++i){
+			struct msghdr *hdr=&obj->msgs[i].msg_hdr;
+			mblk_t *slot=obj->slots[i];
+			if (slot!=NULL && (slot->b_datap->db_lim-slot->b_datap->db_base)<bufsize){
+				freemsg(slot);
+				slot=NULL;
+			}
+			if (slot==NULL) slot=obj->slots[i]=allocb(bufsize,0);
+			obj->iovs[i].iov_base=slot->b_wptr;
+			obj->iovs[i].iov_len=bufsize;
+			memset(hdr,0,sizeof(struct msghdr));
+			hdr->msg_name=&obj->addrs[i];
+			hdr->msg_namelen=sizeof(struct sockaddr_storage);
+			hdr->msg_iov=&obj->iovs[i];
+			hdr->msg_iovlen=1;
+			hdr->msg_control=obj->controls[i];
+			hdr->msg_controllen=CONTROL_SIZE;
+		}
+		ret=recvmmsg(ep->polled_socket,obj->msgs,RECV_BATCH_SIZE,MSG_DONTWAIT,NULL);
+		obj->stats.syscalls++;
+		if (ret<0){
+			if (errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR){
+				ms_warning("MSRtpRecvMultiplexer[%p]: error while reading socket %i of session [%p]: %s",obj,(int)ep->polled_socket,
+					ep->session,strerror(errno));
+			}
+			return;
+		}
+		for(i=0;i<ret;++i){
+			mblk_t *m=obj->slots[i];
+			struct msghdr *hdr=&obj->msgs[i].msg_hdr;
+			obj->slots[i]=NULL;
+			m->b_wptr+=obj->msgs[i].msg_len;
+			memcpy(&m->net_addr,&obj->addrs[i],hdr->msg_namelen);
+			m->net_addrlen=hdr->msg_namelen;
+			parse_control(ep,m,hdr);
+			putq(&ep->recv_queue,m);
+		}
+		obj->tick_packets+=ret;
+		obj->stats.packets+=ret;
+	}while(ret==RECV_BATCH_SIZE);
+}
+
+/*the sockets are polled once per tick, by the first session reading them*/
+static void poll_sockets(MSRtpRecvMultiplexer *obj){
+	struct epoll_event events[MAX_EVENTS];
+	int i,n;
+
+	if (obj->polled_tick==obj->ticker->ticks) return;
+	obj->polled_tick=obj->ticker->ticks;
+	obj->tick_packets=0;
+	n=epoll_wait(obj->epfd,events,MAX_EVENTS,0);
+	obj->stats.syscalls++;
+	obj->stats.polls++;
+	for(i=0;i<n;++i){
+		drain_socket(obj,(MSRtpEndpoint*)events[i].data.ptr);
+	}
+	obj->stats.last_poll_size=obj->tick_packets;
+	if (obj->tick_packets>obj->stats.max_poll_size) obj->stats.max_poll_size=obj->tick_packets;
+}
+
+int ms_rtp_recv_multiplexer_recv(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep, mblk_t *msg, int flags, struct sockaddr *from, socklen_t *fromlen){
+	if (!in_ticker_thread(obj)){
+		/*the queues are accessed by the ticker thread only*/
+		return rtp_session_recvfrom(ep->session,ep->is_rtp,msg,flags,from,fromlen);
+	}
+	update_socket(obj,ep);
+	poll_sockets(obj);
+	return ms_rtp_endpoint_read_queue(ep,msg,from,fromlen);
+}
+
+bool_t ms_rtp_recv_multiplexer_session_idle(RtpSession *session){
+	MSRtpEndpoint *rtp_ep=ms_rtp_endpoint_get(session,TRUE,FALSE);
+	MSRtpEndpoint *rtcp_ep=ms_rtp_endpoint_get(session,FALSE,FALSE);
+	MSRtpRecvMultiplexer *obj;
+
+	if (rtp_ep==NULL || rtcp_ep==NULL || rtp_ep->multiplexer==NULL || rtcp_ep->multiplexer==NULL) return FALSE;
+	obj=rtp_ep->multiplexer;
+	if (!in_ticker_thread(obj)) return FALSE;
+	update_socket(obj,rtp_ep);
+	update_socket(obj,rtcp_ep);
+	poll_sockets(obj);
+	if (!qempty(&rtp_ep->recv_queue) || !qempty(&rtcp_ep->recv_queue) || !qempty(&session->rtp.rq)){
+		rtp_ep->idle_ticks=0;
+		return FALSE;
+	}
+	if (++rtp_ep->idle_ticks>=MAX_IDLE_TICKS){
+		rtp_ep->idle_ticks=0;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+MSRtpRecvMultiplexer *ms_rtp_recv_multiplexer_new(MSTicker *ticker){
+	MSRtpRecvMultiplexer *obj;
+	int epfd=epoll_create1(EPOLL_CLOEXEC);
+
+	if (epfd==-1){
+		ms_error("ms_rtp_recv_multiplexer_new(): epoll_create1() failed: %s",strerror(errno));
+		return NULL;
+	}
+	obj=ms_new0(MSRtpRecvMultiplexer,1);
+	obj->ticker=ticker;
+	obj->epfd=epfd;
+	return obj;
+}
+
+/*to be called with the ticker lock held, so that the ticker thread is not using the endpoint*/
+static void remove_endpoint(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep){
+	unwatch_socket(obj,ep);
+	flushq(&ep->recv_queue,0);
+	obj->endpoints=bctbx_list_remove(obj->endpoints,ep);
+	ep->multiplexer=NULL;
+	ms_rtp_endpoint_release(ep);
+}
+
+void ms_rtp_recv_multiplexer_forget_endpoint(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep){
+	ms_warning("MSRtpRecvMultiplexer[%p]: session [%p] destroyed while being multiplexed",obj,ep->session);
+	ms_mutex_lock(&obj->ticker->lock);
+	unwatch_socket(obj,ep);
+	obj->endpoints=bctbx_list_remove(obj->endpoints,ep);
+	ep->multiplexer=NULL;
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+int ms_rtp_recv_multiplexer_add_session(MSRtpRecvMultiplexer *obj, RtpSession *session){
+	MSRtpEndpoint *rtp_ep;
+	MSRtpEndpoint *rtcp_ep;
+	int ret=0;
+
+	ms_mutex_lock(&obj->ticker->lock);
+	rtp_ep=ms_rtp_endpoint_get(session,TRUE,TRUE);
+	rtcp_ep=ms_rtp_endpoint_get(session,FALSE,TRUE);
+	if (rtp_ep==NULL || rtcp_ep==NULL){
+		ms_error("MSRtpRecvMultiplexer[%p]: session [%p] has no transport or already has a transport endpoint, it cannot be multiplexed",obj,session);
+		ret=-1;
+	}else if (rtp_ep->multiplexer!=NULL || rtcp_ep->multiplexer!=NULL){
+		ms_error("MSRtpRecvMultiplexer[%p]: session [%p] is already multiplexed",obj,session);
+		ret=-1;
+	}else if (rtp_ep->shared_port!=NULL){
+		ms_error("MSRtpRecvMultiplexer[%p]: session [%p] receives from a shared port, it cannot be multiplexed",obj,session);
+		ret=-1;
+	}
+	if (ret==0){
+		rtp_ep->multiplexer=obj;
+		rtcp_ep->multiplexer=obj;
+		update_socket(obj,rtp_ep);
+		update_socket(obj,rtcp_ep);
+		obj->endpoints=bctbx_list_append(obj->endpoints,rtp_ep);
+		obj->endpoints=bctbx_list_append(obj->endpoints,rtcp_ep);
+	}else{
+		if (rtp_ep) ms_rtp_endpoint_release(rtp_ep);
+		if (rtcp_ep) ms_rtp_endpoint_release(rtcp_ep);
+	}
+	ms_mutex_unlock(&obj->ticker->lock);
+	return ret;
+}
+
+void ms_rtp_recv_multiplexer_remove_session(MSRtpRecvMultiplexer *obj, RtpSession *session){
+	bctbx_list_t *elem,*next;
+
+	ms_mutex_lock(&obj->ticker->lock);
+	for(elem=obj->endpoints;elem!=NULL;elem=next){
+		MSRtpEndpoint *ep=(MSRtpEndpoint*)elem->data;
+		next=elem->next;
+		if (ep->session==session) remove_endpoint(obj,ep);
+	}
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+void ms_rtp_recv_multiplexer_get_stats(MSRtpRecvMultiplexer *obj, MSRtpRecvMultiplexerStats *stats){
+	ms_mutex_lock(&obj->ticker->lock);
+	*stats=obj->stats;
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+void ms_rtp_recv_multiplexer_destroy(MSRtpRecvMultiplexer *obj){
+	int i;
+
+	ms_mutex_lock(&obj->ticker->lock);
+	while(obj->endpoints!=NULL) remove_endpoint(obj,(MSRtpEndpoint*)obj->endpoints->data);
+	ms_mutex_unlock(&obj->ticker->lock);
+	if (obj->stats.polls>0){
+		ms_message("MSRtpRecvMultiplexer[%p]: %llu packets read with %llu system calls, at most %i per tick",obj,
+			(unsigned long long)obj->stats.packets,(unsigned long long)obj->stats.syscalls,obj->stats.max_poll_size);
+	}
+	for(i=0;i<RECV_BATCH_SIZE;++i){
+		if (obj->slots[i]) freemsg(obj->slots[i]);
+	}
+	close(obj->epfd);
+	ms_free(obj);
+}
+
+#else
+
+int ms_rtp_recv_multiplexer_recv(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep, mblk_t *msg, int flags, struct sockaddr *from, socklen_t *fromlen){
+	return rtp_session_recvfrom(ep->session,ep->is_rtp,msg,flags,from,fromlen);
+}
+
+bool_t ms_rtp_recv_multiplexer_session_idle(RtpSession *session){
+	return FALSE;
+}
+
+MSRtpRecvMultiplexer *ms_rtp_recv_multiplexer_new(MSTicker *ticker){
+	ms_error("ms_rtp_recv_multiplexer_new(): not supported on this platform");
+	return NULL;
+}
+
+void ms_rtp_recv_multiplexer_forget_endpoint(MSRtpRecvMultiplexer *obj, MSRtpEndpoint *ep){
+}
+
+int ms_rtp_recv_multiplexer_add_session(MSRtpRecvMultiplexer *obj, RtpSession *session){
+	return -1;
+}
+
+void ms_rtp_recv_multiplexer_remove_session(MSRtpRecvMultiplexer *obj, RtpSession *session){
+}
+
+void ms_rtp_recv_multiplexer_get_stats(MSRtpRecvMultiplexer *obj, MSRtpRecvMultiplexerStats *stats){
+	memset(stats,0,sizeof(*stats));
+}
+
+void ms_rtp_recv_multiplexer_destroy(MSRtpRecvMultiplexer *obj){
+}
+
+#endif
@@ -0,0 +1,376 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "msrtpendpoint.h"
+
+#define MIN_CACHE_SIZE 16
+#define MAX_CACHE_SIZE 4096
+
+#define RTCP_RTPFB_PACKET_TYPE 205
+#define RTCP_RTPFB_GENERIC_NACK_FMT 1
+#define RTCP_FB_HEADER_SIZE 12
+#define NACK_FCI_SIZE 4
+/*one FCI requests a packet and the 16 following ones*/
+#define NACK_FCI_SPAN 17
+#define MAX_NACK_FCIS 32
+
+/*the missing packets tracked by the receiving side*/
+#define MAX_MISSING 256
+/*a larger gap is not worth requesting, the decoder will ask for a key frame*/
+#define MAX_GAP 128
+#define MAX_NACKS_PER_PACKET 3
+#define MAX_MISSING_AGE_MS 1000
+/*interval between two requests of the same packet when the round trip time is not known yet*/
+#define DEFAULT_NACK_INTERVAL_MS 100
+#define MIN_NACK_INTERVAL_MS 20
+#define SCAN_INTERVAL_MS 10
+
+typedef struct _MissingPacket{
+	uint64_t detection_time;
+	uint64_t last_nack_time;
+	uint16_t seq;
+	int nacks;
+}MissingPacket;
+
+struct _MSRtpRetransmission{
+	RtpSession *session;
+	MSRtpEndpoint *ep;
+	ms_mutex_t lock;
+	/*sending side*/
+	mblk_t **cache;
+	int cache_mask;
+	/*receiving side*/
+	MissingPacket missing[MAX_MISSING];
+	int nmissing;
+	uint64_t last_scan_time;
+	uint32_t recv_ssrc;
+	uint16_t highest_seq;
+	bool_t receiving;
+	MSRtpRetransmissionStats stats;
+};
+
+static uint16_t rtp_get_seq(const uint8_t *data){
+	return (uint16_t)((data[2]<<8) | data[3]);
+}
+
+static uint32_t rtp_get_ssrc(const uint8_t *data){
+	return ((uint32_t)data[8]<<24) | ((uint32_t)data[9]<<16) | ((uint32_t)data[10]<<8) | (uint32_t)data[11];
+}
+
+/*tells whether the datagram is a RTP packet, and not a RTCP packet multiplexed with RTP, a STUN or a DTLS packet*/
+static bool_t is_rtp_packet(const uint8_t *data, int len){
+	return len>=RTP_FIXED_HEADER_SIZE && (data[0]>>6)==2 && (data[1]<192 || data[1]>223);
+}
+
+static void put_uint16(uint8_t *p, uint16_t val){
+	p[0]=(uint8_t)(val>>8);
+	p[1]=(uint8_t)(val & 0xff);
+}
+
+static void put_uint32(uint8_t *p, uint32_t val){
+	p[0]=(uint8_t)(val>>24);
+	p[1]=(uint8_t)((val>>16) & 0xff);
+	p[2]=(uint8_t)((val>>8) & 0xff);
+	p[3]=(uint8_t)(val & 0xff);
+}
+
+/*
+ * Sending side
+ */
+
+void ms_rtp_retransmission_store(MSRtpRetransmission *obj, mblk_t *m){
+	mblk_t **slot;
+
+	if (!is_rtp_packet(m->b_rptr,(int)(m->b_wptr-m->b_rptr))) return;
+	ms_mutex_lock(&obj->lock);
+	slot=&obj->cache[rtp_get_seq(m->b_rptr) & obj->cache_mask];
+	if (*slot) freemsg(*slot);
+	/*the packet is not modified anymore once it reached the endpoint, its data can be shared*/
+	*slot=dupmsg(m);
+	ms_mutex_unlock(&obj->lock);
+}
+
+/*to be called with the lock held*/
+static void retransmit(MSRtpRetransmission *obj, uint16_t seq){
+	RtpSession *session=obj->session;
+	mblk_t *m=obj->cache[seq & obj->cache_mask];
+	const struct sockaddr *to=NULL;
+	socklen_t tolen=0;
+
+	if (m==NULL || rtp_get_seq(m->b_rptr)!=seq){
+		obj->stats.packets_unavailable++;
+		return;
+	}
+	if (!(session->flags & RTP_SOCKET_CONNECTED)){
+		to=(const struct sockaddr *)&session->rtp.gs.rem_addr;
+		tolen=session->rtp.gs.rem_addrlen;
+	}
+	/*the packet is sent as it was the first time, it is already protected if srtp is used*/
+	m=dupmsg(m);
+	if (rtp_session_sendto(session,TRUE,m,0,to,tolen)>0) obj->stats.packets_retransmitted++;
+	freemsg(m);
+}
+
+bool_t ms_rtp_retransmission_process_rtcp(MSRtpRetransmission *obj, const mblk_t *rtcp){
+	const uint8_t *data=rtcp->b_rptr;
+	int size=(int)(rtcp->b_wptr-rtcp->b_rptr);
+	int len,i;
+
+	if (size<RTCP_FB_HEADER_SIZE || (data[0]>>6)!=2 || (data[0] & 0x1f)!=RTCP_RTPFB_GENERIC_NACK_FMT || data[1]!=RTCP_RTPFB_PACKET_TYPE)
+		return FALSE;
+	/*the media source SSRC of a feedback message is at the same offset as the SSRC of a RTP packet*/
+	if (rtp_get_ssrc(data)!=rtp_session_get_send_ssrc(obj->session)) return FALSE;
+	len=(((data[2]<<8) | data[3])+1)*4;
+	if (len>size) len=size;
+
+	ms_mutex_lock(&obj->lock);
+	if (obj->ep==NULL){
+		/*the session is gone*/
+		ms_mutex_unlock(&obj->lock);
+		return FALSE;
+	}
+	obj->stats.nacks_received++;
+	for(i=RTCP_FB_HEADER_SIZE;i+NACK_FCI_SIZE<=len;i+=NACK_FCI_SIZE){
+		uint16_t pid=(uint16_t)((data[i]<<8) | data[i+1]);
+		uint16_t blp=(uint16_t)((data[i+2]<<8) | data[i+3]);
+		int bit;
+		retransmit(obj,pid);
+		for(bit=0;bit<16;++bit){
+			if (blp & (1<<bit)) retransmit(obj,(uint16_t)(pid+bit+1));
+		}
+	}
+	ms_mutex_unlock(&obj->lock);
+	return TRUE;
+}
+
+/*
+ * Receiving side
+ */
+
+static int get_nack_interval(MSRtpRetransmission *obj){
+	float rtt=rtp_session_get_round_trip_propagation(obj->session);
+	int interval;
+	if (rtt<=0) return DEFAULT_NACK_INTERVAL_MS;
+	/*leave the retransmission some time to cross the network*/
+	interval=(int)(rtt*1000*1.5f);
+	return interval<MIN_NACK_INTERVAL_MS ? MIN_NACK_INTERVAL_MS : interval;
+}
+
+static void remove_missing(MSRtpRetransmission *obj, int index){
+	obj->nmissing--;
+	memmove(&obj->missing[index],&obj->missing[index+1],(obj->nmissing-index)*sizeof(MissingPacket));
+}
+
+static void add_missing(MSRtpRetransmission *obj, uint16_t seq, uint64_t now){
+	MissingPacket *mp;
+	if (obj->nmissing==MAX_MISSING){
+		/*drop the oldest one*/
+		remove_missing(obj,0);
+		obj->stats.packets_abandoned++;
+	}
+	mp=&obj->missing[obj->nmissing++];
+	mp->seq=seq;
+	mp->detection_time=now;
+	mp->last_nack_time=0;
+	mp->nacks=0;
+}
+
+static void send_nack(MSRtpRetransmission *obj, const uint16_t *seqs, int count){
+	mblk_t *m;
+	int nfcis=0;
+	int i;
+	uint8_t *fci=NULL;
+	uint16_t pid=0;
+
+	m=allocb(RTCP_FB_HEADER_SIZE+MAX_NACK_FCIS*NACK_FCI_SIZE,0);
+	m->b_wptr+=RTCP_FB_HEADER_SIZE;
+	/*the sequence numbers are sorted, each one either fits in the bitmask of the current FCI or starts a new one*/
+	for(i=0;i<count;++i){
+		uint16_t delta=(uint16_t)(seqs[i]-pid);
+		if (fci!=NULL && delta>0 && delta<NACK_FCI_SPAN){
+			fci[3-(delta-1)/8] |= (uint8_t)(1<<((delta-1)%8));
+			continue;
+		}
+		if (nfcis==MAX_NACK_FCIS) break;
+		fci=m->b_wptr;
+		pid=seqs[i];
+		put_uint16(fci,pid);
+		put_uint16(fci+2,0);
+		m->b_wptr+=NACK_FCI_SIZE;
+		nfcis++;
+	}
+	m->b_rptr[0]=0x80 | RTCP_RTPFB_GENERIC_NACK_FMT;
+	m->b_rptr[1]=RTCP_RTPFB_PACKET_TYPE;
+	put_uint16(m->b_rptr+2,(uint16_t)(2+nfcis));
+	put_uint32(m->b_rptr+4,rtp_session_get_send_ssrc(obj->session));
+	put_uint32(m->b_rptr+8,obj->recv_ssrc);
+	rtp_session_rtcp_sendm_raw(obj->session,m);
+	obj->stats.nacks_sent++;
+	obj->stats.packets_requested+=i;
+}
+
+static int compare_seqs(const void *a, const void *b){
+	/*sequence numbers are compared modulo 2^16, they all lie within MAX_GAP of each other*/
+	return (int16_t)(*(const uint16_t*)a-*(const uint16_t*)b);
+}
+
+/*requests the missing packets that were never requested or whose last request is too old*/
+static void scan_missing(MSRtpRetransmission *obj, uint64_t now){
+	uint16_t seqs[MAX_MISSING];
+	int count=0;
+	int interval=get_nack_interval(obj);
+	int i;
+
+	obj->last_scan_time=now;
+	for(i=0;i<obj->nmissing;){
+		MissingPacket *mp=&obj->missing[i];
+		if (mp->nacks>0 && now-mp->last_nack_time<(uint64_t)interval){
+			i++;
+			continue;
+		}
+		if (mp->nacks>=MAX_NACKS_PER_PACKET || now-mp->detection_time>MAX_MISSING_AGE_MS){
+			obj->stats.packets_abandoned++;
+			remove_missing(obj,i);
+			continue;
+		}
+		mp->nacks++;
+		mp->last_nack_time=now;
+		seqs[count++]=mp->seq;
+		i++;
+	}
+	if (count==0) return;
+	qsort(seqs,count,sizeof(uint16_t),compare_seqs);
+	send_nack(obj,seqs,count);
+}
+
+void ms_rtp_retransmission_on_receive(MSRtpRetransmission *obj, const uint8_t *data, int len){
+	uint64_t now;
+	uint16_t seq;
+	uint32_t ssrc;
+	int16_t diff;
+	bool_t gap=FALSE;
+	int i;
+
+	if (!is_rtp_packet(data,len)) return;
+	seq=rtp_get_seq(data);
+	ssrc=rtp_get_ssrc(data);
+	now=ortp_get_cur_time_ms();
+
+	ms_mutex_lock(&obj->lock);
+	if (!obj->receiving || ssrc!=obj->recv_ssrc){
+		/*first packet, or the remote party restarted its stream*/
+		obj->receiving=TRUE;
+		obj->recv_ssrc=ssrc;
+		obj->highest_seq=seq;
+		obj->nmissing=0;
+		ms_mutex_unlock(&obj->lock);
+		return;
+	}
+	diff=(int16_t)(seq-obj->highest_seq);
+	if (diff>0){
+		if (diff>1 && diff-1<=MAX_GAP){
+			uint16_t s;
+			for(s=(uint16_t)(obj->highest_seq+1);s!=seq;++s) add_missing(obj,s,now);
+			gap=TRUE;
+		}else if (diff>1){
+			ms_warning("MSRtpRetransmission[%p]: %i packets lost at once, not requesting them",obj,diff-1);
+			obj->stats.packets_abandoned+=obj->nmissing;
+			obj->nmissing=0;
+		}
+		obj->highest_seq=seq;
+	}else{
+		/*late packet: maybe one that was requested*/
+		for(i=0;i<obj->nmissing;++i){
+			if (obj->missing[i].seq==seq){
+				if (obj->missing[i].nacks>0) obj->stats.packets_recovered++;
+				remove_missing(obj,i);
+				break;
+			}
+		}
+	}
+	if (obj->nmissing>0 && (gap || now-obj->last_scan_time>=SCAN_INTERVAL_MS)){
+		scan_missing(obj,now);
+	}
+	ms_mutex_unlock(&obj->lock);
+}
+
+/*
+ * Life cycle
+ */
+
+void ms_rtp_retransmission_forget_endpoint(MSRtpRetransmission *obj, MSRtpEndpoint *ep){
+	ms_warning("MSRtpRetransmission[%p]: session [%p] destroyed before the retransmission handler",obj,ep->session);
+	ms_mutex_lock(&obj->lock);
+	ep->retransmission=NULL;
+	obj->ep=NULL;
+	ms_mutex_unlock(&obj->lock);
+}
+
+MSRtpRetransmission *ms_rtp_retransmission_new(RtpSession *session, int cache_size){
+	MSRtpRetransmission *obj;
+	MSRtpEndpoint *ep=ms_rtp_endpoint_get(session,TRUE,TRUE);
+	int size=MIN_CACHE_SIZE;
+
+	if (ep==NULL){
+		ms_error("MSRtpRetransmission: session [%p] has no transport or already has a transport endpoint",session);
+		return NULL;
+	}
+	if (ep->retransmission!=NULL){
+		ms_error("MSRtpRetransmission: session [%p] already has a retransmission handler",session);
+		return NULL;
+	}
+	while(size<cache_size && size<MAX_CACHE_SIZE) size*=2;
+	obj=ms_new0(MSRtpRetransmission,1);
+	obj->session=session;
+	obj->ep=ep;
+	obj->cache=ms_new0(mblk_t*,size);
+	obj->cache_mask=size-1;
+	ms_mutex_init(&obj->lock,NULL);
+	ep->retransmission=obj;
+	ms_message("MSRtpRetransmission[%p] created for session [%p], keeping the last %i packets sent",obj,session,size);
+	return obj;
+}
+
+void ms_rtp_retransmission_get_stats(MSRtpRetransmission *obj, MSRtpRetransmissionStats *stats){
+	ms_mutex_lock(&obj->lock);
+	*stats=obj->stats;
+	ms_mutex_unlock(&obj->lock);
+}
+
+void ms_rtp_retransmission_destroy(MSRtpRetransmission *obj){
+	int i;
+
+	if (obj->ep){
+		obj->ep->retransmission=NULL;
+		ms_rtp_endpoint_release(obj->ep);
+	}
+	ms_message("MSRtpRetransmission[%p]: %llu packets requested in %llu NACKs, %llu recovered, %llu packets retransmitted",obj,
+		(unsigned long long)obj->stats.packets_requested,(unsigned long long)obj->stats.nacks_sent,
+		(unsigned long long)obj->stats.packets_recovered,(unsigned long long)obj->stats.packets_retransmitted);
+	for(i=0;i<=obj->cache_mask;++i){
+		if (obj->cache[i]) freemsg(obj->cache[i]);
+	}
+	ms_free(obj->cache);
+	ms_mutex_destroy(&obj->lock);
+	ms_free(obj);
+}
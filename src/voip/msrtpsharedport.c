@@ -0,0 +1,618 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /*for recvmmsg()*/
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "msrtpendpoint.h"
+
+#ifndef _WIN32
+#include <netdb.h>
+#endif
+
+#ifdef HAVE_RECVMMSG
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#endif
+
+/*number of packets read by a single recvmmsg() call*/
+#define RECV_BATCH_SIZE 32
+
+/*the socket receives the packets of all the sessions between two ticks*/
+#define SOCKET_RECV_BUFFER_SIZE (4*1024*1024)
+
+/*used until a session with a larger receive buffer size is added*/
+#define DEFAULT_RECV_BUF_SIZE 1500
+
+#define INITIAL_TABLE_SIZE 256
+
+/*packets kept for a session that does not read them, beyond which the oldest ones are dropped*/
+#define MAX_QUEUED_PACKETS 256
+
+/*
+ * An entry of the demultiplexing tables. In the address table, ep is the RTP or RTCP endpoint sending to the address.
+ * In the SSRC table, ep is the RTP endpoint of the session.
+ */
+typedef struct _DemuxEntry{
+	struct _DemuxEntry *next;
+	MSRtpEndpoint *ep;
+	uint32_t hash;
+	uint32_t ssrc;
+	struct sockaddr_storage addr;
+	bool_t learnt;
+}DemuxEntry;
+
+typedef struct _DemuxTable{
+	DemuxEntry **buckets;
+	int size; /*always a power of two*/
+	int count;
+}DemuxTable;
+
+struct _MSRtpSharedPort{
+	MSTicker *ticker;
+	ortp_socket_t sockfd;
+	int local_port;
+	int bufsize;
+	bctbx_list_t *endpoints; /*list of MSRtpEndpoint*/
+	DemuxTable addresses;
+	DemuxTable ssrcs;
+	uint32_t polled_tick;
+#ifdef HAVE_RECVMMSG
+	mblk_t *slots[RECV_BATCH_SIZE];
+	struct mmsghdr msgs[RECV_BATCH_SIZE];
+	struct iovec iovs[RECV_BATCH_SIZE];
+	struct sockaddr_storage addrs[RECV_BATCH_SIZE];
+#endif
+	MSRtpSharedPortStats stats;
+};
+
+static void table_init(DemuxTable *t){
+	t->size=INITIAL_TABLE_SIZE;
+	t->buckets=ms_new0(DemuxEntry*,t->size);
+	t->count=0;
+}
+
+/*the entries are appended, so that the first session registered for an address comes first in its bucket*/
+static void table_append(DemuxTable *t, DemuxEntry *e){
+	DemuxEntry **pe=&t->buckets[e->hash & (t->size-1)];
+	while(*pe!=NULL) pe=&(*pe)->next;
+	e->next=NULL;
+	*pe=e;
+}
+
+static void table_insert(DemuxTable *t, DemuxEntry *e){
+	if (t->count>=2*t->size){
+		DemuxEntry **old=t->buckets;
+		int old_size=t->size;
+		int i;
+		t->size*=2;
+		t->buckets=ms_new0(DemuxEntry*,t->size);
+		for(i=0;i<old_size;++i){
+			DemuxEntry *it=old[i];
+			while(it!=NULL){
+				DemuxEntry *next=it->next;
+				table_append(t,it);
+				it=next;
+			}
+		}
+		ms_free(old);
+	}
+	table_append(t,e);
+	t->count++;
+}
+
+static void table_remove(DemuxTable *t, DemuxEntry *e){
+	DemuxEntry **pe=&t->buckets[e->hash & (t->size-1)];
+	while(*pe!=e) pe=&(*pe)->next;
+	*pe=e->next;
+	t->count--;
+	ms_free(e);
+}
+
+static void table_remove_session(DemuxTable *t, RtpSession *session){
+	int i;
+	for(i=0;i<t->size;++i){
+		DemuxEntry **pe=&t->buckets[i];
+		while(*pe!=NULL){
+			DemuxEntry *e=*pe;
+			if (e->ep->session==session){
+				*pe=e->next;
+				t->count--;
+				ms_free(e);
+			}else pe=&e->next;
+		}
+	}
+}
+
+static void table_uninit(DemuxTable *t){
+	int i;
+	for(i=0;i<t->size;++i){
+		DemuxEntry *e=t->buckets[i];
+		while(e!=NULL){
+			DemuxEntry *next=e->next;
+			ms_free(e);
+			e=next;
+		}
+	}
+	ms_free(t->buckets);
+}
+
+static uint32_t hash_ssrc(uint32_t ssrc){
+	uint32_t h=ssrc*2654435761u;
+	return h^(h>>16);
+}
+
+static const uint8_t *address_key(const struct sockaddr *addr, int *len, uint16_t *port){
+	if (addr->sa_family==AF_INET){
+		const struct sockaddr_in *in=(const struct sockaddr_in*)addr;
+		*len=sizeof(in->sin_addr);
+		*port=in->sin_port;
+		return (const uint8_t*)&in->sin_addr;
+	}else if (addr->sa_family==AF_INET6){
+		const struct sockaddr_in6 *in6=(const struct sockaddr_in6*)addr;
+		*len=sizeof(in6->sin6_addr);
+		*port=in6->sin6_port;
+		return (const uint8_t*)&in6->sin6_addr;
+	}
+	return NULL;
+}
+
+/*FNV-1a hash of the address and port*/
+static uint32_t hash_address(const struct sockaddr *addr){
+	uint32_t h=2166136261u;
+	uint16_t port=0;
+	int len=0,i;
+	const uint8_t *key=address_key(addr,&len,&port);
+
+	for(i=0;i<len;++i) h=(h^key[i])*16777619u;
+	h=(h^(port & 0xff))*16777619u;
+	h=(h^(port>>8))*16777619u;
+	return h;
+}
+
+static bool_t address_equals(const struct sockaddr *a, const struct sockaddr *b){
+	uint16_t port_a=0,port_b=0;
+	int len_a=0,len_b=0;
+	const uint8_t *key_a,*key_b;
+
+	if (a->sa_family!=b->sa_family) return FALSE;
+	key_a=address_key(a,&len_a,&port_a);
+	key_b=address_key(b,&len_b,&port_b);
+	return key_a!=NULL && port_a==port_b && memcmp(key_a,key_b,len_a)==0;
+}
+
+static bool_t in_ticker_thread(MSRtpSharedPort *obj){
+	return (unsigned long)ms_thread_self()==obj->ticker->thread_id;
+}
+
+static void add_address(MSRtpSharedPort *obj, MSRtpEndpoint *ep){
+	DemuxEntry *e=ms_new0(DemuxEntry,1);
+	e->ep=ep;
+	memcpy(&e->addr,&ep->remote_addr,ep->remote_addrlen);
+	e->hash=hash_address((struct sockaddr*)&e->addr);
+	table_insert(&obj->addresses,e);
+}
+
+static void remove_address(MSRtpSharedPort *obj, MSRtpEndpoint *ep){
+	uint32_t hash=hash_address((struct sockaddr*)&ep->remote_addr);
+	DemuxEntry *e;
+	for(e=obj->addresses.buckets[hash & (obj->addresses.size-1)];e!=NULL;e=e->next){
+		if (e->ep==ep){
+			table_remove(&obj->addresses,e);
+			break;
+		}
+	}
+	ep->remote_addrlen=0;
+}
+
+static void set_destination(MSRtpSharedPort *obj, MSRtpEndpoint *ep, const struct sockaddr *to, socklen_t tolen){
+	if (ep->remote_addrlen>0) remove_address(obj,ep);
+	if (to==NULL || tolen==0 || tolen>(socklen_t)sizeof(struct sockaddr_storage) || (to->sa_family!=AF_INET && to->sa_family!=AF_INET6)) return;
+	memcpy(&ep->remote_addr,to,tolen);
+	ep->remote_addrlen=tolen;
+	add_address(obj,ep);
+}
+
+/*
+ * Returns the endpoint sending to the address. If endpoints of several sessions send to it (BUNDLE), the first one
+ * is returned and ambiguous is set.
+ */
+static MSRtpEndpoint *lookup_address(MSRtpSharedPort *obj, const struct sockaddr *addr, bool_t *ambiguous){
+	uint32_t hash=hash_address(addr);
+	MSRtpEndpoint *found=NULL;
+	DemuxEntry *e;
+
+	*ambiguous=FALSE;
+	for(e=obj->addresses.buckets[hash & (obj->addresses.size-1)];e!=NULL;e=e->next){
+		if (e->hash!=hash || !address_equals((struct sockaddr*)&e->addr,addr)) continue;
+		if (found==NULL) found=e->ep;
+		else if (found->session!=e->ep->session){
+			*ambiguous=TRUE;
+			break;
+		}
+	}
+	return found;
+}
+
+static DemuxEntry *lookup_ssrc(MSRtpSharedPort *obj, uint32_t ssrc){
+	uint32_t hash=hash_ssrc(ssrc);
+	DemuxEntry *e;
+	for(e=obj->ssrcs.buckets[hash & (obj->ssrcs.size-1)];e!=NULL;e=e->next){
+		if (e->ssrc==ssrc) return e;
+	}
+	return NULL;
+}
+
+static void add_ssrc(MSRtpSharedPort *obj, MSRtpEndpoint *rtp_ep, uint32_t ssrc, bool_t learnt){
+	DemuxEntry *e=ms_new0(DemuxEntry,1);
+	e->ep=rtp_ep;
+	e->ssrc=ssrc;
+	e->hash=hash_ssrc(ssrc);
+	e->learnt=learnt;
+	table_insert(&obj->ssrcs,e);
+}
+
+/*a session keeps a single learnt SSRC, the one its remote party is currently using*/
+static void learn_ssrc(MSRtpSharedPort *obj, MSRtpEndpoint *rtp_ep, uint32_t ssrc){
+	if (lookup_ssrc(obj,ssrc)!=NULL) return;
+	if (rtp_ep->ssrc_learnt){
+		DemuxEntry *old=lookup_ssrc(obj,rtp_ep->learnt_ssrc);
+		if (old!=NULL && old->ep==rtp_ep && old->learnt) table_remove(&obj->ssrcs,old);
+	}
+	add_ssrc(obj,rtp_ep,ssrc,TRUE);
+	rtp_ep->learnt_ssrc=ssrc;
+	rtp_ep->ssrc_learnt=TRUE;
+}
+
+static void dispatch(MSRtpSharedPort *obj, mblk_t *m){
+	const uint8_t *data=m->b_rptr;
+	int len=(int)(m->b_wptr-m->b_rptr);
+	bool_t ambiguous;
+	MSRtpEndpoint *ep=lookup_address(obj,(struct sockaddr*)&m->net_addr,&ambiguous);
+
+	/*RTP and RTCP packets have the version 2, STUN and DTLS packets can be told apart by their first byte (RFC 7983)*/
+	if (len>=8 && (data[0]>>6)==2){
+		bool_t is_rtcp=(data[1]>=192 && data[1]<=223);
+		uint32_t ssrc;
+		MSRtpEndpoint *rtp_ep;
+
+		if (!is_rtcp && len<12) goto discard;
+		/*the SSRC of a RTP packet, or the SSRC of the sender of a RTCP packet*/
+		memcpy(&ssrc,data+(is_rtcp ? 4 : 8),sizeof(ssrc));
+		ssrc=ntohl(ssrc);
+		if (ep==NULL || ambiguous){
+			DemuxEntry *e=lookup_ssrc(obj,ssrc);
+			if (e==NULL) goto discard;
+			rtp_ep=e->ep;
+		}else{
+			rtp_ep=ep->is_rtp ? ep : ms_rtp_endpoint_get(ep->session,TRUE,FALSE);
+			if (rtp_ep==NULL) goto discard;
+			learn_ssrc(obj,rtp_ep,ssrc);
+		}
+		ep=rtp_ep;
+		if (is_rtcp && !rtp_session_rtcp_mux_enabled(rtp_ep->session)){
+			ep=ms_rtp_endpoint_get(rtp_ep->session,FALSE,FALSE);
+			if (ep==NULL) goto discard;
+		}
+	}
+	if (ep==NULL) goto discard;
+	if (ep->recv_queue.q_mcount>=MAX_QUEUED_PACKETS){
+		/*the session is not read (not attached to the ticker, or stalled): the oldest packet would be late anyway*/
+		freemsg(getq(&ep->recv_queue));
+		obj->stats.dropped++;
+	}
+	putq(&ep->recv_queue,m);
+	return;
+discard:
+	obj->stats.discarded++;
+	freemsg(m);
+}
+
+#ifdef HAVE_RECVMMSG
+
+static void read_socket(MSRtpSharedPort *obj){
+	int i,ret;
+
+	do{
+		for(i=0;i<RECV_BATCH_SIZE;++i){
+			struct msghdr *hdr=&obj->msgs[i].msg_hdr;
+			mblk_t *slot=obj->slots[i];
+			if (slot!=NULL && (slot->b_datap->db_lim-slot->b_datap->db_base)<obj->bufsize){
+				freemsg(slot);
+				slot=NULL;
+			}
+			if (slot==NULL) slot=obj->slots[i]=allocb(obj->bufsize,0);
+			obj->iovs[i].iov_base=slot->b_wptr;
+			obj->iovs[i].iov_len=obj->bufsize;
+			memset(hdr,0,sizeof(struct msghdr));
+			hdr->msg_name=&obj->addrs[i];
+			hdr->msg_namelen=sizeof(struct sockaddr_storage);
+			hdr->msg_iov=&obj->iovs[i];
+			hdr->msg_iovlen=1;
+		}
+		ret=recvmmsg(obj->sockfd,obj->msgs,RECV_BATCH_SIZE,MSG_DONTWAIT,NULL);
+		obj->stats.syscalls++;
+		if (ret<0){
+			if (errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR){
+				ms_warning("MSRtpSharedPort[%p]: error while reading socket: %s",obj,strerror(errno));
+			}
+			return;
+		}
+		for(i=0;i<ret;++i){
+			mblk_t *m=obj->slots[i];
+			obj->slots[i]=NULL;
+			m->b_wptr+=obj->msgs[i].msg_len;
+			memcpy(&m->net_addr,&obj->addrs[i],obj->msgs[i].msg_hdr.msg_namelen);
+			m->net_addrlen=obj->msgs[i].msg_hdr.msg_namelen;
+			dispatch(obj,m);
+		}
+		obj->stats.packets+=ret;
+	}while(ret==RECV_BATCH_SIZE);
+}
+
+#else
+
+static void read_socket(MSRtpSharedPort *obj){
+	for(;;){
+		mblk_t *m=allocb(obj->bufsize,0);
+		struct sockaddr_storage from;
+		socklen_t fromlen=sizeof(from);
+		int ret=(int)recvfrom(obj->sockfd,(char*)m->b_wptr,obj->bufsize,0,(struct sockaddr*)&from,&fromlen);
+		obj->stats.syscalls++;
+		if (ret<0){
+			freemsg(m);
+			return;
+		}
+		m->b_wptr+=ret;
+		memcpy(&m->net_addr,&from,fromlen);
+		m->net_addrlen=fromlen;
+		obj->stats.packets++;
+		dispatch(obj,m);
+	}
+}
+
+#endif
+
+int ms_rtp_shared_port_recv(MSRtpSharedPort *obj, MSRtpEndpoint *ep, mblk_t *msg, int flags, struct sockaddr *from, socklen_t *fromlen){
+	/*the socket is read once per tick, by the ticker thread only*/
+	if (in_ticker_thread(obj) && obj->polled_tick!=obj->ticker->ticks){
+		obj->polled_tick=obj->ticker->ticks;
+		read_socket(obj);
+	}
+	return ms_rtp_endpoint_read_queue(ep,msg,from,fromlen);
+}
+
+int ms_rtp_shared_port_register_destination(MSRtpSharedPort *obj, MSRtpEndpoint *ep, const struct sockaddr *to, socklen_t tolen){
+	if (to==NULL || (ep->remote_addrlen==tolen && memcmp(&ep->remote_addr,to,tolen)==0)) return 0;
+	/*
+	 * The tables are modified by the ticker thread, or with the ticker lock held. The lock cannot be taken here, as
+	 * the sender may already hold it, for instance when a RTCP BYE is sent while the graph is being detached.
+	 */
+	if (!in_ticker_thread(obj)) return -1;
+	set_destination(obj,ep,to,tolen);
+	return 0;
+}
+
+static ortp_socket_t create_socket(const char *local_ip, int port, int *bound_port){
+	struct addrinfo hints,*res=NULL;
+	struct sockaddr_storage addr;
+	socklen_t addrlen=sizeof(addr);
+	char portstr[8];
+	ortp_socket_t sock;
+	int optval;
+	int err;
+
+	memset(&hints,0,sizeof(hints));
+	hints.ai_family=PF_UNSPEC;
+	hints.ai_socktype=SOCK_DGRAM;
+	hints.ai_flags=AI_NUMERICHOST;
+	snprintf(portstr,sizeof(portstr),"%i",port);
+	err=getaddrinfo(local_ip,portstr,&hints,&res);
+	if (err!=0){
+		ms_error("MSRtpSharedPort: invalid local address %s: %s",local_ip,gai_strerror(err));
+		return (ortp_socket_t)-1;
+	}
+	sock=socket(res->ai_family,SOCK_DGRAM,0);
+	if (sock==(ortp_socket_t)-1){
+		ms_error("MSRtpSharedPort: cannot create socket: %s",getSocketError());
+		freeaddrinfo(res);
+		return sock;
+	}
+	if (res->ai_family==AF_INET6){
+		/*accept IPv4 packets too*/
+		optval=0;
+		setsockopt(sock,IPPROTO_IPV6,IPV6_V6ONLY,(const char*)&optval,sizeof(optval));
+	}
+	if (bind(sock,res->ai_addr,(socklen_t)res->ai_addrlen)!=0){
+		ms_error("MSRtpSharedPort: cannot bind to %s port %i: %s",local_ip,port,getSocketError());
+		freeaddrinfo(res);
+		close_socket(sock);
+		return (ortp_socket_t)-1;
+	}
+	freeaddrinfo(res);
+	optval=SOCKET_RECV_BUFFER_SIZE;
+	if (setsockopt(sock,SOL_SOCKET,SO_RCVBUF,(const char*)&optval,sizeof(optval))!=0){
+		ms_warning("MSRtpSharedPort: cannot set the receive buffer size: %s",getSocketError());
+	}
+	set_non_blocking_socket(sock);
+	*bound_port=port;
+	if (getsockname(sock,(struct sockaddr*)&addr,&addrlen)==0){
+		if (addr.ss_family==AF_INET) *bound_port=ntohs(((struct sockaddr_in*)&addr)->sin_port);
+		else if (addr.ss_family==AF_INET6) *bound_port=ntohs(((struct sockaddr_in6*)&addr)->sin6_port);
+	}
+	return sock;
+}
+
+MSRtpSharedPort *ms_rtp_shared_port_new(MSTicker *ticker, const char *local_ip, int port){
+	MSRtpSharedPort *obj;
+	int bound_port=0;
+	ortp_socket_t sock=create_socket(local_ip,port,&bound_port);
+
+	if (sock==(ortp_socket_t)-1) return NULL;
+	obj=ms_new0(MSRtpSharedPort,1);
+	obj->ticker=ticker;
+	obj->sockfd=sock;
+	obj->local_port=bound_port;
+	obj->bufsize=DEFAULT_RECV_BUF_SIZE;
+	table_init(&obj->addresses);
+	table_init(&obj->ssrcs);
+	ms_message("MSRtpSharedPort[%p]: listening on %s port %i",obj,local_ip,bound_port);
+	return obj;
+}
+
+int ms_rtp_shared_port_get_local_port(const MSRtpSharedPort *obj){
+	return obj->local_port;
+}
+
+/*to be called with the ticker lock held, so that the ticker thread is not using the endpoint*/
+static void remove_endpoint(MSRtpSharedPort *obj, MSRtpEndpoint *ep){
+	if (ep->remote_addrlen>0) remove_address(obj,ep);
+	table_remove_session(&obj->ssrcs,ep->session);
+	flushq(&ep->recv_queue,0);
+	obj->endpoints=bctbx_list_remove(obj->endpoints,ep);
+	ep->shared_port=NULL;
+	ms_rtp_endpoint_release(ep);
+}
+
+void ms_rtp_shared_port_forget_endpoint(MSRtpSharedPort *obj, MSRtpEndpoint *ep){
+	ms_warning("MSRtpSharedPort[%p]: session [%p] destroyed while using the shared port",obj,ep->session);
+	ms_mutex_lock(&obj->ticker->lock);
+	if (ep->remote_addrlen>0) remove_address(obj,ep);
+	table_remove_session(&obj->ssrcs,ep->session);
+	obj->endpoints=bctbx_list_remove(obj->endpoints,ep);
+	ep->shared_port=NULL;
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+int ms_rtp_shared_port_add_session(MSRtpSharedPort *obj, RtpSession *session){
+	MSRtpEndpoint *rtp_ep;
+	MSRtpEndpoint *rtcp_ep;
+	int ret=0;
+
+	if (rtp_session_get_rtp_socket(session)!=(ortp_socket_t)-1){
+		ms_error("MSRtpSharedPort[%p]: session [%p] already has its own sockets",obj,session);
+		return -1;
+	}
+	ms_mutex_lock(&obj->ticker->lock);
+	rtp_ep=ms_rtp_endpoint_get(session,TRUE,TRUE);
+	rtcp_ep=ms_rtp_endpoint_get(session,FALSE,TRUE);
+	if (rtp_ep==NULL || rtcp_ep==NULL){
+		ms_error("MSRtpSharedPort[%p]: session [%p] has no transport or already has a transport endpoint, it cannot use a shared port",obj,session);
+		ret=-1;
+	}else if (rtp_ep->shared_port!=NULL || rtp_ep->multiplexer!=NULL){
+		ms_error("MSRtpSharedPort[%p]: session [%p] is already using a shared port or a multiplexer",obj,session);
+		ret=-1;
+	}
+	if (ret==0){
+		rtp_ep->shared_port=obj;
+		rtcp_ep->shared_port=obj;
+		obj->endpoints=bctbx_list_append(obj->endpoints,rtp_ep);
+		obj->endpoints=bctbx_list_append(obj->endpoints,rtcp_ep);
+		if (session->recv_buf_size>obj->bufsize) obj->bufsize=session->recv_buf_size;
+		rtp_session_set_sockets(session,obj->sockfd,obj->sockfd);
+		/*the shared socket is not connected: the destination must be given for every packet*/
+		session->flags&=~(RTP_SOCKET_CONNECTED|RTCP_SOCKET_CONNECTED);
+		/*the remote addresses may be known already, so that the packets can be received before anything is sent*/
+		set_destination(obj,rtp_ep,(struct sockaddr*)&session->rtp.gs.rem_addr,session->rtp.gs.rem_addrlen);
+		set_destination(obj,rtcp_ep,(struct sockaddr*)&session->rtcp.gs.rem_addr,session->rtcp.gs.rem_addrlen);
+	}else{
+		if (rtp_ep) ms_rtp_endpoint_release(rtp_ep);
+		if (rtcp_ep) ms_rtp_endpoint_release(rtcp_ep);
+	}
+	ms_mutex_unlock(&obj->ticker->lock);
+	return ret;
+}
+
+void ms_rtp_shared_port_add_remote_ssrc(MSRtpSharedPort *obj, RtpSession *session, uint32_t ssrc){
+	MSRtpEndpoint *rtp_ep;
+	DemuxEntry *e;
+
+	ms_mutex_lock(&obj->ticker->lock);
+	rtp_ep=ms_rtp_endpoint_get(session,TRUE,FALSE);
+	if (rtp_ep==NULL || rtp_ep->shared_port!=obj){
+		ms_error("MSRtpSharedPort[%p]: session [%p] does not use this shared port",obj,session);
+	}else{
+		e=lookup_ssrc(obj,ssrc);
+		/*a declared SSRC replaces a learnt one*/
+		if (e!=NULL && e->learnt){
+			if (e->ep->learnt_ssrc==ssrc) e->ep->ssrc_learnt=FALSE;
+			table_remove(&obj->ssrcs,e);
+			e=NULL;
+		}
+		if (e==NULL) add_ssrc(obj,rtp_ep,ssrc,FALSE);
+		else if (e->ep!=rtp_ep) ms_error("MSRtpSharedPort[%p]: SSRC %u is already declared by session [%p]",obj,ssrc,e->ep->session);
+	}
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+/*to be called with the ticker lock held*/
+static void remove_session(MSRtpSharedPort *obj, RtpSession *session){
+	bctbx_list_t *elem,*next;
+	bool_t found=FALSE;
+
+	for(elem=obj->endpoints;elem!=NULL;elem=next){
+		MSRtpEndpoint *ep=(MSRtpEndpoint*)elem->data;
+		next=elem->next;
+		if (ep->session==session){
+			remove_endpoint(obj,ep);
+			found=TRUE;
+		}
+	}
+	/*so that the session does not read the shared socket by itself*/
+	if (found) rtp_session_set_sockets(session,-1,-1);
+}
+
+void ms_rtp_shared_port_remove_session(MSRtpSharedPort *obj, RtpSession *session){
+	ms_mutex_lock(&obj->ticker->lock);
+	remove_session(obj,session);
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+void ms_rtp_shared_port_get_stats(MSRtpSharedPort *obj, MSRtpSharedPortStats *stats){
+	ms_mutex_lock(&obj->ticker->lock);
+	*stats=obj->stats;
+	ms_mutex_unlock(&obj->ticker->lock);
+}
+
+void ms_rtp_shared_port_destroy(MSRtpSharedPort *obj){
+	ms_mutex_lock(&obj->ticker->lock);
+	while(obj->endpoints!=NULL) remove_session(obj,((MSRtpEndpoint*)obj->endpoints->data)->session);
+	ms_mutex_unlock(&obj->ticker->lock);
+	ms_message("MSRtpSharedPort[%p]: %llu packets read with %llu system calls, %llu discarded, %llu dropped",obj,
+		(unsigned long long)obj->stats.packets,(unsigned long long)obj->stats.syscalls,(unsigned long long)obj->stats.discarded,
+		(unsigned long long)obj->stats.dropped);
+#ifdef HAVE_RECVMMSG
+	{
+		int i;
+		for(i=0;i<RECV_BATCH_SIZE;++i){
+			if (obj->slots[i]) freemsg(obj->slots[i]);
+		}
+	}
+#endif
+	table_uninit(&obj->addresses);
+	table_uninit(&obj->ssrcs);
+	close_socket(obj->sockfd);
+	ms_free(obj);
+}
@@ -30,6 +30,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #if MS_HAS_ARM
 #include "msvideo_neon.h"
 #endif
+#include "msvideo_x86.h"
 
 #ifndef INT32_MAX
 #define INT32_MAX 017777777777
@@ -47,6 +48,8 @@ const char *ms_pix_fmt_to_string(MSPixFmt fmt){
 		case MS_RGBA32: return "MS_RGBA32";
 		case MS_RGB565: return "MS_RGB565";
 		case MS_H264: return "MS_H264";
+		case MS_NV12: return "MS_NV12";
+		case MS_NV21: return "MS_NV21";
 		case MS_PIX_FMT_UNKNOWN: return "MS_PIX_FMT_UNKNOWN";
 	}
 	return "bad format";
@@ -213,6 +216,19 @@ void ms_yuv_buf_allocator_free(MSYuvBufAllocator *obj) {
 	}
 }
 
+#if MS_HAS_X86_VIDEO_KERNELS
+static int hasSsse3 = -1;
+
+static bool_t use_x86_kernels(void){
+	if (hasSsse3 == -1) hasSsse3 = ms_video_x86_kernels_supported();
+	return hasSsse3;
+}
+
+void ms_video_enable_x86_kernels(bool_t enabled){
+	hasSsse3 = enabled ? ms_video_x86_kernels_supported() : FALSE;
+}
+#endif
+
 static void plane_horizontal_mirror(uint8_t *p, int linesize, int w, int h){
 	int i,j;
 	uint8_t tmp;
@@ -257,6 +273,24 @@ static void plane_vertical_mirror(uint8_t *p, int linesize, int w, int h){
 }
 
 static void plane_mirror(MSMirrorType type, uint8_t *p, int linesize, int w, int h){
+#if MS_HAS_X86_VIDEO_KERNELS
+	if (use_x86_kernels()){
+		switch (type){
+			case MS_HORIZONTAL_MIRROR:
+				plane_horizontal_mirror_x86(p,linesize,w,h);
+				break;
+			case MS_VERTICAL_MIRROR:
+				plane_vertical_mirror_x86(p,linesize,w,h);
+				break;
+			case MS_CENTRAL_MIRROR:
+				plane_central_mirror_x86(p,linesize,w,h);
+				break;
+			case MS_NO_MIRROR:
+				break;
+		}
+		return;
+	}
+#endif
 	switch (type){
 		case MS_HORIZONTAL_MIRROR:
 			 plane_horizontal_mirror(p,linesize,w,h);
@@ -306,6 +340,12 @@ MSPixFmt ms_fourcc_to_pix_fmt(uint32_t fourcc){
 		case MAKEFOURCC('M','J','P','G'):
 			ret=MS_MJPEG;
 		break;
+		case MAKEFOURCC('N','V','1','2'):
+			ret=MS_NV12;
+		break;
+		case MAKEFOURCC('N','V','2','1'):
+			ret=MS_NV21;
+		break;
 		case 0: /*BI_RGB on windows*/
 			ret=MS_RGB24;
 		break;
@@ -319,6 +359,12 @@ void rgb24_mirror(uint8_t *buf, int w, int h, int linesize){
 	int i,j;
 	int r,g,b;
 	int end=w*3;
+#if MS_HAS_X86_VIDEO_KERNELS
+	if (use_x86_kernels()){
+		rgb24_mirror_x86(buf,w,h,linesize);
+		return;
+	}
+#endif
 	for(i=0;i<h;++i){
 		for(j=0;j<end/2;j+=3){
 			r=buf[j];
@@ -419,6 +465,10 @@ int ms_pix_fmt_to_ffmpeg(MSPixFmt fmt){
 			return AV_PIX_FMT_YUYV422;   /* <- same as MS_YUYV */
 		case MS_RGB565:
 			return AV_PIX_FMT_RGB565;
+		case MS_NV12:
+			return AV_PIX_FMT_NV12;
+		case MS_NV21:
+			return AV_PIX_FMT_NV21;
 		default:
 			ms_fatal("format not supported.");
 			return -1;
@@ -442,6 +492,10 @@ MSPixFmt ffmpeg_pix_fmt_to_ms(int fmt){
 			return MS_RGBA32;
 		case AV_PIX_FMT_RGB565:
 			return MS_RGB565;
+		case AV_PIX_FMT_NV12:
+			return MS_NV12;
+		case AV_PIX_FMT_NV21:
+			return MS_NV21;
 		default:
 			ms_fatal("format not supported.");
 			return MS_YUV420P; /* default */
@@ -599,11 +653,44 @@ static MSScalerDesc android_scaler={
 extern MSScalerDesc ms_android_scaler;
 #endif 
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_X86_SCALER
+extern MSScalerDesc ms_x86_scaler;
+#endif
+
 static MSScalerDesc *scaler_impl=NULL;
 
+/* pictures smaller than this are not worth the synchronization with the worker threads */
+#define MS_SCALER_SLICING_MIN_PIXELS (1280*720)
+#define MS_SCALER_MAX_SLICES 8
+
+typedef struct _MSScalerSlice{
+	MSScalerDesc *desc;
+	MSScalerContext *ctx;
+	uint8_t *src[4];
+	int *src_strides;
+	uint8_t *dst[4];
+	int *dst_strides;
+	int ret;
+}MSScalerSlice;
+
+/* the context returned by ms_scaler_create_context(), wrapping the one of the implementation.
+ * When slicing is enabled, each slice has its own implementation context, so that they can run concurrently.*/
+typedef struct _MSSlicedScalerContext{
+	MSScalerDesc *desc;
+	MSScalerContext *ctx;
+	int src_w,src_h,dst_w,dst_h;
+	MSPixFmt src_fmt,dst_fmt;
+	int flags;
+	MSWorkerPool *pool;
+	int nslices;
+	MSScalerSlice slices[MS_SCALER_MAX_SLICES];
+}MSSlicedScalerContext;
 
 MSScalerContext *ms_scaler_create_context(int src_w, int src_h, MSPixFmt src_fmt,
                                           int dst_w, int dst_h, MSPixFmt dst_fmt, int flags){
+	MSSlicedScalerContext *sctx;
+	MSScalerContext *ctx;
 	if (!scaler_impl){
 #if defined(ANDROID) && defined(MS_HAS_ARM)
 		if (android_getCpuFamily() == ANDROID_CPU_FAMILY_ARM && (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON) != 0){
@@ -611,27 +698,175 @@ MSScalerContext *ms_scaler_create_context(int src_w, int src_h, MSPixFmt src_fmt
 		}
 #elif !defined(NO_FFMPEG)
 		scaler_impl=&ffmpeg_scaler;
+#elif defined(HAVE_X86_SCALER)
+		/*without ffmpeg, the x86 scaler is better than no scaler at all*/
+		scaler_impl=&ms_x86_scaler;
 #endif
 	}
 	
-	if (scaler_impl)
-		return scaler_impl->create_context(src_w,src_h,src_fmt,dst_w,dst_h,dst_fmt, flags);
-	ms_fatal("No scaler implementation built-in, please supply one with ms_video_set_scaler_impl ()");
-	return NULL;
+	if (!scaler_impl){
+		ms_fatal("No scaler implementation built-in, please supply one with ms_video_set_scaler_impl ()");
+		return NULL;
+	}
+	ctx=scaler_impl->create_context(src_w,src_h,src_fmt,dst_w,dst_h,dst_fmt, flags);
+	if (ctx==NULL) return NULL;
+	sctx=ms_new0(MSSlicedScalerContext,1);
+	sctx->desc=scaler_impl;
+	sctx->ctx=ctx;
+	sctx->src_w=src_w;
+	sctx->src_h=src_h;
+	sctx->src_fmt=src_fmt;
+	sctx->dst_w=dst_w;
+	sctx->dst_h=dst_h;
+	sctx->dst_fmt=dst_fmt;
+	sctx->flags=flags;
+	sctx->nslices=1;
+	return (MSScalerContext*)sctx;
+}
+
+/* returns the number of rows a slice height must be a multiple of, or 0 if the format can't be sliced */
+static int pix_fmt_slice_alignment(MSPixFmt fmt){
+	switch(fmt){
+		case MS_YUV420P:
+		case MS_NV12:
+		case MS_NV21:
+			return 2;
+		case MS_YUYV:
+		case MS_UYVY:
+		case MS_YUY2:
+		case MS_RGB24:
+		case MS_RGB24_REV:
+		case MS_RGBA32:
+		case MS_RGB565:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/* computes the planes of the picture starting at row y */
+static void pix_fmt_offset_planes(MSPixFmt fmt, uint8_t *planes[], int strides[], int y, uint8_t *ret[]){
+	int i;
+	ret[0]=planes[0]+y*strides[0];
+	for(i=1;i<4;i++){
+		if (planes[i]!=NULL && (fmt==MS_YUV420P || fmt==MS_NV12 || fmt==MS_NV21)){
+			ret[i]=planes[i]+(y/2)*strides[i];
+		}else ret[i]=planes[i];
+	}
+}
+
+static void scaler_release_slices(MSSlicedScalerContext *sctx){
+	int i;
+	for(i=0;i<MS_SCALER_MAX_SLICES;i++){
+		if (sctx->slices[i].ctx) sctx->desc->context_free(sctx->slices[i].ctx);
+	}
+	memset(sctx->slices,0,sizeof(sctx->slices));
+	sctx->nslices=1;
+}
+
+void ms_scaler_context_enable_slicing(MSScalerContext *ctx, MSWorkerPool *pool){
+	MSSlicedScalerContext *sctx=(MSSlicedScalerContext*)ctx;
+	int src_align=pix_fmt_slice_alignment(sctx->src_fmt);
+	int dst_align=pix_fmt_slice_alignment(sctx->dst_fmt);
+	int max_slices,n,i;
+
+	scaler_release_slices(sctx);
+	sctx->pool=pool;
+	if (pool==NULL || src_align==0 || dst_align==0) return;
+	if (MAX(sctx->src_w*sctx->src_h,sctx->dst_w*sctx->dst_h)<MS_SCALER_SLICING_MIN_PIXELS) return;
+	/*the calling thread processes one of the slices*/
+	max_slices=MIN(MS_SCALER_MAX_SLICES,ms_worker_pool_get_thread_count(pool)+1);
+	/*each slice is scaled with the same ratio as the whole picture, so both heights must be split evenly*/
+	for(n=max_slices;n>1;n--){
+		if (sctx->src_h%(n*src_align)==0 && sctx->dst_h%(n*dst_align)==0) break;
+	}
+	if (n<2) return;
+	for(i=0;i<n;i++){
+		MSScalerSlice *slice=&sctx->slices[i];
+		slice->desc=sctx->desc;
+		slice->ctx=sctx->desc->create_context(sctx->src_w,sctx->src_h/n,sctx->src_fmt,sctx->dst_w,sctx->dst_h/n,sctx->dst_fmt,sctx->flags);
+		if (slice->ctx==NULL){
+			ms_warning("Cannot create scaler context for slice %i, slicing disabled.",i);
+			scaler_release_slices(sctx);
+			return;
+		}
+	}
+	sctx->nslices=n;
+	ms_message("Scaler context [%p]: %ix%i %s to %ix%i %s done in %i slices.",ctx,sctx->src_w,sctx->src_h,ms_pix_fmt_to_string(sctx->src_fmt),
+		sctx->dst_w,sctx->dst_h,ms_pix_fmt_to_string(sctx->dst_fmt),n);
+}
+
+static void scaler_slice_process(void *data){
+	MSScalerSlice *slice=(MSScalerSlice*)data;
+	slice->ret=slice->desc->context_process(slice->ctx,slice->src,slice->src_strides,slice->dst,slice->dst_strides);
 }
 
 int ms_scaler_process(MSScalerContext *ctx, uint8_t *src[], int src_strides[], uint8_t *dst[], int dst_strides[]){
-	return scaler_impl->context_process(ctx,src,src_strides,dst,dst_strides);
+	MSSlicedScalerContext *sctx=(MSSlicedScalerContext*)ctx;
+	void *slices[MS_SCALER_MAX_SLICES];
+	int i;
+
+	if (sctx->nslices<2) return sctx->desc->context_process(sctx->ctx,src,src_strides,dst,dst_strides);
+
+	for(i=0;i<sctx->nslices;i++){
+		MSScalerSlice *slice=&sctx->slices[i];
+		pix_fmt_offset_planes(sctx->src_fmt,src,src_strides,i*(sctx->src_h/sctx->nslices),slice->src);
+		pix_fmt_offset_planes(sctx->dst_fmt,dst,dst_strides,i*(sctx->dst_h/sctx->nslices),slice->dst);
+		slice->src_strides=src_strides;
+		slice->dst_strides=dst_strides;
+		slices[i]=slice;
+	}
+	ms_worker_pool_run(sctx->pool,scaler_slice_process,slices,sctx->nslices);
+	for(i=0;i<sctx->nslices;i++){
+		if (sctx->slices[i].ret<0) return sctx->slices[i].ret;
+	}
+	return 0;
+}
+
+int ms_scaler_process_in_filter(MSFilter *f, MSScalerContext *ctx, uint8_t *src[], int src_strides[], uint8_t *dst[], int dst_strides[]){
+	MSTimeSpec start,stop;
+	int ret;
+
+	if (f->stats==NULL) return ms_scaler_process(ctx,src,src_strides,dst,dst_strides);
+	ms_get_cur_time(&start);
+	ret=ms_scaler_process(ctx,src,src_strides,dst,dst_strides);
+	ms_get_cur_time(&stop);
+	f->stats->scaling_count++;
+	f->stats->scaling_elapsed+=(stop.tv_sec-start.tv_sec)*1000000000LL + (stop.tv_nsec-start.tv_nsec);
+	return ret;
 }
 
 void ms_scaler_context_free(MSScalerContext *ctx){
-	scaler_impl->context_free(ctx);
+	MSSlicedScalerContext *sctx=(MSSlicedScalerContext*)ctx;
+	scaler_release_slices(sctx);
+	sctx->desc->context_free(sctx->ctx);
+	ms_free(sctx);
 }
 
 void ms_video_set_scaler_impl(MSScalerDesc *desc){
 	scaler_impl=desc;
 }
 
+MSScalerDesc * ms_video_get_scaler_impl(void){
+	return scaler_impl;
+}
+
+MSScalerDesc * ms_video_get_x86_scaler_impl(void){
+#ifdef HAVE_X86_SCALER
+	return &ms_x86_scaler;
+#else
+	return NULL;
+#endif
+}
+
+MSScalerDesc * ms_video_get_ffmpeg_scaler_impl(void){
+#ifndef NO_FFMPEG
+	return &ffmpeg_scaler;
+#else
+	return NULL;
+#endif
+}
+
 /* Can rotate Y, U or V plane; use step=2 for interleaved UV planes otherwise step=1*/
 static void rotate_plane_down_scale_by_2(int wDest, int hDest, int full_width, const uint8_t* src, uint8_t* dst, int step, bool_t clockWise,bool_t downscale) {
 	int factor = downscale?2:1;
@@ -716,6 +951,11 @@ mblk_t *copy_ycbcrbiplanar_to_true_yuv_with_rotation_and_down_scale_by_2(MSYuvBu
 			if (hasNeon) {
 				deinterlace_down_scale_neon(y, cbcr, pict.planes[0], u_dest, v_dest, w, h, y_byte_per_row, cbcr_byte_per_row,down_scale);
 			} else
+#endif
+#if MS_HAS_X86_VIDEO_KERNELS
+			if (use_x86_kernels()) {
+				deinterlace_down_scale_x86(y, cbcr, pict.planes[0], u_dest, v_dest, w, h, y_byte_per_row, cbcr_byte_per_row,down_scale);
+			} else
 #endif
 			{
 				// plain copy
@@ -741,6 +981,11 @@ mblk_t *copy_ycbcrbiplanar_to_true_yuv_with_rotation_and_down_scale_by_2(MSYuvBu
 			if (hasNeon) {
 				deinterlace_down_scale_and_rotate_180_neon(y, cbcr, pict.planes[0], u_dest, v_dest, w, h, y_byte_per_row, cbcr_byte_per_row,down_scale);
 			} else
+#endif
+#if MS_HAS_X86_VIDEO_KERNELS
+			if (use_x86_kernels()) {
+				deinterlace_down_scale_and_rotate_180_x86(y, cbcr, pict.planes[0], u_dest, v_dest, w, h, y_byte_per_row, cbcr_byte_per_row,down_scale);
+			} else
 #endif
 			{
 				// 180° y rotation
@@ -770,6 +1015,11 @@ mblk_t *copy_ycbcrbiplanar_to_true_yuv_with_rotation_and_down_scale_by_2(MSYuvBu
 			}
 		} else
 #endif
+#if MS_HAS_X86_VIDEO_KERNELS
+		if (use_x86_kernels()) {
+			rotate_down_scale_plane_x86(w,h,y_byte_per_row,y,pict.planes[0],clockwise,down_scale);
+		} else
+#endif
 {
 			uint8_t* dsty = pict.planes[0];
 			uint8_t* srcy = (uint8_t*) y;
@@ -781,6 +1031,11 @@ mblk_t *copy_ycbcrbiplanar_to_true_yuv_with_rotation_and_down_scale_by_2(MSYuvBu
 			rotate_down_scale_cbcr_to_cr_cb(uv_w,uv_h, cbcr_byte_per_row/2, (uint8_t*)cbcr, pict.planes[2], pict.planes[1],clockwise,down_scale);
 		} else
 #endif
+#if MS_HAS_X86_VIDEO_KERNELS
+		if (use_x86_kernels()) {
+			rotate_down_scale_cbcr_x86(uv_w,uv_h,cbcr_byte_per_row/2,cbcr,pict.planes[1],pict.planes[2],clockwise,down_scale);
+		} else
+#endif
 {
 			// Copying U
 			srcu = cbcr;
@@ -0,0 +1,470 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "msvideo_x86.h"
+
+#if MS_HAS_X86_VIDEO_KERNELS
+
+#include <string.h>
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SSSE3_FUNC
+#else
+#include <immintrin.h>
+#define X86_HAVE_AVX2
+#define SSSE3_FUNC __attribute__((target("ssse3")))
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+
+static int cpu_level = -1; /*0: no SSSE3, 1: SSSE3, 2: AVX2*/
+
+static int get_cpu_level(void){
+	if (cpu_level == -1){
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		cpu_level = (info[2] & (1<<9)) ? 1 : 0;
+#else
+		cpu_level = __builtin_cpu_supports("ssse3") ? 1 : 0;
+		if (cpu_level && __builtin_cpu_supports("avx2")) cpu_level = 2;
+#endif
+	}
+	return cpu_level;
+}
+
+bool_t ms_video_x86_kernels_supported(void){
+	return get_cpu_level() > 0;
+}
+
+/* ---- mirroring ---- */
+
+SSSE3_FUNC static MS2_INLINE __m128i reverse_16bytes(__m128i v){
+	return _mm_shuffle_epi8(v, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+/*reverses a row in place, starting at the i-th pixel from both ends*/
+SSSE3_FUNC static void row_reverse_ssse3(uint8_t *p, int w, int i){
+	uint8_t tmp;
+	for (; 2*i + 32 <= w; i += 16){
+		__m128i l = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i r = _mm_loadu_si128((const __m128i *)(p + w - 16 - i));
+		_mm_storeu_si128((__m128i *)(p + i), reverse_16bytes(r));
+		_mm_storeu_si128((__m128i *)(p + w - 16 - i), reverse_16bytes(l));
+	}
+	for (; i < w/2; ++i){
+		tmp = p[i];
+		p[i] = p[w - 1 - i];
+		p[w - 1 - i] = tmp;
+	}
+}
+
+/*a becomes the reversed b, and b the reversed a, starting at the k-th pixel of a*/
+SSSE3_FUNC static void rows_reverse_swap_ssse3(uint8_t *a, uint8_t *b, int w, int k){
+	uint8_t tmp;
+	for (; k + 16 <= w; k += 16){
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + k));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + w - 16 - k));
+		_mm_storeu_si128((__m128i *)(a + k), reverse_16bytes(vb));
+		_mm_storeu_si128((__m128i *)(b + w - 16 - k), reverse_16bytes(va));
+	}
+	for (; k < w; ++k){
+		tmp = a[k];
+		a[k] = b[w - 1 - k];
+		b[w - 1 - k] = tmp;
+	}
+}
+
+static void rows_swap_sse2(uint8_t *a, uint8_t *b, int w, int k){
+	uint8_t tmp;
+	for (; k + 16 <= w; k += 16){
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + k));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + k));
+		_mm_storeu_si128((__m128i *)(a + k), vb);
+		_mm_storeu_si128((__m128i *)(b + k), va);
+	}
+	for (; k < w; ++k){
+		tmp = a[k];
+		a[k] = b[k];
+		b[k] = tmp;
+	}
+}
+
+#ifdef X86_HAVE_AVX2
+
+/* The AVX2 versions finish with the SSSE3 ones, after clearing the upper halves of the registers
+ * to avoid the AVX to SSE transition penalty.*/
+
+AVX2_FUNC static MS2_INLINE __m256i reverse_32bytes(__m256i v){
+	/*pshufb works within 128 bits lanes: reverse each lane, then swap them*/
+	v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+		15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+	return _mm256_permute4x64_epi64(v, 0x4e);
+}
+
+AVX2_FUNC static void row_reverse_avx2(uint8_t *p, int w){
+	int i = 0;
+	for (; 2*i + 64 <= w; i += 32){
+		__m256i l = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i r = _mm256_loadu_si256((const __m256i *)(p + w - 32 - i));
+		_mm256_storeu_si256((__m256i *)(p + i), reverse_32bytes(r));
+		_mm256_storeu_si256((__m256i *)(p + w - 32 - i), reverse_32bytes(l));
+	}
+	_mm256_zeroupper();
+	row_reverse_ssse3(p, w, i);
+}
+
+AVX2_FUNC static void rows_reverse_swap_avx2(uint8_t *a, uint8_t *b, int w){
+	int k = 0;
+	for (; k + 32 <= w; k += 32){
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + k));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + w - 32 - k));
+		_mm256_storeu_si256((__m256i *)(a + k), reverse_32bytes(vb));
+		_mm256_storeu_si256((__m256i *)(b + w - 32 - k), reverse_32bytes(va));
+	}
+	_mm256_zeroupper();
+	rows_reverse_swap_ssse3(a, b, w, k);
+}
+
+AVX2_FUNC static void rows_swap_avx2(uint8_t *a, uint8_t *b, int w){
+	int k = 0;
+	for (; k + 32 <= w; k += 32){
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + k));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + k));
+		_mm256_storeu_si256((__m256i *)(a + k), vb);
+		_mm256_storeu_si256((__m256i *)(b + k), va);
+	}
+	_mm256_zeroupper();
+	rows_swap_sse2(a, b, w, k);
+}
+
+#endif
+
+void plane_horizontal_mirror_x86(uint8_t *p, int linesize, int w, int h){
+	int j;
+	for (j = 0; j < h; ++j){
+#ifdef X86_HAVE_AVX2
+		if (get_cpu_level() >= 2) row_reverse_avx2(p, w);
+		else
+#endif
+		row_reverse_ssse3(p, w, 0);
+		p += linesize;
+	}
+}
+
+/*same as a 180° rotation, except that like the portable version it leaves the middle row of pictures with an odd height untouched*/
+void plane_central_mirror_x86(uint8_t *p, int linesize, int w, int h){
+	uint8_t *bottom_line = p + (h-1)*linesize;
+	int j;
+	for (j = 0; j < h/2; ++j){
+#ifdef X86_HAVE_AVX2
+		if (get_cpu_level() >= 2) rows_reverse_swap_avx2(p, bottom_line, w);
+		else
+#endif
+		rows_reverse_swap_ssse3(p, bottom_line, w, 0);
+		p += linesize;
+		bottom_line -= linesize;
+	}
+}
+
+void plane_vertical_mirror_x86(uint8_t *p, int linesize, int w, int h){
+	uint8_t *bottom_line = p + (h-1)*linesize;
+	int j;
+	for (j = 0; j < h/2; ++j){
+#ifdef X86_HAVE_AVX2
+		if (get_cpu_level() >= 2) rows_swap_avx2(p, bottom_line, w);
+		else
+#endif
+		rows_swap_sse2(p, bottom_line, w, 0);
+		p += linesize;
+		bottom_line -= linesize;
+	}
+}
+
+/* Swaps 10 pixels (30 bytes) from each end of the row per iteration. Each block is loaded and stored as two overlapping
+ * 16 bytes vectors, at offsets 0 and 14, so that nothing is read or written out of the block. The same shuffles
+ * reverse the left block into the right one and the right block into the left one.*/
+SSSE3_FUNC static void rgb24_row_reverse_ssse3(uint8_t *p, int w){
+	const __m128i lo_from_hi = _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1);
+	const __m128i lo_from_lo = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 12);
+	const __m128i hi_from_lo = _mm_setr_epi8(-1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2);
+	const __m128i hi_from_hi = _mm_setr_epi8(3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	int end = w*3;
+	int i = 0, j;
+	uint8_t r, g, b;
+
+	for (; 2*i + 20 <= w; i += 10){
+		uint8_t *left = p + 3*i;
+		uint8_t *right = p + 3*(w - 10 - i);
+		__m128i l0 = _mm_loadu_si128((const __m128i *)left);
+		__m128i l1 = _mm_loadu_si128((const __m128i *)(left + 14));
+		__m128i r0 = _mm_loadu_si128((const __m128i *)right);
+		__m128i r1 = _mm_loadu_si128((const __m128i *)(right + 14));
+		_mm_storeu_si128((__m128i *)left, _mm_or_si128(_mm_shuffle_epi8(r1, lo_from_hi), _mm_shuffle_epi8(r0, lo_from_lo)));
+		_mm_storeu_si128((__m128i *)(left + 14), _mm_or_si128(_mm_shuffle_epi8(r0, hi_from_lo), _mm_shuffle_epi8(r1, hi_from_hi)));
+		_mm_storeu_si128((__m128i *)right, _mm_or_si128(_mm_shuffle_epi8(l1, lo_from_hi), _mm_shuffle_epi8(l0, lo_from_lo)));
+		_mm_storeu_si128((__m128i *)(right + 14), _mm_or_si128(_mm_shuffle_epi8(l0, hi_from_lo), _mm_shuffle_epi8(l1, hi_from_hi)));
+	}
+	for (j = 3*i; j < end/2; j += 3){
+		r = p[j];
+		g = p[j+1];
+		b = p[j+2];
+		p[j] = p[end-j-3];
+		p[j+1] = p[end-j-2];
+		p[j+2] = p[end-j-1];
+		p[end-j-3] = r;
+		p[end-j-2] = g;
+		p[end-j-1] = b;
+	}
+}
+
+void rgb24_mirror_x86(uint8_t *buf, int w, int h, int linesize){
+	int i;
+	for (i = 0; i < h; ++i){
+		rgb24_row_reverse_ssse3(buf, w);
+		buf += linesize;
+	}
+}
+
+/* ---- de-interleaving ---- */
+
+/*even bytes of 32 bytes*/
+static MS2_INLINE __m128i even_bytes(const uint8_t *src){
+	const __m128i mask = _mm_set1_epi16(0xff);
+	__m128i a = _mm_loadu_si128((const __m128i *)src);
+	__m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+	return _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+}
+
+/*even bytes of 16 bytes, in the low half*/
+static MS2_INLINE __m128i even_bytes_8(const uint8_t *src){
+	__m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)src), _mm_set1_epi16(0xff));
+	return _mm_packus_epi16(a, a);
+}
+
+/*16 pairs of bytes into 16 first and 16 second bytes*/
+static MS2_INLINE void deinterleave_16(const uint8_t *src, __m128i *u, __m128i *v){
+	const __m128i mask = _mm_set1_epi16(0xff);
+	__m128i a = _mm_loadu_si128((const __m128i *)src);
+	__m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+	*u = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+	*v = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+}
+
+/*first and second bytes of 16 groups of 4 bytes*/
+static MS2_INLINE void deinterleave_down_scale_16(const uint8_t *src, __m128i *u, __m128i *v){
+	const __m128i mask = _mm_set1_epi32(0xff);
+	__m128i a = _mm_loadu_si128((const __m128i *)src);
+	__m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+	__m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+	__m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+	*u = _mm_packus_epi16(_mm_packs_epi32(_mm_and_si128(a, mask), _mm_and_si128(b, mask)),
+		_mm_packs_epi32(_mm_and_si128(c, mask), _mm_and_si128(d, mask)));
+	*v = _mm_packus_epi16(_mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a, 8), mask), _mm_and_si128(_mm_srli_epi32(b, 8), mask)),
+		_mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(c, 8), mask), _mm_and_si128(_mm_srli_epi32(d, 8), mask)));
+}
+
+void deinterlace_down_scale_x86(const uint8_t* ysrc, const uint8_t* cbcrsrc, uint8_t* ydst, uint8_t* udst, uint8_t* vdst, int w, int h, int y_byte_per_row, int cbcr_byte_per_row, bool_t down_scale){
+	int factor = down_scale ? 2 : 1;
+	int uv_w = w/2, uv_h = h/2;
+	int i, j;
+
+	for (i = 0; i < h; ++i){
+		const uint8_t *src = ysrc + i*factor*y_byte_per_row;
+		uint8_t *dst = ydst + i*w;
+		if (down_scale){
+			for (j = 0; j + 16 <= w; j += 16){
+				_mm_storeu_si128((__m128i *)(dst + j), even_bytes(src + 2*j));
+			}
+			for (; j < w; ++j) dst[j] = src[2*j];
+		} else {
+			memcpy(dst, src, w);
+		}
+	}
+	for (i = 0; i < uv_h; ++i){
+		const uint8_t *src = cbcrsrc + i*factor*cbcr_byte_per_row;
+		uint8_t *u = udst + i*uv_w, *v = vdst + i*uv_w;
+		for (j = 0; j + 16 <= uv_w; j += 16){
+			__m128i vu, vv;
+			if (down_scale) deinterleave_down_scale_16(src + 4*j, &vu, &vv);
+			else deinterleave_16(src + 2*j, &vu, &vv);
+			_mm_storeu_si128((__m128i *)(u + j), vu);
+			_mm_storeu_si128((__m128i *)(v + j), vv);
+		}
+		for (; j < uv_w; ++j){
+			u[j] = src[2*j*factor];
+			v[j] = src[2*j*factor + 1];
+		}
+	}
+}
+
+SSSE3_FUNC void deinterlace_down_scale_and_rotate_180_x86(const uint8_t* ysrc, const uint8_t* cbcrsrc, uint8_t* ydst, uint8_t* udst, uint8_t* vdst, int w, int h, int y_byte_per_row, int cbcr_byte_per_row, bool_t down_scale){
+	int factor = down_scale ? 2 : 1;
+	int uv_w = w/2, uv_h = h/2;
+	int i, j;
+
+	for (i = 0; i < h; ++i){
+		const uint8_t *src = ysrc + (h - 1 - i)*factor*y_byte_per_row;
+		uint8_t *dst = ydst + i*w;
+		/*the destination pixels j..j+15 come from the source pixels w-16-j..w-1-j, reversed*/
+		for (j = 0; j + 16 <= w; j += 16){
+			__m128i v;
+			if (down_scale) v = even_bytes(src + 2*(w - 16 - j));
+			else v = _mm_loadu_si128((const __m128i *)(src + w - 16 - j));
+			_mm_storeu_si128((__m128i *)(dst + j), reverse_16bytes(v));
+		}
+		for (; j < w; ++j) dst[j] = src[(w - 1 - j)*factor];
+	}
+	for (i = 0; i < uv_h; ++i){
+		const uint8_t *src = cbcrsrc + (uv_h - 1 - i)*factor*cbcr_byte_per_row;
+		uint8_t *u = udst + i*uv_w, *v = vdst + i*uv_w;
+		for (j = 0; j + 16 <= uv_w; j += 16){
+			__m128i vu, vv;
+			if (down_scale) deinterleave_down_scale_16(src + 4*(uv_w - 16 - j), &vu, &vv);
+			else deinterleave_16(src + 2*(uv_w - 16 - j), &vu, &vv);
+			_mm_storeu_si128((__m128i *)(u + j), reverse_16bytes(vu));
+			_mm_storeu_si128((__m128i *)(v + j), reverse_16bytes(vv));
+		}
+		for (; j < uv_w; ++j){
+			u[j] = src[2*(uv_w - 1 - j)*factor];
+			v[j] = src[2*(uv_w - 1 - j)*factor + 1];
+		}
+	}
+}
+
+/* ---- 90° rotations ----
+ * The source is read by blocks of 8x8 (down scaled and/or de-interleaved) pixels, transposed with SSE2 unpacks
+ * and written as 8 rows of the destination. Like the portable version, the destination has a stride of wDest.
+ */
+
+/*transposes 8 rows of 8 bytes, t[k] receives the columns 2k and 2k+1*/
+static MS2_INLINE void transpose_8x8(const __m128i r[8], __m128i t[4]){
+	__m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+	__m128i a1 = _mm_unpacklo_epi8(r[2], r[3]);
+	__m128i a2 = _mm_unpacklo_epi8(r[4], r[5]);
+	__m128i a3 = _mm_unpacklo_epi8(r[6], r[7]);
+	__m128i b0 = _mm_unpacklo_epi16(a0, a1);
+	__m128i b1 = _mm_unpackhi_epi16(a0, a1);
+	__m128i b2 = _mm_unpacklo_epi16(a2, a3);
+	__m128i b3 = _mm_unpackhi_epi16(a2, a3);
+	t[0] = _mm_unpacklo_epi32(b0, b2);
+	t[1] = _mm_unpackhi_epi32(b0, b2);
+	t[2] = _mm_unpacklo_epi32(b1, b3);
+	t[3] = _mm_unpackhi_epi32(b1, b3);
+}
+
+/*writes the transposed block: column k of the source block becomes the destination row at first_row_offset + k*row_incr*/
+static MS2_INLINE void store_transposed(const __m128i t[4], uint8_t *dst, int first_row_offset, int row_incr){
+	int k;
+	for (k = 0; k < 4; ++k){
+		_mm_storel_epi64((__m128i *)(dst + first_row_offset + 2*k*row_incr), t[k]);
+		_mm_storel_epi64((__m128i *)(dst + first_row_offset + (2*k + 1)*row_incr), _mm_unpackhi_epi64(t[k], t[k]));
+	}
+}
+
+/* The pixel of source row r and column c (after down scaling) goes to:
+ * - clockwise: destination row c, column wDest-1-r
+ * - anticlockwise: destination row hDest-1-c, column r
+ * For clockwise rotations, the rows of a block are loaded from the bottom so that the transposed rows come out reversed.*/
+static MS2_INLINE int block_dst_offset(int wDest, int hDest, int r0, int c0, bool_t clockWise, int *row_incr){
+	if (clockWise){
+		*row_incr = wDest;
+		return c0*wDest + wDest - 8 - r0;
+	}
+	*row_incr = -wDest;
+	return (hDest - 1 - c0)*wDest + r0;
+}
+
+void rotate_down_scale_plane_x86(int wDest, int hDest, int full_width, const uint8_t* src, uint8_t* dst, bool_t clockWise, bool_t down_scale){
+	int factor = down_scale ? 2 : 1;
+	int src_stride = full_width*factor;
+	int rb = wDest & ~7, cb = hDest & ~7;
+	int r0, c0, r, c, m;
+
+	for (r0 = 0; r0 < rb; r0 += 8){
+		for (c0 = 0; c0 < cb; c0 += 8){
+			__m128i rows[8], t[4];
+			int row_incr, offset;
+			for (m = 0; m < 8; ++m){
+				int row = clockWise ? r0 + 7 - m : r0 + m;
+				const uint8_t *p = src + row*src_stride + c0*factor;
+				rows[m] = down_scale ? even_bytes_8(p) : _mm_loadl_epi64((const __m128i *)p);
+			}
+			transpose_8x8(rows, t);
+			offset = block_dst_offset(wDest, hDest, r0, c0, clockWise, &row_incr);
+			store_transposed(t, dst, offset, row_incr);
+		}
+	}
+	/*remaining columns of the destination (rows of the source), then remaining rows*/
+	for (r = 0; r < wDest; ++r){
+		for (c = (r < rb) ? cb : 0; c < hDest; ++c){
+			uint8_t v = src[r*src_stride + c*factor];
+			if (clockWise) dst[c*wDest + wDest - 1 - r] = v;
+			else dst[(hDest - 1 - c)*wDest + r] = v;
+		}
+	}
+}
+
+void rotate_down_scale_cbcr_x86(int wDest, int hDest, int full_width, const uint8_t* cbcr_src, uint8_t* cb_dst, uint8_t* cr_dst, bool_t clockWise, bool_t down_scale){
+	const __m128i mask16 = _mm_set1_epi16(0xff);
+	const __m128i mask32 = _mm_set1_epi32(0xff);
+	int factor = down_scale ? 2 : 1;
+	int src_stride = 2*full_width*factor;
+	int rb = wDest & ~7, cb = hDest & ~7;
+	int r0, c0, r, c, m;
+
+	for (r0 = 0; r0 < rb; r0 += 8){
+		for (c0 = 0; c0 < cb; c0 += 8){
+			__m128i u[8], v[8], t[4];
+			int row_incr, offset;
+			for (m = 0; m < 8; ++m){
+				int row = clockWise ? r0 + 7 - m : r0 + m;
+				const uint8_t *p = cbcr_src + row*src_stride + 2*c0*factor;
+				__m128i a = _mm_loadu_si128((const __m128i *)p);
+				if (down_scale){
+					__m128i b = _mm_loadu_si128((const __m128i *)(p + 16));
+					__m128i pu = _mm_packs_epi32(_mm_and_si128(a, mask32), _mm_and_si128(b, mask32));
+					__m128i pv = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a, 8), mask32), _mm_and_si128(_mm_srli_epi32(b, 8), mask32));
+					u[m] = _mm_packus_epi16(pu, pu);
+					v[m] = _mm_packus_epi16(pv, pv);
+				} else {
+					u[m] = _mm_packus_epi16(_mm_and_si128(a, mask16), mask16);
+					v[m] = _mm_packus_epi16(_mm_srli_epi16(a, 8), mask16);
+				}
+			}
+			offset = block_dst_offset(wDest, hDest, r0, c0, clockWise, &row_incr);
+			transpose_8x8(u, t);
+			store_transposed(t, cb_dst, offset, row_incr);
+			transpose_8x8(v, t);
+			store_transposed(t, cr_dst, offset, row_incr);
+		}
+	}
+	for (r = 0; r < wDest; ++r){
+		for (c = (r < rb) ? cb : 0; c < hDest; ++c){
+			const uint8_t *p = cbcr_src + r*src_stride + 2*c*factor;
+			int offset = clockWise ? c*wDest + wDest - 1 - r : (hDest - 1 - c)*wDest + r;
+			cb_dst[offset] = p[0];
+			cr_dst[offset] = p[1];
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef MS_VIDEO_X86_H
+#define MS_VIDEO_X86_H
+
+#include "mediastreamer2/msvideo.h"
+
+/*the kernels need compilers able to build SSSE3 and AVX2 functions without enabling them for the whole file*/
+#if (defined(__SSE2__) && ((defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || defined(__clang__))) \
+	|| (defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#define MS_HAS_X86_VIDEO_KERNELS 1
+#else
+#define MS_HAS_X86_VIDEO_KERNELS 0
+#endif
+
+#if MS_HAS_X86_VIDEO_KERNELS
+
+/*
+ * x86 versions of the picture mirroring, rotation and de-interleaving routines of msvideo.c.
+ * They give exactly the same output as the portable code, and all of them require SSSE3.
+ * The mirroring functions use AVX2 when the processor supports it.
+ */
+
+bool_t ms_video_x86_kernels_supported(void);
+
+/*defined in msvideo.c: selects between these kernels (when supported) and the portable code, for tests*/
+void ms_video_enable_x86_kernels(bool_t enabled);
+
+void plane_horizontal_mirror_x86(uint8_t *p, int linesize, int w, int h);
+
+void plane_central_mirror_x86(uint8_t *p, int linesize, int w, int h);
+
+void plane_vertical_mirror_x86(uint8_t *p, int linesize, int w, int h);
+
+void rgb24_mirror_x86(uint8_t *buf, int w, int h, int linesize);
+
+void rotate_down_scale_plane_x86(int wDest, int hDest, int full_width, const uint8_t* src, uint8_t* dst, bool_t clockWise, bool_t down_scale);
+
+void rotate_down_scale_cbcr_x86(int wDest, int hDest, int full_width, const uint8_t* cbcr_src, uint8_t* cb_dst, uint8_t* cr_dst, bool_t clockWise, bool_t down_scale);
+
+void deinterlace_down_scale_x86(const uint8_t* ysrc, const uint8_t* cbcrsrc, uint8_t* ydst, uint8_t* udst, uint8_t* vdst, int w, int h, int y_byte_per_row, int cbcr_byte_per_row, bool_t down_scale);
+
+void deinterlace_down_scale_and_rotate_180_x86(const uint8_t* ysrc, const uint8_t* cbcrsrc, uint8_t* ydst, uint8_t* udst, uint8_t* vdst, int w, int h, int y_byte_per_row, int cbcr_byte_per_row, bool_t down_scale);
+
+#endif
+
+#endif
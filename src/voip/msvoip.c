@@ -303,6 +303,7 @@ void ms_factory_init_voip(MSFactory *obj){
 		MSVideoPresetsManager *vpm = ms_video_presets_manager_new(obj);
 		register_video_preset_high_fps(vpm);
 	}
+	obj->static_image_cache = ms_static_image_cache_new();
 #endif
 
 	obj->devices_info = ms_devices_info_new();
@@ -333,6 +334,8 @@ void ms_factory_uninit_voip(MSFactory *obj){
 		ms_web_cam_manager_destroy(obj->wbcmanager);
 		obj->wbcmanager = NULL;
 		ms_video_presets_manager_destroy(obj->video_presets_manager);
+		ms_static_image_cache_destroy(obj->static_image_cache);
+		obj->static_image_cache = NULL;
 #endif
 		ms_srtp_shutdown();
 		if (obj->devices_info) ms_devices_info_free(obj->devices_info);
@@ -100,6 +100,11 @@ MS2_PUBLIC void ms_srtp_shutdown(void);
  * @param[in]		stream_sessions	Pointer to the new stream session structure
  */
 MS2_PUBLIC void ms_dtls_srtp_set_stream_sessions(MSDtlsSrtpContext *dtls_context, MSMediaStreamSessions *stream_sessions);
+/**
+ * Wait for the handshake steps being computed by the worker pool, to be called before destroying the sessions they send packets through
+ * @param[in/out]	dtls_context	Dtls context
+ */
+MS2_PUBLIC void ms_dtls_srtp_wait_for_handshake_jobs(MSDtlsSrtpContext *dtls_context);
 /**
  * Set the backlink in zrtp_context to stream sessions context. Used when reinvite force creation of a new stream with same session data
  * @param[in/out]	zrtp_context	ZRTP context, contains a link to stream session context needed to access srtp context
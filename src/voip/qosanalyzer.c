@@ -22,6 +22,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/bitratecontrol.h"
 #include "qosanalyzer.h"
+#include "msrtpendpoint.h"
 
 #include <math.h>
 
@@ -78,6 +79,7 @@ const char* ms_qos_analyzer_algorithm_to_string(MSQosAnalyzerAlgorithm alg) {
 	switch (alg){
 		case MSQosAnalyzerAlgorithmSimple: return "Simple";
 		case MSQosAnalyzerAlgorithmStateful: return "Stateful";
+		case MSQosAnalyzerAlgorithmDelayGradient: return "DelayGradient";
 		default: return NULL;
 	}
 }
@@ -86,6 +88,8 @@ MSQosAnalyzerAlgorithm ms_qos_analyzer_algorithm_from_string(const char* alg) {
 		return MSQosAnalyzerAlgorithmSimple;
 	else if (strcasecmp(alg, "Stateful")==0)
 		return MSQosAnalyzerAlgorithmStateful;
+	else if (strcasecmp(alg, "DelayGradient")==0)
+		return MSQosAnalyzerAlgorithmDelayGradient;
 
 	ms_error("MSQosAnalyzer: Invalid QoS analyzer: %s", alg);
 	return MSQosAnalyzerAlgorithmSimple;
@@ -703,3 +707,469 @@ MSQosAnalyzer * ms_stateful_qos_analyzer_new(RtpSession *session){
 }
 
 
+
+
+
+/******************************************************************************/
+/************************** Delay gradient QoS analyzer ***********************/
+/******************************************************************************/
+/*
+ * The receiving side follows the delay based controller of Google Congestion Control (draft-ietf-rmcat-gcc):
+ * the packets are grouped by bursts, the variation of the delay between two groups is accumulated and smoothed, and the
+ * slope of the smoothed delay over the last groups (the trend) is compared to an adaptive threshold. When the delay
+ * keeps growing, a queue is building up: the estimation is decreased below the incoming bitrate. Otherwise it slowly
+ * increases. The estimation is sent to the remote party in REMB messages (draft-alvestrand-rmcat-remb).
+ */
+#define BURST_MS 5
+#define MAX_BURST_DURATION_MS 100
+#define MAX_GROUP_DELTA_MS 3000
+#define SMOOTHING_COEF 0.9
+#define TRENDLINE_GAIN 4.0
+#define MAX_TRENDLINE_DELTAS 60
+#define INITIAL_THRESHOLD 12.5
+#define MIN_THRESHOLD 6.0
+#define MAX_THRESHOLD 600.0
+#define THRESHOLD_K_UP 0.0087
+#define THRESHOLD_K_DOWN 0.039
+#define OVERUSE_TIME_MS 10
+#define RATE_WINDOW_MS 500
+#define DECREASE_FACTOR 0.85
+#define INCREASE_PER_SECOND 0.08
+#define MIN_ESTIMATED_BITRATE 10000
+#define FEEDBACK_INTERVAL_MS 1000
+#define IP_UDP_OVERHEAD 28
+
+#define RTCP_PSFB_PACKET_TYPE 206
+#define RTCP_PSFB_AFB_FMT 15
+#define REMB_SIZE 24
+#define REMB_MAX_MANTISSA ((1<<18)-1)
+
+/*the sending side follows the remote estimations, and the loss rate reported when it is high*/
+#define HIGH_LOSS_RATE 10.f
+#define ACTION_HOLD_MS 2000
+
+static uint32_t read_uint32(const uint8_t *p){
+	return ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | (uint32_t)p[3];
+}
+
+static void write_uint32(uint8_t *p, uint32_t val){
+	p[0]=(uint8_t)(val>>24);
+	p[1]=(uint8_t)((val>>16) & 0xff);
+	p[2]=(uint8_t)((val>>8) & 0xff);
+	p[3]=(uint8_t)(val & 0xff);
+}
+
+static double get_arrival_time(const mblk_t *m){
+	struct timeval tv;
+#if defined(ORTP_TIMESTAMP)
+	/*the time the packet was received by the kernel, when the socket gives it*/
+	if (m->timestamp.tv_sec!=0) return m->timestamp.tv_sec*1000.0+m->timestamp.tv_usec/1000.0;
+#endif
+	ortp_gettimeofday(&tv,NULL);
+	return tv.tv_sec*1000.0+tv.tv_usec/1000.0;
+}
+
+static void delay_gradient_reset_trendline(MSDelayGradientQosAnalyzer *obj){
+	obj->accumulated_delay=0;
+	obj->smoothed_delay=0;
+	obj->trendline_count=0;
+	obj->num_deltas=0;
+	obj->trend=0;
+	obj->previous_trend=0;
+	obj->time_over_using=-1;
+	obj->overuse_count=0;
+	obj->usage=MSDelayGradientNormal;
+}
+
+static void delay_gradient_reset_receiver(MSDelayGradientQosAnalyzer *obj){
+	obj->current_group.valid=FALSE;
+	obj->previous_group.valid=FALSE;
+	delay_gradient_reset_trendline(obj);
+}
+
+static void delay_gradient_update_trendline(MSDelayGradientQosAnalyzer *obj, double arrival, double delay_delta){
+	double mean_x=0,mean_y=0,num=0,den=0;
+	trendlinepoint_t *point;
+	int i;
+
+	obj->num_deltas=MIN(obj->num_deltas+1,1000);
+	obj->accumulated_delay+=delay_delta;
+	obj->smoothed_delay=SMOOTHING_COEF*obj->smoothed_delay+(1-SMOOTHING_COEF)*obj->accumulated_delay;
+	if (obj->trendline_count==0) obj->first_arrival=arrival;
+	if (obj->trendline_count==TRENDLINE_WINDOW){
+		memmove(&obj->trendline[0],&obj->trendline[1],(TRENDLINE_WINDOW-1)*sizeof(trendlinepoint_t));
+		obj->trendline_count--;
+	}
+	point=&obj->trendline[obj->trendline_count++];
+	point->arrival=arrival-obj->first_arrival;
+	point->smoothed_delay=obj->smoothed_delay;
+	if (obj->trendline_count<TRENDLINE_WINDOW) return;
+
+	/*least squares slope of the smoothed delay over the arrival time*/
+	for(i=0;i<TRENDLINE_WINDOW;++i){
+		mean_x+=obj->trendline[i].arrival;
+		mean_y+=obj->trendline[i].smoothed_delay;
+	}
+	mean_x/=TRENDLINE_WINDOW;
+	mean_y/=TRENDLINE_WINDOW;
+	for(i=0;i<TRENDLINE_WINDOW;++i){
+		double dx=obj->trendline[i].arrival-mean_x;
+		num+=dx*(obj->trendline[i].smoothed_delay-mean_y);
+		den+=dx*dx;
+	}
+	if (den>0) obj->trend=num/den;
+}
+
+static void delay_gradient_update_threshold(MSDelayGradientQosAnalyzer *obj, double modified_trend, double now){
+	double abs_trend=fabs(modified_trend);
+	double dt;
+
+	if (obj->last_threshold_update==0) obj->last_threshold_update=now;
+	/*a sudden spike, e.g. a route change, must not move the threshold*/
+	if (abs_trend>obj->threshold+15){
+		obj->last_threshold_update=now;
+		return;
+	}
+	dt=MIN(now-obj->last_threshold_update,100);
+	obj->threshold+=(abs_trend<obj->threshold ? THRESHOLD_K_DOWN : THRESHOLD_K_UP)*(abs_trend-obj->threshold)*dt;
+	obj->threshold=MAX(MIN_THRESHOLD,MIN(obj->threshold,MAX_THRESHOLD));
+	obj->last_threshold_update=now;
+}
+
+static void delay_gradient_detect(MSDelayGradientQosAnalyzer *obj, double now, double send_delta){
+	double modified_trend;
+
+	if (obj->trendline_count<TRENDLINE_WINDOW) return;
+	modified_trend=MIN(obj->num_deltas,MAX_TRENDLINE_DELTAS)*obj->trend*TRENDLINE_GAIN;
+	if (modified_trend>obj->threshold){
+		if (obj->time_over_using<0) obj->time_over_using=send_delta/2;
+		else obj->time_over_using+=send_delta;
+		obj->overuse_count++;
+		if (obj->time_over_using>OVERUSE_TIME_MS && obj->overuse_count>1 && obj->trend>=obj->previous_trend){
+			if (obj->usage!=MSDelayGradientOverusing){
+				ms_message("MSDelayGradientQosAnalyzer[%p]: overusing, trend=%f threshold=%f",obj,modified_trend,obj->threshold);
+			}
+			obj->time_over_using=0;
+			obj->overuse_count=0;
+			obj->usage=MSDelayGradientOverusing;
+		}
+	}else if (modified_trend<-obj->threshold){
+		obj->time_over_using=-1;
+		obj->overuse_count=0;
+		obj->usage=MSDelayGradientUnderusing;
+	}else{
+		obj->time_over_using=-1;
+		obj->overuse_count=0;
+		obj->usage=MSDelayGradientNormal;
+	}
+	obj->previous_trend=obj->trend;
+	delay_gradient_update_threshold(obj,modified_trend,now);
+}
+
+static void delay_gradient_update_estimation(MSDelayGradientQosAnalyzer *obj, double now){
+	double decrease_interval;
+
+	if (obj->incoming_bitrate<=0) return;
+	if (obj->estimated_bitrate<=0){
+		obj->estimated_bitrate=obj->incoming_bitrate;
+		obj->last_rate_update=now;
+		return;
+	}
+	switch(obj->usage){
+		case MSDelayGradientOverusing:
+			/*decrease once per round trip, the time for the remote party to react to the previous decrease*/
+			decrease_interval=200+1000*rtp_session_get_round_trip_propagation(obj->session);
+			if (obj->rate_state!=MSDelayGradientRateDecrease || now-obj->last_decrease>=decrease_interval){
+				obj->estimated_bitrate=MIN(obj->estimated_bitrate,DECREASE_FACTOR*obj->incoming_bitrate);
+				obj->last_decrease=now;
+				obj->rate_state=MSDelayGradientRateDecrease;
+			}
+		break;
+		case MSDelayGradientUnderusing:
+			/*the queues are draining, the incoming bitrate is higher than the available bandwidth*/
+			obj->rate_state=MSDelayGradientRateHold;
+		break;
+		case MSDelayGradientNormal:
+			if (obj->rate_state==MSDelayGradientRateIncrease){
+				double dt=MIN(now-obj->last_rate_update,1000)/1000.0;
+				obj->estimated_bitrate*=pow(1+INCREASE_PER_SECOND,dt);
+			}else obj->rate_state=MSDelayGradientRateIncrease;
+		break;
+	}
+	/*do not go far above what the remote party actually sends, it would take time to come back*/
+	obj->estimated_bitrate=MIN(obj->estimated_bitrate,1.5*obj->incoming_bitrate+10000);
+	obj->estimated_bitrate=MAX(obj->estimated_bitrate,MIN_ESTIMATED_BITRATE);
+	obj->last_rate_update=now;
+}
+
+static void delay_gradient_send_remb(MSDelayGradientQosAnalyzer *obj, double now){
+	mblk_t *m=allocb(REMB_SIZE,0);
+	uint32_t mantissa=(uint32_t)obj->estimated_bitrate;
+	int exp=0;
+
+	while(mantissa>REMB_MAX_MANTISSA){
+		mantissa>>=1;
+		exp++;
+	}
+	m->b_wptr[0]=0x80 | RTCP_PSFB_AFB_FMT;
+	m->b_wptr[1]=RTCP_PSFB_PACKET_TYPE;
+	m->b_wptr[2]=0;
+	m->b_wptr[3]=REMB_SIZE/4-1;
+	write_uint32(m->b_wptr+4,rtp_session_get_send_ssrc(obj->session));
+	write_uint32(m->b_wptr+8,0);
+	memcpy(m->b_wptr+12,"REMB",4);
+	m->b_wptr[16]=1;
+	m->b_wptr[17]=(uint8_t)((exp<<2) | (mantissa>>16));
+	m->b_wptr[18]=(uint8_t)((mantissa>>8) & 0xff);
+	m->b_wptr[19]=(uint8_t)(mantissa & 0xff);
+	write_uint32(m->b_wptr+20,obj->recv_ssrc);
+	m->b_wptr+=REMB_SIZE;
+	rtp_session_rtcp_sendm_raw(obj->session,m);
+	obj->last_feedback=now;
+	obj->last_feedback_bitrate=obj->estimated_bitrate;
+}
+
+/*
+ * Packets sent within a few milliseconds, or received together after a queue while they were sent apart, belong to the
+ * same group.
+ */
+static bool_t delay_gradient_belongs_to_group(const packetgroup_t *g, uint32_t ts, double arrival, int clock_rate){
+	double ts_delta=(double)(uint32_t)(ts-g->first_ts)*1000.0/clock_rate;
+	double arrival_delta=arrival-g->last_arrival;
+
+	if (ts_delta<=BURST_MS) return TRUE;
+	return arrival_delta<=BURST_MS && arrival-g->first_arrival<MAX_BURST_DURATION_MS
+		&& arrival_delta-(double)(uint32_t)(ts-g->last_ts)*1000.0/clock_rate<0;
+}
+
+static void delay_gradient_on_group_complete(MSDelayGradientQosAnalyzer *obj, const packetgroup_t *prev, const packetgroup_t *cur, int clock_rate){
+	double send_delta=(double)(uint32_t)(cur->last_ts-prev->last_ts)*1000.0/clock_rate;
+	double arrival_delta=cur->last_arrival-prev->last_arrival;
+
+	if (arrival_delta<0 || send_delta>MAX_GROUP_DELTA_MS || arrival_delta>MAX_GROUP_DELTA_MS){
+		/*the clock jumped or the stream was paused, the previous measures are meaningless*/
+		delay_gradient_reset_trendline(obj);
+		return;
+	}
+	delay_gradient_update_trendline(obj,cur->last_arrival,arrival_delta-send_delta);
+	delay_gradient_detect(obj,cur->last_arrival,send_delta);
+}
+
+void ms_delay_gradient_qos_analyzer_on_receive(MSQosAnalyzer *objbase, const mblk_t *m, int len){
+	MSDelayGradientQosAnalyzer *obj=(MSDelayGradientQosAnalyzer*)objbase;
+	const uint8_t *data=m->b_wptr;
+	packetgroup_t *g=&obj->current_group;
+	double arrival;
+	uint32_t ssrc,ts;
+	int pt;
+
+	/*only the RTP packets, not the RTCP packets multiplexed with them, nor the STUN or DTLS ones*/
+	if (len<RTP_FIXED_HEADER_SIZE || (data[0]>>6)!=2 || (data[1]>=192 && data[1]<=223)) return;
+	pt=data[1] & 0x7f;
+	ts=read_uint32(data+4);
+	ssrc=read_uint32(data+8);
+	arrival=get_arrival_time(m);
+
+	if (!obj->receiving || ssrc!=obj->recv_ssrc){
+		/*first packet, or the remote party restarted its stream*/
+		obj->receiving=TRUE;
+		obj->recv_ssrc=ssrc;
+		delay_gradient_reset_receiver(obj);
+	}
+	if (pt!=obj->recv_payload_type){
+		PayloadType *payload=rtp_profile_get_payload(rtp_session_get_recv_profile(obj->session),pt);
+		if (payload==NULL || payload->clock_rate<=0) return;
+		if (obj->recv_clock_rate!=payload->clock_rate) delay_gradient_reset_receiver(obj);
+		obj->recv_payload_type=pt;
+		obj->recv_clock_rate=payload->clock_rate;
+	}
+
+	if (obj->rate_window_start==0) obj->rate_window_start=arrival;
+	obj->rate_window_bytes+=len+IP_UDP_OVERHEAD;
+	if (arrival-obj->rate_window_start>=RATE_WINDOW_MS){
+		obj->incoming_bitrate=obj->rate_window_bytes*8*1000.0/(arrival-obj->rate_window_start);
+		obj->rate_window_start=arrival;
+		obj->rate_window_bytes=0;
+	}
+
+	if (!g->valid){
+		g->valid=TRUE;
+		g->first_ts=g->last_ts=ts;
+		g->first_arrival=g->last_arrival=arrival;
+		return;
+	}
+	/*a late packet of a previous group*/
+	if ((int32_t)(ts-g->first_ts)<0) return;
+	if (delay_gradient_belongs_to_group(g,ts,arrival,obj->recv_clock_rate)){
+		if ((int32_t)(ts-g->last_ts)>0) g->last_ts=ts;
+		if (arrival>g->last_arrival) g->last_arrival=arrival;
+		return;
+	}
+	if (obj->previous_group.valid){
+		delay_gradient_on_group_complete(obj,&obj->previous_group,g,obj->recv_clock_rate);
+		delay_gradient_update_estimation(obj,arrival);
+	}
+	obj->previous_group=*g;
+	g->first_ts=g->last_ts=ts;
+	g->first_arrival=g->last_arrival=arrival;
+
+	if (obj->estimated_bitrate>0 && (arrival-obj->last_feedback>=FEEDBACK_INTERVAL_MS
+		|| obj->estimated_bitrate<0.97*obj->last_feedback_bitrate)){
+		delay_gradient_send_remb(obj,arrival);
+	}
+}
+
+/*returns the bitrate of the REMB message if it is about the stream we send, 0 otherwise*/
+static float delay_gradient_parse_remb(MSDelayGradientQosAnalyzer *obj, const mblk_t *rtcp){
+	const uint8_t *data=rtcp->b_rptr;
+	int size=(int)(rtcp->b_wptr-rtcp->b_rptr);
+	uint32_t send_ssrc=rtp_session_get_send_ssrc(obj->session);
+	int nssrcs,exp,i;
+	uint32_t mantissa;
+
+	if (size<REMB_SIZE-4 || (data[0]>>6)!=2 || (data[0] & 0x1f)!=RTCP_PSFB_AFB_FMT || data[1]!=RTCP_PSFB_PACKET_TYPE) return 0;
+	if (memcmp(data+12,"REMB",4)!=0) return 0;
+	size=MIN(size,(((data[2]<<8) | data[3])+1)*4);
+	nssrcs=data[16];
+	exp=data[17]>>2;
+	mantissa=((uint32_t)(data[17] & 0x3)<<16) | ((uint32_t)data[18]<<8) | (uint32_t)data[19];
+	for(i=0;i<nssrcs && 20+4*(i+1)<=size;++i){
+		if (read_uint32(data+20+4*i)==send_ssrc) return (float)ldexp((double)mantissa,exp);
+	}
+	return 0;
+}
+
+static bool_t delay_gradient_analyzer_process_rtcp(MSQosAnalyzer *objbase, mblk_t *rtcp){
+	MSDelayGradientQosAnalyzer *obj=(MSDelayGradientQosAnalyzer*)objbase;
+	const report_block_t *rb=NULL;
+	float bitrate;
+
+	if (rtcp_is_SR(rtcp)){
+		rb=rtcp_SR_get_report_block(rtcp,0);
+	}else if (rtcp_is_RR(rtcp)){
+		rb=rtcp_RR_get_report_block(rtcp,0);
+	}else if ((bitrate=delay_gradient_parse_remb(obj,rtcp))>0){
+		ms_message("MSDelayGradientQosAnalyzer[%p]: remote estimation is %f kbit/s",obj,bitrate/1000);
+		obj->remote_estimated_bitrate=bitrate;
+		obj->estimation_received=TRUE;
+		return TRUE;
+	}
+	if (rb && report_block_get_ssrc(rb)==rtp_session_get_send_ssrc(obj->session)){
+		if (ortp_loss_rate_estimator_process_report_block(objbase->lre,obj->session,rb)){
+			obj->loss_rate=ortp_loss_rate_estimator_get_value(objbase->lre);
+			obj->loss_reported=TRUE;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static void delay_gradient_analyzer_suggest_action(MSQosAnalyzer *objbase, MSRateControlAction *action){
+	MSDelayGradientQosAnalyzer *obj=(MSDelayGradientQosAnalyzer*)objbase;
+	float cur_bw=rtp_session_get_send_bandwidth(obj->session);
+	float target=-1;
+	uint64_t now=ortp_get_cur_time_ms();
+
+	action->type=MSRateControlActionDoNothing;
+	action->value=0;
+	if (obj->estimation_received) target=obj->remote_estimated_bitrate;
+	if (obj->loss_reported && obj->loss_rate>=HIGH_LOSS_RATE){
+		/*losses that the delay did not announce, as on a lossy wireless link, or a remote party not sending estimations*/
+		float loss_target=cur_bw*(1-obj->loss_rate/200);
+		if (target<0 || loss_target<target) target=loss_target;
+	}
+	obj->estimation_received=FALSE;
+	obj->loss_reported=FALSE;
+
+	if (target>0 && cur_bw>0){
+		/*give the encoders the time to reach the previous target before asking them again the same thing*/
+		bool_t same_target=(obj->last_target>0 && target>obj->last_target*0.95f && target<obj->last_target*1.1f);
+		if (same_target && now-obj->last_action_time<ACTION_HOLD_MS){
+			ms_message("MSDelayGradientQosAnalyzer[%p]: waiting for the previous action to take effect",obj);
+		}else if (target<cur_bw*0.95f){
+			action->type=MSRateControlActionDecreaseBitrate;
+			action->value=(int)MIN(50,MAX(5,100*(1-target/cur_bw)));
+		}else if (target>cur_bw*1.1f){
+			action->type=MSRateControlActionIncreaseQuality;
+			action->value=(int)MIN(50,100*(target/cur_bw-1));
+		}
+		if (action->type!=MSRateControlActionDoNothing){
+			obj->last_target=target;
+			obj->last_action_time=now;
+		}
+	}
+
+	ms_message("MSDelayGradientQosAnalyzer[%p]: %s of value %d (cur_bw=%f kbit/s target=%f kbit/s)",
+		obj, ms_rate_control_action_type_name(action->type), action->value, cur_bw/1000, target/1000);
+
+	if (objbase->on_action_suggested!=NULL){
+		int i;
+		char *data[4];
+		int datac = sizeof(data) / sizeof(data[0]);
+		data[0]=ms_strdup("%loss remote_bw_estim cur_bw");
+		data[1]=ms_strdup_printf("%d %d %d"
+			, (int)obj->loss_rate
+			, (int)(obj->remote_estimated_bitrate/1000)
+			, (int)(cur_bw/1000));
+		data[2]=ms_strdup("action_type action_value target_bw");
+		data[3]=ms_strdup_printf("%s %d %d"
+			, ms_rate_control_action_type_name(action->type)
+			, action->value
+			, (int)(target/1000));
+
+		objbase->on_action_suggested(objbase->on_action_suggested_user_pointer, datac, (const char**)data);
+
+		for (i=0;i<datac;++i){
+			ms_free(data[i]);
+		}
+	}
+}
+
+static bool_t delay_gradient_analyzer_has_improved(MSQosAnalyzer *objbase){
+	/*like the stateful analyzer, never go to the 'Stable' state: every estimation received is followed*/
+	return FALSE;
+}
+
+static MSQosAnalyzerDesc delay_gradient_analyzer_desc={
+	delay_gradient_analyzer_process_rtcp,
+	delay_gradient_analyzer_suggest_action,
+	delay_gradient_analyzer_has_improved,
+	NULL,
+	NULL
+};
+
+void ms_delay_gradient_qos_analyzer_forget_endpoint(MSQosAnalyzer *objbase, MSRtpEndpoint *ep){
+	MSDelayGradientQosAnalyzer *obj=(MSDelayGradientQosAnalyzer*)objbase;
+	/*the session is destroyed, the endpoint releases its reference*/
+	ep->delay_gradient_analyzer=NULL;
+	obj->ep=NULL;
+	ms_qos_analyzer_unref(objbase);
+}
+
+MSQosAnalyzer * ms_delay_gradient_qos_analyzer_new(RtpSession *session){
+	MSDelayGradientQosAnalyzer *obj;
+	MSRtpEndpoint *ep=ms_rtp_endpoint_get(session,TRUE,TRUE);
+
+	if (ep!=NULL && ep->delay_gradient_analyzer!=NULL){
+		/*the analyzer measuring the packets received by the session, keep its estimations*/
+		return ep->delay_gradient_analyzer;
+	}
+	obj=ms_new0(MSDelayGradientQosAnalyzer,1);
+	obj->session=session;
+	obj->parent.desc=&delay_gradient_analyzer_desc;
+	obj->parent.type=MSQosAnalyzerAlgorithmDelayGradient;
+	obj->parent.lre=ortp_loss_rate_estimator_new(LOSS_RATE_MIN_INTERVAL, LOSS_RATE_MIN_TIME, session);
+	obj->recv_payload_type=-1;
+	obj->threshold=INITIAL_THRESHOLD;
+	obj->rate_state=MSDelayGradientRateHold;
+	delay_gradient_reset_receiver(obj);
+	if (ep!=NULL){
+		/*the endpoint keeps the analyzer until the session is destroyed, since it may read packets at any time*/
+		obj->ep=ep;
+		ep->delay_gradient_analyzer=ms_qos_analyzer_ref((MSQosAnalyzer*)obj);
+	}else{
+		ms_warning("MSDelayGradientQosAnalyzer[%p]: session [%p] has another transport endpoint, the packets received are not measured",obj,session);
+	}
+	ms_message("MSDelayGradientQosAnalyzer[%p] created for session [%p]",obj,session);
+	return (MSQosAnalyzer*)obj;
+}
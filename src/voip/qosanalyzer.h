@@ -103,6 +103,82 @@ extern "C" {
 		double burst_ratio;
 		double burst_duration_ms;
 	}MSStatefulQosAnalyzer;
+
+
+	/**************************************************************************/
+	/********************** Delay gradient QoS analyzer ***********************/
+	/**************************************************************************/
+	#define TRENDLINE_WINDOW 20
+
+	typedef enum _MSDelayGradientUsage{
+		MSDelayGradientNormal,
+		MSDelayGradientOverusing,
+		MSDelayGradientUnderusing
+	}MSDelayGradientUsage;
+
+	typedef enum _MSDelayGradientRateState{
+		MSDelayGradientRateHold,
+		MSDelayGradientRateIncrease,
+		MSDelayGradientRateDecrease
+	}MSDelayGradientRateState;
+
+	/*the packets sent in a burst, usually the packets of a video frame*/
+	typedef struct {
+		uint32_t first_ts;
+		uint32_t last_ts;
+		double first_arrival; /*ms*/
+		double last_arrival; /*ms*/
+		bool_t valid;
+	}packetgroup_t;
+
+	typedef struct {
+		double arrival; /*ms*/
+		double smoothed_delay; /*ms*/
+	}trendlinepoint_t;
+
+	typedef struct _MSDelayGradientQosAnalyzer{
+		MSQosAnalyzer parent;
+		RtpSession *session;
+		struct _MSRtpEndpoint *ep;
+
+		/*receiving side, run by the thread reading the session*/
+		uint32_t recv_ssrc;
+		int recv_payload_type;
+		int recv_clock_rate;
+		packetgroup_t current_group;
+		packetgroup_t previous_group;
+		double accumulated_delay;
+		double smoothed_delay;
+		double first_arrival;
+		trendlinepoint_t trendline[TRENDLINE_WINDOW];
+		int trendline_count;
+		int num_deltas;
+		double trend;
+		double previous_trend;
+		double threshold;
+		double last_threshold_update;
+		double time_over_using;
+		int overuse_count;
+		MSDelayGradientUsage usage;
+		MSDelayGradientRateState rate_state;
+		double rate_window_start;
+		uint64_t rate_window_bytes;
+		double incoming_bitrate; /*bits/s*/
+		double estimated_bitrate; /*bits/s, the estimation sent to the remote party*/
+		double last_rate_update;
+		double last_decrease;
+		double last_feedback;
+		double last_feedback_bitrate;
+		bool_t receiving;
+
+		/*sending side*/
+		float loss_rate;
+		float remote_estimated_bitrate; /*bits/s, the latest estimation received from the remote party*/
+		float last_target; /*bits/s, the target of the latest action suggested*/
+		uint64_t last_action_time;
+		bool_t estimation_received;
+		bool_t loss_reported;
+	}MSDelayGradientQosAnalyzer;
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,595 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+/*
+ * A scaler implementation for x86 processors, using SSE2 and AVX2 when the cpu supports it.
+ * It handles the conversions needed between cameras, encoders and displays: scaling of YUV420P pictures,
+ * conversions between YUV420P, NV12 and NV21, and conversions from YUV420P to RGB24, RGBA32 and RGB565,
+ * all of them with bilinear or nearest neighbour scaling. Other conversions are delegated to ffmpeg's swscale when it is available.
+ * The SSE2 and AVX2 versions of the kernels give exactly the same output as the scalar ones.
+ */
+
+#include "mediastreamer2/msvideo.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#if (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || defined(__clang__)
+#define SCALER_HAVE_AVX2
+#include <immintrin.h>
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+
+/*fractional positions are in 1/128th, so that a blend of two 8 bits pixels fits in a signed 16 bits integer*/
+#define FRAC_BITS 7
+#define FRAC_ONE (1<<FRAC_BITS)
+#define FRAC_ROUND (1<<(FRAC_BITS-1))
+
+typedef void (*VerticalBlendFunc)(const uint8_t *a, const uint8_t *b, uint8_t *dst, int f, int width);
+typedef void (*InterleaveFunc)(const uint8_t *u, const uint8_t *v, uint8_t *uv, int width);
+typedef void (*DeinterleaveFunc)(const uint8_t *uv, uint8_t *u, uint8_t *v, int width);
+
+typedef struct _PlaneScaler{
+	int src_w, src_h, dst_w, dst_h;
+	int *x_pos; /*for each destination column, the source column and fraction: (x<<FRAC_BITS)|frac*/
+	int *y_pos; /*same for rows*/
+	bool_t half_width; /*exact 2:1 horizontal downscaling, done by averaging pairs of pixels*/
+}PlaneScaler;
+
+typedef struct _MSX86ScalerContext{
+	MSScalerContext *fallback;
+	int src_w, src_h, dst_w, dst_h;
+	MSPixFmt src_fmt, dst_fmt;
+	PlaneScaler planes[3]; /*Y, U and V*/
+	uint8_t *src_yuv[3]; /*source converted to YUV420P, when it is semi-planar*/
+	int src_yuv_strides[3];
+	uint8_t *scaled_yuv[3]; /*scaled picture, when the destination is not YUV420P*/
+	int scaled_yuv_strides[3];
+	uint8_t *row; /*vertically interpolated source row*/
+	VerticalBlendFunc vblend;
+	InterleaveFunc interleave;
+	DeinterleaveFunc deinterleave;
+}MSX86ScalerContext;
+
+#ifndef NO_FFMPEG
+extern MSScalerDesc ffmpeg_scaler;
+#endif
+
+/* ---- scalar kernels, used for the remainders of rows and as references ---- */
+
+static void vblend_c(const uint8_t *a, const uint8_t *b, uint8_t *dst, int f, int width){
+	int i;
+	for (i = 0; i < width; ++i){
+		dst[i] = (uint8_t)((a[i] * (FRAC_ONE - f) + b[i] * f + FRAC_ROUND) >> FRAC_BITS);
+	}
+}
+
+static void interleave_c(const uint8_t *u, const uint8_t *v, uint8_t *uv, int width){
+	int i;
+	for (i = 0; i < width; ++i){
+		uv[2*i] = u[i];
+		uv[2*i + 1] = v[i];
+	}
+}
+
+static void deinterleave_c(const uint8_t *uv, uint8_t *u, uint8_t *v, int width){
+	int i;
+	for (i = 0; i < width; ++i){
+		u[i] = uv[2*i];
+		v[i] = uv[2*i + 1];
+	}
+}
+
+/* ---- SSE2 kernels ---- */
+
+static void vblend_sse2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int f, int width){
+	__m128i zero = _mm_setzero_si128();
+	__m128i fa = _mm_set1_epi16((short)(FRAC_ONE - f));
+	__m128i fb = _mm_set1_epi16((short)f);
+	__m128i round = _mm_set1_epi16(FRAC_ROUND);
+	int i = 0;
+
+	for (; i + 16 <= width; i += 16){
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), fa), _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), fb));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), fa), _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), fb));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, round), FRAC_BITS);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, round), FRAC_BITS);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+	vblend_c(a + i, b + i, dst + i, f, width - i);
+}
+
+static void interleave_sse2(const uint8_t *u, const uint8_t *v, uint8_t *uv, int width){
+	int i = 0;
+	for (; i + 16 <= width; i += 16){
+		__m128i vu = _mm_loadu_si128((const __m128i *)(u + i));
+		__m128i vv = _mm_loadu_si128((const __m128i *)(v + i));
+		_mm_storeu_si128((__m128i *)(uv + 2*i), _mm_unpacklo_epi8(vu, vv));
+		_mm_storeu_si128((__m128i *)(uv + 2*i + 16), _mm_unpackhi_epi8(vu, vv));
+	}
+	interleave_c(u + i, v + i, uv + 2*i, width - i);
+}
+
+static void deinterleave_sse2(const uint8_t *uv, uint8_t *u, uint8_t *v, int width){
+	__m128i mask = _mm_set1_epi16(0xff);
+	int i = 0;
+	for (; i + 16 <= width; i += 16){
+		__m128i a = _mm_loadu_si128((const __m128i *)(uv + 2*i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(uv + 2*i + 16));
+		_mm_storeu_si128((__m128i *)(u + i), _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+		_mm_storeu_si128((__m128i *)(v + i), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+	}
+	deinterleave_c(uv + 2*i, u + i, v + i, width - i);
+}
+
+/* ---- AVX2 kernels, selected at runtime ----
+ * They finish with the SSE2 versions, after clearing the upper halves of the registers to avoid the AVX to SSE transition penalty.
+ */
+
+#ifdef SCALER_HAVE_AVX2
+
+AVX2_FUNC static void vblend_avx2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int f, int width){
+	__m256i zero = _mm256_setzero_si256();
+	__m256i fa = _mm256_set1_epi16((short)(FRAC_ONE - f));
+	__m256i fb = _mm256_set1_epi16((short)f);
+	__m256i round = _mm256_set1_epi16(FRAC_ROUND);
+	int i = 0;
+
+	/*unpack and pack work within 128 bits lanes, so the order of pixels is preserved*/
+	for (; i + 32 <= width; i += 32){
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), fa), _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), fb));
+		__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), fa), _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), fb));
+		lo = _mm256_srli_epi16(_mm256_add_epi16(lo, round), FRAC_BITS);
+		hi = _mm256_srli_epi16(_mm256_add_epi16(hi, round), FRAC_BITS);
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+	}
+	_mm256_zeroupper();
+	vblend_sse2(a + i, b + i, dst + i, f, width - i);
+}
+
+AVX2_FUNC static void interleave_avx2(const uint8_t *u, const uint8_t *v, uint8_t *uv, int width){
+	int i = 0;
+	for (; i + 32 <= width; i += 32){
+		__m256i vu = _mm256_loadu_si256((const __m256i *)(u + i));
+		__m256i vv = _mm256_loadu_si256((const __m256i *)(v + i));
+		__m256i lo = _mm256_unpacklo_epi8(vu, vv);
+		__m256i hi = _mm256_unpackhi_epi8(vu, vv);
+		_mm256_storeu_si256((__m256i *)(uv + 2*i), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(uv + 2*i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	_mm256_zeroupper();
+	interleave_sse2(u + i, v + i, uv + 2*i, width - i);
+}
+
+AVX2_FUNC static void deinterleave_avx2(const uint8_t *uv, uint8_t *u, uint8_t *v, int width){
+	__m256i mask = _mm256_set1_epi16(0xff);
+	int i = 0;
+	for (; i + 32 <= width; i += 32){
+		__m256i a = _mm256_loadu_si256((const __m256i *)(uv + 2*i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(uv + 2*i + 32));
+		__m256i pu = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+		__m256i pv = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+		/*packing interleaves the 64 bits quarters of a and b*/
+		_mm256_storeu_si256((__m256i *)(u + i), _mm256_permute4x64_epi64(pu, 0xd8));
+		_mm256_storeu_si256((__m256i *)(v + i), _mm256_permute4x64_epi64(pv, 0xd8));
+	}
+	_mm256_zeroupper();
+	deinterleave_sse2(uv + 2*i, u + i, v + i, width - i);
+}
+
+static bool_t cpu_has_avx2(void){
+	return __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+}
+
+#endif
+
+/* ---- plane scaling ---- */
+
+/*maps the centers of destination pixels to the source, and returns for each of them the position of its left (or top) neighbour with the fraction*/
+/*with nearest, positions are rounded to whole pixels, so that the blends give exact copies of the nearest source pixel*/
+static int *compute_positions(int src_len, int dst_len, bool_t nearest){
+	int *pos = ms_new(int, dst_len);
+	int i;
+	for (i = 0; i < dst_len; ++i){
+		int64_t p = (((int64_t)(2*i + 1) * src_len * FRAC_ONE) / (2 * dst_len)) - FRAC_ROUND;
+		if (nearest) p = ((p + FRAC_ROUND) >> FRAC_BITS) << FRAC_BITS;
+		if (p < 0) p = 0;
+		if (p > (int64_t)(src_len - 1) * FRAC_ONE) p = (int64_t)(src_len - 1) * FRAC_ONE;
+		pos[i] = (int)p;
+	}
+	return pos;
+}
+
+static void plane_scaler_init(PlaneScaler *ps, int src_w, int src_h, int dst_w, int dst_h, bool_t nearest){
+	ps->src_w = src_w;
+	ps->src_h = src_h;
+	ps->dst_w = dst_w;
+	ps->dst_h = dst_h;
+	ps->x_pos = compute_positions(src_w, dst_w, nearest);
+	ps->y_pos = compute_positions(src_h, dst_h, nearest);
+	ps->half_width = (src_w == 2 * dst_w) && !nearest;
+}
+
+static void plane_scaler_uninit(PlaneScaler *ps){
+	if (ps->x_pos) ms_free(ps->x_pos);
+	if (ps->y_pos) ms_free(ps->y_pos);
+}
+
+static void hscale_half(const uint8_t *src, uint8_t *dst, int dst_w){
+	__m128i mask = _mm_set1_epi16(0xff);
+	int i = 0;
+	for (; i + 16 <= dst_w; i += 16){
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + 2*i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + 2*i + 16));
+		__m128i avg_a = _mm_avg_epu16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+		__m128i avg_b = _mm_avg_epu16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(avg_a, avg_b));
+	}
+	for (; i < dst_w; ++i){
+		dst[i] = (uint8_t)((src[2*i] + src[2*i + 1] + 1) >> 1);
+	}
+}
+
+/*the source row must have one extra pixel duplicating the last one*/
+static void hscale_bilinear(const uint8_t *src, uint8_t *dst, const int *x_pos, int dst_w){
+	int i;
+	for (i = 0; i < dst_w; ++i){
+		int x = x_pos[i] >> FRAC_BITS;
+		int f = x_pos[i] & (FRAC_ONE - 1);
+		dst[i] = (uint8_t)((src[x] * (FRAC_ONE - f) + src[x + 1] * f + FRAC_ROUND) >> FRAC_BITS);
+	}
+}
+
+static void plane_scale(MSX86ScalerContext *ctx, PlaneScaler *ps, const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride){
+	int y;
+	for (y = 0; y < ps->dst_h; ++y){
+		int sy = ps->y_pos[y] >> FRAC_BITS;
+		int fy = ps->y_pos[y] & (FRAC_ONE - 1);
+		const uint8_t *line = src + sy * src_stride;
+		uint8_t *out = dst + y * dst_stride;
+
+		if (fy != 0){
+			ctx->vblend(line, line + src_stride, ctx->row, fy, ps->src_w);
+			line = ctx->row;
+		}
+		if (ps->src_w == ps->dst_w){
+			if (line != out) memcpy(out, line, ps->dst_w);
+		}else if (ps->half_width){
+			hscale_half(line, out, ps->dst_w);
+		}else{
+			if (line != ctx->row) memcpy(ctx->row, line, ps->src_w);
+			ctx->row[ps->src_w] = ctx->row[ps->src_w - 1];
+			hscale_bilinear(ctx->row, out, ps->x_pos, ps->dst_w);
+		}
+	}
+}
+
+static void plane_copy(const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride, int w, int h){
+	int y;
+	for (y = 0; y < h; ++y){
+		memcpy(dst + y * dst_stride, src + y * src_stride, w);
+	}
+}
+
+/* ---- YUV to RGB, ITU-R BT.601 with limited range, coefficients in Q13 ---- */
+
+#define YUV2RGB_SHIFT 13
+#define COEF_Y 9535
+#define COEF_RV 13074
+#define COEF_GV -6660
+#define COEF_GU -3203
+#define COEF_BU 16531
+
+static MS2_INLINE uint8_t clip_u8(int v){
+	return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static MS2_INLINE void yuv2rgb_pixel(int y, int u, int v, uint8_t *r, uint8_t *g, uint8_t *b){
+	const int round = 1 << (YUV2RGB_SHIFT - 1);
+	y = (y - 16) * COEF_Y + round;
+	u -= 128;
+	v -= 128;
+	*r = clip_u8((y + COEF_RV * v) >> YUV2RGB_SHIFT);
+	*g = clip_u8((y + COEF_GV * v + COEF_GU * u) >> YUV2RGB_SHIFT);
+	*b = clip_u8((y + COEF_BU * u) >> YUV2RGB_SHIFT);
+}
+
+/*computes 8 pixels: y, u and v contain 8 signed 16 bits values, with u and v already upsampled*/
+static MS2_INLINE void yuv2rgb_8(__m128i y, __m128i u, __m128i v, __m128i *r, __m128i *g, __m128i *b){
+	const __m128i round = _mm_set1_epi32(1 << (YUV2RGB_SHIFT - 1));
+	const __m128i c_rv = _mm_set_epi16(COEF_RV, COEF_Y, COEF_RV, COEF_Y, COEF_RV, COEF_Y, COEF_RV, COEF_Y);
+	const __m128i c_gv = _mm_set_epi16(COEF_GV, COEF_Y, COEF_GV, COEF_Y, COEF_GV, COEF_Y, COEF_GV, COEF_Y);
+	const __m128i c_gu = _mm_set_epi16(0, COEF_GU, 0, COEF_GU, 0, COEF_GU, 0, COEF_GU);
+	const __m128i c_bu = _mm_set_epi16(COEF_BU, COEF_Y, COEF_BU, COEF_Y, COEF_BU, COEF_Y, COEF_BU, COEF_Y);
+	__m128i zero = _mm_setzero_si128();
+	__m128i yv_lo = _mm_unpacklo_epi16(y, v), yv_hi = _mm_unpackhi_epi16(y, v);
+	__m128i yu_lo = _mm_unpacklo_epi16(y, u), yu_hi = _mm_unpackhi_epi16(y, u);
+	__m128i u_lo = _mm_unpacklo_epi16(u, zero), u_hi = _mm_unpackhi_epi16(u, zero);
+	__m128i lo, hi;
+
+	lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yv_lo, c_rv), round), YUV2RGB_SHIFT);
+	hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yv_hi, c_rv), round), YUV2RGB_SHIFT);
+	*r = _mm_packs_epi32(lo, hi);
+	lo = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(yv_lo, c_gv), _mm_madd_epi16(u_lo, c_gu)), round), YUV2RGB_SHIFT);
+	hi = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(yv_hi, c_gv), _mm_madd_epi16(u_hi, c_gu)), round), YUV2RGB_SHIFT);
+	*g = _mm_packs_epi32(lo, hi);
+	lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_lo, c_bu), round), YUV2RGB_SHIFT);
+	hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_hi, c_bu), round), YUV2RGB_SHIFT);
+	*b = _mm_packs_epi32(lo, hi);
+}
+
+/*converts 16 pixels of a row into saturated 8 bits r, g, b vectors*/
+static MS2_INLINE void yuv2rgb_16(const uint8_t *py, const uint8_t *pu, const uint8_t *pv, __m128i *r, __m128i *g, __m128i *b){
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c16 = _mm_set1_epi16(16);
+	const __m128i c128 = _mm_set1_epi16(128);
+	__m128i vy = _mm_loadu_si128((const __m128i *)py);
+	__m128i vu = _mm_loadl_epi64((const __m128i *)pu);
+	__m128i vv = _mm_loadl_epi64((const __m128i *)pv);
+	__m128i r0, g0, b0, r1, g1, b1;
+
+	vu = _mm_unpacklo_epi8(vu, vu); /*each chroma sample covers two pixels*/
+	vv = _mm_unpacklo_epi8(vv, vv);
+	yuv2rgb_8(_mm_sub_epi16(_mm_unpacklo_epi8(vy, zero), c16), _mm_sub_epi16(_mm_unpacklo_epi8(vu, zero), c128),
+		_mm_sub_epi16(_mm_unpacklo_epi8(vv, zero), c128), &r0, &g0, &b0);
+	yuv2rgb_8(_mm_sub_epi16(_mm_unpackhi_epi8(vy, zero), c16), _mm_sub_epi16(_mm_unpackhi_epi8(vu, zero), c128),
+		_mm_sub_epi16(_mm_unpackhi_epi8(vv, zero), c128), &r1, &g1, &b1);
+	*r = _mm_packus_epi16(r0, r1);
+	*g = _mm_packus_epi16(g0, g1);
+	*b = _mm_packus_epi16(b0, b1);
+}
+
+static void yuv2rgba_row(const uint8_t *py, const uint8_t *pu, const uint8_t *pv, uint8_t *dst, int width){
+	const __m128i alpha = _mm_set1_epi8((char)0xff);
+	int i = 0;
+	for (; i + 16 <= width; i += 16){
+		__m128i r, g, b, rg, ba;
+		yuv2rgb_16(py + i, pu + i/2, pv + i/2, &r, &g, &b);
+		rg = _mm_unpacklo_epi8(r, g);
+		ba = _mm_unpacklo_epi8(b, alpha);
+		_mm_storeu_si128((__m128i *)(dst + 4*i), _mm_unpacklo_epi16(rg, ba));
+		_mm_storeu_si128((__m128i *)(dst + 4*i + 16), _mm_unpackhi_epi16(rg, ba));
+		rg = _mm_unpackhi_epi8(r, g);
+		ba = _mm_unpackhi_epi8(b, alpha);
+		_mm_storeu_si128((__m128i *)(dst + 4*i + 32), _mm_unpacklo_epi16(rg, ba));
+		_mm_storeu_si128((__m128i *)(dst + 4*i + 48), _mm_unpackhi_epi16(rg, ba));
+	}
+	for (; i < width; ++i){
+		yuv2rgb_pixel(py[i], pu[i/2], pv[i/2], dst + 4*i, dst + 4*i + 1, dst + 4*i + 2);
+		dst[4*i + 3] = 0xff;
+	}
+}
+
+static void yuv2rgb24_row(const uint8_t *py, const uint8_t *pu, const uint8_t *pv, uint8_t *dst, int width){
+	uint8_t r8[16], g8[16], b8[16];
+	int i = 0, j;
+	for (; i + 16 <= width; i += 16){
+		__m128i r, g, b;
+		uint8_t *out = dst + 3*i;
+		yuv2rgb_16(py + i, pu + i/2, pv + i/2, &r, &g, &b);
+		_mm_storeu_si128((__m128i *)r8, r);
+		_mm_storeu_si128((__m128i *)g8, g);
+		_mm_storeu_si128((__m128i *)b8, b);
+		for (j = 0; j < 16; ++j, out += 3){
+			out[0] = r8[j];
+			out[1] = g8[j];
+			out[2] = b8[j];
+		}
+	}
+	for (; i < width; ++i){
+		yuv2rgb_pixel(py[i], pu[i/2], pv[i/2], dst + 3*i, dst + 3*i + 1, dst + 3*i + 2);
+	}
+}
+
+static void yuv2rgb565_row(const uint8_t *py, const uint8_t *pu, const uint8_t *pv, uint8_t *dst, int width){
+	const __m128i zero = _mm_setzero_si128();
+	uint16_t *out = (uint16_t *)dst;
+	int i = 0;
+	for (; i + 16 <= width; i += 16){
+		__m128i r, g, b, lo, hi;
+		yuv2rgb_16(py + i, pu + i/2, pv + i/2, &r, &g, &b);
+		lo = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(_mm_unpacklo_epi8(r, zero), 3), 11),
+			_mm_slli_epi16(_mm_srli_epi16(_mm_unpacklo_epi8(g, zero), 2), 5)), _mm_srli_epi16(_mm_unpacklo_epi8(b, zero), 3));
+		hi = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(_mm_unpackhi_epi8(r, zero), 3), 11),
+			_mm_slli_epi16(_mm_srli_epi16(_mm_unpackhi_epi8(g, zero), 2), 5)), _mm_srli_epi16(_mm_unpackhi_epi8(b, zero), 3));
+		_mm_storeu_si128((__m128i *)(out + i), lo);
+		_mm_storeu_si128((__m128i *)(out + i + 8), hi);
+	}
+	for (; i < width; ++i){
+		uint8_t r, g, b;
+		yuv2rgb_pixel(py[i], pu[i/2], pv[i/2], &r, &g, &b);
+		out[i] = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+	}
+}
+
+/* ---- MSScalerDesc implementation ---- */
+
+static bool_t is_supported_input(MSPixFmt fmt){
+	return fmt == MS_YUV420P || fmt == MS_NV12 || fmt == MS_NV21;
+}
+
+static bool_t is_supported_output(MSPixFmt fmt){
+	return fmt == MS_YUV420P || fmt == MS_NV12 || fmt == MS_NV21 || fmt == MS_RGB24 || fmt == MS_RGBA32 || fmt == MS_RGB565;
+}
+
+static void alloc_yuv(uint8_t *planes[3], int strides[3], int w, int h){
+	int cw = (w + 1) / 2, ch = (h + 1) / 2;
+	/*16 bytes of padding so that kernels may read a full vector at the end of a plane*/
+	planes[0] = ms_malloc(w * h + 2 * cw * ch + 16);
+	planes[1] = planes[0] + w * h;
+	planes[2] = planes[1] + cw * ch;
+	strides[0] = w;
+	strides[1] = strides[2] = cw;
+}
+
+static MSScalerContext *x86_create_scaler_context(int src_w, int src_h, MSPixFmt src_fmt, int dst_w, int dst_h, MSPixFmt dst_fmt, int flags){
+	MSX86ScalerContext *ctx;
+	/*like with swscale, bilinear wins when both methods are requested*/
+	bool_t nearest = (flags & MS_SCALER_METHOD_NEIGHBOUR) && !(flags & MS_SCALER_METHOD_BILINEAR);
+	int i;
+
+	if (!is_supported_input(src_fmt) || !is_supported_output(dst_fmt) || src_w < 2 || src_h < 2 || dst_w < 2 || dst_h < 2){
+#ifndef NO_FFMPEG
+		MSScalerContext *fallback = ffmpeg_scaler.create_context(src_w, src_h, src_fmt, dst_w, dst_h, dst_fmt, flags);
+		if (fallback == NULL) return NULL;
+		ctx = ms_new0(MSX86ScalerContext, 1);
+		ctx->fallback = fallback;
+		return (MSScalerContext *)ctx;
+#else
+		ms_error("x86 scaler: unsupported conversion from %s %ix%i to %s %ix%i", ms_pix_fmt_to_string(src_fmt), src_w, src_h,
+			ms_pix_fmt_to_string(dst_fmt), dst_w, dst_h);
+		return NULL;
+#endif
+	}
+	ctx = ms_new0(MSX86ScalerContext, 1);
+	ctx->src_w = src_w;
+	ctx->src_h = src_h;
+	ctx->dst_w = dst_w;
+	ctx->dst_h = dst_h;
+	ctx->src_fmt = src_fmt;
+	ctx->dst_fmt = dst_fmt;
+	ctx->vblend = vblend_sse2;
+	ctx->interleave = interleave_sse2;
+	ctx->deinterleave = deinterleave_sse2;
+#ifdef SCALER_HAVE_AVX2
+	if (cpu_has_avx2()){
+		ctx->vblend = vblend_avx2;
+		ctx->interleave = interleave_avx2;
+		ctx->deinterleave = deinterleave_avx2;
+	}
+#endif
+	plane_scaler_init(&ctx->planes[0], src_w, src_h, dst_w, dst_h, nearest);
+	for (i = 1; i < 3; ++i)
+		plane_scaler_init(&ctx->planes[i], (src_w + 1) / 2, (src_h + 1) / 2, (dst_w + 1) / 2, (dst_h + 1) / 2, nearest);
+	ctx->row = ms_malloc(src_w + 16);
+	if (src_fmt != MS_YUV420P)
+		alloc_yuv(ctx->src_yuv, ctx->src_yuv_strides, src_w, src_h);
+	if (dst_fmt != MS_YUV420P && (src_w != dst_w || src_h != dst_h))
+		alloc_yuv(ctx->scaled_yuv, ctx->scaled_yuv_strides, dst_w, dst_h);
+	return (MSScalerContext *)ctx;
+}
+
+static int x86_scaler_process(MSScalerContext *c, uint8_t *src[], int src_strides[], uint8_t *dst[], int dst_strides[]){
+	MSX86ScalerContext *ctx = (MSX86ScalerContext *)c;
+	const uint8_t *yuv[3];
+	int yuv_strides[3];
+	int cw, ch, y, i;
+
+#ifndef NO_FFMPEG
+	if (ctx->fallback) return ffmpeg_scaler.context_process(ctx->fallback, src, src_strides, dst, dst_strides);
+#endif
+
+	/*get a YUV420P source*/
+	cw = (ctx->src_w + 1) / 2;
+	ch = (ctx->src_h + 1) / 2;
+	if (ctx->src_fmt == MS_YUV420P){
+		for (i = 0; i < 3; ++i){
+			yuv[i] = src[i];
+			yuv_strides[i] = src_strides[i];
+		}
+	}else{
+		int u = (ctx->src_fmt == MS_NV12) ? 1 : 2;
+		for (y = 0; y < ch; ++y){
+			ctx->deinterleave(src[1] + y * src_strides[1], ctx->src_yuv[u] + y * ctx->src_yuv_strides[u],
+				ctx->src_yuv[3 - u] + y * ctx->src_yuv_strides[3 - u], cw);
+		}
+		yuv[0] = src[0];
+		yuv_strides[0] = src_strides[0];
+		for (i = 1; i < 3; ++i){
+			yuv[i] = ctx->src_yuv[i];
+			yuv_strides[i] = ctx->src_yuv_strides[i];
+		}
+	}
+
+	/*scale it*/
+	cw = (ctx->dst_w + 1) / 2;
+	ch = (ctx->dst_h + 1) / 2;
+	if (ctx->src_w != ctx->dst_w || ctx->src_h != ctx->dst_h){
+		uint8_t **out = (ctx->dst_fmt == MS_YUV420P) ? dst : ctx->scaled_yuv;
+		int *out_strides = (ctx->dst_fmt == MS_YUV420P) ? dst_strides : ctx->scaled_yuv_strides;
+		for (i = 0; i < 3; ++i){
+			plane_scale(ctx, &ctx->planes[i], yuv[i], yuv_strides[i], out[i], out_strides[i]);
+			yuv[i] = out[i];
+			yuv_strides[i] = out_strides[i];
+		}
+		if (ctx->dst_fmt == MS_YUV420P) return 0;
+	}
+
+	/*convert to the destination format*/
+	switch (ctx->dst_fmt){
+		case MS_YUV420P:
+			plane_copy(yuv[0], yuv_strides[0], dst[0], dst_strides[0], ctx->dst_w, ctx->dst_h);
+			plane_copy(yuv[1], yuv_strides[1], dst[1], dst_strides[1], cw, ch);
+			plane_copy(yuv[2], yuv_strides[2], dst[2], dst_strides[2], cw, ch);
+		break;
+		case MS_NV12:
+		case MS_NV21:
+		{
+			int u = (ctx->dst_fmt == MS_NV12) ? 1 : 2;
+			plane_copy(yuv[0], yuv_strides[0], dst[0], dst_strides[0], ctx->dst_w, ctx->dst_h);
+			for (y = 0; y < ch; ++y){
+				ctx->interleave(yuv[u] + y * yuv_strides[u], yuv[3 - u] + y * yuv_strides[3 - u], dst[1] + y * dst_strides[1], cw);
+			}
+		}
+		break;
+		case MS_RGBA32:
+		case MS_RGB24:
+		case MS_RGB565:
+			for (y = 0; y < ctx->dst_h; ++y){
+				const uint8_t *py = yuv[0] + y * yuv_strides[0];
+				const uint8_t *pu = yuv[1] + (y / 2) * yuv_strides[1];
+				const uint8_t *pv = yuv[2] + (y / 2) * yuv_strides[2];
+				uint8_t *out = dst[0] + y * dst_strides[0];
+				if (ctx->dst_fmt == MS_RGBA32) yuv2rgba_row(py, pu, pv, out, ctx->dst_w);
+				else if (ctx->dst_fmt == MS_RGB24) yuv2rgb24_row(py, pu, pv, out, ctx->dst_w);
+				else yuv2rgb565_row(py, pu, pv, out, ctx->dst_w);
+			}
+		break;
+		default:
+		break;
+	}
+	return 0;
+}
+
+static void x86_scaler_context_free(MSScalerContext *c){
+	MSX86ScalerContext *ctx = (MSX86ScalerContext *)c;
+	int i;
+
+#ifndef NO_FFMPEG
+	if (ctx->fallback) ffmpeg_scaler.context_free(ctx->fallback);
+#endif
+	for (i = 0; i < 3; ++i) plane_scaler_uninit(&ctx->planes[i]);
+	if (ctx->row) ms_free(ctx->row);
+	if (ctx->src_yuv[0]) ms_free(ctx->src_yuv[0]);
+	if (ctx->scaled_yuv[0]) ms_free(ctx->scaled_yuv[0]);
+	ms_free(ctx);
+}
+
+MSScalerDesc ms_x86_scaler = {
+	x86_create_scaler_context,
+	x86_scaler_process,
+	x86_scaler_context_free
+};
+
+#endif
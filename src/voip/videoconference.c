@@ -0,0 +1,250 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "mediastreamer2/msconference.h"
+#include "mediastreamer2/msvideoswitcher.h"
+#include "private.h"
+
+struct _MSVideoConference{
+	MSTicker *ticker;
+	MSFilter *switcher;
+	MSVideoConferenceParams params;
+	MSVideoEndpoint *members[MS_VIDEO_SWITCHER_MAX_INPUTS]; /*indexed by pin of the switcher*/
+	MSVideoEndpoint *focus;
+	int nmembers;
+};
+
+struct _MSVideoEndpoint{
+	VideoStream *st;
+	MSCPoint in_cut_point; /*the filter that was after the MSRtpRecv*/
+	MSCPoint out_cut_point; /*the filter that was before the MSRtpSend*/
+	MSVideoConference *conference;
+	int pin;
+};
+
+static void on_switcher_event(void *data, MSFilter *f, unsigned int event_id, void *arg){
+	MSVideoConference *obj=(MSVideoConference*)data;
+	int pin=*(int*)arg;
+	MSVideoEndpoint *ep=obj->members[pin];
+
+	if (ep==NULL) return;
+	switch(event_id){
+		case MS_VIDEO_SWITCHER_SEND_FIR:
+			ms_message("Video conference: sending FIR to participant on pin %i",pin);
+			video_stream_send_fir(ep->st);
+			break;
+		case MS_VIDEO_SWITCHER_SEND_PLI:
+			ms_message("Video conference: sending PLI to participant on pin %i",pin);
+			video_stream_send_pli(ep->st);
+			break;
+	}
+}
+
+MSVideoConference * ms_video_conference_new(MSFactory *factory, const MSVideoConferenceParams *params){
+	MSVideoConference *obj=ms_new0(MSVideoConference,1);
+	MSPinFormat pinfmt={0};
+	MSVideoSize vsize={0};
+
+	obj->ticker=ms_ticker_new();
+	ms_ticker_set_name(obj->ticker,"Video conference MSTicker");
+	ms_ticker_set_priority(obj->ticker,__ms_get_default_prio(TRUE));
+	obj->switcher=ms_factory_create_filter(factory,MS_VIDEO_SWITCHER_ID);
+	pinfmt.fmt=ms_factory_get_video_format(factory,params->codec_mime_type,vsize,0,NULL);
+	ms_filter_call_method(obj->switcher,MS_FILTER_SET_INPUT_FMT,&pinfmt);
+	ms_filter_add_notify_callback(obj->switcher,on_switcher_event,obj,TRUE);
+	obj->params=*params;
+	/*the format descriptor is owned by the factory, so the encoding name remains valid*/
+	obj->params.codec_mime_type=pinfmt.fmt->encoding;
+	return obj;
+}
+
+const MSVideoConferenceParams *ms_video_conference_get_params(MSVideoConference *obj){
+	return &obj->params;
+}
+
+static MSCPoint just_before(MSFilter *f){
+	MSQueue *q;
+	MSCPoint pnull={0};
+	if ((q=f->inputs[0])!=NULL){
+		return q->prev;
+	}
+	ms_fatal("No filter before %s",f->desc->name);
+	return pnull;
+}
+
+static MSCPoint just_after(MSFilter *f){
+	MSQueue *q;
+	MSCPoint pnull={0};
+	if ((q=f->outputs[0])!=NULL){
+		return q->next;
+	}
+	ms_fatal("No filter after %s",f->desc->name);
+	return pnull;
+}
+
+static void cut_video_stream_graph(MSVideoEndpoint *ep){
+	VideoStream *st=ep->st;
+	MSTicker *ticker=st->ms.sessions.ticker;
+
+	/*stop the video graph, only its MSRtpRecv and MSRtpSend are used by the conference*/
+	if (st->source) ms_ticker_detach(ticker,st->source);
+	if (st->void_source) ms_ticker_detach(ticker,st->void_source);
+	if (st->ms.rtprecv) ms_ticker_detach(ticker,st->ms.rtprecv);
+
+	if (st->ms.rtprecv && st->ms.rtprecv->outputs[0]){
+		ep->in_cut_point=just_after(st->ms.rtprecv);
+		ms_filter_unlink(st->ms.rtprecv,0,ep->in_cut_point.filter,ep->in_cut_point.pin);
+	}
+	if (st->ms.rtpsend && st->ms.rtpsend->inputs[0]){
+		ep->out_cut_point=just_before(st->ms.rtpsend);
+		ms_filter_unlink(ep->out_cut_point.filter,ep->out_cut_point.pin,st->ms.rtpsend,0);
+	}
+}
+
+static void redo_video_stream_graph(MSVideoEndpoint *ep){
+	VideoStream *st=ep->st;
+	MSTicker *ticker=st->ms.sessions.ticker;
+
+	if (ep->in_cut_point.filter)
+		ms_filter_link(st->ms.rtprecv,0,ep->in_cut_point.filter,ep->in_cut_point.pin);
+	if (ep->out_cut_point.filter)
+		ms_filter_link(ep->out_cut_point.filter,ep->out_cut_point.pin,st->ms.rtpsend,0);
+	if (st->source) ms_ticker_attach(ticker,st->source);
+	if (st->void_source) ms_ticker_attach(ticker,st->void_source);
+	if (st->ms.rtprecv) ms_ticker_attach(ticker,st->ms.rtprecv);
+}
+
+static int find_free_pin(MSFilter *switcher){
+	int i;
+	for(i=0;i<switcher->desc->ninputs;++i){
+		if (switcher->inputs[i]==NULL && switcher->outputs[i]==NULL){
+			return i;
+		}
+	}
+	ms_fatal("No more free pin in switcher filter");
+	return -1;
+}
+
+/*the MSRtpRecv of the participants are the sources of the conference graph*/
+static void attach_switcher(MSVideoConference *obj){
+	int i;
+	for(i=0;i<MS_VIDEO_SWITCHER_MAX_INPUTS;++i){
+		if (obj->switcher->inputs[i]!=NULL){
+			ms_ticker_attach(obj->ticker,obj->switcher);
+			return;
+		}
+	}
+}
+
+static void detach_switcher(MSVideoConference *obj){
+	if (obj->switcher->ticker) ms_ticker_detach(obj->ticker,obj->switcher);
+}
+
+static void give_focus(MSVideoConference *obj, MSVideoEndpoint *ep){
+	obj->focus=ep;
+	if (ep) ms_filter_call_method(obj->switcher,MS_VIDEO_SWITCHER_SET_FOCUS,&ep->pin);
+}
+
+static void plumb_to_conf(MSVideoEndpoint *ep){
+	MSVideoConference *conf=ep->conference;
+	VideoStream *st=ep->st;
+
+	ep->pin=find_free_pin(conf->switcher);
+	if (ep->in_cut_point.filter)
+		ms_filter_link(st->ms.rtprecv,0,conf->switcher,ep->pin);
+	if (ep->out_cut_point.filter)
+		ms_filter_link(conf->switcher,ep->pin,st->ms.rtpsend,0);
+	st->video_switcher=conf->switcher;
+	st->video_switcher_pin=ep->pin;
+}
+
+static void unplumb_from_conf(MSVideoEndpoint *ep){
+	MSVideoConference *conf=ep->conference;
+	VideoStream *st=ep->st;
+
+	if (ep->in_cut_point.filter)
+		ms_filter_unlink(st->ms.rtprecv,0,conf->switcher,ep->pin);
+	if (ep->out_cut_point.filter)
+		ms_filter_unlink(conf->switcher,ep->pin,st->ms.rtpsend,0);
+	st->video_switcher=NULL;
+}
+
+void ms_video_conference_add_member(MSVideoConference *obj, MSVideoEndpoint *ep){
+	detach_switcher(obj);
+	ep->conference=obj;
+	plumb_to_conf(ep);
+	obj->members[ep->pin]=ep;
+	obj->nmembers++;
+	if (obj->focus==NULL && ep->in_cut_point.filter) give_focus(obj,ep);
+	attach_switcher(obj);
+}
+
+void ms_video_conference_remove_member(MSVideoConference *obj, MSVideoEndpoint *ep){
+	int i;
+
+	detach_switcher(obj);
+	unplumb_from_conf(ep);
+	obj->members[ep->pin]=NULL;
+	obj->nmembers--;
+	ep->conference=NULL;
+	if (obj->focus==ep){
+		obj->focus=NULL;
+		for(i=0;i<MS_VIDEO_SWITCHER_MAX_INPUTS;++i){
+			MSVideoEndpoint *member=obj->members[i];
+			if (member && member->in_cut_point.filter){
+				give_focus(obj,member);
+				break;
+			}
+		}
+	}
+	ep->pin=-1;
+	if (obj->nmembers>0) attach_switcher(obj);
+}
+
+void ms_video_conference_set_focus(MSVideoConference *obj, MSVideoEndpoint *ep){
+	if (ep->conference!=obj){
+		ms_error("ms_video_conference_set_focus(): endpoint [%p] is not a member of conference [%p]",ep,obj);
+		return;
+	}
+	give_focus(obj,ep);
+}
+
+int ms_video_conference_get_size(MSVideoConference *obj){
+	return obj->nmembers;
+}
+
+void ms_video_conference_destroy(MSVideoConference *obj){
+	ms_ticker_destroy(obj->ticker);
+	ms_filter_destroy(obj->switcher);
+	ms_free(obj);
+}
+
+MSVideoEndpoint * ms_video_endpoint_get_from_stream(VideoStream *st){
+	MSVideoEndpoint *ep=ms_new0(MSVideoEndpoint,1);
+	ep->st=st;
+	ep->pin=-1;
+	cut_video_stream_graph(ep);
+	return ep;
+}
+
+void ms_video_endpoint_release_from_stream(MSVideoEndpoint *obj){
+	if (obj->conference) ms_video_conference_remove_member(obj->conference,obj);
+	redo_video_stream_graph(obj);
+	ms_free(obj);
+}
@@ -27,8 +27,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/msvideoout.h"
 #include "mediastreamer2/msextdisplay.h"
 #include "mediastreamer2/msitc.h"
+#include "mediastreamer2/mspacer.h"
 #include "mediastreamer2/zrtp.h"
 #include "mediastreamer2/msvideopresets.h"
+#include "mediastreamer2/msvideoswitcher.h"
 #include "mediastreamer2/mseventqueue.h"
 #include "private.h"
 
@@ -40,6 +42,7 @@ static int video_stream_start_with_source_and_output(VideoStream *stream, RtpPro
 void video_stream_free(VideoStream *stream) {
 	bool_t rtp_source = FALSE;
 	bool_t rtp_output = FALSE;
+	int i;
 
 	if ((stream->source != NULL) && (ms_filter_get_id(stream->source) == MS_RTP_RECV_ID))
 		rtp_source = TRUE;
@@ -54,6 +57,11 @@ void video_stream_free(VideoStream *stream) {
 		stream->ms.decoder = NULL;
 	}
 
+	/* The retransmission and FEC handlers are installed on the RTP session, which is destroyed by media_stream_free(). */
+	if (stream->retransmission != NULL)
+		ms_rtp_retransmission_destroy(stream->retransmission);
+	if (stream->fec != NULL)
+		ms_rtp_fec_destroy(stream->fec);
 	media_stream_free(&stream->ms);
 
 	if (stream->void_source != NULL)
@@ -64,6 +72,8 @@ void video_stream_free(VideoStream *stream) {
 		ms_filter_destroy (stream->output);
 	if (stream->sizeconv != NULL)
 		ms_filter_destroy (stream->sizeconv);
+	if (stream->pacer != NULL)
+		ms_filter_destroy(stream->pacer);
 	if (stream->pixconv!=NULL)
 		ms_filter_destroy(stream->pixconv);
 	if (stream->tee!=NULL)
@@ -78,6 +88,10 @@ void video_stream_free(VideoStream *stream) {
 		ms_filter_destroy(stream->tee3);
 	if (stream->recorder_output)
 		ms_filter_destroy(stream->recorder_output);
+	for (i = 0; i < stream->simulcast_layers - 1; i++) {
+		if (stream->simulcast_rtpsends[i] != NULL)
+			ms_filter_destroy(stream->simulcast_rtpsends[i]);
+	}
 	if (stream->local_jpegwriter)
 		ms_filter_destroy(stream->local_jpegwriter);
 	if (stream->rtp_io_session)
@@ -127,6 +141,9 @@ static void video_stream_process_rtcp(MediaStream *media_stream, mblk_t *m){
 	VideoStream *stream = (VideoStream *)media_stream;
 	int i;
 
+	if (stream->retransmission && ms_rtp_retransmission_process_rtcp(stream->retransmission, m)) return;
+	/* Without rate control, the FEC follows the loss rate reported by the remote party on its own. */
+	if (stream->fec && stream->ms.rc == NULL) ms_rtp_fec_process_rtcp(stream->fec, m);
 	if (rtcp_is_PSFB(m) && (stream->ms.encoder != NULL)) {
 		/* The PSFB messages are to be notified to the encoder, so if we have no encoder simply ignore them. */
 		if (rtcp_PSFB_get_media_source_ssrc(m) == rtp_session_get_send_ssrc(stream->ms.sessions.rtp_session)) {
@@ -137,7 +154,10 @@ static void video_stream_process_rtcp(MediaStream *media_stream, mblk_t *m){
 						if (fci == NULL) break;
 						if (rtcp_fb_fir_fci_get_ssrc(fci) == rtp_session_get_recv_ssrc(stream->ms.sessions.rtp_session)) {
 							uint8_t seq_nr = rtcp_fb_fir_fci_get_seq_nr(fci);
-							ms_filter_call_method(stream->ms.encoder, MS_VIDEO_ENCODER_NOTIFY_FIR, &seq_nr);
+							if (stream->video_switcher)
+								ms_filter_call_method(stream->video_switcher, MS_VIDEO_SWITCHER_NOTIFY_FIR, &stream->video_switcher_pin);
+							else
+								ms_filter_call_method(stream->ms.encoder, MS_VIDEO_ENCODER_NOTIFY_FIR, &seq_nr);
                             stream->ms_video_stat.counter_rcvd_fir++;
                             ms_message("video_stream_process_rtcp stream [%p] FIR count %d", stream,  stream->ms_video_stat.counter_rcvd_fir);
 
@@ -148,7 +168,10 @@ static void video_stream_process_rtcp(MediaStream *media_stream, mblk_t *m){
 				case RTCP_PSFB_PLI:
 
                     stream->ms_video_stat.counter_rcvd_pli++;
-					ms_filter_call_method_noarg(stream->ms.encoder, MS_VIDEO_ENCODER_NOTIFY_PLI);
+					if (stream->video_switcher)
+						ms_filter_call_method(stream->video_switcher, MS_VIDEO_SWITCHER_NOTIFY_PLI, &stream->video_switcher_pin);
+					else
+						ms_filter_call_method_noarg(stream->ms.encoder, MS_VIDEO_ENCODER_NOTIFY_PLI);
                     ms_message("video_stream_process_rtcp stream [%p] PLI count %d", stream,  stream->ms_video_stat.counter_rcvd_pli);
 
 					break;
@@ -224,9 +247,65 @@ static void video_stream_track_fps_changes(VideoStream *stream){
 	}
 }
 
+/* The adaptive rate control changes the bitrate of the encoder, the pacing rate follows it. */
+static void video_stream_update_pacing_rate(VideoStream *stream){
+	int bitrate = 0;
+	if (stream->pacer == NULL || stream->ms.encoder == NULL) return;
+	if (ms_filter_call_method(stream->ms.encoder, MS_FILTER_GET_BITRATE, &bitrate) == 0 && bitrate > 0 && bitrate != stream->pacing_bitrate){
+		ms_filter_call_method(stream->pacer, MS_FILTER_SET_BITRATE, &bitrate);
+		stream->pacing_bitrate = bitrate;
+	}
+}
+
+/* The key frame requests received on the sessions of the simulcast layers are notified to the encoder like the ones of the main session. */
+static void video_stream_process_simulcast_rtcp(VideoStream *stream, RtpSession *session, mblk_t *m){
+	int i;
+	do{
+		if (!rtcp_is_PSFB(m)) continue;
+		switch (rtcp_PSFB_get_type(m)) {
+			case RTCP_PSFB_FIR:
+				for (i = 0; ; i++) {
+					rtcp_fb_fir_fci_t *fci = rtcp_PSFB_fir_get_fci(m, i);
+					if (fci == NULL) break;
+					if (rtcp_fb_fir_fci_get_ssrc(fci) == rtp_session_get_send_ssrc(session)) {
+						uint8_t seq_nr = rtcp_fb_fir_fci_get_seq_nr(fci);
+						ms_filter_call_method(stream->ms.encoder, MS_VIDEO_ENCODER_NOTIFY_FIR, &seq_nr);
+						stream->ms_video_stat.counter_rcvd_fir++;
+						break;
+					}
+				}
+				break;
+			case RTCP_PSFB_PLI:
+				if (rtcp_PSFB_get_media_source_ssrc(m) == rtp_session_get_send_ssrc(session)) {
+					ms_filter_call_method_noarg(stream->ms.encoder, MS_VIDEO_ENCODER_NOTIFY_PLI);
+					stream->ms_video_stat.counter_rcvd_pli++;
+				}
+				break;
+			default:
+				break;
+		}
+	}while(rtcp_next_packet(m));
+}
+
+static void video_stream_iterate_simulcast_layers(VideoStream *stream){
+	OrtpEvent *ev;
+	int i;
+	for (i = 0; i < stream->simulcast_layers - 1; i++) {
+		if (stream->simulcast_evqs[i] == NULL) continue;
+		while ((ev = ortp_ev_queue_get(stream->simulcast_evqs[i])) != NULL) {
+			if (ortp_event_get_type(ev) == ORTP_EVENT_RTCP_PACKET_RECEIVED && stream->ms.encoder != NULL) {
+				video_stream_process_simulcast_rtcp(stream, stream->simulcast_sessions[i], ortp_event_get_data(ev)->packet);
+			}
+			ortp_event_destroy(ev);
+		}
+	}
+}
+
 void video_stream_iterate(VideoStream *stream){
 	media_stream_iterate(&stream->ms);
+	video_stream_iterate_simulcast_layers(stream);
 	video_stream_track_fps_changes(stream);
+	video_stream_update_pacing_rate(stream);
 }
 
 const char *video_stream_get_default_video_renderer(void){
@@ -345,6 +424,84 @@ void video_stream_set_fps(VideoStream *stream, float fps){
 	stream->fps=fps;
 }
 
+void video_stream_enable_simulcast(VideoStream *stream, RtpSession *layer_sessions[], int nlayers){
+	int i;
+	if (nlayers > 2) {
+		ms_warning("VideoStream[%p]: only 2 simulcast layers can be added to the full resolution one.", stream);
+		nlayers = 2;
+	}
+	for (i = 0; i < nlayers; i++) {
+		stream->simulcast_sessions[i] = layer_sessions[i];
+	}
+	stream->simulcast_layers = (nlayers > 0) ? nlayers + 1 : 0;
+}
+
+void video_stream_enable_retransmission(VideoStream *stream, int cache_size){
+	stream->retransmission_cache_size = cache_size;
+}
+
+void video_stream_get_retransmission_stats(VideoStream *stream, MSRtpRetransmissionStats *stats){
+	if (stream->retransmission != NULL) ms_rtp_retransmission_get_stats(stream->retransmission, stats);
+	else memset(stats, 0, sizeof(*stats));
+}
+
+void video_stream_enable_fec(VideoStream *stream, int payload_type){
+	stream->fec_payload_type = payload_type;
+}
+
+void video_stream_get_fec_stats(VideoStream *stream, MSRtpFecStats *stats){
+	if (stream->fec != NULL) ms_rtp_fec_get_stats(stream->fec, stats);
+	else memset(stats, 0, sizeof(*stats));
+}
+
+void video_stream_enable_pacing(VideoStream *stream, bool_t enabled){
+	stream->pacing_enabled = enabled;
+}
+
+void video_stream_set_pacing_priority_session(VideoStream *stream, RtpSession *session){
+	stream->pacing_priority_session = session;
+	if (stream->pacer != NULL) ms_filter_call_method(stream->pacer, MS_PACER_SET_PRIORITY_SESSION, session);
+}
+
+int video_stream_get_pacing_queue_delay(VideoStream *stream){
+	int delay = 0;
+	if (stream->pacer != NULL) ms_filter_call_method(stream->pacer, MS_PACER_GET_QUEUE_DELAY, &delay);
+	return delay;
+}
+
+/* Connect the outputs of the encoder carrying the lower resolution layers to their RTP sessions. */
+static void link_simulcast_layers(VideoStream *stream) {
+	int i;
+	if (stream->simulcast_layers <= 1) return;
+	if (!ms_filter_has_method(stream->ms.encoder, MS_VIDEO_ENCODER_SET_SIMULCAST_LAYERS)
+		|| ms_filter_call_method(stream->ms.encoder, MS_VIDEO_ENCODER_SET_SIMULCAST_LAYERS, &stream->simulcast_layers) != 0) {
+		ms_warning("VideoStream[%p]: the %s encoder does not support simulcast.", stream, stream->ms.encoder->desc->name);
+		stream->simulcast_layers = 0;
+		return;
+	}
+	for (i = 0; i < stream->simulcast_layers - 1; i++) {
+		stream->simulcast_rtpsends[i] = ms_factory_create_filter(stream->ms.factory, MS_RTP_SEND_ID);
+		ms_filter_call_method(stream->simulcast_rtpsends[i], MS_RTP_SEND_SET_SESSION, stream->simulcast_sessions[i]);
+		ms_filter_link(stream->ms.encoder, i + 1, stream->simulcast_rtpsends[i], 0);
+		stream->simulcast_evqs[i] = ortp_ev_queue_new();
+		rtp_session_register_event_queue(stream->simulcast_sessions[i], stream->simulcast_evqs[i]);
+	}
+}
+
+static void unlink_simulcast_layers(VideoStream *stream) {
+	int i;
+	for (i = 0; i < stream->simulcast_layers - 1; i++) {
+		if (stream->simulcast_rtpsends[i] != NULL) {
+			ms_filter_unlink(stream->ms.encoder, i + 1, stream->simulcast_rtpsends[i], 0);
+		}
+		if (stream->simulcast_evqs[i] != NULL) {
+			rtp_session_unregister_event_queue(stream->simulcast_sessions[i], stream->simulcast_evqs[i]);
+			ortp_ev_queue_destroy(stream->simulcast_evqs[i]);
+			stream->simulcast_evqs[i] = NULL;
+		}
+	}
+}
+
 MSVideoSize video_stream_get_sent_video_size(const VideoStream *stream) {
 	MSVideoSize vsize;
 	MS_VIDEO_SIZE_ASSIGN(vsize, UNKNOWN);
@@ -583,7 +740,12 @@ static void configure_video_source(VideoStream *stream){
 		case MSQosAnalyzerAlgorithmStateful:
 			stream->ms.rc=ms_bandwidth_bitrate_controller_new(NULL, NULL, stream->ms.sessions.rtp_session,stream->ms.encoder);
 			break;
+		case MSQosAnalyzerAlgorithmDelayGradient:
+			stream->ms.rc=ms_delay_gradient_bitrate_controller_new(NULL, NULL, stream->ms.sessions.rtp_session,stream->ms.encoder);
+			break;
 		}
+		/* The protection against losses follows the loss rate reported by the remote party. */
+		if (stream->ms.rc && stream->fec) ms_bitrate_controller_set_fec(stream->ms.rc, stream->fec);
 	}
 }
 
@@ -889,6 +1051,14 @@ static int video_stream_start_with_source_and_output(VideoStream *stream, RtpPro
 	rtp_session_set_jitter_buffer_params(stream->ms.sessions.rtp_session,&jbp);
 	rtp_session_set_rtp_socket_recv_buffer_size(stream->ms.sessions.rtp_session,socket_buf_size);
 	rtp_session_set_rtp_socket_send_buffer_size(stream->ms.sessions.rtp_session,socket_buf_size);
+	if (stream->retransmission_cache_size > 0) {
+		/* Generic NACK is an AVPF feedback message, the remote party cannot request retransmissions without it. */
+		if (avpf_enabled) stream->retransmission = ms_rtp_retransmission_new(rtps, stream->retransmission_cache_size);
+		else ms_message("VideoStream[%p]: AVPF is not enabled, lost packets will not be retransmitted.", stream);
+	}
+	if (stream->fec_payload_type > 0) {
+		stream->fec = ms_rtp_fec_new(rtps, stream->fec_payload_type);
+	}
 
 	/* Plumb the outgoing stream */
 	if (rem_rtp_port>0) ms_filter_call_method(stream->ms.rtpsend,MS_RTP_SEND_SET_SESSION,stream->ms.sessions.rtp_session);
@@ -901,6 +1071,10 @@ static int video_stream_start_with_source_and_output(VideoStream *stream, RtpPro
 		ms_connection_helper_start(&ch);
 		ms_connection_helper_link(&ch, stream->void_source, -1, 0);
 		ms_connection_helper_link(&ch, stream->ms.rtpsend, 0, -1);
+		if (stream->ms.rc_enable && stream->ms.rc_algorithm==MSQosAnalyzerAlgorithmDelayGradient){
+			/* Nothing is sent, but the delay of the packets received is measured and reported to the remote party. */
+			stream->ms.rc=ms_delay_gradient_bitrate_controller_new(NULL, NULL, stream->ms.sessions.rtp_session, NULL);
+		}
 	} else {
 		MSConnectionHelper ch;
 		if (stream->source_performs_encoding == TRUE) {
@@ -940,6 +1114,12 @@ static int video_stream_start_with_source_and_output(VideoStream *stream, RtpPro
 				}
 			}
 			configure_video_source(stream);
+			if (stream->pacing_enabled && (stream->source_performs_encoding == FALSE)) {
+				stream->pacer = ms_factory_create_filter(stream->ms.factory, MS_PACER_ID);
+				stream->pacing_bitrate = 0;
+				ms_filter_call_method(stream->pacer, MS_PACER_SET_PRIORITY_SESSION, stream->pacing_priority_session);
+				video_stream_update_pacing_rate(stream);
+			}
 		}
 
 		/* and then connect all */
@@ -956,6 +1136,10 @@ static int video_stream_start_with_source_and_output(VideoStream *stream, RtpPro
 		}
 		if ((stream->source_performs_encoding == FALSE) && !rtp_source) {
 			ms_connection_helper_link(&ch, stream->ms.encoder, 0, 0);
+			link_simulcast_layers(stream);
+			if (stream->pacer) {
+				ms_connection_helper_link(&ch, stream->pacer, 0, 0);
+			}
 		}
 		ms_connection_helper_link(&ch, stream->ms.rtpsend, 0, -1);
 		if (stream->output2){
@@ -1381,6 +1565,10 @@ static MSFilter* _video_stream_stop(VideoStream * stream, bool_t keep_source)
 				}
 				if ((stream->source_performs_encoding == FALSE) && !rtp_source) {
 					ms_connection_helper_unlink(&ch, stream->ms.encoder, 0, 0);
+					unlink_simulcast_layers(stream);
+					if (stream->pacer) {
+						ms_connection_helper_unlink(&ch, stream->pacer, 0, 0);
+					}
 				}
 				ms_connection_helper_unlink(&ch, stream->ms.rtpsend, 0, -1);
 				if (stream->output2){
@@ -196,6 +196,13 @@ static void qos_analyzer_on_action_suggested(void *user_data, int datac, const c
 			mgr->adaptive_stats.loss_estim=(float)stateful_analyzer->network_loss_rate;
 			mgr->adaptive_stats.congestion_bw_estim=(float)stateful_analyzer->congestion_bandwidth;
 		}
+	}else if (mgr->type==MSAudio && mgr->audio_stream->ms.rc_enable){
+		const MSQosAnalyzer *analyzer=ms_bitrate_controller_get_qos_analyzer(mgr->audio_stream->ms.rc);
+		if (analyzer->type==MSQosAnalyzerAlgorithmDelayGradient){
+			const MSDelayGradientQosAnalyzer *delay_gradient_analyzer=((const MSDelayGradientQosAnalyzer*)analyzer);
+			mgr->adaptive_stats.loss_estim=delay_gradient_analyzer->loss_rate;
+			mgr->adaptive_stats.congestion_bw_estim=delay_gradient_analyzer->remote_estimated_bitrate/1000;
+		}
 	}
 }
 
@@ -208,8 +215,8 @@ static void disable_plc_on_audio_stream(AudioStream *p1){
 	}
 }
 
-void start_adaptive_stream(MSFormatType type, stream_manager_t ** pmarielle, stream_manager_t ** pmargaux,
-	int payload, int initial_bitrate, int max_bw, float loss_rate, int latency, float dup_ratio, bool_t disable_plc) {
+static void start_adaptive_stream_with_algorithm(MSFormatType type, stream_manager_t ** pmarielle, stream_manager_t ** pmargaux,
+	int payload, int initial_bitrate, int max_bw, float loss_rate, int latency, float dup_ratio, bool_t disable_plc, MSQosAnalyzerAlgorithm algorithm) {
 	int pause_time=0;
 	PayloadType* pt;
 	MediaStream *marielle_ms,*margaux_ms;
@@ -254,7 +261,12 @@ void start_adaptive_stream(MSFormatType type, stream_manager_t ** pmarielle, str
 	}
 
 	media_stream_enable_adaptive_bitrate_control(marielle_ms,TRUE);
-	media_stream_set_adaptive_bitrate_algorithm(marielle_ms, MSQosAnalyzerAlgorithmStateful);
+	media_stream_set_adaptive_bitrate_algorithm(marielle_ms, algorithm);
+	if (algorithm==MSQosAnalyzerAlgorithmDelayGradient){
+		/*the receiver measures the delay of the packets and sends its estimations*/
+		media_stream_enable_adaptive_bitrate_control(margaux_ms,TRUE);
+		media_stream_set_adaptive_bitrate_algorithm(margaux_ms, algorithm);
+	}
 	rtp_session_set_duplication_ratio(marielle_ms->sessions.rtp_session, dup_ratio);
 
 	if (marielle->type == MSAudio){
@@ -282,6 +294,12 @@ void start_adaptive_stream(MSFormatType type, stream_manager_t ** pmarielle, str
 	free(file);
 }
 
+void start_adaptive_stream(MSFormatType type, stream_manager_t ** pmarielle, stream_manager_t ** pmargaux,
+	int payload, int initial_bitrate, int max_bw, float loss_rate, int latency, float dup_ratio, bool_t disable_plc) {
+	start_adaptive_stream_with_algorithm(type, pmarielle, pmargaux, payload, initial_bitrate, max_bw, loss_rate, latency, dup_ratio,
+		disable_plc, MSQosAnalyzerAlgorithmStateful);
+}
+
 static void iterate_adaptive_stream(stream_manager_t * marielle, stream_manager_t * margaux,
 	int timeout_ms, int* current, int expected){
 	int retry=0;
@@ -525,6 +543,23 @@ static void upload_bitrate_opus_3g(void) {
 	upload_bitrate("opus", OPUS_PAYLOAD_TYPE, THIRDGENERATION_BW, 200);
 }
 
+static void delay_gradient_estimation_speex_congested(void) {
+	bool_t supported = ms_factory_codec_supported(_factory, "speex");
+	if( supported ) {
+		stream_manager_t * marielle, * margaux;
+		int max_bw = 25;
+
+		start_adaptive_stream_with_algorithm(MSAudio, &marielle, &margaux, SPEEX_PAYLOAD_TYPE, THIRDGENERATION_BW*1000, max_bw*1000, 0, 50, 0, FALSE,
+			MSQosAnalyzerAlgorithmDelayGradient);
+		iterate_adaptive_stream(marielle, margaux, 15000, NULL, 0);
+		/*the estimation sent by margaux follows the bandwidth of the link, not the bitrate marielle started with*/
+		BC_ASSERT_GREATER(marielle->adaptive_stats.congestion_bw_estim, 10.f, float, "%f");
+		BC_ASSERT_LOWER(marielle->adaptive_stats.congestion_bw_estim, (float)(max_bw*1.5), float, "%f");
+		BC_ASSERT_LOWER((float)(media_stream_get_up_bw(&marielle->audio_stream->ms)/1000), (float)(max_bw*1.5), float, "%f");
+		stop_adaptive_stream(marielle,margaux,TRUE);
+	}
+}
+
 #if VIDEO_ENABLED && 0
 void adaptive_video(int max_bw, int exp_min_bw, int exp_max_bw, int loss_rate, int exp_min_loss, int exp_max_loss) {
 	bool_t supported = ms_filter_codec_supported("VP8");
@@ -567,6 +602,7 @@ static test_t tests[] = {
 	{ "Upload bitrate [speex] - 3g", upload_bitrate_speex_3g },
 	{ "Upload bitrate [opus] - edge", upload_bitrate_opus_edge },
 	{ "Upload bitrate [opus] - 3g", upload_bitrate_opus_3g },
+	{ "Delay gradient estimation [speex] - congested", delay_gradient_estimation_speex_congested },
 
 #if VIDEO_ENABLED && 0
 	{ "Network detection [VP8] - ideal", adaptive_vp8_ideal },
@@ -24,9 +24,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/msfilerec.h"
 #include "mediastreamer2/msrtp.h"
 #include "mediastreamer2/mstonedetector.h"
+#include "mediastreamer2/flowcontrol.h"
+#include "mediastreamer2/msgenericplc.h"
 #include "mediastreamer2_tester.h"
 #include "mediastreamer2_tester_private.h"
 #include "private.h"
+#include "genericplc.h"
+
+#include <math.h>
 
 static MSFactory *factory = NULL;
 static int basic_audio_tester_before_all(void) {
@@ -86,6 +91,55 @@ static void dtmfgen_tonedet(void) {
 	ms_tester_destroy_ticker();
 }
 
+/*scans more frequencies than the former fixed limit of the tone detector, the played one being the last*/
+static void dtmfgen_tonedet_many_scans(void) {
+	MSConnectionHelper h;
+	unsigned int filter_mask = FILTER_MASK_VOIDSOURCE | FILTER_MASK_DTMFGEN | FILTER_MASK_TONEDET | FILTER_MASK_VOIDSINK;
+	bool_t send_silence = TRUE;
+	MSDtmfGenCustomTone tone = { "", 1000, {1900, 0}, 1.0f, 0, 0 };
+	MSToneDetectorDef scan = { "", 0, 400, 0.5f };
+	MSToneDetectorEnergies energies;
+	float energy_values[32];
+	int nscans = 24;
+	int i;
+
+	ms_tester_create_ticker();
+	ms_tester_create_filters(filter_mask, factory);
+	ms_filter_add_notify_callback(ms_tester_tonedet, (MSFilterNotifyFunc)tone_detected_cb, NULL,TRUE);
+	ms_filter_call_method(ms_tester_voidsource, MS_VOID_SOURCE_SEND_SILENCE, &send_silence);
+	for (i = 0; i < nscans; i++) {
+		scan.frequency = 400 + i * 1500 / (nscans - 1);
+		BC_ASSERT_EQUAL(ms_filter_call_method(ms_tester_tonedet, MS_TONE_DETECTOR_ADD_SCAN, &scan), 0, int, "%d");
+	}
+	ms_connection_helper_start(&h);
+	ms_connection_helper_link(&h, ms_tester_voidsource, -1, 0);
+	ms_connection_helper_link(&h, ms_tester_dtmfgen, 0, 0);
+	ms_connection_helper_link(&h, ms_tester_tonedet, 0, 0);
+	ms_connection_helper_link(&h, ms_tester_voidsink, 0, -1);
+	ms_ticker_attach(ms_tester_ticker, ms_tester_voidsource);
+
+	ms_tester_tone_detected = FALSE;
+	ms_filter_call_method(ms_tester_dtmfgen, MS_DTMF_GEN_PLAY_CUSTOM, &tone);
+	ms_usleep(600000);
+	BC_ASSERT_TRUE(ms_tester_tone_detected);
+	energies.energies = energy_values;
+	energies.count = sizeof(energy_values) / sizeof(energy_values[0]);
+	BC_ASSERT_EQUAL(ms_filter_call_method(ms_tester_tonedet, MS_TONE_DETECTOR_GET_ENERGIES, &energies), 0, int, "%d");
+	BC_ASSERT_EQUAL(energies.count, nscans, int, "%d");
+	BC_ASSERT_GREATER(energy_values[nscans - 1], 0.5f, float, "%f");
+	BC_ASSERT_LOWER(energy_values[0], 0.1f, float, "%f");
+	ms_sleep(1);
+
+	ms_ticker_detach(ms_tester_ticker, ms_tester_voidsource);
+	ms_connection_helper_start(&h);
+	ms_connection_helper_unlink(&h, ms_tester_voidsource, -1, 0);
+	ms_connection_helper_unlink(&h, ms_tester_dtmfgen, 0, 0);
+	ms_connection_helper_unlink(&h, ms_tester_tonedet, 0, 0);
+	ms_connection_helper_unlink(&h, ms_tester_voidsink, 0, -1);
+	ms_tester_destroy_filters(filter_mask);
+	ms_tester_destroy_ticker();
+}
+
 /*fileplay awt to TRUE:  uses soundwrite instaed of voidsink  so we can hear what;s going on */
 static void dtmfgen_enc_dec_tonedet(char *mime, int sample_rate, int nchannels, bool_t fileplay) {
 	MSConnectionHelper h;
@@ -403,9 +457,194 @@ static void dtmfgen_filerec_fileplay_tonedet(void) {
     free(recorded_file);
 }
 
+#define PLC_RECEIVED_TICKS 30
+#define PLC_LOST_TICKS 20
+/*duration after which the generic PLC outputs silence*/
+#define PLC_MAX_DURATION_MS 150
+
+static int64_t plc_frame_energy(mblk_t *m) {
+	int64_t energy = 0;
+	int16_t *sample;
+	for (sample = (int16_t *)m->b_rptr; sample < (int16_t *)m->b_wptr; sample++) energy += *sample * *sample;
+	return energy;
+}
+
+/* Conceals a loss with the MSGenericPLC filter, driven by hand with 10ms frames of a 8 kHz sine. */
+static void generic_plc_concealment(void) {
+	MSFilter *source = ms_factory_create_filter(factory, MS_VOID_SOURCE_ID);
+	MSFilter *plc = ms_factory_create_filter(factory, MS_GENERIC_PLC_ID);
+	MSFilter *sink = ms_factory_create_filter(factory, MS_VOID_SINK_ID);
+	MSTicker ticker;
+	int rate = 8000;
+	int nsamples = rate / 100;
+	int tick, i, outputs, concealed;
+	int64_t energy;
+	mblk_t *m;
+
+	memset(&ticker, 0, sizeof(ticker));
+	ticker.interval = 10;
+	ms_filter_call_method(plc, MS_FILTER_SET_SAMPLE_RATE, &rate);
+	ms_filter_link(source, 0, plc, 0);
+	ms_filter_link(plc, 0, sink, 0);
+	plc->ticker = &ticker;
+	plc->desc->preprocess(plc);
+
+	for (tick = 0; tick < PLC_RECEIVED_TICKS + PLC_LOST_TICKS + 5; tick++) {
+		bool_t lost = tick >= PLC_RECEIVED_TICKS && tick < PLC_RECEIVED_TICKS + PLC_LOST_TICKS;
+		ticker.time = tick * ticker.interval;
+		if (!lost) {
+			m = allocb(nsamples * sizeof(int16_t), 0);
+			for (i = 0; i < nsamples; i++) {
+				*((int16_t *)m->b_wptr) = (int16_t)(8000 * sin(2 * M_PI * 440 * (double)(tick * nsamples + i) / rate));
+				m->b_wptr += sizeof(int16_t);
+			}
+			ms_queue_put(plc->inputs[0], m);
+		}
+		plc->desc->process(plc);
+		outputs = concealed = 0;
+		energy = 0;
+		while ((m = ms_queue_get(plc->outputs[0])) != NULL) {
+			outputs++;
+			if (mblk_get_plc_flag(m)) concealed++;
+			energy += plc_frame_energy(m);
+			freemsg(m);
+		}
+		/*one frame goes out at each tick, generated when the input is missing*/
+		BC_ASSERT_EQUAL(outputs, 1, int, "%d");
+		BC_ASSERT_EQUAL(concealed, lost ? 1 : 0, int, "%d");
+		if (tick == PLC_RECEIVED_TICKS) {
+			/*the first concealed frame continues the signal, it is not silence*/
+			BC_ASSERT_GREATER((int)(energy / nsamples), 1000000, int, "%d");
+		} else if (lost && tick >= PLC_RECEIVED_TICKS + PLC_MAX_DURATION_MS / ticker.interval) {
+			/*long losses fade out to silence*/
+			BC_ASSERT_EQUAL((int)energy, 0, int, "%d");
+		}
+	}
+
+	plc->ticker = NULL;
+	ms_filter_unlink(source, 0, plc, 0);
+	ms_filter_unlink(plc, 0, sink, 0);
+	ms_filter_destroy(source);
+	ms_filter_destroy(plc);
+	ms_filter_destroy(sink);
+}
+
+/* the conversions of the concealed signal saturate instead of wrapping around, in the vector loops and in their tails */
+static void generic_plc_saturation(void) {
+	int16_t out[17];
+	int len, i, errors = 0;
+#ifndef MS_FIXED_POINT
+	float values[] = { 40000.0f, -40000.0f, 1e6f, -1e6f, 32767.9f, -32768.9f, 100.7f, -100.7f };
+	ms_word16_t in[17];
+	int v;
+
+	/*every length up to two vectors and a tail, so that each value goes through the scalar tail too*/
+	for (v = 0; v < (int)(sizeof(values) / sizeof(values[0])); v++) {
+		int16_t expected = (int16_t)(values[v] >= 32767.0f ? 32767 : values[v] <= -32768.0f ? -32768 : (int)values[v]);
+		for (len = 1; len <= 17; len++) {
+			for (i = 0; i < len; i++) in[i] = values[v];
+			generic_plc_to_int16(in, out, len);
+			for (i = 0; i < len; i++) if (out[i] != expected) errors++;
+		}
+	}
+#endif
+	/*a gain of 2 at the start of the fade*/
+	for (len = 1; len <= 17; len++) {
+		for (i = 0; i < len; i++) out[i] = (i & 1) ? -30000 : 30000;
+		generic_plc_fade_out(out, len, 100.0f, 100.0f);
+		for (i = 0; i < len; i++) if (out[i] != ((i & 1) ? -32768 : 32767)) errors++;
+	}
+	BC_ASSERT_EQUAL(errors, 0, int, "%d");
+}
+
+static void time_stretcher_bounded_latency(void) {
+	MSBufferizer *input = ms_bufferizer_new();
+	MSAudioTimeStretcher *ts = ms_audio_time_stretcher_new(8000, 1);
+	int16_t out[160];
+	double phase = 0;
+	int i, k, outputs = 0, max_buffered = 0;
+
+	ms_audio_time_stretcher_set_target(ts, 40);
+	for (i = 0; i < 500; ++i) {
+		/*the input brings 50% more audio than what is played out, far beyond what stretching can absorb*/
+		mblk_t *m = allocb(240 * 2, 0);
+		for (k = 0; k < 240; ++k) {
+			*((int16_t *)m->b_wptr) = (int16_t)(10000 * sin(phase));
+			m->b_wptr += 2;
+			phase += 2 * M_PI * 200 / 8000;
+		}
+		ms_bufferizer_put(input, m);
+		if (ms_audio_time_stretcher_read(ts, input, out, 160) == 160) outputs++;
+		/*16 bytes per millisecond of 8 kHz mono audio*/
+		max_buffered = MAX(max_buffered, (int)ms_bufferizer_get_avail(input) / 16);
+	}
+	BC_ASSERT_LOWER(max_buffered, ms_audio_time_stretcher_get_max_depth(ts), int, "%d");
+	/*only the first reads wait for the target to be buffered*/
+	BC_ASSERT_GREATER(outputs, 495, int, "%d");
+	BC_ASSERT_GREATER((int)ms_audio_time_stretcher_get_correction(ts), 500 * 80 / 2, int, "%d");
+	ms_audio_time_stretcher_destroy(ts);
+	ms_bufferizer_destroy(input);
+}
+
+static void time_stretcher_drift(float drift) {
+	MSBufferizer *input = ms_bufferizer_new();
+	MSAudioTimeStretcher *ts = ms_audio_time_stretcher_new(8000, 1);
+	int16_t out[160];
+	double phase = 0, acc = 0;
+	int64_t correction, last_correction = 0, spliced = 0, expected = 0, error;
+	int i, k, direction = 0, direction_changes = 0;
+
+	ms_audio_time_stretcher_set_target(ts, 40);
+	/*200 seconds of audio played out 160 samples at a time, with a 140 Hz pitch whose period is longer than the smallest correction*/
+	for (i = 0; i < 10000; ++i) {
+		mblk_t *m;
+		int n;
+		acc += 160 * (1 + drift);
+		n = (int)acc;
+		acc -= n;
+		expected += n - 160;
+		m = allocb(n * 2, 0);
+		for (k = 0; k < n; ++k) {
+			*((int16_t *)m->b_wptr) = (int16_t)(10000 * sin(phase));
+			m->b_wptr += 2;
+			phase += 2 * M_PI * 140 / 8000;
+		}
+		ms_bufferizer_put(input, m);
+		ms_audio_time_stretcher_read(ts, input, out, 160);
+		correction = ms_audio_time_stretcher_get_correction(ts);
+		if (correction != last_correction) {
+			int dir = (correction > last_correction) ? 1 : -1;
+			if (direction != 0 && dir != direction) direction_changes++;
+			direction = dir;
+			spliced += (correction > last_correction) ? correction - last_correction : last_correction - correction;
+			last_correction = correction;
+		}
+	}
+	correction = (last_correction >= 0) ? last_correction : -last_correction;
+	expected = (expected >= 0) ? expected : -expected;
+	ms_message("time stretcher with %.1f%% drift: %i samples of drift, %i corrected, %i spliced, %i direction changes",
+		drift * 100, (int)expected, (int)correction, (int)spliced, direction_changes);
+	/*the drift is compensated, up to the changes of the amount of audio buffered*/
+	error = (expected >= correction) ? expected - correction : correction - expected;
+	BC_ASSERT_LOWER((int)error, 640, int, "%d");
+	/*each correction goes the way of the drift: nothing is removed to be inserted again afterwards*/
+	BC_ASSERT_LOWER((int)spliced, (int)correction + 120, int, "%d");
+	BC_ASSERT_EQUAL(direction_changes, 0, int, "%d");
+	ms_audio_time_stretcher_destroy(ts);
+	ms_bufferizer_destroy(input);
+}
+
+static void time_stretcher_faster_input(void) {
+	time_stretcher_drift(0.01f);
+}
+
+static void time_stretcher_slower_input(void) {
+	time_stretcher_drift(-0.01f);
+}
 
 test_t basic_audio_tests[] = {
 	{ "dtmfgen-tonedet", dtmfgen_tonedet },
+	{ "dtmfgen-tonedet-many-scans", dtmfgen_tonedet_many_scans },
 	{ "dtmfgen-enc-dec-tonedet-bv16", dtmfgen_enc_dec_tonedet_bv16 },
 	{ "dtmfgen-enc-dec-tonedet-pcmu", dtmfgen_enc_dec_tonedet_pcmu },
 	{ "dtmfgen-enc-dec-tonedet-isac", dtmfgen_enc_dec_tonedet_isac },
@@ -413,7 +652,12 @@ test_t basic_audio_tests[] = {
 	{ "dtmfgen-enc-dec-tonedet-opus", dtmfgen_enc_dec_tonedet_opus },
 #endif
 	{ "dtmfgen-enc-rtp-dec-tonedet", dtmfgen_enc_rtp_dec_tonedet },
-	{ "dtmfgen-filerec-fileplay-tonedet", dtmfgen_filerec_fileplay_tonedet }
+	{ "dtmfgen-filerec-fileplay-tonedet", dtmfgen_filerec_fileplay_tonedet },
+	{ "generic-plc-concealment", generic_plc_concealment },
+	{ "generic-plc-saturation", generic_plc_saturation },
+	{ "time-stretcher-bounded-latency", time_stretcher_bounded_latency },
+	{ "time-stretcher-faster-input", time_stretcher_faster_input },
+	{ "time-stretcher-slower-input", time_stretcher_slower_input }
 };
 
 test_suite_t basic_audio_test_suite = {
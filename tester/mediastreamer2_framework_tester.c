@@ -22,10 +22,24 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/dtmfgen.h"
 #include "mediastreamer2/msfileplayer.h"
 #include "mediastreamer2/msfilerec.h"
+#include "mediastreamer2/mschanadapter.h"
 #include "mediastreamer2/msrtp.h"
 #include "mediastreamer2/mstonedetector.h"
+#include "mediastreamer2/msencoderthread.h"
+#include "mediastreamer2/mspacer.h"
+#include "mediastreamer2/msvideoswitcher.h"
+#include "mediastreamer2/msvideomixer.h"
+#include "mediastreamer2/msworkerpool.h"
 #include "mediastreamer2_tester.h"
 #include "mediastreamer2_tester_private.h"
+#include "msvideo_x86.h"
+#include "h264utils.h"
+#include "pcmformat.h"
+#include "audiodiff.h"
+#include "layouts.h"
+
+#include <math.h>
+#include <stdlib.h>
 
 static int tester_before_all(void) {
 /*	ms_init();
@@ -224,6 +238,304 @@ static void test_copy_ycbcrbiplanar_to_true_yuv_with_rotation_180_with_downscali
 	test_video_processing_base(TRUE,FALSE,TRUE);
 }
 
+static int bytes_per_pixel(MSPixFmt fmt) {
+	switch (fmt) {
+		case MS_RGBA32: return 4;
+		case MS_RGB24: return 3;
+		case MS_RGB565: return 2;
+		default: return 1;
+	}
+}
+
+/* runs a conversion a number of times, and returns the average time per picture in microseconds */
+static int scaler_run(MSScalerDesc *impl, uint8_t *src_planes[], int src_strides[], MSPixFmt src_fmt, MSPixFmt dst_fmt, int dst_w, int dst_h, uint8_t *dst, int runs) {
+	MSScalerContext *ctx = impl->create_context(MS_VIDEO_SIZE_720P_W, MS_VIDEO_SIZE_720P_H, src_fmt, dst_w, dst_h, dst_fmt, MS_SCALER_METHOD_BILINEAR);
+	uint8_t *dst_planes[4] = { dst, dst + dst_w * dst_h, dst + dst_w * dst_h * 5 / 4, NULL };
+	int dst_strides[4] = { dst_w * bytes_per_pixel(dst_fmt), (dst_fmt == MS_NV12 || dst_fmt == MS_NV21) ? dst_w : dst_w / 2, dst_w / 2, 0 };
+	uint64_t start;
+	int i;
+
+	if (!BC_ASSERT_PTR_NOT_NULL(ctx)) return 0;
+	start = ms_get_cur_time_ms();
+	for (i = 0; i < runs; i++) {
+		impl->context_process(ctx, src_planes, src_strides, dst_planes, dst_strides);
+	}
+	impl->context_free(ctx);
+	return (int)((ms_get_cur_time_ms() - start) * 1000 / runs);
+}
+
+/* average absolute difference per color component of two pictures */
+static int scaler_diff(MSPixFmt fmt, const uint8_t *dst1, const uint8_t *dst2, int w, int h) {
+	int64_t diff = 0;
+	int i, size;
+
+	if (fmt == MS_RGB565) {
+		/* compare the components expanded to 8 bits, a rounding difference changes their lowest bit */
+		const uint16_t *p1 = (const uint16_t *)dst1, *p2 = (const uint16_t *)dst2;
+		for (i = 0; i < w * h; i++) {
+			diff += abs(((p1[i] >> 11) << 3) - ((p2[i] >> 11) << 3));
+			diff += abs((((p1[i] >> 5) & 0x3f) << 2) - (((p2[i] >> 5) & 0x3f) << 2));
+			diff += abs(((p1[i] & 0x1f) << 3) - ((p2[i] & 0x1f) << 3));
+		}
+		return (int)(diff / (w * h * 3));
+	}
+	size = (fmt == MS_YUV420P || fmt == MS_NV12 || fmt == MS_NV21) ? w * h * 3 / 2 : w * h * bytes_per_pixel(fmt);
+	for (i = 0; i < size; i++) diff += abs(dst1[i] - dst2[i]);
+	return (int)(diff / size);
+}
+
+/* compares the x86 scaler with swscale, in speed and in output */
+static void test_x86_scaler(void) {
+	MSScalerDesc *x86 = ms_video_get_x86_scaler_impl();
+	MSScalerDesc *ffmpeg = ms_video_get_ffmpeg_scaler_impl();
+	MSPixFmt src_formats[] = { MS_YUV420P, MS_NV12, MS_NV21 };
+	MSPixFmt formats[] = { MS_YUV420P, MS_NV12, MS_NV21, MS_RGB24, MS_RGBA32, MS_RGB565 };
+	MSVideoSize sizes[] = { { MS_VIDEO_SIZE_VGA_W, MS_VIDEO_SIZE_VGA_H }, { MS_VIDEO_SIZE_720P_W, MS_VIDEO_SIZE_720P_H } };
+	MSPicture src;
+	mblk_t *src_m;
+	uint8_t *nv12, *nv21, *dst1, *dst2;
+	int i, j, f, s;
+
+	if (x86 == NULL) {
+		ms_message("No x86 scaler on this platform.");
+		return;
+	}
+	src_m = ms_yuv_buf_alloc(&src, MS_VIDEO_SIZE_720P_W, MS_VIDEO_SIZE_720P_H);
+	for (i = 0; i < src.h; i++) {
+		for (j = 0; j < src.w; j++) src.planes[0][i * src.strides[0] + j] = (uint8_t)(16 + ((i + j) % 220));
+	}
+	/* the same picture with semi-planar chroma, u first for NV12 and v first for NV21 */
+	nv12 = ms_malloc(src.w * src.h / 2);
+	nv21 = ms_malloc(src.w * src.h / 2);
+	for (i = 0; i < src.h / 2; i++) {
+		for (j = 0; j < src.w / 2; j++) {
+			uint8_t u = (uint8_t)(64 + (i % 128)), v = (uint8_t)(64 + (j % 128));
+			src.planes[1][i * src.strides[1] + j] = u;
+			src.planes[2][i * src.strides[2] + j] = v;
+			nv12[i * src.w + 2 * j] = nv21[i * src.w + 2 * j + 1] = u;
+			nv12[i * src.w + 2 * j + 1] = nv21[i * src.w + 2 * j] = v;
+		}
+	}
+	dst1 = ms_malloc(MS_VIDEO_SIZE_720P_W * MS_VIDEO_SIZE_720P_H * 4);
+	dst2 = ms_malloc(MS_VIDEO_SIZE_720P_W * MS_VIDEO_SIZE_720P_H * 4);
+	for (s = 0; s < (int)(sizeof(src_formats) / sizeof(src_formats[0])); s++) {
+		uint8_t *src_planes[4] = { src.planes[0], src.planes[1], src.planes[2], NULL };
+		int src_strides[4] = { src.strides[0], src.strides[1], src.strides[2], 0 };
+		/* the speed is only measured from YUV420P, the other inputs are only checked */
+		int runs = src_formats[s] == MS_YUV420P ? 50 : 1;
+
+		if (src_formats[s] != MS_YUV420P) {
+			src_planes[1] = src_formats[s] == MS_NV12 ? nv12 : nv21;
+			src_planes[2] = NULL;
+			src_strides[1] = src.w;
+			src_strides[2] = 0;
+		}
+		for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+			for (f = 0; f < (int)(sizeof(formats) / sizeof(formats[0])); f++) {
+				int w = sizes[i].width, h = sizes[i].height;
+				int x86_us = scaler_run(x86, src_planes, src_strides, src_formats[s], formats[f], w, h, dst1, runs);
+				if (ffmpeg) {
+					int ffmpeg_us = scaler_run(ffmpeg, src_planes, src_strides, src_formats[s], formats[f], w, h, dst2, runs);
+					/* both implementations use bilinear filtering and ITU-R BT.601, they must give close results */
+					if (!BC_ASSERT_LOWER(scaler_diff(formats[f], dst1, dst2, w, h), 4, int, "%d")) {
+						ms_error("720p %s to %ix%i %s differs from swscale", ms_pix_fmt_to_string(src_formats[s]), w, h, ms_pix_fmt_to_string(formats[f]));
+					}
+					ms_message("720p %s to %ix%i %s: x86 scaler %i us, swscale %i us", ms_pix_fmt_to_string(src_formats[s]), w, h,
+						ms_pix_fmt_to_string(formats[f]), x86_us, ffmpeg_us);
+				} else {
+					ms_message("720p %s to %ix%i %s: x86 scaler %i us", ms_pix_fmt_to_string(src_formats[s]), w, h, ms_pix_fmt_to_string(formats[f]), x86_us);
+				}
+			}
+		}
+	}
+	ms_free(nv12);
+	ms_free(nv21);
+	ms_free(dst1);
+	ms_free(dst2);
+	freemsg(src_m);
+}
+
+/* with MS_SCALER_METHOD_NEIGHBOUR, the x86 scaler copies source pixels instead of blending them */
+static void test_x86_scaler_neighbour(void) {
+	MSScalerDesc *x86 = ms_video_get_x86_scaler_impl();
+	MSPicture src, dst;
+	mblk_t *src_m, *dst_m;
+	MSScalerContext *ctx;
+	int i, j, blended = 0;
+
+	if (x86 == NULL) {
+		ms_message("No x86 scaler on this platform.");
+		return;
+	}
+	src_m = ms_yuv_buf_alloc(&src, MS_VIDEO_SIZE_VGA_W, MS_VIDEO_SIZE_VGA_H);
+	dst_m = ms_yuv_buf_alloc(&dst, MS_VIDEO_SIZE_VGA_W / 2 + 10, MS_VIDEO_SIZE_VGA_H / 2 + 6);
+	/* a checkerboard: any blending of neighbouring pixels gives a value other than 0 and 255 */
+	for (i = 0; i < src.h; i++) {
+		for (j = 0; j < src.w; j++) src.planes[0][i * src.strides[0] + j] = ((i + j) & 1) ? 255 : 0;
+	}
+	memset(src.planes[1], 128, src.strides[1] * src.h / 2);
+	memset(src.planes[2], 128, src.strides[2] * src.h / 2);
+	ctx = x86->create_context(src.w, src.h, MS_YUV420P, dst.w, dst.h, MS_YUV420P, MS_SCALER_METHOD_NEIGHBOUR);
+	if (BC_ASSERT_PTR_NOT_NULL(ctx)) {
+		x86->context_process(ctx, src.planes, src.strides, dst.planes, dst.strides);
+		for (i = 0; i < dst.h; i++) {
+			for (j = 0; j < dst.w; j++) {
+				uint8_t v = dst.planes[0][i * dst.strides[0] + j];
+				if (v != 0 && v != 255) blended++;
+			}
+		}
+		BC_ASSERT_EQUAL(blended, 0, int, "%d");
+		x86->context_free(ctx);
+	}
+	freemsg(src_m);
+	freemsg(dst_m);
+}
+
+/* a 1080p to 720p downscale gives the same result, whether it is done in one piece or in slices */
+static void test_scaler_slicing(void) {
+	MSWorkerPool *pool = ms_worker_pool_new(3);
+	MSPicture src, dst1, dst2;
+	mblk_t *src_m, *dst1_m, *dst2_m;
+	MSScalerContext *ctx1, *ctx2;
+	int i, plane, diff = 0;
+	uint64_t start, single_time, sliced_time;
+
+	src_m = ms_yuv_buf_alloc(&src, 1920, 1080);
+	dst1_m = ms_yuv_buf_alloc(&dst1, MS_VIDEO_SIZE_720P_W, MS_VIDEO_SIZE_720P_H);
+	dst2_m = ms_yuv_buf_alloc(&dst2, MS_VIDEO_SIZE_720P_W, MS_VIDEO_SIZE_720P_H);
+	for (i = 0; i < src.strides[0] * src.h; i++) src.planes[0][i] = (uint8_t)(i * 7 + i / src.strides[0]);
+	for (i = 0; i < src.strides[1] * src.h / 2; i++) {
+		src.planes[1][i] = (uint8_t)(i * 3);
+		src.planes[2][i] = (uint8_t)(i / src.strides[2]);
+	}
+	ctx1 = ms_scaler_create_context(src.w, src.h, MS_YUV420P, dst1.w, dst1.h, MS_YUV420P, MS_SCALER_METHOD_BILINEAR);
+	ctx2 = ms_scaler_create_context(src.w, src.h, MS_YUV420P, dst2.w, dst2.h, MS_YUV420P, MS_SCALER_METHOD_BILINEAR);
+	ms_scaler_context_enable_slicing(ctx2, pool);
+
+	start = ms_get_cur_time_ms();
+	for (i = 0; i < 20; i++) ms_scaler_process(ctx1, src.planes, src.strides, dst1.planes, dst1.strides);
+	single_time = ms_get_cur_time_ms() - start;
+	start = ms_get_cur_time_ms();
+	for (i = 0; i < 20; i++) ms_scaler_process(ctx2, src.planes, src.strides, dst2.planes, dst2.strides);
+	sliced_time = ms_get_cur_time_ms() - start;
+	ms_message("1080p to 720p: %i ms in one piece, %i ms in slices", (int)single_time / 20, (int)sliced_time / 20);
+
+	for (plane = 0; plane < 3; plane++) {
+		int h = plane == 0 ? dst1.h : dst1.h / 2;
+		for (i = 0; i < dst1.strides[plane] * h; i++) {
+			if (dst1.planes[plane][i] != dst2.planes[plane][i]) diff++;
+		}
+	}
+	BC_ASSERT_EQUAL(diff, 0, int, "%i");
+
+	ms_scaler_context_free(ctx1);
+	ms_scaler_context_free(ctx2);
+	freemsg(src_m);
+	freemsg(dst1_m);
+	freemsg(dst2_m);
+	ms_worker_pool_destroy(pool);
+}
+
+#if MS_HAS_X86_VIDEO_KERNELS
+static void fill_random(uint8_t *p, int size) {
+	int i;
+	for (i = 0; i < size; i++) p[i] = (uint8_t)rand();
+}
+
+static bool_t same_pictures(const MSPicture *a, const MSPicture *b) {
+	int plane, i;
+	for (plane = 0; plane < 3; plane++) {
+		int w = plane == 0 ? a->w : a->w / 2;
+		int h = plane == 0 ? a->h : a->h / 2;
+		for (i = 0; i < h; i++) {
+			if (memcmp(a->planes[plane] + i * a->strides[plane], b->planes[plane] + i * b->strides[plane], w) != 0) return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/* the x86 kernels must give exactly the same pictures as the portable code */
+static void test_x86_picture_kernels(void) {
+	MSVideoSize sizes[] = { { 640, 480 }, { 176, 144 }, { 102, 58 }, { 38, 6 } };
+	int rotations[] = { 0, 90, 180, 270 };
+	MSMirrorType mirrors[] = { MS_HORIZONTAL_MIRROR, MS_VERTICAL_MIRROR, MS_CENTRAL_MIRROR };
+	MSYuvBufAllocator *allocator = ms_yuv_buf_allocator_new();
+	int i, j, k;
+
+	if (!ms_video_x86_kernels_supported()) {
+		ms_message("The processor doesn't support SSSE3.");
+		ms_yuv_buf_allocator_free(allocator);
+		return;
+	}
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+		int w = sizes[i].width, h = sizes[i].height;
+		/* source of a biplanar picture of twice the size, in any orientation, with padded rows */
+		int side = 2 * MAX(w, h), stride = side + 6;
+		uint8_t *y = ms_malloc(stride * side);
+		uint8_t *cbcr = ms_malloc(stride * side / 2);
+		uint8_t *rgb1 = ms_malloc((w * 3 + 5) * h);
+		uint8_t *rgb2 = ms_malloc((w * 3 + 5) * h);
+		MSPicture ref, pic;
+		mblk_t *ref_m, *pic_m;
+
+		fill_random(y, stride * side);
+		fill_random(cbcr, stride * side / 2);
+		for (j = 0; j < (int)(sizeof(rotations) / sizeof(rotations[0])); j++) {
+			for (k = 0; k < 2; k++) {
+				mblk_t *m1, *m2;
+				MSPicture p1, p2;
+				ms_video_enable_x86_kernels(FALSE);
+				m1 = copy_ycbcrbiplanar_to_true_yuv_with_rotation_and_down_scale_by_2(allocator, y, cbcr, rotations[j], w, h, stride, stride, TRUE, k == 1);
+				ms_video_enable_x86_kernels(TRUE);
+				m2 = copy_ycbcrbiplanar_to_true_yuv_with_rotation_and_down_scale_by_2(allocator, y, cbcr, rotations[j], w, h, stride, stride, TRUE, k == 1);
+				ms_yuv_buf_init_from_mblk(&p1, m1);
+				ms_yuv_buf_init_from_mblk(&p2, m2);
+				if (!BC_ASSERT_TRUE(same_pictures(&p1, &p2))) {
+					ms_error("%ix%i picture differs with rotation %i, down scaling %i", w, h, rotations[j], k);
+				}
+				freemsg(m1);
+				freemsg(m2);
+			}
+		}
+
+		ref_m = ms_yuv_buf_alloc(&ref, w, h);
+		pic_m = ms_yuv_buf_alloc(&pic, w, h);
+		for (j = 0; j < (int)(sizeof(mirrors) / sizeof(mirrors[0])); j++) {
+			fill_random(ref.planes[0], ref.strides[0] * h);
+			fill_random(ref.planes[1], ref.strides[1] * h / 2);
+			fill_random(ref.planes[2], ref.strides[2] * h / 2);
+			memcpy(pic.planes[0], ref.planes[0], ref.strides[0] * h);
+			memcpy(pic.planes[1], ref.planes[1], ref.strides[1] * h / 2);
+			memcpy(pic.planes[2], ref.planes[2], ref.strides[2] * h / 2);
+			ms_video_enable_x86_kernels(FALSE);
+			ms_yuv_buf_mirrors(&ref, mirrors[j]);
+			ms_video_enable_x86_kernels(TRUE);
+			ms_yuv_buf_mirrors(&pic, mirrors[j]);
+			BC_ASSERT_TRUE(same_pictures(&ref, &pic));
+		}
+		freemsg(ref_m);
+		freemsg(pic_m);
+
+		fill_random(rgb1, (w * 3 + 5) * h);
+		memcpy(rgb2, rgb1, (w * 3 + 5) * h);
+		ms_video_enable_x86_kernels(FALSE);
+		rgb24_mirror(rgb1, w, h, w * 3 + 5);
+		ms_video_enable_x86_kernels(TRUE);
+		rgb24_mirror(rgb2, w, h, w * 3 + 5);
+		BC_ASSERT_EQUAL(memcmp(rgb1, rgb2, (w * 3 + 5) * h), 0, int, "%i");
+
+		ms_free(y);
+		ms_free(cbcr);
+		ms_free(rgb1);
+		ms_free(rgb2);
+	}
+	ms_yuv_buf_allocator_free(allocator);
+}
+#else
+static void test_x86_picture_kernels(void) {
+}
+#endif
+
 #endif
 
 static void test_is_multicast(void) {
@@ -236,6 +548,398 @@ static void test_is_multicast(void) {
 
 }
 
+#define PCM_MAX_SAMPLES 161
+
+static void fill_random_samples(int16_t *samples, int nsamples) {
+	int i;
+	for (i = 0; i < nsamples; i++) samples[i] = (int16_t)(rand() & 0xffff);
+	/*the extreme values are where the sign extensions and saturations of the vector code go wrong*/
+	if (nsamples > 1) {
+		samples[0] = -32768;
+		samples[nsamples - 1] = 32767;
+	}
+}
+
+/* the SSE2 and NEON kernels must give exactly the same samples as a plain loop, whatever the length and the alignment */
+static void test_pcm_format_kernels(void) {
+	int lengths[] = { 1, 7, 8, 9, 15, 16, 17, 63, 100, PCM_MAX_SAMPLES };
+	/*one extra sample and byte on each buffer, so that they can be used misaligned*/
+	int16_t in_buf[2 * PCM_MAX_SAMPLES + 1], out_buf[2 * PCM_MAX_SAMPLES + 1], ref[2 * PCM_MAX_SAMPLES];
+	int16_t left_buf[PCM_MAX_SAMPLES + 1], right_buf[PCM_MAX_SAMPLES + 1], ref_right[PCM_MAX_SAMPLES];
+	float float_buf[PCM_MAX_SAMPLES + 1], ref_float[PCM_MAX_SAMPLES];
+	uint8_t bytes_in[2 * PCM_MAX_SAMPLES + 1], bytes_out[2 * PCM_MAX_SAMPLES + 1], ref_bytes[2 * PCM_MAX_SAMPLES];
+	int i, j, offset, errors = 0;
+
+	for (i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++) {
+		int n = lengths[i];
+		for (offset = 0; offset < 2; offset++) {
+			int16_t *in = in_buf + offset, *out = out_buf + offset;
+			int16_t *left = left_buf + offset, *right = right_buf + offset;
+			float *f = float_buf + offset;
+
+			fill_random_samples(in, 2 * n);
+			ms_pcm_mono_to_stereo(in, out, n);
+			for (j = 0; j < n; j++) {
+				ref[2 * j] = ref[2 * j + 1] = in[j];
+			}
+			if (memcmp(out, ref, 2 * n * sizeof(int16_t)) != 0) errors++;
+
+			ms_pcm_stereo_to_mono(in, out, n);
+			for (j = 0; j < n; j++) ref[j] = in[2 * j];
+			if (memcmp(out, ref, n * sizeof(int16_t)) != 0) errors++;
+			/*in place*/
+			memcpy(out, in, 2 * n * sizeof(int16_t));
+			ms_pcm_stereo_to_mono(out, out, n);
+			if (memcmp(out, ref, n * sizeof(int16_t)) != 0) errors++;
+
+			ms_pcm_deinterleave_stereo(in, left, right, n);
+			for (j = 0; j < n; j++) ref_right[j] = in[2 * j + 1];
+			if (memcmp(left, ref, n * sizeof(int16_t)) != 0 || memcmp(right, ref_right, n * sizeof(int16_t)) != 0) errors++;
+
+			fill_random_samples(left, n);
+			fill_random_samples(right, n);
+			ms_pcm_interleave_stereo(left, right, out, n);
+			for (j = 0; j < n; j++) {
+				ref[2 * j] = left[j];
+				ref[2 * j + 1] = right[j];
+			}
+			if (memcmp(out, ref, 2 * n * sizeof(int16_t)) != 0) errors++;
+
+			ms_pcm_int16_to_float(in, f, n);
+			for (j = 0; j < n; j++) ref_float[j] = (float)in[j] / 32768.0f;
+			if (memcmp(f, ref_float, n * sizeof(float)) != 0) errors++;
+			/*back to the same samples, and out of range values saturate*/
+			ms_pcm_float_to_int16(f, out, n);
+			if (memcmp(out, in, n * sizeof(int16_t)) != 0) errors++;
+			for (j = 0; j < n; j++) {
+				f[j] = (float)(rand() % 4001 - 2000) / 1000.0f;
+				ref[j] = (int16_t)MAX(-32768, MIN(32767, lrintf(f[j] * 32768.0f)));
+			}
+			ms_pcm_float_to_int16(f, out, n);
+			if (memcmp(out, ref, n * sizeof(int16_t)) != 0) errors++;
+
+			/*the byte swap also works on buffers not aligned on a sample boundary*/
+			for (j = 0; j < 2 * n + 1; j++) bytes_in[j] = (uint8_t)rand();
+			for (j = 0; j < n; j++) {
+				ref_bytes[2 * j] = bytes_in[offset + 2 * j + 1];
+				ref_bytes[2 * j + 1] = bytes_in[offset + 2 * j];
+			}
+			ms_pcm_swap_bytes(bytes_in + offset, bytes_out + offset, n);
+			if (memcmp(bytes_out + offset, ref_bytes, 2 * n) != 0) errors++;
+			ms_pcm_swap_bytes(bytes_in + offset, bytes_in + offset, n);
+			if (memcmp(bytes_in + offset, ref_bytes, 2 * n) != 0) errors++;
+
+			if (errors != 0) {
+				ms_error("PCM kernels differ from the plain loops for %i samples with offset %i", n, offset);
+				break;
+			}
+		}
+		if (errors != 0) break;
+	}
+	BC_ASSERT_EQUAL(errors, 0, int, "%d");
+}
+
+#define WORKER_POOL_POSTERS 4
+#define WORKER_POOL_JOBS 200
+
+typedef struct {
+	MSFactory *factory;
+	MSWorkerPool *pool;
+	int posted_runs[WORKER_POOL_JOBS];
+	int batch_runs[WORKER_POOL_JOBS];
+} WorkerPoolPoster;
+
+static void worker_pool_job(void *data) {
+	int *runs = (int *)data;
+	(*runs)++;
+}
+
+static void *worker_pool_poster_run(void *data) {
+	WorkerPoolPoster *poster = (WorkerPoolPoster *)data;
+	void *batch[WORKER_POOL_JOBS];
+	int i;
+
+	poster->pool = ms_factory_get_worker_pool(poster->factory);
+	for (i = 0; i < WORKER_POOL_JOBS; ++i) {
+		ms_worker_pool_post(poster->pool, worker_pool_job, &poster->posted_runs[i]);
+		batch[i] = &poster->batch_runs[i];
+	}
+	ms_worker_pool_run(poster->pool, worker_pool_job, batch, WORKER_POOL_JOBS);
+	return NULL;
+}
+
+static void test_worker_pool(void) {
+	MSFactory *factory = ms_factory_new();
+	WorkerPoolPoster posters[WORKER_POOL_POSTERS];
+	ms_thread_t threads[WORKER_POOL_POSTERS];
+	int i, j, wrong_posted = 0, wrong_batch = 0;
+
+	memset(posters, 0, sizeof(posters));
+	ms_factory_set_cpu_count(factory, 4);
+	for (i = 0; i < WORKER_POOL_POSTERS; ++i) {
+		posters[i].factory = factory;
+		ms_thread_create(&threads[i], NULL, worker_pool_poster_run, &posters[i]);
+	}
+	for (i = 0; i < WORKER_POOL_POSTERS; ++i) {
+		ms_thread_join(threads[i], NULL);
+		/*all the threads asking for the pool of the factory at the same time get the same one*/
+		BC_ASSERT_TRUE(posters[i].pool == posters[0].pool);
+		/*ms_worker_pool_run() returns once all its jobs are done*/
+		for (j = 0; j < WORKER_POOL_JOBS; ++j) {
+			if (posters[i].batch_runs[j] != 1) wrong_batch++;
+		}
+	}
+	/*the jobs still queued are run before the threads of the pool exit*/
+	ms_factory_destroy(factory);
+	for (i = 0; i < WORKER_POOL_POSTERS; ++i) {
+		for (j = 0; j < WORKER_POOL_JOBS; ++j) {
+			if (posters[i].posted_runs[j] != 1) wrong_posted++;
+		}
+	}
+	BC_ASSERT_EQUAL(wrong_batch, 0, int, "%d");
+	BC_ASSERT_EQUAL(wrong_posted, 0, int, "%d");
+}
+
+typedef struct {
+	ms_mutex_t lock;
+	bool_t released;
+	bool_t done;
+} SlowJob;
+
+/* blocks until released, or for 5 seconds at most so that a failing test does not hang */
+static void worker_pool_slow_job(void *data) {
+	SlowJob *job = (SlowJob *)data;
+	int i;
+	for (i = 0; i < 500; i++) {
+		bool_t released;
+		ms_mutex_lock(&job->lock);
+		released = job->released;
+		ms_mutex_unlock(&job->lock);
+		if (released) break;
+		ms_usleep(10000);
+	}
+	ms_mutex_lock(&job->lock);
+	job->done = TRUE;
+	ms_mutex_unlock(&job->lock);
+}
+
+/* a batch run while the only thread of the pool is busy is done by the calling thread, without waiting for the busy one */
+static void test_worker_pool_run_does_not_wait(void) {
+	MSWorkerPool *pool = ms_worker_pool_new(1);
+	SlowJob slow;
+	int runs[WORKER_POOL_JOBS];
+	void *batch[WORKER_POOL_JOBS];
+	bool_t slow_done;
+	int i, wrong_batch = 0;
+
+	memset(&slow, 0, sizeof(slow));
+	memset(runs, 0, sizeof(runs));
+	ms_mutex_init(&slow.lock, NULL);
+	ms_worker_pool_post(pool, worker_pool_slow_job, &slow);
+	for (i = 0; i < WORKER_POOL_JOBS; ++i) batch[i] = &runs[i];
+	ms_worker_pool_run(pool, worker_pool_job, batch, WORKER_POOL_JOBS);
+
+	ms_mutex_lock(&slow.lock);
+	slow_done = slow.done;
+	slow.released = TRUE;
+	ms_mutex_unlock(&slow.lock);
+	BC_ASSERT_FALSE(slow_done);
+	for (i = 0; i < WORKER_POOL_JOBS; ++i) {
+		if (runs[i] != 1) wrong_batch++;
+	}
+	BC_ASSERT_EQUAL(wrong_batch, 0, int, "%d");
+	/*the helper job of the batch, queued behind the slow one, finds nothing to do and must not touch the batch array*/
+	ms_worker_pool_destroy(pool);
+	BC_ASSERT_TRUE(slow.done);
+	ms_mutex_destroy(&slow.lock);
+}
+
+#define PACER_BITRATE 256000
+#define PACER_PACKET_SIZE 200
+#define PACER_BURST_PACKETS 35
+
+/* the bytes output by the pacer during a tick */
+static int pacer_output_bytes(MSFilter *pacer) {
+	int bytes = 0;
+	mblk_t *m;
+	while ((m = ms_queue_get(pacer->outputs[0])) != NULL) {
+		bytes += (int)msgdsize(m);
+		freemsg(m);
+	}
+	return bytes;
+}
+
+static mblk_t *make_constant_samples(int16_t value, int nsamples) {
+	mblk_t *m = allocb(nsamples * 2, 0);
+	int i;
+	for (i = 0; i < nsamples; i++) {
+		*((int16_t *)m->b_wptr) = value;
+		m->b_wptr += 2;
+	}
+	return m;
+}
+
+/* a mono to stereo channel adapter with two inputs takes the left channel from the first one and the right from the second one */
+static void test_channel_adapter_interleave(void) {
+	MSFactory *factory = ms_factory_new_with_voip();
+	MSFilter *left = ms_factory_create_filter(factory, MS_VOID_SOURCE_ID);
+	MSFilter *right = ms_factory_create_filter(factory, MS_VOID_SOURCE_ID);
+	MSFilter *adapter = ms_factory_create_filter(factory, MS_CHANNEL_ADAPTER_ID);
+	MSFilter *sink = ms_factory_create_filter(factory, MS_VOID_SINK_ID);
+	int nchannels = 2;
+	int frames = 0, mismatches = 0;
+	mblk_t *m;
+	int i;
+
+	ms_filter_call_method(adapter, MS_CHANNEL_ADAPTER_SET_OUTPUT_NCHANNELS, &nchannels);
+	ms_filter_link(left, 0, adapter, 0);
+	ms_filter_link(right, 0, adapter, 1);
+	ms_filter_link(adapter, 0, sink, 0);
+
+	/*the inputs do not bring their audio in blocks of the same size*/
+	ms_queue_put(adapter->inputs[0], make_constant_samples(1000, 160));
+	ms_queue_put(adapter->inputs[1], make_constant_samples(-1000, 100));
+	adapter->desc->process(adapter);
+	ms_queue_put(adapter->inputs[1], make_constant_samples(-1000, 60));
+	adapter->desc->process(adapter);
+	while ((m = ms_queue_get(adapter->outputs[0])) != NULL) {
+		for (i = 0; i < (int)msgdsize(m) / 4; i++) {
+			if (((int16_t *)m->b_rptr)[2 * i] != 1000 || ((int16_t *)m->b_rptr)[2 * i + 1] != -1000) mismatches++;
+		}
+		frames += (int)msgdsize(m) / 4;
+		freemsg(m);
+	}
+	BC_ASSERT_EQUAL(frames, 160, int, "%d");
+	BC_ASSERT_EQUAL(mismatches, 0, int, "%d");
+
+	ms_filter_unlink(left, 0, adapter, 0);
+	ms_filter_unlink(right, 0, adapter, 1);
+	ms_filter_unlink(adapter, 0, sink, 0);
+	ms_filter_destroy(left);
+	ms_filter_destroy(right);
+	ms_filter_destroy(adapter);
+	ms_filter_destroy(sink);
+	ms_factory_destroy(factory);
+}
+
+/* the cross correlation of the audio diff, computed with ffts, must match the direct scalar products */
+static void test_audio_diff_cross_correlation(void) {
+	/*the lengths of the reference and the number of shifts, so that the fft sizes are not always a power of two away*/
+	int lengths[][2] = { { 100, 50 }, { 1000, 333 }, { 4801, 960 } };
+	int i, j, k;
+
+	for (i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++) {
+		int n1 = lengths[i][0], nshifts = lengths[i][1];
+		int n2 = n1 + nshifts - 1;
+		int offset = nshifts / 3;
+		int16_t *s1 = ms_new0(int16_t, n1);
+		int16_t *s2 = ms_new0(int16_t, n2);
+		float *xcorr = ms_new0(float, nshifts);
+		double max_direct = 0, max_error = 0;
+		int direct_peak = 0, fft_peak = 0;
+		float fft_max = 0;
+		int64_t direct_at_fft_peak = 0;
+
+		/*s2 holds s1 at a known offset, over a quieter noise*/
+		for (j = 0; j < n1; j++) s1[j] = (int16_t)(rand() % 16001 - 8000);
+		for (j = 0; j < n2; j++) s2[j] = (int16_t)(rand() % 2001 - 1000);
+		for (j = 0; j < n1; j++) s2[offset + j] = s1[j];
+		ms_audio_diff_cross_correlation(s1, n1, s2, xcorr, nshifts);
+
+		for (j = 0; j < nshifts; j++) {
+			int64_t direct = 0;
+			double error;
+			for (k = 0; k < n1; k++) direct += s1[k] * s2[j + k];
+			if (fabs((double)direct) > max_direct) {
+				max_direct = fabs((double)direct);
+				direct_peak = j;
+			}
+			if (fabsf(xcorr[j]) > fft_max) {
+				fft_max = fabsf(xcorr[j]);
+				fft_peak = j;
+				direct_at_fft_peak = direct;
+			}
+			error = fabs((double)xcorr[j] - (double)direct);
+			if (error > max_error) max_error = error;
+		}
+		BC_ASSERT_EQUAL(direct_peak, offset, int, "%d");
+		BC_ASSERT_EQUAL(fft_peak, offset, int, "%d");
+		/*the peak value and every other shift agree with the direct products within the float precision*/
+		BC_ASSERT_LOWER(fabs((double)xcorr[fft_peak] - (double)direct_at_fft_peak), 1e-5 * max_direct, double, "%f");
+		BC_ASSERT_LOWER(max_error, 1e-5 * max_direct, double, "%f");
+
+		ms_free(xcorr);
+		ms_free(s2);
+		ms_free(s1);
+	}
+}
+
+static void test_pacer(void) {
+	MSFactory *factory = ms_factory_new_with_voip();
+	MSFilter *source = ms_factory_create_filter(factory, MS_VOID_SOURCE_ID);
+	MSFilter *pacer = ms_factory_create_filter(factory, MS_PACER_ID);
+	MSFilter *sink = ms_factory_create_filter(factory, MS_VOID_SINK_ID);
+	MSTicker ticker;
+	int bitrate = PACER_BITRATE;
+	float factor = 2.5f;
+	int tick_budget, bytes, delay, max_bytes = 0, total = 0;
+	int i, k;
+
+	memset(&ticker, 0, sizeof(ticker));
+	ticker.interval = 10;
+	ms_filter_call_method(pacer, MS_FILTER_SET_BITRATE, &bitrate);
+	ms_filter_call_method(pacer, MS_PACER_SET_FACTOR, &factor);
+	/*the bytes the link carries in a tick at the pacing rate*/
+	tick_budget = (int)(factor * bitrate * ticker.interval / 8000);
+	ms_filter_link(source, 0, pacer, 0);
+	ms_filter_link(pacer, 0, sink, 0);
+	/*the filter is driven by hand, with a ticker whose time is set by the test*/
+	pacer->ticker = &ticker;
+	pacer->desc->preprocess(pacer);
+
+	/*the time the link stays idle does not allow a larger burst afterwards*/
+	for (k = 1; k <= 5; k++) {
+		ticker.time = (uint64_t)k * ticker.interval;
+		pacer->desc->process(pacer);
+		BC_ASSERT_EQUAL(pacer_output_bytes(pacer), 0, int, "%d");
+	}
+
+	/*a frame larger than what the link carries in a tick, but that can be sent in less than 100ms*/
+	for (i = 0; i < PACER_BURST_PACKETS; i++) {
+		mblk_t *m = allocb(PACER_PACKET_SIZE, 0);
+		memset(m->b_wptr, 0, PACER_PACKET_SIZE);
+		m->b_wptr += PACER_PACKET_SIZE;
+		ms_queue_put(pacer->inputs[0], m);
+	}
+	for (; k <= 25; k++) {
+		ticker.time = (uint64_t)k * ticker.interval;
+		pacer->desc->process(pacer);
+		bytes = pacer_output_bytes(pacer);
+		max_bytes = MAX(max_bytes, bytes);
+		total += bytes;
+		if (total < PACER_BURST_PACKETS * PACER_PACKET_SIZE) {
+			/*the frame is spread over the ticks*/
+			BC_ASSERT_EQUAL(bytes, tick_budget, int, "%d");
+			ms_filter_call_method(pacer, MS_PACER_GET_QUEUE_DELAY, &delay);
+			BC_ASSERT_LOWER(delay, 100, int, "%d");
+		}
+	}
+	BC_ASSERT_LOWER(max_bytes, tick_budget, int, "%d");
+	/*the queue drains*/
+	BC_ASSERT_EQUAL(total, PACER_BURST_PACKETS * PACER_PACKET_SIZE, int, "%d");
+	ms_filter_call_method(pacer, MS_PACER_GET_QUEUE_DELAY, &delay);
+	BC_ASSERT_EQUAL(delay, 0, int, "%d");
+
+	pacer->desc->postprocess(pacer);
+	pacer->ticker = NULL;
+	ms_filter_unlink(source, 0, pacer, 0);
+	ms_filter_unlink(pacer, 0, sink, 0);
+	ms_filter_destroy(source);
+	ms_filter_destroy(pacer);
+	ms_filter_destroy(sink);
+	ms_factory_destroy(factory);
+}
+
 static void test_filterdesc_enable_disable_base(const char* mime, const char* filtername,bool_t is_enc) {
 	MSFilter *filter;
 
@@ -274,17 +978,609 @@ static void test_filterdesc_enable_disable(void) {
 	test_filterdesc_enable_disable_base("pcmu", "MSUlawDec", FALSE);
 	test_filterdesc_enable_disable_base("pcma", "MSAlawEnc", TRUE);
 }
+#ifdef VIDEO_ENABLED
+typedef struct {
+	ms_mutex_t lock;
+	bool_t started;
+	bool_t released;
+} EncoderGate;
+
+static EncoderGate encoder_gate;
+
+/* the encoding blocks until the test releases it, for 5 seconds at most so that a failing test does not hang */
+static void fake_encode(MSFilter *f, mblk_t *frame, uint64_t frame_time, MSQueue *output) {
+	bool_t released = FALSE;
+	int wait = 0;
+
+	ms_mutex_lock(&encoder_gate.lock);
+	encoder_gate.started = TRUE;
+	ms_mutex_unlock(&encoder_gate.lock);
+	while (!released && wait++ < 500) {
+		ms_mutex_lock(&encoder_gate.lock);
+		released = encoder_gate.released;
+		ms_mutex_unlock(&encoder_gate.lock);
+		if (!released) ms_usleep(10000);
+	}
+	ms_queue_put(output, dupmsg(frame));
+}
+
+static void push_numbered_frame(MSEncoderThread *et, int i) {
+	mblk_t *m = allocb(sizeof(int), 0);
+	*(int *)m->b_wptr = i;
+	m->b_wptr += sizeof(int);
+	ms_encoder_thread_push(et, m, i * 40);
+}
+
+static void test_encoder_thread(void) {
+	MSFactory *factory = ms_factory_new();
+	MSFilter *f = ms_factory_create_filter(factory, MS_VOID_SINK_ID);
+	MSEncoderThread *et;
+	MSVideoEncoderAsyncStats stats;
+	MSQueue output;
+	mblk_t *m;
+	bool_t started = FALSE;
+	int i, last = -1, count = 0, wait = 0;
+
+	memset(&encoder_gate, 0, sizeof(encoder_gate));
+	ms_mutex_init(&encoder_gate.lock, NULL);
+	et = ms_encoder_thread_new(f, fake_encode, 1);
+	BC_ASSERT_PTR_NOT_NULL(et);
+	if (et == NULL) goto end;
+	ms_queue_init(&output);
+	/*while the first frame is being encoded, the frames pile up and only the newest one is kept*/
+	push_numbered_frame(et, 0);
+	while (!started && wait++ < 500) {
+		ms_mutex_lock(&encoder_gate.lock);
+		started = encoder_gate.started;
+		ms_mutex_unlock(&encoder_gate.lock);
+		if (!started) ms_usleep(10000);
+	}
+	BC_ASSERT_TRUE(started);
+	for (i = 1; i < 4; ++i) push_numbered_frame(et, i);
+	ms_encoder_thread_get_stats(et, &stats);
+	BC_ASSERT_EQUAL(stats.dropped_frames, 2, unsigned int, "%u");
+	BC_ASSERT_EQUAL(stats.encoded_frames, 0, unsigned int, "%u");
+
+	ms_mutex_lock(&encoder_gate.lock);
+	encoder_gate.released = TRUE;
+	ms_mutex_unlock(&encoder_gate.lock);
+	wait = 0;
+	do {
+		ms_usleep(10000);
+		ms_encoder_thread_get_stats(et, &stats);
+	} while (stats.encoded_frames < 2 && ++wait < 500);
+	BC_ASSERT_EQUAL(stats.encoded_frames, 2, unsigned int, "%u");
+	BC_ASSERT_EQUAL(stats.dropped_frames, 2, unsigned int, "%u");
+	BC_ASSERT_TRUE(stats.max_latency >= stats.mean_latency);
+
+	ms_encoder_thread_collect(et, &output);
+	while ((m = ms_queue_get(&output)) != NULL) {
+		last = *(int *)m->b_rptr;
+		count++;
+		freemsg(m);
+	}
+	BC_ASSERT_EQUAL(count, 2, int, "%d");
+	/*the most recent frame is never dropped*/
+	BC_ASSERT_EQUAL(last, 3, int, "%d");
+	ms_encoder_thread_destroy(et);
+end:
+	ms_mutex_destroy(&encoder_gate.lock);
+	ms_filter_destroy(f);
+	ms_factory_destroy(factory);
+}
+
+/* gives a picture of the size of the encoder to the VP8 encoder driven by hand, and returns the number of RTP payloads of each output */
+static int vp8_encode_picture(MSFilter *enc, MSTicker *ticker, uint64_t time, int *outputs) {
+	MSVideoSize vsize;
+	MSPicture pic;
+	mblk_t *m;
+	int i, total = 0;
+
+	ms_filter_call_method(enc, MS_FILTER_GET_VIDEO_SIZE, &vsize);
+	m = ms_yuv_buf_alloc(&pic, vsize.width, vsize.height);
+	for (i = 0; i < vsize.height; i++) memset(pic.planes[0] + i * pic.strides[0], (int)((i + time / 10) & 0xff), vsize.width);
+	memset(pic.planes[1], 128, pic.strides[1] * vsize.height / 2);
+	memset(pic.planes[2], 128, pic.strides[2] * vsize.height / 2);
+	ticker->time = time;
+	ms_queue_put(enc->inputs[0], m);
+	enc->desc->process(enc);
+	for (i = 0; i < enc->desc->noutputs; i++) {
+		int count = 0;
+		if (enc->outputs[i] == NULL) continue;
+		while ((m = ms_queue_get(enc->outputs[i])) != NULL) {
+			count++;
+			freemsg(m);
+		}
+		if (outputs) outputs[i] = count;
+		total += count;
+	}
+	return total;
+}
+
+static void test_vp8_encoder_load_adaptation(void) {
+	MSFactory *factory = ms_factory_new_with_voip();
+	MSFilter *source, *enc, *sink;
+	MSTicker ticker;
+	MSVideoSize vsize;
+	float configured_fps = 15, fps = 15;
+	bool_t enable = TRUE;
+	uint64_t time = 0;
+	int i, payloads = 0;
+
+	if (!ms_factory_codec_supported(factory, "VP8")) {
+		ms_factory_destroy(factory);
+		return;
+	}
+	/*with a single thread, the controller raises cpu-used and then lowers the frame rate*/
+	ms_factory_set_cpu_count(factory, 1);
+	source = ms_factory_create_filter(factory, MS_VOID_SOURCE_ID);
+	enc = ms_factory_create_encoder(factory, "VP8");
+	sink = ms_factory_create_filter(factory, MS_VOID_SINK_ID);
+	MS_VIDEO_SIZE_ASSIGN(vsize, QCIF);
+	ms_filter_call_method(enc, MS_FILTER_SET_VIDEO_SIZE, &vsize);
+	ms_filter_call_method(enc, MS_FILTER_SET_FPS, &configured_fps);
+	ms_filter_call_method(enc, MS_VIDEO_ENCODER_ENABLE_LOAD_ADAPTATION, &enable);
+	ms_filter_link(source, 0, enc, 0);
+	ms_filter_link(enc, 0, sink, 0);
+	memset(&ticker, 0, sizeof(ticker));
+	ticker.interval = 10;
+	enc->ticker = &ticker;
+	enc->desc->preprocess(enc);
+
+	/*the load of the ticker is set by the test, the encoding of these small pictures stays fast*/
+	ticker.av_load = 95;
+	for (i = 0; i < 1000 && fps == configured_fps; i++) {
+		vp8_encode_picture(enc, &ticker, time, NULL);
+		time += 1000 / 15;
+		ms_filter_call_method(enc, MS_FILTER_GET_FPS, &fps);
+	}
+	BC_ASSERT_TRUE(fps < configured_fps);
+
+	/*the encoders are reconfigured, not restarted: the frames keep flowing, and the configured frame rate comes back when the load is low*/
+	ticker.av_load = 10;
+	for (i = 0; i < 1000 && fps != configured_fps; i++) {
+		payloads += vp8_encode_picture(enc, &ticker, time, NULL);
+		time += 1000 / 15;
+		ms_filter_call_method(enc, MS_FILTER_GET_FPS, &fps);
+	}
+	BC_ASSERT_EQUAL(fps, configured_fps, float, "%f");
+	BC_ASSERT_GREATER(payloads, 0, int, "%d");
+
+	enc->desc->postprocess(enc);
+	enc->ticker = NULL;
+	ms_filter_unlink(source, 0, enc, 0);
+	ms_filter_unlink(enc, 0, sink, 0);
+	ms_filter_destroy(source);
+	ms_filter_destroy(enc);
+	ms_filter_destroy(sink);
+	ms_factory_destroy(factory);
+}
+
+static void test_vp8_encoder_simulcast(void) {
+	MSFactory *factory = ms_factory_new_with_voip();
+	MSFilter *source, *enc, *sinks[3];
+	MSTicker ticker;
+	MSVideoConfiguration vconf = MS_VIDEO_CONF(2000000, 3000000, VGA, 15, 1);
+	int layers = 3;
+	int outputs[3];
+	int payloads[3] = { 0 };
+	MSVideoEncoderLayersThreads lt;
+	bool_t enable = TRUE;
+	int i, k;
+
+	if (!ms_factory_codec_supported(factory, "VP8")) {
+		ms_factory_destroy(factory);
+		return;
+	}
+	/*with two threads and a busy host, the controller removes a thread from every layer*/
+	ms_factory_set_cpu_count(factory, 2);
+	source = ms_factory_create_filter(factory, MS_VOID_SOURCE_ID);
+	enc = ms_factory_create_encoder(factory, "VP8");
+	ms_filter_call_method(enc, MS_VIDEO_ENCODER_SET_CONFIGURATION, &vconf);
+	ms_filter_call_method(enc, MS_VIDEO_ENCODER_SET_SIMULCAST_LAYERS, &layers);
+	ms_filter_call_method(enc, MS_VIDEO_ENCODER_ENABLE_LOAD_ADAPTATION, &enable);
+	ms_filter_link(source, 0, enc, 0);
+	for (i = 0; i < 3; i++) {
+		sinks[i] = ms_factory_create_filter(factory, MS_VOID_SINK_ID);
+		ms_filter_link(enc, i, sinks[i], 0);
+	}
+	memset(&ticker, 0, sizeof(ticker));
+	ticker.interval = 10;
+	ticker.av_load = 95;
+	enc->ticker = &ticker;
+	enc->desc->preprocess(enc);
+	ms_filter_call_method(enc, MS_VIDEO_ENCODER_GET_LAYERS_THREADS, &lt);
+	BC_ASSERT_EQUAL(lt.nlayers, 3, int, "%d");
+	for (i = 0; i < lt.nlayers; i++) {
+		BC_ASSERT_EQUAL(lt.threads[i], 2, int, "%d");
+	}
+
+	/*VGA, QVGA and QQVGA layers, each on its own output, before and after the change of the number of threads*/
+	for (k = 0; k < 45; k++) {
+		memset(outputs, 0, sizeof(outputs));
+		vp8_encode_picture(enc, &ticker, (uint64_t)k * 1000 / 15, outputs);
+		for (i = 0; i < 3; i++) {
+			if (outputs[i] > 0) payloads[i]++;
+		}
+	}
+	for (i = 0; i < 3; i++) {
+		BC_ASSERT_EQUAL(payloads[i], 45, int, "%d");
+	}
+	ms_filter_call_method(enc, MS_VIDEO_ENCODER_GET_LAYERS_THREADS, &lt);
+	BC_ASSERT_EQUAL(lt.nlayers, 3, int, "%d");
+	for (i = 0; i < lt.nlayers; i++) {
+		BC_ASSERT_EQUAL(lt.threads[i], 1, int, "%d");
+	}
+
+	enc->desc->postprocess(enc);
+	enc->ticker = NULL;
+	ms_filter_unlink(source, 0, enc, 0);
+	for (i = 0; i < 3; i++) {
+		ms_filter_unlink(enc, i, sinks[i], 0);
+		ms_filter_destroy(sinks[i]);
+	}
+	ms_filter_destroy(source);
+	ms_filter_destroy(enc);
+	ms_factory_destroy(factory);
+}
+
+static mblk_t *make_vp8_payload(bool_t key_frame, uint32_t ts) {
+	mblk_t *m = allocb(2, 0);
+	*m->b_wptr++ = 0x10; /*start of partition 0*/
+	*m->b_wptr++ = key_frame ? 0x00 : 0x01;
+	mblk_set_timestamp_info(m, ts);
+	return m;
+}
+
+static void switcher_event_cb(void *ud, MSFilter *f, unsigned int event, void *arg) {
+	int *fir_pin = (int *)ud;
+	if (event == MS_VIDEO_SWITCHER_SEND_FIR) *fir_pin = *(int *)arg;
+}
+
+static int switcher_output_ts(MSFilter *f, int pin, uint32_t *ts) {
+	mblk_t *m;
+	int count = 0;
+	while ((m = ms_queue_get(f->outputs[pin])) != NULL) {
+		*ts = mblk_get_timestamp_info(m);
+		count++;
+		freemsg(m);
+	}
+	return count;
+}
+
+static void test_h264_nalus_slicing(void) {
+	/*a SPS with an emulation prevention byte, a PPS after a 3 bytes start code, and a slice longer than a SIMD block*/
+	static const uint8_t bitstream[] = {
+		0, 0, 0, 1, 0x67, 0x42, 0, 0, 3, 1, 0x1f,
+		0, 0, 1, 0x68, 0xce, 0x3c, 0x80,
+		0, 0, 0, 1, 0x65, 0x88, 0x84, 0x21, 0xa0, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa,
+		0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0, 0
+	};
+	static const size_t sizes[] = { 7, 4, 28 };
+	static const size_t offsets[] = { 4, 14, 22 };
+	static const uint8_t sps_rbsp[] = { 0x67, 0x42, 0, 0, 1, 0x1f };
+	uint8_t rbsp[sizeof(bitstream)];
+	MSQueue copies, views;
+	mblk_t *frame = allocb(sizeof(bitstream), 0);
+	mblk_t *m;
+	int i = 0;
+
+	memcpy(frame->b_wptr, bitstream, sizeof(bitstream));
+	frame->b_wptr += sizeof(bitstream);
+	ms_queue_init(&copies);
+	ms_queue_init(&views);
+	ms_h264_bitstream_to_nalus(bitstream, sizeof(bitstream), &copies);
+	ms_h264_frame_to_nalus(frame, &views);
+	BC_ASSERT_EQUAL(copies.q.q_mcount, 3, int, "%d");
+	BC_ASSERT_EQUAL(views.q.q_mcount, 3, int, "%d");
+	while ((m = ms_queue_get(&views)) != NULL) {
+		mblk_t *copy = ms_queue_get(&copies);
+		if (i < 3 && copy != NULL) {
+			BC_ASSERT_EQUAL((int)(m->b_wptr - m->b_rptr), (int)sizes[i], int, "%d");
+			BC_ASSERT_TRUE(m->b_rptr == frame->b_rptr + offsets[i]);
+			BC_ASSERT_EQUAL((int)(copy->b_wptr - copy->b_rptr), (int)sizes[i], int, "%d");
+			BC_ASSERT_EQUAL(memcmp(copy->b_rptr, bitstream + offsets[i], sizes[i]), 0, int, "%d");
+		}
+		if (i == 0) {
+			BC_ASSERT_EQUAL(ms_h264_nalu_get_type(m), MSH264NaluTypeSPS, int, "%d");
+			BC_ASSERT_EQUAL((int)ms_h264_nalu_remove_emulation_prevention_bytes(m->b_rptr, m->b_wptr - m->b_rptr, rbsp),
+				(int)sizeof(sps_rbsp), int, "%d");
+			BC_ASSERT_EQUAL(memcmp(rbsp, sps_rbsp, sizeof(sps_rbsp)), 0, int, "%d");
+		}
+		freemsg(m);
+		if (copy) freemsg(copy);
+		i++;
+	}
+	freemsg(frame);
+}
+
+static void test_video_switcher(void) {
+	MSFactory *factory = ms_factory_new_with_voip();
+	MSFilter *switcher = ms_factory_create_filter(factory, MS_VIDEO_SWITCHER_ID);
+	MSFilter *sources[3], *sinks[3];
+	MSTicker ticker;
+	int i, fir_pin = -1, focus = 1;
+	uint32_t ts = 0;
+
+	memset(&ticker, 0, sizeof(ticker));
+	for (i = 0; i < 3; ++i) {
+		sources[i] = ms_factory_create_filter(factory, MS_VOID_SOURCE_ID);
+		sinks[i] = ms_factory_create_filter(factory, MS_VOID_SINK_ID);
+		ms_filter_link(sources[i], 0, switcher, i);
+		ms_filter_link(switcher, i, sinks[i], 0);
+	}
+	ms_filter_add_notify_callback(switcher, switcher_event_cb, &fir_pin, TRUE);
+	/*the filter is driven by hand, with a ticker whose time is set by the test*/
+	switcher->ticker = &ticker;
+	switcher->desc->preprocess(switcher);
+
+	/*the first participant gets the focus, and a key frame is requested from it*/
+	switcher->desc->process(switcher);
+	BC_ASSERT_EQUAL(fir_pin, 0, int, "%d");
+	ms_queue_put(switcher->inputs[0], make_vp8_payload(FALSE, 1000));
+	switcher->desc->process(switcher);
+	BC_ASSERT_EQUAL(switcher_output_ts(switcher, 1, &ts), 0, int, "%d");
+	ticker.time = 100;
+	ms_queue_put(switcher->inputs[0], make_vp8_payload(TRUE, 4000));
+	switcher->desc->process(switcher);
+	BC_ASSERT_EQUAL(switcher_output_ts(switcher, 0, &ts), 0, int, "%d");
+	BC_ASSERT_EQUAL(switcher_output_ts(switcher, 1, &ts), 1, int, "%d");
+	BC_ASSERT_EQUAL(switcher_output_ts(switcher, 2, &ts), 1, int, "%d");
+	BC_ASSERT_EQUAL(ts, 4000, uint32_t, "%u");
+
+	/*the outputs keep forwarding the previous participant until the new one sends a key frame*/
+	ms_filter_call_method(switcher, MS_VIDEO_SWITCHER_SET_FOCUS, &focus);
+	ticker.time = 1200;
+	switcher->desc->process(switcher);
+	BC_ASSERT_EQUAL(fir_pin, 1, int, "%d");
+	ms_queue_put(switcher->inputs[1], make_vp8_payload(FALSE, 50000));
+	ms_queue_put(switcher->inputs[0], make_vp8_payload(FALSE, 7000));
+	switcher->desc->process(switcher);
+	BC_ASSERT_EQUAL(switcher_output_ts(switcher, 1, &ts), 1, int, "%d");
+	BC_ASSERT_EQUAL(switcher_output_ts(switcher, 2, &ts), 1, int, "%d");
+	BC_ASSERT_EQUAL(ts, 7000, uint32_t, "%u");
+	ticker.time = 1240;
+	ms_queue_put(switcher->inputs[1], make_vp8_payload(TRUE, 90000));
+	ms_queue_put(switcher->inputs[1], make_vp8_payload(FALSE, 93000));
+	switcher->desc->process(switcher);
+	/*the participant having the focus still receives the previous one*/
+	BC_ASSERT_EQUAL(switcher_output_ts(switcher, 1, &ts), 0, int, "%d");
+	BC_ASSERT_EQUAL(switcher_output_ts(switcher, 0, &ts), 2, int, "%d");
+	/*the timestamps continue those of the previous participant: 7000 + 40ms at 90kHz + 3000*/
+	BC_ASSERT_EQUAL(switcher_output_ts(switcher, 2, &ts), 2, int, "%d");
+	BC_ASSERT_EQUAL(ts, 13600, uint32_t, "%u");
+
+	switcher->ticker = NULL;
+	for (i = 0; i < 3; ++i) {
+		ms_filter_unlink(sources[i], 0, switcher, i);
+		ms_filter_unlink(switcher, i, sinks[i], 0);
+		ms_filter_destroy(sources[i]);
+		ms_filter_destroy(sinks[i]);
+	}
+	ms_filter_destroy(switcher);
+	ms_factory_destroy(factory);
+}
+#endif
+
+#ifdef VIDEO_ENABLED
+static void check_rect(const MSRect *r, int x, int y, int w, int h) {
+	BC_ASSERT_EQUAL(r->x, x, int, "%d");
+	BC_ASSERT_EQUAL(r->y, y, int, "%d");
+	BC_ASSERT_EQUAL(r->w, w, int, "%d");
+	BC_ASSERT_EQUAL(r->h, h, int, "%d");
+}
+
+/* the cells are inside the picture, do not overlap and have even positions and sizes */
+static void check_layout_cells(MSVideoSize wsize, const MSRect *rects, int n) {
+	int i, j;
+	for (i = 0; i < n; i++) {
+		const MSRect *a = &rects[i];
+		BC_ASSERT_TRUE(a->x >= 0 && a->y >= 0 && a->w > 0 && a->h > 0);
+		BC_ASSERT_TRUE(a->x + a->w <= wsize.width && a->y + a->h <= wsize.height);
+		BC_ASSERT_EQUAL((a->x | a->y | a->w | a->h) & 0x1, 0, int, "%d");
+		for (j = i + 1; j < n; j++) {
+			const MSRect *b = &rects[j];
+			BC_ASSERT_TRUE(a->x + a->w <= b->x || b->x + b->w <= a->x || a->y + a->h <= b->y || b->y + b->h <= a->y);
+		}
+	}
+}
+
+static void test_video_mixer_layouts(void) {
+	MSVideoSize vga;
+	MSRect rects[MS_VIDEO_MIXER_MAX_INPUTS];
+	int n;
+
+	MS_VIDEO_SIZE_ASSIGN(vga, VGA);
+	ms_layout_compute_grid(vga, 1, rects);
+	check_rect(&rects[0], 0, 0, 640, 480);
+	ms_layout_compute_grid(vga, 2, rects);
+	check_rect(&rects[0], 0, 0, 320, 480);
+	check_rect(&rects[1], 320, 0, 320, 480);
+	/*the incomplete last row is centered*/
+	ms_layout_compute_grid(vga, 3, rects);
+	check_rect(&rects[2], 160, 240, 320, 240);
+	ms_layout_compute_grid(vga, 4, rects);
+	check_rect(&rects[0], 0, 0, 320, 240);
+	check_rect(&rects[1], 320, 0, 320, 240);
+	check_rect(&rects[2], 0, 240, 320, 240);
+	check_rect(&rects[3], 320, 240, 320, 240);
+	ms_layout_compute_grid(vga, 9, rects);
+	check_rect(&rects[0], 2, 0, 212, 160);
+	check_rect(&rects[8], 426, 320, 212, 160);
+
+	ms_layout_compute_active_speaker(vga, 1, rects);
+	check_rect(&rects[0], 0, 0, 640, 480);
+	ms_layout_compute_active_speaker(vga, 4, rects);
+	check_rect(&rects[0], 0, 0, 640, 360);
+	check_rect(&rects[1], 80, 360, 160, 120);
+	check_rect(&rects[3], 400, 360, 160, 120);
+
+	for (n = 1; n <= MS_VIDEO_MIXER_MAX_INPUTS; n++) {
+		ms_layout_compute_grid(vga, n, rects);
+		check_layout_cells(vga, rects, n);
+		ms_layout_compute_active_speaker(vga, n, rects);
+		check_layout_cells(vga, rects, n);
+	}
+}
+
+static mblk_t *make_uniform_picture(int width, int height, uint8_t luma) {
+	MSPicture pic;
+	mblk_t *m = ms_yuv_buf_alloc(&pic, width, height);
+	memset(pic.planes[0], luma, pic.strides[0] * height);
+	memset(pic.planes[1], 128, pic.strides[1] * height / 2);
+	memset(pic.planes[2], 128, pic.strides[2] * height / 2);
+	return m;
+}
+
+static int composed_luma(mblk_t *m, int x, int y) {
+	MSPicture pic;
+	ms_yuv_buf_init_from_mblk(&pic, m);
+	return pic.planes[0][y * pic.strides[0] + x];
+}
+
+static void test_video_mixer_graph(void) {
+	MSFactory *factory = ms_factory_new_with_voip();
+	MSFilter *sources[2], *mixer, *sink;
+	MSTicker ticker;
+	MSVideoSize vsize;
+	MSVideoMixerLayout layout = MSVideoMixerLayoutActiveSpeaker;
+	int speaker = 1;
+	mblk_t *m;
+	int i;
+
+	mixer = ms_factory_create_filter(factory, MS_VIDEO_MIXER_ID);
+	sink = ms_factory_create_filter(factory, MS_VOID_SINK_ID);
+	MS_VIDEO_SIZE_ASSIGN(vsize, VGA);
+	ms_filter_call_method(mixer, MS_FILTER_SET_VIDEO_SIZE, &vsize);
+	for (i = 0; i < 2; i++) {
+		sources[i] = ms_factory_create_filter(factory, MS_VOID_SOURCE_ID);
+		ms_filter_link(sources[i], 0, mixer, i);
+	}
+	ms_filter_link(mixer, 0, sink, 0);
+	memset(&ticker, 0, sizeof(ticker));
+	ticker.interval = 10;
+	mixer->ticker = &ticker;
+	mixer->desc->preprocess(mixer);
+
+	/*both slots of the grid change, they are composed in parallel*/
+	ms_queue_put(mixer->inputs[0], make_uniform_picture(MS_VIDEO_SIZE_QCIF_W, MS_VIDEO_SIZE_QCIF_H, 200));
+	ms_queue_put(mixer->inputs[1], make_uniform_picture(MS_VIDEO_SIZE_QCIF_W, MS_VIDEO_SIZE_QCIF_H, 50));
+	ticker.time = 10;
+	mixer->desc->process(mixer);
+	m = ms_queue_get(mixer->outputs[0]);
+	BC_ASSERT_PTR_NOT_NULL(m);
+	if (m) {
+		BC_ASSERT_EQUAL(composed_luma(m, 160, 240), 200, int, "%d");
+		BC_ASSERT_EQUAL(composed_luma(m, 480, 240), 50, int, "%d");
+		/*the pictures keep their aspect ratio, the rest of their slot is black*/
+		BC_ASSERT_EQUAL(composed_luma(m, 160, 4), 16, int, "%d");
+		freemsg(m);
+	}
+
+	/*the active speaker gets the main slot, without a new picture*/
+	ms_filter_call_method(mixer, MS_VIDEO_MIXER_SET_LAYOUT, &layout);
+	ms_filter_call_method(mixer, MS_VIDEO_MIXER_SET_ACTIVE_SPEAKER, &speaker);
+	ticker.time = 100;
+	mixer->desc->process(mixer);
+	m = ms_queue_get(mixer->outputs[0]);
+	BC_ASSERT_PTR_NOT_NULL(m);
+	if (m) {
+		BC_ASSERT_EQUAL(composed_luma(m, 320, 180), 50, int, "%d");
+		BC_ASSERT_EQUAL(composed_luma(m, 320, 420), 200, int, "%d");
+		freemsg(m);
+	}
+
+	mixer->desc->postprocess(mixer);
+	mixer->ticker = NULL;
+	for (i = 0; i < 2; i++) {
+		ms_filter_unlink(sources[i], 0, mixer, i);
+		ms_filter_destroy(sources[i]);
+	}
+	ms_filter_unlink(mixer, 0, sink, 0);
+	ms_filter_destroy(mixer);
+	ms_filter_destroy(sink);
+	ms_factory_destroy(factory);
+}
+
+static void test_static_image_cache(void) {
+	MSFactory *factory = ms_factory_new_with_voip();
+	MSStaticImageCache *cache = ms_factory_get_static_image_cache(factory);
+	char *path = bc_tester_res("images/nowebcamCIF.jpg");
+	MSVideoSize vsize1, vsize2;
+	MSStaticImageCacheStats stats;
+	mblk_t *pic1, *pic2;
+	size_t size;
+	uint8_t *saved;
+
+	BC_ASSERT_PTR_NOT_NULL(cache);
+	if (cache == NULL) goto end;
+	MS_VIDEO_SIZE_ASSIGN(vsize1, CIF);
+	MS_VIDEO_SIZE_ASSIGN(vsize2, CIF);
+	pic1 = ms_static_image_cache_get(cache, path, &vsize1);
+	pic2 = ms_static_image_cache_get(cache, path, &vsize2);
+	BC_ASSERT_PTR_NOT_NULL(pic1);
+	BC_ASSERT_PTR_NOT_NULL(pic2);
+	ms_static_image_cache_get_stats(cache, &stats);
+	BC_ASSERT_EQUAL(stats.misses, 1, unsigned int, "%u");
+	BC_ASSERT_EQUAL(stats.hits, 1, unsigned int, "%u");
+	BC_ASSERT_EQUAL(stats.entries, 1, unsigned int, "%u");
+	if (pic1 == NULL || pic2 == NULL) {
+		if (pic1) freemsg(pic1);
+		if (pic2) freemsg(pic2);
+		goto end;
+	}
+	/*the filters using the pictures run in different tickers, they must not share a data block*/
+	BC_ASSERT_TRUE(pic1->b_datap != pic2->b_datap);
+	BC_ASSERT_EQUAL(pic1->b_datap->db_ref, 1, int, "%d");
+	BC_ASSERT_EQUAL(pic2->b_datap->db_ref, 1, int, "%d");
+	BC_ASSERT_TRUE(ms_video_size_equal(vsize1, vsize2));
+	size = msgdsize(pic1);
+	BC_ASSERT_EQUAL(msgdsize(pic2), size, size_t, "%zu");
+	BC_ASSERT_EQUAL(memcmp(pic1->b_rptr, pic2->b_rptr, size), 0, int, "%d");
+
+	/*freeing a copy, and then the cache, leaves the other copy intact*/
+	saved = ms_malloc(size);
+	memcpy(saved, pic2->b_rptr, size);
+	freemsg(pic1);
+	ms_static_image_cache_flush(cache);
+	BC_ASSERT_EQUAL(memcmp(saved, pic2->b_rptr, size), 0, int, "%d");
+	freemsg(pic2);
+	ms_free(saved);
+end:
+	free(path);
+	ms_factory_destroy(factory);
+}
+#endif
+
 static test_t tests[] = {
 	 { "Multiple ms_voip_init", filter_register_tester },
 	 { "Is multicast", test_is_multicast},
 	 { "FilterDesc enabling/disabling", test_filterdesc_enable_disable},
+	 { "Worker pool", test_worker_pool},
+	 { "Worker pool run does not wait for busy threads", test_worker_pool_run_does_not_wait},
+	 { "PCM format kernels", test_pcm_format_kernels},
+	 { "Channel adapter interleaving", test_channel_adapter_interleave},
+	 { "Audio diff cross correlation", test_audio_diff_cross_correlation},
+	 { "Pacer", test_pacer},
 #ifdef VIDEO_ENABLED
 	 { "Video processing function", test_video_processing},
 	 { "Copy ycbcrbiplanar to true yuv with downscaling", test_copy_ycbcrbiplanar_to_true_yuv_with_downscaling},
 	 { "Copy ycbcrbiplanar to true yuv with rotation clock wise",test_copy_ycbcrbiplanar_to_true_yuv_with_rotation_clock_wise},
 	 { "Copy ycbcrbiplanar to true yuv with rotation clock wise with downscaling",test_copy_ycbcrbiplanar_to_true_yuv_with_rotation_clock_wise_with_downscaling},
 	 { "Copy ycbcrbiplanar to true yuv with rotation 180", test_copy_ycbcrbiplanar_to_true_yuv_with_rotation_180},
-	 { "Copy ycbcrbiplanar to true yuv with rotation 180 with downscaling", test_copy_ycbcrbiplanar_to_true_yuv_with_rotation_180_with_downscaling}
+	 { "Copy ycbcrbiplanar to true yuv with rotation 180 with downscaling", test_copy_ycbcrbiplanar_to_true_yuv_with_rotation_180_with_downscaling},
+	 { "x86 scaler", test_x86_scaler},
+	 { "x86 scaler nearest neighbour", test_x86_scaler_neighbour},
+	 { "Scaler slicing", test_scaler_slicing},
+	 { "x86 picture kernels", test_x86_picture_kernels},
+	 { "Encoder thread", test_encoder_thread},
+	 { "VP8 encoder load adaptation", test_vp8_encoder_load_adaptation},
+	 { "VP8 encoder simulcast", test_vp8_encoder_simulcast},
+	 { "Static image cache", test_static_image_cache},
+	 { "Video mixer layouts", test_video_mixer_layouts},
+	 { "Video mixer graph", test_video_mixer_graph},
+	 { "Video switcher", test_video_switcher},
+	 { "H264 nal units slicing", test_h264_nalus_slicing}
 #endif
 };
 
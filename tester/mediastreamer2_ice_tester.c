@@ -0,0 +1,390 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "mediastreamer2/mscommon.h"
+#include "mediastreamer2/ice.h"
+#include "mediastreamer2_tester.h"
+#include "mediastreamer2_tester_private.h"
+
+#define ITERATION_INTERVAL	10	/* In milliseconds */
+#define CHECKS_TIMEOUT		5000	/* In milliseconds */
+#define REMOTE_ADDR		"192.0.2.1"
+#define REMOTE_RTP_PORT		7078
+#define REMOTE_RTCP_PORT	7079
+#define MAX_RECORDED_STUN_PACKETS	16
+#define TIMER_TOLERANCE		100	/* In milliseconds */
+#define RTO_DURATION		200	/* In milliseconds, the initial retransmission timeout of the connectivity checks */
+#define KEEPALIVE_TIMEOUT	3	/* In seconds */
+
+typedef struct _ice_agent_t {
+	RtpSession *session;
+	OrtpEvQueue *evq;
+	IceSession *ice_session;
+	IceCheckList *cl;
+	uint32_t ts;
+	int remote_rtp_port;
+	bool_t unresponsive;	/* Record the STUN packets received without handling them */
+	uint64_t requests[MAX_RECORDED_STUN_PACKETS];	/* Reception times of the binding requests from the RTP port of the other agent */
+	int nb_requests;
+	uint64_t indications[MAX_RECORDED_STUN_PACKETS];	/* Reception times of the binding indications from the RTP port of the other agent */
+	int nb_indications;
+} ice_agent_t;
+
+static int tester_init(void) {
+	ortp_init();
+	return 0;
+}
+
+static int tester_cleanup(void) {
+	return 0;
+}
+
+static int ice_agent_init(ice_agent_t *agent, IceRole role) {
+	memset(agent, 0, sizeof(ice_agent_t));
+	agent->session = rtp_session_new(RTP_SESSION_SENDRECV);
+	rtp_session_set_profile(agent->session, &av_profile);
+	rtp_session_set_payload_type(agent->session, 0);
+	rtp_session_set_blocking_mode(agent->session, FALSE);
+	if (rtp_session_set_local_addr(agent->session, "127.0.0.1", -1, -1) < 0) return -1;
+	agent->evq = ortp_ev_queue_new();
+	rtp_session_register_event_queue(agent->session, agent->evq);
+	agent->ice_session = ice_session_new();
+	ice_session_set_role(agent->ice_session, role);
+	agent->cl = ice_check_list_new();
+	ice_session_add_check_list(agent->ice_session, agent->cl, 0);
+	ice_check_list_set_rtp_session(agent->cl, agent->session);
+	ice_add_local_candidate(agent->cl, "host", AF_INET, "127.0.0.1", rtp_session_get_local_port(agent->session), 1, NULL);
+	ice_add_local_candidate(agent->cl, "host", AF_INET, "127.0.0.1", rtp_session_get_local_rtcp_port(agent->session), 2, NULL);
+	return 0;
+}
+
+static void ice_agent_uninit(ice_agent_t *agent) {
+	if (agent->ice_session) ice_session_destroy(agent->ice_session);
+	if (agent->evq) {
+		rtp_session_unregister_event_queue(agent->session, agent->evq);
+		ortp_ev_queue_destroy(agent->evq);
+	}
+	if (agent->session) rtp_session_destroy(agent->session);
+}
+
+/* Do what the offer/answer exchange does: give the agent the credentials and the candidates of the other one. */
+static void ice_agent_set_remote(ice_agent_t *agent, const ice_agent_t *remote) {
+	agent->remote_rtp_port = rtp_session_get_local_port(remote->session);
+	ice_session_set_remote_credentials(agent->ice_session, ice_session_local_ufrag(remote->ice_session), ice_session_local_pwd(remote->ice_session));
+	ice_add_remote_candidate(agent->cl, "host", AF_INET, "127.0.0.1", rtp_session_get_local_port(remote->session), 1, 0, "1", TRUE);
+	ice_add_remote_candidate(agent->cl, "host", AF_INET, "127.0.0.1", rtp_session_get_local_rtcp_port(remote->session), 2, 0, "1", TRUE);
+}
+
+static void ice_agent_start(ice_agent_t *agent) {
+	ice_session_compute_candidates_foundations(agent->ice_session);
+	ice_session_choose_default_candidates(agent->ice_session);
+	ice_session_choose_default_remote_candidates(agent->ice_session);
+	ice_session_start_connectivity_checks(agent->ice_session);
+}
+
+static void ice_agent_record_stun_packet(ice_agent_t *agent, const OrtpEventData *evt_data) {
+	MSStunAddress source;
+	MSStunMessage *msg;
+	mblk_t *mp = evt_data->packet;
+
+	ms_sockaddr_to_stun_address((const struct sockaddr *)&evt_data->source_addr, &source);
+	if (source.ip.v4.port != agent->remote_rtp_port) return;
+	msg = ms_stun_message_create_from_buffer_parsing(mp->b_rptr, (ssize_t)(mp->b_wptr - mp->b_rptr));
+	if (msg == NULL) return;
+	if (ms_stun_message_get_method(msg) == MS_STUN_METHOD_BINDING) {
+		if (ms_stun_message_is_request(msg) && (agent->nb_requests < MAX_RECORDED_STUN_PACKETS)) {
+			agent->requests[agent->nb_requests++] = ms_get_cur_time_ms();
+		} else if (ms_stun_message_is_indication(msg) && (agent->nb_indications < MAX_RECORDED_STUN_PACKETS)) {
+			agent->indications[agent->nb_indications++] = ms_get_cur_time_ms();
+		}
+	}
+	ms_stun_message_destroy(msg);
+}
+
+static void ice_agent_iterate(ice_agent_t *agent) {
+	mblk_t *m;
+	OrtpEvent *ev;
+
+	/* Reading the sockets dispatches the STUN packets received as events. */
+	while ((m = rtp_session_recvm_with_ts(agent->session, agent->ts)) != NULL) freemsg(m);
+	while ((ev = ortp_ev_queue_get(agent->evq)) != NULL) {
+		if (ortp_event_get_type(ev) == ORTP_EVENT_STUN_PACKET_RECEIVED) {
+			ice_agent_record_stun_packet(agent, ortp_event_get_data(ev));
+			if (!agent->unresponsive) ice_handle_stun_packet(agent->cl, agent->session, ortp_event_get_data(ev));
+		}
+		ortp_event_destroy(ev);
+	}
+	ice_check_list_process(agent->cl, agent->session);
+	agent->ts += 8 * ITERATION_INTERVAL;
+}
+
+/* Iterate both agents until the connectivity checks of both have completed or until the timeout. */
+static bool_t ice_agents_wait_for_completion(ice_agent_t *a, ice_agent_t *b, int timeout_ms) {
+	uint64_t start = ms_get_cur_time_ms();
+	while (ms_get_cur_time_ms() - start < (uint64_t)timeout_ms) {
+		ice_agent_iterate(a);
+		ice_agent_iterate(b);
+		if ((ice_session_state(a->ice_session) == IS_Completed) && (ice_session_state(b->ice_session) == IS_Completed)) return TRUE;
+		ms_usleep(ITERATION_INTERVAL * 1000);
+	}
+	return FALSE;
+}
+
+static void ice_agents_iterate_for(ice_agent_t *a, ice_agent_t *b, int duration_ms) {
+	uint64_t start = ms_get_cur_time_ms();
+	while (ms_get_cur_time_ms() - start < (uint64_t)duration_ms) {
+		ice_agent_iterate(a);
+		ice_agent_iterate(b);
+		ms_usleep(ITERATION_INTERVAL * 1000);
+	}
+}
+
+/* The reception times are taken when the agent iterates, so an interval may be short by up to an iteration on each side. */
+static void check_interval(uint64_t from, uint64_t to, int expected_ms) {
+	BC_ASSERT_GREATER((int)(to - from), expected_ms - 2 * ITERATION_INTERVAL, int, "%d");
+	BC_ASSERT_LOWER((int)(to - from), expected_ms + TIMER_TOLERANCE, int, "%d");
+}
+
+static void ice_agents_restart(ice_agent_t *a, ice_agent_t *b) {
+	ice_session_restart(a->ice_session, IR_Controlling);
+	ice_session_restart(b->ice_session, IR_Controlled);
+	ice_agent_set_remote(a, b);
+	ice_agent_set_remote(b, a);
+	ice_agent_start(a);
+	ice_agent_start(b);
+}
+
+static void duplicate_candidate_pairs(void) {
+	ice_agent_t a;
+	ice_agent_t b;
+	IceCandidatePair *pair;
+	IceCandidatePair *duplicates[2] = { NULL, NULL };
+	IceValidCandidatePair *valid_pair;
+	IceValidCandidatePair *selected_pair = NULL;
+	bctbx_list_t *elem;
+	int nb_pairs = 0;
+
+	BC_ASSERT_EQUAL(ice_agent_init(&a, IR_Controlling), 0, int, "%d");
+	BC_ASSERT_EQUAL(ice_agent_init(&b, IR_Controlled), 0, int, "%d");
+	ice_agent_set_remote(&a, &b);
+	ice_agent_set_remote(&b, &a);
+	/* Pairing the candidates a second time gives each pair a duplicate with the same priority, both in the check list. */
+	ice_agent_start(&a);
+	ice_session_start_connectivity_checks(a.ice_session);
+	ice_agent_start(&b);
+	BC_ASSERT_TRUE(ice_agents_wait_for_completion(&a, &b, CHECKS_TIMEOUT));
+
+	for (elem = a.cl->pairs; elem != NULL; elem = elem->next) {
+		pair = (IceCandidatePair *)elem->data;
+		if (pair->local->componentID != 1) continue;
+		if (nb_pairs < 2) duplicates[nb_pairs] = pair;
+		nb_pairs++;
+	}
+	BC_ASSERT_EQUAL(nb_pairs, 2, int, "%d");
+	if (nb_pairs == 2) {
+		BC_ASSERT_PTR_EQUAL(duplicates[0]->local, duplicates[1]->local);
+		BC_ASSERT_PTR_EQUAL(duplicates[0]->remote, duplicates[1]->remote);
+	}
+	for (elem = a.cl->pairs; elem != NULL; elem = elem->next) {
+		pair = (IceCandidatePair *)elem->data;
+		BC_ASSERT_EQUAL(pair->in_check_list, (bctbx_list_find(a.cl->check_list, pair) != NULL), int, "%d");
+	}
+
+	/* Selecting the RTP pair again must resolve to the duplicate that is in the check list and in the valid list,
+	 * not to the one that has been removed from the check list when the checks concluded. */
+	for (elem = a.cl->valid_list; elem != NULL; elem = elem->next) {
+		((IceValidCandidatePair *)elem->data)->selected = FALSE;
+	}
+	ice_add_losing_pair(a.cl, 1, AF_INET, "127.0.0.1", rtp_session_get_local_port(a.session), "127.0.0.1", rtp_session_get_local_port(b.session));
+	for (elem = a.cl->valid_list; elem != NULL; elem = elem->next) {
+		valid_pair = (IceValidCandidatePair *)elem->data;
+		if (valid_pair->selected) selected_pair = valid_pair;
+	}
+	if (BC_ASSERT_PTR_NOT_NULL(selected_pair)) {
+		BC_ASSERT_EQUAL(selected_pair->valid->local->componentID, 1, int, "%d");
+		BC_ASSERT_TRUE(selected_pair->valid->in_check_list);
+	}
+	BC_ASSERT_PTR_NULL(a.cl->losing_pairs);
+
+	ice_agent_uninit(&a);
+	ice_agent_uninit(&b);
+}
+
+static void remove_rtcp_candidates(void) {
+	ice_agent_t a;
+	IceCandidate *local_candidate;
+	IceCandidate *remote_candidate;
+	IceCandidatePair *pair;
+	IceCandidatePair *found = NULL;
+	bctbx_list_t *elem;
+	int rtcp_port;
+
+	BC_ASSERT_EQUAL(ice_agent_init(&a, IR_Controlling), 0, int, "%d");
+	rtcp_port = rtp_session_get_local_rtcp_port(a.session);
+	ice_add_remote_candidate(a.cl, "host", AF_INET, REMOTE_ADDR, REMOTE_RTP_PORT, 1, 0, "1", TRUE);
+	ice_add_remote_candidate(a.cl, "host", AF_INET, REMOTE_ADDR, REMOTE_RTCP_PORT, 2, 0, "1", TRUE);
+	ice_check_list_remove_rtcp_candidates(a.cl);
+	BC_ASSERT_EQUAL((int)bctbx_list_size(a.cl->local_candidates), 1, int, "%d");
+	BC_ASSERT_EQUAL((int)bctbx_list_size(a.cl->remote_candidates), 1, int, "%d");
+
+	/* The removed candidates must be gone from the indexes too, otherwise adding them again is refused as a duplicate. */
+	local_candidate = ice_add_local_candidate(a.cl, "host", AF_INET, "127.0.0.1", rtcp_port, 2, NULL);
+	remote_candidate = ice_add_remote_candidate(a.cl, "host", AF_INET, REMOTE_ADDR, REMOTE_RTCP_PORT, 2, 0, "1", TRUE);
+	BC_ASSERT_PTR_NOT_NULL(local_candidate);
+	BC_ASSERT_PTR_NOT_NULL(remote_candidate);
+
+	/* Looking the candidates up by their addresses must give the new ones. */
+	ice_add_losing_pair(a.cl, 2, AF_INET, "127.0.0.1", rtcp_port, REMOTE_ADDR, REMOTE_RTCP_PORT);
+	for (elem = a.cl->pairs; elem != NULL; elem = elem->next) {
+		pair = (IceCandidatePair *)elem->data;
+		if (pair->local->componentID == 2) found = pair;
+	}
+	if (BC_ASSERT_PTR_NOT_NULL(found)) {
+		BC_ASSERT_PTR_EQUAL(found->local, local_candidate);
+		BC_ASSERT_PTR_EQUAL(found->remote, remote_candidate);
+	}
+
+	ice_agent_uninit(&a);
+}
+
+static void restart_during_connectivity_checks(void) {
+	ice_agent_t a;
+	ice_agent_t b;
+	uint64_t start;
+
+	BC_ASSERT_EQUAL(ice_agent_init(&a, IR_Controlling), 0, int, "%d");
+	BC_ASSERT_EQUAL(ice_agent_init(&b, IR_Controlled), 0, int, "%d");
+	ice_agent_set_remote(&a, &b);
+	ice_agent_set_remote(&b, &a);
+	/* Only the controlling agent runs, so that its checks stay unanswered and their retransmissions are scheduled. */
+	ice_agent_start(&a);
+	start = ms_get_cur_time_ms();
+	while (ms_get_cur_time_ms() - start < 300) {
+		ice_agent_iterate(&a);
+		ms_usleep(ITERATION_INTERVAL * 1000);
+	}
+	BC_ASSERT_EQUAL(ice_check_list_state(a.cl), ICL_Running, int, "%d");
+
+	/* The restart frees the pairs, their retransmission timers must not fire afterwards. */
+	ice_agents_restart(&a, &b);
+	BC_ASSERT_TRUE(ice_agents_wait_for_completion(&a, &b, CHECKS_TIMEOUT));
+	BC_ASSERT_EQUAL(ice_check_list_state(a.cl), ICL_Completed, int, "%d");
+	BC_ASSERT_EQUAL(ice_check_list_state(b.cl), ICL_Completed, int, "%d");
+
+	ice_agent_uninit(&a);
+	ice_agent_uninit(&b);
+}
+
+static void restart_after_connectivity_checks(void) {
+	ice_agent_t a;
+	ice_agent_t b;
+
+	BC_ASSERT_EQUAL(ice_agent_init(&a, IR_Controlling), 0, int, "%d");
+	BC_ASSERT_EQUAL(ice_agent_init(&b, IR_Controlled), 0, int, "%d");
+	ice_agent_set_remote(&a, &b);
+	ice_agent_set_remote(&b, &a);
+	ice_agent_start(&a);
+	ice_agent_start(&b);
+	BC_ASSERT_TRUE(ice_agents_wait_for_completion(&a, &b, CHECKS_TIMEOUT));
+
+	/* The keepalive timers scheduled when the checks completed are cancelled by the restart, and scheduled again
+	 * when the new checks complete. */
+	ice_agents_restart(&a, &b);
+	BC_ASSERT_EQUAL(ice_session_state(a.ice_session), IS_Running, int, "%d");
+	BC_ASSERT_TRUE(ice_agents_wait_for_completion(&a, &b, CHECKS_TIMEOUT));
+	BC_ASSERT_EQUAL(ice_check_list_state(a.cl), ICL_Completed, int, "%d");
+	BC_ASSERT_EQUAL(ice_check_list_state(b.cl), ICL_Completed, int, "%d");
+
+	ice_agent_uninit(&a);
+	ice_agent_uninit(&b);
+}
+
+static void retransmissions_timing(void) {
+	ice_agent_t a;
+	ice_agent_t b;
+	int i;
+	int rto = RTO_DURATION;
+
+	BC_ASSERT_EQUAL(ice_agent_init(&a, IR_Controlling), 0, int, "%d");
+	BC_ASSERT_EQUAL(ice_agent_init(&b, IR_Controlled), 0, int, "%d");
+	ice_agent_set_remote(&a, &b);
+	ice_agent_set_remote(&b, &a);
+	/* The checks of the controlling agent stay unanswered, so the RTP check is retransmitted with an RTO doubling
+	 * each time: 200, 400, 800 and 1600 ms. Stop halfway to the next retransmission, 3200 ms later. */
+	b.unresponsive = TRUE;
+	ice_agent_start(&a);
+	ice_agents_iterate_for(&a, &b, RTO_DURATION * (1 + 2 + 4 + 8 + 8));
+	BC_ASSERT_EQUAL(b.nb_requests, 5, int, "%d");
+	for (i = 1; i < b.nb_requests; i++) {
+		check_interval(b.requests[i - 1], b.requests[i], rto);
+		rto <<= 1;
+	}
+
+	ice_agent_uninit(&a);
+	ice_agent_uninit(&b);
+}
+
+static void keepalives_timing(void) {
+	ice_agent_t a;
+	ice_agent_t b;
+	uint64_t completion_time;
+
+	BC_ASSERT_EQUAL(ice_agent_init(&a, IR_Controlling), 0, int, "%d");
+	BC_ASSERT_EQUAL(ice_agent_init(&b, IR_Controlled), 0, int, "%d");
+	/* Bypass the 15 seconds minimum of ice_session_set_keepalive_timeout() to keep the test short. The timeout stays
+	 * longer than a turn of the timer wheel, so that the keepalive timer has to wait for a second turn. */
+	a.ice_session->keepalive_timeout = KEEPALIVE_TIMEOUT;
+	b.ice_session->keepalive_timeout = KEEPALIVE_TIMEOUT;
+	ice_agent_set_remote(&a, &b);
+	ice_agent_set_remote(&b, &a);
+	ice_agent_start(&a);
+	ice_agent_start(&b);
+	if (!BC_ASSERT_TRUE(ice_agents_wait_for_completion(&a, &b, CHECKS_TIMEOUT))) goto end;
+
+	/* The first keepalive is due a timeout after the checks completed, the next ones a timeout after the previous. */
+	completion_time = (uint64_t)a.cl->keepalive_time.tv_sec * 1000 + (uint64_t)a.cl->keepalive_time.tv_nsec / 1000000;
+	ice_agents_iterate_for(&a, &b, 2 * KEEPALIVE_TIMEOUT * 1000 + TIMER_TOLERANCE);
+	if (BC_ASSERT_EQUAL(b.nb_indications, 2, int, "%d")) {
+		check_interval(completion_time, b.indications[0], KEEPALIVE_TIMEOUT * 1000);
+		check_interval(b.indications[0], b.indications[1], KEEPALIVE_TIMEOUT * 1000);
+	}
+
+end:
+	ice_agent_uninit(&a);
+	ice_agent_uninit(&b);
+}
+
+static test_t tests[] = {
+	{ "Duplicate candidate pairs", duplicate_candidate_pairs },
+	{ "Remove RTCP candidates", remove_rtcp_candidates },
+	{ "Restart during connectivity checks", restart_during_connectivity_checks },
+	{ "Restart after connectivity checks", restart_after_connectivity_checks },
+	{ "Retransmissions timing", retransmissions_timing },
+	{ "Keepalives timing", keepalives_timing },
+};
+
+test_suite_t ice_test_suite = {
+	"ICE",
+	tester_init,
+	tester_cleanup,
+	NULL,
+	NULL,
+	sizeof(tests) / sizeof(tests[0]),
+	tests
+};
@@ -36,6 +36,7 @@ static CodecsManager *_h264_codecs_manager = NULL;
 #define VP8_PAYLOAD_TYPE   103
 #define H264_PAYLOAD_TYPE  104
 #define MP4V_PAYLOAD_TYPE  105
+#define FEC_PAYLOAD_TYPE   110
 
 MSWebCam* mediastreamer2_tester_get_mire_webcam(MSWebCamManager *mgr) {
 	MSWebCam *cam;
@@ -173,6 +174,9 @@ typedef struct _video_stream_tester_t {
 	int local_rtcp;
 	MSWebCam * cam;
 	int payload_type;
+	int retransmission_depth; /*0 to disable retransmissions*/
+	int fec_payload_type; /*0 to disable FEC*/
+	bool_t pacing;
 } video_stream_tester_t;
 
 void video_stream_tester_set_local_ip(video_stream_tester_t* obj,const char*ip) {
@@ -302,6 +306,9 @@ static void create_video_stream(video_stream_tester_t *vst, int payload_type) {
 		video_stream_set_fps(vst->vs, vst->vconf->fps);
 		video_stream_set_sent_video_size(vst->vs, vst->vconf->vsize);
 	}
+	if (vst->retransmission_depth > 0) video_stream_enable_retransmission(vst->vs, vst->retransmission_depth);
+	if (vst->fec_payload_type != 0) video_stream_enable_fec(vst->vs, vst->fec_payload_type);
+	if (vst->pacing) video_stream_enable_pacing(vst->vs, TRUE);
 	vst->payload_type = payload_type;
 }
 
@@ -360,6 +367,10 @@ static void uninit_video_streams(video_stream_tester_t *vst1, video_stream_teste
 
 	destroy_video_stream(vst1);
 	destroy_video_stream(vst2);
+
+	/* The profile is shared by all the tests. */
+	payload_type_unset_flag(vst1_pt, PAYLOAD_TYPE_RTCP_FEEDBACK_ENABLED);
+	payload_type_unset_flag(vst2_pt, PAYLOAD_TYPE_RTCP_FEEDBACK_ENABLED);
 }
 
 static void change_codec(video_stream_tester_t *vst1, video_stream_tester_t *vst2, int payload_type) {
@@ -798,6 +809,86 @@ static void avpf_high_loss_video_stream_base(float rate, int payload_type) {
 	video_stream_tester_destroy(margaux);
 }
 
+static void avpf_high_loss_video_stream_with_retransmissions_vp8(void) {
+	video_stream_tester_t* marielle=video_stream_tester_new();
+	video_stream_tester_t* margaux=video_stream_tester_new();
+	OrtpNetworkSimulatorParams params = { 0 };
+	MSRtpRetransmissionStats marielle_stats, margaux_stats;
+
+	if (ms_factory_codec_supported(_factory, "vp8")) {
+		marielle->retransmission_depth = 256;
+		margaux->retransmission_depth = 256;
+		/* The losses must happen on the way out, so that the receiver sees the gaps in the sequence numbers. */
+		params.enabled = TRUE;
+		params.loss_rate = 10.;
+		params.mode = OrtpNetworkSimulatorOutbound;
+		init_video_streams(marielle, margaux, TRUE, FALSE, &params, VP8_PAYLOAD_TYPE);
+		BC_ASSERT_TRUE(wait_for_until_with_parse_events(&marielle->vs->ms, &margaux->vs->ms,
+			&marielle->stats.number_of_SR, 5, 15000, event_queue_cb, &marielle->stats, event_queue_cb, &margaux->stats));
+		video_stream_get_retransmission_stats(marielle->vs, &marielle_stats);
+		video_stream_get_retransmission_stats(margaux->vs, &margaux_stats);
+		BC_ASSERT_GREATER((int)marielle_stats.nacks_sent, 1, int, "%d");
+		BC_ASSERT_GREATER((int)margaux_stats.nacks_received, 1, int, "%d");
+		BC_ASSERT_GREATER((int)margaux_stats.packets_retransmitted, 1, int, "%d");
+		BC_ASSERT_GREATER((int)marielle_stats.packets_recovered, 1, int, "%d");
+		uninit_video_streams(marielle, margaux);
+	} else {
+		ms_error("VP8 codec is not supported!");
+	}
+	video_stream_tester_destroy(marielle);
+	video_stream_tester_destroy(margaux);
+}
+
+static void high_loss_video_stream_with_fec_vp8(void) {
+	video_stream_tester_t* marielle=video_stream_tester_new();
+	video_stream_tester_t* margaux=video_stream_tester_new();
+	OrtpNetworkSimulatorParams params = { 0 };
+	MSRtpFecStats marielle_stats, margaux_stats;
+
+	if (ms_factory_codec_supported(_factory, "vp8")) {
+		marielle->fec_payload_type = FEC_PAYLOAD_TYPE;
+		margaux->fec_payload_type = FEC_PAYLOAD_TYPE;
+		params.enabled = TRUE;
+		params.loss_rate = 5.;
+		params.mode = OrtpNetworkSimulatorOutbound;
+		init_video_streams(marielle, margaux, FALSE, FALSE, &params, VP8_PAYLOAD_TYPE);
+		BC_ASSERT_TRUE(wait_for_until_with_parse_events(&marielle->vs->ms, &margaux->vs->ms,
+			&marielle->stats.number_of_SR, 5, 15000, event_queue_cb, &marielle->stats, event_queue_cb, &margaux->stats));
+		video_stream_get_fec_stats(marielle->vs, &marielle_stats);
+		video_stream_get_fec_stats(margaux->vs, &margaux_stats);
+		BC_ASSERT_GREATER((int)margaux_stats.fec_packets_sent, 1, int, "%d");
+		BC_ASSERT_GREATER((int)marielle_stats.fec_packets_received, 1, int, "%d");
+		BC_ASSERT_GREATER((int)marielle_stats.packets_recovered, 1, int, "%d");
+		uninit_video_streams(marielle, margaux);
+	} else {
+		ms_error("VP8 codec is not supported!");
+	}
+	video_stream_tester_destroy(marielle);
+	video_stream_tester_destroy(margaux);
+}
+
+static void video_stream_with_pacing_vp8(void) {
+	video_stream_tester_t* marielle=video_stream_tester_new();
+	video_stream_tester_t* margaux=video_stream_tester_new();
+
+	if (ms_factory_codec_supported(_factory, "vp8")) {
+		marielle->pacing = TRUE;
+		margaux->pacing = TRUE;
+		init_video_streams(marielle, margaux, FALSE, FALSE, NULL, VP8_PAYLOAD_TYPE);
+		BC_ASSERT_PTR_NOT_NULL(marielle->vs->pacer);
+		BC_ASSERT_TRUE(wait_for_until_with_parse_events(&marielle->vs->ms, &margaux->vs->ms,
+			&marielle->stats.number_of_SR, 2, 15000, event_queue_cb, &marielle->stats, event_queue_cb, &margaux->stats));
+		/*the packets are paced, not held*/
+		BC_ASSERT_LOWER(video_stream_get_pacing_queue_delay(marielle->vs), 100, int, "%d");
+		BC_ASSERT_GREATER((int)rtp_session_get_stats(margaux->vs->ms.sessions.rtp_session)->packet_recv, 0, int, "%d");
+		uninit_video_streams(marielle, margaux);
+	} else {
+		ms_error("VP8 codec is not supported!");
+	}
+	video_stream_tester_destroy(marielle);
+	video_stream_tester_destroy(margaux);
+}
+
 static void avpf_very_high_loss_video_stream_vp8(void) {
 	avpf_high_loss_video_stream_base(25., VP8_PAYLOAD_TYPE);
 }
@@ -912,6 +1003,9 @@ static test_t tests[] = {
 	{ "AVPF high-loss video stream VP8"          , avpf_high_loss_video_stream_vp8                                 },
 	{ "AVPF high-loss video stream H264"         , avpf_high_loss_video_stream_all_h264_codec_conbinations         },
 	{ "AVPF very high-loss video stream VP8"     , avpf_very_high_loss_video_stream_vp8                            },
+	{ "AVPF high-loss video stream VP8 with retransmissions", avpf_high_loss_video_stream_with_retransmissions_vp8 },
+	{ "High-loss video stream VP8 with FEC"      , high_loss_video_stream_with_fec_vp8                             },
+	{ "Video stream VP8 with pacing"             , video_stream_with_pacing_vp8                                    },
 	{ "AVPF video stream first iframe lost VP8"  , avpf_video_stream_first_iframe_lost_vp8                         },
 	{ "AVPF video stream first iframe lost H264" , avpf_video_stream_first_iframe_lost_all_h264_codec_combinations },
 	{ "AVP video stream first iframe lost VP8"   , video_stream_first_iframe_lost_vp8                              },
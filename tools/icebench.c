@@ -0,0 +1,292 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+/*
+ * Runs the ICE connectivity checks of many calls between agents on the loopback interface, from the pairing of the
+ * candidates to the keepalives, and measures the time spent in the ICE processing.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/mscommon.h"
+#include "mediastreamer2/ice.h"
+#include "ortp/ortp.h"
+
+#include <inttypes.h>
+#include <signal.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#define DEFAULT_NUM_CALLS	1000
+#define MAX_NUM_CANDIDATES	5	/* Per component, the check lists are limited to 10 local candidates */
+#define ITERATION_INTERVAL	10	/* In milliseconds, like the MSTicker of the media streams */
+#define CHECKS_TIMEOUT		60000	/* In milliseconds */
+#define KEEPALIVE_DURATION	5000	/* In milliseconds */
+
+typedef struct _IceBenchAgent {
+	RtpSession *session;
+	OrtpEvQueue *evq;
+	IceSession *ice_session;
+	IceCheckList *cl;
+} IceBenchAgent;
+
+typedef struct _IceBenchCall {
+	IceBenchAgent agents[2];
+	uint64_t completion_time;
+	bool_t completed;
+	bool_t failed;
+} IceBenchCall;
+
+typedef struct _IceBenchStats {
+	uint64_t process_time;	/* In microseconds */
+	uint64_t stun_time;	/* In microseconds */
+	uint64_t stun_packets;
+	int iterations;
+} IceBenchStats;
+
+static int run = 1;
+static int num_candidates = 1;
+
+static void stop(int signum){
+	run = 0;
+}
+
+static uint64_t get_cur_time_us(void){
+	MSTimeSpec ts;
+	ms_get_cur_time(&ts);
+	return ((uint64_t)ts.tv_sec * 1000000) + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+static void raise_file_descriptors_limit(int num_calls){
+#ifndef _WIN32
+	/* Each call uses two RTP sessions with their RTP and RTCP sockets. */
+	struct rlimit rl;
+	rlim_t needed = (rlim_t)num_calls * 4 + 64;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < needed) {
+		rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > needed) ? needed : rl.rlim_max;
+		if (setrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur < needed) {
+			ms_warning("icebench: the number of file descriptors is limited to %i, not enough for %i calls", (int)rl.rlim_cur, num_calls);
+		}
+	}
+#endif
+}
+
+/*
+ * The candidates of a component share the port of the RTP session and have the addresses 127.0.0.1 to 127.0.0.<n>.
+ * Only the first one is bound: the checks sent to the other ones are never answered and are retransmitted until the
+ * check list completes, the ones sent from them leave from 127.0.0.1 and are answered like the checks of the first one.
+ */
+static void add_candidates(IceCheckList *cl, const RtpSession *session, bool_t remote){
+	char addr[16];
+	int i;
+	for (i = 1; i <= num_candidates; i++) {
+		snprintf(addr, sizeof(addr), "127.0.0.%i", i);
+		if (remote) {
+			ice_add_remote_candidate(cl, "host", AF_INET, addr, rtp_session_get_local_port(session), 1, 0, "1", TRUE);
+			ice_add_remote_candidate(cl, "host", AF_INET, addr, rtp_session_get_local_rtcp_port(session), 2, 0, "1", TRUE);
+		} else {
+			ice_add_local_candidate(cl, "host", AF_INET, addr, rtp_session_get_local_port(session), 1, NULL);
+			ice_add_local_candidate(cl, "host", AF_INET, addr, rtp_session_get_local_rtcp_port(session), 2, NULL);
+		}
+	}
+}
+
+static int agent_init(IceBenchAgent *agent, IceRole role){
+	agent->session = rtp_session_new(RTP_SESSION_SENDRECV);
+	rtp_session_set_profile(agent->session, &av_profile);
+	rtp_session_set_payload_type(agent->session, 0);
+	rtp_session_set_blocking_mode(agent->session, FALSE);
+	if (rtp_session_set_local_addr(agent->session, "127.0.0.1", -1, -1) < 0) {
+		ms_error("icebench: cannot bind the RTP session");
+		return -1;
+	}
+	agent->evq = ortp_ev_queue_new();
+	rtp_session_register_event_queue(agent->session, agent->evq);
+	agent->ice_session = ice_session_new();
+	ice_session_set_role(agent->ice_session, role);
+	agent->cl = ice_check_list_new();
+	ice_session_add_check_list(agent->ice_session, agent->cl, 0);
+	ice_check_list_set_rtp_session(agent->cl, agent->session);
+	add_candidates(agent->cl, agent->session, FALSE);
+	return 0;
+}
+
+static void agent_uninit(IceBenchAgent *agent){
+	if (agent->ice_session) ice_session_destroy(agent->ice_session);
+	if (agent->evq) {
+		rtp_session_unregister_event_queue(agent->session, agent->evq);
+		ortp_ev_queue_destroy(agent->evq);
+	}
+	if (agent->session) rtp_session_destroy(agent->session);
+}
+
+/* Do what the offer/answer exchange does: give each agent the credentials and the candidates of the other. */
+static void agent_set_remote(IceBenchAgent *agent, const IceBenchAgent *remote){
+	ice_session_set_remote_credentials(agent->ice_session, ice_session_local_ufrag(remote->ice_session), ice_session_local_pwd(remote->ice_session));
+	add_candidates(agent->cl, remote->session, TRUE);
+}
+
+static void agent_start(IceBenchAgent *agent){
+	ice_session_compute_candidates_foundations(agent->ice_session);
+	ice_session_choose_default_candidates(agent->ice_session);
+	ice_session_choose_default_remote_candidates(agent->ice_session);
+	ice_session_start_connectivity_checks(agent->ice_session);
+}
+
+static void agent_iterate(IceBenchAgent *agent, uint32_t ts, IceBenchStats *stats){
+	mblk_t *m;
+	OrtpEvent *ev;
+	uint64_t start;
+
+	/* Reading the sockets dispatches the STUN packets received as events. */
+	while ((m = rtp_session_recvm_with_ts(agent->session, ts)) != NULL) freemsg(m);
+	while ((ev = ortp_ev_queue_get(agent->evq)) != NULL) {
+		if (ortp_event_get_type(ev) == ORTP_EVENT_STUN_PACKET_RECEIVED) {
+			start = get_cur_time_us();
+			ice_handle_stun_packet(agent->cl, agent->session, ortp_event_get_data(ev));
+			stats->stun_time += get_cur_time_us() - start;
+			stats->stun_packets++;
+		}
+		ortp_event_destroy(ev);
+	}
+	start = get_cur_time_us();
+	ice_check_list_process(agent->cl, agent->session);
+	stats->process_time += get_cur_time_us() - start;
+}
+
+static void print_stats(const char *phase, const IceBenchStats *stats, int num_calls){
+	printf("%s: %i iterations, %.1f us per call and iteration in ice_check_list_process(), %" PRIu64 " STUN packets handled in %.1f us on average\n",
+		phase, stats->iterations,
+		stats->iterations ? (double)stats->process_time / ((double)stats->iterations * num_calls) : 0.0,
+		stats->stun_packets, stats->stun_packets ? (double)stats->stun_time / (double)stats->stun_packets : 0.0);
+}
+
+int main(int argc, char *argv[]){
+	IceBenchCall *calls;
+	IceBenchStats checks_stats;
+	IceBenchStats keepalive_stats;
+	int num_calls = DEFAULT_NUM_CALLS;
+	int num_completed = 0;
+	int num_failed = 0;
+	uint64_t start_time;
+	uint64_t last_completion_time = 0;
+	uint64_t keepalive_start_time = 0;
+	uint32_t ts = 0;
+	bool_t verbose = FALSE;
+	int i, j;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--calls") == 0 && i + 1 < argc) {
+			num_calls = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--candidates") == 0 && i + 1 < argc) {
+			num_candidates = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--verbose") == 0) {
+			verbose = TRUE;
+		} else {
+			printf("Usage: icebench [--calls <number of calls, %i by default>] [--candidates <number of host candidates per component, from 1 to %i>] [--verbose]\n",
+				DEFAULT_NUM_CALLS, MAX_NUM_CANDIDATES);
+			return -1;
+		}
+	}
+	if (num_calls <= 0) {
+		ms_error("icebench: wrong number of calls");
+		return -1;
+	}
+	if (num_candidates <= 0 || num_candidates > MAX_NUM_CANDIDATES) {
+		ms_error("icebench: wrong number of candidates");
+		return -1;
+	}
+
+	ortp_init();
+	if (verbose) ortp_set_log_level_mask(ORTP_LOG_DOMAIN, ORTP_MESSAGE|ORTP_WARNING|ORTP_ERROR|ORTP_FATAL);
+	else ortp_set_log_level_mask(ORTP_LOG_DOMAIN, ORTP_WARNING|ORTP_ERROR|ORTP_FATAL);
+	raise_file_descriptors_limit(num_calls);
+	signal(SIGINT, stop);
+
+	calls = ms_new0(IceBenchCall, num_calls);
+	for (i = 0; i < num_calls; i++) {
+		if (agent_init(&calls[i].agents[0], IR_Controlling) < 0 || agent_init(&calls[i].agents[1], IR_Controlled) < 0) {
+			ms_error("icebench: only %i calls could be created", i);
+			agent_uninit(&calls[i].agents[0]);
+			agent_uninit(&calls[i].agents[1]);
+			num_calls = i;
+			break;
+		}
+		agent_set_remote(&calls[i].agents[0], &calls[i].agents[1]);
+		agent_set_remote(&calls[i].agents[1], &calls[i].agents[0]);
+	}
+
+	memset(&checks_stats, 0, sizeof(checks_stats));
+	memset(&keepalive_stats, 0, sizeof(keepalive_stats));
+	start_time = ms_get_cur_time_ms();
+	for (i = 0; i < num_calls; i++) {
+		agent_start(&calls[i].agents[0]);
+		agent_start(&calls[i].agents[1]);
+	}
+
+	while (run) {
+		uint64_t now = ms_get_cur_time_ms();
+		IceBenchStats *stats;
+
+		if (keepalive_start_time == 0 && (num_completed + num_failed == num_calls || now - start_time >= CHECKS_TIMEOUT)) {
+			keepalive_start_time = now;
+		}
+		if (keepalive_start_time != 0 && now - keepalive_start_time >= KEEPALIVE_DURATION) break;
+		stats = (keepalive_start_time == 0) ? &checks_stats : &keepalive_stats;
+
+		for (i = 0; i < num_calls; i++) {
+			IceBenchCall *call = &calls[i];
+			for (j = 0; j < 2; j++) agent_iterate(&call->agents[j], ts, stats);
+			if (!call->completed && !call->failed) {
+				IceSessionState s0 = ice_session_state(call->agents[0].ice_session);
+				IceSessionState s1 = ice_session_state(call->agents[1].ice_session);
+				if (s0 == IS_Completed && s1 == IS_Completed) {
+					call->completed = TRUE;
+					call->completion_time = ms_get_cur_time_ms() - start_time;
+					last_completion_time = MAX(last_completion_time, call->completion_time);
+					num_completed++;
+				} else if (s0 == IS_Failed || s1 == IS_Failed) {
+					call->failed = TRUE;
+					num_failed++;
+				}
+			}
+		}
+		stats->iterations++;
+		ts += 8 * ITERATION_INTERVAL;
+		now = ms_get_cur_time_ms() - now;
+		if (now < ITERATION_INTERVAL) ms_usleep((ITERATION_INTERVAL - now) * 1000);
+	}
+
+	if (num_calls == 0) goto end;
+	printf("%i calls with %i candidates per component: %i completed in %" PRIu64 " ms, %i failed\n", num_calls, num_candidates, num_completed, last_completion_time, num_failed);
+	print_stats("connectivity checks", &checks_stats, num_calls);
+	print_stats("keepalives", &keepalive_stats, num_calls);
+
+	for (i = 0; i < num_calls; i++) {
+		agent_uninit(&calls[i].agents[0]);
+		agent_uninit(&calls[i].agents[1]);
+	}
+end:
+	ms_free(calls);
+	ortp_exit();
+	return (num_calls > 0 && num_completed == num_calls) ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2016  Belledonne Communications SARL
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+/*
+ * Measures the cost of concealing frames with the MSGenericPLC filter, for bursts of 5 frames of 10ms lost every
+ * 10 frames, at the sample rates the filter is used with.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msfactory.h"
+#include "mediastreamer2/msticker.h"
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEFAULT_NUM_FRAMES 100000
+
+static uint64_t get_cur_time_us(void){
+	MSTimeSpec ts;
+	ms_get_cur_time(&ts);
+	return ((uint64_t)ts.tv_sec * 1000000) + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+static void run_plc(MSFactory *factory, int rate, int num_frames){
+	MSFilter *source = ms_factory_create_filter(factory, MS_VOID_SOURCE_ID);
+	MSFilter *plc = ms_factory_create_filter(factory, MS_GENERIC_PLC_ID);
+	MSFilter *sink = ms_factory_create_filter(factory, MS_VOID_SINK_ID);
+	MSTicker ticker;
+	int nsamples = rate / 100;
+	int concealed = 0;
+	uint64_t elapsed = 0;
+	uint64_t start;
+	mblk_t *m;
+	int k, i;
+
+	memset(&ticker, 0, sizeof(ticker));
+	ticker.interval = 10;
+	ms_filter_call_method(plc, MS_FILTER_SET_SAMPLE_RATE, &rate);
+	ms_filter_link(source, 0, plc, 0);
+	ms_filter_link(plc, 0, sink, 0);
+	/*the filter is driven by hand, so that only its own processing is measured*/
+	plc->ticker = &ticker;
+	plc->desc->preprocess(plc);
+
+	for (k = 0; k < num_frames; k++){
+		bool_t lost = (k % 10 >= 5);
+		ticker.time = (uint64_t)k * ticker.interval;
+		if (!lost){
+			m = allocb(nsamples * sizeof(int16_t), 0);
+			for (i = 0; i < nsamples; i++){
+				*((int16_t *)m->b_wptr) = (int16_t)(8000 * sin(2 * M_PI * 440 * (double)(k * nsamples + i) / rate));
+				m->b_wptr += sizeof(int16_t);
+			}
+			ms_queue_put(plc->inputs[0], m);
+		}
+		start = get_cur_time_us();
+		plc->desc->process(plc);
+		if (lost){
+			elapsed += get_cur_time_us() - start;
+			concealed++;
+		}
+		ms_queue_flush(plc->outputs[0]);
+	}
+	printf("generic PLC at %i Hz: %.2f us per concealed frame\n", rate, concealed ? (double)elapsed / concealed : 0.0);
+
+	plc->ticker = NULL;
+	ms_filter_unlink(source, 0, plc, 0);
+	ms_filter_unlink(plc, 0, sink, 0);
+	ms_filter_destroy(source);
+	ms_filter_destroy(plc);
+	ms_filter_destroy(sink);
+}
+
+int main(int argc, char *argv[]){
+	/*44.1 kHz is left out: its PLC buffer length is odd, which the FFT of the PLC does not support*/
+	int rates[] = { 8000, 16000, 24000, 32000, 48000 };
+	int num_frames = DEFAULT_NUM_FRAMES;
+	MSFactory *factory;
+	int i;
+
+	for (i = 1; i < argc; i++){
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc){
+			num_frames = atoi(argv[++i]);
+		}else{
+			printf("Usage: plcbench [--frames <number of 10ms frames per sample rate, %i by default>]\n", DEFAULT_NUM_FRAMES);
+			return -1;
+		}
+	}
+	if (num_frames <= 0){
+		ms_error("plcbench: wrong number of frames");
+		return -1;
+	}
+
+	ortp_set_log_level_mask(ORTP_LOG_DOMAIN, ORTP_WARNING|ORTP_ERROR|ORTP_FATAL);
+	factory = ms_factory_new_with_voip();
+	for (i = 0; i < (int)(sizeof(rates) / sizeof(rates[0])); i++){
+		run_plc(factory, rates[i], num_frames);
+	}
+	ms_factory_destroy(factory);
+	return 0;
+}